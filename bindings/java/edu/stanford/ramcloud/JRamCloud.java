@@ -15,6 +15,8 @@
 
 package edu.stanford.ramcloud;
 
+import java.nio.ByteBuffer;
+
 /*
  * This class provides Java bindings for RAMCloud. Right now it is a rather
  * simple subset of what RamCloud.h defines.
@@ -23,6 +25,13 @@ package edu.stanford.ramcloud;
  * appropriate JNI function definitions. The glue interfacing to the C++
  * RAMCloud library can be found in JRamCloud.cc.
  *
+ * The readDirect/writeDirect/removeDirect, multiRead/multiWrite, and
+ * async methods are the fast path: keys and values are passed in direct
+ * ByteBuffers and values are returned as direct ByteBuffers referring to
+ * memory in the native client, so no object data is copied onto the Java
+ * heap. The methods taking byte[] and String arguments are simpler to use
+ * but copy every key and value through the JNI.
+ *
  * For JNI information, the IBM tutorials and Android developer docs are much
  * better than Sun's at giving an overall intro:
  *      http://www.ibm.com/developerworks/java/tutorials/j-jni/section4.html
@@ -81,6 +90,44 @@ public class JRamCloud {
         final public long version;
     }
 
+    /**
+     * This class is returned by the zero-copy read operations. Its value is a
+     * read-only direct ByteBuffer referring to memory owned by the native
+     * client, so no copy of the object is made on the Java heap. That memory
+     * is freed by release(), which must be called once the value is no
+     * longer needed; the ByteBuffer must not be used afterwards.
+     */
+    public class DirectObject {
+        DirectObject(ByteBuffer _value, long _version, long _bufferPointer)
+        {
+            value = _value;
+            version = _version;
+            bufferPointer = _bufferPointer;
+        }
+
+        public void
+        release()
+        {
+            if (bufferPointer != 0) {
+                releaseBuffer(bufferPointer);
+                bufferPointer = 0;
+            }
+        }
+
+        final public ByteBuffer value;
+        final public long version;
+
+        /// Pointer to the native Buffer holding value; 0 once released.
+        private long bufferPointer;
+    }
+
+    /// Values returned in the statuses arrays of multiRead and multiWrite.
+    /// See src/Status.h for the others.
+    public static final int STATUS_OK = 0;
+    public static final int STATUS_OBJECT_DOESNT_EXIST = 3;
+    public static final int STATUS_OBJECT_EXISTS = 4;
+    public static final int STATUS_WRONG_VERSION = 5;
+
     /**
      * Connect to the RAMCloud cluster specified by the given coordinator's
      * service locator string. This causes the JNI code to instantiate the
@@ -207,6 +254,53 @@ public class JRamCloud {
     public native long write(long tableId, byte[] key, byte[] value);
     public native long write(long tableId, byte[] key, byte[] value, RejectRules rules);
 
+    /*
+     * Zero-copy operations. Keys and values are direct ByteBuffers; the first
+     * keyLength (or valueLength) bytes of each are used, regardless of its
+     * position and limit.
+     */
+
+    public native DirectObject readDirect(long tableId, ByteBuffer key, int keyLength);
+    public native long removeDirect(long tableId, ByteBuffer key, int keyLength);
+    public native long writeDirect(long tableId, ByteBuffer key, int keyLength,
+                                   ByteBuffer value, int valueLength);
+
+    /**
+     * Read many objects at once, with one RPC per master. The result has one
+     * entry for each key: null if the object couldn't be read, in which case
+     * the reason is in the corresponding element of statuses (which must be
+     * at least as long as keys).
+     */
+    public native DirectObject[] multiRead(long[] tableIds, ByteBuffer[] keys,
+                                           int[] keyLengths, int[] statuses);
+
+    /**
+     * Write many objects at once, with one RPC per master. The new version
+     * and the status of each write are returned in versions and statuses.
+     */
+    public native void multiWrite(long[] tableIds, ByteBuffer[] keys,
+                                  int[] keyLengths, ByteBuffer[] values,
+                                  int[] valueLengths, long[] versions,
+                                  int[] statuses);
+
+    /*
+     * Asynchronous operations. Each returns a handle that must eventually be
+     * passed to the matching wait method (or to cancel). The key and value
+     * buffers are referenced until then, so they must not be modified.
+     * isReady may be called in between to find out, without blocking,
+     * whether wait would return immediately.
+     */
+
+    public native long readAsync(long tableId, ByteBuffer key, int keyLength);
+    public native DirectObject readWait(long handle);
+    public native long writeAsync(long tableId, ByteBuffer key, int keyLength,
+                                  ByteBuffer value, int valueLength);
+    public native long writeWait(long handle);
+    public native boolean isReady(long handle);
+    public native void cancel(long handle);
+
+    private static native void releaseBuffer(long bufferPointer);
+
     /*
      * The following exceptions may be thrown by the JNI functions:
      */
@@ -14,6 +14,8 @@
  */
 
 #include <RamCloud.h>
+#include <MultiRead.h>
+#include <MultiWrite.h>
 #include "edu_stanford_ramcloud_JRamCloud.h"
 
 using namespace RAMCloud;
@@ -92,6 +94,108 @@ class JByteArrayGetter {
     const jsize length;
 };
 
+/**
+ * Native memory behind the value of a JRamCloud.DirectObject. The Java
+ * object holds a pointer to one of these, which is deleted when the
+ * object is released.
+ */
+struct DirectValue {
+    DirectValue()
+        : buffer()
+        , object()
+    {}
+
+    /// Holds the value returned by a single-object read.
+    Buffer buffer;
+
+    /// Holds the object returned by a multiRead.
+    Tub<ObjectBuffer> object;
+};
+
+/**
+ * State of an operation started by readAsync or writeAsync. The handle
+ * returned to Java is a pointer to one of these.
+ */
+struct AsyncRpc {
+    AsyncRpc()
+        : value(new DirectValue)
+        , readRpc()
+        , writeRpc()
+    {}
+
+    RpcWrapper*
+    rpc()
+    {
+        if (readRpc)
+            return readRpc.get();
+        return writeRpc.get();
+    }
+
+    /// Receives the value of a read; handed over to the DirectObject.
+    std::unique_ptr<DirectValue> value;
+
+    /// Exactly one of these is constructed.
+    Tub<ReadRpc> readRpc;
+    Tub<WriteRpc> writeRpc;
+};
+
+/// JRamCloud.DirectObject class and constructor, looked up once since
+/// FindClass is expensive.
+static jclass directObjectClass = NULL;
+static jmethodID directObjectConstructor = NULL;
+
+static void
+initDirectObjectClass(JNIEnv* env)
+{
+    if (directObjectClass != NULL)
+        return;
+    jclass cls = env->FindClass(PACKAGE_PATH "JRamCloud$DirectObject");
+    check_null(cls, "FindClass failed");
+    directObjectConstructor = env->GetMethodID(cls,
+                                  "<init>",
+                                  "(L" PACKAGE_PATH "JRamCloud;Ljava/nio/ByteBuffer;JJ)V");
+    check_null(directObjectConstructor, "GetMethodID failed");
+    directObjectClass = reinterpret_cast<jclass>(env->NewGlobalRef(cls));
+    check_null(directObjectClass, "NewGlobalRef failed");
+}
+
+/**
+ * Wrap native memory in a new JRamCloud.DirectObject without copying it.
+ * The DirectObject takes ownership of \a value.
+ */
+static jobject
+newDirectObject(JNIEnv* env, jobject jRamCloud, DirectValue* value,
+                const void* data, uint32_t length, uint64_t version)
+{
+    // NewDirectByteBuffer rejects NULL, which empty ranges may return.
+    static char empty;
+    if (length == 0)
+        data = &empty;
+    initDirectObjectClass(env);
+    jobject jValue = env->NewDirectByteBuffer(const_cast<void*>(data), length);
+    check_null(jValue, "NewDirectByteBuffer failed");
+    jobject jObject = env->NewObject(directObjectClass,
+                                     directObjectConstructor,
+                                     jRamCloud,
+                                     jValue,
+                                     static_cast<jlong>(version),
+                                     reinterpret_cast<jlong>(value));
+    env->DeleteLocalRef(jValue);
+    return jObject;
+}
+
+/**
+ * Return the memory behind a direct ByteBuffer, so keys and values can be
+ * passed to RAMCloud without copying them.
+ */
+static void*
+getDirectAddress(JNIEnv* env, jobject jBuffer)
+{
+    void* address = env->GetDirectBufferAddress(jBuffer);
+    check_null(address, "GetDirectBufferAddress failed (not a direct ByteBuffer?)");
+    return address;
+}
+
 static RamCloud*
 getRamCloud(JNIEnv* env, jobject jRamCloud)
 {
@@ -418,3 +522,328 @@ JNICALL Java_edu_stanford_ramcloud_JRamCloud_write__J_3B_3BLJRamCloud_RejectRule
     } EXCEPTION_CATCHER(-1);
     return static_cast<jlong>(version);
 }
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    readDirect
+ * Signature: (JLjava/nio/ByteBuffer;I)Ledu/stanford/ramcloud/JRamCloud$DirectObject;
+ */
+JNIEXPORT jobject
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_readDirect(JNIEnv *env,
+                                  jobject jRamCloud,
+                                  jlong jTableId,
+                                  jobject jKey,
+                                  jint jKeyLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    void* key = getDirectAddress(env, jKey);
+    std::unique_ptr<DirectValue> value(new DirectValue);
+    uint64_t version;
+    try {
+        ramcloud->read(jTableId, key, downCast<uint16_t>(jKeyLength),
+                       &value->buffer, NULL, &version);
+    } EXCEPTION_CATCHER(NULL);
+
+    // getRange only copies if the value spans several chunks of the
+    // response, and then into memory owned by the Buffer itself.
+    uint32_t length = value->buffer.getTotalLength();
+    const void* data = value->buffer.getRange(0, length);
+    return newDirectObject(env, jRamCloud, value.release(), data, length,
+                           version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    removeDirect
+ * Signature: (JLjava/nio/ByteBuffer;I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_removeDirect(JNIEnv *env,
+                                    jobject jRamCloud,
+                                    jlong jTableId,
+                                    jobject jKey,
+                                    jint jKeyLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    void* key = getDirectAddress(env, jKey);
+    uint64_t version;
+    try {
+        ramcloud->remove(jTableId, key, downCast<uint16_t>(jKeyLength), NULL,
+                         &version);
+    } EXCEPTION_CATCHER(-1);
+    return static_cast<jlong>(version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    writeDirect
+ * Signature: (JLjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_writeDirect(JNIEnv *env,
+                                   jobject jRamCloud,
+                                   jlong jTableId,
+                                   jobject jKey,
+                                   jint jKeyLength,
+                                   jobject jValue,
+                                   jint jValueLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    void* key = getDirectAddress(env, jKey);
+    void* value = getDirectAddress(env, jValue);
+    uint64_t version;
+    try {
+        ramcloud->write(jTableId,
+                        key, downCast<uint16_t>(jKeyLength),
+                        value, jValueLength,
+                        NULL,
+                        &version);
+    } EXCEPTION_CATCHER(-1);
+    return static_cast<jlong>(version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    multiRead
+ * Signature: ([J[Ljava/nio/ByteBuffer;[I[I)[Ledu/stanford/ramcloud/JRamCloud$DirectObject;
+ */
+JNIEXPORT jobjectArray
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_multiRead(JNIEnv *env,
+                                 jobject jRamCloud,
+                                 jlongArray jTableIds,
+                                 jobjectArray jKeys,
+                                 jintArray jKeyLengths,
+                                 jintArray jStatuses)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    jsize count = env->GetArrayLength(jKeys);
+    std::vector<jlong> tableIds(count);
+    std::vector<jint> keyLengths(count);
+    env->GetLongArrayRegion(jTableIds, 0, count, tableIds.data());
+    env->GetIntArrayRegion(jKeyLengths, 0, count, keyLengths.data());
+
+    std::vector<std::unique_ptr<DirectValue>> values(count);
+    std::vector<MultiReadObject> objects(count);
+    std::vector<MultiReadObject*> pointers(count);
+    for (jsize i = 0; i < count; i++) {
+        jobject jKey = env->GetObjectArrayElement(jKeys, i);
+        void* key = getDirectAddress(env, jKey);
+        env->DeleteLocalRef(jKey);
+        values[i].reset(new DirectValue);
+        objects[i] = MultiReadObject(tableIds[i], key,
+                                     downCast<uint16_t>(keyLengths[i]),
+                                     &values[i]->object);
+        pointers[i] = &objects[i];
+    }
+    try {
+        ramcloud->multiRead(pointers.data(), count);
+    } EXCEPTION_CATCHER(NULL);
+
+    initDirectObjectClass(env);
+    jobjectArray result = env->NewObjectArray(count, directObjectClass, NULL);
+    check_null(result, "NewObjectArray failed");
+    std::vector<jint> statuses(count);
+    for (jsize i = 0; i < count; i++) {
+        statuses[i] = objects[i].status;
+        if (objects[i].status != STATUS_OK)
+            continue;
+        ObjectBuffer* object = values[i]->object.get();
+        uint16_t offset;
+        object->getValueOffset(&offset);
+        uint32_t length = object->getTotalLength() - offset;
+        const void* data = object->getRange(offset, length);
+        jobject jObject = newDirectObject(env, jRamCloud, values[i].release(),
+                                          data, length, objects[i].version);
+        env->SetObjectArrayElement(result, i, jObject);
+        env->DeleteLocalRef(jObject);
+    }
+    env->SetIntArrayRegion(jStatuses, 0, count, statuses.data());
+    return result;
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    multiWrite
+ * Signature: ([J[Ljava/nio/ByteBuffer;[I[Ljava/nio/ByteBuffer;[I[J[I)V
+ */
+JNIEXPORT void
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_multiWrite(JNIEnv *env,
+                                  jobject jRamCloud,
+                                  jlongArray jTableIds,
+                                  jobjectArray jKeys,
+                                  jintArray jKeyLengths,
+                                  jobjectArray jValues,
+                                  jintArray jValueLengths,
+                                  jlongArray jVersions,
+                                  jintArray jStatuses)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    jsize count = env->GetArrayLength(jKeys);
+    std::vector<jlong> tableIds(count);
+    std::vector<jint> keyLengths(count);
+    std::vector<jint> valueLengths(count);
+    env->GetLongArrayRegion(jTableIds, 0, count, tableIds.data());
+    env->GetIntArrayRegion(jKeyLengths, 0, count, keyLengths.data());
+    env->GetIntArrayRegion(jValueLengths, 0, count, valueLengths.data());
+
+    std::vector<MultiWriteObject> objects(count);
+    std::vector<MultiWriteObject*> pointers(count);
+    for (jsize i = 0; i < count; i++) {
+        jobject jKey = env->GetObjectArrayElement(jKeys, i);
+        jobject jValue = env->GetObjectArrayElement(jValues, i);
+        objects[i] = MultiWriteObject(tableIds[i],
+                                      getDirectAddress(env, jKey),
+                                      downCast<uint16_t>(keyLengths[i]),
+                                      getDirectAddress(env, jValue),
+                                      valueLengths[i]);
+        env->DeleteLocalRef(jKey);
+        env->DeleteLocalRef(jValue);
+        pointers[i] = &objects[i];
+    }
+    try {
+        ramcloud->multiWrite(pointers.data(), count);
+    } EXCEPTION_CATCHER();
+
+    std::vector<jlong> versions(count);
+    std::vector<jint> statuses(count);
+    for (jsize i = 0; i < count; i++) {
+        versions[i] = objects[i].version;
+        statuses[i] = objects[i].status;
+    }
+    env->SetLongArrayRegion(jVersions, 0, count, versions.data());
+    env->SetIntArrayRegion(jStatuses, 0, count, statuses.data());
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    readAsync
+ * Signature: (JLjava/nio/ByteBuffer;I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_readAsync(JNIEnv *env,
+                                 jobject jRamCloud,
+                                 jlong jTableId,
+                                 jobject jKey,
+                                 jint jKeyLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    void* key = getDirectAddress(env, jKey);
+    std::unique_ptr<AsyncRpc> async(new AsyncRpc);
+    try {
+        async->readRpc.construct(ramcloud, jTableId, key,
+                                 downCast<uint16_t>(jKeyLength),
+                                 &async->value->buffer);
+    } EXCEPTION_CATCHER(0);
+    return reinterpret_cast<jlong>(async.release());
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    readWait
+ * Signature: (J)Ledu/stanford/ramcloud/JRamCloud$DirectObject;
+ */
+JNIEXPORT jobject
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_readWait(JNIEnv *env,
+                                jobject jRamCloud,
+                                jlong jHandle)
+{
+    std::unique_ptr<AsyncRpc> async(reinterpret_cast<AsyncRpc*>(jHandle));
+    uint64_t version;
+    try {
+        async->readRpc->wait(&version);
+    } EXCEPTION_CATCHER(NULL);
+
+    Buffer& buffer = async->value->buffer;
+    uint32_t length = buffer.getTotalLength();
+    const void* data = buffer.getRange(0, length);
+    return newDirectObject(env, jRamCloud, async->value.release(), data,
+                           length, version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    writeAsync
+ * Signature: (JLjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_writeAsync(JNIEnv *env,
+                                  jobject jRamCloud,
+                                  jlong jTableId,
+                                  jobject jKey,
+                                  jint jKeyLength,
+                                  jobject jValue,
+                                  jint jValueLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    void* key = getDirectAddress(env, jKey);
+    void* value = getDirectAddress(env, jValue);
+    std::unique_ptr<AsyncRpc> async(new AsyncRpc);
+    try {
+        async->writeRpc.construct(ramcloud, jTableId,
+                                  key, downCast<uint16_t>(jKeyLength),
+                                  value, jValueLength);
+    } EXCEPTION_CATCHER(0);
+    return reinterpret_cast<jlong>(async.release());
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    writeWait
+ * Signature: (J)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_writeWait(JNIEnv *env,
+                                 jobject jRamCloud,
+                                 jlong jHandle)
+{
+    std::unique_ptr<AsyncRpc> async(reinterpret_cast<AsyncRpc*>(jHandle));
+    uint64_t version;
+    try {
+        async->writeRpc->wait(&version);
+    } EXCEPTION_CATCHER(-1);
+    return static_cast<jlong>(version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    isReady
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_isReady(JNIEnv *env,
+                               jobject jRamCloud,
+                               jlong jHandle)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    AsyncRpc* async = reinterpret_cast<AsyncRpc*>(jHandle);
+    ramcloud->poll();
+    return async->rpc()->isReady() ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    cancel
+ * Signature: (J)V
+ */
+JNIEXPORT void
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_cancel(JNIEnv *env,
+                              jobject jRamCloud,
+                              jlong jHandle)
+{
+    AsyncRpc* async = reinterpret_cast<AsyncRpc*>(jHandle);
+    async->rpc()->cancel();
+    delete async;
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    releaseBuffer
+ * Signature: (J)V
+ */
+JNIEXPORT void
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_releaseBuffer(JNIEnv *env,
+                                     jclass jRamCloud,
+                                     jlong bufferPointer)
+{
+    delete reinterpret_cast<DirectValue*>(bufferPointer);
+}
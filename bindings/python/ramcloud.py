@@ -45,6 +45,36 @@ class RejectRules(ctypes.Structure):
         return RejectRules(object_doesnt_exist=True, version_gt_given=True,
                            given_version=want_version)
 
+class MultiReadObject(ctypes.Structure):
+    _fields_ = [("tableId", ctypes.c_uint64),
+                ("key", ctypes.c_char_p),
+                ("keyLength", ctypes.c_uint16),
+                ("buf", ctypes.c_void_p),
+                ("maxLength", ctypes.c_uint32),
+                ("actualLength", ctypes.c_uint32),
+                ("version", ctypes.c_uint64),
+                ("status", ctypes.c_int),
+                ]
+
+class MultiWriteObject(ctypes.Structure):
+    _fields_ = [("tableId", ctypes.c_uint64),
+                ("key", ctypes.c_char_p),
+                ("keyLength", ctypes.c_uint16),
+                ("buf", ctypes.c_char_p),
+                ("length", ctypes.c_uint32),
+                ("rejectRules", ctypes.POINTER(RejectRules)),
+                ("version", ctypes.c_uint64),
+                ("status", ctypes.c_int),
+                ]
+
+class MultiRemoveObject(ctypes.Structure):
+    _fields_ = [("tableId", ctypes.c_uint64),
+                ("key", ctypes.c_char_p),
+                ("keyLength", ctypes.c_uint16),
+                ("rejectRules", ctypes.POINTER(RejectRules)),
+                ("version", ctypes.c_uint64),
+                ("status", ctypes.c_int),
+                ]
 
 def load_so():
     not_found = ImportError("Couldn't find libramcloud.so, ensure it is " +
@@ -118,6 +148,8 @@ def load_so():
     table               = ctypes.c_uint64
     version             = ctypes.c_uint64
     serverId            = ctypes.c_uint64
+    async               = ctypes.c_void_p
+    count               = ctypes.c_uint32
 
     so.rc_connect.argtypes = [address, address, POINTER(client)]
     so.rc_connect.restype  = status
@@ -149,6 +181,36 @@ def load_so():
                             POINTER(version)]
     so.rc_write.restype  = status
 
+    so.rc_multiRead.argtypes = [client, POINTER(MultiReadObject), count]
+    so.rc_multiRead.restype  = status
+
+    so.rc_multiRemove.argtypes = [client, POINTER(MultiRemoveObject), count]
+    so.rc_multiRemove.restype  = status
+
+    so.rc_multiWrite.argtypes = [client, POINTER(MultiWriteObject), count]
+    so.rc_multiWrite.restype  = status
+
+    so.rc_multiReadAsync.argtypes = [client, POINTER(MultiReadObject), count,
+                                     POINTER(async)]
+    so.rc_multiReadAsync.restype  = status
+
+    so.rc_multiRemoveAsync.argtypes = [client, POINTER(MultiRemoveObject),
+                                       count, POINTER(async)]
+    so.rc_multiRemoveAsync.restype  = status
+
+    so.rc_multiWriteAsync.argtypes = [client, POINTER(MultiWriteObject), count,
+                                      POINTER(async)]
+    so.rc_multiWriteAsync.restype  = status
+
+    so.rc_asyncIsReady.argtypes = [async]
+    so.rc_asyncIsReady.restype  = ctypes.c_int
+
+    so.rc_asyncWait.argtypes = [async]
+    so.rc_asyncWait.restype  = status
+
+    so.rc_asyncCancel.argtypes = [async]
+    so.rc_asyncCancel.restype  = None
+
     so.rc_testing_kill.argtypes = [client, table, key, keyLength]
     so.rc_testing_kill.restype  = status
 
@@ -323,6 +385,101 @@ class RAMCloud(object):
         self.handle_error(s, got_version.value)
         return got_version.value
 
+    def multi_read(self, table_id, ids, max_length=1024 * 1024):
+        """Read several objects with one call; returns a list holding a
+        (value, version) tuple for each id, or None if it doesn't exist."""
+        requests = (MultiReadObject * len(ids))()
+        bufs = []
+        for i, id in enumerate(ids):
+            buf = ctypes.create_string_buffer(max_length)
+            bufs.append(buf)
+            requests[i] = MultiReadObject(tableId=table_id, key=get_key(id),
+                                          keyLength=get_keyLength(id),
+                                          buf=ctypes.addressof(buf),
+                                          maxLength=max_length)
+        self.hook()
+        s = so.rc_multiRead(self.client, requests, len(ids))
+        self.handle_error(s)
+        return self._multi_read_results(requests, bufs)
+
+    def multi_read_async(self, table_id, ids, max_length=1024 * 1024):
+        """Start reading several objects; returns a MultiOp whose wait()
+        method returns the same result as multi_read."""
+        requests = (MultiReadObject * len(ids))()
+        bufs = []
+        for i, id in enumerate(ids):
+            buf = ctypes.create_string_buffer(max_length)
+            bufs.append(buf)
+            requests[i] = MultiReadObject(tableId=table_id, key=get_key(id),
+                                          keyLength=get_keyLength(id),
+                                          buf=ctypes.addressof(buf),
+                                          maxLength=max_length)
+        handle = ctypes.c_void_p()
+        self.hook()
+        s = so.rc_multiReadAsync(self.client, requests, len(ids),
+                                 ctypes.byref(handle))
+        self.handle_error(s)
+        return MultiOp(self, handle, (requests, bufs),
+                       lambda: self._multi_read_results(requests, bufs))
+
+    def _multi_read_results(self, requests, bufs):
+        results = []
+        for request, buf in itertools.izip(requests, bufs):
+            if request.status == 3:   # STATUS_OBJECT_DOESNT_EXIST
+                results.append(None)
+                continue
+            self.handle_error(request.status, request.version)
+            results.append((buf.raw[0:request.actualLength], request.version))
+        return results
+
+    def multi_remove(self, table_id, ids):
+        """Remove several objects with one call; returns a list holding the
+        version of each object just before it was removed."""
+        requests = (MultiRemoveObject * len(ids))()
+        for i, id in enumerate(ids):
+            requests[i] = MultiRemoveObject(tableId=table_id, key=get_key(id),
+                                            keyLength=get_keyLength(id))
+        self.hook()
+        s = so.rc_multiRemove(self.client, requests, len(ids))
+        self.handle_error(s)
+        return self._multi_results(requests)
+
+    def multi_write(self, table_id, items):
+        """Write several objects with one call; items is a list of
+        (id, data) pairs. Returns a list of the new versions."""
+        requests = (MultiWriteObject * len(items))()
+        for i, (id, data) in enumerate(items):
+            requests[i] = MultiWriteObject(tableId=table_id, key=get_key(id),
+                                           keyLength=get_keyLength(id),
+                                           buf=data, length=len(data))
+        self.hook()
+        s = so.rc_multiWrite(self.client, requests, len(items))
+        self.handle_error(s)
+        return self._multi_results(requests)
+
+    def multi_write_async(self, table_id, items):
+        """Start writing several objects; returns a MultiOp whose wait()
+        method returns the same result as multi_write."""
+        requests = (MultiWriteObject * len(items))()
+        data = []
+        for i, (id, value) in enumerate(items):
+            data.append(value)
+            requests[i] = MultiWriteObject(tableId=table_id, key=get_key(id),
+                                           keyLength=get_keyLength(id),
+                                           buf=value, length=len(value))
+        handle = ctypes.c_void_p()
+        self.hook()
+        s = so.rc_multiWriteAsync(self.client, requests, len(items),
+                                  ctypes.byref(handle))
+        self.handle_error(s)
+        return MultiOp(self, handle, (requests, data),
+                       lambda: self._multi_results(requests))
+
+    def _multi_results(self, requests):
+        for request in requests:
+            self.handle_error(request.status, request.version)
+        return [request.version for request in requests]
+
     def testing_kill(self, table_id, id):
         s = so.rc_testing_kill(self.client, table_id,
                                get_key(id), get_keyLength(id))
@@ -361,6 +518,28 @@ class RAMCloud(object):
     def set_log_file(self, path):
         so.rc_set_log_file(path)
 
+class MultiOp(object):
+    """An operation started by one of the RAMCloud.multi_*_async methods."""
+    def __init__(self, rc, handle, keepalive, results):
+        self.rc = rc
+        self.handle = handle
+        # The C library refers to these until the operation is finished.
+        self.keepalive = keepalive
+        self.results = results
+
+    def is_ready(self):
+        return so.rc_asyncIsReady(self.handle) != 0
+
+    def wait(self):
+        s = so.rc_asyncWait(self.handle)
+        self.handle = None
+        self.rc.handle_error(s)
+        return self.results()
+
+    def cancel(self):
+        so.rc_asyncCancel(self.handle)
+        self.handle = None
+
 def main():
     r = RAMCloud()
     r.connect()
@@ -204,6 +204,27 @@ def broadcast(name, options, cluster_args, client_args):
             (obj_path, flatten_args(client_args), name), **cluster_args)
     print(get_client_log(), end='')
 
+def latencyUnderLoad(name, options, cluster_args, client_args):
+    cluster_args['timeout'] = max(options.timeout, 100)
+    if 'num_clients' not in cluster_args:
+        cluster_args['num_clients'] = 4
+    if options.num_servers == None:
+        cluster_args['num_servers'] = 1
+    client_args['--numTables'] = cluster_args['num_servers']
+    client_args['--arrivals'] = options.arrivals
+    if options.max_outstanding != None:
+        client_args['--maxOutstanding'] = options.max_outstanding
+    if options.num_objects != None:
+        client_args['--numObjects'] = options.num_objects
+    if options.target_rate != None:
+        client_args['--targetRate'] = options.target_rate
+    if options.write_fraction != None:
+        client_args['--writeFraction'] = options.write_fraction
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name),
+            master_args='--masterServiceThreads 4', **cluster_args)
+    print(get_client_log(), end='')
+
 def multiOp(name, options, cluster_args, client_args):
     cluster_args['timeout'] = 100
     if options.num_servers == None:
@@ -275,6 +296,24 @@ def readRandom(name, options, cluster_args, client_args):
             (obj_path, flatten_args(client_args), name), master_args='--masterServiceThreads 4', **cluster_args)
     print(get_client_log(), end='')
 
+def ycsb(name, options, cluster_args, client_args):
+    cluster_args['timeout'] = max(options.timeout, 100)
+    if 'num_clients' not in cluster_args:
+        cluster_args['num_clients'] = 4
+    if options.num_servers == None:
+        cluster_args['num_servers'] = len(hosts)
+    client_args['--numTables'] = cluster_args['num_servers']
+    client_args['--workload'] = options.workload
+    if options.distribution != None:
+        client_args['--distribution'] = options.distribution
+    if options.num_objects != None:
+        client_args['--numObjects'] = options.num_objects
+    if options.target_rate != None:
+        client_args['--targetRate'] = options.target_rate
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
 #-------------------------------------------------------------------
 #  End of driver functions.
 #-------------------------------------------------------------------
@@ -293,9 +332,11 @@ simple_tests = [
     Test("readAllToAll", readAllToAll),
     Test("readNotFound", default),
     Test("writeAsyncSync", default),
+    Test("ycsb", ycsb),
 ]
 
 graph_tests = [
+    Test("latencyUnderLoad", latencyUnderLoad),
     Test("multiWrite_oneMaster", multiOp),
     Test("multiRead_oneMaster", multiOp),
     Test("multiRead_oneObjectPerMaster", multiOp),
@@ -315,6 +356,10 @@ if __name__ == '__main__':
             'all options are used by all benchmarks.',
             usage='%prog [options] test test ...',
             conflict_handler='resolve')
+    parser.add_option('--arrivals', default='poisson',
+            choices=['poisson', 'constant'],
+            help='Spacing of operations issued at a given rate '
+                 '(latencyUnderLoad)')
     parser.add_option('-n', '--clients', type=int,
             metavar='N', dest='num_clients',
             help='Number of instances of the client application '
@@ -325,6 +370,10 @@ if __name__ == '__main__':
     parser.add_option('--disjunct', action='store_true', default=False,
             metavar='True/False',
             help='Disjunct (not collocate) entities on a server')
+    parser.add_option('--distribution',
+            choices=['zipfian', 'latest', 'uniform'],
+            help='Request distribution for ycsb (default: the '
+                 "workload's standard distribution)")
     parser.add_option('--debug', action='store_true', default=False,
             help='Pause after starting servers but before running '
                  'clients to enable debugging setup')
@@ -343,6 +392,13 @@ if __name__ == '__main__':
     parser.add_option('-r', '--replicas', type=int, default=3,
             metavar='N',
             help='Number of disk backup copies for each segment')
+    parser.add_option('--maxOutstanding', type=int,
+            metavar='N', dest='max_outstanding',
+            help='Most asynchronous RPCs each client keeps in progress '
+                 '(latencyUnderLoad)')
+    parser.add_option('--numObjects', type=int,
+            metavar='N', dest='num_objects',
+            help='Number of objects to load before measuring (ycsb)')
     parser.add_option('--servers', type=int,
             metavar='N', dest='num_servers',
             help='Number of hosts on which to run servers')
@@ -352,6 +408,12 @@ if __name__ == '__main__':
             metavar='SECS',
             help="Abort if the client application doesn't finish within "
                  'SECS seconds')
+    parser.add_option('--targetRate', type=float,
+            metavar='OPS', dest='target_rate',
+            help='Operations per second issued by each client, '
+                 'regardless of completions (ycsb; default: issue '
+                 'each operation when the previous one completes), or '
+                 'the first rate measured (latencyUnderLoad)')
     parser.add_option('-T', '--transport', default='infrc',
             help='Transport to use for communication with servers')
     parser.add_option('-v', '--verbose', action='store_true', default=False,
@@ -359,6 +421,13 @@ if __name__ == '__main__':
     parser.add_option('-w', '--warmup', type=int,
             help='Number of times to execute operating before '
             'starting measurements')
+    parser.add_option('--writeFraction', type=float,
+            metavar='F', dest='write_fraction',
+            help='Fraction of operations that are writes '
+                 '(latencyUnderLoad)')
+    parser.add_option('--workload', default='A',
+            choices=['A', 'B', 'C', 'D', 'E', 'F'],
+            help='YCSB core workload to run (ycsb)')
     (options, args) = parser.parse_args()
 
     # Invoke the requested tests (run all of them if no tests were specified)
@@ -330,6 +330,39 @@ for phase in ("counts", "ticks"):
             else:
                 rpc.metric('rpc%dTicks' % i, 'time spent executing RPC %d (undefined)' % i)
 
+# Totals over all opcodes of the time incoming RPCs spend in each stage of
+# their life on the server; ServiceManager::getRpcStageMetrics has the full
+# distributions for each opcode.
+rpcStage = Group('RpcStage',
+    'time incoming RPCs spent in each ServiceManager::RpcStage')
+rpcStage.metric('count', 'number of RPCs whose stages were recorded')
+rpcStage.metric('receiveTicks',
+    'time from the transport creating RPCs until their requests were complete')
+rpcStage.metric('queueTicks',
+    'time RPCs waited for a worker thread under concurrency limits')
+rpcStage.metric('handoffTicks',
+    'time from handing RPCs to worker threads until the workers started')
+rpcStage.metric('executeTicks', 'time worker threads spent executing RPCs')
+rpcStage.metric('lookupTicks',
+    'time worker threads spent looking up objects in ObjectManager')
+rpcStage.metric('syncTicks',
+    'time worker threads spent waiting for replication to backups')
+rpcStage.metric('replyTicks',
+    'time from replies being ready until transports accepted them')
+
+slabAllocator = Group('SlabAllocator',
+    'metrics for the SlabAllocator used for RPC and Buffer objects')
+slabAllocator.metric('allocCount',
+    'number of blocks allocated (updated in batches by each thread)')
+slabAllocator.metric('depotAllocCount',
+    'number of full magazines threads took from the depot')
+slabAllocator.metric('depotFreeCount',
+    'number of full magazines threads gave to the depot')
+slabAllocator.metric('slabCount', 'number of slabs allocated from malloc')
+slabAllocator.metric('slabBytes', 'total bytes in slabs')
+slabAllocator.metric('largeAllocCount',
+    'number of requests too large for a size class, passed to malloc')
+
 transmit = Group('Transmit', 'metrics related to transmitting messages')
 transmit.metric('ticks', 'elapsed time transmitting messages')
 transmit.metric('messageCount', 'number of messages transmitted')
@@ -337,6 +370,8 @@ transmit.metric('packetCount', 'number of packets transmitted')
 transmit.metric('iovecCount', 'number of Buffer chunks transmitted')
 transmit.metric('byteCount', 'number of bytes transmitted')
 transmit.metric('copyTicks', 'elapsed time copying messages')
+transmit.metric('copyByteCount',
+    'number of bytes copied into transmit buffers rather than sent in place')
 transmit.metric('dmaTicks', 'elapsed time waiting for DMA to HCA')
 
 receive = Group('Receive', 'metrics related to receiving messages')
@@ -377,6 +412,8 @@ definitions.group(coordinator);
 definitions.group(master);
 definitions.group(backup);
 definitions.group(rpc);
+definitions.group(rpcStage);
+definitions.group(slabAllocator);
 definitions.group(transport);
 definitions.group(temp);
 definitions.group(serviceManager);
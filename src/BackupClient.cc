@@ -634,6 +634,12 @@ BackupClient::writeSegment(Context* context,
  *      Whether this particular replica should be loaded and filtered at the
  *      start of master recovery (as opposed to having it loaded and filtered
  *      on demand. May be reset on each subsequent write.
+ * \param compressedImage
+ *      If non-NULL, the replica is stored as this compressed image of the
+ *      segment (see SegmentCompressor) and \a offset and \a length refer to
+ *      the image rather than to \a segment, which should be NULL. The
+ *      image must be written from offset 0 and \a certificate must still
+ *      describe the uncompressed segment.
  */
 WriteSegmentRpc::WriteSegmentRpc(Context* context,
                                  ServerId backupId,
@@ -646,7 +652,8 @@ WriteSegmentRpc::WriteSegmentRpc(Context* context,
                                  const Segment::Certificate* certificate,
                                  bool open,
                                  bool close,
-                                 bool primary)
+                                 bool primary,
+                                 const void* compressedImage)
     : ServerIdRpcWrapper(context, backupId,
                          sizeof(WireFormat::BackupWrite::Response))
 {
@@ -665,8 +672,13 @@ WriteSegmentRpc::WriteSegmentRpc(Context* context,
     reqHdr->open = open;
     reqHdr->close = close;
     reqHdr->primary = primary;
-    if (segment)
+    reqHdr->compressed = (compressedImage != NULL);
+    if (compressedImage) {
+        request.append(
+            static_cast<const uint8_t*>(compressedImage) + offset, length);
+    } else if (segment) {
         segment->appendToBuffer(request, offset, length);
+    }
     CycleCounter<RawMetric> _(&metrics->master.replicationPostingWriteRpcTicks);
     send();
 }
@@ -208,7 +208,8 @@ class WriteSegmentRpc : public ServerIdRpcWrapper {
                     uint64_t segmentId, uint64_t segmentEpoch,
                     const Segment* segment, uint32_t offset, uint32_t length,
                     const Segment::Certificate* certificate,
-                    bool open, bool close, bool primary);
+                    bool open, bool close, bool primary,
+                    const void* compressedImage = NULL);
     ~WriteSegmentRpc() {}
     void wait();
 
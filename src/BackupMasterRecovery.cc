@@ -17,6 +17,7 @@
 #include "BackupService.h"
 #include "Object.h"
 #include "RecoverySegmentBuilder.h"
+#include "SegmentCompressor.h"
 #include "ShortMacros.h"
 
 namespace RAMCloud {
@@ -532,8 +533,18 @@ BackupMasterRecovery::buildRecoverySegments(Replica& replica)
     CycleCounter<RawMetric> _(&metrics->backup.filterTicks);
 
     std::unique_ptr<Segment[]> recoverySegments(new Segment[numPartitions]);
+    std::unique_ptr<uint8_t[]> decompressedData;
     uint64_t start = Cycles::rdtsc();
     try {
+        if (replica.metadata->compressed) {
+            // The certificate covers the decompressed segment, so a corrupt
+            // image is caught either here or while building.
+            decompressedData.reset(new uint8_t[segmentSize]);
+            SegmentCompressor::decompress(replicaData, segmentSize,
+                                          decompressedData.get(),
+                                          segmentSize);
+            replicaData = decompressedData.get();
+        }
         if (!testingSkipBuild) {
             assert(partitions);
             RecoverySegmentBuilder::build(replicaData, segmentSize,
@@ -543,7 +554,8 @@ BackupMasterRecovery::buildRecoverySegments(Replica& replica)
                                           recoverySegments.get());
         }
     } catch (const Exception& e) {
-        // Can throw SegmentIteratorException or SegmentRecoveryFailedException.
+        // Can throw SegmentIteratorException, SegmentRecoveryFailedException,
+        // or SegmentCompressorException.
         // Exception is a little broad, but it catches them both; hopefully we
         // don't try to recover from anything else too serious.
         LOG(NOTICE, "Couldn't build recovery segments for <%s,%lu>: %s",
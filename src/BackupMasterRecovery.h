@@ -341,7 +341,8 @@ class BackupReplicaMetadata {
                           uint32_t segmentCapacity,
                           uint64_t segmentEpoch,
                           bool closed,
-                          bool primary)
+                          bool primary,
+                          bool compressed = false)
         : certificate(certificate)
         , logId(logId)
         , segmentId(segmentId)
@@ -350,11 +351,9 @@ class BackupReplicaMetadata {
         , closed(closed)
         , primary(primary)
         , checksum()
+        , compressed(compressed)
     {
-        Crc32C calculatedChecksum;
-        calculatedChecksum.update(this, static_cast<unsigned>
-                                  (sizeof(*this) - sizeof(checksum)));
-        checksum = calculatedChecksum.getResult();
+        checksum = computeChecksum();
     }
 
     /**
@@ -365,10 +364,7 @@ class BackupReplicaMetadata {
      * loaded from storage.
      */
     bool checkIntegrity() const {
-        Crc32C calculatedChecksum;
-        calculatedChecksum.update(this, static_cast<unsigned>
-                                  (sizeof(*this) - sizeof(checksum)));
-        return calculatedChecksum.getResult() == checksum;
+        return computeChecksum() == checksum;
     }
 
     /**
@@ -431,15 +427,44 @@ class BackupReplicaMetadata {
 
   PRIVATE:
     /**
-     * Checksum of all the above fields. Must come last in the class.
+     * Checksum of all the above fields, and of #compressed if it is set.
      * Populated on construction; can be checked with checkIntegrity().
      * Protects the fields of this structure from corruption on/by
      * storage.
      */
     Crc32C::ResultType checksum;
+
+  PUBLIC:
+    /**
+     * Whether the replica is stored as a compressed image of the segment
+     * (see SegmentCompressor) rather than as the segment itself.
+     * #certificate describes the segment once decompressed. Only ever set
+     * for closed replicas.
+     *
+     * This comes after #checksum so that the fields before it keep the
+     * layout older backups wrote. Storage zeroes unused metadata space, so
+     * their metadata reads back as an uncompressed replica, and since the
+     * flag is only checksummed when set, its checksum still matches. Older
+     * backups, in turn, reject compressed replicas they couldn't read.
+     */
+    bool compressed;
+
+  PRIVATE:
+    /**
+     * Compute the checksum stored in #checksum.
+     */
+    Crc32C::ResultType computeChecksum() const {
+        Crc32C calculatedChecksum;
+        calculatedChecksum.update(this, static_cast<unsigned>
+                                  (sizeof(*this) - sizeof(checksum) -
+                                   sizeof(compressed)));
+        if (compressed)
+            calculatedChecksum.update(&compressed, sizeof(compressed));
+        return calculatedChecksum.getResult();
+    }
 } __attribute__((packed));
 // Substitute for std::is_trivially_copyable until we have real C++11.
-static_assert(sizeof(BackupReplicaMetadata) == 42,
+static_assert(sizeof(BackupReplicaMetadata) == 43,
               "Unexpected padding in BackupReplicaMetadata");
 
 } // namespace RAMCloud
@@ -59,14 +59,14 @@ struct BackupMasterRecoveryTest : public ::testing::Test {
     void
     mockMetadata(uint64_t segmentId,
                  bool closed = true, bool primary = false,
-                 bool screwItUp = false)
+                 bool screwItUp = false, bool compressed = false)
     {
         frames.emplace_back(storage.open(true));
         Segment::Certificate certificate;
         uint32_t epoch = downCast<uint32_t>(segmentId) + 100;
         BackupReplicaMetadata metadata(certificate, crashedMasterId.getId(),
                                        segmentId, 1024, epoch,
-                                       closed, primary);
+                                       closed, primary, compressed);
         if (screwItUp)
             metadata.checksum = 0;
         frames.back()->append(source, 0, 0, 0, &metadata, sizeof(metadata));
@@ -373,4 +373,48 @@ TEST_F(BackupMasterRecoveryTest, buildRecoverySegments_buildThrows) {
     EXPECT_TRUE(recovery->replicas.at(0).built);
 }
 
+TEST_F(BackupMasterRecoveryTest, buildRecoverySegments_decompressThrows) {
+    mockMetadata(88, true, true, false, true);
+    recovery->start(frames, NULL, NULL);
+    recovery->setPartitionsAndSchedule(partitions);
+    TestLog::Enable _(buildRecoverySegmentsFilter);
+    taskQueue.performTask();
+    EXPECT_TRUE(StringUtil::startsWith(TestLog::get(),
+        "buildRecoverySegments: Couldn't build recovery segments for "
+        "<99.0,88>: RAMCloud::SegmentCompressorException: image too short"));
+    EXPECT_TRUE(recovery->replicas.at(0).recoveryException);
+    EXPECT_FALSE(recovery->replicas.at(0).recoverySegments);
+    EXPECT_TRUE(recovery->replicas.at(0).built);
+}
+
+TEST_F(BackupMasterRecoveryTest, replicaMetadata_olderLayout) {
+    // Metadata written before the compressed flag existed: the same fields
+    // and checksum, then the zeroes storage fills unused space with.
+    Segment::Certificate certificate;
+    BackupReplicaMetadata metadata(certificate, 1, 2, 1024, 3, true, false);
+    const uint32_t fieldsLength = sizeof32(metadata) -
+            sizeof32(Crc32C::ResultType) - sizeof32(metadata.compressed);
+    char older[sizeof(metadata)];
+    memset(older, 0, sizeof(older));
+    memcpy(older, &metadata, fieldsLength);
+    Crc32C olderChecksum;
+    olderChecksum.update(older, fieldsLength);
+    Crc32C::ResultType checksum = olderChecksum.getResult();
+    memcpy(older + fieldsLength, &checksum, sizeof(checksum));
+    const BackupReplicaMetadata* loaded =
+            reinterpret_cast<const BackupReplicaMetadata*>(older);
+    EXPECT_TRUE(loaded->checkIntegrity());
+    EXPECT_FALSE(loaded->compressed);
+    EXPECT_EQ(2U, loaded->segmentId);
+
+    // The flag is protected once set, and older backups (which only
+    // checksum the fields before it) reject compressed replicas.
+    BackupReplicaMetadata compressed(certificate, 1, 2, 1024, 3, true, false,
+                                     true);
+    EXPECT_TRUE(compressed.checkIntegrity());
+    EXPECT_NE(checksum, compressed.checksum);
+    compressed.compressed = false;
+    EXPECT_FALSE(compressed.checkIntegrity());
+}
+
 } // namespace RAMCloud
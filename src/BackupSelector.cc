@@ -38,6 +38,51 @@ BackupStats::getExpectedReadMs() {
            1024 / 1024 / expectedReadMBytesPerSec);
 }
 
+/**
+ * Return the expected number of microseconds before a new write rpc sent
+ * to the backup would complete. This is the recently observed latency of
+ * write rpcs to the backup plus the time its disk would need to absorb all
+ * of the data this master already has in flight to it.
+ */
+uint64_t
+BackupStats::getExpectedWriteUs()
+{
+    uint64_t latencyUs = writeLatencyUs;
+    if (writeRpcsInFlight == 0 && lastWriteLatencyTicks != 0 &&
+        Cycles::toNanoseconds(Cycles::rdtsc() - lastWriteLatencyTicks) >
+            uint64_t(WRITE_LATENCY_EXPIRY_MS) * 1000 * 1000) {
+        latencyUs = 0;
+    }
+
+    uint64_t queuedUs = 0;
+    if (expectedReadMBytesPerSec != 0) {
+        queuedUs = bytesInFlight * 1000 * 1000 /
+                   (uint64_t(expectedReadMBytesPerSec) * 1024 * 1024);
+    }
+    return latencyUs + queuedUs;
+}
+
+/**
+ * Fold the latency of a completed write rpc to the backup into
+ * #writeLatencyUs. The average gives each new sample a weight of 1/8, which
+ * smooths out noise while still reacting to a backup becoming overloaded
+ * within a handful of rpcs.
+ *
+ * \param latencyTicks
+ *      Time in Cycles::rdtsc() ticks between sending the write rpc and
+ *      noticing its completion.
+ */
+void
+BackupStats::recordWriteLatency(uint64_t latencyTicks)
+{
+    uint64_t latencyUs = Cycles::toMicroseconds(latencyTicks);
+    if (lastWriteLatencyTicks == 0)
+        writeLatencyUs = latencyUs;
+    else
+        writeLatencyUs = (writeLatencyUs * 7 + latencyUs) / 8;
+    lastWriteLatencyTicks = Cycles::rdtsc();
+}
+
 // --- BackupSelector ---
 
 /**
@@ -151,6 +196,54 @@ BackupSelector::signalFreedPrimary(const ServerId backupId)
     --stats->primaryReplicaCount;
 }
 
+/**
+ * Inform the BackupSelector that a write rpc carrying \a bytes of replica
+ * data has been sent to a backup. Used to track how much load this master
+ * is placing on each backup.
+ * \param backupId
+ *      The ServerId of the backup the write rpc was sent to.
+ * \param bytes
+ *      Number of bytes of segment data carried by the rpc.
+ */
+void
+BackupSelector::signalWriteStarted(const ServerId backupId, uint32_t bytes)
+{
+    BackupStats* stats = findStats(backupId);
+    if (stats == NULL)
+        return;
+    stats->bytesInFlight += bytes;
+    ++stats->writeRpcsInFlight;
+}
+
+/**
+ * Inform the BackupSelector that a write rpc previously passed to
+ * signalWriteStarted() has completed (successfully or not) or has been
+ * abandoned.
+ * \param backupId
+ *      The ServerId of the backup the write rpc was sent to.
+ * \param bytes
+ *      Number of bytes of segment data carried by the rpc; must match the
+ *      value passed to signalWriteStarted().
+ * \param latencyTicks
+ *      Time in Cycles::rdtsc() ticks the rpc took to complete. 0 means the
+ *      rpc was canceled and no latency sample should be recorded.
+ */
+void
+BackupSelector::signalWriteFinished(const ServerId backupId, uint32_t bytes,
+                                    uint64_t latencyTicks)
+{
+    BackupStats* stats = findStats(backupId);
+    if (stats == NULL)
+        return;
+    // The stats may have been recreated while the rpc was outstanding if the
+    // backup was removed and re-added; don't let the counts wrap.
+    stats->bytesInFlight -= std::min(stats->bytesInFlight, uint64_t(bytes));
+    if (stats->writeRpcsInFlight > 0)
+        --stats->writeRpcsInFlight;
+    if (latencyTicks != 0)
+        stats->recordWriteLatency(latencyTicks);
+}
+
 // - private -
 
 /**
@@ -196,6 +289,21 @@ BackupSelector::applyTrackerChanges()
     }
 }
 
+/**
+ * Return the BackupStats for a backup, or NULL if the backup is no longer in
+ * #tracker (for example, because it crashed while a write rpc to it was
+ * outstanding).
+ */
+BackupStats*
+BackupSelector::findStats(const ServerId backupId)
+{
+    try {
+        return tracker[backupId];
+    } catch (const Exception& e) {
+        return NULL;
+    }
+}
+
 /**
  * Return whether it is unwise to place a replica on \a backup given
  * that a replica exists on backup \a otherBackupId.
@@ -25,17 +25,32 @@ namespace RAMCloud {
 /**
  * Tracks speed of backups and count of replicas stored on each which is
  * used to balance placement of replicas across the cluster. Also keeps track
- * of the replication group Ids of the backups. Stored for backup
- * in a BackupTracker.
+ * of the replication group Ids of the backups and of the replication load
+ * this master is placing on each of them. Stored for backup in a
+ * BackupTracker.
  */
 struct BackupStats {
     BackupStats()
         : primaryReplicaCount(0)
         , expectedReadMBytesPerSec(0)
         , replicationId(0)
+        , bytesInFlight(0)
+        , writeRpcsInFlight(0)
+        , writeLatencyUs(0)
+        , lastWriteLatencyTicks(0)
     {}
 
     uint32_t getExpectedReadMs();
+    uint64_t getExpectedWriteUs();
+    void recordWriteLatency(uint64_t latencyTicks);
+
+    /**
+     * Latency samples older than this are ignored by getExpectedWriteUs()
+     * if no writes are outstanding to the backup. Otherwise a backup which
+     * was slow once would never be chosen again and so would never get a
+     * chance to show that it has recovered.
+     */
+    static const uint32_t WRITE_LATENCY_EXPIRY_MS = 1000;
 
     /// Number of primary replicas this master has stored on the backup.
     uint32_t primaryReplicaCount;
@@ -45,6 +60,21 @@ struct BackupStats {
 
     /// Replication group Id of the backup.
     uint64_t replicationId;
+
+    /// Bytes this master has sent to the backup in write rpcs which have not
+    /// completed yet.
+    uint64_t bytesInFlight;
+
+    /// Number of write rpcs this master has outstanding to the backup.
+    uint32_t writeRpcsInFlight;
+
+    /// Exponentially weighted moving average of the latency of write rpcs
+    /// this master has sent to the backup, in microseconds.
+    uint64_t writeLatencyUs;
+
+    /// Cycles::rdtsc() when #writeLatencyUs was last updated; 0 if no write
+    /// rpc to the backup has completed yet.
+    uint64_t lastWriteLatencyTicks;
 };
 
 /// Tracks BackupStats; a ReplicaManager processes ServerListChanges.
@@ -60,6 +90,11 @@ class BaseBackupSelector {
     virtual ServerId selectSecondary(uint32_t numBackups,
                                      const ServerId backupIds[]) = 0;
     virtual void signalFreedPrimary(const ServerId backupId) = 0;
+    virtual void signalWriteStarted(const ServerId backupId,
+                                    uint32_t bytes) = 0;
+    virtual void signalWriteFinished(const ServerId backupId,
+                                     uint32_t bytes,
+                                     uint64_t latencyTicks) = 0;
     virtual ~BaseBackupSelector() {}
 };
 
@@ -77,9 +112,13 @@ class BackupSelector : public BaseBackupSelector {
     virtual ServerId selectSecondary(uint32_t numBackups,
                                      const ServerId backupIds[]);
     void signalFreedPrimary(const ServerId backupId);
+    void signalWriteStarted(const ServerId backupId, uint32_t bytes);
+    void signalWriteFinished(const ServerId backupId, uint32_t bytes,
+                             uint64_t latencyTicks);
 
   PROTECTED:
     void applyTrackerChanges();
+    BackupStats* findStats(const ServerId backupId);
     bool conflictWithAny(const ServerId backupId,
                          uint32_t numBackups,
                          const ServerId backupIds[]) const;
@@ -0,0 +1,289 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file
+ * A simulator that compares the replication write latency obtained with
+ * different BackupSelectors. A set of masters each replicate a stream of
+ * writes to the backups their selector chooses for each segment. Each backup
+ * is modeled as a disk with a fixed bandwidth that services writes from all
+ * masters in FIFO order; a few backups are much slower than the rest (as if
+ * they were busy with other work). Each master's selector is fed the same
+ * write start/finish notifications ReplicatedSegment would give it.
+ *
+ * Simulated time is independent of real time, so latency samples never
+ * expire during a run (see BackupStats::WRITE_LATENCY_EXPIRY_MS).
+ */
+
+#include <algorithm>
+#include <queue>
+
+#include "Common.h"
+#include "Context.h"
+#include "Cycles.h"
+#include "LoadAwareBackupSelector.h"
+#include "Logger.h"
+#include "ServerList.h"
+#include "ServiceMask.h"
+
+namespace RAMCloud {
+
+class BackupSelectorBenchmark {
+  public:
+    /// Number of backups in the simulated cluster.
+    static const uint32_t NUM_BACKUPS = 30;
+
+    /// Number of backups that are slowed down.
+    static const uint32_t NUM_SLOW_BACKUPS = 3;
+
+    /// Number of masters replicating concurrently.
+    static const uint32_t NUM_MASTERS = 10;
+
+    /// Replication factor.
+    static const uint32_t NUM_REPLICAS = 3;
+
+    /// Disk bandwidth of normal backups in MB/s.
+    static const uint32_t DISK_MBYTES_PER_SEC = 100;
+
+    /// Disk bandwidth of slow backups in MB/s.
+    static const uint32_t SLOW_DISK_MBYTES_PER_SEC = 10;
+
+    /// One-way network delay added to every write, in microseconds.
+    static const uint64_t NETWORK_US = 5;
+
+    /// Bytes of log data carried by each write rpc.
+    static const uint32_t WRITE_BYTES = 16 * 1024;
+
+    /// Bytes in each segment; new backups are chosen for every segment.
+    static const uint32_t SEGMENT_BYTES = 8 * 1024 * 1024;
+
+    /// Interval between writes issued by each master, in microseconds.
+    static const uint64_t WRITE_INTERVAL_US = 500;
+
+    /**
+     * A write rpc in flight from a master to a backup.
+     */
+    struct Write {
+        /// Simulated time at which the backup finishes the write.
+        uint64_t finishUs;
+
+        /// Simulated time at which the write was issued.
+        uint64_t startUs;
+
+        /// Backup the write was sent to.
+        ServerId backupId;
+
+        bool operator>(const Write& other) const
+        {
+            return finishUs > other.finishUs;
+        }
+    };
+    typedef std::priority_queue<Write, vector<Write>,
+                                std::greater<Write>> WriteQueue;
+
+    /**
+     * State of one simulated master.
+     */
+    struct Master {
+        Master()
+            : serverId()
+            , selector()
+            , replicas()
+            , segmentBytes(SEGMENT_BYTES)
+            , inFlight()
+        {}
+
+        ServerId serverId;
+        std::unique_ptr<BackupSelector> selector;
+
+        /// Backups storing the replicas of this master's head segment.
+        ServerId replicas[NUM_REPLICAS];
+
+        /// Bytes written to the head segment so far.
+        uint32_t segmentBytes;
+
+        /// Writes this master has outstanding to backups.
+        WriteQueue inFlight;
+    };
+
+    Context context;
+    ServerList serverList;
+
+    /// Simulated time at which each backup's disk becomes idle, indexed by
+    /// the index number of the backup's ServerId.
+    uint64_t diskIdleUs[NUM_BACKUPS + 1];
+
+    /// Disk bandwidth of each backup in bytes per microsecond.
+    double diskBytesPerUs[NUM_BACKUPS + 1];
+
+    BackupSelectorBenchmark()
+        : context()
+        , serverList(&context)
+        , diskIdleUs()
+        , diskBytesPerUs()
+    {
+        Logger::get().setLogLevels(WARNING);
+        ProtoBuf::ServerList list;
+        for (uint32_t i = 1; i <= NUM_BACKUPS; i++) {
+            ProtoBuf::ServerList_Entry& entry(*list.add_server());
+            entry.set_services(
+                ServiceMask{WireFormat::BACKUP_SERVICE}.serialize());
+            entry.set_server_id(ServerId(i, 0).getId());
+            entry.set_service_locator(format("mock:host=backup%u", i));
+            entry.set_expected_read_mbytes_per_sec(DISK_MBYTES_PER_SEC);
+            entry.set_status(uint32_t(ServerStatus::UP));
+            // Backups are in replication groups of three, in order.
+            entry.set_replication_id((i + 2) / 3);
+
+            uint32_t mbytesPerSec = DISK_MBYTES_PER_SEC;
+            if (i % (NUM_BACKUPS / NUM_SLOW_BACKUPS) == 0)
+                mbytesPerSec = SLOW_DISK_MBYTES_PER_SEC;
+            diskBytesPerUs[i] = mbytesPerSec * 1024. * 1024. / 1e6;
+        }
+        list.set_version_number(1);
+        list.set_type(ProtoBuf::ServerList_Type_FULL_LIST);
+        serverList.applyServerList(list);
+    }
+
+    /**
+     * Choose backups for a master's next head segment.
+     */
+    void
+    openSegment(Master& master)
+    {
+        master.replicas[0] = master.selector->selectPrimary(0, NULL);
+        for (uint32_t i = 1; i < NUM_REPLICAS; i++) {
+            master.replicas[i] = master.selector->selectSecondary(
+                    i, master.replicas);
+        }
+        for (uint32_t i = 0; i < NUM_REPLICAS; i++) {
+            if (!master.replicas[i].isValid())
+                DIE("Selector couldn't find a backup for replica %u", i);
+        }
+        master.segmentBytes = 0;
+    }
+
+    /**
+     * Report all writes that have finished by \a nowUs to the master's
+     * selector.
+     */
+    void
+    reapWrites(Master& master, uint64_t nowUs)
+    {
+        while (!master.inFlight.empty() &&
+               master.inFlight.top().finishUs <= nowUs) {
+            const Write& write = master.inFlight.top();
+            master.selector->signalWriteFinished(write.backupId, WRITE_BYTES,
+                Cycles::fromNanoseconds(
+                    (write.finishUs - write.startUs) * 1000));
+            master.inFlight.pop();
+        }
+    }
+
+    /**
+     * Simulate one write from a master to all of its replicas and return
+     * the time until the write is durable on all of them.
+     */
+    uint64_t
+    issueWrite(Master& master, uint64_t nowUs)
+    {
+        if (master.segmentBytes + WRITE_BYTES > SEGMENT_BYTES)
+            openSegment(master);
+        master.segmentBytes += WRITE_BYTES;
+
+        uint64_t latencyUs = 0;
+        foreach (ServerId backupId, master.replicas) {
+            uint32_t index = backupId.indexNumber();
+            uint64_t arrivalUs = nowUs + NETWORK_US;
+            uint64_t startUs = std::max(arrivalUs, diskIdleUs[index]);
+            diskIdleUs[index] = startUs +
+                uint64_t(WRITE_BYTES / diskBytesPerUs[index]);
+            uint64_t finishUs = diskIdleUs[index] + NETWORK_US;
+            latencyUs = std::max(latencyUs, finishUs - nowUs);
+
+            master.selector->signalWriteStarted(backupId, WRITE_BYTES);
+            master.inFlight.push({finishUs, nowUs, backupId});
+        }
+        return latencyUs;
+    }
+
+    /**
+     * Run the simulation with one selector per master.
+     *
+     * \param name
+     *      Name of the selector configuration to print with the results.
+     * \param loadAware
+     *      If true use LoadAwareBackupSelectors, otherwise BackupSelectors.
+     * \param useMinCopysets
+     *      Passed to LoadAwareBackupSelector.
+     * \param numWrites
+     *      Number of writes each master issues.
+     */
+    void
+    run(const char* name, bool loadAware, bool useMinCopysets,
+        uint32_t numWrites)
+    {
+        std::fill(diskIdleUs, diskIdleUs + NUM_BACKUPS + 1, 0);
+        Master masters[NUM_MASTERS];
+        for (uint32_t i = 0; i < NUM_MASTERS; i++) {
+            masters[i].serverId = ServerId(1000 + i, 0);
+            if (loadAware) {
+                masters[i].selector.reset(new LoadAwareBackupSelector(
+                    &context, &masters[i].serverId, NUM_REPLICAS,
+                    useMinCopysets));
+            } else {
+                masters[i].selector.reset(new BackupSelector(
+                    &context, &masters[i].serverId, NUM_REPLICAS));
+            }
+        }
+
+        vector<uint64_t> latencies;
+        latencies.reserve(numWrites * NUM_MASTERS);
+        for (uint32_t w = 0; w < numWrites; w++) {
+            for (uint32_t m = 0; m < NUM_MASTERS; m++) {
+                // Stagger the masters' writes evenly.
+                uint64_t nowUs = w * WRITE_INTERVAL_US +
+                                 m * WRITE_INTERVAL_US / NUM_MASTERS;
+                reapWrites(masters[m], nowUs);
+                latencies.push_back(issueWrite(masters[m], nowUs));
+            }
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        uint64_t sum = 0;
+        foreach (uint64_t latency, latencies)
+            sum += latency;
+        size_t count = latencies.size();
+        printf("%-28s mean %8lu us  median %8lu us  99%% %8lu us  "
+               "99.9%% %8lu us  max %8lu us\n", name, sum / count,
+               latencies[count / 2], latencies[count * 99 / 100],
+               latencies[count * 999 / 1000], latencies[count - 1]);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(BackupSelectorBenchmark);
+};
+
+}  // namespace RAMCloud
+
+int
+main()
+{
+    uint32_t numWrites = 20000;
+    RAMCloud::BackupSelectorBenchmark benchmark;
+    benchmark.run("BackupSelector", false, false, numWrites);
+    benchmark.run("LoadAwareBackupSelector", true, false, numWrites);
+    benchmark.run("LoadAware with MinCopysets", true, true, numWrites);
+    return 0;
+}
@@ -19,6 +19,7 @@
 
 #include "TestUtil.h"
 #include "Common.h"
+#include "Cycles.h"
 #include "MockCluster.h"
 #include "ServiceMask.h"
 #include "ShortMacros.h"
@@ -84,6 +85,37 @@ TEST_F(BackupSelectorTest, backupStats_getExpectedReadMs) {
     EXPECT_EQ(960u, stats.getExpectedReadMs());
 }
 
+TEST_F(BackupSelectorTest, backupStats_getExpectedWriteUs) {
+    BackupStats stats;
+    EXPECT_EQ(0u, stats.getExpectedWriteUs());
+
+    // 100 MB/s disk with 10 MB in flight: 100 ms queued.
+    stats.expectedReadMBytesPerSec = 100;
+    stats.bytesInFlight = 10 * 1024 * 1024;
+    stats.writeLatencyUs = 50;
+    stats.writeRpcsInFlight = 1;
+    stats.lastWriteLatencyTicks = 1;
+    EXPECT_EQ(100050u, stats.getExpectedWriteUs());
+
+    // Old latency samples are ignored once nothing is in flight.
+    stats.bytesInFlight = 0;
+    stats.writeRpcsInFlight = 0;
+    Cycles::mockTscValue = Cycles::fromNanoseconds(1000 * 1000 * 1000);
+    EXPECT_EQ(50u, stats.getExpectedWriteUs());
+    Cycles::mockTscValue = Cycles::fromNanoseconds(2000 * 1000 * 1000);
+    EXPECT_EQ(0u, stats.getExpectedWriteUs());
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(BackupSelectorTest, backupStats_recordWriteLatency) {
+    BackupStats stats;
+    stats.recordWriteLatency(Cycles::fromNanoseconds(800 * 1000));
+    EXPECT_EQ(800u, stats.writeLatencyUs);
+    EXPECT_NE(0u, stats.lastWriteLatencyTicks);
+    stats.recordWriteLatency(Cycles::fromNanoseconds(1600 * 1000));
+    EXPECT_EQ(900u, stats.writeLatencyUs);
+}
+
 struct BackgroundEnlistBackup {
     explicit BackgroundEnlistBackup(Context* context)
         : context(context) {}
@@ -250,6 +282,51 @@ TEST_F(BackupSelectorTest, signalFreedPrimary) {
     EXPECT_EQ(9u, stats->primaryReplicaCount);
 }
 
+TEST_F(BackupSelectorTest, signalWriteStarted) {
+    std::vector<ServerId> ids;
+    addEqualHosts(ids);
+    selector->applyTrackerChanges();
+
+    selector->signalWriteStarted(ids[0], 1000);
+    selector->signalWriteStarted(ids[0], 24);
+    BackupStats* stats = selector->tracker[ids[0]];
+    EXPECT_EQ(1024u, stats->bytesInFlight);
+    EXPECT_EQ(2u, stats->writeRpcsInFlight);
+
+    // Unknown backups are ignored.
+    selector->signalWriteStarted(ServerId(99, 0), 10);
+}
+
+TEST_F(BackupSelectorTest, signalWriteFinished) {
+    std::vector<ServerId> ids;
+    addEqualHosts(ids);
+    selector->applyTrackerChanges();
+
+    selector->signalWriteStarted(ids[0], 1000);
+    selector->signalWriteStarted(ids[0], 24);
+    BackupStats* stats = selector->tracker[ids[0]];
+
+    selector->signalWriteFinished(ids[0], 1000,
+                                  Cycles::fromNanoseconds(300 * 1000));
+    EXPECT_EQ(24u, stats->bytesInFlight);
+    EXPECT_EQ(1u, stats->writeRpcsInFlight);
+    EXPECT_EQ(300u, stats->writeLatencyUs);
+
+    // Canceled rpcs don't contribute a latency sample.
+    selector->signalWriteFinished(ids[0], 24, 0);
+    EXPECT_EQ(0u, stats->bytesInFlight);
+    EXPECT_EQ(0u, stats->writeRpcsInFlight);
+    EXPECT_EQ(300u, stats->writeLatencyUs);
+
+    // Counts don't wrap if the stats were reset while rpcs were in flight.
+    selector->signalWriteFinished(ids[0], 24, 0);
+    EXPECT_EQ(0u, stats->bytesInFlight);
+    EXPECT_EQ(0u, stats->writeRpcsInFlight);
+
+    // Unknown backups are ignored.
+    selector->signalWriteFinished(ServerId(99, 0), 10, 1);
+}
+
 #if 0
 // This test should run forever, hence why it is commented out.
 // Occasionally, when self-doubt mounts, it is worth running, though.
@@ -641,7 +641,8 @@ BackupService::writeSegment(const WireFormat::BackupWrite::Request* reqHdr,
                                masterId.getId(), segmentId,
                                segmentSize,
                                reqHdr->segmentEpoch,
-                               reqHdr->close, reqHdr->primary);
+                               reqHdr->close, reqHdr->primary,
+                               reqHdr->compressed);
         }
         frame->append(*rpc->requestPayload, sizeof(*reqHdr),
                       reqHdr->length, reqHdr->offset,
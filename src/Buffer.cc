@@ -18,6 +18,7 @@
 
 #include "Buffer.h"
 #include "Memory.h"
+#include "SlabAllocator.h"
 
 namespace RAMCloud {
 
@@ -34,7 +35,7 @@ static Syscall defaultSyscall;
 Syscall* Buffer::sys = &defaultSyscall;
 
 /**
- * Malloc and construct an Allocation.
+ * Allocate (from the SlabAllocator) and construct an Allocation.
  * \param[in] prependSize
  *      See constructor.
  * \param[in] totalSize
@@ -43,10 +44,22 @@ Syscall* Buffer::sys = &defaultSyscall;
 Buffer::Allocation*
 Buffer::Allocation::newAllocation(uint32_t prependSize, uint32_t totalSize) {
     totalSize = (totalSize + 7) & ~7U;
-    void* a = Memory::xmalloc(HERE, sizeof(Allocation) + totalSize);
+    void* a = SlabAllocator::alloc(sizeof(Allocation) + totalSize);
     return new(a) Allocation(prependSize, totalSize);
 }
 
+/**
+ * Destroy and free an Allocation created by #newAllocation().
+ * \param[in] allocation
+ *      The Allocation to free.
+ */
+void
+Buffer::Allocation::deleteAllocation(Allocation* allocation) {
+    size_t size = sizeof(Allocation) + allocation->totalSize;
+    allocation->~Allocation();
+    SlabAllocator::free(allocation, size);
+}
+
 /**
  * Constructor for Allocation.
  * The Allocation must be 8-byte aligned.
@@ -63,7 +76,8 @@ Buffer::Allocation::Allocation(uint32_t prependSize, uint32_t totalSize)
     : next(NULL),
       prependTop(prependSize),
       appendTop(prependSize),
-      chunkTop(totalSize) {
+      chunkTop(totalSize),
+      totalSize(totalSize) {
     assert((reinterpret_cast<uint64_t>(this) & 0x7) == 0);
     assert((totalSize & 0x7) == 0);
     assert(prependSize <= totalSize);
@@ -91,6 +105,7 @@ Buffer::Allocation::reset(uint32_t prependSize, uint32_t totalSize)
     prependTop = prependSize;
     appendTop = prependSize;
     chunkTop = totalSize;
+    this->totalSize = totalSize;
     assert((totalSize & 0x7) == 0);
     assert(prependSize <= totalSize);
 }
@@ -178,12 +193,12 @@ Buffer::reset() {
     { // free the list of allocations
         Allocation* current = allocations;
         // Skip the last allocation in the list (initialAllocationContainer's
-        // allocation) since it's not allocated with xmalloc.
+        // allocation) since it's not allocated with newAllocation.
         if (current != NULL) {
             while (current->next != NULL) {
                 Allocation* next;
                 next = current->next;
-                free(current);
+                Allocation::deleteAllocation(current);
                 current = next;
             }
         }
@@ -167,6 +167,7 @@ class Buffer {
       public:
         static Allocation* newAllocation(uint32_t prependSize,
                                          uint32_t totalSize);
+        static void deleteAllocation(Allocation* allocation);
         Allocation(uint32_t prependSize, uint32_t totalSize);
         ~Allocation();
 
@@ -178,10 +179,11 @@ class Buffer {
       PRIVATE:
 
         /**
-         * Structure padding so that \a data is 8-byte aligned within an
-         * Allocation.
+         * The number of bytes of #data, as passed to the constructor. Needed
+         * to return the Allocation to the SlabAllocator, and also keeps
+         * \a data 8-byte aligned within an Allocation.
          */
-        char padding[4];
+        DataIndex totalSize;
 
         /**
          * The memory from which portions are returned by the allocate methods
@@ -58,7 +58,7 @@ class BufferAllocationTest : public ::testing::Test {
 
     ~BufferAllocationTest() {
         if (a != NULL)
-            free(a);
+            Buffer::Allocation::deleteAllocation(a);
         a = NULL;
     }
   private:
@@ -67,13 +67,14 @@ class BufferAllocationTest : public ::testing::Test {
 
 TEST_F(BufferAllocationTest, constructor) {
 
-    // make sure Allocation::padding is set correctly.
+    // make sure Allocation::data is aligned correctly.
     EXPECT_EQ(0U, reinterpret_cast<uint64_t>(a->data) & 0x7);
 
     EXPECT_TRUE(a->next == NULL);
     EXPECT_EQ(256U, a->prependTop);
     EXPECT_EQ(256U, a->appendTop);
     EXPECT_EQ(2048U, a->chunkTop);
+    EXPECT_EQ(2048U, a->totalSize);
 }
 
 TEST_F(BufferAllocationTest, destructor) {
@@ -90,6 +91,10 @@ TEST_F(BufferAllocationTest, reset) {
     EXPECT_EQ(32U, a->prependTop);
     EXPECT_EQ(32U, a->appendTop);
     EXPECT_EQ(256U, a->chunkTop);
+    EXPECT_EQ(256U, a->totalSize);
+
+    // Restore the size so that the destructor frees it correctly.
+    a->reset(256, 2048);
 }
 
 TEST_F(BufferAllocationTest, allocateChunk) {
@@ -22,6 +22,9 @@
 #include "CRamCloud.h"
 #include "ClientException.h"
 #include "Logger.h"
+#include "MultiRead.h"
+#include "MultiRemove.h"
+#include "MultiWrite.h"
 
 using namespace RAMCloud;
 
@@ -32,6 +35,178 @@ struct rc_client {
     RamCloud* client;
 };
 
+/**
+ * Handle for a multi-object operation started by one of the rc_multi*Async
+ * functions. Each subclass translates between the C request structures and
+ * the C++ MultiOp that carries out the operation.
+ */
+struct rc_async {
+    explicit rc_async(RamCloud* ramcloud)
+        : ramcloud(ramcloud)
+        , op(NULL)
+    {}
+    virtual ~rc_async() {}
+
+    /**
+     * Copy the results of the finished operation into the caller's
+     * request structures.
+     */
+    virtual void finish() = 0;
+
+    /// Client that issued the operation.
+    RamCloud* ramcloud;
+
+    /// Carries out the operation; owned by the subclass.
+    MultiOp* op;
+
+    DISALLOW_COPY_AND_ASSIGN(rc_async);
+};
+
+namespace {
+
+/**
+ * rc_async for rc_multiRead and rc_multiReadAsync.
+ */
+struct AsyncMultiRead : public rc_async {
+    AsyncMultiRead(RamCloud* ramcloud, rc_multi_read_object* requests,
+                   uint32_t numRequests)
+        : rc_async(ramcloud)
+        , requests(requests)
+        , numRequests(numRequests)
+        , values(new Tub<ObjectBuffer>[numRequests])
+        , objects(numRequests)
+        , pointers(numRequests)
+        , multiRead()
+    {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            objects[i] = MultiReadObject(requests[i].tableId, requests[i].key,
+                                         requests[i].keyLength, &values[i]);
+            pointers[i] = &objects[i];
+        }
+        multiRead.construct(ramcloud, pointers.data(), numRequests);
+        op = multiRead.get();
+    }
+
+    void
+    finish()
+    {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            rc_multi_read_object& request = requests[i];
+            request.status = objects[i].status;
+            request.version = objects[i].version;
+            request.actualLength = 0;
+            if (request.status != STATUS_OK)
+                continue;
+
+            // Copy straight from the response into the caller's buffer
+            // rather than making the value contiguous first.
+            ObjectBuffer* value = values[i].get();
+            uint16_t offset;
+            value->getValueOffset(&offset);
+            request.actualLength = value->getTotalLength() - offset;
+            value->copy(offset, std::min(request.actualLength,
+                                         request.maxLength), request.buf);
+        }
+    }
+
+    rc_multi_read_object* requests;
+    uint32_t numRequests;
+    std::unique_ptr<Tub<ObjectBuffer>[]> values;
+    std::vector<MultiReadObject> objects;
+    std::vector<MultiReadObject*> pointers;
+    Tub<MultiRead> multiRead;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncMultiRead);
+};
+
+/**
+ * rc_async for rc_multiRemove and rc_multiRemoveAsync.
+ */
+struct AsyncMultiRemove : public rc_async {
+    AsyncMultiRemove(RamCloud* ramcloud, rc_multi_remove_object* requests,
+                     uint32_t numRequests)
+        : rc_async(ramcloud)
+        , requests(requests)
+        , numRequests(numRequests)
+        , objects(numRequests)
+        , pointers(numRequests)
+        , multiRemove()
+    {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            objects[i] = MultiRemoveObject(requests[i].tableId,
+                                           requests[i].key,
+                                           requests[i].keyLength,
+                                           requests[i].rejectRules);
+            pointers[i] = &objects[i];
+        }
+        multiRemove.construct(ramcloud, pointers.data(), numRequests);
+        op = multiRemove.get();
+    }
+
+    void
+    finish()
+    {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            requests[i].status = objects[i].status;
+            requests[i].version = objects[i].version;
+        }
+    }
+
+    rc_multi_remove_object* requests;
+    uint32_t numRequests;
+    std::vector<MultiRemoveObject> objects;
+    std::vector<MultiRemoveObject*> pointers;
+    Tub<MultiRemove> multiRemove;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncMultiRemove);
+};
+
+/**
+ * rc_async for rc_multiWrite and rc_multiWriteAsync.
+ */
+struct AsyncMultiWrite : public rc_async {
+    AsyncMultiWrite(RamCloud* ramcloud, rc_multi_write_object* requests,
+                    uint32_t numRequests)
+        : rc_async(ramcloud)
+        , requests(requests)
+        , numRequests(numRequests)
+        , objects(numRequests)
+        , pointers(numRequests)
+        , multiWrite()
+    {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            objects[i] = MultiWriteObject(requests[i].tableId,
+                                          requests[i].key,
+                                          requests[i].keyLength,
+                                          requests[i].buf,
+                                          requests[i].length,
+                                          requests[i].rejectRules);
+            pointers[i] = &objects[i];
+        }
+        multiWrite.construct(ramcloud, pointers.data(), numRequests);
+        op = multiWrite.get();
+    }
+
+    void
+    finish()
+    {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            requests[i].status = objects[i].status;
+            requests[i].version = objects[i].version;
+        }
+    }
+
+    rc_multi_write_object* requests;
+    uint32_t numRequests;
+    std::vector<MultiWriteObject> objects;
+    std::vector<MultiWriteObject*> pointers;
+    Tub<MultiWrite> multiWrite;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncMultiWrite);
+};
+
+} // anonymous namespace
+
 /**
  * Create a new client connection to a RAMCloud cluster.
  *
@@ -302,6 +477,274 @@ rc_write(struct rc_client* client, uint64_t tableId,
     return STATUS_OK;
 }
 
+/**
+ * Read several objects at once; this is much faster than calling rc_read
+ * for each object, since objects on the same master are fetched with a
+ * single RPC and different masters are contacted concurrently. See
+ * RamCloud::multiRead for details.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param requests
+ *      Array describing the objects to read. Each object's value is copied
+ *      directly into the buffer given in its entry, and its status, version
+ *      and length are returned there too.
+ * \param numRequests
+ *      Number of entries in \a requests.
+ *
+ * \return
+ *      STATUS_OK if the status of each object was filled in (each may still
+ *      indicate an error); anything else means the operation failed.
+ */
+Status
+rc_multiRead(struct rc_client* client, struct rc_multi_read_object* requests,
+             uint32_t numRequests)
+{
+    try {
+        AsyncMultiRead request(client->client, requests, numRequests);
+        request.op->wait();
+        request.finish();
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Remove several objects at once; the multi-object counterpart of
+ * rc_remove. See rc_multiRead for a description of the arguments and
+ * return value.
+ */
+Status
+rc_multiRemove(struct rc_client* client,
+               struct rc_multi_remove_object* requests, uint32_t numRequests)
+{
+    try {
+        AsyncMultiRemove request(client->client, requests, numRequests);
+        request.op->wait();
+        request.finish();
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Write several objects at once; the multi-object counterpart of
+ * rc_write. See rc_multiRead for a description of the arguments and
+ * return value.
+ */
+Status
+rc_multiWrite(struct rc_client* client,
+              struct rc_multi_write_object* requests, uint32_t numRequests)
+{
+    try {
+        AsyncMultiWrite request(client->client, requests, numRequests);
+        request.op->wait();
+        request.finish();
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+// The functions below start the same operations as rc_multiRead,
+// rc_multiRemove, and rc_multiWrite but return without waiting for them,
+// so that callers can overlap many batches or do other work meanwhile.
+// The requests array and everything it refers to must remain valid until
+// the operation is finished with rc_asyncWait or rc_asyncCancel.
+
+/**
+ * Start an rc_multiRead without waiting for it to complete.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param requests
+ *      See rc_multiRead. Results are filled in by rc_asyncWait.
+ * \param numRequests
+ *      Number of entries in \a requests.
+ * \param[out] handle
+ *      If STATUS_OK is returned, a handle for the operation is returned
+ *      here; it must eventually be passed to rc_asyncWait or
+ *      rc_asyncCancel.
+ *
+ * \return
+ *      STATUS_OK means the operation was started.
+ */
+Status
+rc_multiReadAsync(struct rc_client* client,
+                  struct rc_multi_read_object* requests,
+                  uint32_t numRequests, struct rc_async** handle)
+{
+    try {
+        *handle = new AsyncMultiRead(client->client, requests, numRequests);
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Start an rc_multiRemove without waiting for it to complete; see
+ * rc_multiReadAsync.
+ */
+Status
+rc_multiRemoveAsync(struct rc_client* client,
+                    struct rc_multi_remove_object* requests,
+                    uint32_t numRequests, struct rc_async** handle)
+{
+    try {
+        *handle = new AsyncMultiRemove(client->client, requests, numRequests);
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Start an rc_multiWrite without waiting for it to complete; see
+ * rc_multiReadAsync.
+ */
+Status
+rc_multiWriteAsync(struct rc_client* client,
+                   struct rc_multi_write_object* requests,
+                   uint32_t numRequests, struct rc_async** handle)
+{
+    try {
+        *handle = new AsyncMultiWrite(client->client, requests, numRequests);
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Make progress on an operation started by one of the rc_multi*Async
+ * functions (and any others outstanding on the same client) without
+ * blocking.
+ *
+ * \param handle
+ *      Handle returned by rc_multi*Async.
+ *
+ * \return
+ *      Nonzero means the operation has completed, so rc_asyncWait will
+ *      return without blocking.
+ */
+int
+rc_asyncIsReady(struct rc_async* handle)
+{
+    try {
+        handle->ramcloud->poll();
+        return handle->op->isReady();
+    } catch (...) {
+        // Let rc_asyncWait report the error.
+        return 1;
+    }
+}
+
+/**
+ * Wait for an operation started by one of the rc_multi*Async functions to
+ * complete, fill in the results in its requests array, and free its handle.
+ *
+ * \param handle
+ *      Handle returned by rc_multi*Async; it must not be used again after
+ *      this function returns.
+ *
+ * \return
+ *      See rc_multiRead.
+ */
+Status
+rc_asyncWait(struct rc_async* handle)
+{
+    std::unique_ptr<rc_async> async(handle);
+    try {
+        async->op->wait();
+        async->finish();
+    } catch (ClientException& e) {
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Abandon an operation started by one of the rc_multi*Async functions and
+ * free its handle. Some of the objects may already have been modified on
+ * their masters; the results in the requests array are not filled in.
+ *
+ * \param handle
+ *      Handle returned by rc_multi*Async; it must not be used again after
+ *      this function returns.
+ */
+void
+rc_asyncCancel(struct rc_async* handle)
+{
+    handle->op->cancel();
+    delete handle;
+}
+
 Status
 rc_testing_kill(struct rc_client* client, uint64_t tableId,
                 const void* key, uint16_t keyLength)
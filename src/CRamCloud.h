@@ -31,8 +31,56 @@ using namespace RAMCloud;
 /// Forward Declarations
 struct RamCloud;
 struct rc_client;
+struct rc_async;
 #endif
 
+/**
+ * Describes one object to read with rc_multiRead; the results are returned
+ * in the same structure.
+ */
+struct rc_multi_read_object {
+    uint64_t tableId;           ///< Table containing the object.
+    const void* key;            ///< Object's key; needn't be null-terminated.
+    uint16_t keyLength;         ///< Size in bytes of key.
+    void* buf;                  ///< The object's value is copied here.
+    uint32_t maxLength;         ///< Bytes of space available at buf.
+    uint32_t actualLength;      ///< [out] Full size of the value; may be
+                                ///< larger than maxLength.
+    uint64_t version;           ///< [out] Version of the object.
+    Status status;              ///< [out] Outcome of reading this object.
+};
+
+/**
+ * Describes one object to write with rc_multiWrite; the results are
+ * returned in the same structure.
+ */
+struct rc_multi_write_object {
+    uint64_t tableId;           ///< Table to contain the object.
+    const void* key;            ///< Object's key; needn't be null-terminated.
+    uint16_t keyLength;         ///< Size in bytes of key.
+    const void* buf;            ///< New value of the object.
+    uint32_t length;            ///< Size in bytes of buf.
+    const struct RejectRules* rejectRules;  ///< If non-NULL, conditions under
+                                ///< which the write is aborted.
+    uint64_t version;           ///< [out] Version of the new object.
+    Status status;              ///< [out] Outcome of writing this object.
+};
+
+/**
+ * Describes one object to remove with rc_multiRemove; the results are
+ * returned in the same structure.
+ */
+struct rc_multi_remove_object {
+    uint64_t tableId;           ///< Table containing the object.
+    const void* key;            ///< Object's key; needn't be null-terminated.
+    uint16_t keyLength;         ///< Size in bytes of key.
+    const struct RejectRules* rejectRules;  ///< If non-NULL, conditions under
+                                ///< which the remove is aborted.
+    uint64_t version;           ///< [out] Version of the object just before
+                                ///< it was removed.
+    Status status;              ///< [out] Outcome of removing this object.
+};
+
 Status    rc_connect(const char* serverLocator,
                             const char* clusterName,
                             struct rc_client** newClient);
@@ -64,6 +112,32 @@ Status    rc_write(struct rc_client* client, uint64_t tableId,
                              const struct RejectRules* rejectRules,
                              uint64_t* version);
 
+Status    rc_multiRead(struct rc_client* client,
+                       struct rc_multi_read_object* requests,
+                       uint32_t numRequests);
+Status    rc_multiRemove(struct rc_client* client,
+                         struct rc_multi_remove_object* requests,
+                         uint32_t numRequests);
+Status    rc_multiWrite(struct rc_client* client,
+                        struct rc_multi_write_object* requests,
+                        uint32_t numRequests);
+
+Status    rc_multiReadAsync(struct rc_client* client,
+                            struct rc_multi_read_object* requests,
+                            uint32_t numRequests,
+                            struct rc_async** handle);
+Status    rc_multiRemoveAsync(struct rc_client* client,
+                              struct rc_multi_remove_object* requests,
+                              uint32_t numRequests,
+                              struct rc_async** handle);
+Status    rc_multiWriteAsync(struct rc_client* client,
+                             struct rc_multi_write_object* requests,
+                             uint32_t numRequests,
+                             struct rc_async** handle);
+int       rc_asyncIsReady(struct rc_async* handle);
+Status    rc_asyncWait(struct rc_async* handle);
+void      rc_asyncCancel(struct rc_async* handle);
+
 Status    rc_testing_kill(struct rc_client* client, uint64_t tableId,
                                     const void* key, uint16_t keyLength);
 Status    rc_testing_get_server_id(struct rc_client* client,
@@ -130,7 +130,7 @@ CleanableSegmentManager::getSegmentsToClean(LogSegmentVector& outSegsToClean)
 uint64_t
 CleanableSegmentManager::computeCompactionCostBenefitScore(LogSegment* segment)
 {
-    uint64_t liveBytes = segment->getLiveBytes();
+    uint64_t liveBytes = segment->getMemoryBytes(segment->getLiveBytes());
     uint64_t liveSeglets = (liveBytes + segletSize - 1) / segletSize;
     uint64_t unusedSeglets = segment->getSegletsAllocated() - liveSeglets;
     uint64_t unusedBytes = unusedSeglets * segletSize;
@@ -210,12 +210,14 @@ CleanableSegmentManager::update(Lock& guard)
         }
 
         const LogEntryType objType = LOG_ENTRY_TYPE_OBJ;
-        liveObjectBytes += segment.entryLengths[objType] -
-                           segment.deadEntryLengths[objType];
+        liveObjectBytes += segment.getMemoryBytes(
+                               segment.entryLengths[objType] -
+                               segment.deadEntryLengths[objType]);
 
         const LogEntryType tombType = LOG_ENTRY_TYPE_OBJTOMB;
-        undeadTombstoneBytes += segment.entryLengths[tombType] -
-                                segment.deadEntryLengths[tombType];
+        undeadTombstoneBytes += segment.getMemoryBytes(
+                                    segment.entryLengths[tombType] -
+                                    segment.deadEntryLengths[tombType]);
     }
 
     // Get new candidates from the SegmentManager and insert them into the
@@ -235,9 +237,12 @@ CleanableSegmentManager::update(Lock& guard)
             computeTombstoneScanScore(segment);
         insertInAll(segment, guard);
 
-        liveObjectBytes += segment->entryLengths[LOG_ENTRY_TYPE_OBJ] -
-                           segment->deadEntryLengths[LOG_ENTRY_TYPE_OBJ];
-        undeadTombstoneBytes += segment->entryLengths[LOG_ENTRY_TYPE_OBJTOMB];
+        liveObjectBytes += segment->getMemoryBytes(
+                               segment->entryLengths[LOG_ENTRY_TYPE_OBJ] -
+                               segment->deadEntryLengths[LOG_ENTRY_TYPE_OBJ]);
+        undeadTombstoneBytes += segment->getMemoryBytes(
+                                    segment->entryLengths[
+                                        LOG_ENTRY_TYPE_OBJTOMB]);
     }
 
     assert(costBenefitCandidates.size() == compactionCandidates.size());
@@ -136,6 +136,12 @@ ClientException::throwException(const CodeLocation& where, Status status)
             throw RequestTooLargeException(where);
         case STATUS_UNKNOWN_INDEXLET:
             throw UnknownIndexletException(where);
+        case STATUS_OBJECT_FILTERED:
+            throw ObjectFilteredException(where);
+        case STATUS_RMW_CONDITION_FAILED:
+            throw RmwConditionFailedException(where);
+        case STATUS_SNAPSHOT_EXPIRED:
+            throw SnapshotExpiredException(where);
         default:
             throw InternalError(where, status);
     }
@@ -227,6 +227,15 @@ DEFINE_EXCEPTION(RequestTooLargeException,
 DEFINE_EXCEPTION(UnknownIndexletException,
                  STATUS_UNKNOWN_INDEXLET,
                  ClientException)
+DEFINE_EXCEPTION(ObjectFilteredException,
+                 STATUS_OBJECT_FILTERED,
+                 ClientException)
+DEFINE_EXCEPTION(RmwConditionFailedException,
+                 STATUS_RMW_CONDITION_FAILED,
+                 ClientException)
+DEFINE_EXCEPTION(SnapshotExpiredException,
+                 STATUS_SNAPSHOT_EXPIRED,
+                 ClientException)
 
 } // namespace RAMCloud
 
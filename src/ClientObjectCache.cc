@@ -0,0 +1,348 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ClientObjectCache.h"
+#include "Cycles.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty cache with no tables enabled.
+ *
+ * \param maxEntries
+ *      Maximum number of objects to keep cached. The least recently used
+ *      objects are evicted once this is exceeded.
+ */
+ClientObjectCache::ClientObjectCache(uint32_t maxEntries)
+    : maxEntriesPerStripe(std::max(maxEntries / NUM_STRIPES, 1U))
+    , stripes()
+{
+}
+
+ClientObjectCache::~ClientObjectCache()
+{
+}
+
+/**
+ * Start caching the objects of a table, or change its lease length.
+ *
+ * \param tableId
+ *      The table whose objects are to be cached.
+ * \param leaseMs
+ *      How long, in milliseconds, a cached value may be returned before it
+ *      must be revalidated with the master. This bounds how stale a value
+ *      read from the cache can be.
+ */
+void
+ClientObjectCache::enableTable(uint64_t tableId, uint32_t leaseMs)
+{
+    uint64_t cycles = Cycles::fromNanoseconds(leaseMs * 1000000UL);
+    foreach (Stripe& stripe, stripes) {
+        Lock lock(stripe.mutex);
+        stripe.leaseCycles[tableId] = cycles;
+    }
+}
+
+/**
+ * Stop caching the objects of a table and discard those already cached.
+ *
+ * \param tableId
+ *      The table whose objects are no longer to be cached.
+ */
+void
+ClientObjectCache::disableTable(uint64_t tableId)
+{
+    foreach (Stripe& stripe, stripes) {
+        Lock lock(stripe.mutex);
+        stripe.leaseCycles.erase(tableId);
+        auto it = stripe.lruList.begin();
+        while (it != stripe.lruList.end()) {
+            if (it->tableId == tableId) {
+                stripe.entries.erase(it->keyHash);
+                it = stripe.lruList.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+/**
+ * Look up an object in the cache.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] value
+ *      If the result is HIT, this buffer is reset and filled with a copy of
+ *      the object's value; otherwise it is left alone.
+ * \param[out] version
+ *      If the result is HIT or STALE, the version of the cached value is
+ *      returned here.
+ * \return
+ *      See Result.
+ */
+ClientObjectCache::Result
+ClientObjectCache::lookup(uint64_t tableId, const void* key,
+                          uint16_t keyLength, Buffer* value, uint64_t* version)
+{
+    KeyHash keyHash = Key::getHash(tableId, key, keyLength);
+    Stripe& stripe = getStripe(keyHash);
+    Lock lock(stripe.mutex);
+    if (stripe.leaseCycles.find(tableId) == stripe.leaseCycles.end())
+        return UNCACHED_TABLE;
+
+    LruList::iterator it = find(stripe, tableId, keyHash, lock);
+    if (it == stripe.lruList.end() || !it->valid ||
+            it->key.compare(0, string::npos, static_cast<const char*>(key),
+                            keyLength) != 0) {
+        stripe.misses++;
+        return MISS;
+    }
+
+    stripe.lruList.splice(stripe.lruList.begin(), stripe.lruList, it);
+    *version = it->version;
+    if (Cycles::rdtsc() >= it->leaseExpiration) {
+        stripe.misses++;
+        return STALE;
+    }
+    stripe.hits++;
+    value->reset();
+    value->appendCopy(it->value.data(), downCast<uint32_t>(it->value.size()));
+    return HIT;
+}
+
+/**
+ * Add an object's value, just read from its master, to the cache and start
+ * a new lease on it. Nothing happens if the object's table isn't cached or
+ * if a newer version of the object is already known to exist.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param value
+ *      The object's value; a copy is cached.
+ * \param version
+ *      The version of \a value.
+ */
+void
+ClientObjectCache::insert(uint64_t tableId, const void* key,
+                          uint16_t keyLength, Buffer& value, uint64_t version)
+{
+    KeyHash keyHash = Key::getHash(tableId, key, keyLength);
+    Stripe& stripe = getStripe(keyHash);
+    Lock lock(stripe.mutex);
+    auto lease = stripe.leaseCycles.find(tableId);
+    if (lease == stripe.leaseCycles.end())
+        return;
+
+    LruList::iterator it = find(stripe, tableId, keyHash, lock);
+    if (it == stripe.lruList.end()) {
+        // Make room, replacing any entry for a colliding key.
+        auto collision = stripe.entries.find(keyHash);
+        if (collision != stripe.entries.end()) {
+            stripe.lruList.erase(collision->second);
+            stripe.entries.erase(collision);
+        }
+        stripe.lruList.push_front(Entry(tableId, keyHash));
+        it = stripe.lruList.begin();
+        stripe.entries[keyHash] = it;
+    } else {
+        if (version < it->minVersion)
+            return;
+        if (it->valid && version < it->version)
+            return;
+        stripe.lruList.splice(stripe.lruList.begin(), stripe.lruList, it);
+    }
+
+    it->key.assign(static_cast<const char*>(key), keyLength);
+    it->value.resize(value.getTotalLength());
+    value.copy(0, value.getTotalLength(), &it->value[0]);
+    it->version = version;
+    it->valid = true;
+    it->leaseExpiration = Cycles::rdtsc() + lease->second;
+    evict(stripe, lock);
+}
+
+/**
+ * Start a new lease on a cached object once its master has confirmed that
+ * the cached version is still current.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param version
+ *      The version the master confirmed; returned earlier by lookup().
+ * \param[out] value
+ *      If the lease is renewed, this buffer is reset and filled with a copy
+ *      of the object's value.
+ * \return
+ *      True if the lease was renewed; false if the entry was evicted or
+ *      updated in the meantime, in which case the caller must read the
+ *      object from its master.
+ */
+bool
+ClientObjectCache::renew(uint64_t tableId, const void* key, uint16_t keyLength,
+                         uint64_t version, Buffer* value)
+{
+    KeyHash keyHash = Key::getHash(tableId, key, keyLength);
+    Stripe& stripe = getStripe(keyHash);
+    Lock lock(stripe.mutex);
+    auto lease = stripe.leaseCycles.find(tableId);
+    if (lease == stripe.leaseCycles.end())
+        return false;
+
+    LruList::iterator it = find(stripe, tableId, keyHash, lock);
+    if (it == stripe.lruList.end() || !it->valid || it->version != version ||
+            it->key.compare(0, string::npos, static_cast<const char*>(key),
+                            keyLength) != 0)
+        return false;
+
+    it->leaseExpiration = Cycles::rdtsc() + lease->second;
+    value->reset();
+    value->appendCopy(it->value.data(), downCast<uint32_t>(it->value.size()));
+    return true;
+}
+
+/**
+ * Discard the cached value of an object that this client has just updated,
+ * and make sure that older versions of it aren't cached again afterwards.
+ * Invoked by the RPCs that modify objects; objects are identified by key
+ * hash since that's all those RPCs keep.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param keyHash
+ *      Hash of the object's primary key.
+ * \param minVersion
+ *      Versions of the object older than this are obsolete.
+ */
+void
+ClientObjectCache::invalidate(uint64_t tableId, KeyHash keyHash,
+                              uint64_t minVersion)
+{
+    Stripe& stripe = getStripe(keyHash);
+    Lock lock(stripe.mutex);
+    if (stripe.leaseCycles.find(tableId) == stripe.leaseCycles.end())
+        return;
+
+    LruList::iterator it = find(stripe, tableId, keyHash, lock);
+    if (it == stripe.lruList.end()) {
+        auto collision = stripe.entries.find(keyHash);
+        if (collision != stripe.entries.end()) {
+            stripe.lruList.erase(collision->second);
+            stripe.entries.erase(collision);
+        }
+        stripe.lruList.push_front(Entry(tableId, keyHash));
+        it = stripe.lruList.begin();
+        stripe.entries[keyHash] = it;
+    }
+
+    it->valid = false;
+    it->value.clear();
+    it->minVersion = std::max(it->minVersion, minVersion);
+    evict(stripe, lock);
+}
+
+/**
+ * Return the number of lookup() calls that returned HIT.
+ */
+uint64_t
+ClientObjectCache::getHits()
+{
+    uint64_t total = 0;
+    foreach (Stripe& stripe, stripes) {
+        Lock lock(stripe.mutex);
+        total += stripe.hits;
+    }
+    return total;
+}
+
+/**
+ * Return the number of lookup() calls for objects in cached tables that
+ * returned MISS or STALE.
+ */
+uint64_t
+ClientObjectCache::getMisses()
+{
+    uint64_t total = 0;
+    foreach (Stripe& stripe, stripes) {
+        Lock lock(stripe.mutex);
+        total += stripe.misses;
+    }
+    return total;
+}
+
+/**
+ * Return the stripe responsible for objects with the given key hash.
+ */
+ClientObjectCache::Stripe&
+ClientObjectCache::getStripe(KeyHash keyHash)
+{
+    return stripes[keyHash % NUM_STRIPES];
+}
+
+/**
+ * Find the entry for an object in a stripe.
+ *
+ * \param stripe
+ *      Stripe responsible for \a keyHash.
+ * \param tableId
+ *      The table containing the object.
+ * \param keyHash
+ *      Hash of the object's primary key.
+ * \param lock
+ *      Ensures the caller holds the stripe's mutex.
+ * \return
+ *      The entry, or stripe.lruList.end() if there is none.
+ */
+ClientObjectCache::LruList::iterator
+ClientObjectCache::find(Stripe& stripe, uint64_t tableId, KeyHash keyHash,
+                        const Lock& lock)
+{
+    auto it = stripe.entries.find(keyHash);
+    if (it == stripe.entries.end() || it->second->tableId != tableId)
+        return stripe.lruList.end();
+    return it->second;
+}
+
+/**
+ * Drop least recently used entries from a stripe until it fits in its
+ * share of the cache's capacity.
+ *
+ * \param stripe
+ *      The stripe to shrink.
+ * \param lock
+ *      Ensures the caller holds the stripe's mutex.
+ */
+void
+ClientObjectCache::evict(Stripe& stripe, const Lock& lock)
+{
+    while (stripe.entries.size() > maxEntriesPerStripe) {
+        stripe.entries.erase(stripe.lruList.back().keyHash);
+        stripe.lruList.pop_back();
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,182 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CLIENTOBJECTCACHE_H
+#define RAMCLOUD_CLIENTOBJECTCACHE_H
+
+#include <list>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Buffer.h"
+#include "Key.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * A client-side cache of object values for read-mostly tables. Once a
+ * table has been enabled with enableTable() and the cache has been
+ * attached to a RamCloud object with RamCloud::setObjectCache(),
+ * RamCloud::read calls for objects in the table are answered from the
+ * cache without contacting the master for as long as the cached copy's
+ * lease lasts. After the lease runs out the next read asks the master to
+ * return the value only if its version has changed; if it hasn't, the
+ * lease is renewed without transferring the value again.
+ *
+ * Masters don't know which clients have cached an object, so a read may
+ * return a value that was overwritten by another client up to one lease
+ * period ago; tables should only be enabled if the application tolerates
+ * that. Writes, removes, increments, and read-modify-writes issued through
+ * any RamCloud object sharing the cache invalidate the affected entry as
+ * soon as they complete, so those clients always see their own updates.
+ *
+ * This class is thread-safe and a single instance may be shared by the
+ * RamCloud objects of many client threads. Entries are spread across
+ * #NUM_STRIPES independently locked stripes by key hash, each with its
+ * own least-recently-used list, so threads reading different objects
+ * rarely contend.
+ */
+class ClientObjectCache {
+  public:
+    /// Possible results from lookup().
+    enum Result {
+        /// The object's table isn't cached; the read should go straight
+        /// to the master.
+        UNCACHED_TABLE,
+        /// The object isn't in the cache.
+        MISS,
+        /// The object's value was returned and its lease is still valid.
+        HIT,
+        /// The object is in the cache but its lease has run out; its
+        /// version was returned so the caller can revalidate it.
+        STALE,
+    };
+
+    /// Default value for the maxEntries constructor argument.
+    static const uint32_t DEFAULT_MAX_ENTRIES = 100000;
+
+    /// Number of independently locked parts of the cache.
+    static const uint32_t NUM_STRIPES = 16;
+
+    explicit ClientObjectCache(uint32_t maxEntries = DEFAULT_MAX_ENTRIES);
+    ~ClientObjectCache();
+    void enableTable(uint64_t tableId, uint32_t leaseMs);
+    void disableTable(uint64_t tableId);
+    Result lookup(uint64_t tableId, const void* key, uint16_t keyLength,
+                  Buffer* value, uint64_t* version);
+    void insert(uint64_t tableId, const void* key, uint16_t keyLength,
+                Buffer& value, uint64_t version);
+    bool renew(uint64_t tableId, const void* key, uint16_t keyLength,
+               uint64_t version, Buffer* value);
+    void invalidate(uint64_t tableId, KeyHash keyHash, uint64_t minVersion);
+    uint64_t getHits();
+    uint64_t getMisses();
+
+  PRIVATE:
+    typedef std::lock_guard<SpinLock> Lock;
+
+    /// One cached object (or a record of a recent update), kept in
+    /// Stripe::lruList.
+    struct Entry {
+        Entry(uint64_t tableId, KeyHash keyHash)
+            : tableId(tableId)
+            , keyHash(keyHash)
+            , key()
+            , value()
+            , version(0)
+            , minVersion(0)
+            , valid(false)
+            , leaseExpiration(0)
+        {}
+
+        /// Identifies the object.
+        uint64_t tableId;
+        KeyHash keyHash;
+        string key;
+
+        /// The object's value.
+        string value;
+
+        /// Version of #value.
+        uint64_t version;
+
+        /// Values older than this version are never cached; set when this
+        /// client updates the object, so that a read that was already in
+        /// flight can't cache the value from before the update.
+        uint64_t minVersion;
+
+        /// True if #key, #value and #version describe a cached object;
+        /// false if the entry only records #minVersion.
+        bool valid;
+
+        /// Cycles::rdtsc() time after which #value must be revalidated.
+        uint64_t leaseExpiration;
+    };
+    typedef std::list<Entry> LruList;
+
+    /**
+     * One independently locked part of the cache, holding the objects
+     * whose key hashes map to it.
+     */
+    struct Stripe {
+        Stripe()
+            : mutex("ClientObjectCache::mutex")
+            , leaseCycles()
+            , lruList()
+            , entries()
+            , hits(0)
+            , misses(0)
+        {}
+
+        /// Protects all of the members below.
+        SpinLock mutex;
+
+        /// Lease length, in Cycles::rdtsc() ticks, for each table that is
+        /// cached. Every stripe has its own copy so lookups only lock one
+        /// stripe.
+        std::unordered_map<uint64_t, uint64_t> leaseCycles;
+
+        /// Entries in this stripe, most recently used first.
+        LruList lruList;
+
+        /// Index into #lruList by key hash. Objects whose key hashes
+        /// collide replace each other.
+        std::unordered_map<KeyHash, LruList::iterator> entries;
+
+        /// See getHits().
+        uint64_t hits;
+
+        /// See getMisses().
+        uint64_t misses;
+    };
+
+    Stripe& getStripe(KeyHash keyHash);
+    LruList::iterator find(Stripe& stripe, uint64_t tableId,
+                           KeyHash keyHash, const Lock& lock);
+    void evict(Stripe& stripe, const Lock& lock);
+
+    /// Maximum number of entries kept in each stripe.
+    const uint32_t maxEntriesPerStripe;
+
+    /// The cache's contents, partitioned by key hash.
+    Stripe stripes[NUM_STRIPES];
+
+    DISALLOW_COPY_AND_ASSIGN(ClientObjectCache);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_CLIENTOBJECTCACHE_H
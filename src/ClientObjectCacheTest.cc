@@ -0,0 +1,165 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "ClientObjectCache.h"
+#include "Cycles.h"
+
+namespace RAMCloud {
+
+class ClientObjectCacheTest : public ::testing::Test {
+  public:
+    ClientObjectCache cache;
+    Buffer value;
+    uint64_t version;
+
+    ClientObjectCacheTest()
+        : cache(ClientObjectCache::NUM_STRIPES * 2)
+        , value()
+        , version(0)
+    {
+        Cycles::mockTscValue = 1000;
+        cache.enableTable(1, 10);
+    }
+
+    ~ClientObjectCacheTest()
+    {
+        Cycles::mockTscValue = 0;
+    }
+
+    void
+    insert(uint64_t tableId, const char* key, const char* contents,
+           uint64_t version)
+    {
+        Buffer buffer;
+        buffer.appendCopy(contents, downCast<uint32_t>(strlen(contents)));
+        cache.insert(tableId, key, downCast<uint16_t>(strlen(key)), buffer,
+                     version);
+    }
+
+    ClientObjectCache::Result
+    lookup(uint64_t tableId, const char* key)
+    {
+        return cache.lookup(tableId, key, downCast<uint16_t>(strlen(key)),
+                            &value, &version);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ClientObjectCacheTest);
+};
+
+TEST_F(ClientObjectCacheTest, lookup) {
+    EXPECT_EQ(ClientObjectCache::UNCACHED_TABLE, lookup(2, "a"));
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(1, "a"));
+
+    insert(1, "a", "value a", 5);
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, "a"));
+    EXPECT_EQ("value a", TestUtil::toString(&value));
+    EXPECT_EQ(5U, version);
+    EXPECT_EQ(1U, cache.getHits());
+    EXPECT_EQ(1U, cache.getMisses());
+}
+
+TEST_F(ClientObjectCacheTest, lookup_leaseExpired) {
+    insert(1, "a", "value a", 5);
+    Cycles::mockTscValue += Cycles::fromNanoseconds(10 * 1000 * 1000);
+    value.reset();
+    version = 0;
+    EXPECT_EQ(ClientObjectCache::STALE, lookup(1, "a"));
+    EXPECT_EQ(5U, version);
+    EXPECT_EQ(0U, value.getTotalLength());
+}
+
+TEST_F(ClientObjectCacheTest, insert_uncachedTable) {
+    insert(2, "a", "value a", 5);
+    cache.enableTable(2, 10);
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(2, "a"));
+}
+
+TEST_F(ClientObjectCacheTest, insert_keepsNewerVersion) {
+    insert(1, "a", "new", 6);
+    insert(1, "a", "old", 5);
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, "a"));
+    EXPECT_EQ("new", TestUtil::toString(&value));
+
+    insert(1, "a", "newer", 7);
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, "a"));
+    EXPECT_EQ("newer", TestUtil::toString(&value));
+}
+
+TEST_F(ClientObjectCacheTest, insert_evictsLeastRecentlyUsed) {
+    // Find three keys that share a stripe; each stripe holds two entries.
+    vector<string> keys;
+    KeyHash stripe = Key::getHash(1, "k0", 2) % ClientObjectCache::NUM_STRIPES;
+    for (int i = 0; keys.size() < 3; i++) {
+        string key = format("k%d", i);
+        if (Key::getHash(1, key.data(), downCast<uint16_t>(key.size())) %
+                ClientObjectCache::NUM_STRIPES == stripe)
+            keys.push_back(key);
+    }
+
+    insert(1, keys[0].c_str(), "0", 1);
+    insert(1, keys[1].c_str(), "1", 1);
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, keys[0].c_str()));
+    insert(1, keys[2].c_str(), "2", 1);
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, keys[0].c_str()));
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(1, keys[1].c_str()));
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, keys[2].c_str()));
+}
+
+TEST_F(ClientObjectCacheTest, renew) {
+    EXPECT_FALSE(cache.renew(1, "a", 1, 5, &value));
+
+    insert(1, "a", "value a", 5);
+    Cycles::mockTscValue += Cycles::fromNanoseconds(10 * 1000 * 1000);
+    EXPECT_EQ(ClientObjectCache::STALE, lookup(1, "a"));
+    EXPECT_FALSE(cache.renew(1, "a", 1, 4, &value));
+    EXPECT_TRUE(cache.renew(1, "a", 1, 5, &value));
+    EXPECT_EQ("value a", TestUtil::toString(&value));
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, "a"));
+}
+
+TEST_F(ClientObjectCacheTest, invalidate) {
+    insert(1, "a", "value a", 5);
+    cache.invalidate(1, Key::getHash(1, "a", 1), 6);
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(1, "a"));
+    EXPECT_FALSE(cache.renew(1, "a", 1, 5, &value));
+
+    // A read that started before the update can't cache the old value.
+    insert(1, "a", "value a", 5);
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(1, "a"));
+    insert(1, "a", "new value", 6);
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(1, "a"));
+    EXPECT_EQ("new value", TestUtil::toString(&value));
+}
+
+TEST_F(ClientObjectCacheTest, invalidate_notCached) {
+    cache.invalidate(1, Key::getHash(1, "a", 1), 6);
+    insert(1, "a", "value a", 5);
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(1, "a"));
+}
+
+TEST_F(ClientObjectCacheTest, disableTable) {
+    cache.enableTable(2, 10);
+    insert(1, "a", "value a", 5);
+    insert(2, "a", "value a", 5);
+    cache.disableTable(1);
+    EXPECT_EQ(ClientObjectCache::UNCACHED_TABLE, lookup(1, "a"));
+    EXPECT_EQ(ClientObjectCache::HIT, lookup(2, "a"));
+    cache.enableTable(1, 10);
+    EXPECT_EQ(ClientObjectCache::MISS, lookup(1, "a"));
+}
+
+}  // namespace RAMCloud
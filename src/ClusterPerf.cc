@@ -41,6 +41,7 @@
 
 #include <boost/program_options.hpp>
 #include <boost/version.hpp>
+#include <cmath>
 #include <iostream>
 namespace po = boost::program_options;
 
@@ -48,6 +49,7 @@ namespace po = boost::program_options;
 #include "CycleCounter.h"
 #include "Cycles.h"
 #include "KeyUtil.h"
+#include "LogLinearHistogram.h"
 #include "PerfCounter.h"
 
 using namespace RAMCloud;
@@ -85,6 +87,40 @@ static int numTables;
 // measurements (e.g. to make sure that caches are loaded).
 static int warmupCount;
 
+// Value of the "--workload" command-line option: selects which of the
+// YCSB core workloads (A-F) the "ycsb" test runs.
+static string workload;
+
+// Value of the "--distribution" command-line option: overrides the
+// workload's request distribution in the "ycsb" test ("zipfian", "latest",
+// or "uniform"); empty means use the workload's standard distribution.
+static string distribution;
+
+// Value of the "--numObjects" command-line option: used by some tests to
+// determine how many objects to load before starting measurements.
+static int numObjects;
+
+// Value of the "--targetRate" command-line option: if nonzero, tests that
+// support it issue operations at this many per second per client, starting
+// each one at its scheduled time whether or not earlier ones have finished
+// ("open loop"). 0 means issue each operation as soon as the previous one
+// completes. In "latencyUnderLoad" it is the first of the rates measured.
+static double targetRate;
+
+// Value of the "--arrivals" command-line option: determines how tests that
+// issue operations at a given rate space them out ("poisson" or
+// "constant").
+static string arrivals;
+
+// Value of the "--maxOutstanding" command-line option: the largest number
+// of RPCs that tests issuing asynchronous operations keep in progress at
+// once in each client.
+static int maxOutstanding;
+
+// Value of the "--writeFraction" command-line option: the fraction of
+// operations that are writes rather than reads, in tests that mix them.
+static double writeFraction;
+
 // Identifier for table that is used for test-specific data.
 uint64_t dataTable = -1;
 
@@ -104,6 +140,9 @@ enum Id {
                                      // regions; used in log messages.
     METRICS = 3,                     // Statistics returned from slaves
                                      // to masters.
+    HISTOGRAMS = 4,                  // Latency histograms returned from
+                                     // slaves to masters; histogram i is
+                                     // stored at HISTOGRAMS+i.
 };
 
 #define MAX_METRICS 8
@@ -134,6 +173,16 @@ genRandomString(char* str, const int length) {
     }
 }
 
+/**
+ * Return a random number uniformly distributed in [0, 1).
+ */
+double
+randomFraction()
+{
+    return static_cast<double>(generateRandom() >> 11) /
+            static_cast<double>(1UL << 53);
+}
+
 /**
  * Print a performance measurement consisting of a time value.
  *
@@ -748,6 +797,57 @@ createTables(int numTables, int objectSize, const void* key, uint16_t keyLength)
     return tableIds;
 }
 
+/**
+ * Generate the key of the object with a given number, for tests that
+ * access large numbers of objects.
+ *
+ * \param number
+ *      Identifies the object.
+ * \param key
+ *      The key is stored here; must have room for at least 30 bytes.
+ *
+ * \return
+ *      The length of the key, in bytes.
+ */
+uint16_t
+numberedKey(uint64_t number, char* key)
+{
+    return downCast<uint16_t>(snprintf(key, 30, "user%lu", number));
+}
+
+/**
+ * Write objects with keys generated by numberedKey for all the numbers
+ * in [0, count).  The objects are written in batches with multiWrite.
+ *
+ * \param tableId
+ *      Identifier of the table in which to write the objects.
+ * \param count
+ *      Number of objects to write.
+ * \param size
+ *      Size in bytes of each object's value.
+ */
+void
+loadNumberedObjects(uint64_t tableId, int count, int size)
+{
+    char* value = new char[size];
+    genRandomString(value, size);
+    const int batchSize = 100;
+    char keys[batchSize][30];
+    MultiWriteObject objects[batchSize];
+    MultiWriteObject* requests[batchSize];
+    for (int first = 0; first < count; first += batchSize) {
+        int batch = std::min(batchSize, count - first);
+        for (int j = 0; j < batch; j++) {
+            uint16_t keyLength = numberedKey(first + j, keys[j]);
+            objects[j] = MultiWriteObject(tableId, keys[j], keyLength,
+                    value, size);
+            requests[j] = &objects[j];
+        }
+        cluster->multiWrite(requests, downCast<uint32_t>(batch));
+    }
+    delete[] value;
+}
+
 /**
  * Slaves invoke this method to return one or more performance measurements
  * back to the master.
@@ -896,6 +996,128 @@ average(std::vector<double>& data)
     return result / length;
 }
 
+/**
+ * Slaves invoke this method to return latency histograms back to the
+ * master.
+ *
+ * \param histograms
+ *      Array of histograms to return; the precise meaning of each is
+ *      defined by the test.
+ * \param numHistograms
+ *      Number of elements in \a histograms.
+ */
+void
+sendHistograms(const LogLinearHistogram* histograms, int numHistograms)
+{
+    for (int i = 0; i < numHistograms; i++) {
+        ProtoBuf::LogLinearHistogram protoBuf;
+        histograms[i].serialize(protoBuf);
+        string serialized;
+        protoBuf.SerializeToString(&serialized);
+        MakeKey key(keyVal(clientIndex, static_cast<Id>(HISTOGRAMS + i)));
+        cluster->write(controlTable, key.get(), key.length(),
+                serialized.data(), downCast<uint32_t>(serialized.size()));
+    }
+}
+
+/**
+ * Masters invoke this method to retrieve the latency histograms returned
+ * by sendHistograms and combine them.  This method waits for slaves to
+ * fill in their histograms, if they haven't already.
+ *
+ * \param histograms
+ *      Array of histograms; each is reset and then filled in with the
+ *      corresponding histograms from all of the clients, merged.
+ * \param numHistograms
+ *      Number of elements in \a histograms.
+ * \param clientCount
+ *      Histograms will be read from this many clients, starting at 0.
+ */
+void
+getHistograms(LogLinearHistogram* histograms, int numHistograms,
+        int clientCount)
+{
+    for (int i = 0; i < numHistograms; i++) {
+        histograms[i].reset();
+        for (int client = 0; client < clientCount; client++) {
+            Buffer buffer;
+            MakeKey key(keyVal(client, static_cast<Id>(HISTOGRAMS + i)));
+            waitForObject(controlTable, key.get(), key.length(), NULL, buffer);
+            ProtoBuf::LogLinearHistogram protoBuf;
+            string serialized;
+            serialized.resize(buffer.getTotalLength());
+            buffer.copy(0, buffer.getTotalLength(), &serialized[0]);
+            protoBuf.ParseFromString(serialized);
+            histograms[i].merge(LogLinearHistogram(protoBuf));
+        }
+    }
+}
+
+/**
+ * Print one line summarizing a latency histogram: the number of
+ * latencies recorded, their mean, and a selection of percentiles, all in
+ * microseconds.  Nothing is printed if the histogram is empty.
+ *
+ * \param name
+ *      Symbolic name for the measurement, in the first column.
+ * \param histogram
+ *      The latencies to summarize.
+ */
+void
+printLatencySummary(const char* name, const LogLinearHistogram& histogram)
+{
+    if (histogram.getTotalSamples() == 0)
+        return;
+    printf("%-20s %10lu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+            histogram.getTotalSamples(),
+            1e-03 * static_cast<double>(histogram.getAverage()),
+            1e-03 * static_cast<double>(histogram.getPercentile(50)),
+            1e-03 * static_cast<double>(histogram.getPercentile(90)),
+            1e-03 * static_cast<double>(histogram.getPercentile(99)),
+            1e-03 * static_cast<double>(histogram.getPercentile(99.9)),
+            1e-03 * static_cast<double>(histogram.getPercentile(99.99)),
+            1e-03 * static_cast<double>(histogram.getMax()));
+}
+
+/**
+ * Print the full distribution of a latency histogram in the same format
+ * as HdrHistogram's outputPercentileDistribution: one line for each
+ * percentile, with the percentiles getting closer together towards the
+ * tail.  Nothing is printed if the histogram is empty.
+ *
+ * \param name
+ *      Symbolic name for the measurement, printed in the heading.
+ * \param histogram
+ *      The latencies to print.
+ */
+void
+printLatencyDistribution(const char* name, const LogLinearHistogram& histogram)
+{
+    if (histogram.getTotalSamples() == 0)
+        return;
+    printf("#\n# %s latency distribution\n", name);
+    printf("#      Value(us)   Percentile   TotalCount 1/(1-Percentile)\n");
+
+    // Each pass through this loop halves the distance to 100%, printing
+    // two percentiles per halving.
+    double remaining = 1.0;
+    while (true) {
+        for (int i = 0; i < 2; i++) {
+            double fraction = 1.0 - remaining * (i == 0 ? 1.0 : 0.75);
+            uint64_t value = histogram.getPercentile(100 * fraction);
+            printf("%16.3f %12.6f %12lu %16.2f\n",
+                    1e-03 * static_cast<double>(value), fraction,
+                    histogram.getCountAtOrBelow(value), 1.0 / (1.0 - fraction));
+        }
+        remaining /= 2;
+        if (remaining * static_cast<double>(histogram.getTotalSamples()) < 1.0)
+            break;
+    }
+    printf("%16.3f %12.6f %12lu\n",
+            1e-03 * static_cast<double>(histogram.getMax()), 1.0,
+            histogram.getTotalSamples());
+}
+
 //----------------------------------------------------------------------
 // Test functions start here
 //----------------------------------------------------------------------
@@ -1013,6 +1235,268 @@ broadcast()
     printTime("broadcast", Cycles::toSeconds(totalTime)/count, description);
 }
 
+/**
+ * This method contains the core of the "latencyUnderLoad" test; it is
+ * shared by the master and slaves.  It issues reads (and some writes, if
+ * --writeFraction is nonzero) of randomly chosen objects at a given average
+ * rate for a fixed time, regardless of how quickly they complete, keeping
+ * up to --maxOutstanding RPCs in progress at once.  It reports the offered
+ * and achieved throughput with sendMetrics and the distribution of
+ * latencies with sendHistograms.
+ *
+ * \param tableId
+ *      Identifier of the table holding the objects, which were written
+ *      with loadNumberedObjects.
+ * \param rate
+ *      Average number of operations to issue per second.
+ * \param docString
+ *      Information provided by the master about this run; used
+ *      in log messages.
+ */
+void
+latencyUnderLoadCommon(uint64_t tableId, double rate, const char* docString)
+{
+    // Operations issued before this much time has passed aren't measured,
+    // so that the system can reach a steady state.
+    const double warmupSeconds = 0.1;
+
+    // Operations are scheduled for this much time after the warmup.
+    const double measureSeconds = 0.5;
+
+    // The state of one operation that has been started.
+    struct Slot {
+        Slot()
+            : key()
+            , keyLength(0)
+            , value()
+            , read()
+            , write()
+            , scheduled(0)
+        {}
+        char key[30];                // Key of the object being accessed.
+        uint16_t keyLength;          // Number of bytes in key.
+        Buffer value;                // Value returned by a read.
+        Tub<ReadRpc> read;           // Constructed if this is a read.
+        Tub<WriteRpc> write;         // Constructed if this is a write.
+        uint64_t scheduled;          // Time when the operation should have
+                                     // started, in Cycles::rdtsc() ticks.
+    };
+    Slot* slots = new Slot[maxOutstanding];
+    int outstanding = 0;
+    char* value = new char[objectSize];
+    genRandomString(value, objectSize);
+
+    LogLinearHistogram histogram;
+    uint64_t scheduledCount = 0;
+    uint64_t completedCount = 0;
+    double meanGap = Cycles::perSecond() / rate;
+    uint64_t startTime = Cycles::rdtsc();
+    uint64_t measureStart = startTime + Cycles::fromSeconds(warmupSeconds);
+    uint64_t endTime = measureStart + Cycles::fromSeconds(measureSeconds);
+
+    // Start time of the next operation, in Cycles::rdtsc() ticks; kept as
+    // a double so that rounding errors don't accumulate.
+    double nextStart = static_cast<double>(startTime);
+    while (true) {
+        uint64_t now = Cycles::rdtsc();
+
+        // Start every operation whose time has come, as long as there is
+        // room for it. Once an operation has started it waits only for the
+        // server, so any delay before it starts counts in its latency.
+        while ((nextStart <= static_cast<double>(now)) &&
+                (nextStart < static_cast<double>(endTime))) {
+            uint64_t scheduled = static_cast<uint64_t>(nextStart);
+            if (arrivals == "poisson") {
+                nextStart -= log(1.0 - randomFraction()) * meanGap;
+            } else {
+                nextStart += meanGap;
+            }
+            if (scheduled >= measureStart)
+                scheduledCount++;
+            if (now >= endTime) {
+                // The measurement interval is over but this client fell
+                // so far behind that the operation never started; count it
+                // with the delay it has accumulated so far rather than
+                // letting the backlog go on growing.
+                if (scheduled >= measureStart) {
+                    histogram.storeSample(
+                            Cycles::toNanoseconds(now - scheduled));
+                }
+                continue;
+            }
+            if (outstanding == maxOutstanding) {
+                // Put the operation back; it will start as soon as a
+                // slot frees up.
+                nextStart = static_cast<double>(scheduled);
+                if (scheduled >= measureStart)
+                    scheduledCount--;
+                break;
+            }
+            Slot* slot = NULL;
+            for (int i = 0; i < maxOutstanding; i++) {
+                if (!slots[i].read && !slots[i].write) {
+                    slot = &slots[i];
+                    break;
+                }
+            }
+            slot->scheduled = scheduled;
+            slot->keyLength = numberedKey(generateRandom() % numObjects,
+                    slot->key);
+            if (randomFraction() < writeFraction) {
+                slot->write.construct(cluster, tableId, slot->key,
+                        slot->keyLength, value, objectSize);
+            } else {
+                slot->read.construct(cluster, tableId, slot->key,
+                        slot->keyLength, &slot->value);
+            }
+            outstanding++;
+        }
+        if ((outstanding == 0) &&
+                (nextStart >= static_cast<double>(endTime))) {
+            break;
+        }
+
+        // Collect any operations that have finished.
+        cluster->poll();
+        now = Cycles::rdtsc();
+        for (int i = 0; i < maxOutstanding; i++) {
+            Slot& slot = slots[i];
+            if (slot.read && slot.read->isReady()) {
+                slot.read->wait();
+                slot.read.destroy();
+            } else if (slot.write && slot.write->isReady()) {
+                slot.write->wait();
+                slot.write.destroy();
+            } else {
+                continue;
+            }
+            outstanding--;
+            if (slot.scheduled >= measureStart) {
+                histogram.storeSample(
+                        Cycles::toNanoseconds(now - slot.scheduled));
+                if (now < endTime)
+                    completedCount++;
+            }
+        }
+    }
+    delete[] value;
+    delete[] slots;
+
+    double offered = static_cast<double>(scheduledCount) / measureSeconds;
+    double thruput = static_cast<double>(completedCount) / measureSeconds;
+    sendMetrics(offered, thruput);
+    sendHistograms(&histogram, 1);
+    if (clientIndex != 0) {
+        RAMCLOUD_LOG(NOTICE, "%s: offered: %.1f ops/sec., throughput: "
+                "%.1f ops/sec., median latency: %.1fus", docString, offered,
+                thruput, 1e-03 * static_cast<double>(
+                histogram.getPercentile(50)));
+    }
+}
+
+// This test measures how latency grows with load. All of the clients issue
+// reads (and writes, with --writeFraction) of randomly chosen objects at a
+// given rate regardless of how long they take to complete ("open loop"),
+// with either Poisson or evenly spaced arrivals (--arrivals). Latency is
+// measured from the time each operation was scheduled to start, so it
+// includes any queueing in the client as well as in the servers. The rate
+// starts at --targetRate per client and grows by 25% each step until the
+// servers can no longer keep up; each step produces one point of the
+// throughput-latency curve.
+void
+latencyUnderLoad()
+{
+    if (arrivals != "poisson" && arrivals != "constant") {
+        RAMCLOUD_LOG(ERROR, "unknown arrival process '%s'",
+                arrivals.c_str());
+        return;
+    }
+    if (numObjects < 1 || maxOutstanding < 1) {
+        RAMCLOUD_LOG(ERROR, "--numObjects and --maxOutstanding must be "
+                "at least 1");
+        return;
+    }
+
+    if (clientIndex > 0) {
+        // This is a slave: execute commands coming from the master.
+        while (true) {
+            char command[20];
+            char doc[200];
+            getCommand(command, sizeof(command));
+            if (strcmp(command, "run") == 0) {
+                uint64_t tableId = cluster->getTableId("latencyUnderLoad");
+                MakeKey controlKey(keyVal(0, DOC));
+                readObject(controlTable, controlKey.get(), controlKey.length(),
+                        doc, sizeof(doc));
+                setSlaveState("running");
+
+                // The master puts the rate at the start of the doc string.
+                latencyUnderLoadCommon(tableId, strtod(doc, NULL), doc);
+                setSlaveState("idle");
+            } else if (strcmp(command, "done") == 0) {
+                setSlaveState("done");
+                return;
+            } else {
+                RAMCLOUD_LOG(ERROR, "unknown command %s", command);
+                return;
+            }
+        }
+    }
+
+    // This is the master: first, load the objects.
+    uint64_t tableId = cluster->createTable("latencyUnderLoad", numTables);
+    loadNumberedObjects(tableId, numObjects, objectSize);
+
+    printf("# RAMCloud latency as a function of offered load: %d clients\n"
+           "# access %d-byte objects chosen at random from %d objects on\n"
+           "# %d servers (%.0f%% writes), with %s arrivals and at most %d\n"
+           "# operations outstanding per client. Latency is measured from\n"
+           "# each operation's scheduled start time.\n",
+           numClients, objectSize, numObjects, numTables,
+           100 * writeFraction, arrivals.c_str(), maxOutstanding);
+    printf("# Generated by 'clusterperf.py latencyUnderLoad'\n");
+    printf("#\n");
+    printf("# offered(kops/s) throughput(kops/s) mean(us)  p50(us)  "
+           "p90(us)  p99(us) p99.9(us) max(us)\n");
+    printf("#---------------------------------------------------------"
+           "----------------------------------\n");
+    fflush(stdout);
+
+    double rate = (targetRate > 0) ? targetRate : 10000;
+    for (int step = 0; step < 50; step++) {
+        char doc[100];
+        snprintf(doc, sizeof(doc), "%.1f ops/sec. per client", rate);
+        MakeKey key(keyVal(0, DOC));
+        cluster->write(controlTable, key.get(), key.length(), doc);
+        sendCommand("run", "running", 1, numClients-1);
+        latencyUnderLoadCommon(tableId, rate, doc);
+        for (int i = 1; i < numClients; i++)
+            waitSlave(i, "idle", 10.0);
+        ClientMetrics metrics;
+        getMetrics(metrics, numClients);
+        LogLinearHistogram histogram;
+        getHistograms(&histogram, 1, numClients);
+        double offered = sum(metrics[0]);
+        double thruput = sum(metrics[1]);
+        printf("%12.1f %18.1f %12.1f %8.1f %8.1f %8.1f %9.1f %8.1f\n",
+                offered/1e03, thruput/1e03,
+                1e-03 * static_cast<double>(histogram.getAverage()),
+                1e-03 * static_cast<double>(histogram.getPercentile(50)),
+                1e-03 * static_cast<double>(histogram.getPercentile(90)),
+                1e-03 * static_cast<double>(histogram.getPercentile(99)),
+                1e-03 * static_cast<double>(histogram.getPercentile(99.9)),
+                1e-03 * static_cast<double>(histogram.getMax()));
+        fflush(stdout);
+
+        // Stop once the servers fall well behind the offered load: any
+        // further increase would only lengthen the queues.
+        if (thruput < 0.9 * offered)
+            break;
+        rate *= 1.25;
+    }
+    sendCommand("done", "done", 1, numClients-1);
+}
+
 /**
  * This method contains the core of all the "multiRead" tests.
  * It writes objsPerMaster objects on numMasters servers
@@ -1955,6 +2439,469 @@ writeAsyncSync()
     delete garbage;
 }
 
+// The operations issued by the "ycsb" test; also used to index the latency
+// histograms it collects.
+enum YcsbOp {
+    YCSB_READ = 0,
+    YCSB_UPDATE = 1,
+    YCSB_INSERT = 2,
+    YCSB_SCAN = 3,
+    YCSB_READ_MODIFY_WRITE = 4,
+    YCSB_NUM_OPS = 5
+};
+static const char* ycsbOpNames[] = {
+    "READ", "UPDATE", "INSERT", "SCAN", "READ-MODIFY-WRITE"
+};
+
+// Ways in which the "ycsb" test chooses the records to access.
+enum YcsbDistribution {
+    YCSB_UNIFORM,                    // All records equally popular.
+    YCSB_ZIPFIAN,                    // A few records, scattered across the
+                                     // key space, are very popular.
+    YCSB_LATEST,                     // The most recently inserted records
+                                     // are the most popular.
+};
+static const char* ycsbDistributionNames[] = {
+    "uniform", "zipfian", "latest"
+};
+
+// The following struct and table define the YCSB core workloads in terms
+// of the mix of operations and the distribution of keys they access.
+struct YcsbWorkload {
+    const char* name;                // Name of the workload ("A" to "F").
+    const char* description;         // Short summary, used in output.
+    double mix[YCSB_NUM_OPS];        // Fraction of all operations that are
+                                     // of each type, indexed by YcsbOp.
+    YcsbDistribution distribution;   // Standard request distribution.
+};
+static const YcsbWorkload ycsbWorkloads[] = {
+    {"A", "update heavy",      {0.50, 0.50, 0.00, 0.00, 0.00}, YCSB_ZIPFIAN},
+    {"B", "read mostly",       {0.95, 0.05, 0.00, 0.00, 0.00}, YCSB_ZIPFIAN},
+    {"C", "read only",         {1.00, 0.00, 0.00, 0.00, 0.00}, YCSB_ZIPFIAN},
+    {"D", "read latest",       {0.95, 0.00, 0.05, 0.00, 0.00}, YCSB_LATEST},
+    {"E", "short ranges",      {0.00, 0.00, 0.05, 0.95, 0.00}, YCSB_ZIPFIAN},
+    {"F", "read-modify-write", {0.50, 0.00, 0.00, 0.00, 0.50}, YCSB_ZIPFIAN},
+};
+
+// Largest number of records read by a YCSB scan operation.
+#define YCSB_MAX_SCAN_LENGTH 100
+
+/**
+ * Generates integers in [0, n) following a Zipfian distribution in which 0
+ * is the most popular value, 1 the next most popular, and so on. This is
+ * the algorithm from Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases", which YCSB also uses. The range can grow as records
+ * are inserted; the zeta constant is then extended rather than recomputed
+ * from scratch.
+ */
+class ZipfianGenerator {
+  public:
+    /**
+     * Construct a ZipfianGenerator.
+     *
+     * \param n
+     *      Number of distinct values to generate; must be at least 1.
+     * \param theta
+     *      Skew of the distribution; YCSB uses 0.99.
+     */
+    explicit ZipfianGenerator(uint64_t n, double theta = 0.99)
+        : n(0)
+        , theta(theta)
+        , alpha(1.0 / (1.0 - theta))
+        , zetan(0.0)
+        , zeta2(1.0 + pow(0.5, theta))
+        , eta(0.0)
+    {
+        setItemCount(n);
+    }
+
+    /**
+     * Change the number of distinct values generated.
+     *
+     * \param count
+     *      New number of values; must be at least as large as the
+     *      current number.
+     */
+    void
+    setItemCount(uint64_t count)
+    {
+        for (uint64_t i = n + 1; i <= count; i++)
+            zetan += 1.0 / pow(static_cast<double>(i), theta);
+        n = count;
+        eta = (1.0 - pow(2.0 / static_cast<double>(n), 1.0 - theta)) /
+                (1.0 - zeta2 / zetan);
+    }
+
+    /**
+     * Return the next value in the sequence.
+     */
+    uint64_t
+    next()
+    {
+        double u = randomFraction();
+        double uz = u * zetan;
+        if (uz < 1.0)
+            return 0;
+        if (uz < zeta2)
+            return 1;
+        uint64_t result = static_cast<uint64_t>(static_cast<double>(n) *
+                pow(eta * u - eta + 1.0, alpha));
+        return std::min(result, n - 1);
+    }
+
+  PRIVATE:
+    uint64_t n;                      // Values are chosen from [0, n).
+    double theta;                    // Skew of the distribution.
+    double alpha;                    // 1 / (1 - theta).
+    double zetan;                    // Sum of 1/i^theta for i in [1, n].
+    double zeta2;                    // Same, for i in [1, 2].
+    double eta;                      // Derived from the values above.
+
+    DISALLOW_COPY_AND_ASSIGN(ZipfianGenerator);
+};
+
+/**
+ * Chooses which record each YCSB operation accesses, out of a set of
+ * records that can grow over time.  Records are identified by their index
+ * in order of insertion.
+ */
+class YcsbKeyChooser {
+  public:
+    /**
+     * Construct a YcsbKeyChooser.
+     *
+     * \param distribution
+     *      How to choose records.
+     * \param recordCount
+     *      Number of records initially in the table; must be at least 1.
+     */
+    YcsbKeyChooser(YcsbDistribution distribution, uint64_t recordCount)
+        : distribution(distribution)
+        , recordCount(recordCount)
+        , zipfian(recordCount)
+    {}
+
+    /**
+     * Inform the chooser that records have been inserted.
+     *
+     * \param count
+     *      New number of records in the table.
+     */
+    void
+    setRecordCount(uint64_t count)
+    {
+        recordCount = count;
+        if (distribution != YCSB_UNIFORM)
+            zipfian.setItemCount(count);
+    }
+
+    /**
+     * Return the index of the next record to access.
+     */
+    uint64_t
+    next()
+    {
+        switch (distribution) {
+            case YCSB_UNIFORM:
+                return generateRandom() % recordCount;
+            case YCSB_LATEST:
+                return recordCount - 1 - zipfian.next();
+            case YCSB_ZIPFIAN:
+            default:
+                // Scatter the popular records across the table, as YCSB's
+                // "scrambled" Zipfian distribution does, so that they don't
+                // all land on the same server.
+                return fnvHash(zipfian.next()) % recordCount;
+        }
+    }
+
+  PRIVATE:
+    /**
+     * Return the 64-bit FNV-1a hash of an integer.
+     */
+    static uint64_t
+    fnvHash(uint64_t value)
+    {
+        uint64_t hash = 0xcbf29ce484222325UL;
+        for (int i = 0; i < 8; i++) {
+            hash ^= value & 0xff;
+            hash *= 0x100000001b3UL;
+            value >>= 8;
+        }
+        return hash;
+    }
+
+    YcsbDistribution distribution;   // How to choose records.
+    uint64_t recordCount;            // Records are chosen from
+                                     // [0, recordCount).
+    ZipfianGenerator zipfian;        // Used by the skewed distributions.
+
+    DISALLOW_COPY_AND_ASSIGN(YcsbKeyChooser);
+};
+
+/**
+ * Generate the key of a YCSB record.
+ *
+ * \param index
+ *      Index of the record in order of insertion, as returned by
+ *      YcsbKeyChooser.  Records beyond the initial numObjects are inserted
+ *      by the clients in turn, so each client only knows about the records
+ *      it inserted itself; \a index counts those only.
+ * \param key
+ *      The key is stored here; must have room for at least 30 bytes.
+ *
+ * \return
+ *      The length of the key, in bytes.
+ */
+uint16_t
+ycsbKey(uint64_t index, char* key)
+{
+    uint64_t record = index;
+    if (index >= static_cast<uint64_t>(numObjects)) {
+        record = numObjects + (index - numObjects) * numClients + clientIndex;
+    }
+    return numberedKey(record, key);
+}
+
+/**
+ * This method contains the core of the "ycsb" test; it is shared by the
+ * master and slaves.  It issues --count operations and reports this
+ * client's throughput and latency histograms with sendMetrics and
+ * sendHistograms.
+ *
+ * \param tableId
+ *      Identifier of the table holding the records.
+ * \param workload
+ *      The mix of operations to issue.
+ * \param distribution
+ *      How to choose the records accessed.
+ * \param docString
+ *      Information provided by the master about this run; used
+ *      in log messages.
+ */
+void
+ycsbCommon(uint64_t tableId, const YcsbWorkload* workload,
+        YcsbDistribution distribution, const char* docString)
+{
+    LogLinearHistogram histograms[YCSB_NUM_OPS];
+    YcsbKeyChooser chooser(distribution, numObjects);
+    uint64_t recordCount = numObjects;
+    uint64_t inserted = 0;
+    char* value = new char[objectSize];
+    genRandomString(value, objectSize);
+    char key[30];
+
+    // Storage for the requests of scan operations.
+    char scanKeys[YCSB_MAX_SCAN_LENGTH][30];
+    Tub<ObjectBuffer> scanValues[YCSB_MAX_SCAN_LENGTH];
+    MultiReadObject scanObjects[YCSB_MAX_SCAN_LENGTH];
+    MultiReadObject* scanRequests[YCSB_MAX_SCAN_LENGTH];
+
+    uint64_t cyclesPerOp = 0;
+    if (targetRate > 0)
+        cyclesPerOp = Cycles::fromSeconds(1.0 / targetRate);
+    uint64_t startTime = Cycles::rdtsc();
+    uint64_t stopTime = startTime;
+    for (int i = 0; i < warmupCount + count; i++) {
+        // Decide what to do next.
+        double r = randomFraction();
+        int op = 0;
+        while ((op < YCSB_NUM_OPS - 1) && (r >= workload->mix[op])) {
+            r -= workload->mix[op];
+            op++;
+        }
+
+        // In open-loop mode each operation has a scheduled start time, and
+        // its latency is measured from then, even if earlier operations
+        // delayed it. Otherwise a slow operation would hide the queueing
+        // delay it caused for the ones that should have followed it.
+        uint64_t opStart = Cycles::rdtsc();
+        if (cyclesPerOp != 0) {
+            // startTime is reset once the warmup is over, so the measured
+            // operations are scheduled from there.
+            int sequence = (i < warmupCount) ? i : i - warmupCount;
+            uint64_t scheduled = startTime +
+                    static_cast<uint64_t>(sequence) * cyclesPerOp;
+            while (opStart < scheduled)
+                opStart = Cycles::rdtsc();
+            opStart = scheduled;
+        }
+
+        switch (op) {
+            case YCSB_READ: {
+                uint16_t keyLength = ycsbKey(chooser.next(), key);
+                Buffer result;
+                cluster->read(tableId, key, keyLength, &result);
+                break;
+            }
+            case YCSB_UPDATE: {
+                uint16_t keyLength = ycsbKey(chooser.next(), key);
+                cluster->write(tableId, key, keyLength, value, objectSize);
+                break;
+            }
+            case YCSB_INSERT: {
+                uint16_t keyLength = ycsbKey(recordCount, key);
+                cluster->write(tableId, key, keyLength, value, objectSize);
+                inserted++;
+                recordCount++;
+                chooser.setRecordCount(recordCount);
+                break;
+            }
+            case YCSB_SCAN: {
+                // RAMCloud has no range queries, so a scan reads a run of
+                // consecutively inserted records with a single multiRead.
+                uint64_t first = chooser.next();
+                uint64_t length = 1 + generateRandom() % YCSB_MAX_SCAN_LENGTH;
+                length = std::min(length, recordCount - first);
+                for (uint64_t j = 0; j < length; j++) {
+                    uint16_t keyLength = ycsbKey(first + j, scanKeys[j]);
+                    scanValues[j].destroy();
+                    scanObjects[j] = MultiReadObject(tableId, scanKeys[j],
+                            keyLength, &scanValues[j]);
+                    scanRequests[j] = &scanObjects[j];
+                }
+                cluster->multiRead(scanRequests,
+                        downCast<uint32_t>(length));
+                break;
+            }
+            case YCSB_READ_MODIFY_WRITE: {
+                uint16_t keyLength = ycsbKey(chooser.next(), key);
+                Buffer result;
+                cluster->read(tableId, key, keyLength, &result);
+                cluster->write(tableId, key, keyLength, value, objectSize);
+                break;
+            }
+        }
+
+        stopTime = Cycles::rdtsc();
+        if (i == warmupCount - 1)
+            startTime = stopTime;
+        if (i >= warmupCount)
+            histograms[op].storeSample(
+                    Cycles::toNanoseconds(stopTime - opStart));
+    }
+    delete[] value;
+
+    double thruput = count/Cycles::toSeconds(stopTime - startTime);
+    sendMetrics(thruput, static_cast<double>(inserted));
+    sendHistograms(histograms, YCSB_NUM_OPS);
+    if (clientIndex != 0) {
+        RAMCLOUD_LOG(NOTICE, "%s: throughput: %.1f ops/sec.", docString,
+                thruput);
+    }
+}
+
+// This test runs one of the YCSB core workloads (A-F, selected with
+// --workload) on all of the clients at once, against a table of
+// --numObjects records spread over --numTables servers. It reports the
+// total throughput and the distribution of latencies for each kind of
+// operation. With --targetRate each client issues operations on a fixed
+// schedule and latencies include any time an operation spent waiting
+// behind earlier ones.
+void
+ycsb()
+{
+    const YcsbWorkload* selected = NULL;
+    foreach (const YcsbWorkload& w, ycsbWorkloads) {
+        if (strcasecmp(workload.c_str(), w.name) == 0)
+            selected = &w;
+    }
+    if (selected == NULL) {
+        RAMCLOUD_LOG(ERROR, "unknown YCSB workload '%s'", workload.c_str());
+        return;
+    }
+    YcsbDistribution keyDistribution = selected->distribution;
+    if (!distribution.empty()) {
+        bool found = false;
+        for (int i = 0; i <= YCSB_LATEST; i++) {
+            if (distribution.compare(ycsbDistributionNames[i]) == 0) {
+                keyDistribution = static_cast<YcsbDistribution>(i);
+                found = true;
+            }
+        }
+        if (!found) {
+            RAMCLOUD_LOG(ERROR, "unknown request distribution '%s'",
+                    distribution.c_str());
+            return;
+        }
+    }
+    if (numObjects < 1) {
+        RAMCLOUD_LOG(ERROR, "--numObjects must be at least 1");
+        return;
+    }
+
+    if (clientIndex > 0) {
+        // This is a slave: execute commands coming from the master.
+        while (true) {
+            char command[20];
+            char doc[200];
+            getCommand(command, sizeof(command));
+            if (strcmp(command, "run") == 0) {
+                uint64_t tableId = cluster->getTableId("ycsb");
+                MakeKey controlKey(keyVal(0, DOC));
+                readObject(controlTable, controlKey.get(), controlKey.length(),
+                        doc, sizeof(doc));
+                setSlaveState("running");
+                ycsbCommon(tableId, selected, keyDistribution, doc);
+                setSlaveState("idle");
+            } else if (strcmp(command, "done") == 0) {
+                setSlaveState("done");
+                return;
+            } else {
+                RAMCLOUD_LOG(ERROR, "unknown command %s", command);
+                return;
+            }
+        }
+    }
+
+    // This is the master: first, load the records.
+    uint64_t tableId = cluster->createTable("ycsb", numTables);
+    loadNumberedObjects(tableId, numObjects, objectSize);
+
+    printf("# RAMCloud YCSB workload %s (%s): %d clients, %d %d-byte\n"
+           "# records on %d servers, %s request distribution.\n",
+           selected->name, selected->description, numClients, numObjects,
+           objectSize, numTables, ycsbDistributionNames[keyDistribution]);
+    if (targetRate > 0) {
+        printf("# Each client issues %.0f operations/sec. regardless of "
+               "completions;\n"
+               "# latencies are measured from each operation's scheduled "
+               "start time.\n", targetRate);
+    }
+    printf("# Generated by 'clusterperf.py ycsb'\n");
+    printf("#\n");
+    fflush(stdout);
+
+    char doc[100];
+    snprintf(doc, sizeof(doc), "YCSB workload %s", selected->name);
+    MakeKey key(keyVal(0, DOC));
+    cluster->write(controlTable, key.get(), key.length(), doc);
+    sendCommand("run", "running", 1, numClients-1);
+    ycsbCommon(tableId, selected, keyDistribution, doc);
+
+    // Slaves may finish well after the master, since they may run at
+    // different speeds; give them plenty of time.
+    for (int i = 1; i < numClients; i++)
+        waitSlave(i, "idle", 60.0);
+    ClientMetrics metrics;
+    getMetrics(metrics, numClients);
+    LogLinearHistogram histograms[YCSB_NUM_OPS];
+    getHistograms(histograms, YCSB_NUM_OPS, numClients);
+    printRate("throughput", sum(metrics[0]), "total operations per second");
+    printf("#\n");
+    printf("# Latencies in microseconds:\n");
+    printf("%-20s %10s %9s %9s %9s %9s %9s %9s %9s\n", "# operation",
+            "count", "mean", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    printf("#----------------------------------------------------------"
+           "------------------------------------------\n");
+    for (int op = 0; op < YCSB_NUM_OPS; op++)
+        printLatencySummary(ycsbOpNames[op], histograms[op]);
+    for (int op = 0; op < YCSB_NUM_OPS; op++)
+        printLatencyDistribution(ycsbOpNames[op], histograms[op]);
+    fflush(stdout);
+    sendCommand("done", "done", 1, numClients-1);
+}
+
 // The following struct and table define each performance test in terms of
 // a string name and a function that implements the test.
 struct TestInfo {
@@ -1966,6 +2913,7 @@ struct TestInfo {
 TestInfo tests[] = {
     {"basic", basic},
     {"broadcast", broadcast},
+    {"latencyUnderLoad", latencyUnderLoad},
     {"multiWrite_oneMaster", multiWrite_oneMaster},
     {"multiRead_oneMaster", multiRead_oneMaster},
     {"multiRead_oneObjectPerMaster", multiRead_oneObjectPerMaster},
@@ -1980,6 +2928,7 @@ TestInfo tests[] = {
     {"readVaryingKeyLength", readVaryingKeyLength},
     {"writeVaryingKeyLength", writeVaryingKeyLength},
     {"writeAsyncSync", writeAsyncSync},
+    {"ycsb", ycsb},
 };
 
 int
@@ -1997,6 +2946,9 @@ try
             "directly; it is invoked by the clusterperf script.\n\n"
             "Allowed options:");
     desc.add_options()
+        ("arrivals", po::value<string>(&arrivals)->default_value("poisson"),
+                "Spacing of operations issued at a given rate: poisson "
+                "or constant (latencyUnderLoad)")
         ("clientIndex", po::value<int>(&clientIndex)->default_value(0),
                 "Index of this client (first client is 0)")
         ("coordinator,C", po::value<string>(&coordinatorLocator),
@@ -2009,17 +2961,35 @@ try
                 "Print log messages only at this severity level or higher "
                 "(ERROR, WARNING, NOTICE, DEBUG)")
         ("help,h", "Print this help message")
+        ("maxOutstanding",
+                po::value<int>(&maxOutstanding)->default_value(16),
+                "Most asynchronous RPCs each client keeps in progress "
+                "(latencyUnderLoad)")
         ("numClients", po::value<int>(&numClients)->default_value(1),
                 "Total number of clients running")
         ("size,s", po::value<int>(&objectSize)->default_value(100),
                 "Size of objects (in bytes) to use for test")
         ("numTables", po::value<int>(&numTables)->default_value(10),
                 "Number of tables to use for test")
+        ("numObjects", po::value<int>(&numObjects)->default_value(100000),
+                "Number of objects to load before measuring (ycsb)")
+        ("distribution", po::value<string>(&distribution),
+                "Request distribution: zipfian, latest, or uniform "
+                "(default: the workload's own; ycsb)")
+        ("targetRate", po::value<double>(&targetRate)->default_value(0),
+                "Operations per second issued by each client regardless "
+                "of completions; 0 means issue each operation when the "
+                "previous one completes")
         ("testName", po::value<vector<string>>(&testNames),
                 "Name(s) of test(s) to run")
         ("warmup", po::value<int>(&warmupCount)->default_value(100),
                 "Number of times to invoke operation before beginning "
-                "measurements");
+                "measurements")
+        ("writeFraction",
+                po::value<double>(&writeFraction)->default_value(0),
+                "Fraction of operations that are writes (latencyUnderLoad)")
+        ("workload", po::value<string>(&workload)->default_value("A"),
+                "YCSB core workload to run, A through F (ycsb)");
     po::positional_options_description desc2;
     desc2.add("testName", -1);
     po::variables_map vm;
@@ -0,0 +1,521 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <zlib.h>
+
+#include "CompressedSegment.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty compressed segment.
+ *
+ * \param seglets
+ *      Seglets to store the compressed segment in. This object takes
+ *      ownership of them.
+ * \param segletSize
+ *      Size of each seglet in bytes.
+ * \param cache
+ *      Cache that decompressed blocks are looked up in and added to.
+ */
+CompressedSegment::CompressedSegment(const vector<Seglet*>& seglets,
+                                     uint32_t segletSize,
+                                     DecompressionCache* cache)
+    : physical(seglets, segletSize)
+    , cache(cache)
+    , capacity(downCast<uint32_t>(seglets.size()) * segletSize)
+    , mutex("CompressedSegment::mutex")
+    , blocks()
+    , staging()
+    , stagingOffset(0)
+    , stagingFirstRefOffset(0)
+    , stagingEntries(0)
+    , head(0)
+    , checksum()
+    , closed(false)
+{
+    staging.reserve(BLOCK_SIZE);
+}
+
+/**
+ * Destroy the segment, returning its seglets to their allocator.
+ */
+CompressedSegment::~CompressedSegment()
+{
+    cache->invalidate(this);
+}
+
+/**
+ * Check whether or not the segment has sufficient space to append entries.
+ * Both the logical segment and the compressed representation must have room:
+ * the latter is checked assuming that the data does not compress at all.
+ *
+ * \param numEntries
+ *      Number of entries to be appended.
+ * \param length
+ *      Total length of the entries, including their segment metadata.
+ * \return
+ *      True if the entries would fit, otherwise false.
+ */
+bool
+CompressedSegment::hasSpaceFor(uint32_t numEntries, uint32_t length)
+{
+    Lock lock(mutex);
+    return hasSpaceFor(numEntries, length, lock);
+}
+
+/**
+ * Append a typed entry to the logical segment. See Segment::append().
+ *
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param data
+ *      Pointer to the contents of the entry.
+ * \param length
+ *      Length of the entry's contents in bytes.
+ * \param[out] outReference
+ *      If non-NULL and the append succeeded, a reference to the new entry is
+ *      returned here. It points to the entry's stand-in in the physical
+ *      segment.
+ * \return
+ *      True if the append succeeded, false if there was insufficient space.
+ */
+bool
+CompressedSegment::append(LogEntryType type,
+                          const void* data,
+                          uint32_t length,
+                          Segment::Reference* outReference)
+{
+    Lock lock(mutex);
+
+    Segment::EntryHeader header(type, length);
+    uint32_t lengthWithMetadata = sizeof32(header) +
+                                  header.getLengthBytes() +
+                                  length;
+    if (!hasSpaceFor(1, lengthWithMetadata, lock))
+        return false;
+
+    uint32_t offset = head;
+
+    const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>(&header);
+    staging.insert(staging.end(), headerBytes, headerBytes + sizeof(header));
+    checksum.update(&header, sizeof(header));
+
+    // As in Segment, this assumes a little-endian byte order.
+    const uint8_t* lengthBytes = reinterpret_cast<const uint8_t*>(&length);
+    staging.insert(staging.end(), lengthBytes,
+                   lengthBytes + header.getLengthBytes());
+    checksum.update(&length, header.getLengthBytes());
+
+    const uint8_t* dataBytes = static_cast<const uint8_t*>(data);
+    staging.insert(staging.end(), dataBytes, dataBytes + length);
+    head += lengthWithMetadata;
+
+    if (!physical.append(LOG_ENTRY_TYPE_COMPRESSEDREF, &offset,
+                         sizeof32(offset), outReference)) {
+        throw FatalError(HERE, "Compressed segment ran out of space despite "
+                         "having checked for it");
+    }
+    stagingEntries++;
+
+    if (staging.size() >= BLOCK_SIZE)
+        flush(lock);
+
+    return true;
+}
+
+/**
+ * Compress any remaining staged data and make the segment immutable.
+ */
+void
+CompressedSegment::close()
+{
+    Lock lock(mutex);
+    flush(lock);
+    closed = true;
+    physical.close();
+}
+
+/**
+ * Append a range of the logical segment to a buffer. Since decompressed data
+ * may be evicted from the cache at any time, the data is copied into memory
+ * owned by the buffer.
+ *
+ * \param buffer
+ *      Buffer to append to.
+ * \param offset
+ *      Logical offset to begin appending from.
+ * \param length
+ *      Number of bytes to append.
+ * \throw FatalError
+ *      If the range runs past the end of the logical segment.
+ */
+void
+CompressedSegment::appendToBuffer(Buffer& buffer,
+                                  uint32_t offset,
+                                  uint32_t length)
+{
+    if (length == 0)
+        return;
+
+    uint8_t* copy = new(&buffer, APPEND) uint8_t[length];
+    if (copyOut(offset, copy, length) != length) {
+        throw FatalError(HERE, format("invalid length (%u) and/or offset (%u) "
+            "parameter(s)", length, offset));
+    }
+}
+
+/**
+ * Get an entry given its logical offset. See Segment::getEntry().
+ *
+ * \param offset
+ *      Logical offset of the entry.
+ * \param buffer
+ *      If non-NULL, the entry's contents are appended to this buffer.
+ * \param lengthWithMetadata
+ *      If non-NULL, the length of the entry including its segment metadata
+ *      is returned here.
+ * \return
+ *      The type of the entry.
+ */
+LogEntryType
+CompressedSegment::getEntry(uint32_t offset,
+                            Buffer* buffer,
+                            uint32_t* lengthWithMetadata)
+{
+    // Fetch the header and length field with a single copy, since each
+    // copy may need to look up a decompressed block.
+    uint8_t metadata[sizeof(Segment::EntryHeader) + sizeof(uint32_t)];
+    copyOut(offset, metadata, sizeof32(metadata));
+    Segment::EntryHeader header;
+    memcpy(&header, metadata, sizeof(header));
+    uint32_t dataLength = 0;
+    memcpy(&dataLength, metadata + sizeof(header), header.getLengthBytes());
+
+    uint32_t metadataLength = sizeof32(header) + header.getLengthBytes();
+    if (buffer != NULL)
+        appendToBuffer(*buffer, offset + metadataLength, dataLength);
+    if (lengthWithMetadata != NULL)
+        *lengthWithMetadata = metadataLength + dataLength;
+
+    return header.getType();
+}
+
+/**
+ * Get an entry given a reference returned by append() or getReference().
+ *
+ * \param reference
+ *      Reference to the entry's stand-in in the physical segment.
+ * \param buffer
+ *      If non-NULL, the entry's contents are appended to this buffer.
+ * \param lengthWithMetadata
+ *      If non-NULL, the length of the entry including its segment metadata
+ *      is returned here.
+ * \return
+ *      The type of the entry.
+ */
+LogEntryType
+CompressedSegment::getEntry(Segment::Reference reference,
+                            Buffer* buffer,
+                            uint32_t* lengthWithMetadata)
+{
+    Buffer ref;
+    LogEntryType type = physical.getEntry(reference, &ref);
+    assert(type == LOG_ENTRY_TYPE_COMPRESSEDREF);
+    assert(ref.getTotalLength() == sizeof(uint32_t));
+    (void)type;
+    return getEntry(*ref.getStart<uint32_t>(), buffer, lengthWithMetadata);
+}
+
+/**
+ * Return the length of the logical segment and, optionally, a certificate
+ * for it. See Segment::getAppendedLength().
+ */
+uint32_t
+CompressedSegment::getAppendedLength(Segment::Certificate* certificate)
+{
+    Lock lock(mutex);
+    if (certificate != NULL) {
+        certificate->segmentLength = head;
+        Crc32C certificateChecksum = checksum;
+        certificateChecksum.update(
+            certificate, static_cast<unsigned>
+            (sizeof(*certificate) - sizeof(certificate->checksum)));
+        certificate->checksum = certificateChecksum.getResult();
+    }
+    return head;
+}
+
+/**
+ * Return the number of bytes of seglet memory used by the compressed
+ * representation. Data that is still staged is not included.
+ */
+uint32_t
+CompressedSegment::getCompressedLength()
+{
+    return physical.getAppendedLength();
+}
+
+/**
+ * Copy data out of the logical segment. See Segment::copyOut().
+ *
+ * \param offset
+ *      Logical offset to begin copying from.
+ * \param buffer
+ *      Where to copy the data to.
+ * \param length
+ *      Number of bytes to copy.
+ * \return
+ *      The number of bytes copied. May be less than requested if the end of
+ *      the logical segment is reached.
+ */
+uint32_t
+CompressedSegment::copyOut(uint32_t offset, void* buffer, uint32_t length)
+{
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    uint32_t initialLength = length;
+
+    while (length > 0) {
+        uint32_t index;
+        Block block;
+        {
+            Lock lock(mutex);
+            if (offset >= head)
+                break;
+
+            if (offset >= stagingOffset) {
+                uint32_t bytes = std::min(length, head - offset);
+                memcpy(out, &staging[offset - stagingOffset], bytes);
+                out += bytes;
+                offset += bytes;
+                length -= bytes;
+                continue;
+            }
+
+            index = findBlock(offset, lock);
+            block = blocks[index];
+        }
+
+        // Decompress without holding the lock; compressed blocks never
+        // change once written.
+        DecompressionCache::Block data = getBlock(index, block);
+        uint32_t blockOffset = offset - block.offset;
+        uint32_t bytes = std::min(length, block.length - blockOffset);
+        memcpy(out, &(*data)[blockOffset], bytes);
+        out += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+
+    return initialLength - length;
+}
+
+/**
+ * Return a reference to the entry at the given logical offset. The reference
+ * is the same one that append() returned for the entry.
+ *
+ * \param offset
+ *      Logical offset of an entry. This must be an offset at which an entry
+ *      was appended.
+ */
+Segment::Reference
+CompressedSegment::getReference(uint32_t offset)
+{
+    uint32_t firstRefOffset;
+    uint32_t numEntries;
+    {
+        Lock lock(mutex);
+        assert(offset < head);
+        if (offset >= stagingOffset) {
+            firstRefOffset = stagingFirstRefOffset;
+            numEntries = stagingEntries;
+        } else {
+            const Block& block = blocks[findBlock(offset, lock)];
+            firstRefOffset = block.firstRefOffset;
+            numEntries = block.numEntries;
+        }
+    }
+
+    // The stand-ins for a block's entries are contiguous and sorted by the
+    // logical offsets they record, so binary search them.
+    uint32_t low = 0;
+    uint32_t high = numEntries;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (getRefTarget(firstRefOffset + middle * REF_LENGTH) < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    uint32_t refOffset = firstRefOffset + low * REF_LENGTH;
+    assert(low < numEntries && getRefTarget(refOffset) == offset);
+    return physical.getReference(refOffset);
+}
+
+/******************************************************************************
+ * PRIVATE METHODS
+ ******************************************************************************/
+
+/**
+ * Implementation of hasSpaceFor() for callers already holding the lock.
+ *
+ * \param numEntries
+ *      Number of entries to be appended.
+ * \param length
+ *      Total length of the entries, including their segment metadata.
+ * \param lock
+ *      Ensures the caller holds #mutex.
+ */
+bool
+CompressedSegment::hasSpaceFor(uint32_t numEntries,
+                               uint32_t length,
+                               Lock& lock)
+{
+    if (closed || length > capacity - head)
+        return false;
+
+    // Make sure that every block the staged data and the new entries could
+    // be compressed into will fit, even if nothing compresses.
+    uint32_t pending = downCast<uint32_t>(staging.size()) + length;
+    uint32_t numBlocks = pending / BLOCK_SIZE + 1;
+    uint64_t physicalBytes = static_cast<uint64_t>(numEntries) * REF_LENGTH +
+                             compressBound(pending) +
+                             numBlocks * (sizeof(Segment::EntryHeader) +
+                                          sizeof(uint32_t) +
+                                          compressBound(0));
+    if (physicalBytes > capacity)
+        return false;
+    return physical.hasSpaceFor(downCast<uint32_t>(physicalBytes));
+}
+
+/**
+ * Compress the staged data into a new block, if there is any.
+ *
+ * \param lock
+ *      Ensures the caller holds #mutex.
+ */
+void
+CompressedSegment::flush(Lock& lock)
+{
+    if (staging.empty())
+        return;
+
+    uLongf compressedLength = compressBound(staging.size());
+    vector<uint8_t> compressed(compressedLength);
+    int r = compress2(&compressed[0], &compressedLength,
+                      &staging[0], staging.size(), Z_BEST_SPEED);
+    if (r != Z_OK)
+        throw FatalError(HERE, format("Failed to compress block (%d)", r));
+
+    Block block;
+    block.offset = stagingOffset;
+    block.length = downCast<uint32_t>(staging.size());
+    block.physicalOffset = physical.getAppendedLength();
+    block.firstRefOffset = stagingFirstRefOffset;
+    block.numEntries = stagingEntries;
+    if (!physical.append(LOG_ENTRY_TYPE_COMPRESSEDBLOCK, &compressed[0],
+                         downCast<uint32_t>(compressedLength))) {
+        throw FatalError(HERE, "Compressed segment ran out of space despite "
+                         "having checked for it");
+    }
+    blocks.push_back(block);
+
+    staging.clear();
+    stagingOffset = head;
+    stagingFirstRefOffset = physical.getAppendedLength();
+    stagingEntries = 0;
+}
+
+/**
+ * Find the compressed block containing a logical offset.
+ *
+ * \param offset
+ *      Logical offset that precedes #stagingOffset.
+ * \param lock
+ *      Ensures the caller holds #mutex.
+ * \return
+ *      Index of the block in #blocks.
+ */
+uint32_t
+CompressedSegment::findBlock(uint32_t offset, Lock& lock)
+{
+    assert(offset < stagingOffset);
+    uint32_t low = 0;
+    uint32_t high = downCast<uint32_t>(blocks.size());
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if (blocks[middle].offset <= offset)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * Return the decompressed contents of a block, decompressing it if it is not
+ * in the cache.
+ *
+ * \param index
+ *      Index of the block in #blocks.
+ * \param block
+ *      Copy of the block's entry in #blocks.
+ * \throw FatalError
+ *      If the block could not be decompressed.
+ */
+DecompressionCache::Block
+CompressedSegment::getBlock(uint32_t index, const Block& block)
+{
+    DecompressionCache::Block data = cache->find(this, index);
+    if (data)
+        return data;
+
+    Buffer compressed;
+    physical.getEntry(block.physicalOffset, &compressed);
+    uint32_t compressedLength = compressed.getTotalLength();
+
+    vector<uint8_t>* decompressed = new vector<uint8_t>(block.length);
+    data.reset(decompressed);
+    uLongf length = block.length;
+    int r = uncompress(&(*decompressed)[0], &length,
+                       static_cast<const Bytef*>(
+                           compressed.getRange(0, compressedLength)),
+                       compressedLength);
+    if (r != Z_OK || length != block.length) {
+        throw FatalError(HERE, format("Failed to decompress block %u (%d)",
+                                      index, r));
+    }
+
+    cache->insert(this, index, data);
+    return data;
+}
+
+/**
+ * Return the logical offset recorded in an entry's stand-in.
+ *
+ * \param refOffset
+ *      Offset of a LOG_ENTRY_TYPE_COMPRESSEDREF entry in #physical.
+ */
+uint32_t
+CompressedSegment::getRefTarget(uint32_t refOffset)
+{
+    uint32_t offset = 0;
+    physical.copyOut(refOffset + REF_LENGTH - sizeof32(offset),
+                     &offset, sizeof32(offset));
+    return offset;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,170 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_COMPRESSEDSEGMENT_H
+#define RAMCLOUD_COMPRESSEDSEGMENT_H
+
+#include "Common.h"
+#include "DecompressionCache.h"
+#include "Segment.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * Stores the contents of a Segment in compressed form. A Segment switches to
+ * this representation when Segment::enableCompression() is invoked on it, at
+ * which point all of its methods operate on an instance of this class instead.
+ * The log cleaner uses compressed segments for survivors that hold only cold
+ * data, trading slower reads of that data for a smaller memory footprint.
+ *
+ * Compression is purely an in-memory matter: the segment's contents, length
+ * and certificate are exactly what they would have been had the same entries
+ * been appended to a regular segment, so backups and recovery never know the
+ * difference. We call this the "logical" segment.
+ *
+ * The logical segment is divided into blocks of roughly BLOCK_SIZE bytes that
+ * are compressed independently with zlib, so that reading one entry requires
+ * decompressing only the block it lives in (and recently decompressed blocks
+ * are kept in a shared DecompressionCache). The compressed blocks are stored
+ * as LOG_ENTRY_TYPE_COMPRESSEDBLOCK entries in a regular "physical" segment
+ * made of the original seglets.
+ *
+ * References to entries in the log are pointers into seglet memory, so every
+ * logical entry is also represented by a tiny LOG_ENTRY_TYPE_COMPRESSEDREF
+ * entry in the physical segment that records the entry's logical offset. The
+ * Segment::Reference returned when appending points to that stand-in, which
+ * tells Segment::Reference::getEntry() to resolve it through this class. The
+ * stand-ins for a block's entries are appended before the block itself, so
+ * those of any one block are contiguous and sorted by logical offset.
+ *
+ * Entries that have been appended but whose block has not yet been compressed
+ * are kept uncompressed in a staging area on the heap. close() compresses the
+ * final block.
+ *
+ * This class is thread-safe: the cleaner may append while other threads read
+ * entries through references it has already handed out.
+ */
+class CompressedSegment {
+  public:
+    /// Blocks are compressed once they hold at least this many bytes of
+    /// logical segment data.
+    enum { BLOCK_SIZE = 16 * 1024 };
+
+    CompressedSegment(const vector<Seglet*>& seglets,
+                      uint32_t segletSize,
+                      DecompressionCache* cache);
+    ~CompressedSegment();
+    bool hasSpaceFor(uint32_t numEntries, uint32_t length);
+    bool append(LogEntryType type,
+                const void* data,
+                uint32_t length,
+                Segment::Reference* outReference);
+    void close();
+    void appendToBuffer(Buffer& buffer, uint32_t offset, uint32_t length);
+    LogEntryType getEntry(uint32_t offset,
+                          Buffer* buffer,
+                          uint32_t* lengthWithMetadata);
+    LogEntryType getEntry(Segment::Reference reference,
+                          Buffer* buffer,
+                          uint32_t* lengthWithMetadata);
+    uint32_t getAppendedLength(Segment::Certificate* certificate);
+    uint32_t getCompressedLength();
+    uint32_t copyOut(uint32_t offset, void* buffer, uint32_t length);
+    Segment::Reference getReference(uint32_t offset);
+
+  PRIVATE:
+    typedef std::lock_guard<SpinLock> Lock;
+
+    /// Number of bytes each LOG_ENTRY_TYPE_COMPRESSEDREF entry occupies in
+    /// #physical: a one byte entry header, a one byte length, and a 32-bit
+    /// logical offset.
+    enum { REF_LENGTH = 6 };
+
+    /**
+     * Describes one compressed block of the logical segment.
+     */
+    struct Block {
+        /// Logical offset of the first byte in the block.
+        uint32_t offset;
+
+        /// Number of bytes of the logical segment in the block.
+        uint32_t length;
+
+        /// Offset in #physical of the LOG_ENTRY_TYPE_COMPRESSEDBLOCK entry
+        /// holding the compressed data.
+        uint32_t physicalOffset;
+
+        /// Offset in #physical of the LOG_ENTRY_TYPE_COMPRESSEDREF entry for
+        /// the first logical entry in the block.
+        uint32_t firstRefOffset;
+
+        /// Number of logical entries that start in this block.
+        uint32_t numEntries;
+    };
+
+    bool hasSpaceFor(uint32_t numEntries, uint32_t length, Lock& lock);
+    void flush(Lock& lock);
+    uint32_t findBlock(uint32_t offset, Lock& lock);
+    DecompressionCache::Block getBlock(uint32_t index, const Block& block);
+    uint32_t getRefTarget(uint32_t refOffset);
+
+    /// Holds the compressed blocks and entry stand-ins. Owns the seglets.
+    Segment physical;
+
+    /// Decompressed blocks are cached here.
+    DecompressionCache* cache;
+
+    /// Maximum length of the logical segment. This is the size of the seglets
+    /// the segment was created with, so that the logical segment always fits
+    /// in a backup's segment frame.
+    const uint32_t capacity;
+
+    /// Protects all of the members below.
+    SpinLock mutex;
+
+    /// All compressed blocks, in logical offset order.
+    vector<Block> blocks;
+
+    /// Logical segment data appended since the last block was compressed.
+    vector<uint8_t> staging;
+
+    /// Logical offset of the first byte in #staging.
+    uint32_t stagingOffset;
+
+    /// Offset in #physical of the stand-in for the first entry in #staging.
+    uint32_t stagingFirstRefOffset;
+
+    /// Number of entries in #staging.
+    uint32_t stagingEntries;
+
+    /// Length of the logical segment.
+    uint32_t head;
+
+    /// Checksum of the logical segment's metadata, computed exactly as
+    /// Segment does for the same entries.
+    Crc32C checksum;
+
+    /// Set once close() has been invoked. No appends are allowed afterwards.
+    bool closed;
+
+    friend class Segment;
+
+    DISALLOW_COPY_AND_ASSIGN(CompressedSegment);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_COMPRESSEDSEGMENT_H
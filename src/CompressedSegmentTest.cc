@@ -0,0 +1,213 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "CompressedSegment.h"
+#include "SegletAllocator.h"
+#include "SegmentIterator.h"
+#include "ServerConfig.h"
+
+namespace RAMCloud {
+
+/**
+ * Unit tests for CompressedSegment. These mostly operate through the Segment
+ * interface, since that is how the rest of the system uses it.
+ */
+class CompressedSegmentTest : public ::testing::Test {
+  public:
+    ServerConfig serverConfig;
+    Tub<SegletAllocator> allocator;
+    DecompressionCache cache;
+    Tub<Segment> segment;
+    Tub<Segment> plain;
+
+    CompressedSegmentTest()
+        : serverConfig(ServerConfig::forTesting())
+        , allocator()
+        , cache()
+        , segment()
+        , plain()
+    {
+        serverConfig.segletSize = 8 * 1024;
+        allocator.construct(&serverConfig);
+        segment.construct(allocSeglets(), serverConfig.segletSize);
+        segment->enableCompression(&cache);
+        plain.construct(allocSeglets(), serverConfig.segletSize);
+    }
+
+    vector<Seglet*>
+    allocSeglets()
+    {
+        vector<Seglet*> seglets;
+        EXPECT_TRUE(allocator->alloc(SegletAllocator::DEFAULT,
+                    serverConfig.segmentSize / serverConfig.segletSize,
+                    seglets));
+        return seglets;
+    }
+
+    /// Append the same, fairly compressible, entry to both #segment and
+    /// #plain.
+    void
+    appendBoth(uint32_t i, uint32_t length,
+               Segment::Reference* outReference = NULL)
+    {
+        string contents = format("entry %u ", i);
+        while (contents.size() < length)
+            contents += contents;
+        contents.resize(length);
+        EXPECT_TRUE(segment->append(LOG_ENTRY_TYPE_OBJ, contents.c_str(),
+                                    length, outReference));
+        EXPECT_TRUE(plain->append(LOG_ENTRY_TYPE_OBJ, contents.c_str(),
+                                  length));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(CompressedSegmentTest);
+};
+
+TEST_F(CompressedSegmentTest, enableCompression) {
+    EXPECT_TRUE(segment->isCompressed());
+    EXPECT_FALSE(plain->isCompressed());
+    EXPECT_EQ(0U, segment->seglets.size());
+    EXPECT_EQ(plain->getSegletsAllocated(), segment->getSegletsAllocated());
+}
+
+TEST_F(CompressedSegmentTest, append_getEntry) {
+    vector<Segment::Reference> references;
+    for (uint32_t i = 0; i < 100; i++) {
+        Segment::Reference reference;
+        appendBoth(i, 1000, &reference);
+        references.push_back(reference);
+    }
+
+    // Entries are readable both before and after the last block is flushed.
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < references.size(); i++) {
+            Buffer buffer;
+            uint32_t lengthWithMetadata;
+            EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, segment->getEntry(references[i],
+                &buffer, &lengthWithMetadata));
+            EXPECT_EQ(1000U, buffer.getTotalLength());
+            EXPECT_EQ(1003U, lengthWithMetadata);
+            string expected = format("entry %u ", i);
+            EXPECT_EQ(expected, string(reinterpret_cast<const char*>(
+                buffer.getRange(0, downCast<uint32_t>(expected.size()))),
+                expected.size()));
+        }
+        segment->close();
+    }
+    EXPECT_LT(1U, segment->compressed->blocks.size());
+}
+
+TEST_F(CompressedSegmentTest, getAppendedLength_matchesPlainSegment) {
+    for (uint32_t i = 0; i < 50; i++)
+        appendBoth(i, 10 * i + 1);
+    segment->close();
+    plain->close();
+
+    Segment::Certificate compressedCertificate, plainCertificate;
+    EXPECT_EQ(plain->getAppendedLength(&plainCertificate),
+              segment->getAppendedLength(&compressedCertificate));
+    EXPECT_EQ(plainCertificate.segmentLength,
+              compressedCertificate.segmentLength);
+    EXPECT_EQ(plainCertificate.checksum, compressedCertificate.checksum);
+    EXPECT_TRUE(segment->checkMetadataIntegrity(compressedCertificate));
+}
+
+TEST_F(CompressedSegmentTest, getCompressedLength) {
+    for (uint32_t i = 0; i < 100; i++)
+        appendBoth(i, 1000);
+    segment->close();
+    EXPECT_LT(segment->getCompressedLength(),
+              segment->getAppendedLength() / 2);
+    EXPECT_EQ(plain->getAppendedLength(), plain->getCompressedLength());
+}
+
+TEST_F(CompressedSegmentTest, appendToBuffer) {
+    for (uint32_t i = 0; i < 30; i++)
+        appendBoth(i, 1000);
+    segment->close();
+    plain->close();
+
+    Buffer compressedBuffer, plainBuffer;
+    EXPECT_EQ(plain->appendToBuffer(plainBuffer),
+              segment->appendToBuffer(compressedBuffer));
+    EXPECT_EQ(0, memcmp(
+        plainBuffer.getRange(0, plainBuffer.getTotalLength()),
+        compressedBuffer.getRange(0, compressedBuffer.getTotalLength()),
+        plainBuffer.getTotalLength()));
+}
+
+TEST_F(CompressedSegmentTest, getReference) {
+    vector<Segment::Reference> references;
+    for (uint32_t i = 0; i < 40; i++) {
+        Segment::Reference reference;
+        appendBoth(i, 700, &reference);
+        references.push_back(reference);
+    }
+    segment->close();
+
+    uint32_t i = 0;
+    for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
+        EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, it.getType());
+        EXPECT_EQ(references[i].toInteger(),
+                  segment->getReference(it.getOffset()).toInteger());
+        i++;
+    }
+    EXPECT_EQ(references.size(), i);
+}
+
+TEST_F(CompressedSegmentTest, freeUnusedSeglets) {
+    for (uint32_t i = 0; i < 100; i++)
+        appendBoth(i, 1000);
+    segment->close();
+
+    uint32_t allocated = segment->getSegletsAllocated();
+    uint32_t inUse = segment->getSegletsInUse();
+    EXPECT_LT(inUse, allocated);
+    EXPECT_TRUE(segment->freeUnusedSeglets(allocated - inUse));
+    EXPECT_EQ(inUse, segment->getSegletsAllocated());
+
+    Buffer buffer;
+    segment->getEntry(segment->getReference(0), &buffer);
+    EXPECT_EQ(1000U, buffer.getTotalLength());
+}
+
+TEST_F(CompressedSegmentTest, hasSpaceFor_logicalCapacity) {
+    uint32_t capacity = segment->compressed->capacity;
+    EXPECT_TRUE(segment->hasSpaceFor(capacity / 2));
+    EXPECT_FALSE(segment->hasSpaceFor(capacity + 1));
+
+    // Even perfectly compressible data may not exceed what fits in a regular
+    // segment, since the logical segment is what gets replicated.
+    uint32_t appended = 0;
+    while (segment->append(LOG_ENTRY_TYPE_OBJ, string(4000, 'x').c_str(),
+                           4000)) {
+        appended++;
+    }
+    EXPECT_LE(segment->getAppendedLength(), capacity);
+    EXPECT_GT(appended, 0U);
+}
+
+TEST_F(CompressedSegmentTest, close) {
+    appendBoth(0, 100);
+    EXPECT_EQ(0U, segment->compressed->blocks.size());
+    segment->close();
+    EXPECT_EQ(1U, segment->compressed->blocks.size());
+    EXPECT_EQ(0U, segment->compressed->staging.size());
+    EXPECT_FALSE(segment->append(LOG_ENTRY_TYPE_OBJ, "hi", 3));
+}
+
+}  // namespace RAMCloud
@@ -53,6 +53,7 @@ CoordinatorService::CoordinatorService(Context* context,
     , tableManager(context, &updateManager)
     , runtimeOptions()
     , recoveryManager(context, tableManager, &runtimeOptions)
+    , tabletBalancer(context, tableManager, &runtimeOptions)
     , threadLimit(maxThreads)
     , forceServerDownForTesting(false)
     , initFinished(false)
@@ -76,6 +77,7 @@ CoordinatorService::CoordinatorService(Context* context,
 
 CoordinatorService::~CoordinatorService()
 {
+    tabletBalancer.halt();
     recoveryManager.halt();
 }
 
@@ -117,6 +119,11 @@ CoordinatorService::init(CoordinatorService* service,
         if (startRecoveryManager)
             service->recoveryManager.start();
 
+        // The balancer sits idle until enabled through the
+        // "tabletBalancerMode" runtime option.
+        if (startRecoveryManager)
+            service->tabletBalancer.start();
+
         service->initFinished = true;
     } catch (std::exception& e) {
         LOG(ERROR, "%s", e.what());
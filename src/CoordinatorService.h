@@ -30,6 +30,7 @@
 #include "RuntimeOptions.h"
 #include "Service.h"
 #include "TableManager.h"
+#include "TabletBalancer.h"
 #include "TransportManager.h"
 
 namespace RAMCloud {
@@ -156,6 +157,12 @@ class CoordinatorService : public Service {
      */
     MasterRecoveryManager recoveryManager;
 
+    /**
+     * Moves tablets between masters to even out load; see TabletBalancer.
+     * Controlled by the "tabletBalancer*" runtime options.
+     */
+    TabletBalancer tabletBalancer;
+
     /**
      * Maximum number of threads that are allowed to execute RPC handlers in
      * service at one time.
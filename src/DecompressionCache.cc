@@ -0,0 +1,131 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "DecompressionCache.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty cache.
+ *
+ * \param capacityBytes
+ *      Maximum number of bytes of decompressed data to keep. The least
+ *      recently used blocks are evicted once this is exceeded.
+ */
+DecompressionCache::DecompressionCache(uint64_t capacityBytes)
+    : mutex("DecompressionCache::mutex")
+    , capacityBytes(capacityBytes)
+    , bytesCached(0)
+    , lruList()
+    , entries()
+    , hits(0)
+    , misses(0)
+{
+}
+
+DecompressionCache::~DecompressionCache()
+{
+}
+
+/**
+ * Look up a decompressed block.
+ *
+ * \param owner
+ *      The object the block belongs to.
+ * \param blockIndex
+ *      Index of the block within its owner.
+ * \return
+ *      The decompressed block, or an empty pointer if it is not cached.
+ */
+DecompressionCache::Block
+DecompressionCache::find(const void* owner, uint32_t blockIndex)
+{
+    Lock lock(mutex);
+    auto it = entries.find(Key(owner, blockIndex));
+    if (it == entries.end()) {
+        misses++;
+        return Block();
+    }
+
+    hits++;
+    lruList.splice(lruList.begin(), lruList, it->second);
+    return it->second->block;
+}
+
+/**
+ * Add a freshly decompressed block to the cache, evicting older blocks if
+ * needed. If the block is already cached (because another thread raced to
+ * decompress it), the existing copy is kept.
+ *
+ * \param owner
+ *      The object the block belongs to.
+ * \param blockIndex
+ *      Index of the block within its owner.
+ * \param block
+ *      Decompressed contents of the block.
+ */
+void
+DecompressionCache::insert(const void* owner, uint32_t blockIndex, Block block)
+{
+    Lock lock(mutex);
+    Key key(owner, blockIndex);
+    if (entries.find(key) != entries.end())
+        return;
+
+    lruList.push_front(Entry(key, block));
+    entries[key] = lruList.begin();
+    bytesCached += block->size();
+    evict(lock);
+}
+
+/**
+ * Discard all cached blocks belonging to the given owner. Must be called
+ * before the owner is destroyed.
+ *
+ * \param owner
+ *      The object whose blocks are to be dropped.
+ */
+void
+DecompressionCache::invalidate(const void* owner)
+{
+    Lock lock(mutex);
+    auto it = entries.lower_bound(Key(owner, 0));
+    while (it != entries.end() && it->first.first == owner) {
+        bytesCached -= it->second->block->size();
+        lruList.erase(it->second);
+        entries.erase(it++);
+    }
+}
+
+/**
+ * Drop least recently used blocks until the cache fits in its capacity. The
+ * most recently inserted block is always kept, even if it alone exceeds the
+ * capacity.
+ *
+ * \param lock
+ *      Ensures the caller holds #mutex.
+ */
+void
+DecompressionCache::evict(Lock& lock)
+{
+    while (bytesCached > capacityBytes && lruList.size() > 1) {
+        Entry& victim = lruList.back();
+        bytesCached -= victim.block->size();
+        entries.erase(victim.key);
+        lruList.pop_back();
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,115 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_DECOMPRESSIONCACHE_H
+#define RAMCLOUD_DECOMPRESSIONCACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+
+#include "Common.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * A small LRU cache of decompressed blocks of compressed segments (see
+ * CompressedSegment). Reading a single entry out of a compressed segment
+ * requires decompressing the whole block it lives in; this cache lets
+ * subsequent reads of nearby entries skip that work.
+ *
+ * Blocks are identified by the object that owns them (typically a
+ * CompressedSegment) and the block's index within that owner. Owners must
+ * call invalidate() before they are destroyed so that a later owner at the
+ * same address does not find stale blocks.
+ *
+ * Blocks are handed out as shared pointers so that a block evicted by one
+ * thread remains valid for any other thread still copying out of it.
+ *
+ * This class is thread-safe.
+ */
+class DecompressionCache {
+  public:
+    /// A decompressed block.
+    typedef std::shared_ptr<const vector<uint8_t>> Block;
+
+    /// Default capacity of the cache in bytes of decompressed data.
+    enum { DEFAULT_CAPACITY = 8 * 1024 * 1024 };
+
+    explicit DecompressionCache(uint64_t capacityBytes = DEFAULT_CAPACITY);
+    ~DecompressionCache();
+    Block find(const void* owner, uint32_t blockIndex);
+    void insert(const void* owner, uint32_t blockIndex, Block block);
+    void invalidate(const void* owner);
+
+    /// Return the number of find() calls that returned a cached block.
+    uint64_t getHits() const { return hits; }
+
+    /// Return the number of find() calls that came up empty.
+    uint64_t getMisses() const { return misses; }
+
+    /// Return the number of bytes of decompressed data currently cached.
+    uint64_t getBytesCached() const { return bytesCached; }
+
+  PRIVATE:
+    typedef std::lock_guard<SpinLock> Lock;
+    typedef std::pair<const void*, uint32_t> Key;
+
+    /// One cached block, kept in #lruList.
+    struct Entry {
+        Entry(Key key, Block block)
+            : key(key)
+            , block(block)
+        {
+        }
+
+        /// Identifies the block (see find()).
+        Key key;
+
+        /// The decompressed contents of the block.
+        Block block;
+    };
+    typedef std::list<Entry> LruList;
+
+    void evict(Lock& lock);
+
+    /// Protects all of the members below.
+    SpinLock mutex;
+
+    /// Maximum number of bytes of decompressed data to keep cached.
+    const uint64_t capacityBytes;
+
+    /// Number of bytes of decompressed data currently cached.
+    uint64_t bytesCached;
+
+    /// Cached blocks, most recently used first.
+    LruList lruList;
+
+    /// Index into #lruList.
+    std::map<Key, LruList::iterator> entries;
+
+    /// See getHits().
+    uint64_t hits;
+
+    /// See getMisses().
+    uint64_t misses;
+
+    DISALLOW_COPY_AND_ASSIGN(DecompressionCache);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_DECOMPRESSIONCACHE_H
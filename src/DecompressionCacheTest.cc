@@ -0,0 +1,116 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "DecompressionCache.h"
+
+namespace RAMCloud {
+
+class DecompressionCacheTest : public ::testing::Test {
+  public:
+    DecompressionCache cache;
+    int owner1;
+    int owner2;
+
+    DecompressionCacheTest()
+        : cache(100)
+        , owner1()
+        , owner2()
+    {
+    }
+
+    DecompressionCache::Block
+    makeBlock(uint32_t length, uint8_t fill)
+    {
+        return DecompressionCache::Block(
+            new vector<uint8_t>(length, fill));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(DecompressionCacheTest);
+};
+
+TEST_F(DecompressionCacheTest, find) {
+    EXPECT_FALSE(cache.find(&owner1, 0));
+    EXPECT_EQ(1U, cache.getMisses());
+
+    cache.insert(&owner1, 0, makeBlock(10, 'a'));
+    DecompressionCache::Block block = cache.find(&owner1, 0);
+    ASSERT_TRUE(block);
+    EXPECT_EQ(10U, block->size());
+    EXPECT_EQ('a', (*block)[0]);
+    EXPECT_EQ(1U, cache.getHits());
+
+    EXPECT_FALSE(cache.find(&owner1, 1));
+    EXPECT_FALSE(cache.find(&owner2, 0));
+    EXPECT_EQ(3U, cache.getMisses());
+}
+
+TEST_F(DecompressionCacheTest, find_updatesLru) {
+    cache.insert(&owner1, 0, makeBlock(40, 'a'));
+    cache.insert(&owner1, 1, makeBlock(40, 'b'));
+    EXPECT_TRUE(cache.find(&owner1, 0));
+
+    // Block 1 is now the least recently used, so it goes first.
+    cache.insert(&owner1, 2, makeBlock(40, 'c'));
+    EXPECT_TRUE(cache.find(&owner1, 0));
+    EXPECT_FALSE(cache.find(&owner1, 1));
+    EXPECT_TRUE(cache.find(&owner1, 2));
+}
+
+TEST_F(DecompressionCacheTest, insert_alreadyCached) {
+    cache.insert(&owner1, 0, makeBlock(10, 'a'));
+    cache.insert(&owner1, 0, makeBlock(20, 'b'));
+    EXPECT_EQ(10U, cache.getBytesCached());
+    EXPECT_EQ('a', (*cache.find(&owner1, 0))[0]);
+}
+
+TEST_F(DecompressionCacheTest, insert_evicts) {
+    cache.insert(&owner1, 0, makeBlock(60, 'a'));
+    cache.insert(&owner1, 1, makeBlock(30, 'b'));
+    EXPECT_EQ(90U, cache.getBytesCached());
+
+    cache.insert(&owner2, 0, makeBlock(30, 'c'));
+    EXPECT_EQ(60U, cache.getBytesCached());
+    EXPECT_FALSE(cache.find(&owner1, 0));
+    EXPECT_TRUE(cache.find(&owner1, 1));
+    EXPECT_TRUE(cache.find(&owner2, 0));
+}
+
+TEST_F(DecompressionCacheTest, insert_keepsOversizedBlock) {
+    cache.insert(&owner1, 0, makeBlock(10, 'a'));
+    cache.insert(&owner1, 1, makeBlock(500, 'b'));
+    EXPECT_EQ(500U, cache.getBytesCached());
+    EXPECT_FALSE(cache.find(&owner1, 0));
+    EXPECT_TRUE(cache.find(&owner1, 1));
+}
+
+TEST_F(DecompressionCacheTest, invalidate) {
+    cache.insert(&owner1, 0, makeBlock(10, 'a'));
+    cache.insert(&owner1, 5, makeBlock(10, 'b'));
+    cache.insert(&owner2, 0, makeBlock(10, 'c'));
+    DecompressionCache::Block held = cache.find(&owner1, 5);
+
+    cache.invalidate(&owner1);
+    EXPECT_EQ(10U, cache.getBytesCached());
+    EXPECT_FALSE(cache.find(&owner1, 0));
+    EXPECT_FALSE(cache.find(&owner1, 5));
+    EXPECT_TRUE(cache.find(&owner2, 0));
+
+    // Blocks already handed out remain valid.
+    EXPECT_EQ('b', (*held)[0]);
+}
+
+}  // namespace RAMCloud
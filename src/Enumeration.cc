@@ -38,6 +38,10 @@ struct EnumerateBucketArgs {
 
     /// A vector in which to place the resulting objects.
     std::vector<Log::Reference>* objectReferences;
+
+    /// If non-NULL, objects modified since the snapshot being enumerated
+    /// was created; any object matching one of these is skipped.
+    std::vector<SnapshotManager::PreservedObject>* preserved;
 };
 
 /**
@@ -76,6 +80,16 @@ enumerateBucket(uint64_t reference, void* cookie)
         return;
     }
 
+    // In a snapshot enumeration, the snapshot's version of a modified
+    // object takes the place of the current one.
+    if (args.preserved != NULL) {
+        foreach (const SnapshotManager::PreservedObject& object,
+                 *args.preserved) {
+            if (SnapshotManager::matches(object, key))
+                return;
+        }
+    }
+
     // Filter out objects from stale iterator entries. Skip the
     // topmost entry, which refers to the current master's state.
     for (int64_t frameIndex = static_cast<int64_t>(args.iter->size()) - 2;
@@ -107,6 +121,39 @@ enumerateBucket(uint64_t reference, void* cookie)
     args.objectReferences->push_back(Log::Reference(reference));
 }
 
+/**
+ * Helper function to collect the references in a bucket without
+ * filtering them; used by snapshot enumerations, which must look at the
+ * snapshot only after reading the bucket.
+ *
+ * \param reference
+ *      An entry in the HashTable bucket.
+ * \param cookie
+ *      A pointer to a std::vector<uint64_t> to append the reference to.
+ */
+static void
+collectBucketEntry(uint64_t reference, void* cookie)
+{
+    static_cast<std::vector<uint64_t>*>(cookie)->push_back(reference);
+}
+
+/**
+ * Helper function to prefetch the log entry for an individual entry in a
+ * bucket, so that it is in the cache by the time enumerateBucket() gets
+ * to it.
+ *
+ * \param reference
+ *      An entry in the HashTable bucket.
+ * \param cookie
+ *      Unused; present to conform to the HashTable::forEachInBucket
+ *      interface.
+ */
+static void
+prefetchBucketEntry(uint64_t reference, void* cookie)
+{
+    Log::Reference(reference).prefetch();
+}
+
 /**
  * Appends objects to a buffer. Each object is a uint32_t size and a complete,
  * serialized Object.
@@ -124,34 +171,46 @@ enumerateBucket(uint64_t reference, void* cookie)
  *      and data. True means that the returned objects have
  *      been truncated so that the object data (normally the last
  *      field of the object) is omitted.       
+ * \param filter
+ *      If non-NULL, objects that don't match this filter are skipped, and
+ *      only the part of each value it selects is returned.
  */
 static int64_t
 appendObjectsToBuffer(Log& log,
                       Buffer* buffer,
                       std::vector<Log::Reference>& references,
-                      uint32_t maxBytes, bool keysOnly)
+                      uint32_t maxBytes, bool keysOnly,
+                      const ObjectFilter* filter)
 {
     for (uint32_t index = 0; index < references.size(); index++) {
         Buffer objectBuffer;
         log.getEntry(references[index], objectBuffer);
 
         Object object(objectBuffer);
-        uint32_t length = objectBuffer.getTotalLength();
-        if (keysOnly) {
-            uint32_t dataLength = object.getValueLength();
-            length -= dataLength;
+        if (filter != NULL && !filter->matches(object))
+            continue;
+
+        // Everything up to the end of the keys is always returned, followed
+        // by whatever part of the value was asked for.
+        uint32_t totalLength = objectBuffer.getTotalLength();
+        uint32_t keysEnd = totalLength - object.getValueLength();
+        uint32_t valueStart = keysEnd;
+        uint32_t valueLength = keysOnly ? 0 : object.getValueLength();
+        if (filter != NULL && !keysOnly) {
+            uint32_t offset;
+            valueLength = filter->getValueRange(object, &offset);
+            valueStart = totalLength - object.getKeysAndValueLength() + offset;
         }
+        uint32_t length = keysEnd + valueLength;
 
         if (buffer->getTotalLength() + sizeof(length) + length > maxBytes) {
             return index;
         }
 
         new(buffer, APPEND) uint32_t(length);
-        Buffer::Iterator it(objectBuffer, 0, length);
-        while (!it.isDone()) {
-            buffer->append(it.getData(), it.getLength());
-            it.next();
-        }
+        Buffer::Chunk::appendToBuffer(buffer, &objectBuffer, 0, keysEnd);
+        Buffer::Chunk::appendToBuffer(buffer, &objectBuffer, valueStart,
+                                      valueLength);
     }
 
     return -1;
@@ -238,6 +297,12 @@ class ObjectHashComparator {
  *      A Buffer to hold the resulting objects.
  * \param maxPayloadBytes
  *      The maximum number of bytes of objects to be returned.
+ * \param snapshotManager
+ *      If non-NULL, perform a snapshot enumeration using snapshots kept
+ *      here. NULL means objects are returned as they are now.
+ * \param filter
+ *      If non-NULL, only objects matching this filter are returned, and
+ *      only the parts of their values it selects.
  */
 Enumeration::Enumeration(uint64_t tableId,
                          bool keysOnly,
@@ -248,7 +313,9 @@ Enumeration::Enumeration(uint64_t tableId,
                          EnumerationIterator& iter,
                          Log& log,
                          HashTable& objectMap,
-                         Buffer& payload, uint32_t maxPayloadBytes)
+                         Buffer& payload, uint32_t maxPayloadBytes,
+                         SnapshotManager* snapshotManager,
+                         const ObjectFilter* filter)
     : tableId(tableId)
     , keysOnly(keysOnly)
     , requestedTabletStartHash(requestedTabletStartHash)
@@ -260,6 +327,8 @@ Enumeration::Enumeration(uint64_t tableId,
     , objectMap(objectMap)
     , payload(payload)
     , maxPayloadBytes(maxPayloadBytes)
+    , snapshotManager(snapshotManager)
+    , filter(filter)
 {
 }
 
@@ -269,8 +338,13 @@ Enumeration::Enumeration(uint64_t tableId,
  * the table), iter will be filled with the state to be returned to
  * the client, and nextTabletStartHash will be set to the next tablet
  * for the client to iterate.
+ *
+ * \return
+ *      STATUS_OK, or STATUS_SNAPSHOT_EXPIRED if this is a snapshot
+ *      enumeration whose snapshot no longer exists; in that case nothing
+ *      is returned and the client must start the tablet over.
  */
-void
+Status
 Enumeration::complete()
 {
     // Check iterator state to see if the tablet configuration has
@@ -286,6 +360,21 @@ Enumeration::complete()
         iter.push(frame);
     }
 
+    // Snapshot enumerations pin a snapshot of the tablet the first time
+    // they get here. If the snapshot has gone away (the client took longer
+    // than the lease between RPCs, or the tablet moved), continuing with a
+    // new one would mix two views of the tablet, so the client has to
+    // start over.
+    if (snapshotManager != NULL) {
+        uint64_t& snapshotId = iter.top().snapshotId;
+        if (snapshotId == 0) {
+            snapshotId = snapshotManager->create(tableId,
+                    actualTabletStartHash, actualTabletEndHash);
+        } else if (!snapshotManager->renew(snapshotId)) {
+            return STATUS_SNAPSHOT_EXPIRED;
+        }
+    }
+
     uint64_t bucketIndex = iter.top().bucketIndex;
     uint64_t numBuckets = objectMap.getNumBuckets();
     uint32_t bucketStart;
@@ -298,13 +387,50 @@ Enumeration::complete()
     args.log = &log;
     args.iter = &iter;
     args.objectReferences = &objectRefs;
+    args.preserved = NULL;
+    std::vector<uint64_t> bucketRefs;
+    std::vector<SnapshotManager::PreservedObject> preserved;
     void* cookie = static_cast<void*>(&args);
     for (; bucketIndex < numBuckets && !payloadFull; bucketIndex++) {
+        // Walking the buckets in order is a stream of cache misses, first
+        // on the buckets and then on the log entries they refer to. Stay
+        // ahead of the cursor: fetch buckets two strides ahead, and the
+        // entries of buckets one stride ahead, whose cache lines should
+        // have arrived by now.
+        if (bucketIndex + 2 * PREFETCH_STRIDE < numBuckets)
+            objectMap.prefetchBucketAtIndex(bucketIndex + 2 * PREFETCH_STRIDE);
+        if (bucketIndex + PREFETCH_STRIDE < numBuckets) {
+            objectMap.forEachInBucket(prefetchBucketEntry, NULL,
+                                      bucketIndex + PREFETCH_STRIDE);
+        }
+
         objectRefs.clear();
         bucketStart = payload.getTotalLength();
-        objectMap.forEachInBucket(enumerateBucket, cookie, bucketIndex);
+        if (snapshotManager == NULL) {
+            objectMap.forEachInBucket(enumerateBucket, cookie, bucketIndex);
+        } else {
+            // Read the bucket before the snapshot: writers preserve the old
+            // version before updating the hash table, so any update seen
+            // in the bucket is sure to be in the snapshot.
+            bucketRefs.clear();
+            preserved.clear();
+            objectMap.forEachInBucket(collectBucketEntry, &bucketRefs,
+                                      bucketIndex);
+            snapshotManager->getPreserved(iter.top().snapshotId, bucketIndex,
+                                          &preserved);
+            args.preserved = &preserved;
+            foreach (uint64_t reference, bucketRefs)
+                enumerateBucket(reference, cookie);
+            args.preserved = NULL;
+            foreach (const SnapshotManager::PreservedObject& object,
+                     preserved) {
+                if (object.reference != 0)
+                    enumerateBucket(object.reference, cookie);
+            }
+        }
         int64_t overflow = appendObjectsToBuffer(log, &payload, objectRefs,
-                                                 maxPayloadBytes, keysOnly);
+                                                 maxPayloadBytes, keysOnly,
+                                                 filter);
         payloadFull = overflow >= 0;
     }
 
@@ -320,7 +446,8 @@ Enumeration::complete()
             std::sort(objectRefs.begin(), objectRefs.end(), comparator);
 
             int64_t overflow = appendObjectsToBuffer(log, &payload, objectRefs,
-                                                     maxPayloadBytes, keysOnly);
+                                                     maxPayloadBytes, keysOnly,
+                                                     filter);
             if (overflow >= 0) {
                 LogEntryType type;
                 Buffer buffer;
@@ -339,6 +466,8 @@ Enumeration::complete()
     *nextTabletStartHash = requestedTabletStartHash;
     if (bucketIndex >= numBuckets &&
             payload.getTotalLength() == initialPayloadLength) {
+        if (snapshotManager != NULL)
+            snapshotManager->release(iter.top().snapshotId);
         while (iter.size() > 0 &&
                iter.top().tabletEndHash <= actualTabletEndHash) {
             iter.pop();
@@ -348,6 +477,7 @@ Enumeration::complete()
         // roll around to 0.
         *nextTabletStartHash = actualTabletEndHash + 1;
     }
+    return STATUS_OK;
 }
 
 } // namespace RAMCloud
@@ -20,6 +20,8 @@
 #include "EnumerationIterator.h"
 #include "HashTable.h"
 #include "Log.h"
+#include "ObjectFilter.h"
+#include "SnapshotManager.h"
 
 namespace RAMCloud {
 
@@ -33,6 +35,11 @@ namespace RAMCloud {
  * until the buffer fills up. The Enumeration also updates the
  * provided EnumerationIterator with the state necessary to resume on
  * the next EnumerationRPC.
+ *
+ * Normally, each bucket is read as it is when the Enumeration reaches it,
+ * so a long enumeration sees a mix of old and new data. A snapshot
+ * enumeration instead returns each object as it was when the server
+ * started enumerating the tablet (see SnapshotManager).
  */
 class Enumeration {
   public:
@@ -45,10 +52,17 @@ class Enumeration {
                 EnumerationIterator& iter,
                 Log& log,
                 HashTable& objectMap,
-                Buffer& payload, uint32_t maxPayloadBytes);
-    void complete();
+                Buffer& payload, uint32_t maxPayloadBytes,
+                SnapshotManager* snapshotManager = NULL,
+                const ObjectFilter* filter = NULL);
+    Status complete();
 
   PRIVATE:
+    /// How many buckets ahead of the one being enumerated complete()
+    /// prefetches log entries; buckets themselves are prefetched twice
+    /// this far ahead.
+    static const uint64_t PREFETCH_STRIDE = 4;
+
     /// The table containing the tablet being enumerated.
     uint64_t tableId;
 
@@ -84,6 +98,15 @@ class Enumeration {
 
     /// The maximum number of bytes of objects to be returned.
     uint32_t maxPayloadBytes;
+
+    /// If non-NULL, this is a snapshot enumeration: objects are returned as
+    /// they were when the server first started enumerating the tablet, with
+    /// the help of a snapshot kept here.
+    SnapshotManager* snapshotManager;
+
+    /// If non-NULL, only objects matching this filter are returned, and
+    /// only the parts of their values it selects.
+    const ObjectFilter* filter;
 };
 
 }
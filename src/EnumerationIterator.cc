@@ -33,16 +33,21 @@ namespace RAMCloud {
  * \param bucketNextHash
  *      The next key hash to iterate when resuming inside a
  *      bucket that was too large to fit inside a single RPC.
+ * \param snapshotId
+ *      For snapshot enumerations, the server's snapshot of the tablet;
+ *      zero if there is none.
  */
 EnumerationIterator::Frame::Frame(uint64_t tabletStartHash,
                                   uint64_t tabletEndHash,
                                   uint64_t numBuckets, uint64_t bucketIndex,
-                                  uint64_t bucketNextHash)
+                                  uint64_t bucketNextHash,
+                                  uint64_t snapshotId)
     : tabletStartHash(tabletStartHash)
     , tabletEndHash(tabletEndHash)
     , numBuckets(numBuckets)
     , bucketIndex(bucketIndex)
     , bucketNextHash(bucketNextHash)
+    , snapshotId(snapshotId)
 {
 }
 
@@ -66,7 +71,7 @@ EnumerationIterator::EnumerationIterator(Buffer& buffer,
         frames.push_back(Frame(
             frame.tablet_start_hash(), frame.tablet_end_hash(),
             frame.num_buckets(), frame.bucket_index(),
-            frame.bucket_next_hash()));
+            frame.bucket_next_hash(), frame.snapshot_id()));
     }
 }
 
@@ -157,6 +162,8 @@ EnumerationIterator::serialize(Buffer& buffer)
         part.set_num_buckets(frame.numBuckets);
         part.set_bucket_index(frame.bucketIndex);
         part.set_bucket_next_hash(frame.bucketNextHash);
+        if (frame.snapshotId != 0)
+            part.set_snapshot_id(frame.snapshotId);
     }
     ProtoBuf::serializeToResponse(&buffer, &message);
 
@@ -76,7 +76,7 @@ class EnumerationIterator {
     struct Frame {
         Frame(uint64_t tabletStartHash, uint64_t tabletEndHash,
               uint64_t numBuckets, uint64_t bucketIndex,
-              uint64_t bucketNextHash);
+              uint64_t bucketNextHash, uint64_t snapshotId = 0);
 
         /// The smallest key hash value for the tablet being enumerated.
         uint64_t tabletStartHash;
@@ -102,6 +102,11 @@ class EnumerationIterator {
         /// in a table of size \c numBuckets, and if its key hash is less
         /// than this, then it has already been enumerated.
         uint64_t bucketNextHash;
+
+        /// For snapshot enumerations, identifies the snapshot of the tablet
+        /// kept by the server currently owning it (see SnapshotManager).
+        /// Zero means none has been created yet.
+        uint64_t snapshotId;
     };
 
     EnumerationIterator(Buffer& buffer, uint32_t offset, uint32_t length);
@@ -434,6 +434,19 @@ HashTable::prefetchBucket(KeyHash keyHash)
     prefetch(findBucket(keyHash, &dummy));
 }
 
+/**
+ * Prefetch the first cacheline of the bucket with the given index. Used
+ * when walking the table in bucket order, e.g. during enumeration.
+ *
+ * \param bucket
+ *      An index into the HashTable's buckets.  Must be < #numBuckets.
+ */
+void
+HashTable::prefetchBucketAtIndex(uint64_t bucket)
+{
+    prefetch(&buckets.get()[bucket]);
+}
+
 /**
  * Return the number of bytes per cache line.
  */
@@ -212,6 +212,7 @@ class HashTable {
                              uint64_t bucket);
     uint64_t forEach(void (*callback)(uint64_t, void *), void *cookie);
     void prefetchBucket(KeyHash keyHash);
+    void prefetchBucketAtIndex(uint64_t bucket);
     static uint32_t bytesPerCacheLine();
     static uint32_t entriesPerCacheLine();
     uint64_t getNumBuckets() const;
@@ -0,0 +1,578 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <memory>
+
+#include "HotKeyCache.h"
+#include "AbstractServerList.h"
+#include "ClientException.h"
+#include "Cycles.h"
+#include "MasterClient.h"
+#include "Object.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a HotKeyCache with no hot keys and no copies.
+ *
+ * \param context
+ *      Overall information about the server; used to pick masters to hold
+ *      copies and to communicate with them.
+ * \param serverId
+ *      This master's id, once it has enlisted.
+ * \param numReplicas
+ *      Number of other masters each hot key is copied to. If 0, this master
+ *      never copies its own objects, but still holds copies for others.
+ */
+HotKeyCache::HotKeyCache(Context* context, ServerId* serverId,
+                         uint32_t numReplicas)
+    : context(context)
+    , serverId(serverId)
+    , numReplicas(numReplicas)
+    , sampleInterval(SAMPLE_INTERVAL)
+    , readCount(0)
+    , mutex("HotKeyCache::mutex")
+    , samples()
+    , numSamples(0)
+    , nextPushId(0)
+    , numHotKeys(0)
+    , hotKeys()
+    , pendingInvalidations()
+    , outstandingInvalidations(0)
+    , copies()
+    , syncMutex()
+{
+}
+
+HotKeyCache::~HotKeyCache()
+{
+}
+
+/**
+ * Called by the owner of an object after each successful read of it. Now
+ * and then the read is sampled, and if it shows that the key is hot, the
+ * caller is asked to push copies of the object to other masters.
+ *
+ * \param key
+ *      The key that was read.
+ * \return
+ *      0 in the common case. Otherwise the caller must read the object
+ *      (including keys) and pass it to replicate() along with this value.
+ */
+uint64_t
+HotKeyCache::recordRead(Key& key)
+{
+    if (numReplicas == 0)
+        return 0;
+    if (readCount.fetch_add(1, std::memory_order_relaxed) % sampleInterval)
+        return 0;
+
+    KeyHash keyHash = key.getHash();
+    uint64_t now = Cycles::rdtsc();
+    Lock lock(mutex);
+
+    uint32_t count = ++samples[keyHash];
+    if (++numSamples >= SAMPLE_WINDOW) {
+        samples.clear();
+        numSamples = 0;
+
+        // Forget keys whose copies have all expired; they haven't been read
+        // enough to be renewed.
+        for (HotKeyMap::iterator it = hotKeys.begin(); it != hotKeys.end(); ) {
+            if (it->second.pushId == 0 && it->second.waitUntil <= now)
+                it = hotKeys.erase(it);
+            else
+                ++it;
+        }
+        numHotKeys = downCast<uint32_t>(hotKeys.size());
+    }
+
+    HotKeyMap::iterator it = hotKeys.find(keyHash);
+    if (it != hotKeys.end()) {
+        // Copies are renewed as long as the key is read at least once per
+        // half lease, so that clients never see them lapse.
+        HotKey& hotKey = it->second;
+        if (!matches(hotKey.tableId, hotKey.key, key) || hotKey.pushId != 0)
+            return 0;
+        uint64_t halfLease = Cycles::fromNanoseconds(LEASE_MS * 500000UL);
+        if (hotKey.leaseExpiration > now + halfLease)
+            return 0;
+        hotKey.pushId = ++nextPushId;
+        hotKey.grantTime = now;
+        return hotKey.pushId;
+    }
+
+    if (count < HOT_THRESHOLD || hotKeys.size() >= MAX_HOT_KEYS)
+        return 0;
+    std::vector<ServerId> replicas;
+    chooseReplicas(keyHash, &replicas);
+    if (replicas.empty())
+        return 0;
+
+    HotKey& hotKey = hotKeys.insert({keyHash,
+                                     HotKey(key, ++nextPushId)}).first->second;
+    hotKey.grantTime = now;
+    hotKey.replicas = replicas;
+    numHotKeys = downCast<uint32_t>(hotKeys.size());
+    LOG(DEBUG, "Copying hot key in table %lu (hash 0x%lx) to %lu masters",
+        key.getTableId(), keyHash, replicas.size());
+    return hotKey.pushId;
+}
+
+/**
+ * Push copies of a hot object to the masters chosen for it, then start
+ * advertising them to clients. If the object is modified while this is
+ * going on, the copies are invalidated by sync() as usual.
+ *
+ * \param pushId
+ *      Return value from recordRead().
+ * \param version
+ *      The object's current version.
+ * \param keysAndValue
+ *      The object's keys and value, as returned by ObjectManager::readObject.
+ */
+void
+HotKeyCache::replicate(uint64_t pushId, uint64_t version, Buffer& keysAndValue)
+{
+    uint64_t leaseCycles = Cycles::fromNanoseconds(LEASE_MS * 1000000UL);
+    std::vector<ServerId> replicas;
+    uint64_t tableId;
+    uint64_t grantTime;
+    uint32_t leaseMs;
+    {
+        Lock lock(mutex);
+        HotKeyMap::iterator it = hotKeys.begin();
+        while (it != hotKeys.end() && it->second.pushId != pushId)
+            ++it;
+        if (it == hotKeys.end())
+            return;
+        replicas = it->second.replicas;
+        tableId = it->second.tableId;
+        grantTime = it->second.grantTime;
+
+        // The copies are sent the time left on the lease granted when
+        // recordRead issued pushId, so that they expire relative to the
+        // grant rather than to their arrival.
+        uint64_t now = Cycles::rdtsc();
+        uint64_t elapsed = now - grantTime;
+        leaseMs = (elapsed >= leaseCycles) ? 0 : downCast<uint32_t>(
+                Cycles::toNanoseconds(leaseCycles - elapsed) / 1000000);
+        if (leaseMs == 0) {
+            // Too late; the next sampled read will try again.
+            it->second.pushId = 0;
+            return;
+        }
+
+        // Until the pushes complete we don't know when the new copies
+        // expire; be generous.
+        it->second.waitUntil = std::max(it->second.waitUntil,
+                now + 2 * leaseCycles);
+    }
+
+    std::vector<std::unique_ptr<CacheHotObjectRpc>> rpcs;
+    foreach (ServerId id, replicas) {
+        rpcs.emplace_back(new CacheHotObjectRpc(context, id, tableId, version,
+                                                leaseMs, keysAndValue));
+    }
+    std::vector<ServerId> accepted;
+    string locators;
+    for (size_t i = 0; i < rpcs.size(); i++) {
+        try {
+            rpcs[i]->wait();
+            locators += context->serverList->getLocator(replicas[i]);
+            locators.push_back('\0');
+            accepted.push_back(replicas[i]);
+        } catch (const ClientException& e) {
+            // Most likely the master crashed, so it can't serve a copy
+            // either; in any case, don't advertise it.
+        } catch (const ServerListException& e) {
+        }
+    }
+    uint64_t now = Cycles::rdtsc();
+
+    Lock lock(mutex);
+    HotKeyMap::iterator it = hotKeys.begin();
+    while (it != hotKeys.end() && it->second.pushId != pushId)
+        ++it;
+    if (it == hotKeys.end()) {
+        // The object was modified in the meantime; the copies have been
+        // (or are being) invalidated.
+        return;
+    }
+    if (accepted.empty()) {
+        hotKeys.erase(it);
+        numHotKeys = downCast<uint32_t>(hotKeys.size());
+        return;
+    }
+    HotKey& hotKey = it->second;
+    hotKey.pushId = 0;
+    hotKey.replicas = accepted;
+    hotKey.locators = locators;
+    hotKey.leaseExpiration = grantTime + leaseCycles;
+
+    // A holder's lease started when the copy arrived, which was before now.
+    hotKey.waitUntil = std::max(hotKey.waitUntil,
+            now + Cycles::fromNanoseconds(leaseMs * 1000000UL));
+}
+
+/**
+ * Called by the owner of an object after reading it for a client. If
+ * other masters hold current copies of the object, tell the client where
+ * they are.
+ *
+ * \param key
+ *      The key that was read.
+ * \param buffer
+ *      The service locators of the masters holding copies are appended
+ *      here, each followed by a null character.
+ * \param[out] leaseMs
+ *      Set to the number of milliseconds for which the copies remain valid,
+ *      if any locators were appended.
+ * \return
+ *      The number of bytes appended to \a buffer.
+ */
+uint32_t
+HotKeyCache::appendReplicaLocators(Key& key, Buffer* buffer, uint32_t* leaseMs)
+{
+    if (numHotKeys.load() == 0)
+        return 0;
+
+    uint64_t now = Cycles::rdtsc();
+    Lock lock(mutex);
+    HotKeyMap::iterator it = hotKeys.find(key.getHash());
+    if (it == hotKeys.end())
+        return 0;
+    HotKey& hotKey = it->second;
+    if (!matches(hotKey.tableId, hotKey.key, key) ||
+            hotKey.leaseExpiration <= now)
+        return 0;
+
+    uint32_t length = downCast<uint32_t>(hotKey.locators.size());
+    buffer->appendCopy(hotKey.locators.data(), length);
+    *leaseMs = downCast<uint32_t>(
+            Cycles::toNanoseconds(hotKey.leaseExpiration - now) / 1000000);
+    return length;
+}
+
+/**
+ * Called by ObjectManager whenever an object is written or removed, while
+ * still holding the lock for the object's hash table bucket. If other
+ * masters hold copies of the object, they stop being advertised right away
+ * and are invalidated by the next call to sync().
+ *
+ * \param key
+ *      The object's primary key.
+ * \param version
+ *      The version of the new object, or for removes, the version any
+ *      future object with this key will at least have.
+ */
+void
+HotKeyCache::noteWrite(Key& key, uint64_t version)
+{
+    if (numHotKeys.load() == 0)
+        return;
+
+    Lock lock(mutex);
+    HotKeyMap::iterator it = hotKeys.find(key.getHash());
+    if (it == hotKeys.end() || !matches(it->second.tableId, it->second.key,
+                                        key))
+        return;
+    pendingInvalidations.emplace_back(it->second, version);
+    outstandingInvalidations++;
+    hotKeys.erase(it);
+    numHotKeys = downCast<uint32_t>(hotKeys.size());
+}
+
+/**
+ * Called when this master stops owning a tablet. Copies of its objects on
+ * other masters are invalidated by the next call to sync(), since the new
+ * owner (if any) doesn't know about them.
+ *
+ * \param tableId
+ *      The table containing the tablet.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ */
+void
+HotKeyCache::noteTabletDropped(uint64_t tableId, uint64_t firstKeyHash,
+                               uint64_t lastKeyHash)
+{
+    if (numHotKeys.load() == 0)
+        return;
+
+    Lock lock(mutex);
+    for (HotKeyMap::iterator it = hotKeys.begin(); it != hotKeys.end(); ) {
+        if (it->second.tableId == tableId && it->first >= firstKeyHash &&
+                it->first <= lastKeyHash) {
+            pendingInvalidations.emplace_back(it->second, ~0UL);
+            outstandingInvalidations++;
+            it = hotKeys.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    numHotKeys = downCast<uint32_t>(hotKeys.size());
+}
+
+/**
+ * Invalidate the copies of every object that has been modified since the
+ * last call. Returns once no copy older than those modifications can be
+ * served: either its holder has acknowledged the invalidation, or its
+ * lease has run out. ObjectManager::syncChanges calls this, so the copies
+ * of an object are gone by the time a modification is acknowledged.
+ */
+void
+HotKeyCache::sync()
+{
+    if (outstandingInvalidations.load() == 0)
+        return;
+
+    // If another thread is already invalidating, it may be handling our
+    // modifications, so wait for it to finish.
+    std::lock_guard<std::mutex> _(syncMutex);
+    std::vector<Invalidation> batch;
+    {
+        Lock lock(mutex);
+        batch.swap(pendingInvalidations);
+    }
+    if (batch.empty())
+        return;
+
+    std::vector<std::unique_ptr<InvalidateHotObjectRpc>> rpcs;
+    std::vector<uint64_t> leaseEnds;
+    foreach (Invalidation& invalidation, batch) {
+        foreach (ServerId id, invalidation.replicas) {
+            rpcs.emplace_back(new InvalidateHotObjectRpc(context, id,
+                    invalidation.tableId, invalidation.key.data(),
+                    downCast<uint16_t>(invalidation.key.size()),
+                    invalidation.version));
+            leaseEnds.push_back(invalidation.waitUntil);
+        }
+    }
+
+    uint64_t waitUntil = 0;
+    for (size_t i = 0; i < rpcs.size(); i++) {
+        try {
+            rpcs[i]->wait();
+        } catch (const ClientException& e) {
+            waitUntil = std::max(waitUntil, leaseEnds[i]);
+        }
+    }
+    if (waitUntil != 0) {
+        TEST_LOG("waiting for copies to expire");
+        while (Cycles::rdtsc() < waitUntil)
+            usleep(100);
+    }
+    outstandingInvalidations -= downCast<uint32_t>(batch.size());
+}
+
+/**
+ * Handle a CACHE_HOT_OBJECT request: keep a read-only copy of another
+ * master's object.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param version
+ *      Version of the object.
+ * \param leaseMs
+ *      The copy may be served for this many milliseconds: the time that was
+ *      left on the owner's lease when it sent the copy. 0 means the lease
+ *      ran out before the copy was sent; the copy is ignored.
+ * \param keysAndValue
+ *      Buffer containing the object's keys and value.
+ * \param offset
+ *      Offset of the keys and value within \a keysAndValue.
+ * \param length
+ *      Number of bytes of keys and value.
+ */
+void
+HotKeyCache::storeCopy(uint64_t tableId, uint64_t version, uint32_t leaseMs,
+                       Buffer& keysAndValue, uint32_t offset, uint32_t length)
+{
+    if (leaseMs == 0)
+        return;
+    Object object(tableId, version, 0, keysAndValue, offset, length);
+    KeyLength keyLength = 0;
+    const void* keyString = object.getKey(0, &keyLength);
+    uint16_t valueOffset = 0;
+    if (keyString == NULL || !object.getValueOffset(&valueOffset))
+        return;
+    Key key(tableId, keyString, keyLength);
+
+    uint64_t now = Cycles::rdtsc();
+    Lock lock(mutex);
+    CopyMap::iterator it = copies.find(key.getHash());
+    if (it == copies.end()) {
+        if (copies.size() >= MAX_COPIES)
+            purgeExpiredCopies(lock);
+        if (copies.size() >= MAX_COPIES)
+            return;
+        it = copies.insert({key.getHash(), Copy()}).first;
+    } else if (it->second.leaseExpiration <= now) {
+        it->second = Copy();
+    } else if (!matches(it->second.tableId, it->second.key, key) ||
+               version < it->second.minVersion ||
+               version < it->second.version) {
+        // Either a different key with the same hash, or a push that was
+        // overtaken by an invalidation or a newer push.
+        return;
+    }
+
+    Copy& copy = it->second;
+    copy.tableId = tableId;
+    copy.key.assign(static_cast<const char*>(keyString), keyLength);
+    copy.value.resize(length - valueOffset);
+    keysAndValue.copy(offset + valueOffset, length - valueOffset,
+                      &copy.value[0]);
+    copy.version = version;
+    copy.minVersion = version;
+    copy.valid = true;
+    copy.leaseExpiration = now + Cycles::fromNanoseconds(leaseMs * 1000000UL);
+}
+
+/**
+ * Handle a read of an object that this master doesn't own by serving the
+ * copy it holds, if any.
+ *
+ * \param key
+ *      The object's primary key.
+ * \param value
+ *      If a valid copy exists, its value is appended here.
+ * \param[out] version
+ *      Set to the version of the copy, if one exists.
+ * \return
+ *      True if the read was served from a copy.
+ */
+bool
+HotKeyCache::readCopy(Key& key, Buffer* value, uint64_t* version)
+{
+    uint64_t now = Cycles::rdtsc();
+    Lock lock(mutex);
+    CopyMap::iterator it = copies.find(key.getHash());
+    if (it == copies.end())
+        return false;
+    Copy& copy = it->second;
+    if (!copy.valid || copy.leaseExpiration <= now ||
+            !matches(copy.tableId, copy.key, key))
+        return false;
+    value->appendCopy(copy.value.data(),
+                      downCast<uint32_t>(copy.value.size()));
+    *version = copy.version;
+    return true;
+}
+
+/**
+ * Handle an INVALIDATE_HOT_OBJECT request: stop serving a copy, and ignore
+ * pushes of older versions for as long as a copy could have been valid.
+ *
+ * \param key
+ *      The object's primary key.
+ * \param version
+ *      Copies with older versions must never be served again.
+ */
+void
+HotKeyCache::invalidateCopy(Key& key, uint64_t version)
+{
+    // A push granted before the write may still be on its way; the owner
+    // allows up to two leases for pushes to complete (see replicate), so
+    // remember the invalidation that long.
+    uint64_t now = Cycles::rdtsc();
+    uint64_t leaseEnd = now +
+            Cycles::fromNanoseconds(2 * LEASE_MS * 1000000UL);
+    Lock lock(mutex);
+    CopyMap::iterator it = copies.find(key.getHash());
+    if (it == copies.end()) {
+        // The invalidation overtook the push it's meant for; remember it.
+        if (copies.size() >= MAX_COPIES)
+            purgeExpiredCopies(lock);
+        it = copies.insert({key.getHash(), Copy()}).first;
+    } else if (!matches(it->second.tableId, it->second.key, key)) {
+        if (it->second.leaseExpiration > now)
+            return;
+        it->second = Copy();
+    }
+
+    Copy& copy = it->second;
+    copy.tableId = key.getTableId();
+    copy.key.assign(static_cast<const char*>(key.getStringKey()),
+                    key.getStringKeyLength());
+    copy.value.clear();
+    copy.valid = false;
+    copy.minVersion = std::max(copy.minVersion, version);
+    copy.leaseExpiration = std::max(copy.leaseExpiration, leaseEnd);
+}
+
+/**
+ * Pick the masters that should hold copies of a hot key. Different keys
+ * start at different points in the server list so that several hot keys
+ * don't all land on the same masters.
+ *
+ * \param keyHash
+ *      Hash of the hot key.
+ * \param[out] replicas
+ *      Up to #numReplicas masters other than this one are appended here.
+ */
+void
+HotKeyCache::chooseReplicas(KeyHash keyHash, std::vector<ServerId>* replicas)
+{
+    std::vector<ServerId> masters;
+    bool end = false;
+    ServerId id;
+    while (true) {
+        id = context->serverList->nextServer(id, {WireFormat::MASTER_SERVICE},
+                                             &end);
+        if (end || !id.isValid())
+            break;
+        if (id != *serverId)
+            masters.push_back(id);
+    }
+    for (size_t i = 0; i < masters.size() && i < numReplicas; i++)
+        replicas->push_back(masters[(keyHash + i) % masters.size()]);
+}
+
+/**
+ * Return whether a key stored in a HotKey or Copy is the same as another.
+ */
+bool
+HotKeyCache::matches(uint64_t tableId, const string& key, Key& other)
+{
+    return tableId == other.getTableId() &&
+           key.size() == other.getStringKeyLength() &&
+           memcmp(key.data(), other.getStringKey(), key.size()) == 0;
+}
+
+/**
+ * Discard all copies (and remembered invalidations) whose leases have run
+ * out.
+ *
+ * \param lock
+ *      Ensures that the caller holds #mutex.
+ */
+void
+HotKeyCache::purgeExpiredCopies(const Lock& lock)
+{
+    uint64_t now = Cycles::rdtsc();
+    for (CopyMap::iterator it = copies.begin(); it != copies.end(); ) {
+        if (it->second.leaseExpiration <= now)
+            it = copies.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,276 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_HOTKEYCACHE_H
+#define RAMCLOUD_HOTKEYCACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Buffer.h"
+#include "Key.h"
+#include "ServerId.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * Spreads reads of a master's most popular objects across other masters.
+ * Normally every read of an object goes to the master that owns its
+ * tablet, so a single very popular key limits the whole cluster to what
+ * one master can serve. Each master samples the reads it serves; once a
+ * key accounts for a large share of the samples, the master pushes a
+ * read-only copy of the object to a few other masters and tells clients
+ * reading the key where the copies are. Clients then send their reads of
+ * that key round-robin to the owner and the copies.
+ *
+ * Copies are held under short leases, which the owner renews for as long
+ * as the key stays hot. Before a write, remove, or increment of a copied
+ * object is acknowledged, syncChanges() has the owner invalidate every
+ * copy; if a holder can't be reached, the owner waits until its lease has
+ * run out instead. Invalidations carry the object's new version and holders
+ * remember them until the lease would have ended, so a copy that was
+ * pushed before the write but arrives after the invalidation is dropped.
+ * If the owner crashes, copies may be served until their leases run out,
+ * which is much shorter than the time it takes to recover the tablet.
+ *
+ * Every master plays both roles: the "owner" half of this class keeps
+ * track of which of its objects have copies elsewhere, and the "holder"
+ * half stores the copies other masters have sent it.
+ *
+ * This class is thread-safe. When the master has no copied objects, the
+ * write path costs a single atomic load.
+ */
+class HotKeyCache {
+  public:
+    HotKeyCache(Context* context, ServerId* serverId, uint32_t numReplicas);
+    ~HotKeyCache();
+
+    // Used by the owner of objects.
+    uint64_t recordRead(Key& key);
+    void replicate(uint64_t pushId, uint64_t version, Buffer& keysAndValue);
+    uint32_t appendReplicaLocators(Key& key, Buffer* buffer,
+                                   uint32_t* leaseMs);
+    void noteWrite(Key& key, uint64_t version);
+    void noteTabletDropped(uint64_t tableId, uint64_t firstKeyHash,
+                           uint64_t lastKeyHash);
+    void sync();
+
+    // Used by the holders of copies.
+    void storeCopy(uint64_t tableId, uint64_t version, uint32_t leaseMs,
+                   Buffer& keysAndValue, uint32_t offset, uint32_t length);
+    bool readCopy(Key& key, Buffer* value, uint64_t* version);
+    void invalidateCopy(Key& key, uint64_t version);
+
+    /// Reads are sampled once every this many reads.
+    static const uint32_t SAMPLE_INTERVAL = 64;
+
+    /// Sample counts are reset after this many samples, so that keys that
+    /// are no longer hot eventually stop being copied.
+    static const uint32_t SAMPLE_WINDOW = 1024;
+
+    /// A key is hot once it accounts for this many samples in a window
+    /// (about 3% of the master's reads).
+    static const uint32_t HOT_THRESHOLD = 32;
+
+    /// Most keys a master copies to other masters at once.
+    static const uint32_t MAX_HOT_KEYS = 64;
+
+    /// Most copies a master holds for other masters at once.
+    static const uint32_t MAX_COPIES = 1024;
+
+    /// How long a copy may be served after the owner decides to push it.
+    /// Must be much shorter than crash recovery takes.
+    static const uint32_t LEASE_MS = 100;
+
+  PRIVATE:
+    /**
+     * An object of this master's that has (or is being given) copies on
+     * other masters.
+     */
+    struct HotKey {
+        HotKey(Key& key, uint64_t pushId)
+            : tableId(key.getTableId())
+            , key(static_cast<const char*>(key.getStringKey()),
+                  key.getStringKeyLength())
+            , pushId(pushId)
+            , grantTime(0)
+            , replicas()
+            , locators()
+            , leaseExpiration(0)
+            , waitUntil(0)
+        {}
+
+        /// The table containing the object.
+        uint64_t tableId;
+
+        /// The object's primary key.
+        string key;
+
+        /// Identifies the most recent call to recordRead() that asked for
+        /// copies to be pushed; 0 once that push has completed.
+        uint64_t pushId;
+
+        /// Cycles::rdtsc() time at which #pushId was issued. The copies'
+        /// leases are measured from here, not from when they arrive.
+        uint64_t grantTime;
+
+        /// Masters that have been sent copies.
+        std::vector<ServerId> replicas;
+
+        /// Service locators of the masters in #replicas that accepted the
+        /// most recent push, each followed by a null character, in the form
+        /// returned to clients.
+        string locators;
+
+        /// Cycles::rdtsc() time at which the most recent copies expire; they
+        /// aren't advertised to clients after this.
+        uint64_t leaseExpiration;
+
+        /// Cycles::rdtsc() time before which no copy can have expired; a
+        /// write must wait until then if it can't invalidate a copy.
+        uint64_t waitUntil;
+    };
+
+    /**
+     * Copies that must be invalidated before syncChanges() returns.
+     */
+    struct Invalidation {
+        Invalidation(HotKey& hotKey, uint64_t version)
+            : tableId(hotKey.tableId)
+            , key(hotKey.key)
+            , version(version)
+            , replicas(hotKey.replicas)
+            , waitUntil(hotKey.waitUntil)
+        {}
+
+        /// Identifies the object.
+        uint64_t tableId;
+        string key;
+
+        /// Holders must not serve copies older than this version.
+        uint64_t version;
+
+        /// The masters to invalidate.
+        std::vector<ServerId> replicas;
+
+        /// See HotKey::waitUntil.
+        uint64_t waitUntil;
+    };
+
+    /**
+     * A copy of another master's object held by this master. Invalidated
+     * copies are kept (without their values) until their leases would
+     * have run out, so that stale pushes can be recognized.
+     */
+    struct Copy {
+        Copy()
+            : tableId(0)
+            , key()
+            , value()
+            , version(0)
+            , minVersion(0)
+            , valid(false)
+            , leaseExpiration(0)
+        {}
+
+        /// Identifies the object.
+        uint64_t tableId;
+        string key;
+
+        /// The object's value.
+        string value;
+
+        /// Version of #value.
+        uint64_t version;
+
+        /// Pushes of versions older than this are ignored.
+        uint64_t minVersion;
+
+        /// True if #value may be served.
+        bool valid;
+
+        /// Cycles::rdtsc() time after which the entry is discarded.
+        uint64_t leaseExpiration;
+    };
+
+    typedef std::unordered_map<KeyHash, HotKey> HotKeyMap;
+    typedef std::unordered_map<KeyHash, Copy> CopyMap;
+    typedef std::lock_guard<SpinLock> Lock;
+
+    void chooseReplicas(KeyHash keyHash, std::vector<ServerId>* replicas);
+    static bool matches(uint64_t tableId, const string& key, Key& other);
+    void purgeExpiredCopies(const Lock& lock);
+
+    /// Shared information about the server.
+    Context* context;
+
+    /// This master's id; it is never chosen to hold a copy.
+    ServerId* serverId;
+
+    /// Number of other masters each hot key is copied to; 0 disables the
+    /// owner half of this class.
+    uint32_t numReplicas;
+
+    /// Number of reads between samples; only changed by unit tests.
+    uint32_t sampleInterval;
+
+    /// Counts reads so that one in #sampleInterval can be sampled.
+    std::atomic<uint64_t> readCount;
+
+    /// Protects all of the members below.
+    SpinLock mutex;
+
+    /// Number of samples for each key hash in the current window.
+    std::unordered_map<KeyHash, uint32_t> samples;
+
+    /// Total number of samples in the current window.
+    uint32_t numSamples;
+
+    /// Used to generate HotKey::pushId values.
+    uint64_t nextPushId;
+
+    /// Current number of entries in #hotKeys; lets the write path skip
+    /// taking #mutex when there are none.
+    std::atomic<uint32_t> numHotKeys;
+
+    /// This master's objects that have copies elsewhere, indexed by key
+    /// hash. Keys whose hashes collide with a hot key are never copied.
+    HotKeyMap hotKeys;
+
+    /// Copies waiting to be invalidated by sync().
+    std::vector<Invalidation> pendingInvalidations;
+
+    /// Number of invalidations queued but not yet complete, including any
+    /// that sync() is working on.
+    std::atomic<uint32_t> outstandingInvalidations;
+
+    /// Copies held for other masters, indexed by key hash. Keys whose hashes
+    /// collide with an existing entry are not cached.
+    CopyMap copies;
+
+    /// Serializes calls to sync() that have work to do, so that a caller
+    /// doesn't return while another thread is still invalidating copies
+    /// on its behalf.
+    std::mutex syncMutex;
+
+    DISALLOW_COPY_AND_ASSIGN(HotKeyCache);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_HOTKEYCACHE_H
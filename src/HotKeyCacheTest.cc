@@ -0,0 +1,452 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "HotKeyCache.h"
+#include "MasterService.h"
+#include "MockCluster.h"
+#include "Object.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+class HotKeyCacheTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Server* servers[3];
+    Server* owner;
+    Server* holders[2];
+    Tub<RamCloud> ramcloud;
+    uint64_t tableId;
+
+    // The table's owner copies hot keys to both other masters. Every read
+    // is sampled.
+    HotKeyCacheTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , servers()
+        , owner()
+        , holders()
+        , ramcloud()
+        , tableId()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.master.hotKeyReplicas = 2;
+        for (int i = 0; i < 3; i++) {
+            config.localLocator = format("mock:host=master%d", i + 1);
+            servers[i] = cluster.addServer(config);
+        }
+        ramcloud.construct(&context, "mock:host=coordinator");
+
+        tableId = ramcloud->createTable("table");
+        string ownerLocator =
+                ramcloud->objectFinder.lookupTablet(tableId, 0)->serviceLocator;
+        int numHolders = 0;
+        for (int i = 0; i < 3; i++) {
+            if (servers[i]->config.localLocator == ownerLocator)
+                owner = servers[i];
+            else
+                holders[numHolders++] = servers[i];
+        }
+        ownerCache()->sampleInterval = 1;
+    }
+
+    ~HotKeyCacheTest()
+    {
+        Cycles::mockTscValue = 0;
+    }
+
+    HotKeyCache*
+    ownerCache()
+    {
+        return owner->master->objectManager.getHotKeyCache();
+    }
+
+    HotKeyCache*
+    holderCache(int i)
+    {
+        return holders[i]->master->objectManager.getHotKeyCache();
+    }
+
+    /// Give a cache a copy of an object with key "k" in table 1.
+    void
+    store(HotKeyCache* cache, const char* value, uint64_t version)
+    {
+        Buffer keysAndValue;
+        keysAndValue.appendCopy("junk", 4);
+        Key key(1, "k", 1);
+        Object::appendKeysAndValueToBuffer(key, value,
+                downCast<uint32_t>(strlen(value)), keysAndValue);
+        cache->storeCopy(1, version, HotKeyCache::LEASE_MS, keysAndValue, 4,
+                         keysAndValue.getTotalLength() - 4);
+    }
+
+    /// Read key "k" in table 1 from a cache's copies.
+    string
+    read(HotKeyCache* cache)
+    {
+        Key key(1, "k", 1);
+        Buffer value;
+        uint64_t version;
+        if (!cache->readCopy(key, &value, &version))
+            return "none";
+        return format("%s v%lu", TestUtil::toString(&value).c_str(),
+                      version);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(HotKeyCacheTest);
+};
+
+TEST_F(HotKeyCacheTest, recordRead_threshold) {
+    Key key(tableId, "hot", 3);
+    Key other(tableId, "cold", 4);
+    for (uint32_t i = 1; i < HotKeyCache::HOT_THRESHOLD; i++) {
+        EXPECT_EQ(0U, ownerCache()->recordRead(key));
+        EXPECT_EQ(0U, ownerCache()->recordRead(other));
+    }
+    uint64_t pushId = ownerCache()->recordRead(key);
+    EXPECT_NE(0U, pushId);
+    EXPECT_EQ(1U, ownerCache()->hotKeys.size());
+    EXPECT_EQ(2U, ownerCache()->hotKeys.begin()->second.replicas.size());
+
+    // Nothing more happens until the push completes.
+    EXPECT_EQ(0U, ownerCache()->recordRead(key));
+}
+
+TEST_F(HotKeyCacheTest, recordRead_disabled) {
+    Key key(tableId, "hot", 3);
+    HotKeyCache* cache = holderCache(0);
+    cache->sampleInterval = 1;
+    cache->numReplicas = 0;
+    for (uint32_t i = 0; i < 2 * HotKeyCache::HOT_THRESHOLD; i++)
+        EXPECT_EQ(0U, cache->recordRead(key));
+    EXPECT_EQ(0U, cache->samples.size());
+}
+
+TEST_F(HotKeyCacheTest, recordRead_renewal) {
+    Key key(tableId, "hot", 3);
+    ramcloud->write(tableId, "hot", 3, "value", 5);
+    uint64_t pushId = 0;
+    while (pushId == 0)
+        pushId = ownerCache()->recordRead(key);
+    Buffer keysAndValue;
+    uint64_t version;
+    owner->master->objectManager.readObject(key, &keysAndValue, NULL,
+                                            &version);
+    ownerCache()->replicate(pushId, version, keysAndValue);
+    uint64_t leaseExpiration =
+            ownerCache()->hotKeys.begin()->second.leaseExpiration;
+
+    // Copies are only renewed once half of their lease has gone by.
+    Cycles::mockTscValue = leaseExpiration -
+            Cycles::fromNanoseconds(HotKeyCache::LEASE_MS * 600000UL);
+    EXPECT_EQ(0U, ownerCache()->recordRead(key));
+    Cycles::mockTscValue = leaseExpiration -
+            Cycles::fromNanoseconds(HotKeyCache::LEASE_MS * 400000UL);
+    EXPECT_NE(0U, ownerCache()->recordRead(key));
+}
+
+TEST_F(HotKeyCacheTest, replicate) {
+    ramcloud->write(tableId, "hot", 3, "value", 5);
+    Key key(tableId, "hot", 3);
+    uint64_t pushId = 0;
+    while (pushId == 0)
+        pushId = ownerCache()->recordRead(key);
+    Buffer keysAndValue;
+    uint64_t version;
+    owner->master->objectManager.readObject(key, &keysAndValue, NULL,
+                                            &version);
+    ownerCache()->replicate(pushId, version, keysAndValue);
+
+    Buffer value;
+    uint64_t copyVersion;
+    EXPECT_TRUE(holderCache(0)->readCopy(key, &value, &copyVersion));
+    EXPECT_EQ("value", TestUtil::toString(&value));
+    EXPECT_EQ(version, copyVersion);
+    EXPECT_TRUE(holderCache(1)->readCopy(key, &value, &copyVersion));
+
+    Buffer locators;
+    uint32_t leaseMs = 0;
+    uint32_t length = ownerCache()->appendReplicaLocators(key, &locators,
+                                                           &leaseMs);
+    EXPECT_EQ(locators.getTotalLength(), length);
+    EXPECT_NE(string::npos, TestUtil::toString(&locators).find(
+            holders[0]->config.localLocator));
+    EXPECT_NE(string::npos, TestUtil::toString(&locators).find(
+            holders[1]->config.localLocator));
+    EXPECT_LE(leaseMs, HotKeyCache::LEASE_MS);
+
+    // Stale push ids are ignored.
+    ownerCache()->replicate(pushId, version, keysAndValue);
+    ownerCache()->replicate(pushId + 1, version, keysAndValue);
+}
+
+TEST_F(HotKeyCacheTest, replicate_leaseFromGrant) {
+    ramcloud->write(tableId, "hot", 3, "value", 5);
+    Key key(tableId, "hot", 3);
+    uint64_t pushId = 0;
+    while (pushId == 0)
+        pushId = ownerCache()->recordRead(key);
+    HotKeyCache::HotKey& hotKey = ownerCache()->hotKeys.begin()->second;
+    uint64_t leaseCycles =
+            Cycles::fromNanoseconds(HotKeyCache::LEASE_MS * 1000000UL);
+    Buffer keysAndValue;
+    uint64_t version;
+    owner->master->objectManager.readObject(key, &keysAndValue, NULL,
+                                            &version);
+
+    // The copies expire a lease after the grant, however long the push
+    // took to start.
+    Cycles::mockTscValue = hotKey.grantTime + leaseCycles / 2;
+    ownerCache()->replicate(pushId, version, keysAndValue);
+    EXPECT_EQ(hotKey.grantTime + leaseCycles, hotKey.leaseExpiration);
+    Cycles::mockTscValue += leaseCycles / 2 + leaseCycles / 10;
+    EXPECT_EQ("none", read(holderCache(0)));
+}
+
+TEST_F(HotKeyCacheTest, replicate_grantLapsed) {
+    ramcloud->write(tableId, "hot", 3, "value", 5);
+    Key key(tableId, "hot", 3);
+    uint64_t pushId = 0;
+    while (pushId == 0)
+        pushId = ownerCache()->recordRead(key);
+    HotKeyCache::HotKey& hotKey = ownerCache()->hotKeys.begin()->second;
+    Buffer keysAndValue;
+    uint64_t version;
+    owner->master->objectManager.readObject(key, &keysAndValue, NULL,
+                                            &version);
+
+    Cycles::mockTscValue = hotKey.grantTime +
+            Cycles::fromNanoseconds(HotKeyCache::LEASE_MS * 1000000UL);
+    ownerCache()->replicate(pushId, version, keysAndValue);
+    EXPECT_EQ(0U, hotKey.pushId);
+    Buffer value;
+    uint64_t copyVersion;
+    EXPECT_FALSE(holderCache(0)->readCopy(key, &value, &copyVersion));
+}
+
+TEST_F(HotKeyCacheTest, appendReplicaLocators_notHot) {
+    Key key(tableId, "hot", 3);
+    Buffer locators;
+    uint32_t leaseMs = 0;
+    EXPECT_EQ(0U, ownerCache()->appendReplicaLocators(key, &locators,
+                                                       &leaseMs));
+
+    // Not advertised until the push completes.
+    while (ownerCache()->recordRead(key) == 0) {
+    }
+    EXPECT_EQ(0U, ownerCache()->appendReplicaLocators(key, &locators,
+                                                       &leaseMs));
+    EXPECT_EQ(0U, locators.getTotalLength());
+}
+
+TEST_F(HotKeyCacheTest, noteWrite_and_sync) {
+    Key key(tableId, "hot", 3);
+    ramcloud->write(tableId, "hot", 3, "value", 5);
+    uint64_t pushId = 0;
+    while (pushId == 0)
+        pushId = ownerCache()->recordRead(key);
+    Buffer keysAndValue;
+    uint64_t version;
+    owner->master->objectManager.readObject(key, &keysAndValue, NULL,
+                                            &version);
+    ownerCache()->replicate(pushId, version, keysAndValue);
+
+    Key other(tableId, "other", 5);
+    ownerCache()->noteWrite(other, 10);
+    EXPECT_EQ(0U, ownerCache()->outstandingInvalidations);
+
+    ownerCache()->noteWrite(key, version + 1);
+    EXPECT_EQ(1U, ownerCache()->outstandingInvalidations);
+    EXPECT_EQ(0U, ownerCache()->numHotKeys);
+    Buffer value;
+    uint64_t copyVersion;
+    EXPECT_TRUE(holderCache(0)->readCopy(key, &value, &copyVersion));
+
+    ownerCache()->sync();
+    EXPECT_EQ(0U, ownerCache()->outstandingInvalidations);
+    EXPECT_FALSE(holderCache(0)->readCopy(key, &value, &copyVersion));
+    EXPECT_FALSE(holderCache(1)->readCopy(key, &value, &copyVersion));
+
+    // The push of the old version was overtaken by the invalidation.
+    holderCache(0)->storeCopy(tableId, version, HotKeyCache::LEASE_MS,
+                              keysAndValue, 0,
+                              keysAndValue.getTotalLength());
+    EXPECT_FALSE(holderCache(0)->readCopy(key, &value, &copyVersion));
+}
+
+TEST_F(HotKeyCacheTest, noteTabletDropped) {
+    Key key(tableId, "hot", 3);
+    while (ownerCache()->recordRead(key) == 0) {
+    }
+    ownerCache()->noteTabletDropped(tableId + 1, 0, ~0UL);
+    EXPECT_EQ(1U, ownerCache()->numHotKeys);
+    ownerCache()->noteTabletDropped(tableId, 0, key.getHash() - 1);
+    EXPECT_EQ(1U, ownerCache()->numHotKeys);
+    ownerCache()->noteTabletDropped(tableId, key.getHash(), ~0UL);
+    EXPECT_EQ(0U, ownerCache()->numHotKeys);
+    EXPECT_EQ(1U, ownerCache()->pendingInvalidations.size());
+    EXPECT_EQ(~0UL, ownerCache()->pendingInvalidations[0].version);
+    ownerCache()->sync();
+    EXPECT_EQ(0U, ownerCache()->outstandingInvalidations);
+}
+
+TEST_F(HotKeyCacheTest, sync_holderDown) {
+    Key key(tableId, "hot", 3);
+    while (ownerCache()->recordRead(key) == 0) {
+    }
+    ownerCache()->hotKeys.begin()->second.replicas = {ServerId(99, 0)};
+    ownerCache()->hotKeys.begin()->second.waitUntil = 1;
+    ownerCache()->noteWrite(key, 5);
+    TestLog::reset();
+    ownerCache()->sync();
+    EXPECT_NE(string::npos,
+              TestLog::get().find("sync: waiting for copies to expire"));
+    EXPECT_EQ(0U, ownerCache()->outstandingInvalidations);
+}
+
+TEST_F(HotKeyCacheTest, storeCopy_basics) {
+    HotKeyCache* cache = holderCache(0);
+    EXPECT_EQ("none", read(cache));
+    store(cache, "abc", 5);
+    EXPECT_EQ("abc v5", read(cache));
+    store(cache, "old", 4);
+    EXPECT_EQ("abc v5", read(cache));
+    store(cache, "new", 6);
+    EXPECT_EQ("new v6", read(cache));
+}
+
+TEST_F(HotKeyCacheTest, storeCopy_leaseExpires) {
+    HotKeyCache* cache = holderCache(0);
+    Cycles::mockTscValue = 1000;
+    store(cache, "abc", 5);
+    EXPECT_EQ("abc v5", read(cache));
+    Cycles::mockTscValue = 1000 +
+            Cycles::fromNanoseconds(HotKeyCache::LEASE_MS * 1000000UL);
+    EXPECT_EQ("none", read(cache));
+
+    // Expired entries are replaced, even by older versions.
+    store(cache, "older", 3);
+    EXPECT_EQ("older v3", read(cache));
+}
+
+TEST_F(HotKeyCacheTest, storeCopy_leaseLapsed) {
+    HotKeyCache* cache = holderCache(0);
+    Buffer keysAndValue;
+    Key key(1, "k", 1);
+    Object::appendKeysAndValueToBuffer(key, "abc", 3, keysAndValue);
+    cache->storeCopy(1, 5, 0, keysAndValue, 0, keysAndValue.getTotalLength());
+    EXPECT_EQ("none", read(cache));
+}
+
+TEST_F(HotKeyCacheTest, storeCopy_full) {
+    HotKeyCache* cache = holderCache(0);
+    Cycles::mockTscValue = 1000;
+    for (uint32_t i = 0; i < HotKeyCache::MAX_COPIES; i++)
+        cache->copies[i + 1].leaseExpiration = 2000;
+    store(cache, "abc", 5);
+    EXPECT_EQ("none", read(cache));
+
+    // Expired copies make room.
+    Cycles::mockTscValue = 3000;
+    store(cache, "abc", 5);
+    EXPECT_EQ("abc v5", read(cache));
+    EXPECT_EQ(1U, cache->copies.size());
+}
+
+TEST_F(HotKeyCacheTest, readCopy_otherKey) {
+    HotKeyCache* cache = holderCache(0);
+    store(cache, "abc", 5);
+    Key key(2, "k", 1);
+    Buffer value;
+    uint64_t version;
+    EXPECT_FALSE(cache->readCopy(key, &value, &version));
+}
+
+TEST_F(HotKeyCacheTest, invalidateCopy) {
+    HotKeyCache* cache = holderCache(0);
+    Key key(1, "k", 1);
+    store(cache, "abc", 5);
+    cache->invalidateCopy(key, 6);
+    EXPECT_EQ("none", read(cache));
+    store(cache, "abc", 5);
+    EXPECT_EQ("none", read(cache));
+    store(cache, "def", 6);
+    EXPECT_EQ("def v6", read(cache));
+}
+
+TEST_F(HotKeyCacheTest, invalidateCopy_beforePush) {
+    HotKeyCache* cache = holderCache(0);
+    Key key(1, "k", 1);
+    Cycles::mockTscValue = 1000;
+    cache->invalidateCopy(key, 7);
+    store(cache, "abc", 6);
+    EXPECT_EQ("none", read(cache));
+
+    // Pushes may be in flight for up to two leases.
+    Cycles::mockTscValue = 1000 +
+            Cycles::fromNanoseconds(HotKeyCache::LEASE_MS * 1500000UL);
+    store(cache, "abc", 6);
+    EXPECT_EQ("none", read(cache));
+    store(cache, "def", 7);
+    EXPECT_EQ("def v7", read(cache));
+}
+
+TEST_F(HotKeyCacheTest, endToEnd) {
+    ramcloud->write(tableId, "hot", 3, "value1", 6);
+    Buffer value;
+    for (uint32_t i = 0; i < HotKeyCache::HOT_THRESHOLD; i++)
+        ramcloud->read(tableId, "hot", 3, &value);
+    EXPECT_EQ("value1", TestUtil::toString(&value));
+    EXPECT_EQ(1U, ramcloud->objectFinder.replicaMap.size());
+
+    // Reads are spread across the copies and the owner.
+    for (int i = 0; i < 3; i++) {
+        ramcloud->read(tableId, "hot", 3, &value);
+        EXPECT_EQ("value1", TestUtil::toString(&value));
+    }
+    EXPECT_EQ(1U, holderCache(0)->copies.size());
+    EXPECT_EQ(1U, holderCache(1)->copies.size());
+
+    // A write invalidates the copies before it returns. The key is still
+    // hot, so the next read from the owner pushes new ones.
+    ramcloud->write(tableId, "hot", 3, "value2", 6);
+    Key key(tableId, "hot", 3);
+    uint64_t version;
+    EXPECT_FALSE(holderCache(0)->readCopy(key, &value, &version));
+    EXPECT_FALSE(holderCache(1)->readCopy(key, &value, &version));
+    for (int i = 0; i < 4; i++) {
+        ramcloud->read(tableId, "hot", 3, &value);
+        EXPECT_EQ("value2", TestUtil::toString(&value));
+    }
+    EXPECT_TRUE(holderCache(0)->readCopy(key, &value, &version));
+
+    // Reads with reject rules always go to the owner.
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.doesntExist = 1;
+    ramcloud->read(tableId, "hot", 3, &value, &rules);
+    EXPECT_EQ("value2", TestUtil::toString(&value));
+}
+
+}  // namespace RAMCloud
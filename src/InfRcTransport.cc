@@ -149,6 +149,7 @@ InfRcTransport::InfRcTransport(Context* context,
     , transmitCycleCounter()
     , serverRpcPool()
     , clientRpcPool()
+    , zeroCopyReplies()
     , deadQueuePairs()
     , testingDontReallySend(false)
 {
@@ -292,6 +293,11 @@ InfRcTransport::~InfRcTransport()
         close(serverSetupSocket);
     if (clientSetupSocket != -1)
         close(clientSetupSocket);
+    while (!zeroCopyReplies.empty()) {
+        ServerRpc& rpc = zeroCopyReplies.front();
+        zeroCopyReplies.pop_front();
+        serverRpcPool.destroy(&rpc);
+    }
 }
 
 void
@@ -840,6 +846,16 @@ InfRcTransport::reapTxBuffers()
             reinterpret_cast<BufferDescriptor*>(retArray[i].wr_id);
         freeTxBuffers.push_back(bd);
 
+        // If this was a reply sent from log memory, its RPC can go now.
+        // There are at most MAX_TX_QUEUE_DEPTH of them.
+        foreach (ServerRpc& rpc, zeroCopyReplies) {
+            if (rpc.txBuffer == bd) {
+                zeroCopyReplies.erase(zeroCopyReplies.iterator_to(rpc));
+                serverRpcPool.destroy(&rpc);
+                break;
+            }
+        }
+
         if (retArray[i].status != IBV_WC_SUCCESS) {
             LOG(ERROR, "Transmit failed for buffer %lu: %s",
                 reinterpret_cast<uint64_t>(bd),
@@ -864,6 +880,132 @@ InfRcTransport::reapTxBuffers()
     return n;
 }
 
+/**
+ * Post a message for transmit by the HCA attempting to zero-copy any
+ * data from registered buffers (currently only seglets which are part of
+ * the log). Transparently handles buffers with more chunks than the
+ * scatter-gather entry limit and buffers which mix registered and
+ * non-registered chunks.
+ *
+ * The HCA reads zero-copied chunks after this method returns, so the caller
+ * must keep them alive until the transmit buffer returned in \a txBuffer
+ * has been reaped. For log memory that means keeping the RPC (and hence
+ * its ServerRpcPool epoch) outstanding, so that the cleaner won't free the
+ * seglets.
+ *
+ * \param message
+ *      Buffer containing the message to transmit.
+ * \param qp
+ *      Queue pair to transmit the message on.
+ * \param[out] txBuffer
+ *      If non-NULL, the transmit buffer used for the message is returned
+ *      here; reapTxBuffers() returns it once the HCA has finished with it.
+ * \return
+ *      True if any part of the message was sent directly from registered
+ *      log memory.
+ */
+bool
+InfRcTransport::sendZeroCopy(Buffer* message, QueuePair* qp,
+                             BufferDescriptor** txBuffer)
+{
+    const bool allowZeroCopy = true;
+    uint32_t numSges = message->getNumberChunks();
+    if (message->getNumberChunks() > MAX_TX_SGE_COUNT)
+        numSges = MAX_TX_SGE_COUNT;
+    ibv_sge isge[numSges];
+
+    uint32_t currentChunk = 0;
+    uint32_t currentSge = 0;
+    bool zeroCopied = false;
+    BufferDescriptor* bd = getTransmitBuffer();
+    char* unaddedStart = bd->buffer;
+    char* unaddedEnd = bd->buffer;
+    Buffer::Iterator it(*message);
+    while (!it.isDone()) {
+        const uintptr_t addr = reinterpret_cast<const uintptr_t>(it.getData());
+        if (allowZeroCopy &&
+            (currentChunk == message->getNumberChunks() - 1 ||
+             currentSge < numSges - 1) &&
+            addr >= logMemoryBase &&
+            (addr + it.getLength()) <= (logMemoryBase + logMemoryBytes))
+        {
+            if (unaddedStart != unaddedEnd) {
+                isge[currentSge] = {
+                    reinterpret_cast<uint64_t>(unaddedStart),
+                    downCast<uint32_t>(unaddedEnd - unaddedStart),
+                    bd->mr->lkey
+                };
+                ++currentSge;
+                unaddedStart = unaddedEnd;
+            }
+
+            isge[currentSge] = {
+                addr,
+                it.getLength(),
+                logMemoryRegion->lkey
+            };
+            ++currentSge;
+            zeroCopied = true;
+        } else {
+            CycleCounter<RawMetric>
+                copyTicks(&metrics->transport.transmit.copyTicks);
+            memcpy(unaddedEnd, it.getData(), it.getLength());
+            unaddedEnd += it.getLength();
+            metrics->transport.transmit.copyByteCount += it.getLength();
+        }
+        it.next();
+        ++currentChunk;
+    }
+    if (unaddedStart != unaddedEnd) {
+        isge[currentSge] = {
+            reinterpret_cast<uint64_t>(unaddedStart),
+            downCast<uint32_t>(unaddedEnd - unaddedStart),
+            bd->mr->lkey
+        };
+        ++currentSge;
+        unaddedStart = unaddedEnd;
+    }
+
+    ibv_send_wr txWorkRequest;
+
+    memset(&txWorkRequest, 0, sizeof(txWorkRequest));
+    txWorkRequest.wr_id = reinterpret_cast<uint64_t>(bd);// stash descriptor ptr
+    txWorkRequest.next = NULL;
+    txWorkRequest.sg_list = isge;
+    txWorkRequest.num_sge = currentSge;
+    txWorkRequest.opcode = IBV_WR_SEND;
+    txWorkRequest.send_flags = IBV_SEND_SIGNALED;
+
+    // We can get a substantial latency improvement (nearly 2usec less per RTT)
+    // by inlining data with the WQE for small messages. The Verbs library
+    // automatically takes care of copying from the SGEs to the WQE.
+    if ((message->getTotalLength()) <= Infiniband::MAX_INLINE_DATA)
+        txWorkRequest.send_flags |= IBV_SEND_INLINE;
+
+    metrics->transport.transmit.iovecCount += currentSge;
+    metrics->transport.transmit.byteCount += message->getTotalLength();
+    if (!transmitCycleCounter) {
+        transmitCycleCounter.construct();
+    }
+    if (txBuffer != NULL)
+        *txBuffer = bd;
+    CycleCounter<RawMetric> _(&metrics->transport.transmit.ticks);
+    ibv_send_wr* badTxWorkRequest;
+    if (expect_true(!testingDontReallySend)) {
+        if (ibv_post_send(qp->qp, &txWorkRequest, &badTxWorkRequest)) {
+            throw TransportException(HERE, "ibv_post_send failed");
+        }
+    } else {
+        for (int i = 0; i < txWorkRequest.num_sge; ++i) {
+            const ibv_sge& sge = txWorkRequest.sg_list[i];
+            TEST_LOG("isge[%d]: %u bytes %s", i, sge.length,
+                     (logMemoryRegion && sge.lkey == logMemoryRegion->lkey) ?
+                     "ZERO-COPY" : "COPIED");
+        }
+    }
+    return zeroCopied;
+}
+
 /**
  * Obtain the maximum rpc size. This is limited by the infiniband
  * specification to 2GB(!), though we artificially limit it to a
@@ -919,14 +1061,20 @@ InfRcTransport::ServerRpc::ServerRpc(InfRcTransport* transport,
     : rpcServiceTime(&ReadRequestHandle_MetricSet::rpcServiceTime, false),
       transport(transport),
       qp(qp),
-      nonce(nonce)
+      nonce(nonce),
+      txBuffer(NULL),
+      zeroCopyEntries()
 { }
 
 /**
  * Send a reply for an RPC.
  *
- * Transmits are done using a copy into a pre-registered HCA buffer.
- * The function blocks until the HCA returns success or failure.
+ * Chunks of the reply that refer to log memory (such as object values,
+ * which ObjectManager appends one chunk per seglet) are transmitted
+ * directly from the log; everything else is copied into a pre-registered
+ * HCA buffer. In the first case the RPC is not destroyed until the HCA
+ * has finished with the log memory (see reapTxBuffers), so its epoch
+ * keeps the cleaner from freeing the seglets in the meantime.
  */
 void
 InfRcTransport::ServerRpc::sendReply()
@@ -942,7 +1090,8 @@ InfRcTransport::ServerRpc::sendReply()
 
     InfRcTransport *t = transport;
 
-    // "t->serverRpcPool.destroy(this);" on our way out of the method
+    // "t->serverRpcPool.destroy(this);" on our way out of the method,
+    // unless the reply refers to log memory.
     ServerRpcPoolGuard<ServerRpc> suicide(t->serverRpcPool, this);
 
     if (replyPayload.getTotalLength() > t->getMaxRpcSize()) {
@@ -953,19 +1102,14 @@ InfRcTransport::ServerRpc::sendReply()
                     t->getMaxRpcSize()));
     }
 
-    BufferDescriptor* bd = t->getTransmitBuffer();
     new(&replyPayload, PREPEND) Header(nonce);
-    {
-        CycleCounter<RawMetric> copyTicks(
-            &metrics->transport.transmit.copyTicks);
-        replyPayload.copy(0, replyPayload.getTotalLength(), bd->buffer);
-    }
-    metrics->transport.transmit.iovecCount += replyPayload.getNumberChunks();
-    metrics->transport.transmit.byteCount += replyPayload.getTotalLength();
-    if (!t->transmitCycleCounter) {
-        t->transmitCycleCounter.construct();
+    if (t->sendZeroCopy(&replyPayload, qp, &txBuffer)) {
+        // Return the request's receive buffers now rather than when the
+        // transmit completes.
+        requestPayload.reset();
+        t->zeroCopyReplies.push_back(*this);
+        suicide.release();
     }
-    t->infiniband->postSend(qp, bd, replyPayload.getTotalLength());
     interval.stop();
 
     replyPayload.truncateFront(sizeof(Header)); // for politeness
@@ -1033,114 +1177,6 @@ InfRcTransport::ClientRpc::ClientRpc(InfRcTransport* transport,
 
 }
 
-/**
- * Post an RPC request for transmit by the HCA attempting to zero-copy any
- * data from registered buffers (currently only seglets which are part of
- * the log). Transparently handles buffers with more chunks than the
- * scatter-gather entry limit and buffers which mix registered and
- * non-registered chunks.
- *
- * \param request
- *      Buffer containing the RPC request which should be transmitted
- *      to the endpoint listening on #session.
- */
-void
-InfRcTransport::ClientRpc::sendZeroCopy(Buffer* request)
-{
-    const bool allowZeroCopy = true;
-    InfRcTransport* const t = transport;
-    uint32_t numSges = request->getNumberChunks();
-    if (request->getNumberChunks() > MAX_TX_SGE_COUNT)
-        numSges = MAX_TX_SGE_COUNT;
-    ibv_sge isge[numSges];
-
-    uint32_t currentChunk = 0;
-    uint32_t currentSge = 0;
-    BufferDescriptor* bd = t->getTransmitBuffer();
-    char* unaddedStart = bd->buffer;
-    char* unaddedEnd = bd->buffer;
-    Buffer::Iterator it(*request);
-    while (!it.isDone()) {
-        const uintptr_t addr = reinterpret_cast<const uintptr_t>(it.getData());
-        if (allowZeroCopy &&
-            (currentChunk == request->getNumberChunks() - 1 ||
-             currentSge < numSges - 1) &&
-            addr >= t->logMemoryBase &&
-            (addr + it.getLength()) <= (t->logMemoryBase + t->logMemoryBytes))
-        {
-            if (unaddedStart != unaddedEnd) {
-                isge[currentSge] = {
-                    reinterpret_cast<uint64_t>(unaddedStart),
-                    downCast<uint32_t>(unaddedEnd - unaddedStart),
-                    bd->mr->lkey
-                };
-                ++currentSge;
-                unaddedStart = unaddedEnd;
-            }
-
-            isge[currentSge] = {
-                addr,
-                it.getLength(),
-                t->logMemoryRegion->lkey
-            };
-            ++currentSge;
-        } else {
-            CycleCounter<RawMetric>
-                copyTicks(&metrics->transport.transmit.copyTicks);
-            memcpy(unaddedEnd, it.getData(), it.getLength());
-            unaddedEnd += it.getLength();
-        }
-        it.next();
-        ++currentChunk;
-    }
-    if (unaddedStart != unaddedEnd) {
-        isge[currentSge] = {
-            reinterpret_cast<uint64_t>(unaddedStart),
-            downCast<uint32_t>(unaddedEnd - unaddedStart),
-            bd->mr->lkey
-        };
-        ++currentSge;
-        unaddedStart = unaddedEnd;
-    }
-
-    ibv_send_wr txWorkRequest;
-
-    memset(&txWorkRequest, 0, sizeof(txWorkRequest));
-    txWorkRequest.wr_id = reinterpret_cast<uint64_t>(bd);// stash descriptor ptr
-    txWorkRequest.next = NULL;
-    txWorkRequest.sg_list = isge;
-    txWorkRequest.num_sge = currentSge;
-    txWorkRequest.opcode = IBV_WR_SEND;
-    txWorkRequest.send_flags = IBV_SEND_SIGNALED;
-
-    // We can get a substantial latency improvement (nearly 2usec less per RTT)
-    // by inlining data with the WQE for small messages. The Verbs library
-    // automatically takes care of copying from the SGEs to the WQE.
-    if ((request->getTotalLength()) <= Infiniband::MAX_INLINE_DATA)
-        txWorkRequest.send_flags |= IBV_SEND_INLINE;
-
-    metrics->transport.transmit.iovecCount += currentSge;
-    metrics->transport.transmit.byteCount += request->getTotalLength();
-    if (!t->transmitCycleCounter) {
-        t->transmitCycleCounter.construct();
-    }
-    CycleCounter<RawMetric> _(&metrics->transport.transmit.ticks);
-    ibv_send_wr* badTxWorkRequest;
-    if (expect_true(!t->testingDontReallySend)) {
-        if (ibv_post_send(session->qp->qp, &txWorkRequest, &badTxWorkRequest)) {
-            throw TransportException(HERE, "ibv_post_send failed");
-        }
-    } else {
-        for (int i = 0; i < txWorkRequest.num_sge; ++i) {
-            const ibv_sge& sge = txWorkRequest.sg_list[i];
-            TEST_LOG("isge[%d]: %u bytes %s", i, sge.length,
-                     (t->logMemoryRegion && sge.lkey ==
-                        t->logMemoryRegion->lkey) ?
-                     "ZERO-COPY" : "COPIED");
-        }
-    }
-}
-
 /**
  * Send the RPC request out onto the network if there is a receive buffer
  * available for its response, or queue it for transmission otherwise.
@@ -1160,7 +1196,7 @@ InfRcTransport::ClientRpc::sendOrQueue()
         ++metrics->transport.transmit.packetCount;
 
         new(request, PREPEND) Header(nonce);
-        sendZeroCopy(request);
+        t->sendZeroCopy(request, session->qp, NULL);
         request->truncateFront(sizeof(Header)); // for politeness
 
         t->outstandingRpcs.push_back(*this);
@@ -117,6 +117,12 @@ class InfRcTransport : public Transport {
             QueuePair*      qp;
             /// Uniquely identifies the RPC.
             uint64_t        nonce;
+            /// Transmit buffer used for the reply; valid once sendReply
+            /// has been called.
+            BufferDescriptor* txBuffer;
+            /// Links this RPC into InfRcTransport::zeroCopyReplies.
+            IntrusiveListHook zeroCopyEntries;
+            friend class InfRcTransport;
             DISALLOW_COPY_AND_ASSIGN(ServerRpc);
     };
 
@@ -131,8 +137,6 @@ class InfRcTransport : public Transport {
             void sendOrQueue();
 
         PRIVATE:
-            void sendZeroCopy(Buffer* buffer);
-
             InfRcTransport*     transport;
             InfRcSession*       session;
 
@@ -182,6 +186,7 @@ class InfRcTransport : public Transport {
     static const uint32_t QP_EXCHANGE_MAX_TIMEOUTS = 10;
 
     INTRUSIVE_LIST_TYPEDEF(ClientRpc, queueEntries) ClientRpcList;
+    INTRUSIVE_LIST_TYPEDEF(ServerRpc, zeroCopyEntries) ServerRpcList;
 
     class InfRcSession : public Session {
       public:
@@ -294,6 +299,10 @@ class InfRcTransport : public Transport {
     // Pull TX buffers from completion queue and add to freeTxBuffers.
     int reapTxBuffers();
 
+    // Post a message for transmission, referring to log memory directly.
+    bool sendZeroCopy(Buffer* message, QueuePair* qp,
+                      BufferDescriptor** txBuffer);
+
     // queue pair connection setup helpers
     QueuePair* clientTrySetupQueuePair(IpAddress& address);
     bool       clientTryExchangeQueuePairs(struct sockaddr_in *sin,
@@ -431,6 +440,12 @@ class InfRcTransport : public Transport {
     /// Allocator for ClientRpc objects.
     ObjectPool<ClientRpc> clientRpcPool;
 
+    /// Server RPCs whose replies were sent (at least partly) straight from
+    /// log memory and whose transmit buffers haven't been reaped yet. They
+    /// stay allocated from #serverRpcPool, and so keep their epochs
+    /// outstanding, until the HCA is done reading the log.
+    ServerRpcList zeroCopyReplies;
+
     /// Name for this machine/application (passed from clients to servers so
     /// servers know who they are talking to).
     static char name[50];
@@ -126,6 +126,33 @@ TEST_F(InfRcTransportTest, ClientRpc_sendZeroCopy) {
     free(page);
 }
 
+TEST_F(InfRcTransportTest, ServerRpc_sendReply_zeroCopy) {
+    MockWrapper rpc("r1");
+    Transport::SessionRef session = client.getSession(locator);
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    Transport::ServerRpc* serverRpc =
+            context.serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+
+    void* page = Memory::xmemalign(HERE, getpagesize(), getpagesize());
+    server.registerMemory(page, getpagesize());
+    server.testingDontReallySend = true;
+    serverRpc->replyPayload.appendCopy("abc", 3);
+    serverRpc->replyPayload.append(page, getpagesize());
+    TestLog::Enable _(sendZeroCopyFilter);
+    serverRpc->sendReply();
+    EXPECT_EQ("sendZeroCopy: isge[0]: 11 bytes COPIED | "
+              "sendZeroCopy: isge[1]: 4096 bytes ZERO-COPY", TestLog::get());
+
+    // The RPC is kept until its transmit buffer is reaped, so that the
+    // log memory stays alive.
+    ASSERT_EQ(1U, server.zeroCopyReplies.size());
+    EXPECT_EQ(serverRpc, &server.zeroCopyReplies.front());
+    EXPECT_EQ(0U, serverRpc->requestPayload.getTotalLength());
+
+    free(page);
+}
+
 TEST_F(InfRcTransportTest, InfRcSession_abort_onClientSendQueue) {
     TestLog::Enable _;
 
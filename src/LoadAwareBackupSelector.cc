@@ -0,0 +1,224 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LoadAwareBackupSelector.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+// --- LoadAwareBackupSelector ---
+
+/**
+ * Constructor.
+ * \param context
+ *      Overall information about this RAMCloud server; used to register
+ *      #tracker with this server's ServerList.
+ * \param serverId
+ *      The ServerId of the master. Used for selecting appropriate primary
+ *      and secondary replicas.
+ * \param numReplicas
+ *      The replication factor of each segment.
+ * \param useMinCopysets
+ *      If true, replicas of a segment are all placed within a single
+ *      replication group, as with MinCopysetsBackupSelector.
+ */
+LoadAwareBackupSelector::LoadAwareBackupSelector(Context* context,
+                                                 const ServerId* serverId,
+                                                 uint32_t numReplicas,
+                                                 bool useMinCopysets)
+    : BackupSelector(context, serverId, numReplicas)
+    , useMinCopysets(useMinCopysets)
+{
+}
+
+/**
+ * From NUM_CANDIDATES random backups that do not conflict with an existing
+ * set of backups, discard those that are overloaded relative to another
+ * candidate and choose the one that minimizes the expected time to read
+ * replicas from disk should this master crash. With MinCopysets only
+ * backups whose entire replication group is available are candidates and
+ * each is judged by the load on its most loaded group member. The ServerId
+ * returned is !isValid() if there is no suitable backup.
+ * \param numBackups
+ *      The number of entries in the \a backupIds array.
+ * \param backupIds
+ *      An array of numBackups backup ids, none of which may conflict with the
+ *      returned backup. All existing replica locations should be listed (the
+ *      server Id of the master itself should not be listed).
+ */
+ServerId
+LoadAwareBackupSelector::selectPrimary(uint32_t numBackups,
+                                       const ServerId backupIds[])
+{
+    ServerId primary;
+    uint64_t primaryWriteUs = 0;
+    for (uint32_t i = 0; i < NUM_CANDIDATES; ++i) {
+        ServerId candidate = BackupSelector::selectSecondary(numBackups,
+                                                             backupIds);
+        if (!candidate.isValid())
+            break;
+        if (useMinCopysets &&
+            !isUsableReplicationGroup(candidate, numBackups, backupIds)) {
+            continue;
+        }
+
+        uint64_t writeUs = getExpectedWriteUs(candidate);
+        if (!primary.isValid() || isOverloaded(primaryWriteUs, writeUs) ||
+            (!isOverloaded(writeUs, primaryWriteUs) &&
+             tracker[candidate]->getExpectedReadMs() <
+             tracker[primary]->getExpectedReadMs())) {
+            primary = candidate;
+            primaryWriteUs = writeUs;
+        }
+    }
+    if (!primary.isValid())
+        return primary;
+
+    BackupStats* stats = tracker[primary];
+    LOG(DEBUG, "Chose server %s with %u primary replicas, %u MB/s disk "
+               "bandwidth, and %lu bytes in flight (expected time to read on "
+               "recovery is %u ms, expected write time is %lu us)",
+               primary.toString().c_str(), stats->primaryReplicaCount,
+               stats->expectedReadMBytesPerSec, stats->bytesInFlight,
+               stats->getExpectedReadMs(), primaryWriteUs);
+    ++stats->primaryReplicaCount;
+
+    return primary;
+}
+
+/**
+ * Choose the backup that is expected to accept writes soonest from among
+ * NUM_CANDIDATES random backups that do not conflict with an existing set
+ * of backups. With MinCopysets the choice is instead made among the
+ * members of the replication group of the first entry of \a backupIds. The
+ * ServerId will be invalid if there is no suitable backup.
+ * \param numBackups
+ *      The number of entries in the \a backupIds array.
+ * \param backupIds
+ *      An array of numBackups backup ids, none of which may conflict with the
+ *      returned backup. All existing replica locations should be listed (the
+ *      server id of the master itself should not be listed).
+ */
+ServerId
+LoadAwareBackupSelector::selectSecondary(uint32_t numBackups,
+                                         const ServerId backupIds[])
+{
+    ServerId secondary;
+    uint64_t secondaryWriteUs = 0;
+
+    if (useMinCopysets) {
+        applyTrackerChanges();
+        if (numBackups == 0 || !backupIds[0].isValid())
+            return ServerId(/* Invalid */);
+        BackupStats* stats = findStats(backupIds[0]);
+        // A replication Id of 0 represents a node without a replication group.
+        if (stats == NULL || stats->replicationId == 0 ||
+            replicationIdMap.count(stats->replicationId) != numReplicas) {
+            return ServerId(/* Invalid */);
+        }
+        auto range = replicationIdMap.equal_range(stats->replicationId);
+        for (replicationIter it = range.first; it != range.second; ++it) {
+            if (conflictWithAny(it->second, numBackups, backupIds))
+                continue;
+            uint64_t writeUs = tracker[it->second]->getExpectedWriteUs();
+            if (!secondary.isValid() || writeUs < secondaryWriteUs) {
+                secondary = it->second;
+                secondaryWriteUs = writeUs;
+            }
+        }
+        return secondary;
+    }
+
+    for (uint32_t i = 0; i < NUM_CANDIDATES; ++i) {
+        ServerId candidate = BackupSelector::selectSecondary(numBackups,
+                                                             backupIds);
+        if (!candidate.isValid())
+            break;
+        uint64_t writeUs = getExpectedWriteUs(candidate);
+        if (!secondary.isValid() || writeUs < secondaryWriteUs) {
+            secondary = candidate;
+            secondaryWriteUs = writeUs;
+        }
+    }
+    return secondary;
+}
+
+// - private -
+
+/**
+ * Return the number of microseconds a write rpc sent to a backup is
+ * expected to take given the load on it (see
+ * BackupStats::getExpectedWriteUs()). With MinCopysets, return the value
+ * for the most loaded member of the backup's replication group instead,
+ * since every segment replicated there is written to all of its members.
+ */
+uint64_t
+LoadAwareBackupSelector::getExpectedWriteUs(ServerId backupId)
+{
+    if (!useMinCopysets)
+        return tracker[backupId]->getExpectedWriteUs();
+
+    uint64_t maxWriteUs = 0;
+    auto range = replicationIdMap.equal_range(
+        tracker[backupId]->replicationId);
+    for (replicationIter it = range.first; it != range.second; ++it) {
+        maxWriteUs = std::max(maxWriteUs,
+                              tracker[it->second]->getExpectedWriteUs());
+    }
+    return maxWriteUs;
+}
+
+/**
+ * Return true if a backup expected to take \a writeUs microseconds to
+ * complete a write is overloaded compared to one expected to take
+ * \a otherWriteUs microseconds. See OVERLOAD_FACTOR.
+ */
+bool
+LoadAwareBackupSelector::isOverloaded(uint64_t writeUs, uint64_t otherWriteUs)
+{
+    return writeUs > otherWriteUs * OVERLOAD_FACTOR + OVERLOAD_SLACK_US;
+}
+
+/**
+ * Return true if all replicas of a segment could be placed in the
+ * replication group of \a backupId: the group must be complete and none of
+ * its members may conflict with existing replicas or with this master.
+ * \param backupId
+ *      A member of the replication group to check.
+ * \param numBackups
+ *      The number of entries in the \a backupIds array.
+ * \param backupIds
+ *      An array of numBackups backup ids, none of which may conflict with
+ *      members of the group.
+ */
+bool
+LoadAwareBackupSelector::isUsableReplicationGroup(ServerId backupId,
+                                                  uint32_t numBackups,
+                                                  const ServerId backupIds[])
+{
+    uint64_t replicationId = tracker[backupId]->replicationId;
+    if (replicationId == 0 ||
+        replicationIdMap.count(replicationId) != numReplicas) {
+        return false;
+    }
+    auto range = replicationIdMap.equal_range(replicationId);
+    for (replicationIter it = range.first; it != range.second; ++it) {
+        if (conflictWithAny(it->second, numBackups, backupIds))
+            return false;
+    }
+    return true;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,87 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_LOADAWAREBACKUPSELECTOR_H
+#define RAMCLOUD_LOADAWAREBACKUPSELECTOR_H
+
+#include "Common.h"
+#include "BackupSelector.h"
+
+namespace RAMCloud {
+
+/**
+ * Selects backups while steering replicas away from backups that are
+ * currently slow to accept writes. The replication latency of a segment is
+ * that of its slowest replica, so a single overloaded backup raises the
+ * durable write latency of every master replicating to it. This selector
+ * uses the write rpc latency and the bytes in flight that ReplicatedSegment
+ * reports for each backup (see BackupStats::getExpectedWriteUs()) to avoid
+ * such backups.
+ *
+ * Primaries are chosen as in BackupSelector (the best of several random
+ * candidates by expected recovery read time), except that candidates which
+ * are expected to take much longer to accept a write than another candidate
+ * are discarded first. Secondaries are the least loaded of several random
+ * candidates.
+ *
+ * If MinCopysets is in use the same ideas are applied to whole replication
+ * groups instead: the primary is chosen from the replication group whose
+ * slowest member is least loaded, and the secondaries are then taken from
+ * that group, so the number of copysets is the same as with
+ * MinCopysetsBackupSelector.
+ */
+class LoadAwareBackupSelector : public BackupSelector {
+  PUBLIC:
+    LoadAwareBackupSelector(Context* context,
+                            const ServerId* serverId,
+                            uint32_t numReplicas,
+                            bool useMinCopysets);
+    ServerId selectPrimary(uint32_t numBackups, const ServerId backupIds[]);
+    ServerId selectSecondary(uint32_t numBackups, const ServerId backupIds[]);
+
+    /// Number of random candidates considered for each selection.
+    static const uint32_t NUM_CANDIDATES = 5;
+
+    /**
+     * A candidate is considered overloaded relative to another if its
+     * expected write time exceeds OVERLOAD_FACTOR times the other's plus
+     * OVERLOAD_SLACK_US. The slack keeps noise in the latencies of
+     * lightly-loaded backups from overriding the recovery read time
+     * balancing done for primaries.
+     */
+    static const uint32_t OVERLOAD_FACTOR = 2;
+
+    /// See OVERLOAD_FACTOR.
+    static const uint32_t OVERLOAD_SLACK_US = 200;
+
+  PRIVATE:
+    uint64_t getExpectedWriteUs(ServerId backupId);
+    bool isOverloaded(uint64_t writeUs, uint64_t otherWriteUs);
+    bool isUsableReplicationGroup(ServerId backupId,
+                                  uint32_t numBackups,
+                                  const ServerId backupIds[]);
+
+    /**
+     * If true then replicas are placed in replication groups as with
+     * MinCopysetsBackupSelector.
+     */
+    bool useMinCopysets;
+
+    DISALLOW_COPY_AND_ASSIGN(LoadAwareBackupSelector);
+};
+
+} // namespace RAMCloud
+
+#endif
@@ -0,0 +1,185 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Common.h"
+#include "LoadAwareBackupSelector.h"
+#include "ServerList.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+struct LoadAwareBackupSelectorTest : public ::testing::Test {
+    TestLog::Enable logEnabler;
+    Context context;
+    ServerList serverList;
+    ServerId masterId;
+    std::vector<ServerId> ids;
+
+    LoadAwareBackupSelectorTest()
+        : logEnabler()
+        , context()
+        , serverList(&context)
+        , masterId(100, 0)
+        , ids()
+    {
+    }
+
+    /**
+     * Add backups with ids 1 through \a count to the server list. Backups
+     * are placed in replication groups of three in the order they are added
+     * (so backups 1-3 are in group 1, 4-6 in group 2, and so on).
+     */
+    void
+    addBackups(uint32_t count)
+    {
+        for (uint32_t i = 1; i <= count; i++) {
+            serverList.testingAdd({{i, 0}, format("mock:host=backup%u", i),
+                                   {WireFormat::BACKUP_SERVICE},
+                                   100, ServerStatus::UP, (i + 2) / 3});
+            ids.push_back(ServerId(i, 0));
+        }
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(LoadAwareBackupSelectorTest);
+};
+
+TEST_F(LoadAwareBackupSelectorTest, selectPrimaryNoHosts) {
+    LoadAwareBackupSelector selector(&context, &masterId, 3, false);
+    EXPECT_EQ(ServerId(), selector.selectPrimary(0, NULL));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, selectPrimaryAvoidsOverloadedBackups) {
+    MockRandom _(1);
+    addBackups(6);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, false);
+    selector.applyTrackerChanges();
+
+    // Candidates are ids[0] through ids[4]. Only ids[2] isn't busy, even
+    // though it would take the longest to read on recovery.
+    selector.tracker[ids[2]]->primaryReplicaCount = 10;
+    selector.signalWriteStarted(ids[0], 8 * 1024 * 1024);
+    selector.signalWriteStarted(ids[1], 8 * 1024 * 1024);
+    selector.signalWriteStarted(ids[3], 8 * 1024 * 1024);
+    selector.signalWriteStarted(ids[4], 8 * 1024 * 1024);
+
+    EXPECT_EQ(ids[2], selector.selectPrimary(0, NULL));
+    EXPECT_EQ(11u, selector.tracker[ids[2]]->primaryReplicaCount);
+}
+
+TEST_F(LoadAwareBackupSelectorTest, selectPrimaryBalancesReadTime) {
+    MockRandom _(1);
+    addBackups(6);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, false);
+    selector.applyTrackerChanges();
+
+    // Small differences in load don't matter; the backup with the
+    // fewest primaries wins.
+    for (uint32_t i = 0; i < 5; i++) {
+        selector.tracker[ids[i]]->primaryReplicaCount = 5;
+        selector.signalWriteStarted(ids[i], 1000 * (5 - i));
+    }
+    selector.tracker[ids[1]]->primaryReplicaCount = 0;
+
+    EXPECT_EQ(ids[1], selector.selectPrimary(0, NULL));
+    EXPECT_EQ(1u, selector.tracker[ids[1]]->primaryReplicaCount);
+}
+
+TEST_F(LoadAwareBackupSelectorTest, selectPrimaryMinCopysets) {
+    MockRandom _(1);
+    addBackups(10);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, true);
+    selector.applyTrackerChanges();
+
+    // Candidates are ids[0] through ids[4]: groups 1 and 2. A single busy
+    // member makes all of group 1 look busy.
+    selector.signalWriteStarted(ids[1], 8 * 1024 * 1024);
+    EXPECT_EQ(ids[3], selector.selectPrimary(0, NULL));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, selectSecondary) {
+    MockRandom _(1);
+    addBackups(5);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, false);
+    selector.applyTrackerChanges();
+
+    selector.signalWriteStarted(ids[0], 3 * 1024 * 1024);
+    selector.signalWriteStarted(ids[1], 1 * 1024 * 1024);
+    selector.signalWriteStarted(ids[2], 2 * 1024 * 1024);
+    selector.signalWriteStarted(ids[3], 4 * 1024 * 1024);
+    selector.signalWriteStarted(ids[4], 5 * 1024 * 1024);
+
+    // Candidates are ids[0], ids[2], ids[3], ids[4], and ids[0] again;
+    // ids[1] is least loaded but conflicts.
+    const ServerId conflicts[] = { ids[1] };
+    EXPECT_EQ(ids[2], selector.selectSecondary(1, conflicts));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, selectSecondaryMinCopysets) {
+    addBackups(10);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, true);
+
+    EXPECT_EQ(ServerId(), selector.selectSecondary(0, NULL));
+
+    selector.applyTrackerChanges();
+    selector.signalWriteStarted(ids[4], 1024 * 1024);
+    const ServerId conflicts[] = { ids[3] };
+    EXPECT_EQ(ids[5], selector.selectSecondary(1, conflicts));
+
+    const ServerId moreConflicts[] = { ids[3], ids[5] };
+    EXPECT_EQ(ids[4], selector.selectSecondary(2, moreConflicts));
+
+    // ids[9] is alone in group 4.
+    const ServerId incomplete[] = { ids[9] };
+    EXPECT_EQ(ServerId(), selector.selectSecondary(1, incomplete));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, getExpectedWriteUs) {
+    addBackups(6);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, false);
+    LoadAwareBackupSelector groupSelector(&context, &masterId, 3, true);
+    selector.applyTrackerChanges();
+    groupSelector.applyTrackerChanges();
+
+    selector.signalWriteStarted(ids[1], 1024 * 1024);
+    groupSelector.signalWriteStarted(ids[1], 1024 * 1024);
+
+    EXPECT_EQ(0u, selector.getExpectedWriteUs(ids[0]));
+    EXPECT_EQ(10000u, selector.getExpectedWriteUs(ids[1]));
+    EXPECT_EQ(10000u, groupSelector.getExpectedWriteUs(ids[0]));
+    EXPECT_EQ(0u, groupSelector.getExpectedWriteUs(ids[3]));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, isOverloaded) {
+    LoadAwareBackupSelector selector(&context, &masterId, 3, false);
+    EXPECT_FALSE(selector.isOverloaded(200, 0));
+    EXPECT_TRUE(selector.isOverloaded(201, 0));
+    EXPECT_FALSE(selector.isOverloaded(400, 100));
+    EXPECT_TRUE(selector.isOverloaded(401, 100));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, isUsableReplicationGroup) {
+    addBackups(10);
+    LoadAwareBackupSelector selector(&context, &masterId, 3, true);
+    selector.applyTrackerChanges();
+
+    EXPECT_TRUE(selector.isUsableReplicationGroup(ids[0], 0, NULL));
+    const ServerId conflicts[] = { ids[2] };
+    EXPECT_FALSE(selector.isUsableReplicationGroup(ids[0], 1, conflicts));
+    EXPECT_TRUE(selector.isUsableReplicationGroup(ids[3], 1, conflicts));
+    EXPECT_FALSE(selector.isUsableReplicationGroup(ids[9], 0, NULL));
+}
+
+} // namespace RAMCloud
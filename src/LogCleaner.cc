@@ -59,6 +59,7 @@ LogCleaner::LogCleaner(Context* context,
       cleanableSegments(segmentManager, config, onDiskMetrics),
       writeCostThreshold(config->master.cleanerWriteCostThreshold),
       disableInMemoryCleaning(config->master.disableInMemoryCleaning),
+      coldDataCompressionAge(config->master.coldDataCompressionAge),
       numThreads(config->master.cleanerThreadCount),
       segletSize(config->segletSize),
       segmentSize(config->segmentSize),
@@ -294,11 +295,14 @@ LogCleaner::doMemoryCleaning()
         localMetrics.totalEmptySegmentsCompacted++;
 
     // Allocate a survivor segment to write into. This call may block if one
-    // is not available right now.
+    // is not available right now. Compressed segments only ever hold cold
+    // data, so their compacted versions are compressed as well.
+    uint32_t flags = SegmentManager::FOR_CLEANING |
+                     SegmentManager::MUST_NOT_FAIL;
+    if (segment->isCompressed())
+        flags |= SegmentManager::COMPRESSED;
     CycleCounter<uint64_t> waitTicks(&localMetrics.waitForFreeSurvivorTicks);
-    LogSegment* survivor = segmentManager.allocSideSegment(
-            SegmentManager::FOR_CLEANING | SegmentManager::MUST_NOT_FAIL,
-            segment);
+    LogSegment* survivor = segmentManager.allocSideSegment(flags, segment);
     assert(survivor != NULL);
     waitTicks.stop();
 
@@ -499,9 +503,13 @@ LogCleaner::computeFreeableSeglets(LogSegment* survivor)
     // ensure that disk cleaning is guaranteed to make forward progress (recall
     // that reordering of entries and segment boundaries can increase the amount
     // of space occupied by live objects if we're unlucky).
-    uint32_t liveBytes = survivor->getLiveBytes();
+    //
+    // Live entries in compressed survivors only take up a fraction of their
+    // length in memory, but we can never free seglets that are still in use.
+    uint32_t liveBytes = survivor->getMemoryBytes(survivor->getLiveBytes());
     uint32_t segletsNeeded = (100 * (liveBytes + segletSize)) /
         segletSize / LogCleaner::MAX_CLEANABLE_MEMORY_UTILIZATION;
+    segletsNeeded = std::max(segletsNeeded, survivor->getSegletsInUse());
 
     if (segletsAllocated > segletsNeeded)
         return segletsAllocated - segletsNeeded;
@@ -604,6 +612,7 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     uint64_t totalEntryBytesAppended = 0;
     uint32_t currentLiveEntries[TOTAL_LOG_ENTRY_TYPES] = { 0 };
     uint32_t currentLiveEntryLengths[TOTAL_LOG_ENTRY_TYPES] = { 0 };
+    uint32_t now = WallTime::secondsTimestamp();
 
     foreach (Entry& entry, entries) {
         Buffer buffer;
@@ -611,10 +620,19 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
             &segmentManager.getAllocator(), &buffer);
         Log::Reference reference = entry.reference;
         uint32_t bytesAppended = 0;
+
+        // Entries are sorted by age, so cold ones all come first. Keep them
+        // in compressed survivors of their own: offering a live entry no
+        // survivor at all makes the relocation fail, which closes the current
+        // survivor and allocates one of the right kind below.
+        bool cold = isCold(entry.timestamp, now);
+        LogSegment* target = survivor;
+        if (target != NULL && target->isCompressed() != cold)
+            target = NULL;
         RelocStatus s = relocateEntry(type,
                                       buffer,
                                       reference,
-                                      survivor,
+                                      target,
                                       localMetrics,
                                       &bytesAppended);
 
@@ -633,11 +651,13 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
 
             // Allocate a survivor segment to write into. This call may block if
             // one is not available right now.
+            uint32_t flags = SegmentManager::FOR_CLEANING |
+                             SegmentManager::MUST_NOT_FAIL;
+            if (cold)
+                flags |= SegmentManager::COMPRESSED;
             CycleCounter<uint64_t> waitTicks(
                 &localMetrics.waitForFreeSurvivorsTicks);
-            survivor = segmentManager.allocSideSegment(
-                SegmentManager::FOR_CLEANING | SegmentManager::MUST_NOT_FAIL,
-                NULL);
+            survivor = segmentManager.allocSideSegment(flags, NULL);
             assert(survivor != NULL);
             waitTicks.stop();
             outSurvivors.push_back(survivor);
@@ -685,6 +705,27 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     return totalEntryBytesAppended;
 }
 
+/**
+ * Decide whether a live entry is cold enough to be written to a compressed
+ * survivor segment.
+ *
+ * \param timestamp
+ *      The entry's timestamp, as returned by LogEntryHandlers::getTimestamp.
+ *      Entries without a timestamp (0) are always considered cold.
+ * \param now
+ *      The current time in seconds (see WallTime::secondsTimestamp).
+ * \return
+ *      True if the entry is cold, false if it isn't or if compression of cold
+ *      data is disabled.
+ */
+bool
+LogCleaner::isCold(uint32_t timestamp, uint32_t now)
+{
+    if (coldDataCompressionAge == 0)
+        return false;
+    return timestamp <= now && now - timestamp >= coldDataCompressionAge;
+}
+
 /**
  * Close a survivor segment we've written data to as part of a disk cleaning
  * pass and tell the replicaManager to begin flushing it asynchronously to
@@ -224,6 +224,7 @@ class LogCleaner {
                           EntryVector& outEntries);
     uint64_t relocateLiveEntries(EntryVector& entries,
                             LogSegmentVector& outSurvivors);
+    bool isCold(uint32_t timestamp, uint32_t now);
     void closeSurvivor(LogSegment* survivor);
     void waitForAvailableSurvivors(size_t count, uint64_t& outTicks);
 
@@ -349,6 +350,11 @@ class LogCleaner {
     /// cleaner will run in its place.
     bool disableInMemoryCleaning;
 
+    /// If nonzero, live entries that have not been modified in at least this
+    /// many seconds are written to compressed survivor segments during disk
+    /// cleaning (see ServerConfig::Master::coldDataCompressionAge).
+    uint32_t coldDataCompressionAge;
+
     /// The number of cleaner threads to run concurrently. More threads will
     /// allow the system to perform more cleaning and compaction in parallel to
     /// keep up with higher write rates and memory utilizations.
@@ -40,6 +40,10 @@ toString(LogEntryType type)
         return "Object Safe Version";
     case LOG_ENTRY_TYPE_TABLESTATS:
         return "Table Stats Digest";
+    case LOG_ENTRY_TYPE_COMPRESSEDREF:
+        return "Compressed Entry Reference";
+    case LOG_ENTRY_TYPE_COMPRESSEDBLOCK:
+        return "Compressed Block";
     default:
         return "<<Unknown>>";
     }
@@ -46,6 +46,14 @@ enum LogEntryType {
     /// See TableStats.h::Digest
     LOG_ENTRY_TYPE_TABLESTATS,
 
+    /// See CompressedSegment.h. Stands in for an entry that is stored in a
+    /// compressed block. Only exists in master memory; never replicated.
+    LOG_ENTRY_TYPE_COMPRESSEDREF,
+
+    /// See CompressedSegment.h. A compressed block of log entries. Only
+    /// exists in master memory; never replicated.
+    LOG_ENTRY_TYPE_COMPRESSEDBLOCK,
+
     /// Not a type, but rather the total number of types we have defined.
     /// This is currently restricted by the lower 6 bits in a uint8_t field
     /// in Segment.h's Segment::EntryHeader. RAMCloud will probably collapse
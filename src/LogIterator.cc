@@ -56,13 +56,28 @@ namespace RAMCloud {
  *
  * Do note that running in parallel with cleaning means that the same entry may
  * be iterated over multiple times (i.e. if the cleaner has relocated it).
+ *
+ * \param log
+ *      The log to iterate over.
+ * \param firstSegmentId
+ *      Skip all segments with identifiers lower than this. Since segment
+ *      identifiers are allocated in increasing order, passing the id of the
+ *      log head at some earlier point in time restricts iteration to entries
+ *      appended since then (plus any entries the cleaner has relocated since).
+ * \param lastSegmentId
+ *      Skip all segments with identifiers higher than this until the limit
+ *      is raised with setLastSegmentId(). By default the iterator continues
+ *      up to and including the head.
  */
-LogIterator::LogIterator(Log& log)
+LogIterator::LogIterator(Log& log, uint64_t firstSegmentId,
+                         uint64_t lastSegmentId)
     : log(log),
       segmentList(),
       currentIterator(),
-      currentSegmentId(Segment::INVALID_SEGMENT_ID),
-      headLocked(false)
+      currentSegmentId(firstSegmentId - 1),
+      headLocked(false),
+      lastSegmentId(lastSegmentId),
+      reachedLastSegment(false)
 {
     log.segmentManager->logIteratorCreated();
 
@@ -106,7 +121,7 @@ LogIterator::isDone()
     if (segmentList.size() > 0)
         return false;
 
-    return headLocked;
+    return headLocked || reachedLastSegment;
 }
 
 /**
@@ -132,6 +147,14 @@ LogIterator::next()
     if (segmentList.size() == 0)
         return;
 
+    if (segmentList.back()->id > lastSegmentId) {
+        // Forget the list; it's repopulated once the limit has been raised,
+        // by which point more segments may have become active.
+        segmentList.clear();
+        reachedLastSegment = true;
+        return;
+    }
+
     if (segmentList.back() == log.head) {
         log.appendLock.lock();
         headLocked = true;
@@ -206,6 +229,28 @@ LogIterator::setBufferTo(Buffer& buffer)
     return appendToBuffer(buffer);
 }
 
+/**
+ * Restrict iteration to segments whose identifiers are no higher than the
+ * given one. Once the iterator reaches a segment beyond the limit, isDone()
+ * returns true until the limit is raised again, at which point iteration
+ * resumes where it left off. Limiting iteration to segments below the head
+ * lets callers walk recently appended entries repeatedly without locking
+ * the head (see MasterService::migrateTablet).
+ *
+ * \param lastSegmentId
+ *      Identifier of the last segment to iterate over. Pass ~0UL to iterate
+ *      up to and including the head.
+ */
+void
+LogIterator::setLastSegmentId(uint64_t lastSegmentId)
+{
+    this->lastSegmentId = lastSegmentId;
+    if (reachedLastSegment) {
+        reachedLastSegment = false;
+        next();
+    }
+}
+
 /******************************************************************************
  * PRIVATE METHODS
  ******************************************************************************/
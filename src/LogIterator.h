@@ -41,7 +41,8 @@ namespace RAMCloud {
  */
 class LogIterator {
   PUBLIC:
-    explicit LogIterator(Log& log);
+    explicit LogIterator(Log& log, uint64_t firstSegmentId = 0,
+                         uint64_t lastSegmentId = ~0UL);
     ~LogIterator();
 
     bool isDone();
@@ -51,6 +52,7 @@ class LogIterator {
     uint32_t getLength();
     uint32_t appendToBuffer(Buffer& buffer);
     uint32_t setBufferTo(Buffer& buffer);
+    void setLastSegmentId(uint64_t lastSegmentId);
 
   PRIVATE:
     /**
@@ -83,6 +85,14 @@ class LogIterator {
     /// Indication that the head is locked and must be unlocked on destruction.
     bool headLocked;
 
+    /// Segments with identifiers higher than this are not iterated over
+    /// until the limit is raised with setLastSegmentId().
+    uint64_t lastSegmentId;
+
+    /// Indication that iteration stopped because the next segment is beyond
+    /// #lastSegmentId.
+    bool reachedLastSegment;
+
     DISALLOW_COPY_AND_ASSIGN(LogIterator);
 };
 
@@ -115,6 +115,43 @@ TEST_F(LogIteratorTest, constructor_multiSegmentLog) {
     EXPECT_EQ(1, segmentManager.logIteratorCount);
 }
 
+TEST_F(LogIteratorTest, constructor_firstSegmentId) {
+    l.sync();
+    while (l.head == NULL || l.head->id == 1)
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    l.sync();
+
+    LogIterator i(l, 2);
+    EXPECT_EQ(0U, i.segmentList.size());
+    EXPECT_TRUE(i.currentIterator);
+    EXPECT_EQ(2U, i.currentSegmentId);
+    EXPECT_TRUE(i.headLocked);
+}
+
+TEST_F(LogIteratorTest, setLastSegmentId) {
+    l.sync();
+    while (l.head == NULL || l.head->id == 1)
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    l.sync();
+
+    LogIterator i(l, 0, 1);
+    int count = 0;
+    for (; !i.isDone(); i.next())
+        count++;
+    EXPECT_LT(0, count);
+    EXPECT_EQ(1U, i.currentSegmentId);
+    EXPECT_TRUE(i.reachedLastSegment);
+    EXPECT_FALSE(i.headLocked);
+    EXPECT_EQ(0U, i.segmentList.size());
+
+    i.setLastSegmentId(~0UL);
+    EXPECT_FALSE(i.reachedLastSegment);
+    EXPECT_FALSE(i.isDone());
+    EXPECT_EQ(2U, i.currentSegmentId);
+    EXPECT_TRUE(i.headLocked);
+    EXPECT_EQ(LOG_ENTRY_TYPE_SEGHEADER, i.getType());
+}
+
 TEST_F(LogIteratorTest, destructor) {
     // ensure the append lock is taken and released on destruction
     {
@@ -0,0 +1,312 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_LOGLINEARHISTOGRAM_H
+#define RAMCLOUD_LOGLINEARHISTOGRAM_H
+
+#include <cmath>
+
+#include "Common.h"
+
+#include "Histogram.pb.h"
+
+namespace RAMCloud {
+
+/**
+ * This class records a distribution of integer samples spanning many orders
+ * of magnitude, such as latencies from a microsecond to a second, in the
+ * style of HdrHistogram. Unlike Histogram, whose buckets all have the same
+ * width, each power of two here is split into SUB_BUCKETS equal buckets, so
+ * every sample is known to within about 3% of its value no matter how large
+ * it is, and the histogram has a fixed size of a few kilobytes.
+ *
+ * Histograms can be merged by adding their counts, so each thread (or
+ * server) can record into its own instance and the instances can be
+ * combined when the distribution is needed. storeSample() takes no locks:
+ * one thread may record into a histogram while others read it with
+ * merge(), getPercentile() and so on. A reader may then see a sample in
+ * some counters but not yet in others, which is harmless for statistics.
+ */
+class LogLinearHistogram {
+  public:
+    /// Each power of two is divided into 2^SUB_BUCKET_BITS buckets; samples
+    /// smaller than SUB_BUCKETS are recorded exactly.
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    /// Samples of 2^MAX_BITS or more are all counted in the last bucket
+    /// (but getMax() is still exact). With nanosecond samples this is
+    /// about 18 minutes.
+    static const int MAX_BITS = 40;
+
+    /// Total number of buckets.
+    static const int NUM_BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) *
+                                   SUB_BUCKETS;
+
+    /**
+     * Construct a new, empty histogram.
+     */
+    LogLinearHistogram()
+        : counts(),
+          totalSamples(0),
+          sampleSum(0),
+          max(0),
+          min(-1UL)
+    {
+    }
+
+    /**
+     * Construct a new histogram, initializing its values from the given
+     * protocol buffer.
+     *
+     * \param histogram
+     *      Protocol buffer serialization of another histogram.
+     */
+    explicit LogLinearHistogram(const ProtoBuf::LogLinearHistogram& histogram)
+        : counts(),
+          totalSamples(0),
+          sampleSum(histogram.sample_sum()),
+          max(histogram.max()),
+          min(histogram.min())
+    {
+        foreach (const ProtoBuf::Histogram::Bucket& bucket,
+          histogram.bucket()) {
+            if (bucket.index() < NUM_BUCKETS) {
+                counts[bucket.index()] = bucket.count();
+                totalSamples += bucket.count();
+            }
+        }
+    }
+
+    /**
+     * Store a given sample in the histogram.
+     *
+     * \param sample
+     *      The sample to store.
+     */
+    void
+    storeSample(uint64_t sample)
+    {
+        counts[getBucket(sample)]++;
+        totalSamples++;
+        sampleSum += sample;
+        if (sample < min)
+            min = sample;
+        if (sample > max)
+            max = sample;
+    }
+
+    /**
+     * Add all of the samples stored in another histogram to this one.
+     *
+     * \param other
+     *      Histogram whose samples are added; it is not modified.
+     */
+    void
+    merge(const LogLinearHistogram& other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            counts[i] += other.counts[i];
+        totalSamples += other.totalSamples;
+        sampleSum += other.sampleSum;
+        if (other.min < min)
+            min = other.min;
+        if (other.max > max)
+            max = other.max;
+    }
+
+    /**
+     * Zero out the entire histogram, returning it to its original state
+     * after construction.
+     */
+    void
+    reset()
+    {
+        memset(counts, 0, sizeof(counts));
+        totalSamples = sampleSum = max = 0;
+        min = -1UL;
+    }
+
+    /**
+     * Return the total number of samples stored in the histogram.
+     */
+    uint64_t
+    getTotalSamples() const
+    {
+        return totalSamples;
+    }
+
+    /**
+     * Get the maximum sample stored in the histogram. If no samples were
+     * stored, the value returned will be 0.
+     */
+    uint64_t
+    getMax() const
+    {
+        return max;
+    }
+
+    /**
+     * Get the minimum sample stored in the histogram. If no samples were
+     * stored, the value returned will be -1UL.
+     */
+    uint64_t
+    getMin() const
+    {
+        return min;
+    }
+
+    /**
+     * Get the average sample stored in the histogram, or 0 if there are
+     * none.
+     */
+    uint64_t
+    getAverage() const
+    {
+        if (totalSamples == 0)
+            return 0;
+        return sampleSum / totalSamples;
+    }
+
+    /**
+     * Return the smallest value that is at least as large as a given
+     * percentage of the samples, to within the precision of the buckets:
+     * the result is the largest value that falls in the same bucket as
+     * the exact answer (or the maximum sample, if that is smaller).
+     * Returns 0 if there are no samples.
+     *
+     * \param percentile
+     *      Between 0 and 100; for example, 99.9 returns the value below
+     *      which all but 0.1% of the samples fall.
+     */
+    uint64_t
+    getPercentile(double percentile) const
+    {
+        if (totalSamples == 0)
+            return 0;
+        uint64_t target = static_cast<uint64_t>(
+                ceil(percentile / 100 * static_cast<double>(totalSamples)));
+        if (target == 0)
+            target = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= target)
+                return std::min(getHighestValue(i), max);
+        }
+        return max;
+    }
+
+    /**
+     * Return the number of samples no larger than a given value, to within
+     * the precision of the buckets (all samples in the same bucket as
+     * \a value are included).
+     */
+    uint64_t
+    getCountAtOrBelow(uint64_t value) const
+    {
+        uint64_t result = 0;
+        for (int i = 0; i <= getBucket(value); i++)
+            result += counts[i];
+        return result;
+    }
+
+    /**
+     * Return a one-line summary of the histogram: the number of samples,
+     * their range and mean, and a selection of percentiles.
+     */
+    string
+    toString() const
+    {
+        return format("%lu samples, min %lu, mean %lu, p50 %lu, p90 %lu, "
+                "p99 %lu, p99.9 %lu, p99.99 %lu, max %lu",
+                totalSamples, (totalSamples == 0) ? 0 : min, getAverage(),
+                getPercentile(50), getPercentile(90), getPercentile(99),
+                getPercentile(99.9), getPercentile(99.99), max);
+    }
+
+    /**
+     * Serialize the histogram to a protocol buffer for network transmission.
+     * Only buckets with nonzero counts are included.
+     */
+    void
+    serialize(ProtoBuf::LogLinearHistogram& histogram) const
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            if (counts[i] > 0) {
+                ProtoBuf::Histogram_Bucket& bucket(*histogram.add_bucket());
+                bucket.set_index(i);
+                bucket.set_count(counts[i]);
+            }
+        }
+        histogram.set_sample_sum(sampleSum);
+        histogram.set_max(max);
+        histogram.set_min(min);
+    }
+
+  PRIVATE:
+    /**
+     * Return the index of the bucket that counts a given sample.
+     */
+    static int
+    getBucket(uint64_t sample)
+    {
+        if (sample < SUB_BUCKETS)
+            return downCast<int>(sample);
+        int highBit = 63 - __builtin_clzll(sample);
+        if (highBit >= MAX_BITS)
+            return NUM_BUCKETS - 1;
+        int shift = highBit - SUB_BUCKET_BITS;
+        return ((shift + 1) << SUB_BUCKET_BITS) +
+                downCast<int>((sample >> shift) - SUB_BUCKETS);
+    }
+
+    /**
+     * Return the largest sample that is counted in a given bucket.
+     */
+    static uint64_t
+    getHighestValue(int bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        if (bucket == NUM_BUCKETS - 1)
+            return ~0UL;
+        int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+        uint64_t lowest = (static_cast<uint64_t>(bucket % SUB_BUCKETS) +
+                SUB_BUCKETS) << shift;
+        return lowest + ((1UL << shift) - 1);
+    }
+
+    /// Number of samples counted in each bucket. The first SUB_BUCKETS
+    /// buckets each hold a single value; after that, each group of
+    /// SUB_BUCKETS buckets covers one power of two.
+    uint64_t counts[NUM_BUCKETS];
+
+    /// Number of samples stored.
+    uint64_t totalSamples;
+
+    /// Sum of all samples stored.
+    uint64_t sampleSum;
+
+    /// The highest-valued sample.
+    uint64_t max;
+
+    /// The lowest-valued sample.
+    uint64_t min;
+};
+
+} // namespace RAMCloud
+
+#endif // !RAMCLOUD_LOGLINEARHISTOGRAM_H
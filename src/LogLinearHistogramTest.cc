@@ -0,0 +1,153 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "LogLinearHistogram.h"
+
+namespace RAMCloud {
+
+/**
+ * Unit tests for LogLinearHistogram.
+ */
+class LogLinearHistogramTest : public ::testing::Test {
+  public:
+    LogLinearHistogramTest() {}
+
+    DISALLOW_COPY_AND_ASSIGN(LogLinearHistogramTest);
+};
+
+TEST_F(LogLinearHistogramTest, constructor_deserializer) {
+    LogLinearHistogram h1;
+    h1.storeSample(8);
+    h1.storeSample(23482);
+    h1.storeSample(27);
+
+    ProtoBuf::LogLinearHistogram protoBuf;
+    h1.serialize(protoBuf);
+    EXPECT_EQ(3, protoBuf.bucket_size());
+    LogLinearHistogram h2(protoBuf);
+    EXPECT_EQ(3UL, h2.getTotalSamples());
+    EXPECT_EQ(h1.getAverage(), h2.getAverage());
+    EXPECT_EQ(8UL, h2.getMin());
+    EXPECT_EQ(23482UL, h2.getMax());
+    for (int i = 0; i < LogLinearHistogram::NUM_BUCKETS; i++)
+        EXPECT_EQ(h1.counts[i], h2.counts[i]);
+}
+
+TEST_F(LogLinearHistogramTest, storeSample) {
+    LogLinearHistogram h;
+    EXPECT_EQ(0UL, h.getAverage());
+    EXPECT_EQ(0UL, h.getPercentile(50));
+    h.storeSample(3);
+    h.storeSample(1000);
+    EXPECT_EQ(2UL, h.getTotalSamples());
+    EXPECT_EQ(1UL, h.counts[3]);
+    EXPECT_EQ(1UL, h.counts[LogLinearHistogram::getBucket(1000)]);
+    EXPECT_EQ(3UL, h.getMin());
+    EXPECT_EQ(1000UL, h.getMax());
+    EXPECT_EQ(501UL, h.getAverage());
+}
+
+TEST_F(LogLinearHistogramTest, merge) {
+    LogLinearHistogram h1, h2;
+    h1.storeSample(10);
+    h2.storeSample(5);
+    h2.storeSample(100000);
+    h1.merge(h2);
+    EXPECT_EQ(3UL, h1.getTotalSamples());
+    EXPECT_EQ(5UL, h1.getMin());
+    EXPECT_EQ(100000UL, h1.getMax());
+    EXPECT_EQ(1UL, h1.counts[5]);
+    EXPECT_EQ(1UL, h1.counts[10]);
+    EXPECT_EQ(2UL, h2.getTotalSamples());
+}
+
+TEST_F(LogLinearHistogramTest, reset) {
+    LogLinearHistogram h;
+    h.storeSample(7);
+    h.reset();
+    EXPECT_EQ(0UL, h.getTotalSamples());
+    EXPECT_EQ(0UL, h.counts[7]);
+    EXPECT_EQ(0UL, h.getMax());
+    EXPECT_EQ(~0UL, h.getMin());
+}
+
+TEST_F(LogLinearHistogramTest, getPercentile) {
+    LogLinearHistogram h;
+    for (uint64_t i = 1; i <= 1000; i++)
+        h.storeSample(i * 1000);
+    EXPECT_EQ(1000000UL, h.getPercentile(100));
+
+    // Results are within the precision of the buckets.
+    uint64_t lowest = h.getPercentile(0);
+    EXPECT_LE(1000UL, lowest);
+    EXPECT_GE(1000UL + 1000UL / LogLinearHistogram::SUB_BUCKETS, lowest);
+    uint64_t median = h.getPercentile(50);
+    EXPECT_LE(500000UL, median);
+    EXPECT_GE(500000UL + 500000UL / LogLinearHistogram::SUB_BUCKETS, median);
+    uint64_t p99 = h.getPercentile(99);
+    EXPECT_LE(990000UL, p99);
+    EXPECT_GE(990000UL + 990000UL / LogLinearHistogram::SUB_BUCKETS, p99);
+}
+
+TEST_F(LogLinearHistogramTest, getCountAtOrBelow) {
+    LogLinearHistogram h;
+    h.storeSample(1);
+    h.storeSample(20);
+    h.storeSample(5000);
+    EXPECT_EQ(0UL, h.getCountAtOrBelow(0));
+    EXPECT_EQ(2UL, h.getCountAtOrBelow(20));
+    EXPECT_EQ(3UL, h.getCountAtOrBelow(~0UL));
+}
+
+TEST_F(LogLinearHistogramTest, toString) {
+    LogLinearHistogram h;
+    EXPECT_EQ("0 samples, min 0, mean 0, p50 0, p90 0, p99 0, p99.9 0, "
+              "p99.99 0, max 0", h.toString());
+    h.storeSample(4);
+    h.storeSample(6);
+    EXPECT_EQ("2 samples, min 4, mean 5, p50 4, p90 6, p99 6, p99.9 6, "
+              "p99.99 6, max 6", h.toString());
+}
+
+TEST_F(LogLinearHistogramTest, getBucket) {
+    EXPECT_EQ(0, LogLinearHistogram::getBucket(0));
+    EXPECT_EQ(31, LogLinearHistogram::getBucket(31));
+    EXPECT_EQ(32, LogLinearHistogram::getBucket(32));
+    EXPECT_EQ(63, LogLinearHistogram::getBucket(63));
+    EXPECT_EQ(64, LogLinearHistogram::getBucket(64));
+    EXPECT_EQ(64, LogLinearHistogram::getBucket(65));
+    EXPECT_EQ(65, LogLinearHistogram::getBucket(66));
+    EXPECT_EQ(LogLinearHistogram::NUM_BUCKETS - 1,
+              LogLinearHistogram::getBucket((1UL << 40) - 1));
+    EXPECT_EQ(LogLinearHistogram::NUM_BUCKETS - 1,
+              LogLinearHistogram::getBucket(~0UL));
+}
+
+TEST_F(LogLinearHistogramTest, getHighestValue) {
+    EXPECT_EQ(31UL, LogLinearHistogram::getHighestValue(31));
+    EXPECT_EQ(32UL, LogLinearHistogram::getHighestValue(32));
+    EXPECT_EQ(65UL, LogLinearHistogram::getHighestValue(64));
+    EXPECT_EQ(~0UL, LogLinearHistogram::getHighestValue(
+              LogLinearHistogram::NUM_BUCKETS - 1));
+    for (uint64_t value = 1; value < (1UL << 36); value *= 3) {
+        int bucket = LogLinearHistogram::getBucket(value);
+        EXPECT_LE(value, LogLinearHistogram::getHighestValue(bucket));
+        EXPECT_GT(value, LogLinearHistogram::getHighestValue(bucket - 1));
+    }
+}
+
+}  // namespace RAMCloud
@@ -158,7 +158,28 @@ class LogSegment : public Segment {
             return 0;
         }
         return static_cast<int>(
-            (static_cast<uint64_t>(getLiveBytes()) * 100) / bytesAllocated);
+            (static_cast<uint64_t>(getMemoryBytes(getLiveBytes())) * 100) /
+            bytesAllocated);
+    }
+
+    /**
+     * Convert a number of bytes of entries in this segment (as counted by
+     * getLiveBytes(), for example) into the number of bytes of memory they
+     * occupy. The two are the same unless the segment is compressed, in which
+     * case entries are assumed to take up memory in proportion to how well
+     * the segment as a whole compressed.
+     */
+    uint32_t
+    getMemoryBytes(uint32_t entryBytes)
+    {
+        if (expect_true(!isCompressed()))
+            return entryBytes;
+
+        uint32_t appendedLength = getAppendedLength();
+        if (appendedLength == 0)
+            return entryBytes;
+        return downCast<uint32_t>(static_cast<uint64_t>(entryBytes) *
+                                  getCompressedLength() / appendedLength);
     }
 
     /**
@@ -27,6 +27,59 @@ namespace RAMCloud {
 // Default RejectRules to use if none are provided by the caller.
 RejectRules defaultRejectRules;
 
+/**
+ * Give another master a read-only copy of a frequently read object, which
+ * it may serve to clients until the lease runs out or the copy is
+ * invalidated by #invalidateHotObject.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server.
+ * \param serverId
+ *      Identifier for the master that should hold the copy.
+ * \param tableId
+ *      Identifier for the table containing the object.
+ * \param version
+ *      Version of the object.
+ * \param leaseMs
+ *      The copy may be served for this many milliseconds after it arrives.
+ * \param keysAndValue
+ *      The object's keys and value, in the format returned by
+ *      Object::appendKeysAndValueToBuffer. The buffer must not be modified
+ *      until the RPC completes.
+ */
+void
+MasterClient::cacheHotObject(Context* context, ServerId serverId,
+        uint64_t tableId, uint64_t version, uint32_t leaseMs,
+        Buffer& keysAndValue)
+{
+    CacheHotObjectRpc rpc(context, serverId, tableId, version, leaseMs,
+                          keysAndValue);
+    rpc.wait();
+}
+
+/**
+ * Constructor for CacheHotObjectRpc: initiates an RPC in the same way as
+ * #MasterClient::cacheHotObject, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \copydetails MasterClient::cacheHotObject
+ */
+CacheHotObjectRpc::CacheHotObjectRpc(Context* context, ServerId serverId,
+        uint64_t tableId, uint64_t version, uint32_t leaseMs,
+        Buffer& keysAndValue)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::CacheHotObject::Response))
+{
+    WireFormat::CacheHotObject::Request* reqHdr(
+            allocHeader<WireFormat::CacheHotObject>(serverId));
+    reqHdr->tableId = tableId;
+    reqHdr->version = version;
+    reqHdr->leaseMs = leaseMs;
+    reqHdr->length = keysAndValue.getTotalLength();
+    Buffer::Chunk::appendToBuffer(&request, &keysAndValue, 0, reqHdr->length);
+    send();
+}
+
 /**
  * Instruct the master that it must no longer serve requests for the tablet
  * specified. The server may reclaim all memory previously allocated to that
@@ -227,6 +280,68 @@ GetHeadOfLogRpc::wait()
     return { respHdr->headSegmentId, respHdr->headSegmentOffset };
 }
 
+/**
+ * Retrieve statistics about the tablets and tables stored on a master,
+ * such as the number of reads and writes each tablet has served.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ * \param[out] serverStats
+ *      This protocol buffer is filled in with statistics about the server.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+MasterClient::getServerStatistics(Context* context, ServerId serverId,
+        ProtoBuf::ServerStatistics* serverStats)
+{
+    GetMasterStatisticsRpc rpc(context, serverId);
+    rpc.wait(serverStats);
+}
+
+/**
+ * Constructor for GetMasterStatisticsRpc: initiates an RPC in the same way
+ * as #MasterClient::getServerStatistics, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ */
+GetMasterStatisticsRpc::GetMasterStatisticsRpc(Context* context,
+        ServerId serverId)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::GetServerStatistics::Response))
+{
+    allocHeader<WireFormat::GetServerStatistics>();
+    send();
+}
+
+/**
+ * Wait for a getServerStatistics RPC to complete.
+ *
+ * \param[out] serverStats
+ *      This protocol buffer is filled in with statistics about the server.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+GetMasterStatisticsRpc::wait(ProtoBuf::ServerStatistics* serverStats)
+{
+    waitAndCheckErrors();
+    const WireFormat::GetServerStatistics::Response* respHdr(
+            getResponseHeader<WireFormat::GetServerStatistics>());
+    ProtoBuf::parseFromResponse(response, sizeof(*respHdr),
+            respHdr->serverStatsLength, serverStats);
+}
+
 /**
  * This RPC is sent to an index server to request that it insert an index
  * entry in an indexlet it holds.
@@ -281,6 +396,56 @@ InsertIndexEntryRpc::InsertIndexEntryRpc(
     send();
 }
 
+/**
+ * Tell a master holding a copy of an object (see #cacheHotObject) that the
+ * object has been modified, so the copy must no longer be served.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server.
+ * \param serverId
+ *      Identifier for the master holding the copy.
+ * \param tableId
+ *      Identifier for the table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Size in bytes of \a key.
+ * \param version
+ *      Copies with versions older than this must be discarded, including
+ *      any that arrive after this RPC.
+ */
+void
+MasterClient::invalidateHotObject(Context* context, ServerId serverId,
+        uint64_t tableId, const void* key, uint16_t keyLength,
+        uint64_t version)
+{
+    InvalidateHotObjectRpc rpc(context, serverId, tableId, key, keyLength,
+                               version);
+    rpc.wait();
+}
+
+/**
+ * Constructor for InvalidateHotObjectRpc: initiates an RPC in the same way
+ * as #MasterClient::invalidateHotObject, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \copydetails MasterClient::invalidateHotObject
+ */
+InvalidateHotObjectRpc::InvalidateHotObjectRpc(Context* context,
+        ServerId serverId, uint64_t tableId, const void* key,
+        uint16_t keyLength, uint64_t version)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::InvalidateHotObject::Response))
+{
+    WireFormat::InvalidateHotObject::Request* reqHdr(
+            allocHeader<WireFormat::InvalidateHotObject>(serverId));
+    reqHdr->tableId = tableId;
+    reqHdr->keyLength = keyLength;
+    reqHdr->version = version;
+    request.append(key, keyLength);
+    send();
+}
+
 /**
  * Return whether a replica for a segment created by a given master may still
  * be needed for recovery. Backups use this when restarting after a failure
@@ -372,6 +537,71 @@ IsReplicaNeededRpc::wait()
     return respHdr->needed;
 }
 
+/**
+ * Ask a master to migrate one of its tablets to another master. This is
+ * used by the coordinator's TabletBalancer; the call returns once the data
+ * has been transferred and ownership of the tablet has been reassigned.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master that currently owns the tablet.
+ * \param tableId
+ *      Identifier for the table.
+ * \param firstKeyHash
+ *      Lowest key hash in the tablet range to be migrated.
+ * \param lastKeyHash
+ *      Highest key hash in the tablet range to be migrated.
+ * \param newOwnerMasterId
+ *      Identifier for the master that will own the tablet.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+MasterClient::migrateTablet(Context* context, ServerId serverId,
+        uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+        ServerId newOwnerMasterId)
+{
+    MigrateMasterTabletRpc rpc(context, serverId, tableId, firstKeyHash,
+            lastKeyHash, newOwnerMasterId);
+    rpc.wait();
+}
+
+/**
+ * Constructor for MigrateMasterTabletRpc: initiates an RPC in the same way
+ * as #MasterClient::migrateTablet, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master that currently owns the tablet.
+ * \param tableId
+ *      Identifier for the table.
+ * \param firstKeyHash
+ *      Lowest key hash in the tablet range to be migrated.
+ * \param lastKeyHash
+ *      Highest key hash in the tablet range to be migrated.
+ * \param newOwnerMasterId
+ *      Identifier for the master that will own the tablet.
+ */
+MigrateMasterTabletRpc::MigrateMasterTabletRpc(Context* context,
+        ServerId serverId, uint64_t tableId, uint64_t firstKeyHash,
+        uint64_t lastKeyHash, ServerId newOwnerMasterId)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::MigrateTablet::Response))
+{
+    WireFormat::MigrateTablet::Request* reqHdr(
+            allocHeader<WireFormat::MigrateTablet>());
+    reqHdr->tableId = tableId;
+    reqHdr->firstKeyHash = firstKeyHash;
+    reqHdr->lastKeyHash = lastKeyHash;
+    reqHdr->newOwnerMasterId = newOwnerMasterId.getId();
+    send();
+}
+
 /**
  * Request that a master decide whether it will accept a migrated tablet
  * and set up any necessary state to begin receiving tablet data from the
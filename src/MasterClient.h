@@ -43,15 +43,26 @@ class MasterService;
  */
 class MasterClient {
   public:
+    static void cacheHotObject(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t version, uint32_t leaseMs,
+            Buffer& keysAndValue);
     static void dropTabletOwnership(Context* context, ServerId serverId,
             uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash);
     static Log::Position getHeadOfLog(Context* context, ServerId serverId);
+    static void getServerStatistics(Context* context, ServerId serverId,
+            ProtoBuf::ServerStatistics* serverStats);
     static void insertIndexEntry(MasterService* master,
             uint64_t tableId, uint8_t indexId,
             const void* indexKey, KeyLength indexKeyLength,
             uint64_t primaryKeyHash);
+    static void invalidateHotObject(Context* context, ServerId serverId,
+            uint64_t tableId, const void* key, uint16_t keyLength,
+            uint64_t version);
     static bool isReplicaNeeded(Context* context, ServerId serverId,
             ServerId backupServerId, uint64_t segmentId);
+    static void migrateTablet(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            ServerId newOwnerMasterId);
     static void prepForMigration(Context* context, ServerId serverId,
             uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
             uint64_t expectedObjects, uint64_t expectedBytes);
@@ -83,6 +94,23 @@ class MasterClient {
     MasterClient();
 };
 
+/**
+ * Encapsulates the state of a MasterClient::cacheHotObject
+ * request, allowing it to execute asynchronously.
+ */
+class CacheHotObjectRpc : public ServerIdRpcWrapper {
+  public:
+    CacheHotObjectRpc(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t version, uint32_t leaseMs,
+            Buffer& keysAndValue);
+    ~CacheHotObjectRpc() {}
+    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
+    void wait() {waitAndCheckErrors();}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(CacheHotObjectRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::dropTabletOwnership
  * request, allowing it to execute asynchronously.
@@ -131,6 +159,20 @@ class GetHeadOfLogRpc : public ServerIdRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(GetHeadOfLogRpc);
 };
 
+/**
+ * Encapsulates the state of a MasterClient::getServerStatistics
+ * request, allowing it to execute asynchronously.
+ */
+class GetMasterStatisticsRpc : public ServerIdRpcWrapper {
+  public:
+    GetMasterStatisticsRpc(Context* context, ServerId serverId);
+    ~GetMasterStatisticsRpc() {}
+    void wait(ProtoBuf::ServerStatistics* serverStats);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(GetMasterStatisticsRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::insertIndexEntry
  * request, allowing it to execute asynchronously.
@@ -148,6 +190,23 @@ class InsertIndexEntryRpc : public IndexRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(InsertIndexEntryRpc);
 };
 
+/**
+ * Encapsulates the state of a MasterClient::invalidateHotObject
+ * request, allowing it to execute asynchronously.
+ */
+class InvalidateHotObjectRpc : public ServerIdRpcWrapper {
+  public:
+    InvalidateHotObjectRpc(Context* context, ServerId serverId,
+            uint64_t tableId, const void* key, uint16_t keyLength,
+            uint64_t version);
+    ~InvalidateHotObjectRpc() {}
+    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
+    void wait() {waitAndCheckErrors();}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(InvalidateHotObjectRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::isReplicaNeeded
  * request, allowing it to execute asynchronously.
@@ -163,6 +222,23 @@ class IsReplicaNeededRpc : public ServerIdRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(IsReplicaNeededRpc);
 };
 
+/**
+ * Encapsulates the state of a MasterClient::migrateTablet
+ * request, allowing it to execute asynchronously.
+ */
+class MigrateMasterTabletRpc : public ServerIdRpcWrapper {
+  public:
+    MigrateMasterTabletRpc(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            ServerId newOwnerMasterId);
+    ~MigrateMasterTabletRpc() {}
+    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
+    void wait() {waitAndCheckErrors();}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(MigrateMasterTabletRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::prepForMigration
  * request, allowing it to execute asynchronously.
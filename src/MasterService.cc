@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <deque>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -27,12 +29,15 @@
 #include "MasterClient.h"
 #include "MasterService.h"
 #include "ObjectBuffer.h"
+#include "ObjectFilter.h"
+#include "ParallelSegmentReplayer.h"
 #include "PerfCounter.h"
 #include "ProtoBuf.h"
 #include "RawMetrics.h"
 #include "Segment.h"
 #include "ServiceManager.h"
 #include "ShortMacros.h"
+#include "StringUtil.h"
 #include "Transport.h"
 #include "Tub.h"
 #include "WallTime.h"
@@ -87,7 +92,9 @@ MasterService::MasterService(Context* context,
                     &masterTableMetadata)
     , tabletManager()
     , indexletManager(context, &objectManager)
+    , rpcPriorities()
 {
+    initRpcPriorities();
 }
 
 MasterService::~MasterService()
@@ -114,6 +121,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
     }
 
     switch (opcode) {
+        case WireFormat::CacheHotObject::opcode:
+            callHandler<WireFormat::CacheHotObject, MasterService,
+                        &MasterService::cacheHotObject>(rpc);
+            break;
         case WireFormat::DropTabletOwnership::opcode:
             callHandler<WireFormat::DropTabletOwnership, MasterService,
                         &MasterService::dropTabletOwnership>(rpc);
@@ -150,6 +161,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::InsertIndexEntry, MasterService,
                         &MasterService::insertIndexEntry>(rpc);
             break;
+        case WireFormat::InvalidateHotObject::opcode:
+            callHandler<WireFormat::InvalidateHotObject, MasterService,
+                        &MasterService::invalidateHotObject>(rpc);
+            break;
         case WireFormat::IsReplicaNeeded::opcode:
             callHandler<WireFormat::IsReplicaNeeded, MasterService,
                         &MasterService::isReplicaNeeded>(rpc);
@@ -182,6 +197,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::ReadKeysAndValue, MasterService,
                         &MasterService::readKeysAndValue>(rpc);
             break;
+        case WireFormat::ReadModifyWrite::opcode:
+            callHandler<WireFormat::ReadModifyWrite, MasterService,
+                        &MasterService::readModifyWrite>(rpc);
+            break;
         case WireFormat::ReceiveMigrationData::opcode:
             callHandler<WireFormat::ReceiveMigrationData, MasterService,
                         &MasterService::receiveMigrationData>(rpc);
@@ -257,6 +276,27 @@ MasterService::Disabler::reenable()
     }
 }
 
+/**
+ * Top-level server method to handle the CACHE_HOT_OBJECT request. Another
+ * master is giving us a read-only copy of one of its hot objects; see
+ * HotKeyCache.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::cacheHotObject(
+        const WireFormat::CacheHotObject::Request* reqHdr,
+        WireFormat::CacheHotObject::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    if (rpc->requestPayload->getTotalLength() - reqOffset < reqHdr->length)
+        throw MessageTooShortError(HERE);
+    objectManager.getHotKeyCache()->storeCopy(reqHdr->tableId,
+            reqHdr->version, reqHdr->leaseMs, *rpc->requestPayload,
+            reqOffset, reqHdr->length);
+}
+
 /**
  * Top-level server method to handle the DROP_TABLET_OWNERSHIP request.
  *
@@ -280,6 +320,10 @@ MasterService::dropTabletOwnership(
         // Ensure that the ObjectManager never returns objects from this deleted
         // tablet again.
         objectManager.removeOrphanedObjects();
+        HotKeyCache* hotKeyCache = objectManager.getHotKeyCache();
+        hotKeyCache->noteTabletDropped(reqHdr->tableId, reqHdr->firstKeyHash,
+                                       reqHdr->lastKeyHash);
+        hotKeyCache->sync();
         LOG(NOTICE, "Dropped ownership of tablet [0x%lx,0x%lx] in tableId %lu",
             reqHdr->firstKeyHash, reqHdr->lastKeyHash, reqHdr->tableId);
     } else {
@@ -364,6 +408,13 @@ MasterService::enumerate(const WireFormat::Enumerate::Request* reqHdr,
         *rpc->requestPayload,
         downCast<uint32_t>(sizeof(*reqHdr)), reqHdr->iteratorBytes);
 
+    Tub<ObjectFilter> filter;
+    if (reqHdr->filterBytes > 0) {
+        filter.construct(*rpc->requestPayload,
+                         sizeof32(*reqHdr) + reqHdr->iteratorBytes,
+                         reqHdr->filterBytes);
+    }
+
     Buffer payload;
     // A rough upper bound on how much space will be available in the response.
     uint32_t maxPayloadBytes =
@@ -375,8 +426,13 @@ MasterService::enumerate(const WireFormat::Enumerate::Request* reqHdr,
                             &respHdr->tabletFirstHash, iter,
                             *objectManager.getLog(),
                             *objectManager.getObjectMap(),
-                            *rpc->replyPayload, maxPayloadBytes);
-    enumeration.complete();
+                            *rpc->replyPayload, maxPayloadBytes,
+                            reqHdr->snapshot ?
+                            objectManager.getSnapshotManager() : NULL,
+                            filter.get());
+    respHdr->common.status = enumeration.complete();
+    if (respHdr->common.status != STATUS_OK)
+        return;
     respHdr->payloadBytes = rpc->replyPayload->getTotalLength()
             - downCast<uint32_t>(sizeof(*respHdr));
 
@@ -416,6 +472,22 @@ MasterService::getLogMetrics(
                                                               &logMetrics);
 }
 
+/**
+ * Returns the class of RPCs with the given opcode; see
+ * Service::getRpcPriority. Single-object reads and updates are
+ * latency-critical and go in HIGH_PRIORITY; enumeration, migration,
+ * recovery, and test fills can occupy a thread for a long time and go in
+ * LOW_PRIORITY. The config.master.rpcPriorities option may move any
+ * opcode to another class.
+ */
+MasterService::RpcPriority
+MasterService::getRpcPriority(WireFormat::Opcode opcode)
+{
+    if (opcode >= WireFormat::ILLEGAL_RPC_TYPE)
+        return NORMAL_PRIORITY;
+    return rpcPriorities[opcode];
+}
+
 /**
  * Top-level server method to handle the GET_SERVER_STATISTICS request.
  */
@@ -428,6 +500,19 @@ MasterService::getServerStatistics(
     ProtoBuf::ServerStatistics serverStats;
     tabletManager.getStatistics(&serverStats);
     SpinLock::getStatistics(serverStats.mutable_spin_lock_stats());
+
+    MasterTableMetadata::scanner sc = masterTableMetadata.getScanner();
+    while (sc.hasNext()) {
+        MasterTableMetadata::Entry* entry = sc.next();
+        std::lock_guard<SpinLock> guard(entry->stats.lock);
+        ProtoBuf::ServerStatistics_TableEntry* tableEntry =
+            serverStats.add_tableentry();
+        tableEntry->set_table_id(entry->tableId);
+        tableEntry->set_byte_count(entry->stats.byteCount);
+        tableEntry->set_record_count(entry->stats.recordCount);
+    }
+    if (context->serviceManager != NULL)
+        context->serviceManager->getStatistics(&serverStats);
     respHdr->serverStatsLength = serializeToResponse(rpc->replyPayload,
                                                      &serverStats);
 }
@@ -634,6 +719,68 @@ MasterService::initOnceEnlisted()
     initCalled = true;
 }
 
+/**
+ * Fill in #rpcPriorities: start from the default class of each opcode (see
+ * getRpcPriority) and apply the overrides in config.master.rpcPriorities,
+ * a comma-separated list of OPCODE:CLASS pairs such as
+ * "ENUMERATE:normal,INDEXED_READ:low". Dies if an override is malformed.
+ */
+void
+MasterService::initRpcPriorities()
+{
+    for (int i = 0; i < WireFormat::ILLEGAL_RPC_TYPE; i++) {
+        switch (i) {
+            case WireFormat::READ:
+            case WireFormat::READ_KEYS_AND_VALUE:
+            case WireFormat::WRITE:
+            case WireFormat::REMOVE:
+            case WireFormat::INCREMENT:
+            case WireFormat::READ_MODIFY_WRITE:
+            case WireFormat::MULTI_OP:
+            case WireFormat::CACHE_HOT_OBJECT:
+            case WireFormat::INVALIDATE_HOT_OBJECT:
+                rpcPriorities[i] = HIGH_PRIORITY;
+                break;
+            case WireFormat::ENUMERATE:
+            case WireFormat::FILL_WITH_TEST_DATA:
+            case WireFormat::MIGRATE_TABLET:
+            case WireFormat::RECEIVE_MIGRATION_DATA:
+            case WireFormat::RECOVER:
+                rpcPriorities[i] = LOW_PRIORITY;
+                break;
+            default:
+                rpcPriorities[i] = NORMAL_PRIORITY;
+                break;
+        }
+    }
+
+    foreach (const string& override,
+             StringUtil::split(config->master.rpcPriorities, ',')) {
+        if (override.empty())
+            continue;
+        size_t colon = override.find(':');
+        string name = override.substr(0, colon);
+        string priority = (colon == string::npos) ? "" :
+                override.substr(colon + 1);
+        int opcode = 0;
+        while (opcode < WireFormat::ILLEGAL_RPC_TYPE &&
+                name != WireFormat::opcodeSymbol(opcode))
+            opcode++;
+        if (opcode == WireFormat::ILLEGAL_RPC_TYPE)
+            DIE("Unknown opcode in rpcPriorities: \"%s\"", name.c_str());
+        if (priority == "high") {
+            rpcPriorities[opcode] = HIGH_PRIORITY;
+        } else if (priority == "normal") {
+            rpcPriorities[opcode] = NORMAL_PRIORITY;
+        } else if (priority == "low") {
+            rpcPriorities[opcode] = LOW_PRIORITY;
+        } else {
+            DIE("Unknown class in rpcPriorities: \"%s\" (must be high, "
+                "normal, or low)", priority.c_str());
+        }
+    }
+}
+
 /**
  * RPC handler for INSERT_INDEX_ENTRY;
  * As an index server, this process inserts an index entry. The RPC is
@@ -655,6 +802,23 @@ MasterService::insertIndexEntry(
                                 reqHdr->primaryKeyHash);
 }
 
+/**
+ * Top-level server method to handle the INVALIDATE_HOT_OBJECT request. The
+ * owner of an object we hold a copy of has modified it; see HotKeyCache.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::invalidateHotObject(
+        const WireFormat::InvalidateHotObject::Request* reqHdr,
+        WireFormat::InvalidateHotObject::Response* respHdr,
+        Rpc* rpc)
+{
+    Key key(reqHdr->tableId, *rpc->requestPayload, sizeof32(*reqHdr),
+            reqHdr->keyLength);
+    objectManager.getHotKeyCache()->invalidateCopy(key, reqHdr->version);
+}
+
 /**
  * RPC handler for IS_REPLICA_NEEDED; indicates to backup servers whether
  * a replica for a particular segment that this master generated is needed
@@ -717,12 +881,153 @@ MasterService::lookupIndexKeys(
                     &respHdr->nextKeyLength, &respHdr->nextKeyHash);
 }
 
+namespace MasterServiceInternal {
+/**
+ * Sends the segments packed up by MasterService::migrateTablet() to the
+ * tablet's new owner. Several RECEIVE_MIGRATION_DATA rpcs may be outstanding
+ * at once, so that packing the next segment overlaps with transferring and
+ * replaying earlier ones. Whenever the master is busy with other requests,
+ * the sender backs off to a single rpc at a time so that migration doesn't
+ * compete with clients for the network and worker threads.
+ */
+class MigrationSender {
+  PUBLIC:
+    MigrationSender(Context* context,
+                    ServerId newOwnerMasterId,
+                    uint64_t tableId,
+                    uint64_t firstKeyHash,
+                    uint32_t maxRpcsInFlight,
+                    uint32_t busyThreshold)
+        : context(context)
+        , newOwnerMasterId(newOwnerMasterId)
+        , tableId(tableId)
+        , firstKeyHash(firstKeyHash)
+        , maxRpcsInFlight(std::max(1u, maxRpcsInFlight))
+        , busyThreshold(busyThreshold)
+        , inFlight()
+        , segmentsSent(0)
+        , throttledSends(0)
+    {
+    }
+
+    /**
+     * Start sending a closed segment, first waiting for earlier rpcs to
+     * complete if too many are outstanding.
+     *
+     * \param segment
+     *      Segment of migrated data. The sender keeps it until its rpc
+     *      completes.
+     */
+    void
+    send(std::unique_ptr<Segment> segment)
+    {
+        uint32_t limit = maxRpcsInFlight;
+        if (isBusy()) {
+            limit = 1;
+            throttledSends++;
+        }
+        while (inFlight.size() >= limit)
+            waitForOldest();
+
+        inFlight.emplace_back(new Transfer(std::move(segment)));
+        Transfer* transfer = inFlight.back().get();
+        transfer->rpc.construct(context, newOwnerMasterId, tableId,
+                                firstKeyHash, transfer->segment.get());
+        segmentsSent++;
+    }
+
+    /**
+     * Wait for all outstanding rpcs to complete.
+     */
+    void
+    finish()
+    {
+        while (!inFlight.empty())
+            waitForOldest();
+    }
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Master receiving the migrated tablet.
+    ServerId newOwnerMasterId;
+
+    /// Identifies the tablet being migrated.
+    uint64_t tableId;
+    uint64_t firstKeyHash;
+
+    /// Number of rpcs that may be outstanding when the master isn't busy.
+    uint32_t maxRpcsInFlight;
+
+    /// The master is considered busy when at least this many rpcs other than
+    /// the MIGRATE_TABLET request itself are being serviced.
+    uint32_t busyThreshold;
+
+    /**
+     * A segment being sent along with the rpc sending it.
+     */
+    struct Transfer {
+        explicit Transfer(std::unique_ptr<Segment> segment)
+            : segment(std::move(segment))
+            , rpc()
+        {
+        }
+        std::unique_ptr<Segment> segment;
+        Tub<ReceiveMigrationDataRpc> rpc;
+        DISALLOW_COPY_AND_ASSIGN(Transfer);
+    };
+
+    /// Outstanding rpcs, oldest first.
+    std::deque<std::unique_ptr<Transfer>> inFlight;
+
+    /// Number of segments sent so far.
+    uint64_t segmentsSent;
+
+    /// Number of segments sent while the master was busy.
+    uint64_t throttledSends;
+
+  PRIVATE:
+    bool
+    isBusy()
+    {
+        if (context->serviceManager == NULL)
+            return false;
+        // Don't count the MIGRATE_TABLET request we're running in.
+        uint32_t activeRpcs = context->serviceManager->getActiveRpcCount();
+        return activeRpcs > busyThreshold;
+    }
+
+    void
+    waitForOldest()
+    {
+        // Throws if the new owner has crashed; the exception aborts the
+        // migration and any other outstanding rpcs are abandoned.
+        inFlight.front()->rpc->wait();
+        inFlight.pop_front();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MigrationSender);
+};
+} // namespace MasterServiceInternal
+
 /**
  * Top-level server method to handle the MIGRATE_TABLET request.
  *
  * This is used to manually initiate the migration of a tablet (or piece of a
  * tablet) that this master owns to another master.
  *
+ * Migration happens in two passes, neither of which requires scanning the
+ * whole log. First, the live objects in the tablet are found by walking just
+ * the hash table buckets covering the tablet's key hash range; writes to the
+ * tablet continue during this pass. Second, everything appended to the log
+ * since the first pass began (including tombstones for objects deleted in
+ * the meantime) is sent by iterating only over segments created since then.
+ * The second pass runs in catch-up rounds that each send the log tail
+ * written during the previous round while writes continue, until the tail
+ * is small (see ServerConfig::Master::migrationFreezeBytes). Only then is
+ * the log head locked, freezing writes while the remaining tail is sent and
+ * ownership of the tablet is handed over.
+ *
  * \copydetails Service::ping
  */
 void
@@ -755,9 +1060,6 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
 
     // TODO(rumble/slaughter) what if we end up splitting?!?
 
-    // TODO(rumble/slaughter) add method to query for # objs, # bytes in a
-    // range in order for this to really work, we'll need to split on a bucket
-    // boundary. Otherwise we can't tell where bytes are in the chosen range.
     MasterClient::prepForMigration(context, newOwnerMasterId, tableId,
                                    firstKeyHash, lastKeyHash, 0, 0);
     Log::Position newOwnerLogHead = MasterClient::getHeadOfLog(context,
@@ -767,18 +1069,169 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
         firstKeyHash, lastKeyHash, tableId,
         context->serverList->toString(newOwnerMasterId).c_str());
 
+    // Anything appended to the log from here on is picked up by the second
+    // pass below, so starting a new head bounds how much it has to iterate.
+    Log::Position catchUpStart = objectManager.getLog()->rollHeadOver();
+
+    // The master is busy if every other master service thread is occupied.
+    uint32_t busyThreshold = downCast<uint32_t>(std::max(1, maxThreads() - 1));
+    MasterServiceInternal::MigrationSender sender(context, newOwnerMasterId,
+            tableId, firstKeyHash, config->master.migrationRpcsInFlight,
+            busyThreshold);
+
     // We'll send over objects in Segment containers for better network
     // efficiency and convenience.
-    Tub<Segment> transferSeg;
+    std::unique_ptr<Segment> transferSeg;
 
     // TODO(rumble/slaughter): These should probably be metrics.
     uint64_t totalObjects = 0;
     uint64_t totalTombstones = 0;
     uint64_t totalBytes = 0;
 
-    // Hold on to the iterator since it locks the head Segment, avoiding any
-    // additional appends once we've finished iterating.
-    LogIterator it(*objectManager.getLog());
+    // First pass: live objects, found through the hash table.
+    uint64_t numBuckets = objectManager.getNumBucketsForHashRange(firstKeyHash,
+                                                                  lastKeyHash);
+    for (uint64_t i = 0; i < numBuckets; i++) {
+        if (!transferSeg)
+            transferSeg.reset(new Segment());
+        if (objectManager.appendObjectsForHashRange(tableId, firstKeyHash,
+                lastKeyHash, i, transferSeg.get(), &totalObjects,
+                &totalBytes)) {
+            continue;
+        }
+
+        // If we can't fit them, send the current segment and retry.
+        transferSeg->close();
+        LOG(DEBUG, "Sending migration segment");
+        sender.send(std::move(transferSeg));
+        transferSeg.reset(new Segment());
+        if (!objectManager.appendObjectsForHashRange(tableId, firstKeyHash,
+                lastKeyHash, i, transferSeg.get(), &totalObjects,
+                &totalBytes)) {
+            LOG(ERROR, "Tablet migration failed: could not fit objects "
+                "from one hash table bucket into an empty segment");
+            respHdr->common.status = STATUS_INTERNAL_ERROR;
+            return;
+        }
+    }
+
+    // Second pass: whatever was appended during the first pass. Writes to
+    // the tablet continue for up to migrationCatchUpRounds rounds; each
+    // rolls the head over and sends what was appended during the previous
+    // round, iterating only up to the segment just closed so the head never
+    // gets locked. Rounds stop early once the tail is small enough.
+    LogIterator it(*objectManager.getLog(), catchUpStart.getSegmentId(),
+                   catchUpStart.getSegmentId() - 1);
+    uint32_t catchUpRounds = 0;
+    while (catchUpRounds < config->master.migrationCatchUpRounds) {
+        catchUpRounds++;
+        uint64_t bytesBefore = totalBytes;
+        Log::Position roundEnd = objectManager.getLog()->rollHeadOver();
+        it.setLastSegmentId(roundEnd.getSegmentId() - 1);
+        if (!sendMigrationLogTail(it, tableId, firstKeyHash, lastKeyHash,
+                sender, transferSeg, &totalObjects, &totalTombstones,
+                &totalBytes)) {
+            respHdr->common.status = STATUS_INTERNAL_ERROR;
+            return;
+        }
+        if (totalBytes - bytesBefore <= config->master.migrationFreezeBytes)
+            break;
+    }
+
+    // Freeze writes: iterating the rest of the log locks the head Segment.
+    // Hold on to the iterator to avoid any additional appends until the
+    // tablet has been dropped.
+    uint64_t freezeStart = Cycles::rdtsc();
+    it.setLastSegmentId(~0UL);
+    if (!sendMigrationLogTail(it, tableId, firstKeyHash, lastKeyHash,
+            sender, transferSeg, &totalObjects, &totalTombstones,
+            &totalBytes)) {
+        respHdr->common.status = STATUS_INTERNAL_ERROR;
+        return;
+    }
+
+    if (transferSeg) {
+        transferSeg->close();
+        LOG(DEBUG, "Sending last migration segment");
+        sender.send(std::move(transferSeg));
+    }
+    sender.finish();
+
+    // Copies of the tablet's hot objects on other masters would go stale
+    // once the new owner starts accepting writes, since it doesn't know
+    // about them. Reads served before the tablet is deleted below may
+    // push new copies, so check again afterwards.
+    HotKeyCache* hotKeyCache = objectManager.getHotKeyCache();
+    hotKeyCache->noteTabletDropped(tableId, firstKeyHash, lastKeyHash);
+    hotKeyCache->sync();
+
+    // Now that all data has been transferred, we can reassign ownership of
+    // the tablet. If this succeeds, we are free to drop the tablet. The
+    // data is all on the other machine and the coordinator knows to use it
+    // for any recoveries.
+    CoordinatorClient::reassignTabletOwnership(context,
+        tableId, firstKeyHash, lastKeyHash, newOwnerMasterId,
+        newOwnerLogHead.getSegmentId(), newOwnerLogHead.getSegmentOffset());
+
+    tabletManager.deleteTablet(tableId, firstKeyHash, lastKeyHash);
+    hotKeyCache->noteTabletDropped(tableId, firstKeyHash, lastKeyHash);
+    hotKeyCache->sync();
+    uint64_t freezeCycles = Cycles::rdtsc() - freezeStart;
+
+    LOG(NOTICE, "Migration succeeded for tablet [0x%lx,0x%lx] in "
+        "tableId %lu; sent %lu objects and %lu tombstones to %s, "
+        "%lu bytes in total (%lu segments, %lu sent while busy); "
+        "writes frozen for %.3f ms after %u catch-up rounds",
+        firstKeyHash, lastKeyHash, tableId, totalObjects, totalTombstones,
+        context->serverList->toString(newOwnerMasterId).c_str(), totalBytes,
+        sender.segmentsSent, sender.throttledSends,
+        Cycles::toSeconds(freezeCycles) * 1e03, catchUpRounds);
+
+    // Ensure that the ObjectManager never returns objects from this deleted
+    // tablet again.
+    objectManager.removeOrphanedObjects();
+}
+
+/**
+ * Helper for migrateTablet() that packs the objects and tombstones in a
+ * tablet's key hash range from part of the log into migration segments,
+ * handing full segments to a MigrationSender.
+ *
+ * \param it
+ *      Iterates over the part of the log to send. Entries are consumed
+ *      until it.isDone() returns true.
+ * \param tableId
+ *      Table containing the tablet being migrated.
+ * \param firstKeyHash
+ *      Lowest key hash in the tablet being migrated.
+ * \param lastKeyHash
+ *      Highest key hash in the tablet being migrated.
+ * \param sender
+ *      Sends full segments to the tablet's new owner.
+ * \param transferSeg
+ *      Segment currently being packed. A new one is allocated if this is
+ *      empty, and it may be left partially filled for the caller to send.
+ * \param[out] totalObjects
+ *      Incremented by the number of objects packed.
+ * \param[out] totalTombstones
+ *      Incremented by the number of tombstones packed.
+ * \param[out] totalBytes
+ *      Incremented by the number of bytes packed.
+ * \return
+ *      False if an entry could not fit into an empty segment, in which case
+ *      the migration must be abandoned. Otherwise true.
+ */
+bool
+MasterService::sendMigrationLogTail(LogIterator& it,
+        uint64_t tableId,
+        uint64_t firstKeyHash,
+        uint64_t lastKeyHash,
+        MasterServiceInternal::MigrationSender& sender,
+        std::unique_ptr<Segment>& transferSeg,
+        uint64_t* totalObjects,
+        uint64_t* totalTombstones,
+        uint64_t* totalBytes)
+{
     for (; !it.isDone(); it.next()) {
         LogEntryType type = it.getType();
         if (type != LOG_ENTRY_TYPE_OBJ && type != LOG_ENTRY_TYPE_OBJTOMB) {
@@ -812,74 +1265,35 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
             if (iteratorObject.getVersion() < currentVersion)
                 continue;
 
-            totalObjects++;
+            (*totalObjects)++;
         } else {
-            // We must always send tombstones, since an object we may have sent
-            // could have been deleted more recently. We could be smarter and
-            // more selective here, but that'd require keeping extra state to
-            // know what we've already sent.
-            //
-            // TODO(rumble/slaughter) Actually, we can do better. The stupid way
-            //      is to track each object or tombstone we've sent. The smarter
-            //      way is to just record the Log::Position when we started
-            //      iterating and only send newer tombstones.
-
-            totalTombstones++;
+            // Tombstones appended since the first pass began must be sent,
+            // since the object they delete may already have been sent.
+            (*totalTombstones)++;
         }
 
-        totalBytes += buffer.getTotalLength();
+        *totalBytes += buffer.getTotalLength();
 
         if (!transferSeg)
-            transferSeg.construct();
+            transferSeg.reset(new Segment());
 
         // If we can't fit it, send the current buffer and retry.
         if (!transferSeg->append(type, buffer)) {
             transferSeg->close();
             LOG(DEBUG, "Sending migration segment");
-            MasterClient::receiveMigrationData(context, newOwnerMasterId,
-                tableId, firstKeyHash, transferSeg.get());
-
-            transferSeg.destroy();
-            transferSeg.construct();
+            sender.send(std::move(transferSeg));
+            transferSeg.reset(new Segment());
 
             // If it doesn't fit this time, we're in trouble.
             if (!transferSeg->append(type, buffer)) {
                 LOG(ERROR, "Tablet migration failed: could not fit object "
                     "into empty segment (obj bytes %u)",
                     buffer.getTotalLength());
-                respHdr->common.status = STATUS_INTERNAL_ERROR;
-                return;
+                return false;
             }
         }
     }
-
-    if (transferSeg) {
-        transferSeg->close();
-        LOG(DEBUG, "Sending last migration segment");
-        MasterClient::receiveMigrationData(context, newOwnerMasterId,
-            tableId, firstKeyHash, transferSeg.get());
-        transferSeg.destroy();
-    }
-
-    // Now that all data has been transferred, we can reassign ownership of
-    // the tablet. If this succeeds, we are free to drop the tablet. The
-    // data is all on the other machine and the coordinator knows to use it
-    // for any recoveries.
-    CoordinatorClient::reassignTabletOwnership(context,
-        tableId, firstKeyHash, lastKeyHash, newOwnerMasterId,
-        newOwnerLogHead.getSegmentId(), newOwnerLogHead.getSegmentOffset());
-
-    LOG(NOTICE, "Migration succeeded for tablet [0x%lx,0x%lx] in "
-        "tableId %lu; sent %lu objects and %lu tombstones to %s, "
-        "%lu bytes in total",
-        firstKeyHash, lastKeyHash, tableId, totalObjects, totalTombstones,
-        context->serverList->toString(newOwnerMasterId).c_str(), totalBytes);
-
-    tabletManager.deleteTablet(tableId, firstKeyHash, lastKeyHash);
-
-    // Ensure that the ObjectManager never returns objects from this deleted
-    // tablet again.
-    objectManager.removeOrphanedObjects();
+    return true;
 }
 
 /**
@@ -900,6 +1314,9 @@ MasterService::multiOp(const WireFormat::MultiOp::Request* reqHdr,
         case WireFormat::MultiOp::OpType::WRITE:
             multiWrite(reqHdr, respHdr, rpc);
             break;
+        case WireFormat::MultiOp::OpType::READ_MODIFY_WRITE:
+            multiReadModifyWrite(reqHdr, respHdr, rpc);
+            break;
         default:
             LOG(ERROR, "Unimplemented multiOp (type = %u) received!",
                     (uint32_t) reqHdr->type);
@@ -970,15 +1387,46 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
         reqOffset += currentReq->keyLength;
         Key key(currentReq->tableId, stringKey, currentReq->keyLength);
 
+        Tub<ObjectFilter> filter;
+        if (currentReq->filterLength > 0) {
+            filter.construct(*rpc->requestPayload, reqOffset,
+                             currentReq->filterLength);
+            reqOffset += currentReq->filterLength;
+        }
+
         WireFormat::MultiOp::Response::ReadPart* currentResp =
                    new(rpc->replyPayload, APPEND)
                        WireFormat::MultiOp::Response::ReadPart();
 
         uint32_t initialLength = rpc->replyPayload->getTotalLength();
-        currentResp->status = objectManager.readObject(key,
-                                                        rpc->replyPayload,
-                                                        NULL,
-                                                        &currentResp->version);
+        if (!filter) {
+            currentResp->status = objectManager.readObject(key,
+                    rpc->replyPayload, NULL, &currentResp->version);
+        } else {
+            // Evaluate the filter before anything goes in the response, so
+            // that only the keys and the selected part of the value are
+            // returned.
+            Buffer keysAndValue;
+            currentResp->status = objectManager.readObject(key,
+                    &keysAndValue, NULL, &currentResp->version);
+            if (currentResp->status == STATUS_OK) {
+                Object object(key.getTableId(), currentResp->version, 0,
+                              keysAndValue);
+                if (filter->matches(object)) {
+                    uint16_t keysLength = 0;
+                    object.getValueOffset(&keysLength);
+                    uint32_t valueOffset;
+                    uint32_t valueLength = filter->getValueRange(object,
+                                                                 &valueOffset);
+                    Buffer::Chunk::appendToBuffer(rpc->replyPayload,
+                            &keysAndValue, 0, keysLength);
+                    Buffer::Chunk::appendToBuffer(rpc->replyPayload,
+                            &keysAndValue, valueOffset, valueLength);
+                } else {
+                    currentResp->status = STATUS_OBJECT_FILTERED;
+                }
+            }
+        }
 
         if (currentResp->status != STATUS_OK)
             continue;
@@ -988,6 +1436,104 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
     }
 }
 
+/**
+ * Top-level server method to handle the MULTI_READ_MODIFY_WRITE request.
+ *
+ * \param reqHdr
+ *      Header from the incoming RPC request. Lists the number of operations
+ *      contained in this request.
+ * \param[out] respHdr
+ *      Header for the response that will be returned to the client.
+ *      The caller has pre-allocated the right amount of space in the
+ *      response buffer for this type of request, and has zeroed out
+ *      its contents (so, for example, status is already zero).
+ * \param[out] rpc
+ *      Complete information about the remote procedure call.
+ *      It contains the key and RmwOperation for each object, as well as
+ *      RejectRules to support conditional updates.
+ */
+void
+MasterService::multiReadModifyWrite(const WireFormat::MultiOp::Request* reqHdr,
+                                    WireFormat::MultiOp::Response* respHdr,
+                                    Rpc* rpc)
+{
+    uint32_t numRequests = reqHdr->count;
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    respHdr->count = numRequests;
+
+    // Parse every request before applying any of them: the operations
+    // aren't idempotent, so a malformed request must not be discovered
+    // after earlier ones have already changed their objects.
+    std::vector<const WireFormat::MultiOp::Request::ReadModifyWritePart*>
+            requests;
+    std::vector<const void*> stringKeys;
+    std::vector<RmwOperation> operations;
+    try {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            const WireFormat::MultiOp::Request::ReadModifyWritePart*
+                currentReq = rpc->requestPayload->getOffset<
+                    WireFormat::MultiOp::Request::ReadModifyWritePart>(
+                        reqOffset);
+            if (currentReq == NULL)
+                throw RequestFormatError(HERE);
+            reqOffset += sizeof32(*currentReq);
+
+            const void* stringKey = rpc->requestPayload->getRange(
+                reqOffset, currentReq->keyLength);
+            if (stringKey == NULL)
+                throw RequestFormatError(HERE);
+            reqOffset += currentReq->keyLength;
+
+            operations.push_back(RmwOperation(*rpc->requestPayload,
+                    reqOffset, currentReq->operationLength));
+            reqOffset += currentReq->operationLength;
+            requests.push_back(currentReq);
+            stringKeys.push_back(stringKey);
+        }
+    } catch (ClientException& e) {
+        respHdr->common.status = e.status;
+        return;
+    }
+
+    // Each iteration applies one operation if possible, and appends a
+    // status, version, and value to the response buffer. Each operation is
+    // atomic on its own; there is no atomicity across objects. Every reply
+    // carries the first result; a later one that wouldn't fit in the rpc
+    // isn't applied at all, and the client retries it (and the rest) in a
+    // new rpc.
+    for (uint32_t i = 0; i < numRequests; i++) {
+        const WireFormat::MultiOp::Request::ReadModifyWritePart* currentReq =
+            requests[i];
+        Key key(currentReq->tableId, stringKeys[i], currentReq->keyLength);
+
+        WireFormat::MultiOp::Response::ReadModifyWritePart* currentResp =
+            new(rpc->replyPayload, APPEND)
+                WireFormat::MultiOp::Response::ReadModifyWritePart();
+
+        RejectRules rejectRules = currentReq->rejectRules;
+        uint32_t initialLength = rpc->replyPayload->getTotalLength();
+        Status status = STATUS_RETRY;
+        if (i == 0 || initialLength <= maxResponseRpcLen) {
+            status = objectManager.readModifyWriteObject(key,
+                    operations[i], &rejectRules, &currentResp->version,
+                    rpc->replyPayload,
+                    (i == 0) ? ~0U : maxResponseRpcLen - initialLength);
+        }
+        if (status == STATUS_RETRY && i > 0) {
+            rpc->replyPayload->truncateEnd(sizeof32(*currentResp));
+            respHdr->count = i;
+            break;
+        }
+        currentResp->status = status;
+        currentResp->length = rpc->replyPayload->getTotalLength() -
+                              initialLength;
+    }
+
+    // All of the individual updates were done asynchronously. Sync them
+    // now to propagate them in bulk to backups.
+    objectManager.syncChanges();
+}
+
 /**
  * Top-level server method to handle the MULTI_REMOVE request.
  *
@@ -1100,8 +1646,17 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
     // so that we can later remove index entries corresponding to them.
     Buffer oldObjectBuffers[numRequests];
 
-    // Each iteration extracts one request from the rpc, writes the object
-    // if possible, and appends a status and version to the response buffer.
+    // The writes are parsed first and then handed to the object manager
+    // together, so that all of the new objects go into the log with a
+    // single append.
+    Tub<Object> objects[numRequests];
+    RejectRules rejectRules[numRequests];
+    ObjectManager::BatchedWrite writes[numRequests];
+    WireFormat::MultiOp::Response::WritePart* responses[numRequests];
+    uint32_t numWrites = 0;
+
+    // Each iteration extracts one request from the rpc and appends space
+    // for its status and version to the response buffer.
     for (uint32_t i = 0; i < numRequests; i++) {
         const WireFormat::MultiOp::Request::WritePart *currentReq =
             rpc->requestPayload->getOffset<
@@ -1119,25 +1674,32 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
             respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
             break;
         }
-        WireFormat::MultiOp::Response::WritePart* currentResp =
-            new(rpc->replyPayload, APPEND)
+        responses[i] = new(rpc->replyPayload, APPEND)
                 WireFormat::MultiOp::Response::WritePart();
 
-        Object object(currentReq->tableId, 0, 0, *(rpc->requestPayload),
-                      reqOffset, currentReq->length);
+        objects[i].construct(currentReq->tableId, 0, 0,
+                             *(rpc->requestPayload), reqOffset,
+                             currentReq->length);
 
         // Insert new index entries, if any, before writing object (for strong
         // consistency).
-        requestInsertIndexEntries(object);
+        requestInsertIndexEntries(*objects[i]);
 
-        // Write the object.
-        RejectRules rejectRules = currentReq->rejectRules;
-        currentResp->status = objectManager.writeObject(object, &rejectRules,
-                                                        &currentResp->version,
-                                                        &oldObjectBuffers[i]);
+        rejectRules[i] = currentReq->rejectRules;
+        writes[i].object = objects[i].get();
+        writes[i].rejectRules = &rejectRules[i];
+        writes[i].removedObjBuffer = &oldObjectBuffers[i];
+        numWrites++;
         reqOffset += currentReq->length;
     }
 
+    // Write the objects.
+    objectManager.writeObjects(writes, numWrites);
+    for (uint32_t i = 0; i < numWrites; i++) {
+        responses[i]->status = writes[i].status;
+        responses[i]->version = writes[i].version;
+    }
+
     // By design, our response will be shorter than the request. This ensures
     // that the response can go back in a single RPC.
     assert(rpc->replyPayload->getTotalLength() <= Transport::MAX_RPC_LEN);
@@ -1152,7 +1714,7 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
     // reqHdr, respHdr, and rpc are off-limits now!
 
     // If any of the write parts overwrites, delete old index entries if any.
-    for (uint32_t i = 0; i < numRequests; i++) {
+    for (uint32_t i = 0; i < numWrites; i++) {
         if (oldObjectBuffers[i].getTotalLength() > 0) {
             requestRemoveIndexEntries(oldObjectBuffers[i]);
         }
@@ -1250,10 +1812,36 @@ MasterService::read(const WireFormat::Read::Request* reqHdr,
                                                        &rejectRules,
                                                        &respHdr->version,
                                                        valueOnly);
+
+    HotKeyCache* hotKeyCache = objectManager.getHotKeyCache();
+    if (respHdr->common.status == STATUS_UNKNOWN_TABLET &&
+            !rejectRules.doesntExist && !rejectRules.exists &&
+            !rejectRules.versionLeGiven && !rejectRules.versionNeGiven) {
+        // The object's owner may have given us a copy because it's hot.
+        // Copies can't evaluate reject rules, so clients only send plain
+        // reads here.
+        if (hotKeyCache->readCopy(key, rpc->replyPayload, &respHdr->version)) {
+            respHdr->common.status = STATUS_OK;
+            respHdr->length = rpc->replyPayload->getTotalLength() -
+                    initialLength;
+        }
+        return;
+    }
     if (respHdr->common.status != STATUS_OK)
         return;
 
     respHdr->length = rpc->replyPayload->getTotalLength() - initialLength;
+
+    uint64_t pushId = hotKeyCache->recordRead(key);
+    if (pushId != 0) {
+        Buffer keysAndValue;
+        uint64_t version;
+        if (objectManager.readObject(key, &keysAndValue, NULL,
+                                     &version) == STATUS_OK)
+            hotKeyCache->replicate(pushId, version, keysAndValue);
+    }
+    respHdr->replicasLength = hotKeyCache->appendReplicaLocators(key,
+            rpc->replyPayload, &respHdr->replicaLeaseMs);
 }
 
 /**
@@ -1296,6 +1884,33 @@ MasterService::readKeysAndValue(
     respHdr->length = rpc->replyPayload->getTotalLength() - initialLength;
 }
 
+/**
+ * Top-level server method to handle the READ_MODIFY_WRITE request.
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::readModifyWrite(
+        const WireFormat::ReadModifyWrite::Request* reqHdr,
+        WireFormat::ReadModifyWrite::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    Key key(reqHdr->tableId, *rpc->requestPayload, reqOffset,
+            reqHdr->keyLength);
+    reqOffset += reqHdr->keyLength;
+    RmwOperation operation(*rpc->requestPayload, reqOffset,
+                           reqHdr->operationLength);
+
+    RejectRules rejectRules = reqHdr->rejectRules;
+    uint32_t initialLength = rpc->replyPayload->getTotalLength();
+    respHdr->common.status = objectManager.readModifyWriteObject(key,
+            operation, &rejectRules, &respHdr->version, rpc->replyPayload);
+    respHdr->length = rpc->replyPayload->getTotalLength() - initialLength;
+    if (respHdr->common.status == STATUS_OK)
+        objectManager.syncChanges();
+}
+
 /**
  * Top-level server method to handle the RECEIVE_MIGRATION_DATA request.
  *
@@ -1423,6 +2038,23 @@ MasterService::removeIndexEntry(
                                 reqHdr->primaryKeyHash);
 }
 
+/**
+ * Returns the number of master service threads reserved for RPCs in the
+ * given class; see Service::reservedThreads. Threads are reserved for
+ * high-priority RPCs so that reads and writes aren't stuck behind long
+ * enumerations or migrations, and optionally for low-priority RPCs so
+ * that recovery and migration can't be starved by client load.
+ */
+int
+MasterService::reservedThreads(RpcPriority priority)
+{
+    if (priority == HIGH_PRIORITY)
+        return config->master.highPriorityThreads;
+    if (priority == LOW_PRIORITY)
+        return config->master.lowPriorityThreads;
+    return 0;
+}
+
 /**
  * Top-level server method to handle the SPLIT_MASTER_TABLET_OWNERSHIP request.
  *
@@ -1932,6 +2564,15 @@ MasterService::recover(uint64_t recoveryId,
     // durable.
     SideLog sideLog(objectManager.getLog());
 
+    // If configured to, replay each segment with several threads. In that
+    // case the replayer's own per-thread SideLogs are used in place of the
+    // one above.
+    Tub<ParallelSegmentReplayer> replayer;
+    if (config->master.recoveryReplayThreadCount > 1) {
+        replayer.construct(&objectManager,
+                           config->master.recoveryReplayThreadCount);
+    }
+
     // Start RPCs
     auto replicaIt = notStarted;
     foreach (auto& task, tasks) {
@@ -2044,7 +2685,10 @@ MasterService::recover(uint64_t recoveryId,
                             ReplicatedSegment::recoveryStart),
                         task->replica.segmentId, responseLen);
                 }
-                objectManager.replaySegment(&sideLog, it);
+                if (replayer)
+                    replayer->replaySegment(it);
+                else
+                    objectManager.replaySegment(&sideLog, it);
                 usefulTime += Cycles::rdtsc() - startUseful;
                 TEST_LOG("Segment %lu replay complete",
                          task->replica.segmentId);
@@ -2142,6 +2786,8 @@ MasterService::recover(uint64_t recoveryId,
             0 - metrics->transport.infiniband.transmitActiveTicks;
         metrics->master.logSyncPostingWriteRpcTicks =
             0 - metrics->master.replicationPostingWriteRpcTicks;
+        if (replayer)
+            replayer->commit();
         sideLog.commit();
         metrics->master.logSyncBytes += metrics->transport.transmit.byteCount;
         metrics->master.logSyncTransmitCopyTicks +=
@@ -42,8 +42,10 @@ namespace RAMCloud {
 
 // forward declaration
 namespace MasterServiceInternal {
+class MigrationSender;
 class RecoveryTask;
 }
+class LogIterator;
 
 /**
  * An object of this class represents a RAMCloud server, which can
@@ -59,6 +61,8 @@ class MasterService : public Service {
     void dispatch(WireFormat::Opcode opcode,
                   Rpc* rpc);
     int maxThreads() { return config->master.masterServiceThreadCount; }
+    RpcPriority getRpcPriority(WireFormat::Opcode opcode);
+    int reservedThreads(RpcPriority priority);
 
     /*
      * The following class is used to temporarily disable the servicing of
@@ -92,6 +96,9 @@ class MasterService : public Service {
     ObjectFinder objectFinder;
 
   PRIVATE:
+    void cacheHotObject(const WireFormat::CacheHotObject::Request* reqHdr,
+                WireFormat::CacheHotObject::Response* respHdr,
+                Rpc* rpc);
     void dropTabletOwnership(
                 const WireFormat::DropTabletOwnership::Request* reqHdr,
                 WireFormat::DropTabletOwnership::Response* respHdr,
@@ -124,9 +131,14 @@ class MasterService : public Service {
                 WireFormat::IndexedRead::Response* respHdr,
                 Rpc* rpc);
     void initOnceEnlisted();
+    void initRpcPriorities();
     void insertIndexEntry(const WireFormat::InsertIndexEntry::Request* reqHdr,
                 WireFormat::InsertIndexEntry::Response* respHdr,
                 Rpc* rpc);
+    void invalidateHotObject(
+                const WireFormat::InvalidateHotObject::Request* reqHdr,
+                WireFormat::InvalidateHotObject::Response* respHdr,
+                Rpc* rpc);
     void isReplicaNeeded(const WireFormat::IsReplicaNeeded::Request* reqHdr,
                 WireFormat::IsReplicaNeeded::Response* respHdr,
                 Rpc* rpc);
@@ -136,12 +148,24 @@ class MasterService : public Service {
     void migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
                 WireFormat::MigrateTablet::Response* respHdr,
                 Rpc* rpc);
+    bool sendMigrationLogTail(LogIterator& it,
+                uint64_t tableId,
+                uint64_t firstKeyHash,
+                uint64_t lastKeyHash,
+                MasterServiceInternal::MigrationSender& sender,
+                std::unique_ptr<Segment>& transferSeg,
+                uint64_t* totalObjects,
+                uint64_t* totalTombstones,
+                uint64_t* totalBytes);
     void multiOp(const WireFormat::MultiOp::Request* reqHdr,
                 WireFormat::MultiOp::Response* respHdr,
                 Rpc* rpc);
     void multiRead(const WireFormat::MultiOp::Request* reqHdr,
                 WireFormat::MultiOp::Response* respHdr,
                 Rpc* rpc);
+    void multiReadModifyWrite(const WireFormat::MultiOp::Request* reqHdr,
+                WireFormat::MultiOp::Response* respHdr,
+                Rpc* rpc);
     void multiRemove(const WireFormat::MultiOp::Request* reqHdr,
                 WireFormat::MultiOp::Response* respHdr,
                 Rpc* rpc);
@@ -157,6 +181,9 @@ class MasterService : public Service {
     void readKeysAndValue(const WireFormat::ReadKeysAndValue::Request* reqHdr,
               WireFormat::ReadKeysAndValue::Response* respHdr,
               Rpc* rpc);
+    void readModifyWrite(const WireFormat::ReadModifyWrite::Request* reqHdr,
+                WireFormat::ReadModifyWrite::Response* respHdr,
+                Rpc* rpc);
     void receiveMigrationData(
                 const WireFormat::ReceiveMigrationData::Request* reqHdr,
                 WireFormat::ReceiveMigrationData::Response* respHdr,
@@ -233,6 +260,11 @@ class MasterService : public Service {
      */
     IndexletManager indexletManager;
 
+    /**
+     * Priority class of each opcode; see getRpcPriority().
+     */
+    RpcPriority rpcPriorities[WireFormat::ILLEGAL_RPC_TYPE];
+
 ///////////////////////////////////////////////////////////////////////////////
 /////Recovery related code. This should eventually move into its own file./////
 ///////////////////////////////////////////////////////////////////////////////
@@ -17,6 +17,7 @@
 
 #include "BackupStorage.h"
 #include "Buffer.h"
+#include "Enumeration.h"
 #include "EnumerationIterator.h"
 #include "LogIterator.h"
 #include "MasterClient.h"
@@ -24,6 +25,7 @@
 #include "Memory.h"
 #include "MockCluster.h"
 #include "MultiRead.h"
+#include "MultiReadModifyWrite.h"
 #include "MultiRemove.h"
 #include "MultiWrite.h"
 #include "ObjectBuffer.h"
@@ -574,6 +576,120 @@ TEST_F(MasterServiceTest, enumerate_mergeTablet) {
     EXPECT_EQ(0U, objects.getTotalLength());
 }
 
+/**
+ * Return "key:value" for each object in an enumeration payload.
+ */
+static string
+enumeratedObjects(Buffer& payload)
+{
+    string result;
+    uint32_t offset = 0;
+    while (offset < payload.getTotalLength()) {
+        uint32_t size = *payload.getOffset<uint32_t>(offset);
+        offset += sizeof32(uint32_t);
+        Object object(payload.getRange(offset, size), size);
+        offset += size;
+        uint32_t dataLength;
+        const void* data = object.getValue(&dataLength);
+        if (result.size() > 0)
+            result += " ";
+        result += string(static_cast<const char*>(object.getKey()),
+                         object.getKeyLength()) + ":" +
+                  string(static_cast<const char*>(data), dataLength);
+    }
+    return result;
+}
+
+TEST_F(MasterServiceTest, enumerate_snapshot) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    ramcloud->write(1, "1", 1, "ghijkl", 6);
+    ObjectManager& objectManager = service->objectManager;
+    SnapshotManager* snapshotManager = objectManager.getSnapshotManager();
+
+    // Each round only has room for one object.
+    Buffer iterBuffer, payload;
+    EnumerationIterator iter(iterBuffer, 0, 0);
+    uint64_t nextTabletStartHash;
+    Enumeration round1(1, false, 0, 0, ~0UL, &nextTabletStartHash, iter,
+                       *objectManager.getLog(), *objectManager.getObjectMap(),
+                       payload, 40, snapshotManager);
+    round1.complete();
+    EXPECT_EQ(1U, snapshotManager->snapshots.size());
+    string first = enumeratedObjects(payload);
+    EXPECT_TRUE(first == "0:abcdef" || first == "1:ghijkl");
+
+    // Changes made after the snapshot was taken must not be visible.
+    ramcloud->write(1, "0", 1, "mnopqr", 6);
+    ramcloud->remove(1, "1", 1);
+    ramcloud->write(1, "2", 1, "stuvwx", 6);
+
+    payload.reset();
+    Enumeration round2(1, false, 0, 0, ~0UL, &nextTabletStartHash, iter,
+                       *objectManager.getLog(), *objectManager.getObjectMap(),
+                       payload, 40, snapshotManager);
+    round2.complete();
+    EXPECT_EQ(first == "0:abcdef" ? "1:ghijkl" : "0:abcdef",
+              enumeratedObjects(payload));
+
+    // The snapshot is released once the tablet is finished.
+    payload.reset();
+    Enumeration round3(1, false, 0, 0, ~0UL, &nextTabletStartHash, iter,
+                       *objectManager.getLog(), *objectManager.getObjectMap(),
+                       payload, 40, snapshotManager);
+    round3.complete();
+    EXPECT_EQ("", enumeratedObjects(payload));
+    EXPECT_EQ(0U, snapshotManager->snapshots.size());
+}
+
+TEST_F(MasterServiceTest, enumerate_snapshotExpired) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    ramcloud->write(1, "1", 1, "ghijkl", 6);
+    ObjectManager& objectManager = service->objectManager;
+    SnapshotManager* snapshotManager = objectManager.getSnapshotManager();
+
+    Cycles::mockTscValue = 1000;
+    Buffer iterBuffer, payload;
+    EnumerationIterator iter(iterBuffer, 0, 0);
+    uint64_t nextTabletStartHash;
+    Enumeration round1(1, false, 0, 0, ~0UL, &nextTabletStartHash, iter,
+                       *objectManager.getLog(), *objectManager.getObjectMap(),
+                       payload, 40, snapshotManager);
+    EXPECT_EQ(STATUS_OK, round1.complete());
+
+    // The client waits too long; rather than quietly switching to a new
+    // snapshot, the server makes it start over.
+    Cycles::mockTscValue = 1001 +
+            Cycles::fromSeconds(SnapshotManager::LEASE_SECONDS);
+    payload.reset();
+    Enumeration round2(1, false, 0, 0, ~0UL, &nextTabletStartHash, iter,
+                       *objectManager.getLog(), *objectManager.getObjectMap(),
+                       payload, 40, snapshotManager);
+    EXPECT_EQ(STATUS_SNAPSHOT_EXPIRED, round2.complete());
+    EXPECT_EQ(0U, payload.getTotalLength());
+    EXPECT_EQ(0U, snapshotManager->snapshots.size());
+
+    // The same status reaches the client.
+    Buffer state, objects;
+    iter.serialize(state);
+    EnumerateTableRpc rpc(ramcloud.get(), 1, false, 0, state, objects, true);
+    EXPECT_THROW(rpc.wait(state), SnapshotExpiredException);
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(MasterServiceTest, enumerate_filter) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    ramcloud->write(1, "1", 1, "ghijkl", 6);
+    ObjectFilter filter;
+    filter.requireKeyInRange(0, "1", 1, "9", 1);
+    filter.projectValue(2, 3);
+
+    Buffer iter, nextIter, objects;
+    EnumerateTableRpc rpc(ramcloud.get(), 1, false, 0, iter, objects, false,
+                          &filter);
+    rpc.wait(nextIter);
+    EXPECT_EQ("1:ijk", enumeratedObjects(objects));
+}
+
 TEST_F(MasterServiceTest, getHeadOfLog) {
     EXPECT_EQ(Log::Position(2, 88),
               MasterClient::getHeadOfLog(&context, masterServer->serverId));
@@ -582,6 +698,34 @@ TEST_F(MasterServiceTest, getHeadOfLog) {
               MasterClient::getHeadOfLog(&context, masterServer->serverId));
 }
 
+TEST_F(MasterServiceTest, getRpcPriority) {
+    EXPECT_EQ(Service::HIGH_PRIORITY,
+              service->getRpcPriority(WireFormat::READ));
+    EXPECT_EQ(Service::LOW_PRIORITY,
+              service->getRpcPriority(WireFormat::ENUMERATE));
+    EXPECT_EQ(Service::NORMAL_PRIORITY,
+              service->getRpcPriority(WireFormat::TAKE_TABLET_OWNERSHIP));
+    EXPECT_EQ(Service::NORMAL_PRIORITY,
+              service->getRpcPriority(WireFormat::ILLEGAL_RPC_TYPE));
+
+    ServerConfig config = masterConfig;
+    config.master.rpcPriorities = "ENUMERATE:normal,,TAKE_TABLET_OWNERSHIP:low";
+    config.master.highPriorityThreads = 2;
+    const ServerConfig* savedConfig = service->config;
+    service->config = &config;
+    service->initRpcPriorities();
+    EXPECT_EQ(Service::HIGH_PRIORITY,
+              service->getRpcPriority(WireFormat::READ));
+    EXPECT_EQ(Service::NORMAL_PRIORITY,
+              service->getRpcPriority(WireFormat::ENUMERATE));
+    EXPECT_EQ(Service::LOW_PRIORITY,
+              service->getRpcPriority(WireFormat::TAKE_TABLET_OWNERSHIP));
+    EXPECT_EQ(2, service->reservedThreads(Service::HIGH_PRIORITY));
+    EXPECT_EQ(0, service->reservedThreads(Service::NORMAL_PRIORITY));
+    service->config = savedConfig;
+    service->initRpcPriorities();
+}
+
 TEST_F(MasterServiceTest, getServerStatistics) {
     Buffer value;
     uint64_t version;
@@ -725,13 +869,16 @@ TEST_F(MasterServiceTest, migrateTablet_movingData) {
     TestLog::Enable _("migrateTablet");
 
     ramcloud->migrateTablet(tbl, 0, -1, master2->serverId);
-    EXPECT_EQ("migrateTablet: Migrating tablet [0x0,0xffffffffffffffff] "
-        "in tableId 1 to server 3.0 at mock:host=master2 | "
-        "migrateTablet: Sending last migration segment | "
+    EXPECT_TRUE(TestUtil::matchesPosixRegex(
+        "^migrateTablet: Migrating tablet \\[0x0,0xffffffffffffffff\\] "
+        "in tableId 1 to server 3.0 at mock:host=master2 \\| "
+        "migrateTablet: Sending last migration segment \\| "
         "migrateTablet: Migration succeeded for tablet "
-        "[0x0,0xffffffffffffffff] in tableId 1; sent 1 objects and "
-        "0 tombstones to server 3.0 at mock:host=master2, 36 bytes in total",
-        TestLog::get());
+        "\\[0x0,0xffffffffffffffff\\] in tableId 1; sent 1 objects and "
+        "0 tombstones to server 3.0 at mock:host=master2, 36 bytes in total "
+        "\\(1 segments, 0 sent while busy\\); writes frozen for "
+        "[0-9.]+ ms after 1 catch-up rounds$",
+        TestLog::get()));
 
     // Ensure that the tablet ``creation'' time on the new master is
     // appropriate. It should be greater than the log position before
@@ -746,6 +893,52 @@ TEST_F(MasterServiceTest, migrateTablet_movingData) {
     EXPECT_LT(ctimeCoord, master2HeadPositionAfter);
 }
 
+TEST_F(MasterServiceTest, migrateTablet_onlyLiveObjectsInRange) {
+    ramcloud->createTable("migrationTable");
+    uint64_t tbl = ramcloud->getTableId("migrationTable");
+    ramcloud->write(tbl, "hi", 2, "abcdefg", 7);
+    ramcloud->write(tbl, "hi", 2, "abcdefgh", 8);
+    ramcloud->write(tbl, "bye", 3, "abc", 3);
+    ramcloud->remove(tbl, "bye", 3);
+
+    ServerConfig master2Config = masterConfig;
+    master2Config.master.numReplicas = 0;
+    master2Config.localLocator = "mock:host=master2";
+    Server* master2 = cluster.addServer(master2Config);
+
+    TestLog::Enable _("migrateTablet");
+    ramcloud->migrateTablet(tbl, 0, -1, master2->serverId);
+    EXPECT_NE(string::npos, TestLog::get().find(
+        "sent 1 objects and 0 tombstones"));
+
+    Buffer value;
+    ramcloud->read(tbl, "hi", 2, &value);
+    EXPECT_EQ("abcdefgh", TestUtil::toString(&value));
+    EXPECT_THROW(ramcloud->read(tbl, "bye", 3, &value),
+                 ObjectDoesntExistException);
+}
+
+TEST_F(MasterServiceTest, migrateTablet_noCatchUpRounds) {
+    ramcloud->createTable("migrationTable");
+    uint64_t tbl = ramcloud->getTableId("migrationTable");
+    ramcloud->write(tbl, "hi", 2, "abcdefg", 7);
+    masterServer->config.master.migrationCatchUpRounds = 0;
+
+    ServerConfig master2Config = masterConfig;
+    master2Config.master.numReplicas = 0;
+    master2Config.localLocator = "mock:host=master2";
+    Server* master2 = cluster.addServer(master2Config);
+
+    TestLog::Enable _("migrateTablet");
+    ramcloud->migrateTablet(tbl, 0, -1, master2->serverId);
+    EXPECT_NE(string::npos, TestLog::get().find(
+        "after 0 catch-up rounds"));
+
+    Buffer value;
+    ramcloud->read(tbl, "hi", 2, &value);
+    EXPECT_EQ("abcdefg", TestUtil::toString(&value));
+}
+
 TEST_F(MasterServiceTest, multiRead_basics) {
     uint64_t tableId1 = ramcloud->createTable("table1");
     ramcloud->write(tableId1, "0", 1, "firstVal", 8);
@@ -766,6 +959,31 @@ TEST_F(MasterServiceTest, multiRead_basics) {
                           value2.get()->getValue()), 9));
 }
 
+TEST_F(MasterServiceTest, multiRead_filter) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    ramcloud->write(tableId1, "0", 1, "firstVal", 8);
+    ramcloud->write(tableId1, "1", 1, "secondVal", 9);
+    ObjectFilter projection;
+    projection.projectValue(5, 3);
+    ObjectFilter keyRange;
+    keyRange.requireKeyInRange(0, "a", 1, "z", 1);
+    Tub<ObjectBuffer> value1, value2;
+    MultiReadObject request1(tableId1, "0", 1, &value1, &projection);
+    MultiReadObject request2(tableId1, "1", 1, &value2, &keyRange);
+    MultiReadObject* requests[] = {&request1, &request2};
+    ramcloud->multiRead(requests, 2);
+
+    EXPECT_STREQ("STATUS_OK", statusToSymbol(request1.status));
+    EXPECT_EQ("0", string(reinterpret_cast<const char*>(
+                   value1.get()->getKey()), 1));
+    uint32_t valueLength;
+    const void* value = value1.get()->getValue(&valueLength);
+    EXPECT_EQ("Val", string(reinterpret_cast<const char*>(value),
+                            valueLength));
+    EXPECT_STREQ("STATUS_OBJECT_FILTERED", statusToSymbol(request2.status));
+    EXPECT_FALSE(value2);
+}
+
 TEST_F(MasterServiceTest, multiRead_bufferSizeExceeded) {
     uint64_t tableId1 = ramcloud->createTable("table1");
     service->maxResponseRpcLen = 78;
@@ -837,6 +1055,44 @@ TEST_F(MasterServiceTest, multiRead_noSuchObject) {
                  statusToSymbol(request.status));
 }
 
+TEST_F(MasterServiceTest, multiReadModifyWrite_bufferSizeExceeded) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    service->maxResponseRpcLen = 60;
+    ramcloud->write(tableId1, "0", 1,
+            "chunk1:12 chunk2:12 chunk3:12 chunk4:12 chunk5:12 ",
+            50);
+    ramcloud->write(tableId1, "1", 1,
+            "chunk6:12 chunk7:12 chunk8:12 chunk9:12 chunk10:12",
+            50);
+    RmwOperation operation;
+    operation.append("!", 1);
+    Buffer value1, value2;
+    MultiReadModifyWriteObject object1(tableId1, "0", 1, &operation,
+                                       &value1);
+    MultiReadModifyWriteObject object2(tableId1, "1", 1, &operation,
+                                       &value2);
+    MultiReadModifyWriteObject* requests[] = {&object1, &object2};
+    MultiReadModifyWrite request(ramcloud.get(), requests, 2);
+
+    // The first try applies only the first operation; the second one's
+    // result wouldn't fit, so its object is left alone.
+    EXPECT_FALSE(request.isReady());
+    EXPECT_STREQ("STATUS_OK", statusToSymbol(object1.status));
+    EXPECT_EQ(51U, value1.getTotalLength());
+    Buffer value;
+    uint64_t version;
+    ramcloud->read(tableId1, "1", 1, &value, NULL, &version);
+    EXPECT_EQ(1U, version);
+
+    // When we retry, the second operation is applied exactly once.
+    EXPECT_TRUE(request.isReady());
+    EXPECT_STREQ("STATUS_OK", statusToSymbol(object2.status));
+    EXPECT_EQ("chunk6:12 chunk7:12 chunk8:12 chunk9:12 chunk10:12!",
+              TestUtil::toString(&value2));
+    ramcloud->read(tableId1, "1", 1, &value, NULL, &version);
+    EXPECT_EQ(2U, version);
+}
+
 TEST_F(MasterServiceTest, multiRemove_basics) {
     uint64_t tableId1 = ramcloud->createTable("table1");
     ramcloud->write(tableId1, "0", 1, "firstVal", 8);
@@ -1166,6 +1422,76 @@ TEST_F(MasterServiceTest, read_rejectRules) {
     EXPECT_EQ(1U, version);
 }
 
+TEST_F(MasterServiceTest, readModifyWrite_basics) {
+    KeyInfo keyList[2];
+    keyList[0].keyLength = 2;
+    keyList[0].key = "ha";
+    keyList[1].keyLength = 2;
+    keyList[1].key = "hi";
+    ramcloud->write(1, 2, keyList, "abcdef", NULL, NULL, false);
+
+    RmwOperation operation;
+    operation.compareAndSwap(2, "cd", "xy", 2);
+    Buffer value;
+    uint64_t version;
+    ramcloud->readModifyWrite(1, "ha", 2, operation, &value, NULL, &version);
+    EXPECT_EQ(2U, version);
+    EXPECT_EQ("abxyef", TestUtil::toString(&value));
+
+    // The object's secondary keys are kept.
+    ObjectBuffer keysAndValue;
+    ramcloud->readKeysAndValue(1, "ha", 2, &keysAndValue);
+    EXPECT_EQ(2U, keysAndValue.getNumKeys());
+    EXPECT_EQ("hi", string(reinterpret_cast<const char *>(
+                    keysAndValue.getKey(1)), 2));
+    EXPECT_EQ("abxyef", string(reinterpret_cast<const char*>(
+                        keysAndValue.getValue()), 6));
+}
+
+TEST_F(MasterServiceTest, readModifyWrite_conditionFailed) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+
+    // The current value comes back, so the caller can decide what to do
+    // without another read.
+    RmwOperation operation;
+    operation.compareAndSwap(2, "xx", "yy", 2);
+    Buffer value;
+    uint64_t version;
+    EXPECT_THROW(ramcloud->readModifyWrite(1, "0", 1, operation, &value,
+                                           NULL, &version),
+                 RmwConditionFailedException);
+    EXPECT_EQ(1U, version);
+    EXPECT_EQ("abcdef", TestUtil::toString(&value));
+
+    ramcloud->read(1, "0", 1, &value, NULL, &version);
+    EXPECT_EQ(1U, version);
+}
+
+TEST_F(MasterServiceTest, readModifyWrite_noSuchObject) {
+    RmwOperation operation;
+    operation.append("abc", 3);
+    EXPECT_THROW(ramcloud->readModifyWrite(1, "5", 1, operation),
+                 ObjectDoesntExistException);
+}
+
+TEST_F(MasterServiceTest, readModifyWrite_rejectRules) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+
+    RmwOperation operation;
+    operation.append("ghi", 3);
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.versionNeGiven = true;
+    rules.givenVersion = 2;
+    EXPECT_THROW(ramcloud->readModifyWrite(1, "0", 1, operation, NULL,
+                                           &rules),
+                 WrongVersionException);
+    rules.givenVersion = 1;
+    Buffer value;
+    ramcloud->readModifyWrite(1, "0", 1, operation, &value, &rules);
+    EXPECT_EQ("abcdefghi", TestUtil::toString(&value));
+}
+
 TEST_F(MasterServiceTest, receiveMigrationData) {
     Segment s;
 
@@ -1669,6 +1995,27 @@ TEST_F(MasterServiceFullSegmentSizeTest, write_maximumObjectSize) {
     delete[] key;
 }
 
+TEST_F(MasterServiceFullSegmentSizeTest, readModifyWrite_objectTooLarge) {
+    uint32_t length = MAX_OBJECT_SIZE - 100;
+    char* buf = new char[length];
+    memset(buf, 'a', length);
+    ramcloud->write(1, "0", 1, buf, length);
+
+    // Appending past the size limit fails for good rather than being
+    // retried forever, and the object is unchanged.
+    RmwOperation operation;
+    operation.append(buf, 200);
+    Buffer value;
+    uint64_t version;
+    EXPECT_THROW(ramcloud->readModifyWrite(1, "0", 1, operation, &value,
+                                           NULL, &version),
+                 RmwConditionFailedException);
+    EXPECT_EQ(1U, version);
+    EXPECT_EQ(length, value.getTotalLength());
+
+    delete[] buf;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /////Recovery related tests. This should eventually move into its own file.////
 ///////////////////////////////////////////////////////////////////////////////
@@ -31,7 +31,11 @@ class MockService : public Service {
 
     explicit MockService(int threadLimit = 3) : mutex(), log(),
             gate(0), sendReply(false),
-            threadLimit(threadLimit) { }
+            threadLimit(threadLimit), priorities(), reserved()
+    {
+        for (int i = 0; i < WireFormat::ILLEGAL_RPC_TYPE; i++)
+            priorities[i] = NORMAL_PRIORITY;
+    }
     virtual ~MockService() {}
     virtual void dispatch(WireFormat::Opcode opcode, Rpc* rpc)
     {
@@ -79,6 +83,12 @@ class MockService : public Service {
     virtual int maxThreads() {
         return threadLimit;
     }
+    virtual RpcPriority getRpcPriority(WireFormat::Opcode opcode) {
+        return priorities[opcode];
+    }
+    virtual int reservedThreads(RpcPriority priority) {
+        return reserved[priority];
+    }
     virtual void initOnceEnlisted() {
         TEST_LOG("called");
     }
@@ -102,6 +112,12 @@ class MockService : public Service {
     /// Return value from maxThreads.
     int threadLimit;
 
+    /// Return values from getRpcPriority, indexed by opcode.
+    RpcPriority priorities[WireFormat::ILLEGAL_RPC_TYPE];
+
+    /// Return values from reservedThreads, indexed by priority.
+    int reserved[NUM_PRIORITIES];
+
     DISALLOW_COPY_AND_ASSIGN(MockService);
 };
 
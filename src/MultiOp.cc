@@ -13,6 +13,7 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "ClientObjectCache.h"
 #include "MultiOp.h"
 #include "ShortMacros.h"
 
@@ -158,6 +159,29 @@ MultiOp::isReady() {
     return startRpcs();
 }
 
+/**
+ * Called by subclasses when a request has modified an object, so that a
+ * copy of it in the client's object cache (if any) isn't returned.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Length of \a key in bytes.
+ * \param version
+ *      Cached copies older than this version are discarded.
+ */
+void
+MultiOp::invalidateCachedObject(uint64_t tableId, const void* key,
+                                uint16_t keyLength, uint64_t version)
+{
+    if (ramcloud->objectCache == NULL)
+        return;
+    ramcloud->objectCache->invalidate(tableId,
+            Key::getHash(tableId, key, keyLength), version);
+}
+
 /**
  * Scan the list of objects and start RPCs if possible. When this method
  * is called, it's possible that some RPCS are already underway (left over
@@ -102,6 +102,8 @@ class MultiOp {
     };
 
 
+    void invalidateCachedObject(uint64_t tableId, const void* key,
+                                uint16_t keyLength, uint64_t version);
     bool startRpcs();
 
   PRIVATE:
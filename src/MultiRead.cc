@@ -62,10 +62,12 @@ MultiRead::appendRequest(MultiOpObject* request, Buffer* buf)
 
     // Add the current object to the list of those being
     // fetched by this RPC.
-    new(buf, APPEND)
+    WireFormat::MultiOp::Request::ReadPart* part = new(buf, APPEND)
             WireFormat::MultiOp::Request::ReadPart(
             req->tableId, req->keyLength);
     buf->append(req->key, req->keyLength);
+    if (req->filter != NULL)
+        part->filterLength = downCast<uint16_t>(req->filter->serialize(*buf));
 }
 
 /**
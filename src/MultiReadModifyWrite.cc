@@ -0,0 +1,129 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "MultiReadModifyWrite.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+// Default RejectRules to use if none are provided by the caller: rejects
+// nothing.
+static RejectRules defaultRejectRules;
+
+/**
+ * Constructor for MultiReadModifyWrite objects: initiates one or more RPCs
+ * for a multiReadModifyWrite operation, but returns once the RPCs have been
+ * initiated, without waiting for any of them to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this operation.
+ * \param requests
+ *      Each element in this array describes one object to update.
+ * \param numRequests
+ *      Number of elements in \c requests.
+ */
+MultiReadModifyWrite::MultiReadModifyWrite(RamCloud* ramcloud,
+        MultiReadModifyWriteObject* const requests[],
+        uint32_t numRequests)
+    : MultiOp(ramcloud, type,
+              reinterpret_cast<MultiOpObject* const *>(requests),
+              numRequests)
+{
+    startRpcs();
+}
+
+/**
+ * Append a given MultiReadModifyWriteObject to a buffer.
+ *
+ * It is the responsibility of the caller to ensure that the
+ * MultiOpObject passed in is actually a MultiReadModifyWriteObject.
+ *
+ * \param request
+ *      MultiReadModifyWriteObject request to append
+ * \param buf
+ *      Buffer to append to
+ */
+void
+MultiReadModifyWrite::appendRequest(MultiOpObject* request, Buffer* buf)
+{
+    MultiReadModifyWriteObject* req =
+            static_cast<MultiReadModifyWriteObject*>(request);
+
+    WireFormat::MultiOp::Request::ReadModifyWritePart* part =
+            new(buf, APPEND) WireFormat::MultiOp::Request::ReadModifyWritePart(
+                req->tableId, req->keyLength, 0,
+                req->rejectRules ? *req->rejectRules : defaultRejectRules);
+    buf->append(req->key, req->keyLength);
+    part->operationLength = req->operation->serialize(*buf);
+}
+
+/**
+ * Read the MultiReadModifyWrite response in the buffer given an offset
+ * and put the response into a MultiReadModifyWriteObject. This modifies
+ * the offset as necessary and checks for missing data.
+ *
+ * It is the responsibility of the caller to ensure that the
+ * MultiOpObject passed in is actually a MultiReadModifyWriteObject.
+ *
+ * \param request
+ *      MultiReadModifyWriteObject where the interpreted response goes
+ * \param response
+ *      Buffer to read the response from
+ * \param respOffset
+ *      offset into the buffer for the current position
+ *              which will be modified as this method reads.
+ *
+ * \return
+ *      true if there is missing data
+ */
+bool
+MultiReadModifyWrite::readResponse(MultiOpObject* request,
+                                   Buffer* response,
+                                   uint32_t* respOffset)
+{
+    MultiReadModifyWriteObject* req =
+            static_cast<MultiReadModifyWriteObject*>(request);
+    const WireFormat::MultiOp::Response::ReadModifyWritePart* part =
+        response->getOffset<
+                WireFormat::MultiOp::Response::ReadModifyWritePart>(
+                        *respOffset);
+    if (part == NULL) {
+        TEST_LOG("missing Response::Part");
+        return true;
+    }
+    *respOffset += sizeof32(*part);
+
+    if (response->getTotalLength() < *respOffset + part->length) {
+        TEST_LOG("missing object data");
+        return true;
+    }
+
+    req->status = part->status;
+    req->version = part->version;
+    if (req->status == STATUS_OK) {
+        invalidateCachedObject(req->tableId, req->key, req->keyLength,
+                               req->version);
+    }
+    if (req->value != NULL) {
+        req->value->reset();
+        response->copy(*respOffset, part->length,
+                       new(req->value, APPEND) char[part->length]);
+    }
+    *respOffset += part->length;
+
+    return false;
+}
+
+} // end RAMCloud
@@ -0,0 +1,47 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_MULTIREADMODIFYWRITE_H
+#define RAMCLOUD_MULTIREADMODIFYWRITE_H
+
+#include "MultiOp.h"
+
+namespace RAMCloud {
+
+/**
+ * This class implements the client side of multiReadModifyWrite
+ * operations, using the MultiOp Framework to manage multiple concurrent
+ * RPCs, each updating one or more objects on a single server.
+ */
+class MultiReadModifyWrite : public MultiOp {
+    static const WireFormat::MultiOp::OpType type =
+                            WireFormat::MultiOp::OpType::READ_MODIFY_WRITE;
+
+  PUBLIC:
+    MultiReadModifyWrite(RamCloud* ramcloud,
+                         MultiReadModifyWriteObject* const requests[],
+                         uint32_t numRequests);
+
+  PROTECTED:
+    void appendRequest(MultiOpObject* request, Buffer* buf);
+    bool readResponse(MultiOpObject* request, Buffer* response,
+                      uint32_t* respOffset);
+
+    DISALLOW_COPY_AND_ASSIGN(MultiReadModifyWrite);
+};
+
+} // end RAMCloud
+
+#endif /* RAMCLOUD_MULTIREADMODIFYWRITE_H */
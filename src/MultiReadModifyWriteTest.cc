@@ -0,0 +1,156 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "MultiReadModifyWrite.h"
+#include "ShortMacros.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+class MultiReadModifyWriteTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    uint64_t tableId1;
+    uint64_t tableId2;
+    BindTransport::BindSession* session1;
+    RmwOperation increment;
+    RmwOperation setBits;
+    Buffer values[4];
+    Tub<MultiReadModifyWriteObject> objects[4];
+
+  public:
+    MultiReadModifyWriteTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud()
+        , tableId1(-1)
+        , tableId2(-2)
+        , session1(NULL)
+        , increment()
+        , setBits()
+        , values()
+        , objects()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        config.maxObjectKeySize = 512;
+        config.maxObjectDataSize = 1024;
+        config.segmentSize = 128*1024;
+        config.segletSize = 128*1024;
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+        ramcloud.construct(&context, "mock:host=coordinator");
+
+        tableId1 = ramcloud->createTable("table1");
+        tableId2 = ramcloud->createTable("table2");
+        int64_t zero = 0;
+        ramcloud->write(tableId1, "counter1", 8, &zero, sizeof(zero));
+        ramcloud->write(tableId1, "counter2", 8, &zero, sizeof(zero));
+        ramcloud->write(tableId2, "flags", 5, "xa", 2);
+
+        Transport::SessionRef session =
+                ramcloud->clientContext->transportManager->getSession(
+                "mock:host=master1");
+        session1 = static_cast<BindTransport::BindSession*>(session.get());
+
+        increment.add(0, 1);
+        setBits.bitwiseOr(1, "\x02", 1);
+        objects[0].construct(tableId1, "counter1", 8, &increment, &values[0]);
+        objects[1].construct(tableId1, "counter2", 8, &increment, &values[1]);
+        objects[2].construct(tableId2, "flags", 5, &setBits, &values[2]);
+        objects[3].construct(tableId1, "missing", 7, &increment, &values[3]);
+    }
+
+    int64_t
+    valueOf(Buffer& buffer)
+    {
+        int64_t value = -1;
+        buffer.copy(0, sizeof(value), &value);
+        return value;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MultiReadModifyWriteTest);
+};
+
+TEST_F(MultiReadModifyWriteTest, basics_end_to_end) {
+    MultiReadModifyWriteObject* requests[] = {
+        objects[0].get(), objects[1].get(), objects[2].get(), objects[3].get()
+    };
+    ramcloud->multiReadModifyWrite(requests, 4);
+    ramcloud->multiReadModifyWrite(requests, 2);
+
+    EXPECT_EQ(STATUS_OK, objects[0]->status);
+    EXPECT_EQ(3U, objects[0]->version);
+    EXPECT_EQ(2, valueOf(values[0]));
+    EXPECT_EQ(STATUS_OK, objects[1]->status);
+    EXPECT_EQ(2, valueOf(values[1]));
+    EXPECT_EQ(STATUS_OK, objects[2]->status);
+    EXPECT_EQ(2U, objects[2]->version);
+    EXPECT_EQ("xc", TestUtil::toString(&values[2]));
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, objects[3]->status);
+    EXPECT_EQ(0U, values[3].getTotalLength());
+
+    Buffer value;
+    ramcloud->read(tableId1, "counter2", 8, &value);
+    EXPECT_EQ(2, valueOf(value));
+}
+
+TEST_F(MultiReadModifyWriteTest, appendRequest) {
+    MultiReadModifyWriteObject* requests[] = {objects[0].get()};
+    Buffer buf;
+
+    // Create a non-operating request.
+    MultiReadModifyWrite request(ramcloud.get(), requests, 0);
+    request.wait();
+
+    request.appendRequest(requests[0], &buf);
+    const WireFormat::MultiOp::Request::ReadModifyWritePart* part =
+            buf.getStart<WireFormat::MultiOp::Request::ReadModifyWritePart>();
+    EXPECT_EQ(8U, part->keyLength);
+    EXPECT_EQ(sizeof32(WireFormat::RmwOperation) + 8, part->operationLength);
+    EXPECT_EQ(sizeof32(*part) + 8 + part->operationLength,
+              buf.getTotalLength());
+}
+
+TEST_F(MultiReadModifyWriteTest, readResponse_missingValue) {
+    TestLog::Enable _("readResponse");
+    MultiReadModifyWriteObject* requests[] = {objects[0].get()};
+    session1->dontNotify = true;
+    MultiReadModifyWrite request(ramcloud.get(), requests, 1);
+
+    // The operation is retried, so it is applied twice.
+    session1->lastResponse->truncateEnd(1);
+    session1->lastNotifier->completed();
+    EXPECT_FALSE(request.isReady());
+    EXPECT_EQ("readResponse: missing object data", TestLog::get());
+
+    session1->lastNotifier->completed();
+    EXPECT_TRUE(request.isReady());
+    EXPECT_EQ(STATUS_OK, objects[0]->status);
+    EXPECT_EQ(2, valueOf(values[0]));
+}
+
+}  // namespace RAMCloud
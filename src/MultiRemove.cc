@@ -107,6 +107,11 @@ MultiRemove::readResponse(MultiOpObject* request,
 
     req->status = part->status;
     req->version = part->version;
+    if (req->status == STATUS_OK) {
+        // The returned version is the one removed.
+        invalidateCachedObject(req->tableId, req->key, req->keyLength,
+                               req->version + 1);
+    }
 
     return false;
 }
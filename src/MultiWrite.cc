@@ -125,6 +125,20 @@ MultiWrite::readResponse(MultiOpObject* request,
 
     req->status = part->status;
     req->version = part->version;
+    if (req->status == STATUS_OK) {
+        const void* key = req->key;
+        uint16_t keyLength = req->keyLength;
+        if (req->keyInfo != NULL) {
+            // The primary key is the first entry in req->keyInfo.
+            key = req->keyInfo[0].key;
+            keyLength = req->keyInfo[0].keyLength;
+            if (keyLength == 0) {
+                keyLength = downCast<uint16_t>(strlen(
+                        static_cast<const char*>(key)));
+            }
+        }
+        invalidateCachedObject(req->tableId, key, keyLength, req->version);
+    }
 
     return false;
 }
@@ -0,0 +1,212 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ObjectFilter.h"
+#include "ClientException.h"
+#include "ObjectFinder.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a filter that matches every object and returns all of its
+ * value.
+ */
+ObjectFilter::ObjectFilter()
+    : predicate(NONE)
+    , keyIndex(0)
+    , firstKey()
+    , lastKey()
+    , valueOffset(0)
+    , valueLength(~0U)
+{
+}
+
+/**
+ * Construct a filter from its serialized form; used by masters.
+ *
+ * \param buffer
+ *      Buffer containing a filter created by serialize().
+ * \param offset
+ *      Offset of the filter within \a buffer.
+ * \param length
+ *      Size of the filter in bytes; return value from serialize().
+ *
+ * \throw MessageTooShortError
+ *      The buffer doesn't hold a complete filter.
+ * \throw RequestFormatError
+ *      The filter is malformed.
+ */
+ObjectFilter::ObjectFilter(Buffer& buffer, uint32_t offset, uint32_t length)
+    : predicate(NONE)
+    , keyIndex(0)
+    , firstKey()
+    , lastKey()
+    , valueOffset(0)
+    , valueLength(~0U)
+{
+    const WireFormat::ObjectFilter* header =
+            buffer.getOffset<WireFormat::ObjectFilter>(offset);
+    if (header == NULL || length < sizeof32(*header))
+        throw MessageTooShortError(HERE);
+    uint32_t keysLength = header->firstKeyLength + header->lastKeyLength;
+    if (length != sizeof32(*header) + keysLength)
+        throw RequestFormatError(HERE);
+    if (header->predicate > KEY_RANGE)
+        throw RequestFormatError(HERE);
+
+    predicate = static_cast<Predicate>(header->predicate);
+    keyIndex = header->keyIndex;
+    valueOffset = header->valueOffset;
+    valueLength = header->valueLength;
+
+    const char* keys = static_cast<const char*>(
+            buffer.getRange(offset + sizeof32(*header), keysLength));
+    if (keysLength > 0 && keys == NULL)
+        throw MessageTooShortError(HERE);
+    firstKey.assign(keys, header->firstKeyLength);
+    lastKey.assign(keys + header->firstKeyLength, header->lastKeyLength);
+}
+
+/**
+ * Only return objects that have a particular key.
+ *
+ * \param keyIndex
+ *      Index of the key that must be present; 0 is the primary key, which
+ *      every object has.
+ */
+void
+ObjectFilter::requireKey(KeyIndex keyIndex)
+{
+    predicate = KEY_PRESENT;
+    this->keyIndex = keyIndex;
+    firstKey.clear();
+    lastKey.clear();
+}
+
+/**
+ * Only return objects whose key at a given index lies within a range.
+ * Objects without that key don't match.
+ *
+ * \param keyIndex
+ *      Index of the key to test; 0 is the primary key.
+ * \param firstKey
+ *      Smallest key that matches.
+ * \param firstKeyLength
+ *      Length of \a firstKey in bytes.
+ * \param lastKey
+ *      Largest key that matches.
+ * \param lastKeyLength
+ *      Length of \a lastKey in bytes.
+ */
+void
+ObjectFilter::requireKeyInRange(KeyIndex keyIndex,
+                                const void* firstKey, KeyLength firstKeyLength,
+                                const void* lastKey, KeyLength lastKeyLength)
+{
+    predicate = KEY_RANGE;
+    this->keyIndex = keyIndex;
+    this->firstKey.assign(static_cast<const char*>(firstKey), firstKeyLength);
+    this->lastKey.assign(static_cast<const char*>(lastKey), lastKeyLength);
+}
+
+/**
+ * Only return part of each object's value. Objects whose values are
+ * shorter than \a offset are still returned, with empty values.
+ *
+ * \param offset
+ *      Offset within the value of the first byte to return.
+ * \param length
+ *      Maximum number of bytes to return; ~0 means everything through
+ *      the end of the value.
+ */
+void
+ObjectFilter::projectValue(uint32_t offset, uint32_t length)
+{
+    valueOffset = offset;
+    valueLength = length;
+}
+
+/**
+ * Append the filter to an RPC request in the format masters expect.
+ *
+ * \param buffer
+ *      The filter is appended here.
+ * \return
+ *      The number of bytes appended.
+ */
+uint32_t
+ObjectFilter::serialize(Buffer& buffer) const
+{
+    WireFormat::ObjectFilter* header =
+            new(&buffer, APPEND) WireFormat::ObjectFilter();
+    header->predicate = downCast<uint8_t>(predicate);
+    header->keyIndex = keyIndex;
+    header->firstKeyLength = downCast<uint16_t>(firstKey.size());
+    header->lastKeyLength = downCast<uint16_t>(lastKey.size());
+    header->valueOffset = valueOffset;
+    header->valueLength = valueLength;
+    buffer.appendCopy(firstKey.data(), downCast<uint32_t>(firstKey.size()));
+    buffer.appendCopy(lastKey.data(), downCast<uint32_t>(lastKey.size()));
+    return sizeof32(*header) + downCast<uint32_t>(firstKey.size() +
+                                                  lastKey.size());
+}
+
+/**
+ * Return whether an object satisfies the filter's predicate.
+ */
+bool
+ObjectFilter::matches(Object& object) const
+{
+    if (predicate == NONE)
+        return true;
+
+    KeyLength keyLength = 0;
+    const void* key = object.getKey(keyIndex, &keyLength);
+    if (key == NULL)
+        return false;
+    if (predicate == KEY_PRESENT)
+        return true;
+
+    return ObjectFinder::keyCompare(firstKey.data(),
+                    downCast<uint16_t>(firstKey.size()), key, keyLength) <= 0 &&
+           ObjectFinder::keyCompare(lastKey.data(),
+                    downCast<uint16_t>(lastKey.size()), key, keyLength) >= 0;
+}
+
+/**
+ * Determine which bytes of an object's value the filter returns.
+ *
+ * \param object
+ *      The object.
+ * \param[out] offset
+ *      Offset of the first byte of value to return, relative to the start
+ *      of the object's keys and value (that is, the keys are not counted
+ *      as part of the value).
+ * \return
+ *      The number of bytes of value to return, starting at \a offset.
+ */
+uint32_t
+ObjectFilter::getValueRange(Object& object, uint32_t* offset) const
+{
+    uint16_t keysLength = 0;
+    object.getValueOffset(&keysLength);
+    uint32_t totalValueLength = object.getKeysAndValueLength() - keysLength;
+    uint32_t start = std::min(valueOffset, totalValueLength);
+    *offset = keysLength + start;
+    return std::min(valueLength, totalValueLength - start);
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,84 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_OBJECTFILTER_H
+#define RAMCLOUD_OBJECTFILTER_H
+
+#include "Buffer.h"
+#include "Object.h"
+
+namespace RAMCloud {
+
+/**
+ * Describes which objects a multiRead or enumeration should return, and
+ * which part of each object's value, so that masters can drop unwanted
+ * data before it goes over the network. A filter consists of an optional
+ * predicate on one of an object's keys and an optional byte range of the
+ * value (the projection); keys are always returned in full.
+ *
+ * Clients build a filter and pass it along with the request, which carries
+ * it in the format defined by WireFormat::ObjectFilter; masters parse it
+ * back out and apply it to each object before adding the object to the
+ * response.
+ */
+class ObjectFilter {
+  public:
+    /// The predicates that can be applied to objects. Values are part of
+    /// the wire format.
+    enum Predicate {
+        /// Every object matches.
+        NONE = 0,
+        /// Objects match if they have a key at #keyIndex.
+        KEY_PRESENT = 1,
+        /// Objects match if they have a key at #keyIndex that lies within
+        /// [#firstKey, #lastKey], inclusive, in the same order as used by
+        /// indexes.
+        KEY_RANGE = 2,
+    };
+
+    ObjectFilter();
+    ObjectFilter(Buffer& buffer, uint32_t offset, uint32_t length);
+    void requireKey(KeyIndex keyIndex);
+    void requireKeyInRange(KeyIndex keyIndex,
+                           const void* firstKey, KeyLength firstKeyLength,
+                           const void* lastKey, KeyLength lastKeyLength);
+    void projectValue(uint32_t offset, uint32_t length);
+    uint32_t serialize(Buffer& buffer) const;
+
+    bool matches(Object& object) const;
+    uint32_t getValueRange(Object& object, uint32_t* offset) const;
+
+  PRIVATE:
+    /// Which objects match the filter.
+    Predicate predicate;
+
+    /// The key tested by #predicate; 0 is the primary key.
+    KeyIndex keyIndex;
+
+    /// Bounds for KEY_RANGE; unused otherwise.
+    string firstKey;
+    string lastKey;
+
+    /// Offset of the first byte of each object's value to return.
+    uint32_t valueOffset;
+
+    /// Maximum number of bytes of each object's value to return, starting
+    /// at #valueOffset. ~0 means everything through the end of the value.
+    uint32_t valueLength;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_OBJECTFILTER_H
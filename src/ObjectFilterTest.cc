@@ -0,0 +1,135 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ClientException.h"
+#include "ObjectFilter.h"
+#include "RamCloud.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Unit tests for ObjectFilter.
+ */
+class ObjectFilterTest : public ::testing::Test {
+  public:
+    Buffer keysAndValue;
+    Tub<Object> object;
+
+    // The object has the primary key "pk", no key at index 1, the key
+    // "bob" at index 2, and the value "0123456789".
+    ObjectFilterTest()
+        : keysAndValue()
+        , object()
+    {
+        KeyInfo keyList[3];
+        keyList[0] = {"pk", 2};
+        keyList[1] = {NULL, 0};
+        keyList[2] = {"bob", 3};
+        Object::appendKeysAndValueToBuffer(1, 3, keyList, "0123456789", 10,
+                                           keysAndValue);
+        object.construct(1, 1, 0, keysAndValue);
+    }
+
+    /// Returns the part of the object's value that a filter selects.
+    string
+    projectedValue(ObjectFilter& filter)
+    {
+        uint32_t offset;
+        uint32_t length = filter.getValueRange(*object, &offset);
+        return TestUtil::toString(&keysAndValue, offset, length);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ObjectFilterTest);
+};
+
+TEST_F(ObjectFilterTest, constructor_default) {
+    ObjectFilter filter;
+    EXPECT_TRUE(filter.matches(*object));
+    EXPECT_EQ("0123456789", projectedValue(filter));
+}
+
+TEST_F(ObjectFilterTest, constructor_deserialize) {
+    ObjectFilter filter;
+    filter.requireKeyInRange(2, "a", 1, "bz", 2);
+    filter.projectValue(3, 4);
+
+    Buffer buffer;
+    buffer.appendCopy("xx", 2);
+    uint32_t length = filter.serialize(buffer);
+    EXPECT_EQ(sizeof32(WireFormat::ObjectFilter) + 3, length);
+    EXPECT_EQ(length + 2, buffer.getTotalLength());
+
+    ObjectFilter copy(buffer, 2, length);
+    EXPECT_EQ(ObjectFilter::KEY_RANGE, copy.predicate);
+    EXPECT_EQ(2U, copy.keyIndex);
+    EXPECT_EQ("a", copy.firstKey);
+    EXPECT_EQ("bz", copy.lastKey);
+    EXPECT_EQ(3U, copy.valueOffset);
+    EXPECT_EQ(4U, copy.valueLength);
+}
+
+TEST_F(ObjectFilterTest, constructor_deserializeMalformed) {
+    ObjectFilter filter;
+    filter.requireKeyInRange(2, "a", 1, "bz", 2);
+    Buffer buffer;
+    uint32_t length = filter.serialize(buffer);
+
+    EXPECT_THROW(ObjectFilter(buffer, 0, 4), MessageTooShortError);
+    EXPECT_THROW(ObjectFilter(buffer, 0, length - 1), RequestFormatError);
+
+    WireFormat::ObjectFilter badPredicate = {3, 0, 0, 0, 0, ~0U};
+    Buffer badBuffer;
+    badBuffer.appendCopy(&badPredicate);
+    EXPECT_THROW(ObjectFilter(badBuffer, 0, sizeof32(badPredicate)),
+                 RequestFormatError);
+}
+
+TEST_F(ObjectFilterTest, matches_keyPresent) {
+    ObjectFilter filter;
+    filter.requireKey(0);
+    EXPECT_TRUE(filter.matches(*object));
+    filter.requireKey(1);
+    EXPECT_FALSE(filter.matches(*object));
+    filter.requireKey(2);
+    EXPECT_TRUE(filter.matches(*object));
+    filter.requireKey(3);
+    EXPECT_FALSE(filter.matches(*object));
+}
+
+TEST_F(ObjectFilterTest, matches_keyRange) {
+    ObjectFilter filter;
+    filter.requireKeyInRange(2, "bob", 3, "bob", 3);
+    EXPECT_TRUE(filter.matches(*object));
+    filter.requireKeyInRange(2, "a", 1, "bo", 2);
+    EXPECT_FALSE(filter.matches(*object));
+    filter.requireKeyInRange(2, "boba", 4, "c", 1);
+    EXPECT_FALSE(filter.matches(*object));
+    filter.requireKeyInRange(1, "", 0, "zzz", 3);
+    EXPECT_FALSE(filter.matches(*object));
+}
+
+TEST_F(ObjectFilterTest, getValueRange) {
+    ObjectFilter filter;
+    filter.projectValue(2, 3);
+    EXPECT_EQ("234", projectedValue(filter));
+    filter.projectValue(8, 5);
+    EXPECT_EQ("89", projectedValue(filter));
+    filter.projectValue(12, ~0U);
+    EXPECT_EQ("", projectedValue(filter));
+}
+
+}  // namespace RAMCloud
@@ -126,6 +126,7 @@ ObjectFinder::ObjectFinder(Context* context)
     : context(context)
     , tableMap()
     , tableIndexMap()
+    , replicaMap()
     , tableConfigFetcher(new RealTableConfigFetcher(context))
 {
 }
@@ -150,6 +151,68 @@ ObjectFinder::flush(uint64_t tableId) {
     IndexletIter indexUpper = tableIndexMap.upper_bound(
                 std::make_pair(tableId, std::numeric_limits<uint8_t>::max()));
     tableIndexMap.erase(indexLower, indexUpper);
+
+    replicaMap.erase(replicaMap.lower_bound(start),
+                     replicaMap.upper_bound(end));
+}
+
+/**
+ * Record that a master told us where copies of a hot object are, so that
+ * later reads of it can be spread across them; see lookupForRead.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param keyHash
+ *      Hash of the object's primary key.
+ * \param locators
+ *      Buffer holding the service locators of the masters holding copies,
+ *      each followed by a null character.
+ * \param offset
+ *      Offset of the first locator within \a locators.
+ * \param length
+ *      Total size of the locators in bytes.
+ * \param leaseMs
+ *      The copies remain valid for this many milliseconds.
+ */
+void
+ObjectFinder::addReplicas(uint64_t tableId, KeyHash keyHash, Buffer& locators,
+                          uint32_t offset, uint32_t length, uint32_t leaseMs)
+{
+    if (replicaMap.size() >= MAX_REPLICA_ENTRIES)
+        replicaMap.clear();
+
+    Replicas& replicas = replicaMap[TabletKey{tableId, keyHash}];
+    replicas.locators.clear();
+    const char* data = static_cast<const char*>(
+            locators.getRange(offset, length));
+    const char* end = data + length;
+    while (data != NULL && data < end) {
+        const char* terminator = static_cast<const char*>(
+                memchr(data, '\0', end - data));
+        if (terminator == NULL)
+            break;
+        replicas.locators.emplace_back(data, terminator);
+        data = terminator + 1;
+    }
+    replicas.leaseExpiration = Cycles::rdtsc() +
+            Cycles::fromNanoseconds(leaseMs * 1000000UL);
+    if (replicas.nextReplica > replicas.locators.size())
+        replicas.nextReplica = 0;
+}
+
+/**
+ * Stop sending reads of an object to copies on other masters; used when
+ * a master that was supposed to hold a copy couldn't serve it.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param keyHash
+ *      Hash of the object's primary key.
+ */
+void
+ObjectFinder::flushReplicas(uint64_t tableId, KeyHash keyHash)
+{
+    replicaMap.erase(TabletKey{tableId, keyHash});
 }
 
 /**
@@ -222,6 +285,52 @@ ObjectFinder::lookup(uint64_t tableId, KeyHash keyHash)
                 lookupTablet(tableId, keyHash)->serviceLocator.c_str());
 }
 
+/**
+ * Find a master to send a read of an object to. Normally this is the
+ * owner of the object's tablet, as for lookup(), but if the object is hot
+ * and other masters hold copies of it, reads are spread round-robin across
+ * the owner and the copies.
+ *
+ * \param tableId
+ *      The table containing the desired object.
+ * \param keyHash
+ *      Hash of the object's primary key.
+ * \param[out] isReplica
+ *      Set to true if the returned session leads to a master holding a copy
+ *      rather than the owner.
+ * \return
+ *      Session for communication with the chosen master.
+ *
+ * \throw TableDoesntExistException
+ *      The coordinator has no record of the table.
+ */
+Transport::SessionRef
+ObjectFinder::lookupForRead(uint64_t tableId, KeyHash keyHash,
+                            bool* isReplica)
+{
+    *isReplica = false;
+    if (replicaMap.empty())
+        return lookup(tableId, keyHash);
+
+    std::map<TabletKey, Replicas>::iterator it =
+            replicaMap.find(TabletKey{tableId, keyHash});
+    if (it == replicaMap.end())
+        return lookup(tableId, keyHash);
+    Replicas& replicas = it->second;
+    if (replicas.leaseExpiration <= Cycles::rdtsc()) {
+        replicaMap.erase(it);
+        return lookup(tableId, keyHash);
+    }
+
+    size_t index = replicas.nextReplica;
+    replicas.nextReplica = (index + 1) % (replicas.locators.size() + 1);
+    if (index >= replicas.locators.size())
+        return lookup(tableId, keyHash);
+    *isReplica = true;
+    return context->transportManager->getSession(
+            replicas.locators[index].c_str());
+}
+
 /**
  * Lookup the master holding the indexlet containing the given key.
  *
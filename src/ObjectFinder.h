@@ -76,12 +76,17 @@ class ObjectFinder {
     Transport::SessionRef lookup(uint64_t tableId, KeyHash keyHash);
     Transport::SessionRef lookup(uint64_t tableId, uint8_t indexId,
                                  const void* key, uint16_t keyLength);
+    Transport::SessionRef lookupForRead(uint64_t tableId, KeyHash keyHash,
+                                        bool* isReplica);
 
     const Indexlet* lookupIndexlet(uint64_t tableId, uint8_t indexId,
                                    const void* key, uint16_t keyLength);
     const TabletWithLocator* lookupTablet(uint64_t table, KeyHash keyHash);
 
     void flush(uint64_t tableId);
+    void addReplicas(uint64_t tableId, KeyHash keyHash, Buffer& locators,
+                     uint32_t offset, uint32_t length, uint32_t leaseMs);
+    void flushReplicas(uint64_t tableId, KeyHash keyHash);
     void flushSession(uint64_t tableId, KeyHash keyHash);
     void flushSession(uint64_t tableId, uint8_t indexId,
                       const void* key, uint16_t keyLength);
@@ -124,6 +129,39 @@ class ObjectFinder {
     typedef std::multimap< std::pair<uint64_t, uint8_t>,
                                     Indexlet>::iterator IndexletIter;
 
+    /**
+     * Masters other than the owner that hold copies of a hot object; see
+     * HotKeyCache.
+     */
+    struct Replicas {
+        Replicas()
+            : locators()
+            , leaseExpiration(0)
+            , nextReplica(0)
+        {}
+
+        /// Service locators of the masters.
+        std::vector<string> locators;
+
+        /// Cycles::rdtsc() time after which the copies may no longer be
+        /// valid.
+        uint64_t leaseExpiration;
+
+        /// Reads go round-robin to the copies and the owner; this is the
+        /// index in #locators of the next one to use, or the size of
+        /// #locators for the owner.
+        size_t nextReplica;
+    };
+
+    /**
+     * Objects with copies on other masters, indexed by table id and key
+     * hash; entries are removed once their leases run out.
+     */
+    std::map<TabletKey, Replicas> replicaMap;
+
+    /// Upper limit on the size of #replicaMap.
+    static const size_t MAX_REPLICA_ENTRIES = 1000;
+
     /**
      * Update the local tablet map cache. Usually, calling
      * tableConfigFetcher.getTableConfig() is the same as calling
@@ -241,6 +241,49 @@ TEST_F(ObjectFinderTest, flushSession) {
     objectFinder->flushSession(99, 0);
 }
 
+TEST_F(ObjectFinderTest, lookupForRead) {
+    KeyHash keyHash = Key::getHash(1, "testKey", 7);
+    objectFinder->lookup(1, keyHash);
+    bool isReplica = true;
+    Transport::SessionRef session =
+            objectFinder->lookupForRead(1, keyHash, &isReplica);
+    EXPECT_FALSE(isReplica);
+    EXPECT_EQ("mock:host=server1", session->getServiceLocator());
+
+    Buffer locators;
+    locators.appendCopy("xx", 2);
+    locators.appendCopy("mock:host=server2\0mock:host=server3\0", 36);
+    objectFinder->addReplicas(1, keyHash, locators, 2, 36, 100);
+    string sequence;
+    for (int i = 0; i < 4; i++) {
+        session = objectFinder->lookupForRead(1, keyHash, &isReplica);
+        sequence += format("%s%s ", session->getServiceLocator().c_str(),
+                           isReplica ? "" : "(owner)");
+    }
+    EXPECT_EQ("mock:host=server2 mock:host=server3 "
+              "mock:host=server1(owner) mock:host=server2 ", sequence);
+
+    // Other keys still go to the owner.
+    session = objectFinder->lookupForRead(1, keyHash + 1, &isReplica);
+    EXPECT_FALSE(isReplica);
+
+    objectFinder->flushReplicas(1, keyHash);
+    session = objectFinder->lookupForRead(1, keyHash, &isReplica);
+    EXPECT_FALSE(isReplica);
+    EXPECT_EQ(0U, objectFinder->replicaMap.size());
+
+    // Expired entries are dropped.
+    objectFinder->addReplicas(1, keyHash, locators, 2, 36, 0);
+    session = objectFinder->lookupForRead(1, keyHash, &isReplica);
+    EXPECT_FALSE(isReplica);
+    EXPECT_EQ(0U, objectFinder->replicaMap.size());
+
+    // flush() forgets about copies too.
+    objectFinder->addReplicas(1, keyHash, locators, 2, 36, 100);
+    objectFinder->flush(1);
+    EXPECT_EQ(0U, objectFinder->replicaMap.size());
+}
+
 TEST_F(ObjectFinderTest, lookupIndexlet) {
     char a = 'a';
     char b = 'b';
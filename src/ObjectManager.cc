@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <unordered_set>
+
 #include "Buffer.h"
 #include "Cycles.h"
 #include "Dispatch.h"
@@ -24,6 +26,7 @@
 #include "Object.h"
 #include "ShortMacros.h"
 #include "RawMetrics.h"
+#include "RpcStageTimer.h"
 #include "Tub.h"
 #include "ProtoBuf.h"
 #include "Segment.h"
@@ -66,11 +69,14 @@ ObjectManager::ObjectManager(Context* context,
     , allocator(config)
     , replicaManager(context, serverId,
                      config->master.numReplicas,
-                     config->master.useMinCopysets)
+                     config->master.useMinCopysets,
+                     config->master.useLoadAwareBackupSelection)
     , segmentManager(context, config, serverId,
                      allocator, replicaManager, masterTableMetadata)
     , log(context, config, this, &segmentManager, &replicaManager)
     , objectMap(config->master.hashTableBytes / HashTable::bytesPerCacheLine())
+    , snapshotManager(&log, objectMap.getNumBuckets())
+    , hotKeyCache(context, serverId, config->master.hotKeyReplicas)
     , anyWrites(false)
     , hashTableBucketLocks()
     , replaySegmentReturnCount(0)
@@ -261,24 +267,7 @@ ObjectManager::writeObject(Object& newObject,
                            uint64_t* outVersion,
                            Buffer* removedObjBuffer)
 {
-    if (!anyWrites) {
-        // This is the first write; use this as a trigger to update the
-        // cluster configuration information and open a session with each
-        // backup, so it won't slow down recovery benchmarks.  This is a
-        // temporary hack, and needs to be replaced with a more robust
-        // approach to updating cluster configuration information.
-        anyWrites = true;
-
-        // Empty coordinator locator means we're in test mode, so skip this.
-        if (!context->coordinatorSession->getLocation().empty()) {
-            ProtoBuf::ServerList backups;
-            CoordinatorClient::getBackupList(context, &backups);
-            TransportManager& transportManager =
-                *context->transportManager;
-            foreach(auto& backup, backups.server())
-                transportManager.getSession(backup.service_locator().c_str());
-        }
-    }
+    initOnFirstWrite();
 
     uint16_t keyLength = 0;
     const void *keyString = newObject.getKey(0, &keyLength);
@@ -286,7 +275,39 @@ ObjectManager::writeObject(Object& newObject,
 
     objectMap.prefetchBucket(key.getHash());
     HashTableBucketLock lock(*this, key);
+    return writeObject(lock, key, newObject, rejectRules, outVersion,
+                       removedObjBuffer);
+}
 
+/**
+ * Does all the work of the public writeObject method, once the caller holds
+ * the lock for the object's hash table bucket. This allows methods such as
+ * readModifyWriteObject to read an object and write its new version
+ * atomically.
+ *
+ * \param lock
+ *      Lock on the hash table bucket that \a key maps to.
+ * \param key
+ *      The primary key of \a newObject.
+ * \param newObject
+ *      The new object to be written to the log; see the public writeObject.
+ * \param rejectRules
+ *      See the public writeObject.
+ * \param[out] outVersion
+ *      See the public writeObject.
+ * \param[out] removedObjBuffer
+ *      See the public writeObject.
+ * \return
+ *      See the public writeObject.
+ */
+Status
+ObjectManager::writeObject(HashTableBucketLock& lock,
+                           Key& key,
+                           Object& newObject,
+                           RejectRules* rejectRules,
+                           uint64_t* outVersion,
+                           Buffer* removedObjBuffer)
+{
     // If the tablet doesn't exist in the NORMAL state, we must plead ignorance.
     TabletManager::Tablet tablet;
     if (!tabletManager->getTablet(key, &tablet))
@@ -368,6 +389,8 @@ ObjectManager::writeObject(Object& newObject,
         return STATUS_RETRY;
     }
 
+    snapshotManager.preserve(key, tombstone ? currentReference.toInteger() : 0);
+    hotKeyCache.noteWrite(key, newObject.getVersion());
     if (tombstone) {
         currentHashTableEntry.setReference(appends[0].reference.toInteger());
         log.free(currentReference);
@@ -405,6 +428,282 @@ ObjectManager::writeObject(Object& newObject,
     return STATUS_OK;
 }
 
+/**
+ * Write a batch of objects, as if by calling writeObject for each of them
+ * in order, but much more cheaply: all of the objects' hash table buckets
+ * are locked at once, and all of the new objects and tombstones are
+ * appended to the log in a single Log::append call (batches larger than
+ * MAX_WRITE_BATCH_BYTES or MAX_WRITE_BATCH_OBJECTS are split). This is
+ * the write path for multiWrite and bulk loads.
+ *
+ * The batch as a whole is not atomic: each object succeeds or fails on its
+ * own, just as with writeObject. As with writeObject, the caller must
+ * call syncChanges() once afterwards to make the writes durable.
+ *
+ * \param writes
+ *      The objects to write. On return, the status and version of each
+ *      have been filled in.
+ * \param numWrites
+ *      Number of entries in \a writes.
+ */
+void
+ObjectManager::writeObjects(BatchedWrite* writes, uint32_t numWrites)
+{
+    initOnFirstWrite();
+
+    uint32_t first = 0;
+    std::unordered_set<uint64_t> keyHashes;
+    while (first < numWrites) {
+        // Pick the longest run of writes that fits in a batch. A key may
+        // only appear once per batch: a second write to it has to see the
+        // first one's version and hash table entry.
+        keyHashes.clear();
+        uint32_t count = 0;
+        uint64_t bytes = 0;
+        while (first + count < numWrites) {
+            Object* object = writes[first + count].object;
+            uint16_t keyLength = 0;
+            const void* keyString = object->getKey(0, &keyLength);
+            Key key(object->getTableId(), keyString, keyLength);
+            bytes += object->getSerializedLength();
+            if (count > 0 && (bytes > MAX_WRITE_BATCH_BYTES ||
+                    count == MAX_WRITE_BATCH_OBJECTS ||
+                    keyHashes.count(key.getHash()) != 0))
+                break;
+            keyHashes.insert(key.getHash());
+            count++;
+        }
+        writeBatch(&writes[first], count);
+        first += count;
+    }
+}
+
+/**
+ * Invoked at the start of every write. The first time, this opens a session
+ * with each backup, so it won't slow down recovery benchmarks. This is a
+ * temporary hack, and needs to be replaced with a more robust approach to
+ * updating cluster configuration information.
+ */
+void
+ObjectManager::initOnFirstWrite()
+{
+    if (anyWrites)
+        return;
+    anyWrites = true;
+
+    // Empty coordinator locator means we're in test mode, so skip this.
+    if (!context->coordinatorSession->getLocation().empty()) {
+        ProtoBuf::ServerList backups;
+        CoordinatorClient::getBackupList(context, &backups);
+        TransportManager& transportManager =
+            *context->transportManager;
+        foreach(auto& backup, backups.server())
+            transportManager.getSession(backup.service_locator().c_str());
+    }
+}
+
+/**
+ * Does the work of writeObjects for one batch: locks the hash table buckets
+ * of all of the objects, checks each write the way writeObject does, appends
+ * every new object and tombstone with one Log::append call, and then updates
+ * the hash table.
+ *
+ * \param writes
+ *      The writes in the batch. No two of them may have the same key, and
+ *      their objects must fit in a segment.
+ * \param numWrites
+ *      Number of entries in \a writes.
+ */
+void
+ObjectManager::writeBatch(BatchedWrite* writes, uint32_t numWrites)
+{
+    // State kept for each write between checking it and updating the hash
+    // table once its entries are in the log.
+    struct Pending {
+        Pending()
+            : key()
+            , lockIndex(0)
+            , tablet()
+            , currentBuffer()
+            , currentReference()
+            , currentHashTableEntry()
+            , tombstone()
+            , objectAppend(-1)
+        {}
+        Tub<Key> key;
+        uint64_t lockIndex;
+        TabletManager::Tablet tablet;
+        /// The object being overwritten, if any. Its tombstone may refer
+        /// to memory in here, so it must live until the append is done.
+        Buffer currentBuffer;
+        Log::Reference currentReference;
+        HashTable::Candidates currentHashTableEntry;
+        Tub<ObjectTombstone> tombstone;
+        /// Index in appends of the new object; -1 if it isn't being
+        /// written.
+        int objectAppend;
+    };
+    std::unique_ptr<Pending[]> pending(new Pending[numWrites]);
+    std::unique_ptr<Log::AppendVector[]> appends(
+            new Log::AppendVector[2 * numWrites]);
+
+    // Lock every bucket the batch touches. The locks are taken in index
+    // order so that concurrent batches can't deadlock (and each is taken
+    // only once, since different buckets share locks).
+    uint32_t numLocks = arrayLength(hashTableBucketLocks);
+    vector<uint64_t> lockIndexes;
+    for (uint32_t i = 0; i < numWrites; i++) {
+        Object* object = writes[i].object;
+        uint16_t keyLength = 0;
+        const void* keyString = object->getKey(0, &keyLength);
+        pending[i].key.construct(object->getTableId(), keyString, keyLength);
+        objectMap.prefetchBucket(pending[i].key->getHash());
+        uint64_t unused;
+        pending[i].lockIndex = HashTable::findBucketIndex(
+                objectMap.getNumBuckets(), pending[i].key->getHash(),
+                &unused) & (numLocks - 1);
+        lockIndexes.push_back(pending[i].lockIndex);
+    }
+    std::sort(lockIndexes.begin(), lockIndexes.end());
+    lockIndexes.erase(std::unique(lockIndexes.begin(), lockIndexes.end()),
+                      lockIndexes.end());
+    Tub<HashTableBucketLock> locks[lockIndexes.size()];
+    for (uint32_t i = 0; i < lockIndexes.size(); i++)
+        locks[i].construct(*this, lockIndexes[i]);
+
+    // Check each write and assemble its log entries, as writeObject does.
+    uint32_t numAppends = 0;
+    for (uint32_t i = 0; i < numWrites; i++) {
+        BatchedWrite& write = writes[i];
+        Pending& p = pending[i];
+        Key& key = *p.key;
+        HashTableBucketLock& lock = *locks[std::lower_bound(
+                lockIndexes.begin(), lockIndexes.end(), p.lockIndex) -
+                lockIndexes.begin()];
+
+        if (!tabletManager->getTablet(key, &p.tablet) ||
+                p.tablet.state != TabletManager::NORMAL) {
+            write.status = STATUS_UNKNOWN_TABLET;
+            continue;
+        }
+
+        LogEntryType currentType = LOG_ENTRY_TYPE_INVALID;
+        Buffer& currentBuffer = p.currentBuffer;
+        uint64_t currentVersion = VERSION_NONEXISTENT;
+        if (lookup(lock, key, currentType, currentBuffer, 0,
+                   &p.currentReference, &p.currentHashTableEntry)) {
+            if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
+                removeIfTombstone(p.currentReference.toInteger(), this);
+            } else {
+                Object currentObject(currentBuffer);
+                currentVersion = currentObject.getVersion();
+            }
+        }
+
+        if (write.rejectRules != NULL) {
+            write.status = rejectOperation(write.rejectRules, currentVersion);
+            if (write.status != STATUS_OK) {
+                write.version = currentVersion;
+                continue;
+            }
+        }
+
+        Object& newObject = *write.object;
+        newObject.setVersion((currentVersion == VERSION_NONEXISTENT) ?
+                segmentManager.allocateVersion() : currentVersion + 1);
+        newObject.setTimestamp(WallTime::secondsTimestamp());
+
+        if (currentVersion != VERSION_NONEXISTENT) {
+            Object object(currentBuffer);
+            p.tombstone.construct(object,
+                                  log.getSegmentId(p.currentReference),
+                                  WallTime::secondsTimestamp());
+            if (write.removedObjBuffer != NULL)
+                write.removedObjBuffer->append(&currentBuffer);
+        }
+
+        // Each tombstone directly follows its object, so that a backup
+        // never sees one without the other (see writeObject).
+        p.objectAppend = numAppends;
+        newObject.assembleForLog(appends[numAppends].buffer);
+        appends[numAppends].type = LOG_ENTRY_TYPE_OBJ;
+        numAppends++;
+        if (p.tombstone) {
+            p.tombstone->assembleForLog(appends[numAppends].buffer);
+            appends[numAppends].type = LOG_ENTRY_TYPE_OBJTOMB;
+            numAppends++;
+        }
+    }
+
+    if (numAppends == 0)
+        return;
+
+    if (!log.append(appends.get(), numAppends)) {
+        // The log is out of space; see writeObject.
+        for (uint32_t i = 0; i < numWrites; i++) {
+            if (pending[i].objectAppend < 0)
+                continue;
+            writes[i].status = STATUS_RETRY;
+            if (writes[i].removedObjBuffer != NULL)
+                writes[i].removedObjBuffer->reset();
+        }
+        return;
+    }
+
+    // Overwrites update the hash table before any inserts: an insert into
+    // a full cache line moves its last entry to a new line, which would
+    // leave another write's Candidates pointing at what is now a chain
+    // pointer.
+    for (uint32_t i = 0; i < numWrites; i++) {
+        Pending& p = pending[i];
+        if (p.objectAppend < 0)
+            continue;
+        snapshotManager.preserve(*p.key,
+                p.tombstone ? p.currentReference.toInteger() : 0);
+        if (p.tombstone) {
+            p.currentHashTableEntry.setReference(
+                    appends[p.objectAppend].reference.toInteger());
+            log.free(p.currentReference);
+        }
+    }
+
+    for (uint32_t i = 0; i < numWrites; i++) {
+        BatchedWrite& write = writes[i];
+        Pending& p = pending[i];
+        if (p.objectAppend < 0)
+            continue;
+        Key& key = *p.key;
+        Log::AppendVector& objectAppend = appends[p.objectAppend];
+
+        hotKeyCache.noteWrite(key, write.object->getVersion());
+        uint64_t byteCount = objectAppend.buffer.getTotalLength();
+        uint64_t recordCount = 1;
+        if (p.tombstone) {
+            byteCount += appends[p.objectAppend + 1].buffer.getTotalLength();
+            recordCount++;
+        } else {
+            objectMap.insert(key.getHash(),
+                             objectAppend.reference.toInteger());
+        }
+
+        write.status = STATUS_OK;
+        write.version = write.object->getVersion();
+        tabletManager->incrementWriteCount(key);
+
+        TEST_LOG("object: %u bytes, version %lu",
+            objectAppend.buffer.getTotalLength(), write.version);
+        if (p.tombstone) {
+            TEST_LOG("tombstone: %u bytes, version %lu",
+                appends[p.objectAppend + 1].buffer.getTotalLength(),
+                p.tombstone->getObjectVersion());
+        }
+        TableStats::increment(masterTableMetadata,
+                              p.tablet.tableId,
+                              byteCount,
+                              recordCount);
+    }
+}
+
 /**
  * Read an object previously written to this ObjectManager.
  *
@@ -475,6 +774,123 @@ ObjectManager::readObject(Key& key,
     return STATUS_OK;
 }
 
+/**
+ * Atomically replace the value of an object with one computed from its
+ * current value. The object is read, the new value computed, and the new
+ * version written while holding the lock for the object's hash table
+ * bucket, so no other update of the object can intervene. The object's
+ * keys are unchanged, so secondary indexes need no updates.
+ *
+ * Just like writeObject(), the new version isn't guaranteed to be durable
+ * until syncChanges() is called.
+ *
+ * \param key
+ *      Key of the object to modify.
+ * \param operation
+ *      Computes the object's new value from its current one.
+ * \param rejectRules
+ *      If non-NULL, use the specified rules to perform a conditional update.
+ *      See the RejectRules class documentation for more details.
+ * \param[out] outVersion
+ *      If non-NULL, the new version of the object is returned here if the
+ *      operation succeeded; otherwise the current version, if the object
+ *      exists.
+ * \param[out] outValue
+ *      If non-NULL, a copy of the object's new value is appended here if the
+ *      operation succeeded, or a copy of its current value if the status is
+ *      STATUS_RMW_CONDITION_FAILED.
+ * \param maxValueLength
+ *      Largest value the caller can accept in \a outValue. If the value to
+ *      be returned is longer, the object is left unchanged and STATUS_RETRY
+ *      is returned; multiReadModifyWrite uses this to stop before a result
+ *      that wouldn't fit in its reply.
+ * \return
+ *      STATUS_OK if the object was updated. Otherwise, for example,
+ *      STATUS_OBJECT_DOESNT_EXIST or STATUS_RMW_CONDITION_FAILED may be
+ *      returned; in that case there were no changes made and the caller need
+ *      not sync. STATUS_RMW_CONDITION_FAILED is also returned if the
+ *      operation would grow the object past MAX_OBJECT_SIZE.
+ */
+Status
+ObjectManager::readModifyWriteObject(Key& key,
+                                     RmwOperation& operation,
+                                     RejectRules* rejectRules,
+                                     uint64_t* outVersion,
+                                     Buffer* outValue,
+                                     uint32_t maxValueLength)
+{
+    objectMap.prefetchBucket(key.getHash());
+    HashTableBucketLock lock(*this, key);
+
+    // If the tablet doesn't exist in the NORMAL state, we must plead ignorance.
+    TabletManager::Tablet tablet;
+    if (!tabletManager->getTablet(key, &tablet))
+        return STATUS_UNKNOWN_TABLET;
+    if (tablet.state != TabletManager::NORMAL)
+        return STATUS_UNKNOWN_TABLET;
+
+    Buffer buffer;
+    LogEntryType type;
+    uint64_t version;
+    bool found = lookup(lock, key, type, buffer, &version);
+    if (!found || type != LOG_ENTRY_TYPE_OBJ)
+        return STATUS_OBJECT_DOESNT_EXIST;
+
+    if (outVersion != NULL)
+        *outVersion = version;
+
+    if (rejectRules != NULL) {
+        Status status = rejectOperation(rejectRules, version);
+        if (status != STATUS_OK)
+            return status;
+    }
+
+    Object object(buffer);
+    Buffer keysAndValue;
+    object.appendKeysAndValueToBuffer(keysAndValue);
+    uint16_t valueOffset = 0;
+    object.getValueOffset(&valueOffset);
+    uint32_t valueLength = keysAndValue.getTotalLength() - valueOffset;
+
+    // The new object refers to the log for everything but the bytes the
+    // operation changed; the log copies it all when the object is appended.
+    Buffer newKeysAndValue;
+    Buffer::Chunk::appendToBuffer(&newKeysAndValue, &keysAndValue, 0,
+                                  valueOffset);
+    Status status = operation.apply(keysAndValue, valueOffset, valueLength,
+                                    newKeysAndValue);
+
+    // An object that grew past the limit might never fit in the log (the
+    // write would be retried forever), so treat that like any other failed
+    // condition.
+    uint32_t newLength = newKeysAndValue.getTotalLength();
+    if (status == STATUS_OK && newLength > MAX_OBJECT_SIZE &&
+            newLength > keysAndValue.getTotalLength())
+        status = STATUS_RMW_CONDITION_FAILED;
+
+    if (status != STATUS_OK) {
+        if (status == STATUS_RMW_CONDITION_FAILED && outValue != NULL) {
+            if (valueLength > maxValueLength)
+                return STATUS_RETRY;
+            keysAndValue.copy(valueOffset, valueLength,
+                              new(outValue, APPEND) char[valueLength]);
+        }
+        return status;
+    }
+
+    uint32_t newValueLength = newLength - valueOffset;
+    if (outValue != NULL && newValueLength > maxValueLength)
+        return STATUS_RETRY;
+
+    Object newObject(key.getTableId(), 0, 0, newKeysAndValue);
+    status = writeObject(lock, key, newObject, NULL, outVersion);
+    if (status == STATUS_OK && outValue != NULL) {
+        newKeysAndValue.copy(valueOffset, newValueLength,
+                             new(outValue, APPEND) char[newValueLength]);
+    }
+    return status;
+}
+
 /**
  * Remove an object previously written to this ObjectManager.
  *
@@ -564,6 +980,8 @@ ObjectManager::removeObject(Key& key,
                           tombstoneBuffer.getTotalLength(),
                           1);
     segmentManager.raiseSafeVersion(object.getVersion() + 1);
+    snapshotManager.preserve(key, reference.toInteger());
+    hotKeyCache.noteWrite(key, object.getVersion() + 1);
     log.free(reference);
     remove(lock, key);
     return STATUS_OK;
@@ -574,12 +992,15 @@ ObjectManager::removeObject(Key& key,
  * writeObject() or removeObject() invocation if the caller wants to ensure that
  * the change is committed to stable storage. Prior to invoking this, no
  * guarantees are made about the consistency of backup and master views of the
- * log since the previous syncChanges() operation.
+ * log since the previous syncChanges() operation. It also invalidates any
+ * copies of the modified objects held by other masters (see HotKeyCache).
  */
 void
 ObjectManager::syncChanges()
 {
+    RpcStageTimer _(RpcStageTimer::SYNC);
     log.sync();
+    hotKeyCache.sync();
 }
 
 /**
@@ -686,18 +1107,7 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
     // Metrics can be very expense (they're atomic operations), so we aggregate
     // as much as we can in local variables and update the counters once at the
     // end of this method.
-    uint64_t verifyChecksumTicks = 0;
-    uint64_t segmentAppendTicks = 0;
-    uint64_t recoverySegmentEntryCount = 0;
-    uint64_t recoverySegmentEntryBytes = 0;
-    uint64_t objectAppendCount = 0;
-    uint64_t tombstoneAppendCount = 0;
-    uint64_t liveObjectCount = 0;
-    uint64_t liveObjectBytes = 0;
-    uint64_t objectDiscardCount = 0;
-    uint64_t tombstoneDiscardCount = 0;
-    uint64_t safeVersionRecoveryCount = 0;
-    uint64_t safeVersionNonRecoveryCount = 0;
+    ReplayCounters counters;
 
     // Keep track of the number of times this method returns (or throws). See
     // RemoveTombstonePoller for how this count is used.
@@ -712,210 +1122,255 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
         prefetchHashTableBucket(&prefetcher);
         prefetcher.next();
 
-        LogEntryType type = it.getType();
-
         if (bytesIterated > 50000) {
             bytesIterated = 0;
             replicaManager.proceed();
         }
         bytesIterated += it.getLength();
 
-        recoverySegmentEntryCount++;
-        recoverySegmentEntryBytes += it.getLength();
+        // The recovery segment is guaranteed to be contiguous, so we need
+        // not provide a copyout buffer.
+        replayEntry(sideLog,
+                    it.getType(),
+                    it.getContiguous<void>(NULL, 0),
+                    it.getLength(),
+                    counters);
 
-        if (expect_true(type == LOG_ENTRY_TYPE_OBJ)) {
-            // The recovery segment is guaranteed to be contiguous, so we need
-            // not provide a copyout buffer.
-
-            const Object::Header* recoveryObj =
-                it.getContiguous<Object::Header>(NULL, 0);
+        it.next();
+    }
 
-            Object replayObj(recoveryObj, it.getLength());
-            KeyLength primaryKeyLen = 0;
-            const void *primaryKey = replayObj.getKey(0, &primaryKeyLen);
+    counters.flush(masterTableMetadata);
+    metrics->master.backupInRecoverTicks +=
+        metrics->master.replicaManagerTicks - startReplicationTicks;
+    metrics->master.recoverSegmentPostingWriteRpcTicks +=
+        metrics->master.replicationPostingWriteRpcTicks -
+        startReplicationPostingWriteRpcTicks;
+}
 
-            Key key(recoveryObj->tableId, primaryKey, primaryKeyLen);
+/**
+ * Replay a single entry from a recovery segment. This contains the guts of
+ * replaySegment() and is also used by ParallelSegmentReplayer, whose threads
+ * each replay the entries falling into their own range of hash table bucket
+ * locks.
+ *
+ * \param sideLog
+ *      Pointer to the SideLog in which the replayed entry will be stored (if
+ *      it is not obsolete).
+ * \param type
+ *      Type of the entry being replayed. Entries other than objects,
+ *      tombstones, and safe versions are ignored.
+ * \param entry
+ *      Pointer to the contiguous contents of the entry in the recovery
+ *      segment.
+ * \param length
+ *      Length of the entry in bytes.
+ * \param counters
+ *      Local statistics to update. These are added to the server's metrics
+ *      and table stats by the caller (see ReplayCounters::flush()).
+ */
+void
+ObjectManager::replayEntry(SideLog* sideLog,
+                           LogEntryType type,
+                           const void* entry,
+                           uint32_t length,
+                           ReplayCounters& counters)
+{
+    counters.recoverySegmentEntryCount++;
+    counters.recoverySegmentEntryBytes += length;
 
-            bool checksumIsValid = ({
-                CycleCounter<uint64_t> c(&verifyChecksumTicks);
-                Object::computeChecksum(recoveryObj, it.getLength()) ==
-                    recoveryObj->checksum;
-            });
-            if (expect_false(!checksumIsValid)) {
-                LOG(WARNING, "bad object checksum! key: %s, version: %lu",
-                    key.toString().c_str(), recoveryObj->version);
-                // TODO(Stutsman): Should throw and try another segment replica?
-            }
+    if (expect_true(type == LOG_ENTRY_TYPE_OBJ)) {
+        const Object::Header* recoveryObj =
+            static_cast<const Object::Header*>(entry);
 
-            HashTableBucketLock lock(*this, key);
+        Object replayObj(recoveryObj, length);
+        KeyLength primaryKeyLen = 0;
+        const void *primaryKey = replayObj.getKey(0, &primaryKeyLen);
+
+        Key key(recoveryObj->tableId, primaryKey, primaryKeyLen);
+
+        bool checksumIsValid = ({
+            CycleCounter<uint64_t> c(&counters.verifyChecksumTicks);
+            Object::computeChecksum(recoveryObj, length) ==
+                recoveryObj->checksum;
+        });
+        if (expect_false(!checksumIsValid)) {
+            LOG(WARNING, "bad object checksum! key: %s, version: %lu",
+                key.toString().c_str(), recoveryObj->version);
+            // TODO(Stutsman): Should throw and try another segment replica?
+        }
 
-            uint64_t minSuccessor = 0;
-            bool freeCurrentEntry = false;
+        HashTableBucketLock lock(*this, key);
 
-            LogEntryType currentType;
-            Buffer currentBuffer;
-            Log::Reference currentReference;
-            if (lookup(lock, key, currentType, currentBuffer, 0,
-                                                        &currentReference)) {
-                uint64_t currentVersion;
+        uint64_t minSuccessor = 0;
+        bool freeCurrentEntry = false;
 
-                if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
-                    ObjectTombstone currentTombstone(currentBuffer);
-                    currentVersion = currentTombstone.getObjectVersion();
-                } else {
-                    Object currentObject(currentBuffer);
-                    currentVersion = currentObject.getVersion();
-                    freeCurrentEntry = true;
-                }
+        LogEntryType currentType;
+        Buffer currentBuffer;
+        Log::Reference currentReference;
+        if (lookup(lock, key, currentType, currentBuffer, 0,
+                                                    &currentReference)) {
+            uint64_t currentVersion;
 
-                minSuccessor = currentVersion + 1;
+            if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
+                ObjectTombstone currentTombstone(currentBuffer);
+                currentVersion = currentTombstone.getObjectVersion();
+            } else {
+                Object currentObject(currentBuffer);
+                currentVersion = currentObject.getVersion();
+                freeCurrentEntry = true;
             }
 
-            if (recoveryObj->version >= minSuccessor) {
-                // write to log (with lazy backup flush) & update hash table
-                Log::Reference newObjReference;
-                {
-                    CycleCounter<uint64_t> _(&segmentAppendTicks);
-                    sideLog->append(LOG_ENTRY_TYPE_OBJ,
-                                    recoveryObj,
-                                    it.getLength(),
-                                    &newObjReference);
-                    TableStats::increment(masterTableMetadata,
-                                          key.getTableId(),
-                                          it.getLength(),
-                                          1);
-                }
-
-                // TODO(steve/ryan): what happens if the log is full? won't an
-                //      exception here just cause the master to try another
-                //      backup?
-
-                objectAppendCount++;
-                liveObjectBytes += it.getLength();
-
-                replace(lock, key, newObjReference);
+            minSuccessor = currentVersion + 1;
+        }
 
-                // nuke the old object, if it existed
-                // TODO(steve): put tombstones in the HT and have this free them
-                //              as well
-                if (freeCurrentEntry) {
-                    liveObjectBytes -= currentBuffer.getTotalLength();
-                    sideLog->free(currentReference);
-                } else {
-                    liveObjectCount++;
-                }
-            } else {
-                objectDiscardCount++;
-            }
-        } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
-            Buffer buffer;
-            it.appendToBuffer(buffer);
-            Key key(type, buffer);
-
-            ObjectTombstone recoverTomb(buffer);
-            bool checksumIsValid = ({
-                CycleCounter<uint64_t> c(&verifyChecksumTicks);
-                recoverTomb.checkIntegrity();
-            });
-            if (expect_false(!checksumIsValid)) {
-                LOG(WARNING, "bad tombstone checksum! key: %s, version: %lu",
-                    key.toString().c_str(), recoverTomb.getObjectVersion());
-                // TODO(Stutsman): Should throw and try another segment replica?
+        if (recoveryObj->version >= minSuccessor) {
+            // write to log (with lazy backup flush) & update hash table
+            Log::Reference newObjReference;
+            {
+                CycleCounter<uint64_t> _(&counters.segmentAppendTicks);
+                sideLog->append(LOG_ENTRY_TYPE_OBJ,
+                                recoveryObj,
+                                length,
+                                &newObjReference);
+                counters.incrementTableStats(masterTableMetadata,
+                                             key.getTableId(),
+                                             length);
             }
 
-            HashTableBucketLock lock(*this, key);
+            // TODO(steve/ryan): what happens if the log is full? won't an
+            //      exception here just cause the master to try another
+            //      backup?
 
-            uint64_t minSuccessor = 0;
-            bool freeCurrentEntry = false;
+            counters.objectAppendCount++;
+            counters.liveObjectBytes += length;
 
-            LogEntryType currentType;
-            Buffer currentBuffer;
-            Log::Reference currentReference;
-            if (lookup(lock, key, currentType, currentBuffer, 0,
-                                                        &currentReference)) {
-                if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
-                    ObjectTombstone currentTombstone(currentBuffer);
-                    minSuccessor = currentTombstone.getObjectVersion() + 1;
-                } else {
-                    Object currentObject(currentBuffer);
-                    minSuccessor = currentObject.getVersion();
-                    freeCurrentEntry = true;
-                }
+            replace(lock, key, newObjReference);
+
+            // nuke the old object, if it existed
+            // TODO(steve): put tombstones in the HT and have this free them
+            //              as well
+            if (freeCurrentEntry) {
+                counters.liveObjectBytes -= currentBuffer.getTotalLength();
+                sideLog->free(currentReference);
+            } else {
+                counters.liveObjectCount++;
             }
+        } else {
+            counters.objectDiscardCount++;
+        }
+    } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+        Buffer buffer;
+        buffer.append(entry, length);
+        Key key(type, buffer);
 
-            if (recoverTomb.getObjectVersion() >= minSuccessor) {
-                tombstoneAppendCount++;
-                Log::Reference newTombReference;
-                {
-                    CycleCounter<uint64_t> _(&segmentAppendTicks);
-                    sideLog->append(LOG_ENTRY_TYPE_OBJTOMB,
-                                    buffer,
-                                    &newTombReference);
-                    TableStats::increment(masterTableMetadata,
-                                          key.getTableId(),
-                                          buffer.getTotalLength(),
-                                          1);
-                }
+        ObjectTombstone recoverTomb(buffer);
+        bool checksumIsValid = ({
+            CycleCounter<uint64_t> c(&counters.verifyChecksumTicks);
+            recoverTomb.checkIntegrity();
+        });
+        if (expect_false(!checksumIsValid)) {
+            LOG(WARNING, "bad tombstone checksum! key: %s, version: %lu",
+                key.toString().c_str(), recoverTomb.getObjectVersion());
+            // TODO(Stutsman): Should throw and try another segment replica?
+        }
 
-                // TODO(steve/ryan): append could fail here!
+        HashTableBucketLock lock(*this, key);
 
-                replace(lock, key, newTombReference);
+        uint64_t minSuccessor = 0;
+        bool freeCurrentEntry = false;
 
-                // nuke the object, if it existed
-                if (freeCurrentEntry) {
-                    liveObjectCount++;
-                    liveObjectBytes -= currentBuffer.getTotalLength();
-                    sideLog->free(currentReference);
-                }
+        LogEntryType currentType;
+        Buffer currentBuffer;
+        Log::Reference currentReference;
+        if (lookup(lock, key, currentType, currentBuffer, 0,
+                                                    &currentReference)) {
+            if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
+                ObjectTombstone currentTombstone(currentBuffer);
+                minSuccessor = currentTombstone.getObjectVersion() + 1;
             } else {
-                tombstoneDiscardCount++;
-            }
-        } else if (type == LOG_ENTRY_TYPE_SAFEVERSION) {
-            // LOG_ENTRY_TYPE_SAFEVERSION is duplicated to all the
-            // partitions in BackupService::buildRecoverySegments()
-            Buffer buffer;
-            it.appendToBuffer(buffer);
-
-            ObjectSafeVersion recoverSafeVer(buffer);
-            uint64_t safeVersion = recoverSafeVer.getSafeVersion();
-
-            bool checksumIsValid = ({
-                CycleCounter<uint64_t> _(&verifyChecksumTicks);
-                recoverSafeVer.checkIntegrity();
-            });
-            if (expect_false(!checksumIsValid)) {
-                LOG(WARNING, "bad objectSafeVer checksum! version: %lu",
-                    safeVersion);
-                // TODO(Stutsman): Should throw and try another segment replica?
+                Object currentObject(currentBuffer);
+                minSuccessor = currentObject.getVersion();
+                freeCurrentEntry = true;
             }
+        }
 
-            // Copy SafeVerObject to the recovery segment.
-            // Sync can be delayed, because recovery can be replayed
-            // with the same backup data when the recovery crashes on the way.
+        if (recoverTomb.getObjectVersion() >= minSuccessor) {
+            counters.tombstoneAppendCount++;
+            Log::Reference newTombReference;
             {
-                CycleCounter<uint64_t> _(&segmentAppendTicks);
-                sideLog->append(LOG_ENTRY_TYPE_SAFEVERSION, buffer);
+                CycleCounter<uint64_t> _(&counters.segmentAppendTicks);
+                sideLog->append(LOG_ENTRY_TYPE_OBJTOMB,
+                                buffer,
+                                &newTombReference);
+                counters.incrementTableStats(masterTableMetadata,
+                                             key.getTableId(),
+                                             buffer.getTotalLength());
             }
 
-            // recover segmentManager.safeVersion (Master safeVersion)
-            if (segmentManager.raiseSafeVersion(safeVersion)) {
-                // true if log.safeVersion is revised.
-                safeVersionRecoveryCount++;
-                LOG(DEBUG, "SAFEVERSION %lu recovered", safeVersion);
-            } else {
-                safeVersionNonRecoveryCount++;
-                LOG(DEBUG, "SAFEVERSION %lu discarded", safeVersion);
+            // TODO(steve/ryan): append could fail here!
+
+            replace(lock, key, newTombReference);
+
+            // nuke the object, if it existed
+            if (freeCurrentEntry) {
+                counters.liveObjectCount++;
+                counters.liveObjectBytes -= currentBuffer.getTotalLength();
+                sideLog->free(currentReference);
             }
+        } else {
+            counters.tombstoneDiscardCount++;
+        }
+    } else if (type == LOG_ENTRY_TYPE_SAFEVERSION) {
+        // LOG_ENTRY_TYPE_SAFEVERSION is duplicated to all the
+        // partitions in BackupService::buildRecoverySegments()
+        Buffer buffer;
+        buffer.append(entry, length);
+
+        ObjectSafeVersion recoverSafeVer(buffer);
+        uint64_t safeVersion = recoverSafeVer.getSafeVersion();
+
+        bool checksumIsValid = ({
+            CycleCounter<uint64_t> _(&counters.verifyChecksumTicks);
+            recoverSafeVer.checkIntegrity();
+        });
+        if (expect_false(!checksumIsValid)) {
+            LOG(WARNING, "bad objectSafeVer checksum! version: %lu",
+                safeVersion);
+            // TODO(Stutsman): Should throw and try another segment replica?
         }
 
-        it.next();
+        // Copy SafeVerObject to the recovery segment.
+        // Sync can be delayed, because recovery can be replayed
+        // with the same backup data when the recovery crashes on the way.
+        {
+            CycleCounter<uint64_t> _(&counters.segmentAppendTicks);
+            sideLog->append(LOG_ENTRY_TYPE_SAFEVERSION, buffer);
+        }
+
+        // recover segmentManager.safeVersion (Master safeVersion)
+        if (segmentManager.raiseSafeVersion(safeVersion)) {
+            // true if log.safeVersion is revised.
+            counters.safeVersionRecoveryCount++;
+            LOG(DEBUG, "SAFEVERSION %lu recovered", safeVersion);
+        } else {
+            counters.safeVersionNonRecoveryCount++;
+            LOG(DEBUG, "SAFEVERSION %lu discarded", safeVersion);
+        }
     }
+}
+
+/**
+ * Add the statistics accumulated in this object to the server's metrics and
+ * to the per-table stats, then reset it so that it may be used again.
+ *
+ * \param masterTableMetadata
+ *      The table stats container to update with any buffered increments.
+ */
+void
+ObjectManager::ReplayCounters::flush(MasterTableMetadata* masterTableMetadata)
+{
+    flushTableStats(masterTableMetadata);
 
-    metrics->master.backupInRecoverTicks +=
-        metrics->master.replicaManagerTicks - startReplicationTicks;
-    metrics->master.recoverSegmentPostingWriteRpcTicks +=
-        metrics->master.replicationPostingWriteRpcTicks -
-        startReplicationPostingWriteRpcTicks;
     metrics->master.verifyChecksumTicks += verifyChecksumTicks;
     metrics->master.segmentAppendTicks += segmentAppendTicks;
     metrics->master.recoverySegmentEntryCount += recoverySegmentEntryCount;
@@ -928,6 +1383,87 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
     metrics->master.tombstoneDiscardCount += tombstoneDiscardCount;
     metrics->master.safeVersionRecoveryCount += safeVersionRecoveryCount;
     metrics->master.safeVersionNonRecoveryCount += safeVersionNonRecoveryCount;
+
+    *this = ReplayCounters();
+}
+
+/**
+ * Record that a new entry of a given table was appended during replay. Table
+ * stats are protected by a per-table lock, so rather than taking it for every
+ * entry we accumulate increments for consecutive entries of the same table
+ * (recovery segments usually contain very few tables) and apply them at once.
+ *
+ * \param masterTableMetadata
+ *      The table stats container to update.
+ * \param tableId
+ *      Table the appended entry belongs to.
+ * \param byteCount
+ *      Length of the appended entry.
+ */
+void
+ObjectManager::ReplayCounters::incrementTableStats(
+                                    MasterTableMetadata* masterTableMetadata,
+                                    uint64_t tableId,
+                                    uint64_t byteCount)
+{
+    if (statsRecordCount != 0 && statsTableId != tableId)
+        flushTableStats(masterTableMetadata);
+
+    statsTableId = tableId;
+    statsByteCount += byteCount;
+    statsRecordCount++;
+}
+
+/**
+ * Apply any table stats increments buffered by incrementTableStats().
+ *
+ * \param masterTableMetadata
+ *      The table stats container to update.
+ */
+void
+ObjectManager::ReplayCounters::flushTableStats(
+                                    MasterTableMetadata* masterTableMetadata)
+{
+    if (statsRecordCount == 0)
+        return;
+
+    TableStats::increment(masterTableMetadata,
+                          statsTableId,
+                          statsByteCount,
+                          statsRecordCount);
+    statsByteCount = 0;
+    statsRecordCount = 0;
+}
+
+/**
+ * Record the log reference of an object if it belongs to the table and key
+ * hash range being collected. Used by appendObjectsForHashRange().
+ *
+ * \param reference
+ *      Reference into the log for an entry, on callback from
+ *      objectMap->forEachInBucket().
+ * \param cookie
+ *      Pointer to the HashRangeParameters describing what to collect.
+ */
+void
+ObjectManager::collectObjectInHashRange(uint64_t reference, void *cookie)
+{
+    HashRangeParameters* params =
+        reinterpret_cast<HashRangeParameters*>(cookie);
+    Buffer buffer;
+
+    LogEntryType type = params->objectManager->log.getEntry(
+        Log::Reference(reference), buffer);
+    if (type != LOG_ENTRY_TYPE_OBJ)
+        return;
+
+    Key key(type, buffer);
+    if (key.getTableId() != params->tableId ||
+        key.getHash() < params->firstKeyHash ||
+        key.getHash() > params->lastKeyHash) {
+        return;
+    }
+    params->references->push_back(Log::Reference(reference));
 }
 
 /**
@@ -980,6 +1516,96 @@ ObjectManager::removeOrphanedObjects()
     }
 }
 
+/**
+ * Return the number of hash table buckets that may hold objects whose key
+ * hashes fall within a given range. Buckets are indexed by the low-order bits
+ * of key hashes, so a range narrower than the number of buckets maps to that
+ * many consecutive buckets (modulo the table size); any wider range may touch
+ * every bucket. Used with appendObjectsForHashRange() to find the objects of
+ * a tablet without scanning the log.
+ *
+ * \param firstKeyHash
+ *      Lowest key hash in the range.
+ * \param lastKeyHash
+ *      Highest key hash in the range.
+ */
+uint64_t
+ObjectManager::getNumBucketsForHashRange(uint64_t firstKeyHash,
+                                         uint64_t lastKeyHash)
+{
+    uint64_t numBuckets = objectMap.getNumBuckets();
+    if (lastKeyHash - firstKeyHash >= numBuckets - 1)
+        return numBuckets;
+    return lastKeyHash - firstKeyHash + 1;
+}
+
+/**
+ * Append copies of all live objects in one hash table bucket that belong to
+ * a given table and key hash range to a segment. Either every such object in
+ * the bucket is appended or none of them are, so callers can start a new
+ * segment and retry if this one is full. The bucket is locked while its
+ * objects are copied, so concurrent writes to them either complete before
+ * the copy is made or are appended to the log afterwards.
+ *
+ * \param tableId
+ *      Table the objects must belong to.
+ * \param firstKeyHash
+ *      Lowest key hash of the objects to append.
+ * \param lastKeyHash
+ *      Highest key hash of the objects to append.
+ * \param bucketIndex
+ *      Which of the buckets covering the range to scan, from 0 up to (but not
+ *      including) getNumBucketsForHashRange().
+ * \param segment
+ *      Segment to append the objects to.
+ * \param[out] objectsAppended
+ *      Incremented by the number of objects appended.
+ * \param[out] bytesAppended
+ *      Incremented by the number of bytes of objects appended.
+ * \return
+ *      True if all matching objects in the bucket (if any) were appended,
+ *      false if \a segment did not have enough space for them.
+ */
+bool
+ObjectManager::appendObjectsForHashRange(uint64_t tableId,
+                                         uint64_t firstKeyHash,
+                                         uint64_t lastKeyHash,
+                                         uint64_t bucketIndex,
+                                         Segment* segment,
+                                         uint64_t* objectsAppended,
+                                         uint64_t* bytesAppended)
+{
+    uint64_t bucket = (firstKeyHash + bucketIndex) &
+                      (objectMap.getNumBuckets() - 1);
+    HashTableBucketLock lock(*this, bucket);
+
+    vector<Log::Reference> references;
+    HashRangeParameters params = { this, tableId, firstKeyHash, lastKeyHash,
+                                   &references };
+    objectMap.forEachInBucket(collectObjectInHashRange, &params, bucket);
+    if (references.empty())
+        return true;
+
+    vector<uint32_t> lengths;
+    foreach (Log::Reference reference, references) {
+        Buffer buffer;
+        log.getEntry(reference, buffer);
+        lengths.push_back(buffer.getTotalLength());
+    }
+    if (!segment->hasSpaceFor(&lengths[0], downCast<uint32_t>(lengths.size())))
+        return false;
+
+    foreach (Log::Reference reference, references) {
+        Buffer buffer;
+        log.getEntry(reference, buffer);
+        bool success = segment->append(LOG_ENTRY_TYPE_OBJ, buffer);
+        assert(success);
+        (*objectsAppended)++;
+        *bytesAppended += buffer.getTotalLength();
+    }
+    return true;
+}
+
 /**
  * Adds a log entry header, an object header and the object contents
  * to a buffer. This is preparatory work so that eventually, all the
@@ -1233,6 +1859,10 @@ ObjectManager::flushEntriesToLog(Buffer *logBuffer, uint32_t& numEntries)
 
             if (lookup(lock, key, currentType, currentBuffer, &currentVersion,
                        &currentReference, &currentHashTableEntry)) {
+                snapshotManager.preserve(key,
+                        currentType == LOG_ENTRY_TYPE_OBJ ?
+                        currentReference.toInteger() : 0);
+                hotKeyCache.noteWrite(key, object.getVersion());
 
                 if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
                     removeIfTombstone(currentReference.toInteger(), this);
@@ -1245,6 +1875,8 @@ ObjectManager::flushEntriesToLog(Buffer *logBuffer, uint32_t& numEntries)
                     log.free(currentReference);
                 }
             } else {
+                snapshotManager.preserve(key, 0);
+                hotKeyCache.noteWrite(key, object.getVersion());
                 objectMap.insert(key.getHash(), references[i].toInteger());
             }
         } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
@@ -1267,6 +1899,9 @@ ObjectManager::flushEntriesToLog(Buffer *logBuffer, uint32_t& numEntries)
                 // this is a tombstone for the most recent version of
                 // the object so far in the log
                 if (currentVersion == tombstone.getObjectVersion()) {
+                    snapshotManager.preserve(key,
+                            currentReference.toInteger());
+                    hotKeyCache.noteWrite(key, currentVersion + 1);
                     remove(lock, key);
                     log.free(currentReference);
                     segmentManager.raiseSafeVersion(currentVersion + 1);
@@ -1428,6 +2063,10 @@ ObjectManager::relocateObject(Buffer& oldBuffer,
         return;
     }
 
+    // An enumeration snapshot may still need this version.
+    if (snapshotManager.relocate(oldBuffer, oldReference, relocator))
+        return;
+
     // No reference was found meaning object will be cleaned.  We should update
     // the stats accordingly.
     TableStats::decrement(masterTableMetadata,
@@ -1555,6 +2194,7 @@ ObjectManager::lookup(HashTableBucketLock& lock,
                       Log::Reference* outReference,
                       HashTable::Candidates* outCandidates)
 {
+    RpcStageTimer _(RpcStageTimer::LOOKUP);
     HashTable::Candidates candidates;
     objectMap.lookup(key.getHash(), candidates);
     while (!candidates.isDone()) {
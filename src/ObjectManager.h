@@ -21,12 +21,15 @@
 #include "SideLog.h"
 #include "LogEntryHandlers.h"
 #include "HashTable.h"
+#include "HotKeyCache.h"
 #include "IndexKey.h"
 #include "Object.h"
 #include "SegmentManager.h"
 #include "SegmentIterator.h"
 #include "ReplicaManager.h"
+#include "RmwOperation.h"
 #include "ServerConfig.h"
+#include "SnapshotManager.h"
 #include "SpinLock.h"
 #include "TabletManager.h"
 #include "MasterTableMetadata.h"
@@ -48,6 +51,36 @@ namespace RAMCloud {
  */
 class ObjectManager : public LogEntryHandlers {
   public:
+    /**
+     * One object to be written by writeObjects(), along with the results
+     * of writing it. The fields correspond to the arguments of writeObject.
+     */
+    struct BatchedWrite {
+        BatchedWrite()
+            : object(NULL)
+            , rejectRules(NULL)
+            , removedObjBuffer(NULL)
+            , status(STATUS_OK)
+            , version(VERSION_NONEXISTENT)
+        {}
+
+        /// The object to write. Its version and timestamp are filled in.
+        Object* object;
+
+        /// If non-NULL, rules that may prevent the write.
+        RejectRules* rejectRules;
+
+        /// If non-NULL, the object being overwritten (if any) is appended
+        /// here, but only if the write succeeds.
+        Buffer* removedObjBuffer;
+
+        /// Result of the write, as writeObject would return it.
+        Status status;
+
+        /// Version of the new object; if the reject rules failed the write,
+        /// the current object's version.
+        uint64_t version;
+    };
 
     ObjectManager(Context* context,
                   ServerId* serverId,
@@ -71,6 +104,13 @@ class ObjectManager : public LogEntryHandlers {
                        RejectRules* rejectRules,
                        uint64_t* outVersion,
                        Buffer* removedObjBuffer = NULL);
+    void writeObjects(BatchedWrite* writes, uint32_t numWrites);
+    Status readModifyWriteObject(Key& key,
+                                 RmwOperation& operation,
+                                 RejectRules* rejectRules,
+                                 uint64_t* outVersion,
+                                 Buffer* outValue,
+                                 uint32_t maxValueLength = ~0U);
     Status removeObject(Key& key,
                         RejectRules* rejectRules,
                         uint64_t* outVersion,
@@ -79,6 +119,15 @@ class ObjectManager : public LogEntryHandlers {
     void prefetchHashTableBucket(SegmentIterator* it);
     void replaySegment(SideLog* sideLog, SegmentIterator& it);
     void removeOrphanedObjects();
+    uint64_t getNumBucketsForHashRange(uint64_t firstKeyHash,
+                                       uint64_t lastKeyHash);
+    bool appendObjectsForHashRange(uint64_t tableId,
+                                   uint64_t firstKeyHash,
+                                   uint64_t lastKeyHash,
+                                   uint64_t bucketIndex,
+                                   Segment* segment,
+                                   uint64_t* objectsAppended,
+                                   uint64_t* bytesAppended);
 
     /// The following three methods are used when multiple log entries
     /// need to be committed to the log atomically
@@ -124,6 +173,8 @@ class ObjectManager : public LogEntryHandlers {
     Log* getLog() { return &log; }
     ReplicaManager* getReplicaManager() { return &replicaManager; }
     HashTable* getObjectMap() { return &objectMap; }
+    SnapshotManager* getSnapshotManager() { return &snapshotManager; }
+    HotKeyCache* getHotKeyCache() { return &hotKeyCache; }
 
   PRIVATE:
     /**
@@ -243,6 +294,64 @@ class ObjectManager : public LogEntryHandlers {
         DISALLOW_COPY_AND_ASSIGN(RemoveTombstonePoller);
     };
 
+    /**
+     * Statistics gathered while replaying recovery segment entries (see
+     * replayEntry()). Updating RawMetrics is expensive (they are atomic
+     * operations), so replay accumulates as much as it can in an instance of
+     * this struct and adds it to the server's metrics once per segment.
+     */
+    struct ReplayCounters {
+        ReplayCounters()
+            : verifyChecksumTicks(0)
+            , segmentAppendTicks(0)
+            , recoverySegmentEntryCount(0)
+            , recoverySegmentEntryBytes(0)
+            , objectAppendCount(0)
+            , tombstoneAppendCount(0)
+            , liveObjectCount(0)
+            , liveObjectBytes(0)
+            , objectDiscardCount(0)
+            , tombstoneDiscardCount(0)
+            , safeVersionRecoveryCount(0)
+            , safeVersionNonRecoveryCount(0)
+            , statsTableId(0)
+            , statsByteCount(0)
+            , statsRecordCount(0)
+        {
+        }
+
+        void flush(MasterTableMetadata* masterTableMetadata);
+        void incrementTableStats(MasterTableMetadata* masterTableMetadata,
+                                 uint64_t tableId,
+                                 uint64_t byteCount);
+        void flushTableStats(MasterTableMetadata* masterTableMetadata);
+
+        uint64_t verifyChecksumTicks;
+        uint64_t segmentAppendTicks;
+        uint64_t recoverySegmentEntryCount;
+        uint64_t recoverySegmentEntryBytes;
+        uint64_t objectAppendCount;
+        uint64_t tombstoneAppendCount;
+        uint64_t liveObjectCount;
+        uint64_t liveObjectBytes;
+        uint64_t objectDiscardCount;
+        uint64_t tombstoneDiscardCount;
+        uint64_t safeVersionRecoveryCount;
+        uint64_t safeVersionNonRecoveryCount;
+
+        /// Table whose stats increments are currently being buffered by
+        /// incrementTableStats(). Only valid if statsRecordCount != 0.
+        uint64_t statsTableId;
+
+        /// Bytes appended to #statsTableId that have not yet been added to
+        /// the table's stats.
+        uint64_t statsByteCount;
+
+        /// Entries appended to #statsTableId that have not yet been added to
+        /// the table's stats.
+        uint64_t statsRecordCount;
+    };
+
     /**
      * Struct used to pass parameters into the removeIfOrphanedObject and
      * removeIfTombstone methods through the generic HashTable::forEachInBucket
@@ -257,6 +366,26 @@ class ObjectManager : public LogEntryHandlers {
         ObjectManager::HashTableBucketLock* lock;
     };
 
+    /**
+     * Struct used to pass parameters into the collectObjectInHashRange
+     * method through the generic HashTable::forEachInBucket method.
+     */
+    struct HashRangeParameters {
+        /// Pointer to the ObjectManager class owning the hash table.
+        ObjectManager* objectManager;
+
+        /// Only objects in this table are collected.
+        uint64_t tableId;
+
+        /// Only objects whose key hashes fall within
+        /// [firstKeyHash, lastKeyHash] are collected.
+        uint64_t firstKeyHash;
+        uint64_t lastKeyHash;
+
+        /// Log references of the matching objects are pushed here.
+        vector<Log::Reference>* references;
+    };
+
     bool lookup(HashTableBucketLock& lock,
                 Key& key,
                 LogEntryType& outType,
@@ -266,6 +395,12 @@ class ObjectManager : public LogEntryHandlers {
                 HashTable::Candidates* outCandidates = NULL);
     bool remove(HashTableBucketLock& lock, Key& key);
     bool replace(HashTableBucketLock& lock, Key& key, Log::Reference reference);
+    void replayEntry(SideLog* sideLog,
+                     LogEntryType type,
+                     const void* entry,
+                     uint32_t length,
+                     ReplayCounters& counters);
+    static void collectObjectInHashRange(uint64_t reference, void *cookie);
     static void removeIfOrphanedObject(uint64_t reference, void *cookie);
     static void removeIfTombstone(uint64_t maybeTomb, void *cookie);
     static string dumpSegment(Segment* segment);
@@ -330,7 +465,34 @@ class ObjectManager : public LogEntryHandlers {
      */
     HashTable objectMap;
 
+    /**
+     * Point-in-time views of tablets used by snapshot enumerations. Must be
+     * told about every object update before the hash table changes.
+     */
+    SnapshotManager snapshotManager;
+
+    /**
+     * Copies of hot objects held by other masters, and copies of other
+     * masters' objects held here. Must be told about every object update
+     * before the bucket lock is released.
+     */
+    HotKeyCache hotKeyCache;
+
   PRIVATE:
+    /**
+     * writeObjects() appends at most about this many bytes in each call to
+     * Log::append. Each call's entries must fit in one segment, and a batch
+     * that doesn't fit in the current head closes it early, wasting the
+     * rest of its space.
+     */
+    static const uint32_t MAX_WRITE_BATCH_BYTES = 64 * 1024;
+
+    /**
+     * writeObjects() writes at most this many objects in each batch. A
+     * batch holds the bucket locks of all of its objects until it is in
+     * the log, so large batches would block reads of much of the table.
+     */
+    static const uint32_t MAX_WRITE_BATCH_OBJECTS = 64;
 
     /**
      * Used to identify the first write request, so that we can initialize
@@ -369,6 +531,7 @@ class ObjectManager : public LogEntryHandlers {
     friend void removeObjectIfFromUnknownTablet(uint64_t reference,
                                                 void *cookie);
 
+    void initOnFirstWrite();
     uint32_t getObjectTimestamp(Buffer& buffer);
     uint32_t getTombstoneTimestamp(Buffer& buffer);
     Status rejectOperation(const RejectRules* rejectRules, uint64_t version)
@@ -379,9 +542,17 @@ class ObjectManager : public LogEntryHandlers {
     void relocateTombstone(Buffer& oldBuffer,
                            LogEntryRelocator& relocator);
     void removeTombstones();
+    Status writeObject(HashTableBucketLock& lock,
+                       Key& key,
+                       Object& newObject,
+                       RejectRules* rejectRules,
+                       uint64_t* outVersion,
+                       Buffer* removedObjBuffer = NULL);
+    void writeBatch(BatchedWrite* writes, uint32_t numWrites);
 
     friend class CleanerCompactionBenchmark;
     friend class ObjectManagerBenchmark;
+    friend class ParallelSegmentReplayer;
 
     DISALLOW_COPY_AND_ASSIGN(ObjectManager);
 };
@@ -1,4 +1,4 @@
-/* Copyright (c) 2010-2013 Stanford University
+/* Copyright (c) 2010-2014 Stanford University
  *
  * Permission to use, copy, modify, and distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -147,6 +147,57 @@ class ObjectManagerBenchmark {
                                    Cycles::toSeconds(stop - start));
     }
 
+    /**
+     * Write objects of a given size, read them back, and report how much
+     * of each read would have to be copied by a transport that transmits
+     * log memory in place (as InfRcTransport does): every byte of the
+     * reply Buffer that is not in a chunk pointing into the log.
+     */
+    void
+    measureCopying(uint32_t dataBytes, uint32_t numObjects, uint32_t numReads)
+    {
+        tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+
+        vector<char> objectData(dataBytes);
+        for (uint64_t keyVal = 0; keyVal < numObjects; keyVal++) {
+            Key key(0, &keyVal, sizeof(keyVal));
+            Buffer dataBuffer;
+            Object object(key, &objectData[0], dataBytes, 0, 0, dataBuffer);
+            Status status = objectManager->writeObject(object, NULL, NULL);
+            if (status != STATUS_OK) {
+                fprintf(stderr, "Failed to write object! Out of memory?\n");
+                exit(1);
+            }
+        }
+
+        const char* logBase = static_cast<const char*>(
+                objectManager->allocator.getBaseAddress());
+        const char* logEnd = logBase + objectManager->allocator.getTotalBytes();
+        uint64_t chunks = 0;
+        uint64_t copiedBytes = 0;
+        uint64_t start = Cycles::rdtsc();
+        for (uint32_t i = 0; i < numReads; i++) {
+            uint64_t keyVal = i % numObjects;
+            Key key(0, &keyVal, sizeof(keyVal));
+            Buffer buffer;
+            objectManager->readObject(key, &buffer, NULL, NULL);
+            for (Buffer::Iterator it(buffer); !it.isDone(); it.next()) {
+                const char* data = static_cast<const char*>(it.getData());
+                chunks++;
+                if (data < logBase || data + it.getLength() > logEnd)
+                    copiedBytes += it.getLength();
+            }
+        }
+        uint64_t stop = Cycles::rdtsc();
+
+        printf(" %7u-byte objects: %5.2f chunks/read, %7.1f bytes "
+               "copied/read, %.3f us/read\n",
+               dataBytes,
+               static_cast<double>(chunks) / numReads,
+               static_cast<double>(copiedBytes) / numReads,
+               Cycles::toSeconds(stop - start) * 1e6 / numReads);
+    }
+
     DISALLOW_COPY_AND_ASSIGN(ObjectManagerBenchmark);
 };
 
@@ -174,5 +225,14 @@ main()
             (readsPerSec / oneThreadRate) / threads[i] * 100);
     }
 
+    // Objects larger than a seglet (64 KB) come back in one chunk per
+    // seglet they span; none of it should need copying.
+    printf("============ Bytes Copied per Read ==============\n");
+    uint32_t sizes[] = { 100, 1000, 10000, 100000, 1000000, 0 };
+    for (int i = 0; sizes[i] != 0; i++) {
+        RAMCloud::ObjectManagerBenchmark omb("2048", "10%");
+        omb.measureCopying(sizes[i], 100, 100000);
+    }
+
     return 0;
 }
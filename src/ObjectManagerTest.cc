@@ -316,6 +316,12 @@ writeObjectFilter(string s)
     return s == "writeObject";
 }
 
+static bool
+writeBatchFilter(string s)
+{
+    return s == "writeBatch";
+}
+
 static bool
 antiGetEntryFilter(string s)
 {
@@ -395,6 +401,137 @@ TEST_F(ObjectManagerTest, writeObject_returnRemovedObj) {
                                       oldValueLength));
 }
 
+TEST_F(ObjectManagerTest, writeObjects) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Buffer buffer0, buffer1, buffer2, buffer3, buffer4;
+    Object obj0(key1, "value", 5, 0, 0, buffer0);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj0, 0, 0));
+
+    Object obj1(key1, "value", 5, 0, 0, buffer1);
+    Key key2(1, "2", 1);
+    Object obj2(key2, "value", 5, 0, 0, buffer2);
+    Key key3(2, "3", 1);
+    Object obj3(key3, "value", 5, 0, 0, buffer3);
+    Key key4(1, "4", 1);
+    Object obj4(key4, "value", 5, 0, 0, buffer4);
+    RejectRules rejectRules;
+    memset(&rejectRules, 0, sizeof(rejectRules));
+    rejectRules.doesntExist = 1;
+
+    ObjectManager::BatchedWrite writes[4];
+    Buffer removedObjBuffer;
+    writes[0].object = &obj1;
+    writes[0].removedObjBuffer = &removedObjBuffer;
+    writes[1].object = &obj2;
+    writes[2].object = &obj3;
+    writes[3].object = &obj4;
+    writes[3].rejectRules = &rejectRules;
+
+    TestLog::Enable _(writeBatchFilter);
+    objectManager.writeObjects(writes, 4);
+    EXPECT_EQ("writeBatch: object: 33 bytes, version 2 | "
+              "writeBatch: tombstone: 33 bytes, version 1 | "
+              "writeBatch: object: 33 bytes, version 3", TestLog::get());
+
+    // Overwrite, with the old object returned.
+    EXPECT_EQ(STATUS_OK, writes[0].status);
+    EXPECT_EQ(2U, writes[0].version);
+    Object oldObj(removedObjBuffer);
+    EXPECT_EQ(1U, oldObj.getVersion());
+
+    // New object.
+    EXPECT_EQ(STATUS_OK, writes[1].status);
+    EXPECT_EQ(3U, writes[1].version);
+
+    // No tablet.
+    EXPECT_EQ(STATUS_UNKNOWN_TABLET, writes[2].status);
+
+    // Rejected.
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, writes[3].status);
+    EXPECT_EQ(VERSION_NONEXISTENT, writes[3].version);
+
+    EXPECT_EQ("found=true tableId=1 byteCount=132 recordCount=4"
+              , verifyMetadata(1));
+    Buffer value;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key2, &value, 0, 0));
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+              objectManager.readObject(key4, &value, 0, 0));
+}
+
+TEST_F(ObjectManagerTest, writeObjects_duplicateKey) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key(1, "1", 1);
+    Buffer buffer1, buffer2;
+    Object obj1(key, "value", 5, 0, 0, buffer1);
+    Object obj2(key, "value", 5, 0, 0, buffer2);
+    ObjectManager::BatchedWrite writes[2];
+    writes[0].object = &obj1;
+    writes[1].object = &obj2;
+
+    // The second write must see the first, so it goes in its own batch.
+    TestLog::Enable _(writeBatchFilter);
+    objectManager.writeObjects(writes, 2);
+    EXPECT_EQ("writeBatch: object: 33 bytes, version 1 | "
+              "writeBatch: object: 33 bytes, version 2 | "
+              "writeBatch: tombstone: 33 bytes, version 1", TestLog::get());
+    EXPECT_EQ(STATUS_OK, writes[1].status);
+    EXPECT_EQ(2U, writes[1].version);
+}
+
+TEST_F(ObjectManagerTest, writeObjects_fullCacheLine) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+
+    // Find enough keys that fall in one bucket to fill its cache line and
+    // overflow it.
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+    uint64_t unused;
+    vector<string> keys;
+    uint64_t bucket = ~0UL;
+    for (int i = 0; keys.size() < HashTable::entriesPerCacheLine() + 1; i++) {
+        string keyString = format("%d", i);
+        Key key(1, keyString.c_str(), downCast<uint16_t>(keyString.size()));
+        uint64_t b = HashTable::findBucketIndex(numBuckets, key.getHash(),
+                                                &unused);
+        if (keys.empty())
+            bucket = b;
+        if (b == bucket)
+            keys.push_back(keyString);
+    }
+
+    // Fill the cache line.
+    for (uint32_t i = 0; i < keys.size() - 1; i++) {
+        Key key(1, keys[i].c_str(), downCast<uint16_t>(keys[i].size()));
+        Buffer buffer;
+        Object object(key, "old", 3, 0, 0, buffer);
+        EXPECT_EQ(STATUS_OK, objectManager.writeObject(object, 0, 0));
+    }
+
+    // Insert a new key, which moves the last entry to a chained cache
+    // line, and overwrite the key in that last entry in the same batch.
+    Key newKey(1, keys.back().c_str(), downCast<uint16_t>(keys.back().size()));
+    uint32_t last = downCast<uint32_t>(keys.size() - 2);
+    Key oldKey(1, keys[last].c_str(), downCast<uint16_t>(keys[last].size()));
+    Buffer buffer1, buffer2;
+    Object obj1(newKey, "new", 3, 0, 0, buffer1);
+    Object obj2(oldKey, "new", 3, 0, 0, buffer2);
+    ObjectManager::BatchedWrite writes[2];
+    writes[0].object = &obj1;
+    writes[1].object = &obj2;
+    objectManager.writeObjects(writes, 2);
+    EXPECT_EQ(STATUS_OK, writes[0].status);
+    EXPECT_EQ(STATUS_OK, writes[1].status);
+
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        Key key(1, keys[i].c_str(), downCast<uint16_t>(keys[i].size()));
+        Buffer value;
+        EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &value, 0, 0,
+                                                      true));
+        EXPECT_EQ((i >= last) ? "new" : "old", string(
+                reinterpret_cast<const char*>(value.getRange(0, 3)), 3));
+    }
+}
+
 TEST_F(ObjectManagerTest, readObject) {
     Buffer buffer;
     Key key(1, "1", 1);
@@ -508,6 +645,65 @@ TEST_F(ObjectManagerTest, removeObject) {
     EXPECT_FALSE(objectManager.lookup(lock, key, type, buffer, 0, 0));
 }
 
+TEST_F(ObjectManagerTest, getNumBucketsForHashRange) {
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+    EXPECT_EQ(numBuckets,
+              objectManager.getNumBucketsForHashRange(0, ~0UL));
+    EXPECT_EQ(10UL, objectManager.getNumBucketsForHashRange(10, 19));
+    EXPECT_EQ(numBuckets - 1,
+              objectManager.getNumBucketsForHashRange(0, numBuckets - 2));
+    EXPECT_EQ(numBuckets,
+              objectManager.getNumBucketsForHashRange(5, numBuckets + 4));
+    EXPECT_EQ(numBuckets,
+              objectManager.getNumBucketsForHashRange(5, numBuckets * 3));
+}
+
+TEST_F(ObjectManagerTest, appendObjectsForHashRange) {
+    tabletManager.addTablet(97, 0, ~0UL, TabletManager::NORMAL);
+    tabletManager.addTablet(98, 0, ~0UL, TabletManager::NORMAL);
+    Key key(97, "1", 1);
+    Key otherTableKey(98, "1", 1);
+    Buffer value;
+    Object obj(key, "hi", 2, 0, 0, value);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, NULL, NULL));
+    Object otherTableObj(otherTableKey, "hi", 2, 0, 0, value);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(otherTableObj, NULL, NULL));
+
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+    uint64_t bucketIndex = key.getHash() & (numBuckets - 1);
+    Segment segment;
+    uint64_t objects = 0;
+    uint64_t bytes = 0;
+
+    // Outside of the range.
+    EXPECT_TRUE(objectManager.appendObjectsForHashRange(97,
+        key.getHash() + 1, ~0UL, numBuckets - 1, &segment, &objects, &bytes));
+    EXPECT_EQ(0UL, objects);
+
+    EXPECT_TRUE(objectManager.appendObjectsForHashRange(97, 0, ~0UL,
+        bucketIndex, &segment, &objects, &bytes));
+    EXPECT_EQ(1UL, objects);
+    EXPECT_LT(0UL, bytes);
+
+    SegmentIterator it(segment);
+    EXPECT_FALSE(it.isDone());
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, it.getType());
+    Buffer buffer;
+    it.appendToBuffer(buffer);
+    Object object(buffer);
+    EXPECT_EQ(97UL, object.getTableId());
+    it.next();
+    EXPECT_TRUE(it.isDone());
+
+    // Doesn't fit: nothing is appended.
+    uint32_t appendedLength = segment.getAppendedLength();
+    segment.close();
+    EXPECT_FALSE(objectManager.appendObjectsForHashRange(97, 0, ~0UL,
+        bucketIndex, &segment, &objects, &bytes));
+    EXPECT_EQ(1UL, objects);
+    EXPECT_EQ(appendedLength, segment.getAppendedLength());
+}
+
 TEST_F(ObjectManagerTest, removeOrphanedObjects) {
     tabletManager.addTablet(97, 0, ~0UL, TabletManager::NORMAL);
     Key key(97, "1", 1);
@@ -17,23 +17,18 @@
 #define RAMCLOUD_OBJECTPOOL_H
 
 #include "Common.h"
-#include "Memory.h"
+#include "SlabAllocator.h"
 
 /*
  * Notes on performance and efficiency:
  *
- * This class is currently extremely simple and has some notable
- * inefficiencies. It does not allocate in blocks of objects, so
- * each allocation that cannot be satisfied by the space of a
- * previously destroyed object results in a malloc. Furthermore,
- * the individual mallocs can cause poor cache locality when small
- * objects are used.
- *
- * Compared to the former boost-based ObjectPool, for very small
- * objects a fast allocation is about 70% slower (6.2ns vs 3.6ns;
- * due to cache effects) for 4-byte objects. For 64-byte objects
- * they're about the same. Slow allocation (no pool memory left)
- * is considerably slower.
+ * ObjectPool used to keep its own free list of objects, each malloced
+ * individually. It now allocates from the SlabAllocator, so objects are
+ * carved from shared slabs (better cache locality, and no mallocs once the
+ * allocator's magazines are warm), freed memory can be reused by other
+ * pools of similarly sized objects, and an object may be destroyed by a
+ * different thread than the one that constructed it without any locking
+ * in this class.
  */
 
 namespace RAMCloud {
@@ -46,9 +41,9 @@ struct ObjectPoolException : public Exception {
 /**
  * ObjectPool is a simple templated allocator that provides fast
  * allocation in cases where objects are frequently constructed and
- * then deleted. It initially allocates memory from malloc, but when
- * the pool is given an object to destroy it caches the backing
- * memory for more efficient future allocations.
+ * then deleted. The backing memory comes from the SlabAllocator, whose
+ * per-thread magazines make constructing and destroying an object about
+ * as cheap as pushing and popping a stack.
  *
  * Use ObjectPool in cases where you want to be able to repeatedly
  * new and delete an relatively fixed set of objects very quickly.
@@ -60,14 +55,11 @@ class ObjectPool
 {
   public:
     /**
-     * Construct a new ObjectPool. The pool begins life with no allocated
-     * memory. Objects are first allocated individually via malloc. Destroyed
-     * objects have their backing memory stashed away to speed up future
-     * allocations. For simplicity, no bulk allocations are performed.
+     * Construct a new ObjectPool. The pool itself holds no memory; see
+     * SlabAllocator.
      */
     ObjectPool()
-        : outstandingObjects(0),
-          pool()
+        : outstandingObjects(0)
     {
     }
 
@@ -78,22 +70,15 @@ class ObjectPool
      */
     ~ObjectPool()
     {
-        foreach(void* p, pool) {
-            free(p);
-        }
-
-        // Catching this isn't intended, but could be done if the caller really
-        // wants to, so make sure we free the pooled memory first.
         if (outstandingObjects > 0) {
             RAMCLOUD_LOG(ERROR, "Pool destroyed before objects!");
         }
     }
 
     /**
-     * Construct a new object of templated type T. This method allocates memory
-     * from the pool if possible. If the pool is empty, it mallocs more space.
-     * If malloc fails, the process is terminated.
-     * 
+     * Construct a new object of templated type T. If memory can't be
+     * allocated, the process is terminated.
+     *
      * \param args
      *      Arguments to provide to T's constructor.
      * \throw
@@ -103,19 +88,13 @@ class ObjectPool
     T*
     construct(Args&&... args)
     {
-        void* backing = NULL;
-        if (pool.size() == 0) {
-            backing = Memory::xmalloc(HERE, sizeof(T));
-        } else {
-            backing = pool.back();
-            pool.pop_back();
-        }
+        void* backing = SlabAllocator::alloc(sizeof(T));
 
         T* object = NULL;
         try {
             object = new(backing) T(static_cast<Args&&>(args)...);
         } catch (...) {
-            pool.push_back(backing);
+            SlabAllocator::free(backing, sizeof(T));
             throw;
         }
 
@@ -131,7 +110,7 @@ class ObjectPool
     {
         assert(outstandingObjects > 0);
         object->~T();
-        pool.push_back(static_cast<void*>(object));
+        SlabAllocator::free(static_cast<void*>(object), sizeof(T));
         outstandingObjects--;
     }
 
@@ -139,9 +118,6 @@ class ObjectPool
     /// Count of the number of objects for which construct() was called, but
     /// destroy() was not.
     uint64_t outstandingObjects;
-
-    /// Pool of backing memory from previously destroyed objects.
-    vector<void*> pool;
 };
 
 } // end RAMCloud
@@ -90,7 +90,7 @@ TEST(ObjectPoolTest, destructor_objectsStillAllocated) {
 TEST(ObjectPoolTest, construct) {
     ObjectPool<TestObject> pool;
     EXPECT_THROW(pool.construct(true), Exception);
-    EXPECT_EQ(1U, pool.pool.size());
+    EXPECT_EQ(0U, pool.outstandingObjects);
     TestObject*a = pool.construct();
     EXPECT_NE(static_cast<TestObject*>(NULL), a);
     EXPECT_EQ(1U, pool.outstandingObjects);
@@ -103,7 +103,15 @@ TEST(ObjectPoolTests, destroy) {
     pool.destroy(pool.construct(&destroyed));
     EXPECT_TRUE(destroyed);
     EXPECT_EQ(0U, pool.outstandingObjects);
-    EXPECT_EQ(1U, pool.pool.size());
+}
+
+TEST(ObjectPoolTests, destroy_memoryReused) {
+    ObjectPool<TestObject> pool;
+    TestObject* a = pool.construct();
+    pool.destroy(a);
+    TestObject* b = pool.construct();
+    EXPECT_EQ(a, b);
+    pool.destroy(b);
 }
 
 TEST(ObjectPoolTests, destroy_inOrder) {
@@ -0,0 +1,281 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "CycleCounter.h"
+#include "Object.h"
+#include "ParallelSegmentReplayer.h"
+#include "RawMetrics.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ParallelSegmentReplayer and start its replay threads.
+ *
+ * \param objectManager
+ *      The ObjectManager that recovered objects and tombstones will be added
+ *      to.
+ * \param numThreads
+ *      Number of threads to replay recovery segments with. Each thread gets
+ *      its own SideLog. Must be at least 1.
+ */
+ParallelSegmentReplayer::ParallelSegmentReplayer(ObjectManager* objectManager,
+                                                 uint32_t numThreads)
+    : objectManager(objectManager)
+    , numThreads(numThreads)
+    , shards()
+    , mutex()
+    , workAvailable()
+    , generation(0)
+    , shardsRemaining(0)
+    , threadsShouldExit(false)
+{
+    assert(numThreads > 0);
+    for (uint32_t i = 0; i < numThreads; i++)
+        shards.push_back(new Shard(objectManager->getLog(), i));
+    foreach (Shard* shard, shards)
+        shard->thread = new std::thread(replayThreadEntry, this, shard);
+}
+
+/**
+ * Stop the replay threads and destroy the per-thread SideLogs. Any replayed
+ * entries that were not committed with commit() are aborted.
+ */
+ParallelSegmentReplayer::~ParallelSegmentReplayer()
+{
+    {
+        Lock _(mutex);
+        threadsShouldExit = true;
+    }
+    workAvailable.notify_all();
+
+    foreach (Shard* shard, shards) {
+        shard->thread->join();
+        delete shard->thread;
+        delete shard;
+    }
+}
+
+/**
+ * Replay the entries within a recovery segment using all of the replay
+ * threads, and return once every entry has been replayed. This has the same
+ * effect as ObjectManager::replaySegment(), except that the entries are
+ * appended to the per-thread SideLogs. While the threads are working the
+ * calling thread drives replication of the SideLogs' segments.
+ *
+ * \param it
+ *      SegmentIterator which is pointing to the start of the recovery segment
+ *      to be replayed. The segment must be contiguous in memory and must
+ *      remain valid until this method returns.
+ * \throw Exception
+ *      Any exception thrown while replaying an entry on one of the replay
+ *      threads is rethrown here.
+ */
+void
+ParallelSegmentReplayer::replaySegment(SegmentIterator& it)
+{
+    uint64_t startReplicationTicks = metrics->master.replicaManagerTicks;
+    uint64_t startReplicationPostingWriteRpcTicks =
+        metrics->master.replicationPostingWriteRpcTicks;
+    CycleCounter<RawMetric> _(&metrics->master.recoverSegmentTicks);
+
+    partition(it);
+
+    {
+        Lock _(mutex);
+        shardsRemaining = numThreads;
+        generation++;
+    }
+    workAvailable.notify_all();
+
+    ReplicaManager* replicaManager = objectManager->getReplicaManager();
+    while (shardsRemaining > 0)
+        replicaManager->proceed();
+
+    // See RemoveTombstonePoller for how this count is used.
+    objectManager->replaySegmentReturnCount++;
+
+    metrics->master.backupInRecoverTicks +=
+        metrics->master.replicaManagerTicks - startReplicationTicks;
+    metrics->master.recoverSegmentPostingWriteRpcTicks +=
+        metrics->master.replicationPostingWriteRpcTicks -
+        startReplicationPostingWriteRpcTicks;
+
+    foreach (Shard* shard, shards) {
+        if (shard->error) {
+            std::exception_ptr error = shard->error;
+            foreach (Shard* s, shards)
+                s->error = std::exception_ptr();
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * Commit the entries appended to all of the replay threads' SideLogs to the
+ * log at once. When this method returns, all replayed data is durable on
+ * backups. See SideLog::commitAll().
+ */
+void
+ParallelSegmentReplayer::commit()
+{
+    vector<SideLog*> sideLogs;
+    foreach (Shard* shard, shards)
+        sideLogs.push_back(&shard->sideLog);
+    SideLog::commitAll(sideLogs);
+}
+
+/******************************************************************************
+ * PRIVATE METHODS
+ ******************************************************************************/
+
+/**
+ * Main loop of each replay thread. Waits for replaySegment() to hand out a
+ * new recovery segment, replays this thread's share of it, and repeats until
+ * the ParallelSegmentReplayer is destroyed.
+ *
+ * \param replayer
+ *      The ParallelSegmentReplayer this thread belongs to.
+ * \param shard
+ *      The shard this thread replays entries for.
+ */
+void
+ParallelSegmentReplayer::replayThreadEntry(ParallelSegmentReplayer* replayer,
+                                           Shard* shard)
+{
+    uint64_t lastGeneration = 0;
+    while (1) {
+        {
+            Lock lock(replayer->mutex);
+            while (!replayer->threadsShouldExit &&
+                   replayer->generation == lastGeneration) {
+                replayer->workAvailable.wait(lock);
+            }
+            if (replayer->threadsShouldExit)
+                return;
+            lastGeneration = replayer->generation;
+        }
+
+        try {
+            replayer->replayShard(shard);
+        } catch (...) {
+            shard->entries.clear();
+            shard->error = std::current_exception();
+        }
+        replayer->shardsRemaining--;
+    }
+}
+
+/**
+ * Determine which shard (and therefore which replay thread) is responsible for
+ * entries with a given key hash. Shards are assigned contiguous ranges of
+ * ObjectManager's hash table bucket locks, so that no two shards ever use the
+ * same lock.
+ *
+ * \param keyHash
+ *      Hash of the key of the entry to be replayed.
+ * \return
+ *      Index into #shards of the shard responsible for the key.
+ */
+uint32_t
+ParallelSegmentReplayer::getShardIndex(KeyHash keyHash)
+{
+    uint64_t numLocks = arrayLength(objectManager->hashTableBucketLocks);
+    uint64_t unused;
+    uint64_t bucket = HashTable::findBucketIndex(
+                            objectManager->objectMap.getNumBuckets(),
+                            keyHash, &unused);
+    uint64_t lockIndex = bucket & (numLocks - 1);
+    return downCast<uint32_t>(lockIndex * numThreads / numLocks);
+}
+
+/**
+ * Walk a recovery segment once and divide its entries among the shards.
+ * Objects and tombstones are assigned according to their key's hash (see
+ * getShardIndex()). Safe version entries are always replayed by the first
+ * shard. Entries of any other type are ignored, just as in
+ * ObjectManager::replaySegment().
+ *
+ * \param it
+ *      SegmentIterator pointing to the start of the recovery segment.
+ */
+void
+ParallelSegmentReplayer::partition(SegmentIterator& it)
+{
+    while (expect_true(!it.isDone())) {
+        LogEntryType type = it.getType();
+        uint32_t length = it.getLength();
+
+        // The recovery segment is guaranteed to be contiguous, so we need
+        // not provide a copyout buffer.
+        const void* data = it.getContiguous<void>(NULL, 0);
+
+        Entry entry = { data, 0, length, type };
+        uint32_t shardIndex = 0;
+        if (expect_true(type == LOG_ENTRY_TYPE_OBJ)) {
+            const Object::Header* header =
+                static_cast<const Object::Header*>(data);
+            Object object(header, length);
+            KeyLength keyLength = 0;
+            const void* key = object.getKey(0, &keyLength);
+            entry.keyHash = Key::getHash(header->tableId, key, keyLength);
+            shardIndex = getShardIndex(entry.keyHash);
+        } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+            const ObjectTombstone::Header* header =
+                static_cast<const ObjectTombstone::Header*>(data);
+            entry.keyHash = Key::getHash(header->tableId, header->key,
+                downCast<uint16_t>(length - sizeof32(*header)));
+            shardIndex = getShardIndex(entry.keyHash);
+        } else if (type != LOG_ENTRY_TYPE_SAFEVERSION) {
+            it.next();
+            continue;
+        }
+
+        shards[shardIndex]->entries.push_back(entry);
+        it.next();
+    }
+}
+
+/**
+ * Replay all of the entries assigned to a shard by partition(). Invoked on
+ * the shard's replay thread.
+ *
+ * \param shard
+ *      The shard whose entries are to be replayed.
+ */
+void
+ParallelSegmentReplayer::replayShard(Shard* shard)
+{
+    ObjectManager::ReplayCounters counters;
+    HashTable* objectMap = objectManager->getObjectMap();
+    vector<Entry>& entries = shard->entries;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (expect_true(i + 1 < entries.size()))
+            objectMap->prefetchBucket(entries[i + 1].keyHash);
+
+        Entry& entry = entries[i];
+        objectManager->replayEntry(&shard->sideLog,
+                                   entry.type,
+                                   entry.data,
+                                   entry.length,
+                                   counters);
+    }
+
+    counters.flush(objectManager->masterTableMetadata);
+    entries.clear();
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,160 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PARALLELSEGMENTREPLAYER_H
+#define RAMCLOUD_PARALLELSEGMENTREPLAYER_H
+
+#include <condition_variable>
+#include <thread>
+#include <exception>
+
+#include "Common.h"
+#include "ObjectManager.h"
+#include "SegmentIterator.h"
+#include "SideLog.h"
+
+namespace RAMCloud {
+
+/**
+ * Replays recovery segments using several threads at once. Normally a
+ * recovery master replays each recovery segment with a single call to
+ * ObjectManager::replaySegment(), so replay proceeds no faster than one core
+ * allows no matter how many cores the recovery master has.
+ *
+ * This class divides the entries of each recovery segment among a fixed set
+ * of replay threads according to the hash table bucket each entry's key maps
+ * to. Each thread owns a contiguous range of ObjectManager's bucket locks (and
+ * therefore every bucket that maps to those locks), so two replay threads
+ * never operate on the same bucket and never contend for the same lock. The
+ * locks are still taken, since the log cleaner and other RPCs may be running
+ * concurrently, but they are always uncontended among replay threads.
+ *
+ * Every thread appends to its own SideLog to avoid contending for a single
+ * log's append lock. The SideLogs are committed together by commit() once all
+ * recovery segments have been replayed, making all recovered data durable at
+ * once (see SideLog::commitAll()). If commit() is never called, destroying
+ * this object aborts all of the replayed data, just as destroying an
+ * uncommitted SideLog would.
+ *
+ * This class is not thread-safe: replaySegment() and commit() must be invoked
+ * by a single thread (typically the worker handling the RECOVER RPC).
+ */
+class ParallelSegmentReplayer {
+  public:
+    ParallelSegmentReplayer(ObjectManager* objectManager,
+                            uint32_t numThreads);
+    ~ParallelSegmentReplayer();
+    void replaySegment(SegmentIterator& it);
+    void commit();
+
+    /// Returns the number of replay threads used by this object.
+    uint32_t getNumThreads() const { return numThreads; }
+
+  PRIVATE:
+    /**
+     * Describes a single recovery segment entry that has been assigned to
+     * a replay thread.
+     */
+    struct Entry {
+        /// Pointer to the contiguous entry in the recovery segment.
+        const void* data;
+
+        /// Hash of the entry's key. Used to prefetch its hash table bucket
+        /// before the entry is replayed. Zero for entries without keys.
+        KeyHash keyHash;
+
+        /// Length of the entry in bytes.
+        uint32_t length;
+
+        /// Type of the entry.
+        LogEntryType type;
+    };
+
+    /**
+     * Everything belonging to a single replay thread.
+     */
+    struct Shard {
+        Shard(Log* log, uint32_t index)
+            : index(index)
+            , sideLog(log)
+            , entries()
+            , error()
+            , thread(NULL)
+        {
+        }
+
+        /// Index of this shard in #shards.
+        const uint32_t index;
+
+        /// All entries replayed by this shard's thread are appended here.
+        SideLog sideLog;
+
+        /// The entries of the current recovery segment that this shard's
+        /// thread must replay. Filled in by partition() before the thread is
+        /// released and emptied by the thread when it is done.
+        vector<Entry> entries;
+
+        /// If replaying the current segment threw an exception, it is stored
+        /// here so that replaySegment() can rethrow it on the calling thread.
+        std::exception_ptr error;
+
+        /// The thread replaying this shard's entries.
+        std::thread* thread;
+
+        DISALLOW_COPY_AND_ASSIGN(Shard);
+    };
+
+    typedef std::unique_lock<std::mutex> Lock;
+
+    static void replayThreadEntry(ParallelSegmentReplayer* replayer,
+                                  Shard* shard);
+    uint32_t getShardIndex(KeyHash keyHash);
+    void partition(SegmentIterator& it);
+    void replayShard(Shard* shard);
+
+    /// The ObjectManager whose hash table and log recovered data is added to.
+    ObjectManager* objectManager;
+
+    /// Number of replay threads (and shards) used by this object.
+    const uint32_t numThreads;
+
+    /// One entry per replay thread. Entry i handles the entries whose keys
+    /// map to the i'th range of hash table bucket locks.
+    vector<Shard*> shards;
+
+    /// Protects #generation and #threadsShouldExit.
+    std::mutex mutex;
+
+    /// Notified whenever #generation is incremented or #threadsShouldExit is
+    /// set, waking up the replay threads.
+    std::condition_variable workAvailable;
+
+    /// Incremented each time a new recovery segment has been partitioned and
+    /// is ready to be replayed by the shards' threads.
+    uint64_t generation;
+
+    /// Number of shards whose threads have not yet finished replaying the
+    /// entries of the current recovery segment.
+    std::atomic<uint32_t> shardsRemaining;
+
+    /// Set by the destructor to tell the replay threads to exit.
+    bool threadsShouldExit;
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelSegmentReplayer);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_PARALLELSEGMENTREPLAYER_H
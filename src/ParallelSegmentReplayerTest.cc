@@ -0,0 +1,230 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MasterTableMetadata.h"
+#include "ObjectManager.h"
+#include "ParallelSegmentReplayer.h"
+#include "RawMetrics.h"
+#include "Segment.h"
+#include "ServerList.h"
+#include "StringUtil.h"
+
+namespace RAMCloud {
+
+class ParallelSegmentReplayerTest : public ::testing::Test {
+  public:
+    Context context;
+    ServerId serverId;
+    ServerList serverList;
+    ServerConfig masterConfig;
+    MasterTableMetadata masterTableMetadata;
+    TabletManager tabletManager;
+    ObjectManager objectManager;
+    Segment segment;
+    Buffer segmentBuffer;
+    Segment::Certificate certificate;
+
+    ParallelSegmentReplayerTest()
+        : context()
+        , serverId(5)
+        , serverList(&context)
+        , masterConfig(ServerConfig::forTesting())
+        , masterTableMetadata()
+        , tabletManager()
+        , objectManager(&context,
+                        &serverId,
+                        &masterConfig,
+                        &tabletManager,
+                        &masterTableMetadata)
+        , segment()
+        , segmentBuffer()
+        , certificate()
+    {
+        objectManager.initOnceEnlisted();
+        tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+    }
+
+    /**
+     * Append an object with the given key and value to #segment.
+     */
+    void
+    appendObject(string key, string value, uint64_t version)
+    {
+        Key k(0, key.c_str(), downCast<uint16_t>(key.length()));
+        Buffer dataBuffer;
+        Object object(k, value.c_str(), downCast<uint32_t>(value.length()),
+                      version, 0, dataBuffer);
+        Buffer buffer;
+        object.assembleForLog(buffer);
+        EXPECT_TRUE(segment.append(LOG_ENTRY_TYPE_OBJ, buffer));
+    }
+
+    /**
+     * Append a tombstone for the given key and version to #segment.
+     */
+    void
+    appendTombstone(string key, uint64_t version)
+    {
+        Key k(0, key.c_str(), downCast<uint16_t>(key.length()));
+        Buffer dataBuffer;
+        Object object(k, NULL, 0, version, 0, dataBuffer);
+        ObjectTombstone tombstone(object, 0, 0);
+        Buffer buffer;
+        tombstone.assembleForLog(buffer);
+        EXPECT_TRUE(segment.append(LOG_ENTRY_TYPE_OBJTOMB, buffer));
+    }
+
+    /**
+     * Close #segment and construct an iterator over a contiguous copy of it,
+     * just like a recovery segment received from a backup.
+     */
+    void
+    closeSegment(Tub<SegmentIterator>& it)
+    {
+        segment.close();
+        segment.appendToBuffer(segmentBuffer);
+        segment.getAppendedLength(&certificate);
+        it.construct(segmentBuffer.getRange(0, segmentBuffer.getTotalLength()),
+                     segmentBuffer.getTotalLength(), certificate);
+    }
+
+    string
+    readObject(string key)
+    {
+        Key k(0, key.c_str(), downCast<uint16_t>(key.length()));
+        Buffer value;
+        Status status = objectManager.readObject(k, &value, NULL, NULL, true);
+        if (status != STATUS_OK)
+            return statusToSymbol(status);
+        return string(reinterpret_cast<const char*>(
+                      value.getRange(0, value.getTotalLength())),
+                      value.getTotalLength());
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelSegmentReplayerTest);
+};
+
+TEST_F(ParallelSegmentReplayerTest, constructor) {
+    ParallelSegmentReplayer replayer(&objectManager, 3);
+    EXPECT_EQ(3U, replayer.getNumThreads());
+    EXPECT_EQ(3U, replayer.shards.size());
+    for (uint32_t i = 0; i < 3; i++) {
+        EXPECT_EQ(i, replayer.shards[i]->index);
+        EXPECT_TRUE(replayer.shards[i]->thread != NULL);
+    }
+}
+
+TEST_F(ParallelSegmentReplayerTest, replaySegment) {
+    appendObject("a", "older", 1);
+    appendObject("b", "bee", 1);
+    appendObject("a", "newer", 2);
+    appendObject("c", "sea", 4);
+    appendTombstone("c", 4);
+    Tub<SegmentIterator> it;
+    closeSegment(it);
+
+    ParallelSegmentReplayer replayer(&objectManager, 4);
+    uint64_t returnCount = objectManager.replaySegmentReturnCount;
+    uint64_t entryCount = metrics->master.recoverySegmentEntryCount;
+    replayer.replaySegment(*it);
+
+    EXPECT_EQ(returnCount + 1, objectManager.replaySegmentReturnCount);
+    EXPECT_EQ(entryCount + 5, metrics->master.recoverySegmentEntryCount);
+    EXPECT_EQ("newer", readObject("a"));
+    EXPECT_EQ("bee", readObject("b"));
+    EXPECT_EQ("STATUS_OBJECT_DOESNT_EXIST", readObject("c"));
+    foreach (ParallelSegmentReplayer::Shard* shard, replayer.shards)
+        EXPECT_TRUE(shard->entries.empty());
+
+    MasterTableMetadata::Entry* entry = masterTableMetadata.find(0);
+    ASSERT_TRUE(entry != NULL);
+    EXPECT_EQ(5U, entry->stats.recordCount);
+}
+
+TEST_F(ParallelSegmentReplayerTest, commit) {
+    appendObject("a", "hi", 1);
+    appendObject("b", "there", 1);
+    Tub<SegmentIterator> it;
+    closeSegment(it);
+
+    ParallelSegmentReplayer replayer(&objectManager, 2);
+    replayer.replaySegment(*it);
+
+    uint64_t headId = objectManager.getLog()->head->id;
+    replayer.commit();
+    EXPECT_NE(headId, objectManager.getLog()->head->id);
+    foreach (ParallelSegmentReplayer::Shard* shard, replayer.shards)
+        EXPECT_TRUE(shard->sideLog.segments.empty());
+    EXPECT_EQ("hi", readObject("a"));
+    EXPECT_EQ("there", readObject("b"));
+}
+
+TEST_F(ParallelSegmentReplayerTest, getShardIndex) {
+    ParallelSegmentReplayer replayer(&objectManager, 4);
+
+    // Shards own contiguous ranges of the 1024 bucket locks.
+    EXPECT_EQ(0U, replayer.getShardIndex(0));
+    EXPECT_EQ(0U, replayer.getShardIndex(255));
+    EXPECT_EQ(1U, replayer.getShardIndex(256));
+    EXPECT_EQ(3U, replayer.getShardIndex(1023));
+
+    // Buckets sharing a lock always map to the same shard.
+    EXPECT_EQ(replayer.getShardIndex(300), replayer.getShardIndex(300 + 1024));
+}
+
+TEST_F(ParallelSegmentReplayerTest, partition) {
+    appendObject("a", "hi", 1);
+    appendTombstone("b", 1);
+    ObjectSafeVersion safeVersion(10);
+    Buffer buffer;
+    safeVersion.assembleForLog(buffer);
+    EXPECT_TRUE(segment.append(LOG_ENTRY_TYPE_SAFEVERSION, buffer));
+    EXPECT_TRUE(segment.append(LOG_ENTRY_TYPE_TABLESTATS, "junk", 4));
+    Tub<SegmentIterator> it;
+    closeSegment(it);
+
+    ParallelSegmentReplayer replayer(&objectManager, 2);
+    replayer.partition(*it);
+
+    Key a(0, "a", 1);
+    Key b(0, "b", 1);
+    vector<ParallelSegmentReplayer::Entry>& first =
+        replayer.shards[replayer.getShardIndex(a.getHash())]->entries;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, first[0].type);
+    EXPECT_EQ(a.getHash(), first[0].keyHash);
+
+    uint32_t bShard = replayer.getShardIndex(b.getHash());
+    bool foundTombstone = false;
+    foreach (ParallelSegmentReplayer::Entry& entry,
+             replayer.shards[bShard]->entries) {
+        if (entry.type == LOG_ENTRY_TYPE_OBJTOMB) {
+            foundTombstone = true;
+            EXPECT_EQ(b.getHash(), entry.keyHash);
+        }
+    }
+    EXPECT_TRUE(foundTombstone);
+
+    // Safe versions always go to the first shard; unknown types are dropped.
+    EXPECT_EQ(LOG_ENTRY_TYPE_SAFEVERSION,
+              replayer.shards[0]->entries.back().type);
+    EXPECT_EQ(3U, replayer.shards[0]->entries.size() +
+                  replayer.shards[1]->entries.size());
+
+    foreach (ParallelSegmentReplayer::Shard* shard, replayer.shards)
+        shard->entries.clear();
+}
+
+} // namespace RAMCloud
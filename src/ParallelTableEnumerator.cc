@@ -0,0 +1,301 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ParallelTableEnumerator.h"
+#include "Dispatch.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Constructor for ParallelTableEnumerator objects. No RPCs are sent until
+ * the first call to hasNext() or next().
+ *
+ * \param ramcloud
+ *      Overall information about the RAMCloud cluster to use for this
+ *      enumeration.
+ * \param tableId
+ *      Identifier for the table to enumerate.
+ * \param keysOnly
+ *      False means that full objects are returned, containing both keys
+ *      and data. True means that the returned objects have
+ *      been truncated so that the object data (normally the last
+ *      field of the object) is omitted.
+ * \param maxRpcsPerMaster
+ *      Limit on the number of enumeration RPCs outstanding to any one
+ *      master at a time. Must be at least 1.
+ * \param snapshot
+ *      True means that each tablet is returned as it was when its server
+ *      started enumerating it, and that a tablet whose snapshot expires is
+ *      enumerated again from its beginning; see TableEnumerator.
+ * \param filter
+ *      If non-NULL, only objects that match this filter are returned, and
+ *      only the parts of their values it selects; the filter is copied.
+ */
+ParallelTableEnumerator::ParallelTableEnumerator(RamCloud& ramcloud,
+                                                 uint64_t tableId,
+                                                 bool keysOnly,
+                                                 uint32_t maxRpcsPerMaster,
+                                                 bool snapshot,
+                                                 const ObjectFilter* filter)
+    : ramcloud(ramcloud)
+    , tableId(tableId)
+    , keysOnly(keysOnly)
+    , snapshot(snapshot)
+    , filter()
+    , maxRpcsPerMaster(std::max(1u, maxRpcsPerMaster))
+    , streams()
+    , outstandingRpcs()
+    , ready()
+    , objects()
+    , objectsLastHash(0)
+    , nextOffset(0)
+    , done(false)
+{
+    if (filter != NULL)
+        this->filter.construct(*filter);
+}
+
+/**
+ * Test if any objects remain to be enumerated from the table.
+ *
+ * \result
+ *      True if any objects remain, or false otherwise.
+ */
+bool
+ParallelTableEnumerator::hasNext()
+{
+    requestMoreObjects();
+    return !done;
+}
+
+/**
+ * Return the next object in the table. See TableEnumerator::next; the only
+ * difference is that objects from different tablets are interleaved.
+ *
+ * \param[out] size
+ *      After a successful return, this field will hold the size of
+ *      the object in bytes.
+ * \param[out] object
+ *      After a successful return, this will point to contiguous
+ *      memory containing an instance of Object immediately followed
+ *      by its key and data payloads. The memory is part of an RPC
+ *      response and remains valid until the next call to hasNext() or
+ *      next() that has to move on to another response. NULL is returned
+ *      to indicate that the enumeration is complete.
+ */
+void
+ParallelTableEnumerator::next(uint32_t* size, const void** object)
+{
+    *size = 0;
+    *object = NULL;
+
+    requestMoreObjects();
+    if (done) return;
+
+    uint32_t objectSize = *objects->getOffset<uint32_t>(nextOffset);
+    nextOffset += downCast<uint32_t>(sizeof(uint32_t));
+
+    const void* blob = objects->getRange(nextOffset, objectSize);
+    nextOffset += objectSize;
+
+    *size = objectSize;
+    *object = blob;
+}
+
+/**
+ * Returns the next object in the enumeration, if any. See
+ * TableEnumerator::nextKeyAndData.
+ *
+ * \param[out] keyLength
+ *      After successful return, this field holds the size of the key in bytes.
+ * \param[out] key
+ *      After a successful return, this points to contiguous memory containing
+ *      the key. NULL is returned to indicate enumeration is complete.
+ * \param[out] dataLength
+ *      After successful return, this field holds the size of the data in bytes.
+ * \param[out] data
+ *      After a successful return, this points to contiguous memory containing
+ *      the data. If the keysOnly flag was set when constructing the
+ *      enumerator, NULL is returned.
+ */
+void
+ParallelTableEnumerator::nextKeyAndData(uint32_t* keyLength, const void** key,
+                                        uint32_t* dataLength, const void** data)
+{
+    *keyLength = 0;
+    *key = NULL;
+    *dataLength = 0;
+    *data = NULL;
+
+    uint32_t size = 0;
+    const void* buffer = 0;
+    next(&size, &buffer);
+    if (done) return;
+
+    Object object(buffer, size);
+    *keyLength = object.getKeyLength();
+    *key = object.getKey();
+
+    if (!keysOnly) {
+        *data = object.getValue(dataLength);
+    }
+}
+
+/**
+ * Create one stream for each tablet of the table, according to the
+ * client's current tablet map.
+ */
+void
+ParallelTableEnumerator::findTablets()
+{
+    uint64_t firstHash = 0;
+    while (true) {
+        const TabletWithLocator* tablet =
+                ramcloud.objectFinder.lookupTablet(tableId, firstHash);
+        uint64_t lastHash = tablet->tablet.endKeyHash;
+        streams.emplace_back(new Stream(firstHash, lastHash));
+        if (lastHash == ~0UL)
+            break;
+        firstHash = lastHash + 1;
+    }
+}
+
+/**
+ * Collect the results of a stream's outstanding RPC, which must be ready,
+ * and queue any objects it returned for the client.
+ *
+ * \param stream
+ *      The stream whose RPC has completed.
+ */
+void
+ParallelTableEnumerator::finishRpc(Stream* stream)
+{
+    uint64_t nextHash;
+    try {
+        nextHash = stream->rpc->wait(stream->state);
+    } catch (SnapshotExpiredException& e) {
+        // Start this stream's current tablet over with a new snapshot.
+        stream->rpc.destroy();
+        outstandingRpcs[stream->master]--;
+        stream->state.reset();
+        stream->objects.reset();
+        return;
+    }
+    stream->rpc.destroy();
+    outstandingRpcs[stream->master]--;
+
+    bool empty = (stream->objects->getTotalLength() == 0);
+    if (!empty)
+        ready.emplace_back(std::move(stream->objects), stream->lastHash);
+    stream->objects.reset();
+
+    // The server returns no objects only once it has finished a tablet; the
+    // new hash is then one past the end of that tablet (wrapping to zero
+    // after the last one). Since a stream can start at zero, the hash alone
+    // doesn't say whether anything has finished. If the tablet had been
+    // split, there is more of this stream's range to cover on other tablets.
+    if (empty && (nextHash == 0 || nextHash > stream->lastHash))
+        stream->done = true;
+    stream->nextHash = nextHash;
+}
+
+/**
+ * Collect the results of any RPCs that have completed, then start RPCs for
+ * every stream that needs one, subject to #maxRpcsPerMaster.
+ */
+void
+ParallelTableEnumerator::pollRpcs()
+{
+    foreach (std::unique_ptr<Stream>& stream, streams) {
+        if (stream->rpc && stream->rpc->isReady())
+            finishRpc(stream.get());
+    }
+
+    foreach (std::unique_ptr<Stream>& stream, streams) {
+        if (stream->done || stream->rpc)
+            continue;
+        string master = ramcloud.objectFinder.lookupTablet(tableId,
+                stream->nextHash)->serviceLocator;
+        uint32_t& outstanding = outstandingRpcs[master];
+        if (outstanding >= maxRpcsPerMaster)
+            continue;
+        outstanding++;
+        stream->master = master;
+        stream->objects.reset(new Buffer());
+        stream->rpc.construct(&ramcloud, tableId, keysOnly, stream->nextHash,
+                stream->state, *stream->objects, snapshot, filter.get());
+    }
+}
+
+/**
+ * Used internally by #hasNext() and #next() to retrieve objects. Will
+ * set the #done field if enumeration is complete. Otherwise #objects will
+ * contain an object belonging to its stream at #nextOffset.
+ */
+void
+ParallelTableEnumerator::requestMoreObjects()
+{
+    if (done)
+        return;
+    if (streams.empty())
+        findTablets();
+
+    while (true) {
+        if (objects) {
+            // Skip objects that belong to another stream; this only happens
+            // if tablets were merged after the enumeration started.
+            while (nextOffset < objects->getTotalLength()) {
+                if (objectsLastHash == ~0UL)
+                    return;
+                uint32_t size = *objects->getOffset<uint32_t>(nextOffset);
+                Object object(objects->getRange(
+                        nextOffset + sizeof32(uint32_t), size), size);
+                KeyLength keyLength;
+                const void* key = object.getKey(0, &keyLength);
+                if (Key(tableId, key, keyLength).getHash() <= objectsLastHash)
+                    return;
+                nextOffset += sizeof32(uint32_t) + size;
+            }
+            objects.reset();
+        }
+
+        // Keep the pipeline full before handing out the next batch, so that
+        // servers work on later batches while the client reads this one.
+        pollRpcs();
+        if (!ready.empty()) {
+            objects = std::move(ready.front().objects);
+            objectsLastHash = ready.front().lastHash;
+            ready.pop_front();
+            nextOffset = 0;
+            continue;
+        }
+
+        bool finished = true;
+        foreach (std::unique_ptr<Stream>& stream, streams) {
+            if (!stream->done) {
+                finished = false;
+                break;
+            }
+        }
+        if (finished) {
+            done = true;
+            return;
+        }
+        ramcloud.clientContext->dispatch->poll();
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,174 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PARALLELTABLEENUMERATOR_H
+#define RAMCLOUD_PARALLELTABLEENUMERATOR_H
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include "RamCloud.h"
+#include "Object.h"
+
+namespace RAMCloud {
+
+/**
+ * A drop-in alternative to TableEnumerator for scanning large tables.
+ * Instead of walking the table one tablet and one EnumerateTableRpc at a
+ * time, it enumerates every tablet of the table concurrently, keeping up to
+ * a configurable number of RPCs outstanding to each master. Responses are
+ * queued as they arrive, and further RPCs are issued while the caller is
+ * still consuming earlier results.
+ *
+ * Enumeration state is inherently sequential within a tablet, so the
+ * concurrency available from any one master is bounded by the number of
+ * tablets of the table it owns. Objects are returned in no particular
+ * order; the same exactly-once guarantees as TableEnumerator apply.
+ */
+class ParallelTableEnumerator {
+  public:
+    ParallelTableEnumerator(RamCloud& ramcloud, uint64_t tableId,
+                            bool keysOnly, uint32_t maxRpcsPerMaster = 2,
+                            bool snapshot = false,
+                            const ObjectFilter* filter = NULL);
+    bool hasNext();
+    void next(uint32_t* size, const void** object);
+    void nextKeyAndData(uint32_t* keyLength, const void** key,
+                        uint32_t* dataLength, const void** data);
+
+  PRIVATE:
+    /**
+     * The enumeration of one range of key hashes, which corresponds to a
+     * tablet of the table at the time the enumeration started. If the
+     * tablet has been split since then, the stream continues through the
+     * pieces one at a time, exactly as TableEnumerator does.
+     */
+    struct Stream {
+        Stream(uint64_t firstHash, uint64_t lastHash)
+            : nextHash(firstHash)
+            , lastHash(lastHash)
+            , state()
+            , objects()
+            , rpc()
+            , master()
+            , done(false)
+        {}
+
+        /// Where the next RPC for this stream should continue enumeration;
+        /// see EnumerateTableRpc.
+        uint64_t nextHash;
+
+        /// Largest key hash covered by this stream. Objects with larger
+        /// hashes belong to a later stream.
+        uint64_t lastHash;
+
+        /// Opaque enumeration state returned by the most recent RPC.
+        Buffer state;
+
+        /// Response buffer for the outstanding RPC, if any.
+        std::unique_ptr<Buffer> objects;
+
+        /// The outstanding RPC for this stream, if any.
+        Tub<EnumerateTableRpc> rpc;
+
+        /// Service locator of the master #rpc was sent to.
+        string master;
+
+        /// True once every object in the stream's range has been returned
+        /// by a server.
+        bool done;
+
+        DISALLOW_COPY_AND_ASSIGN(Stream);
+    };
+
+    /**
+     * Objects returned by one EnumerateTableRpc, waiting to be handed out
+     * by next().
+     */
+    struct Batch {
+        Batch(std::unique_ptr<Buffer> objects, uint64_t lastHash)
+            : objects(std::move(objects))
+            , lastHash(lastHash)
+        {}
+
+        /// Response of the RPC, trimmed down to just the objects.
+        std::unique_ptr<Buffer> objects;
+
+        /// Objects with key hashes larger than this belong to another
+        /// stream; see Stream::lastHash.
+        uint64_t lastHash;
+    };
+
+    void findTablets();
+    void finishRpc(Stream* stream);
+    void pollRpcs();
+    void requestMoreObjects();
+
+    /// The RamCloud master object.
+    RamCloud& ramcloud;
+
+    /// The table being enumerated.
+    uint64_t tableId;
+
+    /// False means that full objects are returned, containing both keys
+    /// and data. True means that the returned objects have
+    /// been truncated so that the object data (normally the last
+    /// field of the object) is omitted.
+    bool keysOnly;
+
+    /// True means each tablet is enumerated as it was when its server
+    /// started on it; see RamCloud::enumerateTable.
+    bool snapshot;
+
+    /// If constructed, servers only return objects that match this filter,
+    /// and only the parts of their values it selects.
+    Tub<ObjectFilter> filter;
+
+    /// Limit on the number of EnumerateTableRpcs outstanding to any one
+    /// master.
+    uint32_t maxRpcsPerMaster;
+
+    /// One entry for each tablet of the table; empty until the first call
+    /// to requestMoreObjects().
+    std::vector<std::unique_ptr<Stream>> streams;
+
+    /// Number of RPCs currently outstanding to each master, indexed by
+    /// service locator.
+    std::unordered_map<string, uint32_t> outstandingRpcs;
+
+    /// Responses that have arrived but haven't been handed out yet.
+    std::deque<Batch> ready;
+
+    /// The objects currently being read out by the client. Objects returned
+    /// by next() point into this buffer, so it is only released when the
+    /// client asks for an object from the next batch.
+    std::unique_ptr<Buffer> objects;
+
+    /// Batch::lastHash for #objects.
+    uint64_t objectsLastHash;
+
+    /// The next offset to read within #objects.
+    uint32_t nextOffset;
+
+    /// Set to true when the entire enumeration has completed.
+    bool done;
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelTableEnumerator);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_PARALLELTABLEENUMERATOR_H
@@ -0,0 +1,236 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "ParallelTableEnumerator.h"
+#include "SnapshotManager.h"
+
+namespace RAMCloud {
+
+class ParallelTableEnumeratorTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+
+  public:
+    ParallelTableEnumeratorTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+    }
+
+    void
+    fill(uint64_t tableId, int count)
+    {
+        for (int i = 0; i < count; i++) {
+            string key = format("%d", i);
+            string value = format("value%d", i);
+            ramcloud.write(tableId, key.c_str(),
+                    downCast<uint16_t>(key.length()),
+                    value.c_str(), downCast<uint32_t>(value.length()));
+        }
+    }
+
+    /// Enumerate everything and return "key:value" strings, sorted, so
+    /// that the result doesn't depend on the order RPCs complete in.
+    static string
+    enumerateAll(ParallelTableEnumerator& iter)
+    {
+        std::vector<string> results;
+        while (iter.hasNext()) {
+            uint32_t keyLength = 0, dataLength = 0;
+            const void* key = NULL;
+            const void* data = NULL;
+            iter.nextKeyAndData(&keyLength, &key, &dataLength, &data);
+            results.push_back(string(static_cast<const char*>(key),
+                                     keyLength) + ":" +
+                              string(static_cast<const char*>(data),
+                                     dataLength));
+        }
+        std::sort(results.begin(), results.end());
+        string result;
+        foreach (const string& s, results) {
+            if (result.size() > 0)
+                result += " ";
+            result += s;
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelTableEnumeratorTest);
+};
+
+TEST_F(ParallelTableEnumeratorTest, basics) {
+    uint64_t tableId = ramcloud.createTable("table1", 4);
+    fill(tableId, 10);
+
+    ParallelTableEnumerator iter(ramcloud, tableId, false, 1);
+    EXPECT_EQ("0:value0 1:value1 2:value2 3:value3 4:value4 5:value5 "
+              "6:value6 7:value7 8:value8 9:value9", enumerateAll(iter));
+    EXPECT_EQ(4U, iter.streams.size());
+    foreach (std::unique_ptr<ParallelTableEnumerator::Stream>& stream,
+             iter.streams) {
+        EXPECT_TRUE(stream->done);
+        EXPECT_FALSE(stream->rpc);
+    }
+    EXPECT_EQ(0U, iter.outstandingRpcs["mock:host=master1"]);
+    EXPECT_EQ(0U, iter.outstandingRpcs["mock:host=master2"]);
+
+    // Once finished, stays finished.
+    uint32_t size = 1;
+    const void* object = &size;
+    iter.next(&size, &object);
+    EXPECT_EQ(0U, size);
+    EXPECT_TRUE(object == NULL);
+}
+
+TEST_F(ParallelTableEnumeratorTest, emptyTable) {
+    uint64_t tableId = ramcloud.createTable("table1", 2);
+    ParallelTableEnumerator iter(ramcloud, tableId, false);
+    EXPECT_FALSE(iter.hasNext());
+}
+
+TEST_F(ParallelTableEnumeratorTest, singleTablet) {
+    uint64_t tableId = ramcloud.createTable("table1", 1);
+    fill(tableId, 3);
+
+    // The only stream starts at hash 0 and the server wraps back to 0
+    // when it finishes, so the stream must not be restarted.
+    ParallelTableEnumerator iter(ramcloud, tableId, false);
+    EXPECT_EQ("0:value0 1:value1 2:value2", enumerateAll(iter));
+    ASSERT_EQ(1U, iter.streams.size());
+    EXPECT_TRUE(iter.streams[0]->done);
+    EXPECT_EQ(0U, iter.streams[0]->nextHash);
+}
+
+TEST_F(ParallelTableEnumeratorTest, keysOnly) {
+    uint64_t tableId = ramcloud.createTable("table1", 2);
+    fill(tableId, 3);
+
+    ParallelTableEnumerator iter(ramcloud, tableId, true);
+    EXPECT_EQ("0: 1: 2:", enumerateAll(iter));
+}
+
+TEST_F(ParallelTableEnumeratorTest, findTablets) {
+    uint64_t tableId = ramcloud.createTable("table1", 3);
+    ParallelTableEnumerator iter(ramcloud, tableId, false);
+    iter.findTablets();
+    ASSERT_EQ(3U, iter.streams.size());
+    EXPECT_EQ(0UL, iter.streams[0]->nextHash);
+    EXPECT_EQ(iter.streams[1]->nextHash - 1, iter.streams[0]->lastHash);
+    EXPECT_EQ(iter.streams[2]->nextHash - 1, iter.streams[1]->lastHash);
+    EXPECT_EQ(~0UL, iter.streams[2]->lastHash);
+}
+
+TEST_F(ParallelTableEnumeratorTest, pollRpcs_maxRpcsPerMaster) {
+    // Four tablets, two on each master.
+    uint64_t tableId = ramcloud.createTable("table1", 4);
+    fill(tableId, 10);
+
+    ParallelTableEnumerator iter(ramcloud, tableId, false, 1);
+    iter.findTablets();
+    iter.pollRpcs();
+    uint32_t started = 0;
+    foreach (std::unique_ptr<ParallelTableEnumerator::Stream>& stream,
+             iter.streams) {
+        if (stream->rpc)
+            started++;
+    }
+    EXPECT_EQ(2U, started);
+    EXPECT_EQ(1U, iter.outstandingRpcs["mock:host=master1"]);
+    EXPECT_EQ(1U, iter.outstandingRpcs["mock:host=master2"]);
+
+    // The next poll collects those responses and starts another RPC on
+    // each master.
+    iter.pollRpcs();
+    EXPECT_FALSE(iter.ready.empty());
+    started = 0;
+    foreach (std::unique_ptr<ParallelTableEnumerator::Stream>& stream,
+             iter.streams) {
+        if (stream->rpc)
+            started++;
+    }
+    EXPECT_EQ(2U, started);
+    EXPECT_EQ(1U, iter.outstandingRpcs["mock:host=master1"]);
+    EXPECT_EQ(1U, iter.outstandingRpcs["mock:host=master2"]);
+}
+
+TEST_F(ParallelTableEnumeratorTest, finishRpc_tabletSplitAfterStart) {
+    uint64_t tableId = ramcloud.createTable("table1", 2);
+    fill(tableId, 10);
+
+    // The client believes the table is a single tablet; the stream must
+    // continue through both halves.
+    ParallelTableEnumerator iter(ramcloud, tableId, false);
+    iter.streams.emplace_back(new ParallelTableEnumerator::Stream(0, ~0UL));
+    EXPECT_EQ("0:value0 1:value1 2:value2 3:value3 4:value4 5:value5 "
+              "6:value6 7:value7 8:value8 9:value9", enumerateAll(iter));
+}
+
+TEST_F(ParallelTableEnumeratorTest, finishRpc_snapshotExpired) {
+    uint64_t tableId = ramcloud.createTable("table1", 1);
+    fill(tableId, 3);
+
+    // The first RPC takes the snapshot; the lease runs out before the
+    // next one, so the tablet is enumerated again from its beginning.
+    Cycles::mockTscValue = 1000;
+    ParallelTableEnumerator iter(ramcloud, tableId, false, 1, true);
+    iter.findTablets();
+    iter.pollRpcs();
+    Cycles::mockTscValue = 1001 +
+            Cycles::fromSeconds(SnapshotManager::LEASE_SECONDS);
+    iter.pollRpcs();
+    EXPECT_EQ(1U, iter.ready.size());
+    iter.pollRpcs();
+    EXPECT_EQ(1U, iter.ready.size());
+    EXPECT_FALSE(iter.streams[0]->done);
+    EXPECT_EQ(0U, iter.streams[0]->nextHash);
+
+    EXPECT_EQ("0:value0 0:value0 1:value1 1:value1 2:value2 2:value2",
+              enumerateAll(iter));
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(ParallelTableEnumeratorTest, requestMoreObjects_tabletsMerged) {
+    uint64_t tableId = ramcloud.createTable("table1", 1);
+    fill(tableId, 10);
+
+    // The client believes the table has two tablets, but the server has
+    // just one; each stream gets the whole tablet's objects and must drop
+    // the ones outside its range.
+    ParallelTableEnumerator iter(ramcloud, tableId, false);
+    iter.streams.emplace_back(new ParallelTableEnumerator::Stream(
+            0, 0x7fffffffffffffffUL));
+    iter.streams.emplace_back(new ParallelTableEnumerator::Stream(
+            0x8000000000000000UL, ~0UL));
+    EXPECT_EQ("0:value0 1:value1 2:value2 3:value3 4:value4 5:value5 "
+              "6:value6 7:value7 8:value8 9:value9", enumerateAll(iter));
+}
+
+}  // namespace RAMCloud
@@ -22,7 +22,9 @@
 #include "ShortMacros.h"
 #include "PingClient.h"
 #include "PingService.h"
+#include "ProtoBuf.h"
 #include "ServerList.h"
+#include "ServiceManager.h"
 #include "TimeTrace.h"
 
 namespace RAMCloud {
@@ -58,6 +60,23 @@ PingService::getMetrics(const WireFormat::GetMetrics::Request* reqHdr,
            serialized.c_str(), respHdr->messageLength);
 }
 
+/**
+ * Top-level service method to handle the GET_RPC_STAGE_METRICS request.
+ *
+ * \copydetails Service::ping
+ */
+void
+PingService::getRpcStageMetrics(
+        const WireFormat::GetRpcStageMetrics::Request* reqHdr,
+        WireFormat::GetRpcStageMetrics::Response* respHdr,
+        Rpc* rpc)
+{
+    ProtoBuf::RpcStageMetrics stageMetrics;
+    context->serviceManager->getRpcStageMetrics(&stageMetrics);
+    respHdr->messageLength = ProtoBuf::serializeToResponse(
+            rpc->replyPayload, &stageMetrics);
+}
+
 /**
  * Top-level service method to handle the GET_SERVER_ID request.
  *
@@ -225,6 +244,10 @@ PingService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::GetMetrics, PingService,
                         &PingService::getMetrics>(rpc);
             break;
+        case WireFormat::GetRpcStageMetrics::opcode:
+            callHandler<WireFormat::GetRpcStageMetrics, PingService,
+                        &PingService::getRpcStageMetrics>(rpc);
+            break;
         case WireFormat::GetServerId::opcode:
             callHandler<WireFormat::GetServerId, PingService,
                         &PingService::getServerId>(rpc);
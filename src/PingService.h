@@ -38,6 +38,10 @@ class PingService : public Service {
     void getMetrics(const WireFormat::GetMetrics::Request* reqHdr,
               WireFormat::GetMetrics::Response* respHdr,
               Rpc* rpc);
+    void getRpcStageMetrics(
+              const WireFormat::GetRpcStageMetrics::Request* reqHdr,
+              WireFormat::GetRpcStageMetrics::Response* respHdr,
+              Rpc* rpc);
     void getServerId(const WireFormat::GetServerId::Request* reqHdr,
               WireFormat::GetServerId::Response* respHdr,
               Rpc* rpc);
@@ -18,6 +18,7 @@
 #include "FailSession.h"
 #include "MasterClient.h"
 #include "MultiRead.h"
+#include "MultiReadModifyWrite.h"
 #include "MultiRemove.h"
 #include "MultiWrite.h"
 #include "Object.h"
@@ -64,6 +65,7 @@ RamCloud::RamCloud(const char* locator, const char* clusterName)
     , clientContext(realClientContext.construct(false))
     , status(STATUS_OK)
     , objectFinder(clientContext)
+    , objectCache(NULL)
 {
     clientContext->coordinatorSession->setLocation(locator,
             clusterName);
@@ -81,6 +83,7 @@ RamCloud::RamCloud(Context* context, const char* locator,
     , clientContext(context)
     , status(STATUS_OK)
     , objectFinder(clientContext)
+    , objectCache(NULL)
 {
     clientContext->coordinatorSession->setLocation(locator,
             clusterName);
@@ -362,6 +365,16 @@ DropIndexRpc::DropIndexRpc(RamCloud* ramcloud,
  *      tablet. When this happens, the return value will be set to
  *      point to the next tablet, or will be set to zero if this is
  *      the end of the entire table.
+ * \param snapshot
+ *      True means that each tablet is enumerated as it was when its
+ *      server received the first request for it, with later writes
+ *      ignored. Must be the same in every call for an enumeration.
+ *      False means that objects are returned as they are when the
+ *      server gets to them.
+ * \param filter
+ *      If non-NULL, servers only return objects that match this filter,
+ *      and only the parts of their values it selects. Must be the same in
+ *      every call for an enumeration.
  *
  * \return
  *       The return value is a key hash indicating where to continue
@@ -373,10 +386,11 @@ DropIndexRpc::DropIndexRpc(RamCloud* ramcloud,
  */
 uint64_t
 RamCloud::enumerateTable(uint64_t tableId, bool keysOnly,
-                    uint64_t tabletFirstHash, Buffer& state, Buffer& objects)
+                    uint64_t tabletFirstHash, Buffer& state, Buffer& objects,
+                    bool snapshot, const ObjectFilter* filter)
 {
     EnumerateTableRpc rpc(this, tableId, keysOnly,
-                            tabletFirstHash, state, objects);
+                            tabletFirstHash, state, objects, snapshot, filter);
     return rpc.wait(state);
 }
 
@@ -409,9 +423,16 @@ RamCloud::enumerateTable(uint64_t tableId, bool keysOnly,
  * \param[out] objects
  *      After a successful return, this buffer will contain zero or
  *      more objects from the requested tablet.
+ * \param snapshot
+ *      True means enumerate each tablet as it was when its server first
+ *      started on it; see RamCloud::enumerateTable.
+ * \param filter
+ *      If non-NULL, only return objects matching this filter, and only the
+ *      parts of their values it selects; see RamCloud::enumerateTable.
  */
 EnumerateTableRpc::EnumerateTableRpc(RamCloud* ramcloud, uint64_t tableId,
-        bool keysOnly, uint64_t tabletFirstHash, Buffer& state, Buffer& objects)
+        bool keysOnly, uint64_t tabletFirstHash, Buffer& state, Buffer& objects,
+        bool snapshot, const ObjectFilter* filter)
     : ObjectRpcWrapper(ramcloud, tableId, tabletFirstHash,
             sizeof(WireFormat::Enumerate::Response), &objects)
 {
@@ -419,10 +440,12 @@ EnumerateTableRpc::EnumerateTableRpc(RamCloud* ramcloud, uint64_t tableId,
             allocHeader<WireFormat::Enumerate>());
     reqHdr->tableId = tableId;
     reqHdr->keysOnly = keysOnly;
+    reqHdr->snapshot = snapshot;
     reqHdr->tabletFirstHash = tabletFirstHash;
     reqHdr->iteratorBytes = state.getTotalLength();
     for (Buffer::Iterator it(state); !it.isDone(); it.next())
         request.append(it.getData(), it.getLength());
+    reqHdr->filterBytes = (filter != NULL) ? filter->serialize(request) : 0;
     send();
 }
 
@@ -699,6 +722,82 @@ GetMetricsLocatorRpc::wait()
     return metrics;
 }
 
+/**
+ * Retrieve a breakdown of where the RPCs a server has handled spent their
+ * time (receiving the request, waiting for a worker thread, looking up
+ * objects, waiting for replication, sending the reply, and so on), for
+ * each opcode; see ServiceManager::RpcStage.
+ *
+ * \param serviceLocator
+ *      Selects the server from which the breakdown should be retrieved.
+ * \param[out] stageMetrics
+ *      This protocol buffer is filled in with the breakdown.
+ *
+ * \throw TransportException
+ *       Thrown if an unrecoverable error occurred while communicating with
+ *       the target server.
+ */
+void
+RamCloud::getRpcStageMetrics(const char* serviceLocator,
+        ProtoBuf::RpcStageMetrics& stageMetrics)
+{
+    GetRpcStageMetricsRpc rpc(this, serviceLocator);
+    rpc.wait(stageMetrics);
+}
+
+/**
+ * Constructor for GetRpcStageMetricsRpc: initiates an RPC in the same way as
+ * #RamCloud::getRpcStageMetrics, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param serviceLocator
+ *      Selects the server from which the breakdown should be retrieved.
+ */
+GetRpcStageMetricsRpc::GetRpcStageMetricsRpc(RamCloud* ramcloud,
+        const char* serviceLocator)
+    : RpcWrapper(sizeof(WireFormat::GetRpcStageMetrics::Response))
+    , ramcloud(ramcloud)
+{
+    try {
+        session = ramcloud->clientContext->transportManager->getSession(
+                serviceLocator);
+    } catch (const TransportException& e) {
+        session = FailSession::get();
+    }
+    allocHeader<WireFormat::GetRpcStageMetrics>();
+    send();
+}
+
+/**
+ * Wait for a getRpcStageMetrics RPC to complete, and return the same
+ * results as #RamCloud::getRpcStageMetrics.
+ *
+ * \param[out] stageMetrics
+ *      This protocol buffer is filled in with the breakdown.
+ *
+ * \throw TransportException
+ *       Thrown if an unrecoverable error occurred while communicating with
+ *       the target server.
+ */
+void
+GetRpcStageMetricsRpc::wait(ProtoBuf::RpcStageMetrics& stageMetrics)
+{
+    waitInternal(ramcloud->clientContext->dispatch);
+    if (getState() != RpcState::FINISHED) {
+        throw TransportException(HERE);
+    }
+    const WireFormat::GetRpcStageMetrics::Response* respHdr(
+            getResponseHeader<WireFormat::GetRpcStageMetrics>());
+
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+
+    ProtoBuf::parseFromResponse(response, sizeof(*respHdr),
+        respHdr->messageLength, &stageMetrics);
+}
+
 /**
  * Retrieve a server's runtime configuration.
  *
@@ -1016,6 +1115,9 @@ IncrementRpc::wait(uint64_t* version)
             getResponseHeader<WireFormat::Increment>());
     if (version != NULL)
         *version = respHdr->version;
+    if (respHdr->common.status == STATUS_OK &&
+            ramcloud->objectCache != NULL)
+        ramcloud->objectCache->invalidate(tableId, keyHash, respHdr->version);
 
     if (respHdr->common.status != STATUS_OK)
         ClientException::throwException(HERE, respHdr->common.status);
@@ -1527,6 +1629,31 @@ RamCloud::multiRead(MultiReadObject* requests[], uint32_t numRequests)
     request.wait();
 }
 
+/**
+ * Atomically update multiple objects, each with its own RmwOperation; see
+ * RamCloud::readModifyWrite. Each update is atomic on its own, but there is
+ * no atomicity across objects. This method has two performance advantages
+ * over calling RamCloud::readModifyWrite separately for each object:
+ * - If multiple objects are stored on a single server, this method
+ *   issues a single RPC to update all of them at once.
+ * - If different objects are stored on different servers, this method
+ *   issues multiple RPCs concurrently.
+ *
+ * \param requests
+ *      Each element in this array describes one object to update. The
+ *      operation's status, the object's version, and its value are also
+ *      returned here.
+ * \param numRequests
+ *      Number of valid entries in \c requests.
+ */
+void
+RamCloud::multiReadModifyWrite(MultiReadModifyWriteObject* requests[],
+                               uint32_t numRequests)
+{
+    MultiReadModifyWrite request(this, requests, numRequests);
+    request.wait();
+}
+
 /**
  * Remove multiple objects.
  * This method has two performance advantages over calling RamCloud::remove
@@ -1630,10 +1757,76 @@ RamCloud::read(uint64_t tableId, const void* key, uint16_t keyLength,
                    Buffer* value, const RejectRules* rejectRules,
                    uint64_t* version)
 {
+    if (objectCache != NULL && rejectRules == NULL) {
+        readCached(tableId, key, keyLength, value, version);
+        return;
+    }
     ReadRpc rpc(this, tableId, key, keyLength, value, rejectRules);
     rpc.wait(version);
 }
 
+/**
+ * Helper for #read when a ClientObjectCache is attached: serves the read
+ * from the cache if possible, and otherwise reads the object from its
+ * master and caches it. Arguments are the same as for #read.
+ */
+void
+RamCloud::readCached(uint64_t tableId, const void* key, uint16_t keyLength,
+        Buffer* value, uint64_t* version)
+{
+    uint64_t cachedVersion = 0;
+    ClientObjectCache::Result result = objectCache->lookup(tableId, key,
+            keyLength, value, &cachedVersion);
+    if (result == ClientObjectCache::HIT) {
+        if (version != NULL)
+            *version = cachedVersion;
+        return;
+    }
+    if (result == ClientObjectCache::UNCACHED_TABLE) {
+        ReadRpc rpc(this, tableId, key, keyLength, value);
+        rpc.wait(version);
+        return;
+    }
+
+    uint64_t newVersion = 0;
+    try {
+        if (result == ClientObjectCache::STALE) {
+            // Ask the master to send the value only if it has changed since
+            // it was cached; if it hasn't, the read is rejected.
+            RejectRules rules;
+            memset(&rules, 0, sizeof(rules));
+            rules.givenVersion = cachedVersion;
+            rules.versionLeGiven = 1;
+            try {
+                ReadRpc rpc(this, tableId, key, keyLength, value, &rules);
+                rpc.wait(&newVersion);
+                objectCache->insert(tableId, key, keyLength, *value,
+                                    newVersion);
+                if (version != NULL)
+                    *version = newVersion;
+                return;
+            } catch (WrongVersionException& e) {
+                if (objectCache->renew(tableId, key, keyLength,
+                                       cachedVersion, value)) {
+                    if (version != NULL)
+                        *version = cachedVersion;
+                    return;
+                }
+                // The entry was dropped in the meantime; read it again.
+            }
+        }
+        ReadRpc rpc(this, tableId, key, keyLength, value);
+        rpc.wait(&newVersion);
+    } catch (ObjectDoesntExistException& e) {
+        objectCache->invalidate(tableId,
+                Key::getHash(tableId, key, keyLength), 0);
+        throw;
+    }
+    objectCache->insert(tableId, key, keyLength, *value, newVersion);
+    if (version != NULL)
+        *version = newVersion;
+}
+
 /**
  * Read the current contents of an object including the keys and the value.
  *
@@ -1694,6 +1887,8 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
         const RejectRules* rejectRules)
     : ObjectRpcWrapper(ramcloud, tableId, key, keyLength,
             sizeof(WireFormat::Read::Response), value)
+    , mayUseReplica(rejectRules == NULL)
+    , sentToReplica(false)
 {
     value->reset();
     WireFormat::Read::Request* reqHdr(allocHeader<WireFormat::Read>());
@@ -1704,6 +1899,50 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
     send();
 }
 
+// See RpcWrapper for documentation.
+bool
+ReadRpc::checkStatus()
+{
+    if (sentToReplica && responseHeader->status == STATUS_UNKNOWN_TABLET) {
+        // The copy has expired or been invalidated; go back to the owner
+        // without throwing away the rest of our configuration.
+        ramcloud->objectFinder.flushReplicas(tableId, keyHash);
+        send();
+        return false;
+    }
+    return ObjectRpcWrapper::checkStatus();
+}
+
+// See RpcWrapper for documentation.
+bool
+ReadRpc::handleTransportError()
+{
+    if (sentToReplica) {
+        ramcloud->clientContext->transportManager->flushSession(
+                session->getServiceLocator().c_str());
+        session = NULL;
+        ramcloud->objectFinder.flushReplicas(tableId, keyHash);
+        send();
+        return false;
+    }
+    return ObjectRpcWrapper::handleTransportError();
+}
+
+// See RpcWrapper for documentation.
+void
+ReadRpc::send()
+{
+    sentToReplica = false;
+    if (mayUseReplica) {
+        session = ramcloud->objectFinder.lookupForRead(tableId, keyHash,
+                                                       &sentToReplica);
+    } else {
+        session = ramcloud->objectFinder.lookup(tableId, keyHash);
+    }
+    state = IN_PROGRESS;
+    session->sendRequest(&request, response, this);
+}
+
 /**
  * Wait for the RPC to complete, and return the same results as
  * #RamCloud::read.
@@ -1720,13 +1959,25 @@ ReadRpc::wait(uint64_t* version)
     if (version != NULL)
         *version = respHdr->version;
 
+    // If the object is hot, the owner tells us where copies of it are;
+    // later reads will be spread across them.
+    Status status = respHdr->common.status;
+    uint32_t replicasLength = 0;
+    if (status == STATUS_OK && respHdr->replicasLength != 0) {
+        replicasLength = respHdr->replicasLength;
+        ramcloud->objectFinder.addReplicas(tableId, keyHash, *response,
+                sizeof32(*respHdr) + respHdr->length, replicasLength,
+                respHdr->replicaLeaseMs);
+    }
+
     // Truncate the response Buffer so that it consists of nothing
     // but the object data.
     response->truncateFront(sizeof(*respHdr));
+    response->truncateEnd(replicasLength);
     assert(respHdr->length == response->getTotalLength());
 
-    if (respHdr->common.status != STATUS_OK)
-        ClientException::throwException(HERE, respHdr->common.status);
+    if (status != STATUS_OK)
+        ClientException::throwException(HERE, status);
 }
 
 /**
@@ -1795,6 +2046,124 @@ ReadKeysAndValueRpc::wait(uint64_t* version)
         ClientException::throwException(HERE, respHdr->common.status);
 }
 
+/**
+ * Atomically replace the value of an object with one computed from its
+ * current value by an RmwOperation (for example, add to a counter or
+ * compare-and-swap a field). The server applies the operation while no
+ * other update of the object can intervene, so unlike a read followed by
+ * a conditional write, it never needs to be retried because of contention.
+ *
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param operation
+ *      Computes the object's new value from its current one.
+ * \param[out] value
+ *      If non-NULL, this Buffer holds the object's new value after a
+ *      successful return, or its current value if the operation throws
+ *      RmwConditionFailedException.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the operation
+ *      should be aborted with an error.
+ * \param[out] version
+ *      If non-NULL, the new version number of the object is returned here.
+ *
+ * \exception ObjectDoesntExistException
+ *      The object doesn't exist; operations never create objects.
+ * \exception InvalidObjectException
+ *      The field the operation applies to doesn't lie within the value.
+ * \exception RmwConditionFailedException
+ *      The operation's condition didn't hold, so the object is unchanged.
+ */
+void
+RamCloud::readModifyWrite(uint64_t tableId, const void* key,
+        uint16_t keyLength, const RmwOperation& operation, Buffer* value,
+        const RejectRules* rejectRules, uint64_t* version)
+{
+    ReadModifyWriteRpc rpc(this, tableId, key, keyLength, operation, value,
+            rejectRules);
+    rpc.wait(version);
+}
+
+/**
+ * Constructor for ReadModifyWriteRpc: initiates an RPC in the same way as
+ * #RamCloud::readModifyWrite, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param operation
+ *      Computes the object's new value from its current one.
+ * \param[out] value
+ *      If non-NULL, receives the object's value; see
+ *      #RamCloud::readModifyWrite.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the operation
+ *      should be aborted with an error.
+ */
+ReadModifyWriteRpc::ReadModifyWriteRpc(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength, const RmwOperation& operation,
+        Buffer* value, const RejectRules* rejectRules)
+    : ObjectRpcWrapper(ramcloud, tableId, key, keyLength,
+            sizeof(WireFormat::ReadModifyWrite::Response), value)
+{
+    if (value != NULL)
+        value->reset();
+    WireFormat::ReadModifyWrite::Request* reqHdr(
+            allocHeader<WireFormat::ReadModifyWrite>());
+    reqHdr->tableId = tableId;
+    reqHdr->keyLength = keyLength;
+    reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    request.append(key, keyLength);
+    reqHdr->operationLength = operation.serialize(request);
+    send();
+}
+
+/**
+ * Wait for the RPC to complete, and return the same results as
+ * #RamCloud::readModifyWrite.
+ *
+ * \param[out] version
+ *      If non-NULL, the new version number of the object is returned here.
+ */
+void
+ReadModifyWriteRpc::wait(uint64_t* version)
+{
+    waitInternal(ramcloud->clientContext->dispatch);
+    const WireFormat::ReadModifyWrite::Response* respHdr(
+            getResponseHeader<WireFormat::ReadModifyWrite>());
+    if (version != NULL)
+        *version = respHdr->version;
+    if (respHdr->common.status == STATUS_OK &&
+            ramcloud->objectCache != NULL)
+        ramcloud->objectCache->invalidate(tableId, keyHash, respHdr->version);
+
+    // Truncate the response Buffer so that it consists of nothing
+    // but the object's value.
+    response->truncateFront(sizeof(*respHdr));
+    assert(respHdr->length == response->getTotalLength());
+
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+}
+
 /**
  * Delete an object from a table. If the object does not currently exist
  * then the operation succeeds without doing anything (unless rejectRules
@@ -1875,6 +2244,10 @@ RemoveRpc::wait(uint64_t* version)
             getResponseHeader<WireFormat::Remove>());
     if (version != NULL)
         *version = respHdr->version;
+    if (respHdr->common.status == STATUS_OK &&
+            ramcloud->objectCache != NULL)
+        ramcloud->objectCache->invalidate(tableId, keyHash,
+                                          respHdr->version + 1);
 
     if (respHdr->common.status != STATUS_OK)
         ClientException::throwException(HERE, respHdr->common.status);
@@ -2153,6 +2526,34 @@ GetRuntimeOptionRpc::GetRuntimeOptionRpc(RamCloud* ramcloud, const char* option,
     send();
 }
 
+/**
+ * Constructor for GetRuntimeOptionRpc for use by servers, which have no
+ * RamCloud object of their own.
+ *
+ * \param context
+ *      Overall information about this server; used to reach the
+ *      coordinator.
+ * \param option
+ *      String name corresponding to a member field in the RuntimeOptions
+ *      class whose value should be returned in value buffer.
+ * \param[out] value
+ *      After a successful return, this Buffer will hold the value of the desired
+ *      option.
+ */
+GetRuntimeOptionRpc::GetRuntimeOptionRpc(Context* context, const char* option,
+                                         Buffer* value)
+    : CoordinatorRpcWrapper(context,
+                            sizeof(WireFormat::GetRuntimeOption::Response),
+                            value)
+{
+    value->reset();
+    WireFormat::GetRuntimeOption::Request*
+            reqHdr(allocHeader<WireFormat::GetRuntimeOption>());
+    reqHdr->optionLength = downCast<uint32_t> (strlen(option) + 1);
+    request.append(option, reqHdr->optionLength);
+    send();
+}
+
 /**
  * Wait for the RPC to complete, and return the same results as
  * #RamCloud::read.
@@ -2249,6 +2650,22 @@ KillRpc::KillRpc(RamCloud* ramcloud, uint64_t tableId,
     send();
 }
 
+/**
+ * Attach a cache of object values to this object; see ClientObjectCache.
+ * The same cache may be attached to the RamCloud objects of several
+ * threads.
+ *
+ * \param cache
+ *      Cache to use for reads of the tables enabled in it, or NULL to stop
+ *      using a cache. The caller must keep the cache alive for as long as
+ *      it is attached.
+ */
+void
+RamCloud::setObjectCache(ClientObjectCache* cache)
+{
+    objectCache = cache;
+}
+
 /**
  * Set a runtime option field on the coordinator to the indicated value.
  *
@@ -2621,6 +3038,9 @@ WriteRpc::wait(uint64_t* version)
             getResponseHeader<WireFormat::Write>());
     if (version != NULL)
         *version = respHdr->version;
+    if (respHdr->common.status == STATUS_OK &&
+            ramcloud->objectCache != NULL)
+        ramcloud->objectCache->invalidate(tableId, keyHash, respHdr->version);
 
     if (respHdr->common.status != STATUS_OK)
         ClientException::throwException(HERE, respHdr->common.status);
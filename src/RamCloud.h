@@ -17,20 +17,25 @@
 #define RAMCLOUD_RAMCLOUD_H
 
 #include "Common.h"
+#include "ClientObjectCache.h"
 #include "CoordinatorClient.h"
 #include "IndexRpcWrapper.h"
 #include "MasterClient.h"
 #include "ObjectBuffer.h"
+#include "ObjectFilter.h"
 #include "ObjectFinder.h"
 #include "ObjectRpcWrapper.h"
+#include "RmwOperation.h"
 #include "ServerMetrics.h"
 
 #include "LogMetrics.pb.h"
+#include "RpcStageMetrics.pb.h"
 #include "ServerConfig.pb.h"
 #include "ServerStatistics.pb.h"
 
 namespace RAMCloud {
 class MultiReadObject;
+class MultiReadModifyWriteObject;
 class MultiRemoveObject;
 class MultiWriteObject;
 
@@ -68,12 +73,15 @@ class RamCloud {
                                                       uint8_t numIndexlets = 1);
     void dropIndex(uint64_t tableId, uint8_t indexId);
     uint64_t enumerateTable(uint64_t tableId, bool keysOnly,
-         uint64_t tabletFirstHash, Buffer& state, Buffer& objects);
+         uint64_t tabletFirstHash, Buffer& state, Buffer& objects,
+         bool snapshot = false, const ObjectFilter* filter = NULL);
     void getLogMetrics(const char* serviceLocator,
                        ProtoBuf::LogMetrics& logMetrics);
     ServerMetrics getMetrics(uint64_t tableId, const void* key,
             uint16_t keyLength);
     ServerMetrics getMetrics(const char* serviceLocator);
+    void getRpcStageMetrics(const char* serviceLocator,
+            ProtoBuf::RpcStageMetrics& stageMetrics);
     void getRuntimeOption(const char* option, Buffer* value);
     void getServerConfig(const char* serviceLocator,
             ProtoBuf::ServerConfig& serverConfig);
@@ -103,6 +111,8 @@ class RamCloud {
     void migrateTablet(uint64_t tableId, uint64_t firstKeyHash,
             uint64_t lastKeyHash, ServerId newOwnerMasterId);
     void multiRead(MultiReadObject* requests[], uint32_t numRequests);
+    void multiReadModifyWrite(MultiReadModifyWriteObject* requests[],
+            uint32_t numRequests);
     void multiRemove(MultiRemoveObject* requests[], uint32_t numRequests);
     void multiWrite(MultiWriteObject* requests[], uint32_t numRequests);
     void quiesce();
@@ -112,6 +122,10 @@ class RamCloud {
     void readKeysAndValue(uint64_t tableId, const void* key, uint16_t keyLength,
             ObjectBuffer* value, const RejectRules* rejectRules = NULL,
             uint64_t* version = NULL);
+    void readModifyWrite(uint64_t tableId, const void* key,
+            uint16_t keyLength, const RmwOperation& operation,
+            Buffer* value = NULL, const RejectRules* rejectRules = NULL,
+            uint64_t* version = NULL);
     void remove(uint64_t tableId, const void* key, uint16_t keyLength,
             const RejectRules* rejectRules = NULL, uint64_t* version = NULL);
     void serverControl(uint64_t tableId, const void* key, uint16_t keyLength,
@@ -125,6 +139,7 @@ class RamCloud {
     string testingGetServiceLocator(uint64_t tableId, const void* key,
             uint16_t keyLength);
     void testingKill(uint64_t tableId, const void* key, uint16_t keyLength);
+    void setObjectCache(ClientObjectCache* cache);
     void setRuntimeOption(const char* option, const char* value);
     void testingWaitForAllTabletsNormal(uint64_t tableId,
                                         uint64_t timeoutNs = ~0lu);
@@ -151,6 +166,9 @@ class RamCloud {
     virtual ~RamCloud();
 
   PRIVATE:
+    void readCached(uint64_t tableId, const void* key, uint16_t keyLength,
+            Buffer* value, uint64_t* version);
+
     /**
      * Service locator for the cluster coordinator.
      */
@@ -179,6 +197,14 @@ class RamCloud {
   public: // public for now to make administrative calls from clients
     ObjectFinder objectFinder;
 
+    /**
+     * If non-NULL, reads of objects in the tables enabled in this cache
+     * may be served from it, and updates made through this object
+     * invalidate its entries. Set by setObjectCache(); not owned by this
+     * object.
+     */
+    ClientObjectCache* objectCache;
+
   private:
     DISALLOW_COPY_AND_ASSIGN(RamCloud);
 };
@@ -250,7 +276,8 @@ class DropIndexRpc : public CoordinatorRpcWrapper {
 class EnumerateTableRpc : public ObjectRpcWrapper {
   public:
     EnumerateTableRpc(RamCloud* ramcloud, uint64_t tableId, bool keysOnly,
-            uint64_t tabletFirstHash, Buffer& iter, Buffer& objects);
+            uint64_t tabletFirstHash, Buffer& iter, Buffer& objects,
+            bool snapshot = false, const ObjectFilter* filter = NULL);
     ~EnumerateTableRpc() {}
     uint64_t wait(Buffer& nextIter);
 
@@ -319,6 +346,21 @@ class GetMetricsLocatorRpc : public RpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(GetMetricsLocatorRpc);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::getRpcStageMetrics operation,
+ * allowing it to execute asynchronously.
+ */
+class GetRpcStageMetricsRpc : public RpcWrapper {
+  public:
+    GetRpcStageMetricsRpc(RamCloud* ramcloud, const char* serviceLocator);
+    ~GetRpcStageMetricsRpc() {}
+    void wait(ProtoBuf::RpcStageMetrics& stageMetrics);
+
+  PRIVATE:
+    RamCloud* ramcloud;
+    DISALLOW_COPY_AND_ASSIGN(GetRpcStageMetricsRpc);
+};
+
 /**
  * Encapsulate the state of RamCloud:: getRuntimeOption operation
  * allowing to execute asynchronously.
@@ -327,6 +369,8 @@ class GetRuntimeOptionRpc : public CoordinatorRpcWrapper{
     public:
         GetRuntimeOptionRpc(RamCloud* ramcloud, const char* option,
                          Buffer* value);
+        GetRuntimeOptionRpc(Context* context, const char* option,
+                         Buffer* value);
         ~GetRuntimeOptionRpc(){}
         void wait();
     PRIVATE:
@@ -566,28 +610,107 @@ struct MultiReadObject : public MultiOpObject {
      */
     uint64_t version;
 
+    /**
+     * If non-NULL, the object is only returned if it matches this filter
+     * (otherwise the status is STATUS_OBJECT_FILTERED), and only the part
+     * of its value selected by the filter is returned. The caller must
+     * keep the filter valid until the read completes.
+     */
+    const ObjectFilter* filter;
+
     MultiReadObject(uint64_t tableId, const void* key, uint16_t keyLength,
-            Tub<ObjectBuffer>* value)
+            Tub<ObjectBuffer>* value, const ObjectFilter* filter = NULL)
         : MultiOpObject(tableId, key, keyLength)
         , value(value)
         , version()
+        , filter(filter)
     {}
 
     MultiReadObject()
         : value()
         , version()
+        , filter()
     {}
 
     MultiReadObject(const MultiReadObject& other)
         : MultiOpObject(other)
         , value(other.value)
         , version(other.version)
+        , filter(other.filter)
     {}
 
     MultiReadObject& operator=(const MultiReadObject& other) {
         MultiOpObject::operator =(other);
         value = other.value;
         version = other.version;
+        filter = other.filter;
+        return *this;
+    }
+};
+
+/**
+ * Objects of this class are used to pass parameters into
+ * \c multiReadModifyWrite and for it to return results.
+ */
+struct MultiReadModifyWriteObject : public MultiOpObject {
+    /**
+     * Computes the object's new value from its current one. The caller must
+     * keep the operation valid until the request completes.
+     */
+    const RmwOperation* operation;
+
+    /**
+     * The RejectRules specify when conditional operations should be aborted.
+     */
+    const RejectRules* rejectRules;
+
+    /**
+     * If non-NULL, the object's new value is returned here if the operation
+     * succeeded, or its current value if the status is
+     * STATUS_RMW_CONDITION_FAILED.
+     */
+    Buffer* value;
+
+    /**
+     * The new version number of the object is returned here (or its current
+     * version, if the operation failed).
+     */
+    uint64_t version;
+
+    MultiReadModifyWriteObject(uint64_t tableId, const void* key,
+                               uint16_t keyLength,
+                               const RmwOperation* operation,
+                               Buffer* value = NULL,
+                               const RejectRules* rejectRules = NULL)
+        : MultiOpObject(tableId, key, keyLength)
+        , operation(operation)
+        , rejectRules(rejectRules)
+        , value(value)
+        , version()
+    {}
+
+    MultiReadModifyWriteObject()
+        : operation()
+        , rejectRules()
+        , value()
+        , version()
+    {}
+
+    MultiReadModifyWriteObject(const MultiReadModifyWriteObject& other)
+        : MultiOpObject(other)
+        , operation(other.operation)
+        , rejectRules(other.rejectRules)
+        , value(other.value)
+        , version(other.version)
+    {}
+
+    MultiReadModifyWriteObject& operator=(
+            const MultiReadModifyWriteObject& other) {
+        MultiOpObject::operator =(other);
+        operation = other.operation;
+        rejectRules = other.rejectRules;
+        value = other.value;
+        version = other.version;
         return *this;
     }
 };
@@ -802,7 +925,20 @@ class ReadRpc : public ObjectRpcWrapper {
     ~ReadRpc() {}
     void wait(uint64_t* version = NULL);
 
+  PROTECTED:
+    virtual bool checkStatus();
+    virtual bool handleTransportError();
+    virtual void send();
+
   PRIVATE:
+    /// True if the read may be served by a master holding a copy of a hot
+    /// object rather than its owner; false if it has reject rules.
+    bool mayUseReplica;
+
+    /// True if the request was most recently sent to a master holding a
+    /// copy rather than the owner.
+    bool sentToReplica;
+
     DISALLOW_COPY_AND_ASSIGN(ReadRpc);
 };
 
@@ -823,6 +959,22 @@ class ReadKeysAndValueRpc : public ObjectRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(ReadKeysAndValueRpc);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::readModifyWrite operation,
+ * allowing it to execute asynchronously.
+ */
+class ReadModifyWriteRpc : public ObjectRpcWrapper {
+  public:
+    ReadModifyWriteRpc(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength, const RmwOperation& operation, Buffer* value,
+            const RejectRules* rejectRules = NULL);
+    ~ReadModifyWriteRpc() {}
+    void wait(uint64_t* version = NULL);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(ReadModifyWriteRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::remove operation,
  * allowing it to execute asynchronously.
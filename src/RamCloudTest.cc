@@ -499,6 +499,86 @@ TEST_F(RamCloudTest, read) {
                         value.getTotalLength()));
 }
 
+TEST_F(RamCloudTest, read_objectCache) {
+    ClientObjectCache cache;
+    cache.enableTable(tableId1, 10);
+    ramcloud->setObjectCache(&cache);
+    RamCloud other(&context, "mock:host=coordinator");
+    Cycles::mockTscValue = 1000;
+
+    ramcloud->write(tableId1, "0", 1, "first", 5);
+    Buffer value;
+    uint64_t version;
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &version);
+    EXPECT_EQ("first", TestUtil::toString(&value));
+    EXPECT_EQ(0U, cache.getHits());
+
+    // Updates by clients not sharing the cache aren't seen until the
+    // lease runs out.
+    other.write(tableId1, "0", 1, "second", 6);
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &version);
+    EXPECT_EQ("first", TestUtil::toString(&value));
+    EXPECT_EQ(1U, version);
+    EXPECT_EQ(1U, cache.getHits());
+
+    Cycles::mockTscValue += Cycles::fromNanoseconds(10 * 1000 * 1000);
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &version);
+    EXPECT_EQ("second", TestUtil::toString(&value));
+    EXPECT_EQ(2U, version);
+
+    // Revalidating an unchanged object renews its lease.
+    Cycles::mockTscValue += Cycles::fromNanoseconds(10 * 1000 * 1000);
+    value.reset();
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &version);
+    EXPECT_EQ("second", TestUtil::toString(&value));
+    EXPECT_EQ(2U, version);
+    ramcloud->read(tableId1, "0", 1, &value);
+    EXPECT_EQ(2U, cache.getHits());
+
+    // Our own updates are seen immediately.
+    ramcloud->write(tableId1, "0", 1, "third", 5);
+    ramcloud->read(tableId1, "0", 1, &value);
+    EXPECT_EQ("third", TestUtil::toString(&value));
+    ramcloud->remove(tableId1, "0", 1);
+    EXPECT_THROW(ramcloud->read(tableId1, "0", 1, &value),
+                 ObjectDoesntExistException);
+
+    // Reads with reject rules and reads of other tables bypass the cache.
+    other.write(tableId1, "0", 1, "fourth", 6);
+    ramcloud->read(tableId1, "0", 1, &value);
+    other.write(tableId1, "0", 1, "fifth", 5);
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.doesntExist = 1;
+    ramcloud->read(tableId1, "0", 1, &value, &rules);
+    EXPECT_EQ("fifth", TestUtil::toString(&value));
+    other.write(tableId2, "0", 1, "other table", 11);
+    ramcloud->read(tableId2, "0", 1, &value);
+    EXPECT_EQ("other table", TestUtil::toString(&value));
+
+    ramcloud->setObjectCache(NULL);
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(RamCloudTest, multiWrite_objectCache) {
+    ClientObjectCache cache;
+    cache.enableTable(tableId1, 1000);
+    ramcloud->setObjectCache(&cache);
+    Buffer value;
+    ramcloud->write(tableId1, "ha", 2, "old", 3);
+    ramcloud->read(tableId1, "ha", 2, &value);
+
+    KeyInfo keyList[1];
+    keyList[0].keyLength = 0;
+    keyList[0].key = "ha";
+    MultiWriteObject object(tableId1, "new", 3, 1, keyList);
+    MultiWriteObject* requests[] = {&object};
+    ramcloud->multiWrite(requests, 1);
+    ramcloud->read(tableId1, "ha", 2, &value);
+    EXPECT_EQ("new", TestUtil::toString(&value));
+    ramcloud->setObjectCache(NULL);
+}
+
 TEST_F(RamCloudTest, remove) {
     ramcloud->write(tableId1, "0", 1, "abcdef", 6);
     uint64_t version;
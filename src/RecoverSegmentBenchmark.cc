@@ -18,6 +18,7 @@
 #include "Logger.h"
 #include "MasterService.h"
 #include "Memory.h"
+#include "ParallelSegmentReplayer.h"
 #include "SegmentIterator.h"
 #include "Seglet.h"
 #include "Tablets.pb.h"
@@ -57,7 +58,7 @@ class RecoverSegmentBenchmark {
     }
 
     void
-    run(int numSegments, int dataLen)
+    run(int numSegments, int dataLen, uint32_t numThreads)
     {
         /*
          * Allocate numSegments Segments and fill them up with objects of
@@ -112,9 +113,14 @@ class RecoverSegmentBenchmark {
         metrics->temp.count9 = 0;
 
         /*
-         * Now run a fake recovery.
+         * Now run a fake recovery. A single thread uses the ordinary
+         * ObjectManager::replaySegment() path; more threads use a
+         * ParallelSegmentReplayer, just as a recovery master would.
          */
         SideLog sideLog(service->objectManager.getLog());
+        Tub<ParallelSegmentReplayer> replayer;
+        if (numThreads > 1)
+            replayer.construct(&service->objectManager, numThreads);
         uint64_t before = Cycles::rdtsc();
         for (int i = 0; i < numSegments; i++) {
             Segment* s = segments[i];
@@ -124,16 +130,22 @@ class RecoverSegmentBenchmark {
             s->getAppendedLength(&certificate);
             const void* contigSeg = buffer.getRange(0, buffer.getTotalLength());
             SegmentIterator it(contigSeg, buffer.getTotalLength(), certificate);
-            service->objectManager.replaySegment(&sideLog, it);
+            if (replayer)
+                replayer->replaySegment(it);
+            else
+                service->objectManager.replaySegment(&sideLog, it);
         }
         uint64_t ticks = Cycles::rdtsc() - before;
 
         uint64_t totalObjectBytes = numObjects * dataLen;
         uint64_t totalSegmentBytes = numSegments *
                                      Segment::DEFAULT_SEGMENT_SIZE;
-        printf("Recovery of %d %dKB Segments with %d byte Objects took %lu "
-            "ms\n", numSegments, Segment::DEFAULT_SEGMENT_SIZE / 1024,
-            dataLen, RAMCloud::Cycles::toNanoseconds(ticks) / 1000 / 1000);
+        printf("Recovery of %d %dKB Segments with %d byte Objects using %u "
+            "thread(s) took %lu ms (%.1f MB/s)\n", numSegments,
+            Segment::DEFAULT_SEGMENT_SIZE / 1024, dataLen, numThreads,
+            RAMCloud::Cycles::toNanoseconds(ticks) / 1000 / 1000,
+            static_cast<double>(totalSegmentBytes) / (1024. * 1024.) /
+            Cycles::toSeconds(ticks));
         printf("Actual total object count: %lu (%lu bytes in Objects, %.2f%% "
             "overhead)\n", numObjects, totalObjectBytes,
             100.0 *
@@ -199,11 +211,14 @@ main()
 {
     int numSegments = 600 / 8; // = 72.
     int dataLen[] = { 64, 128, 256, 512, 1024, 2048, 8192, 0 };
+    uint32_t numThreads[] = { 1, 2, 4, 8, 16, 0 };
 
     for (int i = 0; dataLen[i] != 0; i++) {
-        printf("==========================\n");
-        RAMCloud::RecoverSegmentBenchmark rsb("2048", "10%", numSegments);
-        rsb.run(numSegments, dataLen[i]);
+        for (int j = 0; numThreads[j] != 0; j++) {
+            printf("==========================\n");
+            RAMCloud::RecoverSegmentBenchmark rsb("2048", "10%", numSegments);
+            rsb.run(numSegments, dataLen[i], numThreads[j]);
+        }
     }
 
     return 0;
@@ -15,8 +15,10 @@
 
 #include "BackupClient.h"
 #include "CycleCounter.h"
+#include "LoadAwareBackupSelector.h"
 #include "Logger.h"
 #include "MinCopysetsBackupSelector.h"
+#include "RamCloud.h"
 #include "ShortMacros.h"
 #include "RawMetrics.h"
 #include "ReplicaManager.h"
@@ -39,11 +41,16 @@ namespace RAMCloud {
  * \param useMinCopysets
  *      Specifies whether to use the MinCopysets replication scheme or random
  *      replication.
+ * \param useLoadAwareBackupSelection
+ *      If true, backups are chosen with a LoadAwareBackupSelector, which
+ *      avoids backups that are slow to accept writes (while still obeying
+ *      \a useMinCopysets).
  */
 ReplicaManager::ReplicaManager(Context* context,
                                const ServerId* masterId,
                                uint32_t numReplicas,
-                               bool useMinCopysets)
+                               bool useMinCopysets,
+                               bool useLoadAwareBackupSelection)
     : context(context)
     , numReplicas(numReplicas)
     , backupSelector()
@@ -53,12 +60,24 @@ ReplicaManager::ReplicaManager(Context* context,
     , replicatedSegmentList()
     , taskQueue()
     , writeRpcsInFlight(0)
+    , writePolicy()
+    , compressor()
+    , compressionLevelRpc()
+    , compressionThreadsRpc()
+    , compressionLevelValue()
+    , compressionThreadsValue()
+    , nextCompressionOptionsPoll(Cycles::rdtsc() +
+            Cycles::fromSeconds(COMPRESSION_OPTIONS_POLL_SECONDS))
     , replicationEpoch()
     , failureMonitor(context, this)
     , replicationCounter()
     , useMinCopysets(useMinCopysets)
 {
-    if (useMinCopysets) {
+    if (useLoadAwareBackupSelection) {
+        backupSelector.reset(new LoadAwareBackupSelector(context, masterId,
+                                                         numReplicas,
+                                                         useMinCopysets));
+    } else if (useMinCopysets) {
         backupSelector.reset(new MinCopysetsBackupSelector(context, masterId,
                                                            numReplicas));
     } else {
@@ -363,6 +382,7 @@ ReplicaManager::proceed()
 {
     CycleCounter<RawMetric> _(&metrics->master.replicaManagerTicks);
     Lock __(dataMutex);
+    pollCompressionOptions(__);
     taskQueue.performTask();
     metrics->master.replicationTasks =
         std::max(metrics->master.replicationTasks.load(),
@@ -415,7 +435,10 @@ ReplicaManager::allocateSegment(const Lock& lock,
                                  writeRpcsInFlight, *replicationEpoch,
                                  dataMutex, segmentId, segment,
                                  isLogHead, *masterId, numReplicas,
-                                 &replicationCounter);
+                                 &replicationCounter,
+                                 ReplicatedSegment::
+                                    DEFAULT_MAX_BYTES_PER_WRITE_RPC,
+                                 &writePolicy, &compressor);
     replicatedSegmentList.push_back(*replicatedSegment);
 
     // ReplicatedSegment's constructor has scheduled the open.
@@ -423,6 +446,58 @@ ReplicaManager::allocateSegment(const Lock& lock,
     return replicatedSegment;
 }
 
+/**
+ * Keep #compressor's options in sync with the "replicationCompressionLevel"
+ * and "replicationCompressionThreads" RuntimeOptions on the coordinator.
+ * The options are fetched every COMPRESSION_OPTIONS_POLL_SECONDS without
+ * ever blocking; each call just checks on the outstanding rpcs, if any.
+ *
+ * \param lock
+ *      Caller must acquire a lock on #dataMutex before calling. Variable
+ *      is unused, but guarantees the caller at least thought about safety.
+ */
+void
+ReplicaManager::pollCompressionOptions(const Lock& lock)
+{
+    if (!compressionLevelRpc) {
+        if (Cycles::rdtsc() < nextCompressionOptionsPoll)
+            return;
+        compressionLevelRpc.reset(new GetRuntimeOptionRpc(context,
+            "replicationCompressionLevel", &compressionLevelValue));
+        compressionThreadsRpc.reset(new GetRuntimeOptionRpc(context,
+            "replicationCompressionThreads", &compressionThreadsValue));
+        return;
+    }
+
+    if (!compressionLevelRpc->isReady() || !compressionThreadsRpc->isReady())
+        return;
+
+    try {
+        compressionLevelRpc->wait();
+        compressionThreadsRpc->wait();
+        const char* level = static_cast<const char*>(
+            compressionLevelValue.getRange(
+                0, compressionLevelValue.getTotalLength()));
+        const char* numThreads = static_cast<const char*>(
+            compressionThreadsValue.getRange(
+                0, compressionThreadsValue.getTotalLength()));
+        if (level != NULL && numThreads != NULL) {
+            compressor.setOptions(
+                downCast<uint32_t>(strtoul(level, NULL, 10)),
+                downCast<uint32_t>(strtoul(numThreads, NULL, 10)));
+        }
+    } catch (const ClientException& e) {
+        // Most likely the coordinator doesn't know about these options;
+        // leave compression as it is.
+        LOG(DEBUG, "Couldn't fetch replica compression options from "
+            "coordinator: %s", e.what());
+    }
+    compressionLevelRpc.reset();
+    compressionThreadsRpc.reset();
+    nextCompressionOptionsPoll = Cycles::rdtsc() +
+        Cycles::fromSeconds(COMPRESSION_OPTIONS_POLL_SECONDS);
+}
+
 /**
  * Respond to a change in cluster configuration by scheduling any work that is
  * needed to restore durability guarantees. Keep in mind a context needs to be
@@ -26,12 +26,14 @@
 #include "CoordinatorClient.h"
 #include "UpdateReplicationEpochTask.h"
 #include "ReplicatedSegment.h"
+#include "SegmentCompressor.h"
 #include "ServerTracker.h"
 #include "TaskQueue.h"
 #include "Tub.h"
 
 namespace RAMCloud {
 
+class GetRuntimeOptionRpc;
 class Segment;
 
 /**
@@ -67,7 +69,8 @@ class ReplicaManager
     ReplicaManager(Context* context,
                    const ServerId* masterId,
                    uint32_t numReplicas,
-                   bool useMinCopysets);
+                   bool useMinCopysets,
+                   bool useLoadAwareBackupSelection = false);
     ~ReplicaManager();
 
     bool isIdle();
@@ -86,6 +89,13 @@ class ReplicaManager
     ReplicatedSegment* allocateSegment(const Lock& lock, uint64_t segmentId,
                                        const Segment* segment, bool isLogHead);
         __attribute__((warn_unused_result));
+    void pollCompressionOptions(const Lock& lock);
+
+    /**
+     * How often, in seconds, the compression RuntimeOptions are fetched from
+     * the coordinator. See pollCompressionOptions().
+     */
+    enum { COMPRESSION_OPTIONS_POLL_SECONDS = 5 };
 
     /// Shared RAMCloud information.
     Context* context;
@@ -161,6 +171,35 @@ class ReplicaManager
      */
     uint32_t writeRpcsInFlight;
 
+    /**
+     * Decides how much data ReplicatedSegments send in each write rpc based
+     * on measurements of earlier ones. Shared among ReplicatedSegments.
+     */
+    ReplicationWritePolicy writePolicy;
+
+    /**
+     * Compresses closed segments before their replicas are sent to backups,
+     * if the coordinator's "replicationCompressionLevel" RuntimeOption asks
+     * for it. Shared among ReplicatedSegments.
+     */
+    SegmentCompressor compressor;
+
+    /**
+     * Outstanding requests to the coordinator for the
+     * "replicationCompressionLevel" and "replicationCompressionThreads"
+     * RuntimeOptions, if any. See pollCompressionOptions().
+     */
+    std::unique_ptr<GetRuntimeOptionRpc> compressionLevelRpc;
+    std::unique_ptr<GetRuntimeOptionRpc> compressionThreadsRpc;
+
+    /// Responses to #compressionLevelRpc and #compressionThreadsRpc.
+    Buffer compressionLevelValue;
+    Buffer compressionThreadsValue;
+
+    /// Cycles::rdtsc() time after which the compression options should be
+    /// fetched from the coordinator again.
+    uint64_t nextCompressionOptionsPoll;
+
     /**
      * Provides access to the latest replicationEpoch acknowledged by the
      * coordinator for this server and allows easy, asynchronous updates
@@ -75,6 +75,14 @@ enum { OBEY_SAFETY_CONSTRAINTS = true };
  * \param maxBytesPerWriteRpc
  *      Maximum bytes to send in a single write rpc; can help latency of
  *      GetRecoveryDataRequests by unclogging backups a bit.
+ * \param writePolicy
+ *      Measures write rpcs and chooses how much data to send in each.
+ *      Shared among ReplicatedSegments. If NULL, every write rpc is
+ *      only limited by \a maxBytesPerWriteRpc.
+ * \param compressor
+ *      Compresses the segment for replicas that are sent compressed (see
+ *      shouldCompress()). Shared among ReplicatedSegments. If NULL,
+ *      replicas are always sent uncompressed.
  */
 ReplicatedSegment::ReplicatedSegment(Context* context,
                                      TaskQueue& taskQueue,
@@ -91,7 +99,9 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
                                      uint32_t numReplicas,
                                      Tub<CycleCounter<RawMetric>>*
                                                              replicationCounter,
-                                     uint32_t maxBytesPerWriteRpc)
+                                     uint32_t maxBytesPerWriteRpc,
+                                     ReplicationWritePolicy* writePolicy,
+                                     SegmentCompressor* compressor)
     : Task(taskQueue)
     , context(context)
     , backupSelector(backupSelector)
@@ -105,6 +115,9 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
     , masterId(masterId)
     , segmentId(segmentId)
     , maxBytesPerWriteRpc(maxBytesPerWriteRpc)
+    , writePolicy(writePolicy)
+    , compressor(compressor)
+    , compressionJob()
     , queued(true, 0, 0, false)
     , queuedCertificate()
     , openLen(0)
@@ -179,6 +192,8 @@ ReplicatedSegment::free()
         replica.writeRpc->cancel();
         replica.writeRpc.destroy();
         --writeRpcsInFlight;
+        backupSelector.signalWriteFinished(replica.backupId,
+                                           replica.writeRpcBytes, 0);
     }
 
     // Segment should free itself ASAP. It must not start new write rpcs after
@@ -299,8 +314,11 @@ ReplicatedSegment::handleBackupFailure(ServerId failedId, bool useMinCopysets)
             ++metrics->master.openReplicaRecoveries;
         }
 
-        if (replica.writeRpc)
+        if (replica.writeRpc) {
             --writeRpcsInFlight;
+            backupSelector.signalWriteFinished(replica.backupId,
+                                               replica.writeRpcBytes, 0);
+        }
         replica.failed();
         schedule();
         ++metrics->master.replicaRecoveries;
@@ -711,12 +729,24 @@ ReplicatedSegment::performWrite(Replica& replica)
     if (replica.writeRpc) {
         // This replica has a write request outstanding to a backup.
         if (replica.writeRpc->isReady()) {
+            // Let the backupSelector know how long the backup took, even
+            // if the rpc failed: slow failures are a sign of overload, too.
+            uint64_t latencyTicks =
+                Cycles::rdtsc() - replica.writeRpcStartTicks;
+            backupSelector.signalWriteFinished(replica.backupId,
+                                               replica.writeRpcBytes,
+                                               latencyTicks);
             // Wait for it to complete if it is ready.
             try {
                 replica.writeRpc->wait();
+                if (writePolicy != NULL) {
+                    writePolicy->recordWriteRpc(replica.writeRpcBytes,
+                                                latencyTicks);
+                }
                 TEST_LOG("Write RPC finished for replica slot %ld",
                          &replica - &replicas[0]);
                 replica.acked = replica.sent;
+                replica.imageBytesAcked = replica.imageBytesSent;
                 if (replica.acked == queued || replica.acked.bytes == openLen) {
                     // #committed advances whenever a certificate was sent.
                     // Which happens in two cases:
@@ -736,6 +766,7 @@ ReplicatedSegment::performWrite(Replica& replica)
                 // handleBackupFailure to reset the replica and break this
                 // loop.
                 replica.sent = replica.acked;
+                replica.imageBytesSent = replica.imageBytesAcked;
                 LOG(WARNING, "Couldn't write to backup %s; server is down",
                     replica.backupId.toString().c_str());
             } catch (const BackupOpenRejectedException& e) {
@@ -757,6 +788,7 @@ ReplicatedSegment::performWrite(Replica& replica)
                     "STATUS_CALLER_NOT_IN_CLUSTER",
                     replica.backupId.toString().c_str());
                 replica.sent = replica.acked;
+                replica.imageBytesSent = replica.imageBytesAcked;
                 CoordinatorClient::verifyMembership(context, masterId);
             }
             replica.writeRpc.destroy();
@@ -786,7 +818,7 @@ ReplicatedSegment::performWrite(Replica& replica)
                 return;
             }
             // No outstanding write, but not yet durably open.
-            if (writeRpcsInFlight == MAX_WRITE_RPCS_IN_FLIGHT) {
+            if (writeRpcsInFlight >= getMaxWriteRpcsInFlight()) {
                 schedule();
                 return;
             }
@@ -805,6 +837,9 @@ ReplicatedSegment::performWrite(Replica& replica)
                                        segment, 0, openLen, certificateToSend,
                                        true, false, replicaIsPrimary(replica));
             ++writeRpcsInFlight;
+            replica.writeRpcBytes = openLen;
+            replica.writeRpcStartTicks = Cycles::rdtsc();
+            backupSelector.signalWriteStarted(replica.backupId, openLen);
             if (LOG_RECOVERY_REPLICATION_RPC_TIMING && recoveryStart) {
                 LOG(DEBUG, "@%7lu: Replica <%s,%lu,%lu> write -> %7u+%7u "
                     "%u rpcs out OPEN",
@@ -837,18 +872,44 @@ ReplicatedSegment::performWrite(Replica& replica)
                 return;
             }
 
+            if (shouldCompress(replica)) {
+                // Closed segments are compressed in the background; the
+                // image is shared by all replicas of this segment.
+                if (!compressionJob) {
+                    compressionJob = compressor->compressAsync(segment,
+                                                               queued.bytes);
+                }
+                if (!compressionJob->done) {
+                    schedule();
+                    return;
+                }
+                // An empty image means compression didn't pay off.
+                replica.compressed = !compressionJob->image.empty();
+            }
+
+            // Compressed replicas are written from the start of the image
+            // rather than from where the opening write left off. Either way,
+            // the certificate always describes the uncompressed segment.
+            const uint8_t* image = NULL;
+            uint32_t totalBytes = queued.bytes;
             uint32_t offset = replica.sent.bytes;
-            uint32_t length = queued.bytes - offset;
+            if (replica.compressed) {
+                image = compressionJob->image.data();
+                totalBytes = downCast<uint32_t>(compressionJob->image.size());
+                offset = replica.imageBytesSent;
+            }
+            uint32_t length = totalBytes - offset;
             Segment::Certificate* certificateToSend = &queuedCertificate;
 
             // Breaks atomicity of log entries, but it could happen anyway
             // if a segment gets partially written to disk.
-            if (length > maxBytesPerWriteRpc) {
-                length = maxBytesPerWriteRpc;
+            uint32_t maxBytes = getMaxBytesPerWriteRpc();
+            if (length > maxBytes) {
+                length = maxBytes;
                 certificateToSend = NULL;
             }
 
-            bool sendClose = queued.close && (offset + length) == queued.bytes;
+            bool sendClose = queued.close && (offset + length) == totalBytes;
             if (OBEY_SAFETY_CONSTRAINTS &&
                 sendClose &&
                 followingSegment &&
@@ -865,7 +926,7 @@ ReplicatedSegment::performWrite(Replica& replica)
                 return;
             }
 
-            if (writeRpcsInFlight == MAX_WRITE_RPCS_IN_FLIGHT) {
+            if (writeRpcsInFlight >= getMaxWriteRpcsInFlight()) {
                 TEST_LOG("Cannot write segment %lu, too many writes "
                          "in flight", segmentId);
                 schedule();
@@ -876,11 +937,14 @@ ReplicatedSegment::performWrite(Replica& replica)
                      replica.backupId.toString().c_str());
             replica.writeRpc.construct(context, replica.backupId, masterId,
                                        segmentId, queued.epoch,
-                                       segment, offset, length,
+                                       image ? NULL : segment, offset, length,
                                        certificateToSend,
                                        false, sendClose,
-                                       replicaIsPrimary(replica));
+                                       replicaIsPrimary(replica), image);
             ++writeRpcsInFlight;
+            replica.writeRpcBytes = length;
+            replica.writeRpcStartTicks = Cycles::rdtsc();
+            backupSelector.signalWriteStarted(replica.backupId, length);
             if (LOG_RECOVERY_REPLICATION_RPC_TIMING && recoveryStart) {
                 LOG(DEBUG, "@%7lu: Replica <%s,%lu,%lu> write -> %7u+%7u "
                     "%u rpcs out %s",
@@ -889,7 +953,13 @@ ReplicatedSegment::performWrite(Replica& replica)
                     &replica - &replicas[0], offset, length,
                     writeRpcsInFlight, sendClose ? " CLOSE" : "");
             }
-            replica.sent.bytes += length;
+            if (replica.compressed) {
+                replica.imageBytesSent += length;
+                if (replica.imageBytesSent == totalBytes)
+                    replica.sent.bytes = queued.bytes;
+            } else {
+                replica.sent.bytes += length;
+            }
             replica.sent.epoch = queued.epoch;
             replica.sent.close = sendClose;
             schedule();
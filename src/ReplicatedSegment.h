@@ -25,6 +25,8 @@
 #include "CycleCounter.h"
 #include "UpdateReplicationEpochTask.h"
 #include "RawMetrics.h"
+#include "ReplicationWritePolicy.h"
+#include "SegmentCompressor.h"
 #include "Transport.h"
 #include "TaskQueue.h"
 #include "VarLenArray.h"
@@ -230,6 +232,11 @@ class ReplicatedSegment : public Task {
             , sent()
             , freeRpc()
             , writeRpc()
+            , writeRpcBytes(0)
+            , writeRpcStartTicks(0)
+            , compressed(false)
+            , imageBytesSent(0)
+            , imageBytesAcked(0)
             , replicateAtomically(false)
         {}
 
@@ -324,6 +331,29 @@ class ReplicatedSegment : public Task {
         /// The outstanding write operation to this backup, if any.
         Tub<WriteSegmentRpc> writeRpc;
 
+        /// Number of bytes of segment data carried by #writeRpc. Reported
+        /// to the BackupSelector when the rpc finishes.
+        uint32_t writeRpcBytes;
+
+        /// Cycles::rdtsc() when #writeRpc was sent; used to measure write
+        /// latency to the backup for the BackupSelector.
+        uint64_t writeRpcStartTicks;
+
+        /**
+         * Set if this replica is being written as a compressed image of the
+         * segment (see SegmentCompressor) rather than as a copy of it. The
+         * image is sent after the opening write, overwriting it, and #sent,
+         * #acked and #committed only move past the opening write once the
+         * whole image (and its certificate) has been sent.
+         */
+        bool compressed;
+
+        /// If #compressed, bytes of the image sent to the backup so far.
+        uint32_t imageBytesSent;
+
+        /// If #compressed, bytes of the image acknowledged by the backup.
+        uint32_t imageBytesAcked;
+
         // Fields below survive across failed()/start() calls.
 
         /**
@@ -369,6 +399,16 @@ class ReplicatedSegment : public Task {
      */
     enum { MAX_WRITE_RPCS_IN_FLIGHT = 8 };
 
+    /**
+     * Number of the MAX_WRITE_RPCS_IN_FLIGHT slots that only head segments
+     * may use. Keeps the log cleaner and recovery from delaying writes that
+     * clients are waiting on to become durable.
+     */
+    enum { HEAD_RESERVED_WRITE_RPCS = 2 };
+
+    /// Default hard limit on the number of bytes sent in a write rpc.
+    enum { DEFAULT_MAX_BYTES_PER_WRITE_RPC = 1024 * 1024 };
+
     ReplicatedSegment(Context* context,
                       TaskQueue& taskQueue,
                       BaseBackupSelector& backupSelector,
@@ -382,7 +422,10 @@ class ReplicatedSegment : public Task {
                       ServerId masterId,
                       uint32_t numReplicas,
                       Tub<CycleCounter<RawMetric>>* replicationCounter = NULL,
-                      uint32_t maxBytesPerWriteRpc = 1024 * 1024);
+                      uint32_t maxBytesPerWriteRpc =
+                                DEFAULT_MAX_BYTES_PER_WRITE_RPC,
+                      ReplicationWritePolicy* writePolicy = NULL,
+                      SegmentCompressor* compressor = NULL);
     ~ReplicatedSegment();
 
     void schedule();
@@ -407,6 +450,46 @@ class ReplicatedSegment : public Task {
         return p;
     }
 
+    /**
+     * Return the maximum number of bytes to send in the next write rpc
+     * for this segment. See ReplicationWritePolicy.
+     */
+    uint32_t getMaxBytesPerWriteRpc() const {
+        if (writePolicy == NULL)
+            return maxBytesPerWriteRpc;
+        return writePolicy->getMaxBytesPerWriteRpc(normalLogSegment,
+                                                   maxBytesPerWriteRpc);
+    }
+
+    /**
+     * Return the number of write rpcs that may be in flight across all
+     * ReplicatedSegments before this segment must wait to send another.
+     */
+    uint32_t getMaxWriteRpcsInFlight() const {
+        if (normalLogSegment)
+            return MAX_WRITE_RPCS_IN_FLIGHT;
+        return MAX_WRITE_RPCS_IN_FLIGHT - HEAD_RESERVED_WRITE_RPCS;
+    }
+
+    /**
+     * Return true if \a replica should be sent to its backup compressed,
+     * assuming the compressed image turns out to be smaller than the segment.
+     * Only replicas of closed segments that are never partially relied upon
+     * are compressed: those of segments written by the cleaner (which must be
+     * synced before they become part of the log) and those being recreated
+     * after a failure (which are replicated atomically). This keeps the
+     * overwrite of the opening write by the image harmless.
+     */
+    bool shouldCompress(const Replica& replica) const {
+        return compressor != NULL &&
+               compressor->getLevel() > 0 &&
+               !replica.compressed &&
+               replica.sent.bytes == openLen &&
+               queued.close &&
+               queued.bytes > openLen &&
+               (!normalLogSegment || replica.replicateAtomically);
+    }
+
     /// Return true if this replica should be considered the primary replica.
     bool replicaIsPrimary(Replica& replica) const {
         return &replica == &replicas[0];
@@ -485,10 +568,30 @@ class ReplicatedSegment : public Task {
      * Maximum number of bytes to send in any single write rpc
      * to backups. The idea is to avoid starving other rpcs to the
      * backup by not inundating it with segment-sized writes on
-     * recovery.
+     * recovery. #writePolicy may choose a smaller limit.
      */
     const uint32_t maxBytesPerWriteRpc;
 
+    /**
+     * Measures write rpcs and sizes them for this segment; shared among
+     * ReplicatedSegments. If NULL, write rpcs are only limited by
+     * #maxBytesPerWriteRpc.
+     */
+    ReplicationWritePolicy* writePolicy;
+
+    /**
+     * Compresses the segment for replicas that are sent compressed; shared
+     * among ReplicatedSegments. If NULL, replicas are never compressed.
+     */
+    SegmentCompressor* compressor;
+
+    /**
+     * The compressed image of the segment, once requested from #compressor.
+     * Shared by all replicas of the segment, and kept until the segment is
+     * freed since write rpcs refer directly to the image.
+     */
+    SegmentCompressor::JobRef compressionJob;
+
     /**
      * Tracks how much of a segment the log module has made available for
      * replication.
@@ -17,6 +17,7 @@
 
 #include "TestUtil.h"
 #include "BackupSelector.h"
+#include "Cycles.h"
 #include "Memory.h"
 #include "ReplicatedSegment.h"
 #include "Segment.h"
@@ -44,6 +45,8 @@ struct MockBackupSelector : public BaseBackupSelector {
     explicit MockBackupSelector(size_t count)
         : backups()
         , primaryFreed()
+        , bytesInFlight(0)
+        , writesFinished(0)
         , nextIndex(0)
     {
         makeSimpleHostList(count);
@@ -67,6 +70,16 @@ struct MockBackupSelector : public BaseBackupSelector {
         primaryFreed.push_back(backupId);
     }
 
+    void signalWriteStarted(const ServerId backupId, uint32_t bytes) {
+        bytesInFlight += bytes;
+    }
+
+    void signalWriteFinished(const ServerId backupId, uint32_t bytes,
+                             uint64_t latencyTicks) {
+        bytesInFlight -= bytes;
+        ++writesFinished;
+    }
+
     void makeSimpleHostList(size_t count) {
         for (uint32_t i = 0; i < count; ++i)
             backups.push_back(ServerId(i, 0));
@@ -74,6 +87,8 @@ struct MockBackupSelector : public BaseBackupSelector {
 
     std::vector<ServerId> backups;
     std::vector<ServerId> primaryFreed;
+    uint64_t bytesInFlight;
+    uint32_t writesFinished;
     size_t nextIndex;
 };
 
@@ -98,7 +113,8 @@ struct ReplicatedSegmentTest : public ::testing::Test {
         CreateSegment(ReplicatedSegmentTest* test,
                       ReplicatedSegment* precedingSegment,
                       uint64_t segmentId,
-                      uint32_t numReplicas)
+                      uint32_t numReplicas,
+                      bool normalLogSegment = true)
             : logSegment(test->data, DATA_LEN)
             , segment()
         {
@@ -115,7 +131,7 @@ struct ReplicatedSegmentTest : public ::testing::Test {
                                               test->dataMutex,
                                               segmentId,
                                               &logSegment,
-                                              true,
+                                              normalLogSegment,
                                               test->masterId,
                                               numReplicas,
                                               NULL,
@@ -1172,6 +1188,53 @@ TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlight) {
     EXPECT_EQ(0u, deleter.count);
 }
 
+TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlightBulkSegment) {
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+    reset();
+    CreateSegment bulk(this, NULL, segmentId + 1, numReplicas, false);
+    ReplicatedSegment* bulkSegment = bulk.segment.get();
+
+    // Bulk segments can't use the slots reserved for head segments.
+    writeRpcsInFlight = ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT -
+                        ReplicatedSegment::HEAD_RESERVED_WRITE_RPCS;
+    taskQueue.performTask();
+    EXPECT_FALSE(bulkSegment->replicas[0].sent.open);
+    EXPECT_TRUE(bulkSegment->isScheduled());
+
+    writeRpcsInFlight--;
+    taskQueue.performTask();
+    EXPECT_TRUE(bulkSegment->replicas[0].sent.open);
+    EXPECT_FALSE(bulkSegment->replicas[1].sent.open);
+    taskQueue.performTask(); // reap
+    taskQueue.performTask(); // second replica
+    taskQueue.performTask(); // reap
+    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT -
+              ReplicatedSegment::HEAD_RESERVED_WRITE_RPCS - 1,
+              writeRpcsInFlight);
+    bulkSegment->scheduled = false;
+    while (!taskQueue.isIdle())
+        taskQueue.tasks.pop();
+}
+
+TEST_F(ReplicatedSegmentTest, performWriteRecordsLatencyInWritePolicy) {
+    ReplicationWritePolicy policy;
+    segment->writePolicy = &policy;
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+
+    Cycles::mockCyclesPerSec = 1e09;
+    Cycles::mockTscValue = 1000;
+    taskQueue.performTask(); // send opens
+    Cycles::mockTscValue = 6000;
+    taskQueue.performTask(); // reap opens
+    Cycles::mockTscValue = 0;
+    Cycles::mockCyclesPerSec = 0;
+    EXPECT_EQ(5000u, policy.smallWriteLatencyNs);
+    EXPECT_EQ(MAX_BYTES_PER_WRITE, segment->getMaxBytesPerWriteRpc());
+    reset();
+}
+
 TEST_F(ReplicatedSegmentTest, performWriteOpen) {
     transport.setInput("0 0"); // write
     transport.setInput("0 0"); // write
@@ -1281,6 +1344,33 @@ TEST_F(ReplicatedSegmentTest, performWriteRpcIsReady) {
     reset();
 }
 
+TEST_F(ReplicatedSegmentTest, performWriteSignalsBackupSelector) {
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+
+    taskQueue.performTask(); // send opens
+    EXPECT_EQ(2 * openLen, backupSelector.bytesInFlight);
+    EXPECT_EQ(openLen, segment->replicas[0].writeRpcBytes);
+    EXPECT_NE(0u, segment->replicas[0].writeRpcStartTicks);
+    EXPECT_EQ(0u, backupSelector.writesFinished);
+
+    taskQueue.performTask(); // reap opens
+    EXPECT_EQ(0u, backupSelector.bytesInFlight);
+    EXPECT_EQ(2u, backupSelector.writesFinished);
+
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+    createSegment->logSegment.head = openLen + 10;
+    segment->close();
+    taskQueue.performTask(); // send writes
+    EXPECT_EQ(2u * 10, backupSelector.bytesInFlight);
+
+    segment->free(); // syncs the outstanding writes
+    EXPECT_EQ(0u, backupSelector.bytesInFlight);
+    EXPECT_EQ(4u, backupSelector.writesFinished);
+    reset();
+}
+
 TEST_F(ReplicatedSegmentTest, performWriteRpcFailed) {
     ServerIdRpcWrapper::ConvertExceptionsToDoesntExist _;
     transport.clearInput();
@@ -1476,6 +1566,51 @@ TEST_F(ReplicatedSegmentTest, performWriteClosedButLongerThanMaxTxLimit) {
     reset();
 }
 
+TEST_F(ReplicatedSegmentTest, performWriteCompressed) {
+    for (int i = 0; i < 8; ++i)
+        transport.setInput("0 0");
+    reset();
+    SegmentCompressor compressor;
+    compressor.setOptions(1, 1);
+    CreateSegment bulk(this, NULL, segmentId + 1, 1, false);
+    ReplicatedSegment* bulkSegment = bulk.segment.get();
+    bulkSegment->compressor = &compressor;
+    bulk.logSegment.head = DATA_LEN;
+    bulkSegment->close();
+
+    ReplicatedSegment::Replica& replica = bulkSegment->replicas[0];
+    uint64_t deadline = Cycles::rdtsc() + Cycles::fromSeconds(5);
+    while (!(replica.acked == bulkSegment->queued) &&
+           Cycles::rdtsc() < deadline) {
+        taskQueue.performTask();
+    }
+    ASSERT_TRUE(bulkSegment->compressionJob);
+    uint32_t imageBytes =
+        downCast<uint32_t>(bulkSegment->compressionJob->image.size());
+    EXPECT_LT(imageBytes, uint32_t(DATA_LEN));
+    EXPECT_TRUE(replica.compressed);
+    EXPECT_EQ(imageBytes, replica.imageBytesAcked);
+    EXPECT_EQ(uint32_t(DATA_LEN), replica.acked.bytes);
+    EXPECT_TRUE(replica.acked.close);
+
+    // The first write of the image starts over at the beginning of the
+    // replica and the last one carries the (uncompressed) certificate.
+    ASSERT_LE(3u, transport.output.size());
+    const WrReq* first = transport.output[1].second.getStart<WrReq>();
+    EXPECT_EQ(0u, first->offset);
+    EXPECT_TRUE(first->compressed);
+    EXPECT_FALSE(first->certificateIncluded);
+    const WrReq* last = transport.output.back().second.getStart<WrReq>();
+    EXPECT_EQ(imageBytes, last->offset + last->length);
+    EXPECT_TRUE(last->compressed);
+    EXPECT_TRUE(last->close);
+    Segment::Certificate certificate;
+    bulk.logSegment.getAppendedLength(&certificate);
+    EXPECT_EQ(certificate.segmentLength,
+              last->certificate.segmentLength);
+    EXPECT_EQ(certificate.checksum, last->certificate.checksum);
+}
+
 TEST_F(ReplicatedSegmentTest, performWriteEnsureNewHeadOpenAckedBeforeClose) {
     transport.setInput("0 0"); // write - segment open
     transport.setInput("0 0"); // write - segment open
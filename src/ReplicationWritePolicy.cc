@@ -0,0 +1,94 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Cycles.h"
+#include "ReplicationWritePolicy.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ReplicationWritePolicy with no measurements. Until write rpcs
+ * have been measured all segments use the hard limit passed to
+ * getMaxBytesPerWriteRpc().
+ */
+ReplicationWritePolicy::ReplicationWritePolicy()
+    : smallWriteLatencyNs(0)
+    , bytesPerNs(0)
+{
+}
+
+/**
+ * Return the maximum number of bytes a ReplicatedSegment should send in its
+ * next write rpc.
+ *
+ * \param normalLogSegment
+ *      True if the segment is a log head segment (see
+ *      ReplicatedSegment::normalLogSegment), false if it is written by the
+ *      log cleaner or during recovery.
+ * \param limit
+ *      Hard limit on the size of write rpcs for the segment; the value
+ *      returned never exceeds it.
+ */
+uint32_t
+ReplicationWritePolicy::getMaxBytesPerWriteRpc(bool normalLogSegment,
+                                               uint32_t limit) const
+{
+    if (normalLogSegment || smallWriteLatencyNs == 0 || bytesPerNs == 0)
+        return limit;
+
+    double bytes = bytesPerNs * static_cast<double>(smallWriteLatencyNs) *
+                   BULK_WRITE_LATENCY_FACTOR;
+    if (bytes < MIN_BULK_BYTES_PER_WRITE_RPC)
+        bytes = MIN_BULK_BYTES_PER_WRITE_RPC;
+    if (bytes > limit)
+        return limit;
+    return static_cast<uint32_t>(bytes);
+}
+
+/**
+ * Update the measurements with a successfully completed write rpc. Writes
+ * of at most SMALL_WRITE_BYTES update the fixed cost of a write; larger
+ * writes update the bandwidth estimate using the time they took beyond
+ * that fixed cost. Each new sample gets a weight of 1/8.
+ *
+ * \param bytes
+ *      Number of bytes of segment data carried by the rpc.
+ * \param latencyTicks
+ *      Time in Cycles::rdtsc() ticks between sending the rpc and noticing
+ *      its completion.
+ */
+void
+ReplicationWritePolicy::recordWriteRpc(uint32_t bytes, uint64_t latencyTicks)
+{
+    uint64_t latencyNs = Cycles::toNanoseconds(latencyTicks);
+    if (bytes <= SMALL_WRITE_BYTES) {
+        if (smallWriteLatencyNs == 0)
+            smallWriteLatencyNs = latencyNs;
+        else
+            smallWriteLatencyNs = (smallWriteLatencyNs * 7 + latencyNs) / 8;
+        return;
+    }
+
+    if (smallWriteLatencyNs == 0 || latencyNs <= smallWriteLatencyNs)
+        return;
+    double sample = static_cast<double>(bytes) /
+                    static_cast<double>(latencyNs - smallWriteLatencyNs);
+    if (bytesPerNs == 0)
+        bytesPerNs = sample;
+    else
+        bytesPerNs = (bytesPerNs * 7 + sample) / 8;
+}
+
+} // namespace RAMCloud
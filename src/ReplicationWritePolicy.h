@@ -0,0 +1,85 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_REPLICATIONWRITEPOLICY_H
+#define RAMCLOUD_REPLICATIONWRITEPOLICY_H
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * Decides how much segment data ReplicatedSegments send to backups in each
+ * write rpc, based on the latency and bandwidth observed for earlier write
+ * rpcs. Shared among all of the ReplicatedSegments of a ReplicaManager and
+ * protected by ReplicaManager::dataMutex.
+ *
+ * Head segments and bulk segments (those written by the log cleaner or by
+ * recovery through a SideLog) are treated differently. Log::sync() already
+ * batches the appends of all threads waiting to sync into a single
+ * ReplicatedSegment::sync(), and clients are waiting on each such batch, so
+ * head segments always send as much as the hard limit allows: splitting a
+ * batch only adds round trips, and every rpc without a certificate delays
+ * the commit of the whole batch. Bulk segments have no such waiters but can
+ * delay head segment writes queued behind them at the same backup, so their
+ * writes are sized to keep a backup busy for only a bounded multiple of the
+ * round trip time of a small write.
+ */
+class ReplicationWritePolicy {
+  PUBLIC:
+    ReplicationWritePolicy();
+    uint32_t getMaxBytesPerWriteRpc(bool normalLogSegment,
+                                    uint32_t limit) const;
+    void recordWriteRpc(uint32_t bytes, uint64_t latencyTicks);
+
+    /**
+     * Write rpcs carrying at most this many bytes are used to measure the
+     * fixed cost (mostly network and rpc overhead) of a write to a backup.
+     */
+    enum { SMALL_WRITE_BYTES = 4 * 1024 };
+
+    /**
+     * Bulk segment write rpcs are sized so that transferring their data
+     * takes about this many times as long as a small write rpc.
+     */
+    enum { BULK_WRITE_LATENCY_FACTOR = 16 };
+
+    /**
+     * Bulk segment write rpcs are never limited to fewer than this many
+     * bytes, so that they remain efficient even if measurements are noisy.
+     */
+    enum { MIN_BULK_BYTES_PER_WRITE_RPC = 64 * 1024 };
+
+  PRIVATE:
+    /**
+     * Exponentially weighted moving average of the latency of write rpcs
+     * of at most SMALL_WRITE_BYTES, in nanoseconds. 0 if no such rpc has
+     * completed yet.
+     */
+    uint64_t smallWriteLatencyNs;
+
+    /**
+     * Exponentially weighted moving average of the rate at which backups
+     * absorb data beyond the fixed cost of a write rpc, in bytes per
+     * nanosecond. 0 if not yet known.
+     */
+    double bytesPerNs;
+
+    DISALLOW_COPY_AND_ASSIGN(ReplicationWritePolicy);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_REPLICATIONWRITEPOLICY_H
@@ -0,0 +1,81 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "ReplicationWritePolicy.h"
+
+namespace RAMCloud {
+
+struct ReplicationWritePolicyTest : public ::testing::Test {
+    ReplicationWritePolicy policy;
+
+    ReplicationWritePolicyTest()
+        : policy()
+    {
+        // Make one tick one nanosecond.
+        Cycles::mockCyclesPerSec = 1e09;
+    }
+
+    ~ReplicationWritePolicyTest()
+    {
+        Cycles::mockCyclesPerSec = 0;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ReplicationWritePolicyTest);
+};
+
+TEST_F(ReplicationWritePolicyTest, getMaxBytesPerWriteRpc) {
+    // No measurements yet.
+    EXPECT_EQ(1000000u, policy.getMaxBytesPerWriteRpc(false, 1000000));
+
+    // 10 us per small write, 1 byte/ns beyond that: bulk writes should take
+    // 16 * 10 us to transfer.
+    policy.smallWriteLatencyNs = 10000;
+    policy.bytesPerNs = 1.0;
+    EXPECT_EQ(160000u, policy.getMaxBytesPerWriteRpc(false, 1000000));
+    EXPECT_EQ(100000u, policy.getMaxBytesPerWriteRpc(false, 100000));
+
+    // Head segments always use the hard limit.
+    EXPECT_EQ(1000000u, policy.getMaxBytesPerWriteRpc(true, 1000000));
+
+    // Bulk writes don't become too small.
+    policy.bytesPerNs = 0.01;
+    EXPECT_EQ(ReplicationWritePolicy::MIN_BULK_BYTES_PER_WRITE_RPC,
+              policy.getMaxBytesPerWriteRpc(false, 1000000));
+    EXPECT_EQ(1000u, policy.getMaxBytesPerWriteRpc(false, 1000));
+}
+
+TEST_F(ReplicationWritePolicyTest, recordWriteRpc) {
+    // Large writes are ignored until the fixed cost is known.
+    policy.recordWriteRpc(100000, 110000);
+    EXPECT_EQ(0, policy.bytesPerNs);
+
+    policy.recordWriteRpc(100, 8000);
+    EXPECT_EQ(8000u, policy.smallWriteLatencyNs);
+    policy.recordWriteRpc(4096, 16000);
+    EXPECT_EQ(9000u, policy.smallWriteLatencyNs);
+
+    policy.recordWriteRpc(100000, 109000);
+    EXPECT_DOUBLE_EQ(1.0, policy.bytesPerNs);
+    policy.recordWriteRpc(100000, 59000);
+    EXPECT_DOUBLE_EQ(1.125, policy.bytesPerNs);
+
+    // Large writes faster than small ones don't give a useful sample.
+    policy.recordWriteRpc(100000, 5000);
+    EXPECT_DOUBLE_EQ(1.125, policy.bytesPerNs);
+}
+
+} // namespace RAMCloud
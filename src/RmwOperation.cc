@@ -0,0 +1,297 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "RmwOperation.h"
+#include "ClientException.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an operation that adds 0 to the int64_t at the start of the
+ * value; that is, one that rewrites the object without changing it. One of
+ * the other methods is normally called to pick the real operation.
+ */
+RmwOperation::RmwOperation()
+    : op(ADD)
+    , fieldOffset(0)
+    , minValue(std::numeric_limits<int64_t>::min())
+    , maxValue(std::numeric_limits<int64_t>::max())
+    , operand(sizeof(int64_t), '\0')
+{
+}
+
+/**
+ * Construct an operation from its serialized form; used by masters.
+ *
+ * \param buffer
+ *      Buffer containing an operation created by serialize().
+ * \param offset
+ *      Offset of the operation within \a buffer.
+ * \param length
+ *      Size of the operation in bytes; return value from serialize().
+ *
+ * \throw MessageTooShortError
+ *      The buffer doesn't hold a complete operation.
+ * \throw RequestFormatError
+ *      The operation is malformed.
+ */
+RmwOperation::RmwOperation(Buffer& buffer, uint32_t offset, uint32_t length)
+    : op(ADD)
+    , fieldOffset(0)
+    , minValue(0)
+    , maxValue(0)
+    , operand()
+{
+    const WireFormat::RmwOperation* header =
+            buffer.getOffset<WireFormat::RmwOperation>(offset);
+    if (header == NULL || length < sizeof32(*header))
+        throw MessageTooShortError(HERE);
+    if (length != sizeof32(*header) + header->operandLength)
+        throw RequestFormatError(HERE);
+    if (header->op > BITWISE_AND)
+        throw RequestFormatError(HERE);
+
+    op = static_cast<Operator>(header->op);
+    fieldOffset = header->fieldOffset;
+    minValue = header->minValue;
+    maxValue = header->maxValue;
+
+    const char* data = static_cast<const char*>(
+            buffer.getRange(offset + sizeof32(*header),
+                            header->operandLength));
+    if (header->operandLength > 0 && data == NULL)
+        throw MessageTooShortError(HERE);
+    operand.assign(data, header->operandLength);
+
+    if ((op == ADD && operand.size() != sizeof(int64_t)) ||
+            (op == COMPARE_AND_SWAP && operand.size() % 2 != 0))
+        throw RequestFormatError(HERE);
+}
+
+/**
+ * Add a signed value to a 64-bit two's complement, little-endian integer
+ * stored in the object's value, provided the result stays within bounds.
+ *
+ * \param fieldOffset
+ *      Offset within the value of the integer.
+ * \param delta
+ *      Amount to add (may be negative).
+ * \param minValue
+ *      Smallest acceptable result; the operation fails with
+ *      STATUS_RMW_CONDITION_FAILED if the result would be smaller, which
+ *      makes it easy to implement counters that never go negative.
+ * \param maxValue
+ *      Largest acceptable result. Overflow always fails.
+ */
+void
+RmwOperation::add(uint32_t fieldOffset, int64_t delta,
+                  int64_t minValue, int64_t maxValue)
+{
+    setOperand(ADD, fieldOffset, &delta, sizeof32(delta));
+    this->minValue = minValue;
+    this->maxValue = maxValue;
+}
+
+/**
+ * Replace bytes of the object's value only if they currently hold a given
+ * value; otherwise the operation fails with STATUS_RMW_CONDITION_FAILED.
+ *
+ * \param fieldOffset
+ *      Offset within the value of the bytes to compare.
+ * \param expected
+ *      The bytes the field must contain.
+ * \param newBytes
+ *      The bytes to store in the field.
+ * \param length
+ *      Size of the field, \a expected, and \a newBytes.
+ */
+void
+RmwOperation::compareAndSwap(uint32_t fieldOffset, const void* expected,
+                             const void* newBytes, uint32_t length)
+{
+    setOperand(COMPARE_AND_SWAP, fieldOffset, expected, length);
+    operand.append(static_cast<const char*>(newBytes), length);
+}
+
+/**
+ * Append bytes to the end of the object's value.
+ *
+ * \param data
+ *      The bytes to append.
+ * \param length
+ *      Size of \a data.
+ */
+void
+RmwOperation::append(const void* data, uint32_t length)
+{
+    setOperand(APPEND_BYTES, 0, data, length);
+}
+
+/**
+ * Set bits in the object's value.
+ *
+ * \param fieldOffset
+ *      Offset within the value of the bytes to modify.
+ * \param mask
+ *      Bytes to OR into the field.
+ * \param length
+ *      Size of \a mask.
+ */
+void
+RmwOperation::bitwiseOr(uint32_t fieldOffset, const void* mask,
+                        uint32_t length)
+{
+    setOperand(BITWISE_OR, fieldOffset, mask, length);
+}
+
+/**
+ * Clear bits in the object's value.
+ *
+ * \param fieldOffset
+ *      Offset within the value of the bytes to modify.
+ * \param mask
+ *      Bytes to AND into the field.
+ * \param length
+ *      Size of \a mask.
+ */
+void
+RmwOperation::bitwiseAnd(uint32_t fieldOffset, const void* mask,
+                         uint32_t length)
+{
+    setOperand(BITWISE_AND, fieldOffset, mask, length);
+}
+
+/**
+ * Append the operation to an RPC request in the format masters expect.
+ *
+ * \param buffer
+ *      The operation is appended here.
+ * \return
+ *      The number of bytes appended.
+ */
+uint32_t
+RmwOperation::serialize(Buffer& buffer) const
+{
+    WireFormat::RmwOperation* header =
+            new(&buffer, APPEND) WireFormat::RmwOperation();
+    header->op = downCast<uint8_t>(op);
+    header->fieldOffset = fieldOffset;
+    header->minValue = minValue;
+    header->maxValue = maxValue;
+    header->operandLength = downCast<uint32_t>(operand.size());
+    buffer.appendCopy(operand.data(), header->operandLength);
+    return sizeof32(*header) + header->operandLength;
+}
+
+/**
+ * Compute the new value of an object from its current one.
+ *
+ * \param buffer
+ *      Buffer containing the object's current value.
+ * \param valueOffset
+ *      Offset of the value within \a buffer.
+ * \param valueLength
+ *      Size of the value in bytes.
+ * \param[out] newValue
+ *      If the operation succeeds, the new value is appended here. Unmodified
+ *      parts of the value refer to the memory of \a buffer, so it must
+ *      outlive \a newValue.
+ * \return
+ *      STATUS_OK if the new value was computed, STATUS_INVALID_OBJECT if
+ *      the operation's field doesn't lie within the value, or
+ *      STATUS_RMW_CONDITION_FAILED if the operation's condition didn't hold.
+ */
+Status
+RmwOperation::apply(Buffer& buffer, uint32_t valueOffset, uint32_t valueLength,
+                    Buffer& newValue) const
+{
+    if (op == APPEND_BYTES) {
+        Buffer::Chunk::appendToBuffer(&newValue, &buffer, valueOffset,
+                                      valueLength);
+        newValue.appendCopy(operand.data(),
+                            downCast<uint32_t>(operand.size()));
+        return STATUS_OK;
+    }
+
+    uint32_t fieldLength = downCast<uint32_t>(operand.size());
+    if (op == COMPARE_AND_SWAP)
+        fieldLength /= 2;
+    if (fieldOffset > valueLength || fieldLength > valueLength - fieldOffset)
+        return STATUS_INVALID_OBJECT;
+
+    string field(fieldLength, '\0');
+    buffer.copy(valueOffset + fieldOffset, fieldLength, &field[0]);
+
+    switch (op) {
+        case ADD: {
+            int64_t oldValue;
+            int64_t delta;
+            memcpy(&oldValue, field.data(), sizeof(oldValue));
+            memcpy(&delta, operand.data(), sizeof(delta));
+
+            // Add as unsigned so that overflow is well-defined, then
+            // detect it from the sign of the change.
+            int64_t result = static_cast<int64_t>(
+                    static_cast<uint64_t>(oldValue) +
+                    static_cast<uint64_t>(delta));
+            if ((delta < 0) != (result < oldValue) ||
+                    result < minValue || result > maxValue)
+                return STATUS_RMW_CONDITION_FAILED;
+            memcpy(&field[0], &result, sizeof(result));
+            break;
+        }
+        case COMPARE_AND_SWAP:
+            if (operand.compare(0, fieldLength, field) != 0)
+                return STATUS_RMW_CONDITION_FAILED;
+            field.assign(operand, fieldLength, fieldLength);
+            break;
+        case BITWISE_OR:
+            for (uint32_t i = 0; i < fieldLength; i++)
+                field[i] = static_cast<char>(field[i] | operand[i]);
+            break;
+        case BITWISE_AND:
+            for (uint32_t i = 0; i < fieldLength; i++)
+                field[i] = static_cast<char>(field[i] & operand[i]);
+            break;
+        case APPEND_BYTES:
+            break;
+    }
+
+    uint32_t suffixOffset = fieldOffset + fieldLength;
+    Buffer::Chunk::appendToBuffer(&newValue, &buffer, valueOffset,
+                                  fieldOffset);
+    newValue.appendCopy(field.data(), fieldLength);
+    Buffer::Chunk::appendToBuffer(&newValue, &buffer,
+                                  valueOffset + suffixOffset,
+                                  valueLength - suffixOffset);
+    return STATUS_OK;
+}
+
+/**
+ * Helper for the methods that pick an operation.
+ */
+void
+RmwOperation::setOperand(Operator op, uint32_t fieldOffset,
+                         const void* operand, uint32_t length)
+{
+    this->op = op;
+    this->fieldOffset = fieldOffset;
+    this->operand.assign(static_cast<const char*>(operand), length);
+    minValue = std::numeric_limits<int64_t>::min();
+    maxValue = std::numeric_limits<int64_t>::max();
+}
+
+} // namespace RAMCloud
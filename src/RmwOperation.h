@@ -0,0 +1,93 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RMWOPERATION_H
+#define RAMCLOUD_RMWOPERATION_H
+
+#include <limits>
+
+#include "Buffer.h"
+#include "Status.h"
+
+namespace RAMCloud {
+
+/**
+ * Describes how a readModifyWrite request should compute an object's new
+ * value from its current one. Masters apply the operation while holding
+ * the lock for the object's hash table bucket, so the read and the write
+ * are atomic with respect to every other update of the object, and
+ * clients don't need to loop on conditional writes to update hot objects.
+ *
+ * Only a small fixed set of operators is supported; each applies to the
+ * object's value (never its keys). Clients build an operation and pass it
+ * along with the request, which carries it in the format defined by
+ * WireFormat::RmwOperation; masters parse it back out and call apply().
+ */
+class RmwOperation {
+  public:
+    /// The supported operators. Values are part of the wire format.
+    enum Operator {
+        /// Add #operand, an int64_t, to the int64_t at #fieldOffset. Fails
+        /// if the result would fall outside [#minValue, #maxValue].
+        ADD = 0,
+        /// #operand holds an expected and a new byte string of equal
+        /// length. If the bytes at #fieldOffset equal the expected ones,
+        /// they are replaced by the new ones; otherwise the operation fails.
+        COMPARE_AND_SWAP = 1,
+        /// Append #operand to the end of the value.
+        APPEND_BYTES = 2,
+        /// OR #operand into the bytes at #fieldOffset.
+        BITWISE_OR = 3,
+        /// AND #operand into the bytes at #fieldOffset.
+        BITWISE_AND = 4,
+    };
+
+    RmwOperation();
+    RmwOperation(Buffer& buffer, uint32_t offset, uint32_t length);
+    void add(uint32_t fieldOffset, int64_t delta,
+             int64_t minValue = std::numeric_limits<int64_t>::min(),
+             int64_t maxValue = std::numeric_limits<int64_t>::max());
+    void compareAndSwap(uint32_t fieldOffset, const void* expected,
+                        const void* newBytes, uint32_t length);
+    void append(const void* data, uint32_t length);
+    void bitwiseOr(uint32_t fieldOffset, const void* mask, uint32_t length);
+    void bitwiseAnd(uint32_t fieldOffset, const void* mask, uint32_t length);
+    uint32_t serialize(Buffer& buffer) const;
+
+    Status apply(Buffer& buffer, uint32_t valueOffset, uint32_t valueLength,
+                 Buffer& newValue) const;
+
+  PRIVATE:
+    void setOperand(Operator op, uint32_t fieldOffset, const void* operand,
+                    uint32_t length);
+
+    /// How the new value is computed.
+    Operator op;
+
+    /// Offset within the value of the bytes the operator applies to;
+    /// unused for APPEND_BYTES.
+    uint32_t fieldOffset;
+
+    /// Bounds on the result of ADD; unused otherwise.
+    int64_t minValue;
+    int64_t maxValue;
+
+    /// Argument to the operator; its interpretation depends on #op.
+    string operand;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_RMWOPERATION_H
@@ -0,0 +1,165 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ClientException.h"
+#include "RmwOperation.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Unit tests for RmwOperation.
+ */
+class RmwOperationTest : public ::testing::Test {
+  public:
+    Buffer newValue;
+
+    RmwOperationTest()
+        : newValue()
+    {
+    }
+
+    /// Applies an operation to a value given as a string, and returns the
+    /// new value (or the status, if the operation fails).
+    string
+    apply(RmwOperation& operation, const char* value)
+    {
+        // The value is preceded by junk, to make sure apply() honors
+        // valueOffset.
+        Buffer buffer;
+        buffer.appendCopy("junk", 4);
+        buffer.appendCopy(value, downCast<uint32_t>(strlen(value)));
+        newValue.reset();
+        Status status = operation.apply(buffer, 4,
+                buffer.getTotalLength() - 4, newValue);
+        if (status != STATUS_OK)
+            return statusToSymbol(status);
+        return TestUtil::toString(&newValue);
+    }
+
+    /// Applies an ADD to an integer value and returns the result (or the
+    /// status, if the operation fails).
+    string
+    add(int64_t value, int64_t delta,
+        int64_t minValue = std::numeric_limits<int64_t>::min(),
+        int64_t maxValue = std::numeric_limits<int64_t>::max())
+    {
+        RmwOperation operation;
+        operation.add(0, delta, minValue, maxValue);
+        Buffer buffer;
+        buffer.appendCopy(&value);
+        newValue.reset();
+        Status status = operation.apply(buffer, 0, 8, newValue);
+        if (status != STATUS_OK)
+            return statusToSymbol(status);
+        int64_t result;
+        newValue.copy(0, 8, &result);
+        return format("%ld", result);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RmwOperationTest);
+};
+
+TEST_F(RmwOperationTest, constructor_default) {
+    RmwOperation operation;
+    EXPECT_EQ("abcdefgh", apply(operation, "abcdefgh"));
+}
+
+TEST_F(RmwOperationTest, constructor_deserialize) {
+    RmwOperation operation;
+    operation.compareAndSwap(3, "ab", "cd", 2);
+
+    Buffer buffer;
+    buffer.appendCopy("xx", 2);
+    uint32_t length = operation.serialize(buffer);
+    EXPECT_EQ(sizeof32(WireFormat::RmwOperation) + 4, length);
+    EXPECT_EQ(length + 2, buffer.getTotalLength());
+
+    RmwOperation copy(buffer, 2, length);
+    EXPECT_EQ(RmwOperation::COMPARE_AND_SWAP, copy.op);
+    EXPECT_EQ(3U, copy.fieldOffset);
+    EXPECT_EQ("abcd", copy.operand);
+}
+
+TEST_F(RmwOperationTest, constructor_deserializeMalformed) {
+    RmwOperation operation;
+    operation.append("abc", 3);
+    Buffer buffer;
+    uint32_t length = operation.serialize(buffer);
+
+    EXPECT_THROW(RmwOperation(buffer, 0, 4), MessageTooShortError);
+    EXPECT_THROW(RmwOperation(buffer, 0, length - 1), RequestFormatError);
+
+    WireFormat::RmwOperation badOperator = {5, 0, 0, 0, 0};
+    Buffer badBuffer;
+    badBuffer.appendCopy(&badOperator);
+    EXPECT_THROW(RmwOperation(badBuffer, 0, sizeof32(badOperator)),
+                 RequestFormatError);
+
+    // An ADD needs an 8-byte operand.
+    WireFormat::RmwOperation badAdd = {0, 0, 0, 0, 1};
+    badBuffer.reset();
+    badBuffer.appendCopy(&badAdd);
+    badBuffer.appendCopy("x", 1);
+    EXPECT_THROW(RmwOperation(badBuffer, 0, sizeof32(badAdd) + 1),
+                 RequestFormatError);
+}
+
+TEST_F(RmwOperationTest, apply_add) {
+    EXPECT_EQ("21", add(16, 5));
+    EXPECT_EQ("-16", add(16, -32));
+    EXPECT_EQ("0", add(1, -1, 0));
+    EXPECT_EQ("STATUS_RMW_CONDITION_FAILED", add(0, -1, 0));
+    EXPECT_EQ("STATUS_RMW_CONDITION_FAILED", add(9, 2, 0, 10));
+    EXPECT_EQ("STATUS_RMW_CONDITION_FAILED",
+              add(std::numeric_limits<int64_t>::max(), 1));
+    EXPECT_EQ("STATUS_RMW_CONDITION_FAILED",
+              add(std::numeric_limits<int64_t>::min(), -1));
+}
+
+TEST_F(RmwOperationTest, apply_addField) {
+    RmwOperation operation;
+    int64_t one = 0x0101010101010101;
+    operation.add(2, one);
+    EXPECT_EQ("abcdefghijkl", apply(operation, "abbcdefghikl"));
+    EXPECT_EQ("STATUS_INVALID_OBJECT", apply(operation, "abcdefghi"));
+}
+
+TEST_F(RmwOperationTest, apply_compareAndSwap) {
+    RmwOperation operation;
+    operation.compareAndSwap(2, "cd", "xy", 2);
+    EXPECT_EQ("abxyef", apply(operation, "abcdef"));
+    EXPECT_EQ("STATUS_RMW_CONDITION_FAILED", apply(operation, "abcxef"));
+    EXPECT_EQ("STATUS_INVALID_OBJECT", apply(operation, "abc"));
+}
+
+TEST_F(RmwOperationTest, apply_append) {
+    RmwOperation operation;
+    operation.append("xyz", 3);
+    EXPECT_EQ("abcxyz", apply(operation, "abc"));
+    EXPECT_EQ("xyz", apply(operation, ""));
+}
+
+TEST_F(RmwOperationTest, apply_bitwise) {
+    RmwOperation operation;
+    operation.bitwiseOr(1, "\x20\x20", 2);
+    EXPECT_EQ("AbcD", apply(operation, "ABCD"));
+    operation.bitwiseAnd(0, "\xdf", 1);
+    EXPECT_EQ("Abcd", apply(operation, "abcd"));
+    EXPECT_EQ("STATUS_INVALID_OBJECT", apply(operation, ""));
+}
+
+}  // namespace RAMCloud
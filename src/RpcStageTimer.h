@@ -0,0 +1,97 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RPCSTAGETIMER_H
+#define RAMCLOUD_RPCSTAGETIMER_H
+
+#include "Common.h"
+#include "Cycles.h"
+
+namespace RAMCloud {
+
+/**
+ * Measures the time a worker thread spends in a stage of executing an RPC
+ * that happens below the service layer, such as looking up objects or
+ * waiting for replication, where the Transport::ServerRpc isn't at hand.
+ * Construct one of these on the stack around the code to be timed; the
+ * elapsed time is added to a thread-local total for the stage when it is
+ * destroyed. ServiceManager clears the totals before a worker starts each
+ * RPC and copies them into the RPC's Transport::ServerRpc::StageTimes
+ * once its reply is ready.
+ *
+ * Timing costs two rdtsc instructions and no locks or shared cache lines,
+ * so it is always enabled. Time spent outside of worker threads (for
+ * example, in unit tests) accumulates harmlessly and is never reported.
+ */
+class RpcStageTimer {
+  public:
+    /// Stages that can be timed with this class.
+    enum Stage {
+        /// Finding an object in ObjectManager's hash table and log.
+        LOOKUP,
+        /// Waiting in ObjectManager::syncChanges for log entries to be
+        /// replicated to backups.
+        SYNC,
+        NUM_STAGES
+    };
+
+    explicit RpcStageTimer(Stage stage)
+        : stage(stage)
+        , start(Cycles::rdtsc())
+    {
+    }
+
+    ~RpcStageTimer()
+    {
+        cycles[stage] += Cycles::rdtsc() - start;
+    }
+
+    /**
+     * Return the total time, in Cycles::rdtsc() ticks, the calling thread
+     * has spent in the given stage since the last call to reset().
+     */
+    static uint64_t
+    get(Stage stage)
+    {
+        return cycles[stage];
+    }
+
+    /**
+     * Zero the calling thread's totals for all stages.
+     */
+    static void
+    reset()
+    {
+        for (int i = 0; i < NUM_STAGES; i++)
+            cycles[i] = 0;
+    }
+
+  PRIVATE:
+    /// The stage being timed.
+    Stage stage;
+
+    /// Cycles::rdtsc() time when this object was constructed.
+    uint64_t start;
+
+    /// Time each thread has spent in each stage since it last called
+    /// reset(). Defined in ServiceManager.cc.
+    static __thread uint64_t cycles[NUM_STAGES];
+
+    DISALLOW_COPY_AND_ASSIGN(RpcStageTimer);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_RPCSTAGETIMER_H
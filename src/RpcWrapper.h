@@ -19,6 +19,7 @@
 #include "Dispatch.h"
 #include "Fence.h"
 #include "ServerId.h"
+#include "SlabAllocator.h"
 #include "Transport.h"
 #include "WireFormat.h"
 
@@ -63,6 +64,40 @@ class RpcWrapper : public Transport::RpcNotifier {
     virtual void failed();
     bool isReady();
 
+    /**
+     * Wrappers that outlive the stack frame that creates them (such as
+     * the asynchronous RPCs kept by SessionAlarm and in multi-operation
+     * tables) are allocated and freed at RPC rates, so they come from the
+     * SlabAllocator rather than malloc.
+     */
+    static void*
+    operator new(size_t size)
+    {
+        return SlabAllocator::alloc(size);
+    }
+
+    /// Placement form (used by Tub), which the one above would hide.
+    static void*
+    operator new(size_t size, void* p)
+    {
+        return p;
+    }
+
+    /**
+     * The size is that of the most-derived class, since the destructor is
+     * virtual.
+     */
+    static void
+    operator delete(void* p, size_t size)
+    {
+        SlabAllocator::free(p, size);
+    }
+
+    static void
+    operator delete(void* p, void* place)
+    {
+    }
+
   PROTECTED:
     /// Possible states for an RPC.
     enum RpcState {
@@ -69,6 +69,33 @@ struct Parser<std::queue<T>> : public RuntimeOptions::Parseable {
 
 };
 
+/**
+ * Specialization which parses a single unsigned integer. Strings that
+ * don't start with a number leave the field unchanged.
+ */
+template <>
+struct Parser<uint32_t> : public RuntimeOptions::Parseable {
+    explicit Parser(uint32_t& target)
+        : target(target)
+    {}
+
+    void
+    parse(const char* value)
+    {
+        std::istringstream iss(value);
+        uint32_t parsed;
+        if (iss >> parsed)
+            target = parsed;
+    }
+    std::string
+    getValue()
+    {
+        return format("%u", target);
+    }
+    // target holds the parsed value for the option.
+    uint32_t& target;
+};
+
 /**
  * Parser for coordinator crash point run time options.
  * An option is just a string in this case and currently,
@@ -130,9 +157,25 @@ RuntimeOptions::RuntimeOptions()
     , mutex()
     , failRecoveryMasters()
     , crashCoordinator()
+    , replicationCompressionLevel(0)
+    , replicationCompressionThreads(1)
+    , tabletBalancerMode(0)
+    , tabletBalancerIntervalSeconds(60)
+    , tabletBalancerMaxMoves(2)
+    , tabletBalancerMaxMoveMegabytes(1024)
+    , tabletBalancerSkewPercent(150)
+    , tabletBalancerMinOperations(10000)
 {
 #define REGISTER(field) registerOption(#field, newParser(field))
     REGISTER(failRecoveryMasters);
+    REGISTER(replicationCompressionLevel);
+    REGISTER(replicationCompressionThreads);
+    REGISTER(tabletBalancerMode);
+    REGISTER(tabletBalancerIntervalSeconds);
+    REGISTER(tabletBalancerMaxMoves);
+    REGISTER(tabletBalancerMaxMoveMegabytes);
+    REGISTER(tabletBalancerSkewPercent);
+    REGISTER(tabletBalancerMinOperations);
 #undef REGISTER
     registerOption("crashCoordinator",
             newcrashCoordParser(crashCoordinator));
@@ -218,6 +261,25 @@ RuntimeOptions::checkAndCrashCoordinator(const char *crashPoint)
     }
 }
 
+/**
+ * Return the current values of all the options that control the
+ * TabletBalancer, read atomically so that a round of balancing never sees
+ * a mix of old and new settings.
+ */
+RuntimeOptions::TabletBalancerOptions
+RuntimeOptions::getTabletBalancerOptions()
+{
+    Lock _(mutex);
+    TabletBalancerOptions options;
+    options.mode = tabletBalancerMode;
+    options.intervalSeconds = tabletBalancerIntervalSeconds;
+    options.maxMoves = tabletBalancerMaxMoves;
+    options.maxMoveMegabytes = tabletBalancerMaxMoveMegabytes;
+    options.skewPercent = tabletBalancerSkewPercent;
+    options.minOperations = tabletBalancerMinOperations;
+    return options;
+}
+
 // - private -
 
 /**
@@ -46,6 +46,20 @@ class RuntimeOptions {
         uint32_t popFailRecoveryMasters();
         void checkAndCrashCoordinator(const char *crashPoint);
 
+        /**
+         * Consistent snapshot of the runtime options that control the
+         * TabletBalancer; see the fields of the same names below.
+         */
+        struct TabletBalancerOptions {
+            uint32_t mode;
+            uint32_t intervalSeconds;
+            uint32_t maxMoves;
+            uint32_t maxMoveMegabytes;
+            uint32_t skewPercent;
+            uint32_t minOperations;
+        };
+        TabletBalancerOptions getTabletBalancerOptions();
+
     PRIVATE:
         /**
          * Interface for all configuration option parsers. Generally
@@ -94,6 +108,58 @@ class RuntimeOptions {
          */
         std::string crashCoordinator;
 
+        /**
+         * zlib compression level (1-9) masters use for replicas of closed
+         * segments they send to backups, or 0 to send them uncompressed.
+         * Masters poll the coordinator for this value, so changes take a
+         * few seconds to take effect. See SegmentCompressor.
+         */
+        uint32_t replicationCompressionLevel;
+
+        /**
+         * Number of threads each master dedicates to compressing replicas
+         * when #replicationCompressionLevel is nonzero.
+         */
+        uint32_t replicationCompressionThreads;
+
+        /**
+         * Determines what the TabletBalancer does with the splits and
+         * migrations it plans: 0 means the balancer is off, 1 means the
+         * plan is only logged (dry run), and 2 means it is carried out.
+         */
+        uint32_t tabletBalancerMode;
+
+        /**
+         * Seconds between rounds of the TabletBalancer. Load is measured as
+         * the number of reads and writes each tablet served since the
+         * previous round.
+         */
+        uint32_t tabletBalancerIntervalSeconds;
+
+        /**
+         * Maximum number of splits and migrations the TabletBalancer plans
+         * in one round.
+         */
+        uint32_t tabletBalancerMaxMoves;
+
+        /**
+         * Maximum number of megabytes of data (estimated from TableStats)
+         * the TabletBalancer migrates in one round.
+         */
+        uint32_t tabletBalancerMaxMoveMegabytes;
+
+        /**
+         * A master is considered overloaded if its load is at least this
+         * percentage of the average load across all masters.
+         */
+        uint32_t tabletBalancerSkewPercent;
+
+        /**
+         * The TabletBalancer leaves the cluster alone during rounds in which
+         * the masters served fewer than this many reads and writes in total.
+         */
+        uint32_t tabletBalancerMinOperations;
+
     DISALLOW_COPY_AND_ASSIGN(RuntimeOptions);
 };
 
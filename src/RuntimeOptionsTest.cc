@@ -47,6 +47,17 @@ TEST_F(RuntimeOptionsTest, set) {
     ASSERT_EQ(1u, options.failRecoveryMasters.size());
 }
 
+TEST_F(RuntimeOptionsTest, set_uint32) {
+    EXPECT_EQ(0u, options.replicationCompressionLevel);
+    options.set("replicationCompressionLevel", "6");
+    EXPECT_EQ(6u, options.replicationCompressionLevel);
+    options.set("replicationCompressionLevel", "foo");
+    EXPECT_EQ(6u, options.replicationCompressionLevel);
+    options.set("replicationCompressionThreads", "4 5");
+    EXPECT_EQ(4u, options.replicationCompressionThreads);
+    EXPECT_STREQ("4", options.get("replicationCompressionThreads").c_str());
+}
+
 TEST_F(RuntimeOptionsTest, get){
     options.set("failRecoveryMasters", "1 2 3");
     ASSERT_EQ(3u, options.failRecoveryMasters.size());
@@ -70,5 +81,17 @@ TEST_F(RuntimeOptionsTest, popFailRecoveryMasters) {
     EXPECT_EQ(0u, options.popFailRecoveryMasters());
 }
 
+TEST_F(RuntimeOptionsTest, getTabletBalancerOptions) {
+    options.set("tabletBalancerMode", "1");
+    options.set("tabletBalancerSkewPercent", "200");
+    RuntimeOptions::TabletBalancerOptions balancer =
+            options.getTabletBalancerOptions();
+    EXPECT_EQ(1u, balancer.mode);
+    EXPECT_EQ(60u, balancer.intervalSeconds);
+    EXPECT_EQ(2u, balancer.maxMoves);
+    EXPECT_EQ(1024u, balancer.maxMoveMegabytes);
+    EXPECT_EQ(200u, balancer.skewPercent);
+    EXPECT_EQ(10000u, balancer.minOperations);
+}
 
 }  // namespace RAMCloud
@@ -15,6 +15,7 @@
 
 #include "Common.h"
 #include "BitOps.h"
+#include "CompressedSegment.h"
 #include "Crc32C.h"
 #include "CycleCounter.h"
 #include "Segment.h"
@@ -44,7 +45,8 @@ Segment::Segment()
       closed(false),
       mustFreeBlocks(true),
       head(0),
-      checksum()
+      checksum(),
+      compressed(NULL)
 {
     segletBlocks.push_back(new uint8_t[segletSize]);
 }
@@ -60,7 +62,8 @@ Segment::Segment(const vector<Seglet*>& allocatedSeglets, uint32_t segletSize)
       closed(false),
       mustFreeBlocks(false),
       head(0),
-      checksum()
+      checksum(),
+      compressed(NULL)
 {
     assert(BitOps::isPowerOfTwo(segletSize));
 
@@ -95,7 +98,8 @@ Segment::Segment(const void* buffer, uint32_t length)
       closed(true),
       mustFreeBlocks(false),
       head(length),
-      checksum()
+      checksum(),
+      compressed(NULL)
 {
     // We promise not to scribble on it, honest!
     segletBlocks.push_back(const_cast<void*>(buffer));
@@ -106,6 +110,9 @@ Segment::Segment(const void* buffer, uint32_t length)
  */
 Segment::~Segment()
 {
+    // The compressed segment owns the seglets, if any.
+    delete compressed;
+
     // Check if the 0-argument constructor dynamically allocated space we need
     // to free.
     if (mustFreeBlocks) {
@@ -141,6 +148,9 @@ Segment::hasSpaceFor(uint32_t* entryLengths, uint32_t numEntries)
                             entryLengths[i];
     }
 
+    if (expect_false(compressed != NULL))
+        return compressed->hasSpaceFor(numEntries, totalBytesNeeded);
+
     uint32_t bytesLeft = 0;
     if (!closed) {
         uint32_t capacity = getSegletsAllocated() * segletSize;
@@ -164,6 +174,9 @@ Segment::hasSpaceFor(uint32_t* entryLengths, uint32_t numEntries)
 bool
 Segment::hasSpaceFor(uint32_t length)
 {
+    if (expect_false(compressed != NULL))
+        return compressed->hasSpaceFor(1, length);
+
     uint32_t bytesLeft = 0;
     if (!closed) {
         uint32_t capacity = getSegletsAllocated() * segletSize;
@@ -197,6 +210,9 @@ Segment::append(LogEntryType type,
                 uint32_t length,
                 Reference* outReference)
 {
+    if (expect_false(compressed != NULL))
+        return compressed->append(type, buffer, length, outReference);
+
     EntryHeader entryHeader(type, length);
 
     if (!hasSpaceFor(&length, 1))
@@ -284,6 +300,20 @@ Segment::append(const void* buffer,
     LogEntryType entryType = getEntry(buffer, &lengthWithoutMetadata,
                                       &lengthWithMetadata);
 
+    if (expect_false(compressed != NULL)) {
+        const uint8_t* entryContents = static_cast<const uint8_t*>(buffer) +
+            lengthWithMetadata - lengthWithoutMetadata;
+        if (!compressed->append(entryType, entryContents,
+                                lengthWithoutMetadata, outReference)) {
+            return false;
+        }
+        if (entryDataLength)
+            *entryDataLength = lengthWithoutMetadata;
+        if (type)
+            *type = entryType;
+        return true;
+    }
+
     if (!hasSpaceFor(lengthWithMetadata))
         return false;
 
@@ -357,6 +387,8 @@ Segment::appendLogHeader(LogEntryType type,
 void
 Segment::close()
 {
+    if (expect_false(compressed != NULL))
+        compressed->close();
     closed = true;
 }
 
@@ -381,6 +413,11 @@ uint64_t bufferAppendCount;
 void
 Segment::appendToBuffer(Buffer& buffer, uint32_t offset, uint32_t length) const
 {
+    if (expect_false(compressed != NULL)) {
+        compressed->appendToBuffer(buffer, offset, length);
+        return;
+    }
+
     while (length > 0) {
         const void* contigPointer = NULL;
         uint32_t contigBytes = std::min(length, peek(offset, &contigPointer));
@@ -412,8 +449,9 @@ Segment::appendToBuffer(Buffer& buffer, uint32_t offset, uint32_t length) const
 uint32_t
 Segment::appendToBuffer(Buffer& buffer)
 {
-    appendToBuffer(buffer, 0, head);
-    return head;
+    uint32_t length = getAppendedLength();
+    appendToBuffer(buffer, 0, length);
+    return length;
 }
 
 /**
@@ -439,6 +477,9 @@ Segment::appendToBuffer(Buffer& buffer)
 LogEntryType
 Segment::getEntry(uint32_t offset, Buffer* buffer, uint32_t* lengthWithMetadata)
 {
+    if (expect_false(compressed != NULL))
+        return compressed->getEntry(offset, buffer, lengthWithMetadata);
+
     EntryHeader header = getEntryHeader(offset);
     uint32_t entryDataOffset = offset +
                                sizeof32(header) +
@@ -483,6 +524,9 @@ Segment::getEntry(Reference reference,
                   Buffer* buffer,
                   uint32_t* lengthWithMetadata)
 {
+    if (expect_false(compressed != NULL))
+        return compressed->getEntry(reference, buffer, lengthWithMetadata);
+
     // Binary search our seglets to find out which one this entry starts in and
     // compute the offset in the segment.
     void* p = reinterpret_cast<void*>(reference.toInteger());
@@ -645,6 +689,9 @@ Segment::getEntry(Buffer* buffer, uint32_t offset,
 uint32_t
 Segment::getAppendedLength(Certificate* certificate) const
 {
+    if (expect_false(compressed != NULL))
+        return compressed->getAppendedLength(certificate);
+
     if (certificate != NULL) {
         certificate->segmentLength = head;
         Crc32C certificateChecksum = checksum;
@@ -662,6 +709,9 @@ Segment::getAppendedLength(Certificate* certificate) const
 uint32_t
 Segment::getSegletsAllocated()
 {
+    if (expect_false(compressed != NULL))
+        return compressed->physical.getSegletsAllocated();
+
     // We use 'segletBlocks', rather than 'seglets', because not all segments
     // are constructed using Seglet objects. Some just wrap unmanaged buffers.
     return downCast<uint32_t>(segletBlocks.size());
@@ -675,6 +725,8 @@ Segment::getSegletsAllocated()
 uint32_t
 Segment::getSegletsInUse()
 {
+    if (expect_false(compressed != NULL))
+        return compressed->physical.getSegletsInUse();
     return (head + segletSize - 1) / segletSize;
 }
 
@@ -689,6 +741,9 @@ Segment::getSegletsInUse()
 bool
 Segment::freeUnusedSeglets(uint32_t count)
 {
+    if (expect_false(compressed != NULL))
+        return closed && compressed->physical.freeUnusedSeglets(count);
+
     // If we're closed or don't have any seglets allocated (either because
     // they've all been freed or we started with a static or heap allocation
     // not backed by Seglet classes), there's nothing to be done.
@@ -734,6 +789,17 @@ Segment::freeUnusedSeglets(uint32_t count)
 bool
 Segment::checkMetadataIntegrity(const Certificate& certificate)
 {
+    if (expect_false(compressed != NULL)) {
+        // Check a decompressed copy. This is only done when iterating over
+        // a segment, which reads the whole thing anyway.
+        Buffer buffer;
+        uint32_t length = std::min(certificate.segmentLength,
+                                   getAppendedLength());
+        appendToBuffer(buffer, 0, length);
+        Segment copy(buffer.getRange(0, length), length);
+        return copy.checkMetadataIntegrity(certificate);
+    }
+
     uint32_t offset = 0;
     Crc32C currentChecksum;
 
@@ -791,6 +857,9 @@ Segment::checkMetadataIntegrity(const Certificate& certificate)
 uint32_t
 Segment::copyOut(uint32_t offset, void* buffer, uint32_t length) const
 {
+    if (expect_false(compressed != NULL))
+        return compressed->copyOut(offset, buffer, length);
+
     uint32_t initialLength = length;
     uint8_t* bufferBytes = static_cast<uint8_t*>(buffer);
 
@@ -844,6 +913,12 @@ Segment::getEntryHeader(uint32_t offset)
 {
     static_assert(sizeof(EntryHeader) == 1,
                   "Contiguity in segments not guaranteed!");
+    if (expect_false(compressed != NULL)) {
+        EntryHeader header;
+        compressed->copyOut(offset, &header, sizeof32(header));
+        return header;
+    }
+
     const EntryHeader* header = NULL;
     peek(offset, reinterpret_cast<const void**>(&header));
     return *header;
@@ -923,11 +998,54 @@ Segment::copyInFromBuffer(uint32_t segmentOffset,
 Segment::Reference
 Segment::getReference(uint32_t offset)
 {
+    if (expect_false(compressed != NULL))
+        return compressed->getReference(offset);
+
     const void* p = NULL;
     peek(offset, &p);
     return Reference(reinterpret_cast<uint64_t>(p));
 }
 
+/**
+ * Switch this segment to storing its contents compressed. Entries appended
+ * afterwards are compressed in blocks, references to them resolve through a
+ * small per-entry stand-in, and reading them back costs a decompression
+ * unless the block is cached. See CompressedSegment for details.
+ *
+ * The logical contents of the segment (its length, certificate, entries, and
+ * the data appended to buffers for replication) are exactly what they would
+ * have been without compression.
+ *
+ * This may only be invoked on an empty, open segment that was constructed
+ * with seglets.
+ *
+ * \param cache
+ *      Cache to keep recently decompressed blocks in.
+ */
+void
+Segment::enableCompression(DecompressionCache* cache)
+{
+    assert(head == 0 && !closed && compressed == NULL);
+    assert(!mustFreeBlocks && seglets.size() > 0);
+
+    compressed = new CompressedSegment(seglets, segletSize, cache);
+    seglets.clear();
+    segletBlocks.clear();
+}
+
+/**
+ * Return the number of bytes of memory occupied by the data appended to this
+ * segment. Unless the segment is compressed, this is the same as
+ * getAppendedLength().
+ */
+uint32_t
+Segment::getCompressedLength()
+{
+    if (expect_false(compressed != NULL))
+        return compressed->getCompressedLength();
+    return head;
+}
+
 LogEntryType
 Segment::Reference::getEntry(SegletAllocator* allocator,
                              Buffer* buffer,
@@ -935,12 +1053,14 @@ Segment::Reference::getEntry(SegletAllocator* allocator,
 {
     uint32_t segletSize = allocator->getSegletSize();
 
-    // See if we can take the fast path for contiguous entries.
+    // See if we can take the fast path for contiguous entries. Entries in
+    // compressed segments must always be looked up through their segment.
     EntryHeader* header = reinterpret_cast<EntryHeader*>(reference);
     uint32_t offset = downCast<uint32_t>(reference & (segletSize - 1));
     uint32_t fullHeaderLength = sizeof32(*header) +
                                 header->getLengthBytes();
-    if (expect_true(offset + fullHeaderLength <= segletSize)) {
+    if (expect_true(offset + fullHeaderLength <= segletSize &&
+                    header->getType() != LOG_ENTRY_TYPE_COMPRESSEDREF)) {
         // Looks like the header fits. Now grab the length and see if
         // the whole entry fits.
         TEST_LOG("Contiguous entry");
@@ -974,8 +1094,8 @@ Segment::Reference::getEntry(SegletAllocator* allocator,
         }
     }
 
-    // Slow path for a discontiguous entry. Need to figure out which
-    // Segment this belongs to so we can look up subsequent seglets.
+    // Slow path for a discontiguous or compressed entry. Need to figure out
+    // which Segment this belongs to so we can look up subsequent seglets.
     // This is likely to involve at least 3 additional cache misses.
     TEST_LOG("Discontiguous entry");
     LogSegment* segment = allocator->getOwnerSegment(
@@ -28,6 +28,10 @@
 
 namespace RAMCloud {
 
+// Forward declarations to avoid cyclic includes.
+class CompressedSegment;
+class DecompressionCache;
+
 /**
  * An exception that is thrown when the Segment class is provided invalid
  * method arguments or mutating operations are attempted on a closed Segment.
@@ -252,6 +256,7 @@ class Segment {
         /// above in this struct.
         Crc32C::ResultType checksum;
 
+        friend class CompressedSegment;
         friend class Segment;
         friend class SegmentIterator;
     } __attribute__((__packed__));
@@ -287,6 +292,11 @@ class Segment {
         Reference(Segment* segment, uint32_t offset)
             : reference(0)
         {
+            if (expect_false(segment->compressed != NULL)) {
+                reference = segment->getReference(offset).reference;
+                return;
+            }
+
             const void* p = NULL;
             uint32_t contigBytes = segment->peek(offset, &p);
             assert(contigBytes > 0);
@@ -307,6 +317,18 @@ class Segment {
                               Buffer* buffer,
                               uint32_t* lengthWithMetadata = NULL);
 
+        /**
+         * Prefetch the start of the referenced entry (its header and the
+         * first part of its contents) into the processor's caches, ahead of
+         * a later call to getEntry().
+         */
+        void
+        prefetch() const
+        {
+            RAMCloud::prefetch(reinterpret_cast<const void*>(reference),
+                               2 * CACHE_LINE_SIZE);
+        }
+
         /**
          * Compare references for equality. Returns true if equal, else false.
          */
@@ -374,6 +396,17 @@ class Segment {
     bool checkMetadataIntegrity(const Certificate& certificate);
     uint32_t copyOut(uint32_t offset, void* buffer, uint32_t length) const;
     Reference getReference(uint32_t offset);
+    void enableCompression(DecompressionCache* cache);
+    uint32_t getCompressedLength();
+
+    /**
+     * Returns true if enableCompression() has been invoked on this segment.
+     */
+    bool
+    isCompressed() const
+    {
+        return compressed != NULL;
+    }
 
     /**
      * 'Peek' into the segment by specifying a logical byte offset and getting
@@ -388,7 +421,8 @@ class Segment {
      *      Pointer to contiguous memory corresponding to the given offset.
      * \return
      *      The number of contiguous bytes accessible from the returned pointer
-     *      (outAddress). 
+     *      (outAddress). Always 0 for compressed segments, whose contents are
+     *      not directly addressable.
      */
     uint32_t
     peek(uint32_t offset, const void** outAddress) const
@@ -481,6 +515,13 @@ class Segment {
     /// is their responsibility. Used to generate Segment::Certificates.
     Crc32C checksum;
 
+    /// If enableCompression() has been invoked, this holds the segment's
+    /// contents in compressed form and all other members describe an empty
+    /// segment: nearly every public method forwards to this object instead.
+    /// NULL otherwise.
+    CompressedSegment* compressed;
+
+    friend class CompressedSegment;
     friend class SegmentIterator;
 
     DISALLOW_COPY_AND_ASSIGN(Segment);
@@ -0,0 +1,226 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <zlib.h>
+
+#include "SegmentCompressor.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a compressor with compression turned off. Use setOptions() to
+ * turn it on.
+ */
+SegmentCompressor::SegmentCompressor()
+    : mutex()
+    , workAvailable()
+    , jobs()
+    , level(0)
+    , numThreads(1)
+    , threads()
+    , threadsShouldExit(false)
+{
+}
+
+/**
+ * Stop all compression threads. Jobs that have not been compressed yet are
+ * abandoned; their #done flags are never set.
+ */
+SegmentCompressor::~SegmentCompressor()
+{
+    {
+        Lock lock(mutex);
+        threadsShouldExit = true;
+        workAvailable.notify_all();
+    }
+    foreach (std::thread* thread, threads) {
+        thread->join();
+        delete thread;
+    }
+}
+
+/**
+ * Change how segments are compressed. Takes effect for all jobs that start
+ * being compressed after this call.
+ *
+ * \param level
+ *      zlib compression level to use, from 1 (fastest) to 9 (smallest).
+ *      0 turns compression off: callers are expected to check getLevel()
+ *      before invoking compressAsync(). Values above 9 are treated as 9.
+ * \param numThreads
+ *      Maximum number of threads to compress segments with. At least one
+ *      thread is always used.
+ */
+void
+SegmentCompressor::setOptions(uint32_t level, uint32_t numThreads)
+{
+    Lock lock(mutex);
+    if (level > Z_BEST_COMPRESSION)
+        level = Z_BEST_COMPRESSION;
+    if (this->level != level || this->numThreads != std::max(1u, numThreads))
+        LOG(NOTICE, "Replica compression level %u using up to %u threads",
+            level, std::max(1u, numThreads));
+    this->level = level;
+    this->numThreads = std::max(1u, numThreads);
+
+    // Surplus threads notice and park themselves, and parked ones resume if
+    // they are needed again; new ones are only started when there is work
+    // for them.
+    workAvailable.notify_all();
+}
+
+/**
+ * Start compressing a closed segment in the background.
+ *
+ * \param segment
+ *      Segment to compress. Its contents are copied before this method
+ *      returns, so the segment may be freed at any time afterwards.
+ * \param length
+ *      Number of bytes at the start of \a segment to compress.
+ * \return
+ *      Reference to a job whose #Job::done flag will be set once the
+ *      segment has been compressed.
+ */
+SegmentCompressor::JobRef
+SegmentCompressor::compressAsync(const Segment* segment, uint32_t length)
+{
+    JobRef job(new Job(length, std::max(1u, level.load())));
+    segment->copyOut(0, job->contents.data(), length);
+
+    Lock lock(mutex);
+    jobs.push_back(job);
+    uint32_t numStarted = downCast<uint32_t>(threads.size());
+    if (numStarted < std::min(numThreads, downCast<uint32_t>(jobs.size()))) {
+        threads.push_back(new std::thread(&SegmentCompressor::workerMain,
+                                          this, numStarted));
+    }
+    // Wake every thread: one woken alone might be parked.
+    workAvailable.notify_all();
+    return job;
+}
+
+/**
+ * Compress a segment into an image that backups can store in place of the
+ * segment's replica.
+ *
+ * \param data
+ *      Contents of the segment.
+ * \param length
+ *      Number of bytes in \a data.
+ * \param level
+ *      zlib compression level to use.
+ * \param[out] image
+ *      Replaced with the compressed image. Left empty if the image would not
+ *      be smaller than \a length.
+ * \return
+ *      True if the segment was compressed, otherwise false.
+ */
+bool
+SegmentCompressor::compress(const void* data, uint32_t length, int level,
+                            vector<uint8_t>* image)
+{
+    image->resize(sizeof(Header) + compressBound(length));
+    uLongf compressedLength = downCast<uLongf>(image->size() - sizeof(Header));
+    int r = compress2(image->data() + sizeof(Header), &compressedLength,
+                      static_cast<const Bytef*>(data), length, level);
+    if (r != Z_OK || sizeof(Header) + compressedLength >= length) {
+        image->clear();
+        return false;
+    }
+
+    Header* header = reinterpret_cast<Header*>(image->data());
+    header->compressedLength = downCast<uint32_t>(compressedLength);
+    header->uncompressedLength = length;
+    image->resize(sizeof(Header) + compressedLength);
+    return true;
+}
+
+/**
+ * Decompress an image created by compress().
+ *
+ * \param image
+ *      The image, typically the contents of a backup's storage frame.
+ * \param imageCapacity
+ *      Number of valid bytes at \a image; the image itself may be shorter.
+ * \param output
+ *      Where to place the decompressed segment.
+ * \param outputCapacity
+ *      Number of bytes available at \a output.
+ * \return
+ *      Length of the decompressed segment.
+ * \throw SegmentCompressorException
+ *      The image is corrupt or too large for \a output.
+ */
+uint32_t
+SegmentCompressor::decompress(const void* image, uint32_t imageCapacity,
+                              void* output, uint32_t outputCapacity)
+{
+    if (imageCapacity < sizeof(Header))
+        throw SegmentCompressorException(HERE, "image too short");
+    const Header* header = static_cast<const Header*>(image);
+    if (header->compressedLength > imageCapacity - sizeof(Header) ||
+        header->uncompressedLength > outputCapacity) {
+        throw SegmentCompressorException(HERE,
+            format("bad image header (%u compressed bytes, %u uncompressed)",
+                   header->compressedLength, header->uncompressedLength));
+    }
+
+    uLongf outputLength = outputCapacity;
+    int r = uncompress(static_cast<Bytef*>(output), &outputLength,
+                       reinterpret_cast<const Bytef*>(header + 1),
+                       header->compressedLength);
+    if (r != Z_OK || outputLength != header->uncompressedLength) {
+        throw SegmentCompressorException(HERE,
+            format("failed to decompress image (zlib error %d)", r));
+    }
+    return header->uncompressedLength;
+}
+
+// - private -
+
+/**
+ * Main loop of each compression thread: compress jobs whenever there are
+ * some and this thread is within #numThreads, until the compressor is
+ * destroyed.
+ *
+ * \param index
+ *      Position of this thread in #threads.
+ */
+void
+SegmentCompressor::workerMain(uint32_t index)
+{
+    Lock lock(mutex);
+    while (true) {
+        while (!threadsShouldExit && (jobs.empty() || index >= numThreads))
+            workAvailable.wait(lock);
+        if (threadsShouldExit)
+            break;
+
+        JobRef job = jobs.front();
+        jobs.pop_front();
+        lock.unlock();
+
+        compress(job->contents.data(),
+                 downCast<uint32_t>(job->contents.size()),
+                 job->level, &job->image);
+        vector<uint8_t>().swap(job->contents);
+        job->done = true;
+
+        lock.lock();
+    }
+}
+
+} // namespace RAMCloud
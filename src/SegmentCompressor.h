@@ -0,0 +1,148 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SEGMENTCOMPRESSOR_H
+#define RAMCLOUD_SEGMENTCOMPRESSOR_H
+
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+#include "Common.h"
+#include "Segment.h"
+
+namespace RAMCloud {
+
+/**
+ * Thrown when a compressed replica image cannot be decompressed.
+ */
+struct SegmentCompressorException : public Exception {
+    SegmentCompressorException(const CodeLocation& where, std::string msg)
+        : Exception(where, msg) {}
+};
+
+/**
+ * Compresses the contents of closed segments so that masters can send
+ * smaller replicas to backups, and decompresses them again on backups
+ * during recovery.
+ *
+ * A compressed replica is stored on backups as an "image": a small Header
+ * followed by the zlib-compressed contents of the segment. The segment's
+ * certificate is always computed over the uncompressed contents, so a
+ * decompressed image can be checked and used exactly like a regular replica.
+ *
+ * Masters compress segments in the background on a small pool of threads
+ * (see compressAsync()), since compressing a full segment takes far too long
+ * to do on the replication thread. The compression level and the number of
+ * threads may be changed at any time with setOptions(); no threads are
+ * started until compression is first requested.
+ *
+ * This class is thread-safe.
+ */
+class SegmentCompressor {
+  public:
+    /**
+     * Describes one segment to be compressed in the background. Returned by
+     * compressAsync(); the result is only valid once #done is set.
+     */
+    struct Job {
+        Job(uint32_t length, int level)
+            : done(false)
+            , level(level)
+            , contents(length)
+            , image()
+        {
+        }
+
+        /// Set once #image has been filled in (or left empty).
+        std::atomic<bool> done;
+
+        /// zlib compression level to use.
+        const int level;
+
+        /// Copy of the segment's contents. Released once compressed.
+        vector<uint8_t> contents;
+
+        /// The compressed image of #contents, or empty if compressing
+        /// the segment would not have made it smaller.
+        vector<uint8_t> image;
+
+        DISALLOW_COPY_AND_ASSIGN(Job);
+    };
+    typedef std::shared_ptr<Job> JobRef;
+
+    SegmentCompressor();
+    ~SegmentCompressor();
+    void setOptions(uint32_t level, uint32_t numThreads);
+    JobRef compressAsync(const Segment* segment, uint32_t length);
+
+    /// Return the current compression level; 0 means compression is off.
+    uint32_t getLevel() const { return level; }
+
+    static bool compress(const void* data, uint32_t length, int level,
+                         vector<uint8_t>* image);
+    static uint32_t decompress(const void* image, uint32_t imageCapacity,
+                               void* output, uint32_t outputCapacity);
+
+  PRIVATE:
+    /**
+     * Precedes the compressed data in every image.
+     */
+    struct Header {
+        /// Number of bytes of compressed data following this header.
+        uint32_t compressedLength;
+
+        /// Length of the segment data once decompressed.
+        uint32_t uncompressedLength;
+    } __attribute__((packed));
+
+    typedef std::unique_lock<std::mutex> Lock;
+
+    void workerMain(uint32_t index);
+
+    /// Protects all of the members below.
+    std::mutex mutex;
+
+    /// Notified when jobs are queued, when #numThreads changes, and when the
+    /// compressor is being destroyed.
+    std::condition_variable workAvailable;
+
+    /// Jobs waiting for a thread to compress them.
+    std::deque<JobRef> jobs;
+
+    /// See getLevel(). Set by setOptions().
+    std::atomic<uint32_t> level;
+
+    /// Number of threads that may compress jobs: only threads[0] through
+    /// threads[numThreads - 1] take jobs.
+    uint32_t numThreads;
+
+    /// Threads started so far; each runs workerMain() with its index here.
+    /// Threads are never stopped before the destructor, so lowering
+    /// #numThreads just parks the surplus ones, and the pool never holds
+    /// more threads than the largest #numThreads ever set.
+    vector<std::thread*> threads;
+
+    /// Set by the destructor to tell all threads to exit.
+    bool threadsShouldExit;
+
+    DISALLOW_COPY_AND_ASSIGN(SegmentCompressor);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_SEGMENTCOMPRESSOR_H
@@ -0,0 +1,154 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "Cycles.h"
+#include "SegmentCompressor.h"
+
+namespace RAMCloud {
+
+class SegmentCompressorTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    SegmentCompressor compressor;
+    Segment segment;
+
+    SegmentCompressorTest()
+        : logEnabler()
+        , compressor()
+        , segment()
+    {
+        char entry[100];
+        memset(entry, 'x', sizeof(entry));
+        for (int i = 0; i < 100; i++)
+            segment.append(LOG_ENTRY_TYPE_OBJ, entry, sizeof(entry));
+        segment.close();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(SegmentCompressorTest);
+};
+
+TEST_F(SegmentCompressorTest, setOptions) {
+    EXPECT_EQ(0U, compressor.getLevel());
+    compressor.setOptions(12, 0);
+    EXPECT_EQ(9U, compressor.getLevel());
+    EXPECT_EQ(1U, compressor.numThreads);
+    EXPECT_EQ("setOptions: Replica compression level 9 using up to 1 threads",
+              TestLog::get());
+
+    TestLog::reset();
+    compressor.setOptions(9, 1);
+    EXPECT_EQ("", TestLog::get());
+}
+
+TEST_F(SegmentCompressorTest, compressAsync) {
+    compressor.setOptions(1, 2);
+    SegmentCompressor::JobRef job1 =
+        compressor.compressAsync(&segment, segment.getAppendedLength());
+    SegmentCompressor::JobRef job2 =
+        compressor.compressAsync(&segment, segment.getAppendedLength());
+    EXPECT_EQ(2U, compressor.threads.size());
+
+    uint64_t deadline = Cycles::rdtsc() + Cycles::fromSeconds(5);
+    while ((!job1->done || !job2->done) && Cycles::rdtsc() < deadline)
+        usleep(100);
+    ASSERT_TRUE(job1->done);
+    ASSERT_TRUE(job2->done);
+    EXPECT_TRUE(job1->contents.empty());
+    EXPECT_FALSE(job1->image.empty());
+    EXPECT_EQ(job1->image, job2->image);
+}
+
+TEST_F(SegmentCompressorTest, compressAsync_fewerThreads) {
+    compressor.setOptions(1, 2);
+    SegmentCompressor::JobRef job1 =
+        compressor.compressAsync(&segment, segment.getAppendedLength());
+    SegmentCompressor::JobRef job2 =
+        compressor.compressAsync(&segment, segment.getAppendedLength());
+    EXPECT_EQ(2U, compressor.threads.size());
+
+    // The surplus thread is parked rather than replaced, so changing the
+    // limit back and forth doesn't accumulate threads.
+    compressor.setOptions(1, 1);
+    SegmentCompressor::JobRef job3 =
+        compressor.compressAsync(&segment, segment.getAppendedLength());
+    compressor.setOptions(1, 2);
+    SegmentCompressor::JobRef job4 =
+        compressor.compressAsync(&segment, segment.getAppendedLength());
+    EXPECT_EQ(2U, compressor.threads.size());
+
+    uint64_t deadline = Cycles::rdtsc() + Cycles::fromSeconds(5);
+    while ((!job3->done || !job4->done) && Cycles::rdtsc() < deadline)
+        usleep(100);
+    EXPECT_TRUE(job3->done);
+    EXPECT_TRUE(job4->done);
+}
+
+TEST_F(SegmentCompressorTest, compressAndDecompress) {
+    uint32_t length = segment.getAppendedLength();
+    vector<uint8_t> original(length);
+    segment.copyOut(0, original.data(), length);
+
+    vector<uint8_t> image;
+    EXPECT_TRUE(SegmentCompressor::compress(original.data(), length, 6,
+                                            &image));
+    EXPECT_LT(image.size(), length);
+
+    vector<uint8_t> output(length);
+    EXPECT_EQ(length, SegmentCompressor::decompress(
+        image.data(), downCast<uint32_t>(image.size()),
+        output.data(), length));
+    EXPECT_EQ(original, output);
+}
+
+TEST_F(SegmentCompressorTest, compress_notSmaller) {
+    vector<uint8_t> data(1000);
+    uint32_t seed = 1;
+    foreach (uint8_t& byte, data) {
+        seed = seed * 1103515245 + 12345;
+        byte = downCast<uint8_t>(seed >> 24);
+    }
+    vector<uint8_t> image;
+    EXPECT_FALSE(SegmentCompressor::compress(data.data(), 1000, 9, &image));
+    EXPECT_TRUE(image.empty());
+}
+
+TEST_F(SegmentCompressorTest, decompress_corrupt) {
+    uint32_t length = segment.getAppendedLength();
+    vector<uint8_t> original(length);
+    segment.copyOut(0, original.data(), length);
+    vector<uint8_t> image;
+    ASSERT_TRUE(SegmentCompressor::compress(original.data(), length, 6,
+                                            &image));
+    vector<uint8_t> output(length);
+
+    EXPECT_THROW(SegmentCompressor::decompress(image.data(), 4,
+                                               output.data(), length),
+                 SegmentCompressorException);
+    EXPECT_THROW(SegmentCompressor::decompress(image.data(),
+                                               downCast<uint32_t>(image.size()),
+                                               output.data(), length - 1),
+                 SegmentCompressorException);
+
+    image.back() ^= 0xff;
+    image[image.size() / 2] ^= 0xff;
+    EXPECT_THROW(SegmentCompressor::decompress(image.data(),
+                                               downCast<uint32_t>(image.size()),
+                                               output.data(), length),
+                 SegmentCompressorException);
+}
+
+}  // namespace RAMCloud
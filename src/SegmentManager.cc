@@ -79,6 +79,7 @@ SegmentManager::SegmentManager(Context* context,
       logIteratorCount(0),
       segmentsOnDisk(0),
       segmentsOnDiskHistogram(maxSegments, 1),
+      decompressionCache(),
       safeVersion(1)
 {
     if ((segmentSize % allocator.getSegletSize()) != 0)
@@ -327,6 +328,9 @@ SegmentManager::allocSideSegment(uint32_t flags, LogSegment* replacing)
     }
     assert(guard);
 
+    if (flags & COMPRESSED)
+        s->enableCompression(&decompressionCache);
+
     writeHeader(s);
 
     if (replacing != NULL) {
@@ -1164,7 +1168,7 @@ SegmentManager::freeUnreferencedSegments()
         return;
 
     uint64_t earliestEpoch =
-        ServerRpcPool<>::getEarliestOutstandingEpoch(context);
+        ServerRpcPool<>::getEarliestOutstandingEpoch();
     SegmentList::iterator it = freeablePending.begin();
 
     while (it != freeablePending.end()) {
@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "BoostIntrusive.h"
+#include "DecompressionCache.h"
 #include "LargeBlockOfMemory.h"
 #include "LogSegment.h"
 #include "Histogram.h"
@@ -105,7 +106,13 @@ class SegmentManager {
         /// The segment being allocated will be used for cleaning. This simply
         /// tells SegmentManager which pool of memory to allocate from. This
         /// flag only makes sense in the allocSideSegment method.
-        FOR_CLEANING = 2
+        FOR_CLEANING = 2,
+
+        /// The segment being allocated will store its contents compressed
+        /// (see CompressedSegment). This trades slower reads for less memory,
+        /// so the cleaner only uses it for survivors holding cold data. This
+        /// flag only makes sense in the allocSideSegment method.
+        COMPRESSED = 4
     };
 
     SegmentManager(Context* context,
@@ -374,6 +381,10 @@ class SegmentManager {
     /// time a segment is allocated or freed.
     Histogram segmentsOnDiskHistogram;
 
+    /// Caches recently decompressed blocks of all COMPRESSED segments
+    /// allocated by this module.
+    DecompressionCache decompressionCache;
+
     /**
      * Safe version number for a new object in the log.
      * Single safeVersion is maintained in each master through recovery.
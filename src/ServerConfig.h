@@ -218,8 +218,18 @@ struct ServerConfig {
             , cleanerWriteCostThreshold(0)
             , cleanerThreadCount(1)
             , masterServiceThreadCount(1)
+            , recoveryReplayThreadCount(1)
             , numReplicas(0)
             , useMinCopysets(false)
+            , useLoadAwareBackupSelection(false)
+            , coldDataCompressionAge(0)
+            , migrationRpcsInFlight(4)
+            , migrationCatchUpRounds(3)
+            , migrationFreezeBytes(1024 * 1024)
+            , hotKeyReplicas(0)
+            , rpcPriorities()
+            , highPriorityThreads(0)
+            , lowPriorityThreads(0)
         {}
 
         /**
@@ -237,8 +247,18 @@ struct ServerConfig {
             , cleanerWriteCostThreshold()
             , cleanerThreadCount()
             , masterServiceThreadCount()
+            , recoveryReplayThreadCount()
             , numReplicas()
             , useMinCopysets()
+            , useLoadAwareBackupSelection()
+            , coldDataCompressionAge()
+            , migrationRpcsInFlight()
+            , migrationCatchUpRounds()
+            , migrationFreezeBytes()
+            , hotKeyReplicas()
+            , rpcPriorities()
+            , highPriorityThreads()
+            , lowPriorityThreads()
         {}
 
         /**
@@ -256,8 +276,19 @@ struct ServerConfig {
             config.set_cleaner_write_cost_threshold(cleanerWriteCostThreshold);
             config.set_cleaner_thread_count(cleanerThreadCount);
             config.set_master_service_thread_count(masterServiceThreadCount);
+            config.set_recovery_replay_thread_count(recoveryReplayThreadCount);
             config.set_num_replicas(numReplicas);
             config.set_use_mincopysets(useMinCopysets);
+            config.set_use_load_aware_backup_selection(
+                useLoadAwareBackupSelection);
+            config.set_cold_data_compression_age(coldDataCompressionAge);
+            config.set_migration_rpcs_in_flight(migrationRpcsInFlight);
+            config.set_migration_catch_up_rounds(migrationCatchUpRounds);
+            config.set_migration_freeze_bytes(migrationFreezeBytes);
+            config.set_hot_key_replicas(hotKeyReplicas);
+            config.set_rpc_priorities(rpcPriorities);
+            config.set_high_priority_threads(highPriorityThreads);
+            config.set_low_priority_threads(lowPriorityThreads);
         }
 
         /// Total number bytes to use for the in-memory Log.
@@ -297,12 +328,65 @@ struct ServerConfig {
         /// throughput (especially for reads).
         uint32_t masterServiceThreadCount;
 
+        /// Number of threads a recovery master uses to replay recovery
+        /// segments. If 1, segments are replayed one at a time by the worker
+        /// handling the recovery; otherwise a ParallelSegmentReplayer with
+        /// this many threads is used.
+        uint32_t recoveryReplayThreadCount;
+
         /// Number of replicas to keep per segment stored on backups.
         uint32_t numReplicas;
 
         /// Specifies whether to use MinCopysets replication or random
         /// replication.
         bool useMinCopysets;
+
+        /// If true, choose backups with a LoadAwareBackupSelector, which
+        /// avoids backups that are slow to accept replication writes.
+        bool useLoadAwareBackupSelection;
+
+        /// If nonzero, the disk cleaner considers log entries that have not
+        /// been modified in at least this many seconds to be cold and writes
+        /// them to compressed survivor segments (see CompressedSegment). If
+        /// 0, survivor segments are never compressed.
+        uint32_t coldDataCompressionAge;
+
+        /// Maximum number of RECEIVE_MIGRATION_DATA rpcs a master keeps
+        /// outstanding while migrating a tablet. Only one is used while
+        /// the master is busy serving other requests.
+        uint32_t migrationRpcsInFlight;
+
+        /// Maximum number of catch-up rounds a master runs while migrating a
+        /// tablet. Each round sends the log entries appended during the
+        /// previous one without blocking writes. Once the rounds are done,
+        /// writes are frozen while the remaining tail is sent and ownership
+        /// is handed over. If 0, writes are frozen as soon as the bulk copy
+        /// of the tablet's live objects has been sent.
+        uint32_t migrationCatchUpRounds;
+
+        /// Catch-up rounds stop early once a round sends no more than this
+        /// many bytes, since the tail left for the write freeze is then
+        /// expected to be small.
+        uint64_t migrationFreezeBytes;
+
+        /// Number of other masters that are sent read-only copies of this
+        /// master's most frequently read objects, so that clients can spread
+        /// reads of those objects across them (see HotKeyCache). If 0, hot
+        /// objects are only ever read from this master.
+        uint32_t hotKeyReplicas;
+
+        /// Overrides of the default priority class of master RPCs (see
+        /// MasterService::getRpcPriority), as a comma-separated list of
+        /// OPCODE:CLASS pairs where CLASS is high, normal, or low.
+        string rpcPriorities;
+
+        /// Number of master service threads that only high-priority RPCs
+        /// (single-object reads and writes by default) may use.
+        uint32_t highPriorityThreads;
+
+        /// Number of master service threads that only low-priority RPCs
+        /// (enumeration, migration, and recovery by default) may use.
+        uint32_t lowPriorityThreads;
     } master;
 
     /**
@@ -107,6 +107,61 @@ main(int argc, char *argv[])
              ProgramOptions::value<bool>(&config.master.useMinCopysets)->
                 default_value(false),
              "Whether to use MinCopysets or random replication")
+            ("useLoadAwareBackupSelection",
+             ProgramOptions::value<bool>(
+                &config.master.useLoadAwareBackupSelection)->
+                default_value(false),
+             "Whether to avoid placing replicas on backups that are slow to "
+             "accept writes (may be combined with useMinCopysets)")
+            ("coldDataCompressionAge",
+             ProgramOptions::value<uint32_t>(
+                &config.master.coldDataCompressionAge)->
+                default_value(0),
+             "Number of seconds after which unmodified objects are considered "
+             "cold and are compressed in memory by the log cleaner (0 means "
+             "never compress)")
+            ("migrationRpcsInFlight",
+             ProgramOptions::value<uint32_t>(
+                &config.master.migrationRpcsInFlight)->
+                default_value(4),
+             "Maximum number of rpcs carrying data to the new owner that "
+             "may be outstanding while migrating a tablet")
+            ("migrationCatchUpRounds",
+             ProgramOptions::value<uint32_t>(
+                &config.master.migrationCatchUpRounds)->
+                default_value(3),
+             "Maximum number of rounds spent sending writes made during a "
+             "tablet migration before writes to the tablet are frozen for "
+             "the hand-over (0 means freeze right after the bulk copy)")
+            ("migrationFreezeBytes",
+             ProgramOptions::value<uint64_t>(
+                &config.master.migrationFreezeBytes)->
+                default_value(1024 * 1024),
+             "Stop tablet migration catch-up rounds early once a round sends "
+             "at most this many bytes")
+            ("hotKeyReplicas",
+             ProgramOptions::value<uint32_t>(
+                &config.master.hotKeyReplicas)->
+                default_value(0),
+             "Number of other masters given read-only copies of this "
+             "master's most frequently read objects (0 disables this)")
+            ("rpcPriorities",
+             ProgramOptions::value<string>(&config.master.rpcPriorities)->
+                default_value(""),
+             "Comma-separated OPCODE:CLASS pairs that override the default "
+             "priority class (high, normal, or low) of master RPCs")
+            ("highPriorityThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.master.highPriorityThreads)->
+                default_value(1),
+             "Number of master service threads reserved for high-priority "
+             "RPCs such as reads and writes")
+            ("lowPriorityThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.master.lowPriorityThreads)->
+                default_value(0),
+             "Number of master service threads reserved for low-priority "
+             "RPCs such as enumeration, migration, and recovery")
             ("segmentFrames",
              ProgramOptions::value<uint32_t>(&config.backup.numSegmentFrames)->
                 default_value(512),
@@ -148,6 +203,13 @@ main(int argc, char *argv[])
              "The number of cleaner threads controls the amount of parallelism "
              "in the cleaner. More threads will use more cores, but may be "
              "able to better keep up with high write rates.")
+            ("recoveryReplayThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.master.recoveryReplayThreadCount)->default_value(1),
+             "The number of threads this server uses to replay recovery "
+             "segments when it acts as a recovery master. Entries are divided "
+             "among the threads by hash table bucket, so more threads allow "
+             "each recovery master to replay more data in the same time.")
             ("backupWriteRateLimit",
              ProgramOptions::value<size_t>(
                 &config.backup.writeRateLimit)->default_value(0),
@@ -15,13 +15,63 @@
 
 #include "Common.h"
 #include "ServerRpcPool.h"
+#include "ShortMacros.h"
+#include "SpinLock.h"
 
 namespace RAMCloud {
 
 /// See ServerRpcPool.h for details.
 namespace ServerRpcPoolInternal {
-    ServerRpcPoolInternal::ServerRpcList outstandingServerRpcs;
     uint64_t currentEpoch = 0;
+    EpochSlot epochSlots[MAX_EPOCH_SLOTS];
+
+    // Serializes allocation and release of epochSlots; not needed to read
+    // or publish epochs.
+    static SpinLock epochSlotMutex("ServerRpcPoolInternal::epochSlotMutex");
+
+/**
+ * Reserve an unused entry in epochSlots for a new ServerRpcPool.
+ */
+EpochSlot*
+allocateEpochSlot()
+{
+    std::lock_guard<SpinLock> lock(epochSlotMutex);
+    for (uint32_t i = 0; i < MAX_EPOCH_SLOTS; i++) {
+        if (!epochSlots[i].inUse) {
+            epochSlots[i].inUse = true;
+            epochSlots[i].earliestEpoch.store(-1);
+            return &epochSlots[i];
+        }
+    }
+    DIE("Too many ServerRpcPools; increase MAX_EPOCH_SLOTS (%u)",
+        MAX_EPOCH_SLOTS);
+}
+
+/**
+ * Return a slot obtained from allocateEpochSlot once its pool has no more
+ * outstanding RPCs.
+ */
+void
+freeEpochSlot(EpochSlot* slot)
+{
+    std::lock_guard<SpinLock> lock(epochSlotMutex);
+    slot->earliestEpoch.store(-1);
+    slot->inUse = false;
 }
 
+/**
+ * Return the minimum of the epochs published in epochSlots, or -1 if no
+ * RPCs are outstanding.
+ */
+uint64_t
+getEarliestEpoch()
+{
+    uint64_t earliest = -1;
+    for (uint32_t i = 0; i < MAX_EPOCH_SLOTS; i++)
+        earliest = std::min(earliest, epochSlots[i].earliestEpoch.load());
+    return earliest;
+}
+
+} // namespace ServerRpcPoolInternal
+
 } // namespace RAMCloud
@@ -17,7 +17,7 @@
 #define RAMCLOUD_SERVERRPCPOOL_H
 
 #include "Common.h"
-#include "Dispatch.h"
+#include "Atomic.h"
 #include "ObjectPool.h"
 #include "Transport.h"
 
@@ -27,12 +27,37 @@ namespace ServerRpcPoolInternal {
     INTRUSIVE_LIST_TYPEDEF(Transport::ServerRpc, outstandingRpcListHook)
         ServerRpcList;
 
-    // List of ServerRpcs that are being processed. RPCs are added to the
-    // list when allocated in ServerRpcPool::construct and are removed
-    // when they are destroyed in ServerRpcPool::destroy. This list may
-    // be walked to check whether a given epoch is still represented by
-    // any outstanding RPC in the system.
-    extern ServerRpcList outstandingServerRpcs;
+    // Each ServerRpcPool publishes the earliest epoch of its outstanding
+    // RPCs in one of these, so that the oldest epoch in the system can be
+    // found without looking at (or locking) the pools themselves. Slots
+    // are padded to a full cache line so that pools on different threads
+    // don't contend.
+    struct EpochSlot {
+        EpochSlot()
+            : earliestEpoch(-1)
+            , inUse(false)
+        {}
+
+        // Earliest epoch of any RPC outstanding in the pool that owns this
+        // slot, or -1 if it has none. Only the owning pool writes this.
+        Atomic<uint64_t> earliestEpoch;
+
+        // True if the slot has been handed out by allocateEpochSlot.
+        bool inUse;
+
+        char pad[CACHE_LINE_SIZE - sizeof(Atomic<uint64_t>) - sizeof(bool)];
+    };
+
+    // Maximum number of ServerRpcPools that may exist at once (each
+    // transport has one).
+    static const uint32_t MAX_EPOCH_SLOTS = 64;
+
+    // Fixed array scanned by getEarliestEpoch; see EpochSlot.
+    extern EpochSlot epochSlots[MAX_EPOCH_SLOTS];
+
+    EpochSlot* allocateEpochSlot();
+    void freeEpochSlot(EpochSlot* slot);
+    uint64_t getEarliestEpoch();
 
     // An unsigned integer representing the current epoch. Epochs are
     // just monotonically increasing values that represent some point
@@ -51,6 +76,12 @@ namespace ServerRpcPoolInternal {
  * if RPCs less than or equal to a given epoch are still present. This
  * can be used, for example, to ensure that its safe to reclaim zero-
  * copy buffers.
+ *
+ * Each pool keeps its own list of outstanding RPCs and publishes the
+ * earliest of their epochs in a slot of a fixed, global array, so querying
+ * the earliest epoch only reads that array. A pool must only be used by a
+ * single thread (normally its transport's dispatch thread), so construct
+ * and destroy need no locks.
  */
 template<typename T = Transport::ServerRpc>
 class ServerRpcPool {
@@ -60,7 +91,9 @@ class ServerRpcPool {
      */
     ServerRpcPool()
         : pool(),
-          outstandingAllocations(0)
+          outstandingAllocations(0),
+          outstandingRpcs(),
+          epochSlot(ServerRpcPoolInternal::allocateEpochSlot())
     {
     }
 
@@ -72,6 +105,7 @@ class ServerRpcPool {
         // ServerRpcs should not just be dropped on the floor. If you are
         // hitting this, then you're not being careful cleaning up.
         assert(outstandingAllocations == 0);
+        ServerRpcPoolInternal::freeEpochSlot(epochSlot);
     }
 
     /**
@@ -84,7 +118,14 @@ class ServerRpcPool {
     {
         T* rpc = pool.construct(static_cast<Args&&>(args)...);
         rpc->epoch = ServerRpcPoolInternal::currentEpoch;
-        ServerRpcPoolInternal::outstandingServerRpcs.push_back(*rpc);
+
+        // Epochs never decrease, so #outstandingRpcs stays sorted by epoch
+        // and the published value only changes when the list was empty.
+        // It is published before the RPC is handed to a service, so any
+        // reference the RPC takes on log memory is visible to the cleaner.
+        if (outstandingRpcs.empty())
+            epochSlot->earliestEpoch.store(rpc->epoch);
+        outstandingRpcs.push_back(*rpc);
         outstandingAllocations++;
         return rpc;
     }
@@ -96,8 +137,12 @@ class ServerRpcPool {
     void
     destroy(T* const rpc)
     {
-        ServerRpcPoolInternal::outstandingServerRpcs.erase(
-            ServerRpcPoolInternal::outstandingServerRpcs.iterator_to(*rpc));
+        bool wasEarliest = (&outstandingRpcs.front() == rpc);
+        outstandingRpcs.erase(outstandingRpcs.iterator_to(*rpc));
+        if (wasEarliest) {
+            epochSlot->earliestEpoch.store(outstandingRpcs.empty() ?
+                    -1 : outstandingRpcs.front().epoch);
+        }
         outstandingAllocations--;
         pool.destroy(rpc);
     }
@@ -116,28 +161,14 @@ class ServerRpcPool {
      * system. If there are no RPCs, then the return value is -1 (i.e. the
      * largest 64-bit unsigned integer).
      *
-     * Note that this method is not particularly efficient and should not be
-     * called very frequently (it will grab the Dispatch lock and query all
-     * outstanding server RPCs).
-     * 
-     * \param context
-     *      Overall information about the RAMCloud server; used to lock the
-     *      dispatcher.
+     * This takes no locks: it reads the epoch each pool has published, so
+     * its cost depends only on the number of pools, not on the number of
+     * outstanding RPCs.
      */
     static uint64_t
-    getEarliestOutstandingEpoch(Context* context)
+    getEarliestOutstandingEpoch()
     {
-        Dispatch::Lock lock(context->dispatch);
-        uint64_t earliest = -1;
-
-        ServerRpcPoolInternal::ServerRpcList::iterator it =
-            ServerRpcPoolInternal::outstandingServerRpcs.begin();
-        while (it != ServerRpcPoolInternal::outstandingServerRpcs.end()) {
-            earliest = std::min(it->epoch, earliest);
-            it++;
-        }
-
-        return earliest;
+        return ServerRpcPoolInternal::getEarliestEpoch();
     }
 
     /**
@@ -161,6 +192,16 @@ class ServerRpcPool {
     /// yet destroyed. The new ObjectPool does this, but the old one did not.
     /// Keep this simple check around just in case the interface changes.
     uint64_t outstandingAllocations;
+
+    /// RPCs constructed by this pool that haven't been destroyed yet, in
+    /// order of construction (and therefore of epoch).
+    ServerRpcPoolInternal::ServerRpcList outstandingRpcs;
+
+    /// Where this pool publishes the epoch of the first RPC in
+    /// #outstandingRpcs.
+    ServerRpcPoolInternal::EpochSlot* epochSlot;
+
+    DISALLOW_COPY_AND_ASSIGN(ServerRpcPool);
 };
 
 /**
@@ -183,7 +224,18 @@ class ServerRpcPoolGuard {
 
     ~ServerRpcPoolGuard()
     {
-        pool.destroy(rpc);
+        if (rpc != NULL)
+            pool.destroy(rpc);
+    }
+
+    /**
+     * Don't destroy the rpc after all; the caller takes responsibility
+     * for returning it to the pool.
+     */
+    void
+    release()
+    {
+        rpc = NULL;
     }
 
   PRIVATE:
@@ -45,27 +45,50 @@ TEST(ServerRpcPoolTest, destructor) {
 }
 
 TEST(ServerRpcPoolTest, construct) {
-    Context context;
     ServerRpcPool<TestServerRpc> pool;
 
     ServerRpcPoolInternal::currentEpoch = 12;
     TestServerRpc* rpc = pool.construct();
     EXPECT_EQ(12UL, rpc->epoch);
-    EXPECT_EQ(12UL, ServerRpcPool<>::getEarliestOutstandingEpoch(&context));
+    EXPECT_EQ(12UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
     EXPECT_EQ(true, rpc->outstandingRpcListHook.is_linked());
     EXPECT_EQ(1U, pool.outstandingAllocations);
 
+    // Later RPCs don't change the published epoch.
+    ServerRpcPoolInternal::currentEpoch = 13;
+    TestServerRpc* rpc2 = pool.construct();
+    EXPECT_EQ(13UL, rpc2->epoch);
+    EXPECT_EQ(12UL, pool.epochSlot->earliestEpoch.load());
+
     pool.destroy(rpc);
+    pool.destroy(rpc2);
 }
 
 TEST(ServerRpcPoolTest, destroy) {
-    Context context;
     ServerRpcPool<TestServerRpc> pool;
 
     TestServerRpc* rpc = pool.construct();
     pool.destroy(rpc);
     EXPECT_EQ(0U, pool.outstandingAllocations);
-    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch(&context));
+    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
+}
+
+TEST(ServerRpcPoolTest, destroy_earliest) {
+    ServerRpcPool<TestServerRpc> pool;
+
+    ServerRpcPoolInternal::currentEpoch = 3;
+    TestServerRpc* rpc1 = pool.construct();
+    ServerRpcPoolInternal::currentEpoch = 4;
+    TestServerRpc* rpc2 = pool.construct();
+    ServerRpcPoolInternal::currentEpoch = 5;
+    TestServerRpc* rpc3 = pool.construct();
+
+    pool.destroy(rpc2);
+    EXPECT_EQ(3UL, pool.epochSlot->earliestEpoch.load());
+    pool.destroy(rpc1);
+    EXPECT_EQ(5UL, pool.epochSlot->earliestEpoch.load());
+    pool.destroy(rpc3);
+    EXPECT_EQ(-1UL, pool.epochSlot->earliestEpoch.load());
 }
 
 TEST(ServerRpcPoolTest, getCurrentEpoch) {
@@ -74,16 +97,42 @@ TEST(ServerRpcPoolTest, getCurrentEpoch) {
 }
 
 TEST(ServerRpcPoolTest, getEarliestOutstandingEpoch) {
-    Context context;
-    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch(&context));
+    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
 
     ServerRpcPoolInternal::currentEpoch = 57;
     ServerRpcPool<TestServerRpc> pool;
     TestServerRpc* rpc = pool.construct();
-    EXPECT_EQ(57UL, ServerRpcPool<>::getEarliestOutstandingEpoch(&context));
+    EXPECT_EQ(57UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
     pool.destroy(rpc);
 
-    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch(&context));
+    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
+}
+
+TEST(ServerRpcPoolTest, getEarliestOutstandingEpoch_multiplePools) {
+    ServerRpcPool<TestServerRpc> pool1;
+    ServerRpcPool<TestServerRpc> pool2;
+
+    ServerRpcPoolInternal::currentEpoch = 20;
+    TestServerRpc* rpc1 = pool1.construct();
+    ServerRpcPoolInternal::currentEpoch = 21;
+    TestServerRpc* rpc2 = pool2.construct();
+    EXPECT_EQ(20UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
+    pool1.destroy(rpc1);
+    EXPECT_EQ(21UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
+    pool2.destroy(rpc2);
+    EXPECT_EQ(-1UL, ServerRpcPool<>::getEarliestOutstandingEpoch());
+}
+
+TEST(ServerRpcPoolTest, freeEpochSlot) {
+    ServerRpcPoolInternal::EpochSlot* slot;
+    {
+        ServerRpcPool<TestServerRpc> pool;
+        slot = pool.epochSlot;
+        EXPECT_TRUE(slot->inUse);
+    }
+    EXPECT_FALSE(slot->inUse);
+    ServerRpcPool<TestServerRpc> pool;
+    EXPECT_EQ(slot, pool.epochSlot);
 }
 
 TEST(ServerRpcPoolTest, incrementCurrentEpoch) {
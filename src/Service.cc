@@ -261,6 +261,10 @@ Service::setServerId(ServerId assignedServerId)
 void
 Service::Rpc::sendReply()
 {
+    if (replied)
+        return;
+    replied = true;
+
     // The "if" statement below is only needed to simplify tests; it should
     // never be needed in a real system.
     if (worker != NULL) {
@@ -105,6 +105,42 @@ class Service {
         return 1;
     }
 
+    /**
+     * Classes of RPCs. When all of a service's threads are busy, waiting
+     * RPCs in one class are started before those in any later class, and
+     * a service may reserve some of its threads for a class so that RPCs
+     * in other classes can never occupy all of them.
+     */
+    enum RpcPriority {
+        /// Short, latency-critical requests such as reads and writes.
+        HIGH_PRIORITY = 0,
+        /// Requests not in another class.
+        NORMAL_PRIORITY = 1,
+        /// Long-running requests that don't need a quick response, such
+        /// as enumeration and migration.
+        LOW_PRIORITY = 2,
+    };
+
+    /// Number of values in RpcPriority.
+    static const int NUM_PRIORITIES = 3;
+
+    /**
+     * Returns the class of RPCs with the given opcode; the ServiceManager
+     * calls this once for each opcode when the service is added. The
+     * default puts every RPC in NORMAL_PRIORITY.
+     */
+    virtual RpcPriority getRpcPriority(WireFormat::Opcode opcode) {
+        return NORMAL_PRIORITY;
+    }
+
+    /**
+     * Returns the number of threads (out of maxThreads()) that only RPCs
+     * in the given class may use. The default reserves none.
+     */
+    virtual int reservedThreads(RpcPriority priority) {
+        return 0;
+    }
+
     void ping(const WireFormat::Ping::Request* reqHdr,
               WireFormat::Ping::Response* respHdr,
               Rpc* rpc);
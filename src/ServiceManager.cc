@@ -20,6 +20,7 @@
 #include "Fence.h"
 #include "Initialize.h"
 #include "RawMetrics.h"
+#include "RpcStageTimer.h"
 #include "ShortMacros.h"
 #include "ServerRpcPool.h"
 #include "ServiceManager.h"
@@ -56,6 +57,10 @@ Syscall* ServiceManager::sys = &defaultSyscall;
 // September 2011 this time appears to be as much as 50 microseconds).
 int ServiceManager::pollMicros = 10000;
 
+// Worker threads are the only ones whose RpcStageTimer totals are reported,
+// but any thread may use the class.
+__thread uint64_t RpcStageTimer::cycles[RpcStageTimer::NUM_STAGES];
+
 // The following constant is used to signal a worker thread that
 // it should exit.
 #define WORKER_EXIT reinterpret_cast<Transport::ServerRpc*>(1)
@@ -69,9 +74,17 @@ ServiceManager::ServiceManager(Context* context)
     , services()
     , busyThreads()
     , idleThreads()
+    , activeRpcs(0)
     , serviceCount(0)
+    , queueingDelays()
+    , allWorkers()
+    , statsLock("ServiceManager::statsLock")
+    , stageHistograms()
     , testRpcs()
 {
+    // 10-microsecond buckets up to 10 ms; longer delays are outliers.
+    for (int i = 0; i < Service::NUM_PRIORITIES; i++)
+        queueingDelays.emplace_back(1000, 10);
 }
 
 /**
@@ -89,6 +102,8 @@ ServiceManager::~ServiceManager()
         worker->exit();
         delete worker;
     }
+    for (int i = 0; i < WireFormat::ILLEGAL_RPC_TYPE; i++)
+        delete stageHistograms[i].load();
 }
 
 /**
@@ -120,6 +135,8 @@ ServiceManager::addService(Service& service, WireFormat::ServiceType type) {
         Worker* worker = new Worker(context);
         worker->thread.construct(workerMain, worker);
         idleThreads.push_back(worker);
+        std::lock_guard<SpinLock> _(statsLock);
+        allWorkers.push_back(worker);
     }
 }
 
@@ -172,10 +189,17 @@ ServiceManager::handleRpc(Transport::ServerRpc* rpc)
             rpc->requestPayload.getTotalLength());
 #endif
 
+    rpc->stageTimes.dispatched = Cycles::rdtsc();
     rpc->enqueueThreadToStartWork.start();
-    // See if we have exceeded the concurrency limit for the service.
-    if (serviceInfo->requestsRunning >= serviceInfo->maxThreads) {
-        serviceInfo->waitingRpcs.push(rpc);
+    activeRpcs++;
+    int priority = Service::NORMAL_PRIORITY;
+    if (header->opcode < WireFormat::ILLEGAL_RPC_TYPE)
+        priority = serviceInfo->priorities[header->opcode];
+
+    // See if we have exceeded the concurrency limit for the RPC's class.
+    if (!serviceInfo->canStart(priority)) {
+        serviceInfo->waitingRpcs[priority].push(
+                WaitingRpc(rpc, context->dispatch->currentTime));
         return;
     }
     // Temporary code to test how much faster things would be without threads.
@@ -195,17 +219,118 @@ ServiceManager::handleRpc(Transport::ServerRpc* rpc)
 #endif
 
     serviceInfo->requestsRunning++;
+    serviceInfo->running[priority]++;
+    recordQueueingDelay(priority, 0);
 
     // Hand off the RPC to a worker thread.
     assert(!idleThreads.empty());
     Worker* worker = idleThreads.back();
     idleThreads.pop_back();
     worker->serviceInfo = serviceInfo;
+    worker->priority = priority;
+    worker->opcode = header->opcode;
+    rpc->stageTimes.handedOff = Cycles::rdtsc();
     worker->handoff(rpc);
     worker->busyIndex = downCast<int>(busyThreads.size());
     busyThreads.push_back(worker);
 }
 
+/**
+ * Returns the number of incoming RPCs that are currently being executed by
+ * workers or waiting for a worker to become available. Unlike most methods
+ * of this class, this may be invoked from any thread (such as a worker that
+ * wants to back off when the server is busy); the result may be slightly
+ * out of date by the time it is used.
+ */
+uint32_t
+ServiceManager::getActiveRpcCount()
+{
+    return activeRpcs.load();
+}
+
+/**
+ * Return a breakdown of where the RPCs this server has replied to spent
+ * their time, for each opcode. May be invoked from any thread.
+ *
+ * \param stageMetrics
+ *      One entry is added here for each opcode that has been replied to,
+ *      with one stage for each RpcStage that such RPCs have entered.
+ */
+void
+ServiceManager::getRpcStageMetrics(ProtoBuf::RpcStageMetrics* stageMetrics)
+{
+    static const char* names[NUM_RPC_STAGES] = {"receive", "queue",
+            "handoff", "execute", "lookup", "sync", "reply", "total"};
+    for (uint32_t opcode = 0; opcode < WireFormat::ILLEGAL_RPC_TYPE;
+            opcode++) {
+        StageHistograms* histograms = stageHistograms[opcode].load();
+        if (histograms == NULL)
+            continue;
+        Fence::enter();
+        ProtoBuf::RpcStageMetrics_Entry* entry = stageMetrics->add_entry();
+        entry->set_opcode(WireFormat::opcodeSymbol(opcode));
+        for (int i = 0; i < NUM_RPC_STAGES; i++) {
+            if (histograms->stages[i].getTotalSamples() == 0)
+                continue;
+            ProtoBuf::RpcStageMetrics_Stage* stage = entry->add_stage();
+            stage->set_name(names[i]);
+            histograms->stages[i].serialize(*stage->mutable_latency());
+        }
+    }
+}
+
+/**
+ * Add information about how long RPCs have waited for worker threads, and
+ * how long workers have taken to execute them, to a master's statistics.
+ * May be invoked from any thread.
+ *
+ * \param serverStats
+ *      One RpcQueueEntry is added here for each Service::RpcPriority, and
+ *      one RpcServiceTimeEntry for each opcode that has been executed.
+ */
+void
+ServiceManager::getStatistics(ProtoBuf::ServerStatistics* serverStats)
+{
+    static const char* names[Service::NUM_PRIORITIES] =
+            {"high", "normal", "low"};
+    std::vector<Worker*> workers;
+    {
+        std::lock_guard<SpinLock> _(statsLock);
+        for (int i = 0; i < Service::NUM_PRIORITIES; i++) {
+            ProtoBuf::ServerStatistics_RpcQueueEntry* entry =
+                    serverStats->add_rpc_queue_entry();
+            entry->set_priority(names[i]);
+            queueingDelays[i].serialize(*entry->mutable_queueing_delay());
+        }
+        workers = allWorkers;
+    }
+
+    // Each worker records service times in its own histograms; merge them.
+    // This is done without #statsLock, which the dispatch thread needs for
+    // every RPC it hands to a worker. Workers are never deleted while the
+    // ServiceManager exists, so the copied pointers stay valid.
+    for (uint32_t opcode = 0; opcode < WireFormat::ILLEGAL_RPC_TYPE;
+            opcode++) {
+        LogLinearHistogram serviceTime;
+        bool executed = false;
+        foreach (Worker* worker, workers) {
+            LogLinearHistogram* histogram =
+                    worker->serviceTimes[opcode].load();
+            if (histogram != NULL) {
+                Fence::enter();
+                serviceTime.merge(*histogram);
+                executed = true;
+            }
+        }
+        if (executed) {
+            ProtoBuf::ServerStatistics_RpcServiceTimeEntry* entry =
+                    serverStats->add_rpc_service_time_entry();
+            entry->set_opcode(WireFormat::opcodeSymbol(opcode));
+            serviceTime.serialize(*entry->mutable_service_time());
+        }
+    }
+}
+
 /**
  * Returns true if there are currently no RPCs being serviced, false
  * if at least one RPC is currently being executed by a worker.  If true
@@ -247,16 +372,33 @@ ServiceManager::poll()
                     reinterpret_cast<uint64_t>(worker->rpc),
                     worker->rpc->replyPayload.getTotalLength());
 #endif
+            // The RPC may be gone once its reply has been sent.
+            Transport::ServerRpc::StageTimes times = worker->rpc->stageTimes;
             worker->rpc->sendReply();
+            recordRpcStages(worker->opcode, times, Cycles::rdtsc());
             worker->rpc = NULL;
+            activeRpcs--;
         }
 
         if (state != Worker::POSTPROCESSING) {
-            // If there is work waiting for this service, start the next RPC.
+            // If there is work waiting for this service that may use the
+            // thread, start the highest-priority RPC.
             ServiceInfo* info = worker->serviceInfo;
-            if (!info->waitingRpcs.empty()) {
-                worker->handoff(info->waitingRpcs.front());
-                info->waitingRpcs.pop();
+            info->running[worker->priority]--;
+            int priority = info->nextWaitingPriority();
+            if (priority >= 0) {
+                WaitingRpc next = info->waitingRpcs[priority].front();
+                info->waitingRpcs[priority].pop();
+                uint64_t now = context->dispatch->currentTime;
+                recordQueueingDelay(priority, (now > next.arrivalTime) ?
+                        now - next.arrivalTime : 0);
+                info->running[priority]++;
+                worker->priority = priority;
+                const WireFormat::RequestCommon* header = next.rpc->
+                        requestPayload.getStart<WireFormat::RequestCommon>();
+                worker->opcode = header->opcode;
+                next.rpc->stageTimes.handedOff = Cycles::rdtsc();
+                worker->handoff(next.rpc);
             } else {
                 // This worker is now idle; remove it from busyThreads (fill
                 // its slot with the worker in the last slot).
@@ -274,6 +416,90 @@ ServiceManager::poll()
     }
 }
 
+/**
+ * Record how long an RPC waited for a worker thread.
+ *
+ * \param priority
+ *      Service::RpcPriority of the RPC.
+ * \param delayCycles
+ *      Time, in Cycles::rdtsc() ticks, between the RPC's arrival and its
+ *      handoff to a worker.
+ */
+void
+ServiceManager::recordQueueingDelay(int priority, uint64_t delayCycles)
+{
+    uint64_t micros = (delayCycles == 0) ? 0 :
+            Cycles::toMicroseconds(delayCycles);
+    std::lock_guard<SpinLock> _(statsLock);
+    queueingDelays[priority].storeSample(micros);
+}
+
+/**
+ * Return the number of Cycles::rdtsc() ticks between two times, or 0 if
+ * \a end is before \a start: the times may have been read on different
+ * cores, so a stage that took almost no time may appear to have ended
+ * before it started.
+ */
+static uint64_t
+elapsed(uint64_t start, uint64_t end)
+{
+    return (end > start) ? end - start : 0;
+}
+
+/**
+ * Record how long an RPC spent in each RpcStage. This method should only
+ * be invoked in the dispatch thread.
+ *
+ * \param opcode
+ *      Opcode of the RPC; nothing is recorded for invalid opcodes.
+ * \param times
+ *      The RPC's progress through the server.
+ * \param replySent
+ *      Cycles::rdtsc() time when the transport accepted the RPC's reply.
+ */
+void
+ServiceManager::recordRpcStages(uint32_t opcode,
+        const Transport::ServerRpc::StageTimes& times, uint64_t replySent)
+{
+    if (opcode >= WireFormat::ILLEGAL_RPC_TYPE)
+        return;
+    StageHistograms* histograms = stageHistograms[opcode].load();
+    if (histograms == NULL) {
+        histograms = new StageHistograms();
+
+        // Make sure the histograms are fully constructed before other
+        // threads can find them.
+        Fence::leave();
+        stageHistograms[opcode].store(histograms);
+    }
+
+    uint64_t intervals[NUM_RPC_STAGES];
+    intervals[RECEIVE] = elapsed(times.received, times.dispatched);
+    intervals[QUEUE] = elapsed(times.dispatched, times.handedOff);
+    intervals[HANDOFF] = elapsed(times.handedOff, times.started);
+    intervals[EXECUTE] = elapsed(times.started, times.completed);
+    intervals[LOOKUP] = times.lookupCycles;
+    intervals[SYNC] = times.syncCycles;
+    intervals[REPLY] = elapsed(times.completed, replySent);
+    intervals[TOTAL] = elapsed(times.received, replySent);
+    for (int i = 0; i < NUM_RPC_STAGES; i++) {
+        // Most RPCs never look up objects or wait for replication.
+        if ((i == LOOKUP || i == SYNC) && intervals[i] == 0)
+            continue;
+        histograms->stages[i].storeSample(
+                Cycles::toNanoseconds(intervals[i]));
+    }
+
+    metrics->rpcStage.count++;
+    metrics->rpcStage.receiveTicks += intervals[RECEIVE];
+    metrics->rpcStage.queueTicks += intervals[QUEUE];
+    metrics->rpcStage.handoffTicks += intervals[HANDOFF];
+    metrics->rpcStage.executeTicks += intervals[EXECUTE];
+    metrics->rpcStage.lookupTicks += intervals[LOOKUP];
+    metrics->rpcStage.syncTicks += intervals[SYNC];
+    metrics->rpcStage.replyTicks += intervals[REPLY];
+}
+
 /**
  * Wait for an RPC request to appear in the testRpcs queue, but give up if
  * it takes too long.  This method is intended only for testing (it only
@@ -367,7 +593,18 @@ ServiceManager::workerMain(Worker* worker)
             worker->threadWork.start();
             Service::Rpc rpc(worker, &worker->rpc->requestPayload,
                     &worker->rpc->replyPayload);
+
+            uint64_t start = Cycles::rdtsc();
+            worker->rpc->stageTimes.started = start;
+            RpcStageTimer::reset();
             worker->serviceInfo->service.handleRpc(&rpc);
+            uint64_t stop = Cycles::rdtsc();
+            worker->recordServiceTime(worker->opcode, stop - start);
+
+            // If the service already asked for the reply to be sent, the
+            // RPC may be gone by now.
+            if (!rpc.replied)
+                worker->completeStages(stop);
 
             worker->threadWork.stop();
 
@@ -394,6 +631,100 @@ ServiceManager::workerMain(Worker* worker)
     }
 }
 
+/**
+ * Construct the ServiceInfo for a newly added service.
+ *
+ * \param service
+ *      The service; its priority classes and thread reservations are
+ *      fetched once here.
+ */
+ServiceManager::ServiceInfo::ServiceInfo(Service& service)
+    : service(service)
+    , maxThreads(service.maxThreads())
+    , requestsRunning(0)
+    , priorities()
+    , reserved()
+    , running()
+    , sharedThreads(maxThreads)
+    , waitingRpcs()
+{
+    for (int i = 0; i < WireFormat::ILLEGAL_RPC_TYPE; i++) {
+        Service::RpcPriority priority = service.getRpcPriority(
+                static_cast<WireFormat::Opcode>(i));
+        assert(priority < Service::NUM_PRIORITIES);
+        priorities[i] = downCast<uint8_t>(priority);
+    }
+
+    // Leave at least one shared thread, so that RPCs in classes without
+    // reservations can still run.
+    for (int i = 0; i < Service::NUM_PRIORITIES; i++) {
+        reserved[i] = std::max(0, std::min(sharedThreads - 1,
+                service.reservedThreads(
+                    static_cast<Service::RpcPriority>(i))));
+        sharedThreads -= reserved[i];
+    }
+}
+
+/**
+ * Returns true if an RPC in the given class may be started now without
+ * exceeding the service's concurrency limit or using threads reserved
+ * for other classes.
+ *
+ * \param priority
+ *      Service::RpcPriority of the RPC.
+ */
+bool
+ServiceManager::ServiceInfo::canStart(int priority)
+{
+    if (running[priority] < reserved[priority])
+        return true;
+    int sharedInUse = 0;
+    for (int i = 0; i < Service::NUM_PRIORITIES; i++)
+        sharedInUse += std::max(0, running[i] - reserved[i]);
+    return sharedInUse < sharedThreads;
+}
+
+/**
+ * Returns the class of the waiting RPC that should be started next, or
+ * -1 if there is none that may be started now. Classes are considered in
+ * priority order; RPCs within a class are started in arrival order.
+ */
+int
+ServiceManager::ServiceInfo::nextWaitingPriority()
+{
+    for (int i = 0; i < Service::NUM_PRIORITIES; i++) {
+        if (!waitingRpcs[i].empty() && canStart(i))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Destroy a Worker. Its thread must already have exited.
+ */
+Worker::~Worker()
+{
+    for (int i = 0; i < WireFormat::ILLEGAL_RPC_TYPE; i++)
+        delete serviceTimes[i].load();
+}
+
+/**
+ * Record in the worker's current RPC that it has finished executing, along
+ * with the time spent in stages measured by RpcStageTimer. This method
+ * should only be invoked in the worker's own thread, before the RPC is
+ * passed back to the dispatch thread.
+ *
+ * \param completed
+ *      Cycles::rdtsc() time when execution finished.
+ */
+void
+Worker::completeStages(uint64_t completed)
+{
+    rpc->stageTimes.completed = completed;
+    rpc->stageTimes.lookupCycles = RpcStageTimer::get(RpcStageTimer::LOOKUP);
+    rpc->stageTimes.syncCycles = RpcStageTimer::get(RpcStageTimer::SYNC);
+}
+
 /**
  * Force this worker's thread to exit (and don't return until it has exited).
  * This method is only used during testing and ServiceManager destruction.
@@ -425,6 +756,32 @@ Worker::exit()
     exited = true;
 }
 
+/**
+ * Record how long this worker took to execute an RPC. This method should
+ * only be invoked in the worker's own thread.
+ *
+ * \param opcode
+ *      Opcode of the RPC; nothing is recorded for invalid opcodes.
+ * \param cycles
+ *      Time, in Cycles::rdtsc() ticks, the worker spent executing it.
+ */
+void
+Worker::recordServiceTime(uint32_t opcode, uint64_t cycles)
+{
+    if (opcode >= WireFormat::ILLEGAL_RPC_TYPE)
+        return;
+    LogLinearHistogram* histogram = serviceTimes[opcode].load();
+    if (histogram == NULL) {
+        histogram = new LogLinearHistogram();
+
+        // Make sure the histogram is fully constructed before other
+        // threads can find it.
+        Fence::leave();
+        serviceTimes[opcode].store(histogram);
+    }
+    histogram->storeSample(Cycles::toNanoseconds(cycles));
+}
+
 /**
  * This method is invoked by the dispatch thread to pass an RPC to an idle
  * worker.  It should only be invoked when the worker is idle (i.e. #rpc is
@@ -464,6 +821,7 @@ Worker::handoff(Transport::ServerRpc* newRpc)
 void
 Worker::sendReply()
 {
+    completeStages(Cycles::rdtsc());
     Fence::leave();
     state.store(POSTPROCESSING);
 }
@@ -16,13 +16,20 @@
 #ifndef RAMCLOUD_SERVICEMANAGER_H
 #define RAMCLOUD_SERVICEMANAGER_H
 
+#include <atomic>
 #include <queue>
 
 #include "Dispatch.h"
+#include "Histogram.h"
+#include "LogLinearHistogram.h"
 #include "Service.h"
+#include "SpinLock.h"
 #include "Transport.h"
 #include "WireFormat.h"
 
+#include "RpcStageMetrics.pb.h"
+#include "ServerStatistics.pb.h"
+
 namespace RAMCloud {
 
 /**
@@ -33,11 +40,47 @@ namespace RAMCloud {
  */
 class ServiceManager : Dispatch::Poller {
   public:
+    /**
+     * The stages of an incoming RPC's life on the server. The time RPCs of
+     * each opcode spend in each stage is recorded when their replies are
+     * sent; see getRpcStageMetrics().
+     */
+    enum RpcStage {
+        /// From the transport creating the RPC (usually when its first
+        /// packet arrives) until it passes the complete request to
+        /// handleRpc.
+        RECEIVE,
+        /// Waiting for a worker thread because the service was already
+        /// running as many RPCs of the same priority as it may.
+        QUEUE,
+        /// From handing the RPC to a worker thread until the worker starts
+        /// executing it, including waking up the worker if it was asleep.
+        HANDOFF,
+        /// The worker executing the RPC, up to the point where the reply
+        /// is ready. Includes LOOKUP and SYNC.
+        EXECUTE,
+        /// The part of EXECUTE spent looking up objects in ObjectManager.
+        LOOKUP,
+        /// The part of EXECUTE spent waiting for log entries to be
+        /// replicated to backups.
+        SYNC,
+        /// From the reply being ready until the transport has accepted it,
+        /// including the time for the dispatch thread to notice.
+        REPLY,
+        /// From the transport creating the RPC until the transport has
+        /// accepted its reply.
+        TOTAL,
+        NUM_RPC_STAGES
+    };
+
     explicit ServiceManager(Context* context);
     ~ServiceManager();
 
     void addService(Service& service, WireFormat::ServiceType type);
     void exitWorker();
+    uint32_t getActiveRpcCount();
+    void getRpcStageMetrics(ProtoBuf::RpcStageMetrics* stageMetrics);
+    void getStatistics(ProtoBuf::ServerStatistics* serverStats);
     void handleRpc(Transport::ServerRpc* rpc);
     bool idle();
     static void init();
@@ -55,10 +98,23 @@ class ServiceManager : Dispatch::Poller {
     /// testing.
     static int pollMicros;
     static void workerMain(Worker* worker);
+    void recordQueueingDelay(int priority, uint64_t arrivalTime);
+    void recordRpcStages(uint32_t opcode,
+            const Transport::ServerRpc::StageTimes& times,
+            uint64_t replySent);
 
     /// Shared RAMCloud information.
     Context* context;
 
+    // An RPC that is waiting for a worker thread.
+    struct WaitingRpc {
+        WaitingRpc(Transport::ServerRpc* rpc, uint64_t arrivalTime)
+            : rpc(rpc), arrivalTime(arrivalTime) {}
+        Transport::ServerRpc* rpc;     /// The request.
+        uint64_t arrivalTime;          /// Dispatch::currentTime when
+                                       /// handleRpc was invoked for #rpc.
+    };
+
     // Contains one entry for each possible RpcService value, which is used
     // to dispatch requests to the service associated with that RpcService
     // value (if there is one).
@@ -72,16 +128,26 @@ class ServiceManager : Dispatch::Poller {
                                        /// executed by the service (each in a
                                        /// separate thread); must never be
                                        /// greater than maxThreads.
-        std::queue<Transport::ServerRpc*> waitingRpcs;
-                                       /// Requests that cannot execute until
-                                       /// an existing request completes
-                                       /// (requestsRunning == maxThreads).
-        explicit ServiceInfo(Service& service)
-            : service(service)
-            , maxThreads(service.maxThreads())
-            , requestsRunning(0)
-            , waitingRpcs()
-        {}
+        uint8_t priorities[WireFormat::ILLEGAL_RPC_TYPE];
+                                       /// Service::RpcPriority of each
+                                       /// opcode.
+        int reserved[Service::NUM_PRIORITIES];
+                                       /// Threads that only RPCs of each
+                                       /// class may use; see
+                                       /// Service::reservedThreads.
+        int running[Service::NUM_PRIORITIES];
+                                       /// The number of RPCs of each class
+                                       /// currently being executed.
+        int sharedThreads;             /// maxThreads minus all of the
+                                       /// reserved threads; these may be used
+                                       /// by RPCs of any class.
+        std::queue<WaitingRpc> waitingRpcs[Service::NUM_PRIORITIES];
+                                       /// Requests of each class that cannot
+                                       /// execute until an existing request
+                                       /// completes.
+        explicit ServiceInfo(Service& service);
+        bool canStart(int priority);
+        int nextWaitingPriority();
         friend class Worker;
         DISALLOW_COPY_AND_ASSIGN(ServiceInfo);
     };
@@ -96,9 +162,40 @@ class ServiceManager : Dispatch::Poller {
     // offer a fast wakeup).
     std::vector<Worker*> idleThreads;
 
+    // Number of incoming RPCs that have been dispatched to a service but have
+    // not yet been replied to, including those waiting for a worker thread.
+    // Only modified by the dispatch thread, but may be read by any thread
+    // (see getActiveRpcCount()).
+    std::atomic<uint32_t> activeRpcs;
+
     // Number of services that are currently registered.
     int serviceCount;
 
+    // Distribution of the time RPCs of each Service::RpcPriority spend
+    // waiting for a worker thread, in microseconds. Only updated by the
+    // dispatch thread, but may be read by any thread under #statsLock
+    // (see getStatistics()).
+    std::vector<Histogram> queueingDelays;
+
+    // Every worker thread created by addService; used to collect their
+    // service time histograms (see getStatistics()).
+    std::vector<Worker*> allWorkers;
+
+    // Protects #queueingDelays and #allWorkers.
+    SpinLock statsLock;
+
+    // The distributions of the time RPCs of one opcode have spent in each
+    // RpcStage, in nanoseconds.
+    struct StageHistograms {
+        LogLinearHistogram stages[NUM_RPC_STAGES];
+    };
+
+    // Stage times for each opcode. Each entry is allocated the first time
+    // an RPC with the opcode is replied to; NULL until then. Only the
+    // dispatch thread records into these, without locking; other threads
+    // may read them (see getRpcStageMetrics()).
+    Atomic<StageHistograms*> stageHistograms[WireFormat::ILLEGAL_RPC_TYPE];
+
     // Used for testing: if no services are registered, incoming RPCs are
     // queued here.
     std::queue<Transport::ServerRpc*> testRpcs;
@@ -138,6 +235,14 @@ class Worker {
     int busyIndex;                     /// Location of this worker in
                                        /// #busyThreads, or -1 if this worker
                                        /// is idle.
+    int priority;                      /// Service::RpcPriority of the
+                                       /// last request executed by this
+                                       /// worker.
+    uint32_t opcode;                   /// Opcode of the last request executed
+                                       /// by this worker (fetched before it
+                                       /// executes, since services may
+                                       /// modify the request), or
+                                       /// ILLEGAL_RPC_TYPE if it had none.
     Atomic<int> state;                 /// Shared variable used to pass RPCs
                                        /// between the dispatch thread and this
                                        /// worker.
@@ -175,13 +280,28 @@ class Worker {
     bool exited;                       /// True means the worker is no longer
                                        /// running.
 
+    Atomic<LogLinearHistogram*> serviceTimes[WireFormat::ILLEGAL_RPC_TYPE];
+                                       /// Time this worker has spent executing
+                                       /// RPCs of each opcode, in nanoseconds.
+                                       /// Each histogram is allocated the
+                                       /// first time the worker executes the
+                                       /// opcode; NULL until then. Only the
+                                       /// worker records into these, without
+                                       /// locking; other threads may read them
+                                       /// (see ServiceManager::getStatistics).
+
     explicit Worker(Context* context)
         : context(context), serviceInfo(NULL), thread(), rpc(NULL),
-          busyIndex(-1), state(POLLING), exited(false),
+          busyIndex(-1), priority(0), opcode(WireFormat::ILLEGAL_RPC_TYPE),
+          state(POLLING), exited(false),
+          serviceTimes(),
           threadWork(&ReadThreadingCost_MetricSet::threadWork, false)
         {}
+    ~Worker();
+    void completeStages(uint64_t completed);
     void exit();
     void handoff(Transport::ServerRpc* rpc);
+    void recordServiceTime(uint32_t opcode, uint64_t cycles);
 
   public:
     ReadThreadingCost_MetricSet::Interval threadWork;
@@ -135,6 +135,26 @@ TEST_F(ServiceManagerTest, addService) {
     EXPECT_EQ(3U, manager1.idleThreads.size());
 }
 
+TEST_F(ServiceManagerTest, serviceInfo_reservations) {
+    MockService mock(3);
+    mock.priorities[1] = Service::HIGH_PRIORITY;
+    mock.reserved[Service::HIGH_PRIORITY] = 2;
+    mock.reserved[Service::LOW_PRIORITY] = 2;
+    ServiceManager::ServiceInfo info(mock);
+    EXPECT_EQ(Service::HIGH_PRIORITY, info.priorities[1]);
+    EXPECT_EQ(Service::NORMAL_PRIORITY, info.priorities[2]);
+    EXPECT_EQ(2, info.reserved[Service::HIGH_PRIORITY]);
+    EXPECT_EQ(0, info.reserved[Service::LOW_PRIORITY]);
+    EXPECT_EQ(1, info.sharedThreads);
+
+    EXPECT_TRUE(info.canStart(Service::NORMAL_PRIORITY));
+    info.running[Service::NORMAL_PRIORITY] = 1;
+    EXPECT_FALSE(info.canStart(Service::NORMAL_PRIORITY));
+    EXPECT_TRUE(info.canStart(Service::HIGH_PRIORITY));
+    info.running[Service::HIGH_PRIORITY] = 2;
+    EXPECT_FALSE(info.canStart(Service::HIGH_PRIORITY));
+}
+
 TEST_F(ServiceManagerTest, handleRpc_noHeader) {
     TestLog::Enable _;
     MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
@@ -170,10 +190,61 @@ TEST_F(ServiceManagerTest, handleRpc_concurrencyLimitExceeded) {
     manager->handleRpc(rpc2);
     manager->handleRpc(rpc3);
     EXPECT_EQ(3U, manager->busyThreads.size());
-    EXPECT_EQ(0U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(0U, manager->services[1]->waitingRpcs[
+            Service::NORMAL_PRIORITY].size());
     manager->handleRpc(rpc4);
     EXPECT_EQ(3U, manager->busyThreads.size());
-    EXPECT_EQ(1U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(1U, manager->services[1]->waitingRpcs[
+            Service::NORMAL_PRIORITY].size());
+}
+
+TEST_F(ServiceManagerTest, handleRpc_priorities) {
+    manager.destroy();
+    service.priorities[1] = Service::HIGH_PRIORITY;
+    service.priorities[2] = Service::LOW_PRIORITY;
+    service.reserved[Service::HIGH_PRIORITY] = 1;
+    manager.construct(&context);
+    manager->addService(service, WireFormat::BACKUP_SERVICE);
+    ServiceManager::ServiceInfo* info = manager->services[1].get();
+
+    // Low-priority RPCs may only use the 2 shared threads.
+    service.gate = -1;
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10002 1"));
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10002 2"));
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10002 3"));
+    EXPECT_EQ(2U, manager->busyThreads.size());
+    EXPECT_EQ(1U, info->waitingRpcs[Service::LOW_PRIORITY].size());
+
+    // A high-priority RPC gets the reserved thread.
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10001 4"));
+    EXPECT_EQ(3U, manager->busyThreads.size());
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10001 5"));
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10000 6"));
+    EXPECT_EQ(1U, info->waitingRpcs[Service::HIGH_PRIORITY].size());
+    EXPECT_EQ(1U, info->waitingRpcs[Service::NORMAL_PRIORITY].size());
+
+    // Freed threads go to the highest-priority waiting RPC.
+    service.gate = 1;
+    waitUntilDone(1);
+    manager->poll();
+    EXPECT_EQ(0U, info->waitingRpcs[Service::HIGH_PRIORITY].size());
+    EXPECT_EQ(1U, info->waitingRpcs[Service::NORMAL_PRIORITY].size());
+    EXPECT_EQ(1U, info->waitingRpcs[Service::LOW_PRIORITY].size());
+    EXPECT_EQ(1, info->running[Service::LOW_PRIORITY]);
+    EXPECT_EQ(2, info->running[Service::HIGH_PRIORITY]);
+
+    service.gate = 2;
+    waitUntilDone(1);
+    manager->poll();
+    EXPECT_EQ(0U, info->waitingRpcs[Service::NORMAL_PRIORITY].size());
+    EXPECT_EQ(1U, info->waitingRpcs[Service::LOW_PRIORITY].size());
+    EXPECT_EQ(1, info->running[Service::NORMAL_PRIORITY]);
 }
 
 TEST_F(ServiceManagerTest, handleRpc_handoffToWorker) {
@@ -188,6 +259,68 @@ TEST_F(ServiceManagerTest, handleRpc_handoffToWorker) {
     EXPECT_EQ(3U, manager->idleThreads.size());
 }
 
+TEST_F(ServiceManagerTest, getStatistics) {
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10000 1"));
+    ProtoBuf::ServerStatistics stats;
+    manager->getStatistics(&stats);
+    ASSERT_EQ(3, stats.rpc_queue_entry_size());
+    EXPECT_EQ("high", stats.rpc_queue_entry(0).priority());
+    EXPECT_EQ("normal", stats.rpc_queue_entry(1).priority());
+    EXPECT_EQ("low", stats.rpc_queue_entry(2).priority());
+    EXPECT_EQ(0, stats.rpc_queue_entry(0).queueing_delay().bucket_size());
+    const ProtoBuf::Histogram& normal =
+            stats.rpc_queue_entry(1).queueing_delay();
+    ASSERT_EQ(1, normal.bucket_size());
+    EXPECT_EQ(0U, normal.bucket(0).index());
+    EXPECT_EQ(1U, normal.bucket(0).count());
+}
+
+TEST_F(ServiceManagerTest, getRpcStageMetrics) {
+    ProtoBuf::RpcStageMetrics stageMetrics;
+    manager->getRpcStageMetrics(&stageMetrics);
+    EXPECT_EQ(0, stageMetrics.entry_size());
+
+    // Opcode 7 is PING.
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10007 1"));
+    waitUntilDone(1);
+    manager->poll();
+    manager->getRpcStageMetrics(&stageMetrics);
+    ASSERT_EQ(1, stageMetrics.entry_size());
+    const ProtoBuf::RpcStageMetrics::Entry& entry = stageMetrics.entry(0);
+    EXPECT_EQ("PING", entry.opcode());
+
+    // The mock service never looks up objects or syncs.
+    string stages;
+    foreach (const ProtoBuf::RpcStageMetrics::Stage& stage, entry.stage()) {
+        stages += stage.name() + " ";
+        EXPECT_EQ(1UL, LogLinearHistogram(stage.latency()).getTotalSamples());
+    }
+    EXPECT_EQ("receive queue handoff execute reply total ", stages);
+}
+
+TEST_F(ServiceManagerTest, getStatistics_serviceTimes) {
+    ProtoBuf::ServerStatistics stats;
+    manager->getStatistics(&stats);
+    EXPECT_EQ(0, stats.rpc_service_time_entry_size());
+
+    // Opcode 7 is PING.
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10007 1"));
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10007 2"));
+    waitUntilDone(2);
+    manager->poll();
+    stats.Clear();
+    manager->getStatistics(&stats);
+    ASSERT_EQ(1, stats.rpc_service_time_entry_size());
+    EXPECT_EQ("PING", stats.rpc_service_time_entry(0).opcode());
+    LogLinearHistogram serviceTime(
+            stats.rpc_service_time_entry(0).service_time());
+    EXPECT_EQ(2UL, serviceTime.getTotalSamples());
+}
+
 TEST_F(ServiceManagerTest, idle) {
     EXPECT_TRUE(manager->idle());
     // Start one RPC.
@@ -220,7 +353,9 @@ TEST_F(ServiceManagerTest, poll_basics) {
     manager->handleRpc(rpc3);
     manager->handleRpc(rpc4);
     manager->handleRpc(rpc5);
-    EXPECT_EQ(2U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(2U, manager->services[1]->waitingRpcs[
+            Service::NORMAL_PRIORITY].size());
+    EXPECT_EQ(5U, manager->getActiveRpcCount());
 
     // Allow 2 of the requests to complete, and make sure that the remaining
     // 2 start service.
@@ -229,9 +364,11 @@ TEST_F(ServiceManagerTest, poll_basics) {
     service.gate = 2;
     waitUntilDone(2);
     manager->poll();
-    EXPECT_EQ(0U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(0U, manager->services[1]->waitingRpcs[
+            Service::NORMAL_PRIORITY].size());
     EXPECT_EQ("serverReply: 0x10001 3 | serverReply: 0x10001 2",
             transport.outputLog);
+    EXPECT_EQ(3U, manager->getActiveRpcCount());
 
     // Allow the request in slot 0 of busyThreads to complete.
     transport.outputLog.clear();
@@ -249,6 +386,7 @@ TEST_F(ServiceManagerTest, poll_basics) {
     manager->poll();
     EXPECT_EQ("serverReply: 0x10001 5 | serverReply: 0x10001 4",
             transport.outputLog);
+    EXPECT_EQ(0U, manager->getActiveRpcCount());
 }
 
 TEST_F(ServiceManagerTest, poll_postprocessing) {
@@ -281,6 +419,34 @@ TEST_F(ServiceManagerTest, poll_postprocessing) {
 
 // No tests for waitForRpc: this method is only used in tests.
 
+TEST_F(ServiceManagerTest, recordRpcStages) {
+    Transport::ServerRpc::StageTimes times;
+    times.received = 1000;
+    times.dispatched = 2000;
+    times.handedOff = 1500;    // Clocks on different cores may disagree.
+    times.started = 5000;
+    times.completed = 9000;
+    times.lookupCycles = 1000;
+    manager->recordRpcStages(WireFormat::READ, times, 10000);
+    manager->recordRpcStages(WireFormat::ILLEGAL_RPC_TYPE, times, 10000);
+
+    ServiceManager::StageHistograms* histograms =
+            manager->stageHistograms[WireFormat::READ].load();
+    ASSERT_TRUE(histograms != NULL);
+    LogLinearHistogram* stages = histograms->stages;
+    EXPECT_EQ(Cycles::toNanoseconds(1000),
+            stages[ServiceManager::RECEIVE].getMax());
+    EXPECT_EQ(0UL, stages[ServiceManager::QUEUE].getMax());
+    EXPECT_EQ(Cycles::toNanoseconds(4000),
+            stages[ServiceManager::EXECUTE].getMax());
+    EXPECT_EQ(1UL, stages[ServiceManager::LOOKUP].getTotalSamples());
+    EXPECT_EQ(0UL, stages[ServiceManager::SYNC].getTotalSamples());
+    EXPECT_EQ(Cycles::toNanoseconds(1000),
+            stages[ServiceManager::REPLY].getMax());
+    EXPECT_EQ(Cycles::toNanoseconds(9000),
+            stages[ServiceManager::TOTAL].getMax());
+}
+
 TEST_F(ServiceManagerTest, workerMain_goToSleep) {
     // Workers were already created when the test initialized.  Initially
     // the (first) worker should not go to sleep (time appears to
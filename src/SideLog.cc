@@ -90,34 +90,76 @@ SideLog::~SideLog()
 void
 SideLog::commit()
 {
-    Tub<Lock> lock;
-    lock.construct(appendLock);
+    vector<SideLog*> sideLogs;
+    sideLogs.push_back(this);
+    commitAll(sideLogs);
+}
 
-    if (segments.empty())
+/**
+ * Commit the entries appended to several SideLogs of the same log at once.
+ * This is equivalent to invoking commit() on each of them, except that the
+ * log's head is rolled over only once, so all of the SideLogs' segments
+ * become part of the on-disk log in the same digest. It is used when several
+ * threads each append to their own SideLog (for example, during parallel
+ * recovery replay; see ParallelSegmentReplayer) and their entries need to
+ * become durable together.
+ *
+ * When this method returns, all of the given SideLogs are reset to the state
+ * after their construction and may be reused.
+ *
+ * \param sideLogs
+ *      The SideLogs to commit. They must all have been constructed for the
+ *      same log.
+ */
+void
+SideLog::commitAll(vector<SideLog*>& sideLogs)
+{
+    if (sideLogs.empty())
         return;
 
-    // The last segment will still be open. Close it and begin replication.
-    LogSegment* lastSegmentAllocated = segments.back();
-    lastSegmentAllocated->close();
-    lastSegmentAllocated->replicatedSegment->close();
+    Log* log = sideLogs[0]->log;
+    vector<std::unique_lock<SpinLock>> locks;
+    foreach (SideLog* sideLog, sideLogs) {
+        assert(sideLog->log == log);
+        locks.push_back(std::unique_lock<SpinLock>(sideLog->appendLock));
+    }
+
+    // The last segment of each SideLog will still be open. Close it and begin
+    // replication.
+    bool anySegments = false;
+    foreach (SideLog* sideLog, sideLogs) {
+        if (sideLog->segments.empty())
+            continue;
+        LogSegment* lastSegmentAllocated = sideLog->segments.back();
+        lastSegmentAllocated->close();
+        lastSegmentAllocated->replicatedSegment->close();
+        anySegments = true;
+    }
+
+    if (!anySegments)
+        return;
 
     // Ensure that replication has completed on all segments.
-    foreach (LogSegment* segment, segments)
-        segment->replicatedSegment->sync();
+    foreach (SideLog* sideLog, sideLogs) {
+        foreach (LogSegment* segment, sideLog->segments)
+            segment->replicatedSegment->sync();
+    }
 
     // Tell SegmentManager to make these segments part of the log. They will
     // become part of the on-disk log when the next head segment is opened and
-    // a new digest is written.
-    segmentManager->injectSideSegments(segments);
-
-    // Wipe the list so that this SideLog can be used again to commit a
-    // different batch of entries.
-    segments.clear();
+    // a new digest is written. Wipe the lists so that these SideLogs can be
+    // used again to commit a different batch of entries.
+    foreach (SideLog* sideLog, sideLogs) {
+        if (sideLog->segments.empty())
+            continue;
+        sideLog->segmentManager->injectSideSegments(sideLog->segments);
+        sideLog->segments.clear();
+    }
 
     // Force the head to roll over so a new digest goes out. The caller also
     // acquires the appendLock, so drop it first. This is safe. We don't care
     // about any races. We only want the log head to change.
-    lock.destroy();
+    locks.clear();
     log->rollHeadOver();
 }
 
@@ -72,6 +72,7 @@ class SideLog : public AbstractLog {
     SideLog(Log* log, LogCleaner* cleaner);
     ~SideLog();
     void commit();
+    static void commitAll(vector<SideLog*>& sideLogs);
 
   PRIVATE:
     LogSegment* allocNextSegment(bool mustNotFail);
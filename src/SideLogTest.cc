@@ -139,6 +139,32 @@ TEST_F(SideLogTest, commit) {
     EXPECT_EQ(headId, l.head->id);
 }
 
+TEST_F(SideLogTest, commitAll) {
+    SideLog sl1(&l);
+    SideLog sl2(&l);
+    SideLog sl3(&l);
+    vector<SideLog*> sideLogs = { &sl1, &sl2, &sl3 };
+
+    // empty sidelogs shouldn't alter the log
+    uint64_t headId = l.head->id;
+    SideLog::commitAll(sideLogs);
+    EXPECT_EQ(headId, l.head->id);
+
+    EXPECT_TRUE(sl1.append(LOG_ENTRY_TYPE_OBJ, "hi", 2));
+    EXPECT_TRUE(sl3.append(LOG_ENTRY_TYPE_OBJ, "there", 5));
+    LogSegment* seg1 = sl1.segments[0];
+    LogSegment* seg3 = sl3.segments[0];
+
+    SideLog::commitAll(sideLogs);
+    EXPECT_TRUE(seg1->closed);
+    EXPECT_TRUE(seg3->closed);
+    EXPECT_TRUE(sl1.segments.empty());
+    EXPECT_TRUE(sl3.segments.empty());
+
+    // the head should only have been rolled over once for all of them
+    EXPECT_EQ(headId + 3, l.head->id);
+}
+
 static void
 freeSegmentSoon(SegmentManager* segmentManager, LogSegment* segment) {
     usleep(1000);
@@ -0,0 +1,240 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Common.h"
+#include "Initialize.h"
+#include "Memory.h"
+#include "RawMetrics.h"
+#include "SlabAllocator.h"
+
+namespace RAMCloud {
+
+SlabAllocator::Depot* SlabAllocator::depots = NULL;
+__thread SlabAllocator::ThreadCache* SlabAllocator::threadCache = NULL;
+pthread_key_t SlabAllocator::threadCacheKey;
+
+// Make sure the depots exist before main() runs (and therefore before
+// there can be more than one thread).
+static Initialize _(SlabAllocator::init);
+
+/**
+ * Create the depots. This is invoked automatically before main() runs,
+ * and also by the first allocation, in case that happens during static
+ * initialization; later calls do nothing.
+ */
+void
+SlabAllocator::init()
+{
+    if (depots != NULL)
+        return;
+    depots = new Depot[NUM_CLASSES];
+    pthread_key_create(&threadCacheKey, releaseThreadCache);
+}
+
+/**
+ * Allocate a block that is too large for any size class.
+ *
+ * \param size
+ *      Number of bytes needed.
+ */
+void*
+SlabAllocator::allocLarge(size_t size)
+{
+    metrics->slabAllocator.largeAllocCount++;
+    return Memory::xmalloc(HERE, size);
+}
+
+/**
+ * Allocate a block when the thread's loaded magazine is empty (or hasn't
+ * been created yet): swap in the previous magazine if it has blocks,
+ * otherwise trade with the depot or carve up a new slab.
+ *
+ * \param cache
+ *      The calling thread's cache.
+ * \param sizeClass
+ *      Size class of the block.
+ */
+void*
+SlabAllocator::allocSlow(ThreadCache* cache, int sizeClass)
+{
+    Magazine*& loaded = cache->loaded[sizeClass];
+    Magazine*& previous = cache->previous[sizeClass];
+    if (previous != NULL && previous->count > 0) {
+        std::swap(loaded, previous);
+    } else {
+        Depot& depot = depots[sizeClass];
+        Magazine* full = NULL;
+        Magazine* empty = NULL;
+        {
+            std::lock_guard<SpinLock> _(depot.mutex);
+            if (previous != NULL)
+                depot.empty.push_back(previous);
+            if (!depot.full.empty()) {
+                full = depot.full.back();
+                depot.full.pop_back();
+            } else if (!depot.empty.empty()) {
+                empty = depot.empty.back();
+                depot.empty.pop_back();
+            }
+        }
+        if (full != NULL) {
+            metrics->slabAllocator.depotAllocCount++;
+        } else {
+            full = newSlab(sizeClass, empty);
+        }
+        previous = loaded;
+        loaded = full;
+    }
+    flushAllocCount(cache);
+    metrics->slabAllocator.allocCount++;
+    return loaded->rounds[--loaded->count];
+}
+
+/**
+ * Add the allocations a thread has served from its magazines to the
+ * shared allocation count.
+ *
+ * \param cache
+ *      The calling thread's cache.
+ */
+void
+SlabAllocator::flushAllocCount(ThreadCache* cache)
+{
+    if (cache->allocCount > 0) {
+        metrics->slabAllocator.allocCount += cache->allocCount;
+        cache->allocCount = 0;
+    }
+}
+
+/**
+ * Free a block when the thread's loaded magazine is full (or hasn't been
+ * created yet): swap in the previous magazine if it is empty, otherwise
+ * give the full one to the depot in exchange for an empty one.
+ *
+ * \param cache
+ *      The calling thread's cache.
+ * \param sizeClass
+ *      Size class of the block.
+ * \param block
+ *      The block being freed.
+ */
+void
+SlabAllocator::freeSlow(ThreadCache* cache, int sizeClass, void* block)
+{
+    Magazine*& loaded = cache->loaded[sizeClass];
+    Magazine*& previous = cache->previous[sizeClass];
+    if (previous != NULL && previous->count == 0) {
+        std::swap(loaded, previous);
+    } else {
+        Depot& depot = depots[sizeClass];
+        Magazine* empty = NULL;
+        {
+            std::lock_guard<SpinLock> _(depot.mutex);
+            if (previous != NULL)
+                depot.full.push_back(previous);
+            if (!depot.empty.empty()) {
+                empty = depot.empty.back();
+                depot.empty.pop_back();
+            }
+        }
+        if (previous != NULL)
+            metrics->slabAllocator.depotFreeCount++;
+        if (empty == NULL) {
+            empty = new Magazine(std::min(MAX_ROUNDS, std::max(2U,
+                    MAGAZINE_BYTES / getClassSize(sizeClass))));
+        }
+        previous = loaded;
+        loaded = empty;
+    }
+    loaded->rounds[loaded->count++] = block;
+}
+
+/**
+ * Allocate a new slab of memory and divide it into blocks.
+ *
+ * \param sizeClass
+ *      Size class of the blocks.
+ * \param magazine
+ *      An empty magazine to hold the blocks, or NULL to create one.
+ * \return
+ *      A full magazine holding the new blocks.
+ */
+SlabAllocator::Magazine*
+SlabAllocator::newSlab(int sizeClass, Magazine* magazine)
+{
+    uint32_t blockSize = getClassSize(sizeClass);
+    if (magazine == NULL) {
+        magazine = new Magazine(std::min(MAX_ROUNDS,
+                std::max(2U, MAGAZINE_BYTES / blockSize)));
+    }
+    size_t slabSize = size_t(magazine->capacity) * blockSize;
+    char* slab = static_cast<char*>(Memory::xmemalign(HERE, 64, slabSize));
+
+    // Push the blocks in reverse so that they are handed out in address
+    // order.
+    for (uint32_t i = magazine->capacity; i > 0; i--)
+        magazine->rounds[magazine->count++] = slab + (i - 1) * blockSize;
+    metrics->slabAllocator.slabCount++;
+    metrics->slabAllocator.slabBytes += slabSize;
+    return magazine;
+}
+
+/**
+ * Create a cache for the calling thread and arrange for its magazines to
+ * be returned to the depot when the thread exits.
+ */
+SlabAllocator::ThreadCache*
+SlabAllocator::newThreadCache()
+{
+    init();
+    threadCache = new ThreadCache();
+    pthread_setspecific(threadCacheKey, threadCache);
+    return threadCache;
+}
+
+/**
+ * Invoked by pthreads when a thread with a cache exits: gives all of the
+ * thread's magazines to the depot and deletes its cache.
+ *
+ * \param arg
+ *      The thread's ThreadCache.
+ */
+void
+SlabAllocator::releaseThreadCache(void* arg)
+{
+    ThreadCache* cache = static_cast<ThreadCache*>(arg);
+    flushAllocCount(cache);
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        Depot& depot = depots[i];
+        std::lock_guard<SpinLock> _(depot.mutex);
+        Magazine* magazines[] = {cache->loaded[i], cache->previous[i]};
+        foreach (Magazine* magazine, magazines) {
+            if (magazine == NULL)
+                continue;
+            if (magazine->count > 0)
+                depot.full.push_back(magazine);
+            else
+                depot.empty.push_back(magazine);
+        }
+    }
+    delete cache;
+
+    // A destructor for other thread-local data could still allocate or
+    // free; it will get a new cache.
+    threadCache = NULL;
+    pthread_setspecific(threadCacheKey, NULL);
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,273 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SLABALLOCATOR_H
+#define RAMCLOUD_SLABALLOCATOR_H
+
+#include <pthread.h>
+
+#include "Common.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * A general-purpose allocator for the small, short-lived objects that
+ * every RPC creates and destroys, such as Buffer::Allocations, the
+ * ServerRpcs that transports allocate with ObjectPool, and RpcWrappers
+ * created with new. It follows the magazine design of Bonwick and Adams'
+ * "Magazines and Vmem" (USENIX 2001):
+ *
+ * - Requests are rounded up to one of NUM_CLASSES size classes (four per
+ *   power of two, so at most 25% of a block is wasted); requests larger
+ *   than MAX_SIZE go to malloc.
+ * - Each thread caches free blocks of each class in two magazines, small
+ *   arrays used as stacks. alloc() and free() normally just pop or push
+ *   the calling thread's magazine: no locks, atomic instructions, or
+ *   shared cache lines. Since RAMCloud's dispatch and worker threads each
+ *   have a core to themselves, these are effectively per-core caches.
+ * - When both of a thread's magazines are empty (or full), it trades one
+ *   with a global depot, which keeps lists of full and empty magazines
+ *   for each class behind a SpinLock. A block allocated by one thread may
+ *   be freed by another, as happens when a worker thread fills in an
+ *   RPC's reply and the dispatch thread sends it; full magazines then flow
+ *   through the depot from the freeing thread to the allocating one.
+ * - When the depot has no full magazines, a new slab of memory is
+ *   allocated with malloc and carved into a magazine's worth of blocks.
+ *
+ * Like ObjectPool, the allocator never returns memory to malloc: the
+ * memory used by each class stays at its peak. A thread's magazines are
+ * returned to the depot when the thread exits.
+ *
+ * Blocks are 16-byte aligned. Callers must pass the same size to free()
+ * that they passed to alloc(), in the style of C++14's sized delete.
+ */
+class SlabAllocator {
+  public:
+    /// Requests no larger than this are rounded up to MIN_SIZE.
+    static const uint32_t MIN_SHIFT = 6;
+    static const uint32_t MIN_SIZE = 1 << MIN_SHIFT;
+
+    /// Requests larger than this are passed on to malloc.
+    static const uint32_t MAX_SHIFT = 16;
+    static const uint32_t MAX_SIZE = 1 << MAX_SHIFT;
+
+    /// Number of size classes: one for MIN_SIZE, then four for each power
+    /// of two up to MAX_SIZE.
+    static const int NUM_CLASSES = 1 + 4 * (MAX_SHIFT - MIN_SHIFT);
+
+    /// Most blocks a magazine can hold.
+    static const uint32_t MAX_ROUNDS = 64;
+
+    /// Magazines for large classes hold fewer blocks, so that each
+    /// magazine caches no more than about this many bytes.
+    static const uint32_t MAGAZINE_BYTES = 128 * 1024;
+
+    /**
+     * Allocate a block of memory.
+     *
+     * \param size
+     *      Number of bytes needed.
+     * \return
+     *      A pointer to at least \a size bytes of memory, which must be
+     *      released by calling free() with the same \a size. If there isn't
+     *      enough memory, the process is terminated.
+     */
+    static void*
+    alloc(size_t size)
+    {
+        int sizeClass = getClass(size);
+        if (sizeClass < 0)
+            return allocLarge(size);
+        ThreadCache* cache = getThreadCache();
+        Magazine* magazine = cache->loaded[sizeClass];
+        if (expect_true(magazine != NULL && magazine->count > 0)) {
+            cache->allocCount++;
+            return magazine->rounds[--magazine->count];
+        }
+        return allocSlow(cache, sizeClass);
+    }
+
+    /**
+     * Release a block previously returned by alloc().
+     *
+     * \param block
+     *      The block to release.
+     * \param size
+     *      The size that was passed to alloc() for \a block.
+     */
+    static void
+    free(void* block, size_t size)
+    {
+        int sizeClass = getClass(size);
+        if (sizeClass < 0) {
+            std::free(block);
+            return;
+        }
+        ThreadCache* cache = getThreadCache();
+        Magazine* magazine = cache->loaded[sizeClass];
+        if (expect_true(magazine != NULL &&
+                magazine->count < magazine->capacity)) {
+            magazine->rounds[magazine->count++] = block;
+            return;
+        }
+        freeSlow(cache, sizeClass, block);
+    }
+
+    /**
+     * Return the number of bytes actually usable in a block allocated
+     * with the given size.
+     */
+    static size_t
+    getUsableSize(size_t size)
+    {
+        int sizeClass = getClass(size);
+        return (sizeClass < 0) ? size : getClassSize(sizeClass);
+    }
+
+    static void init();
+
+  PRIVATE:
+    /**
+     * A stack of free blocks of one size class.
+     */
+    struct Magazine {
+        explicit Magazine(uint32_t capacity)
+            : count(0)
+            , capacity(capacity)
+            , rounds()
+        {}
+
+        /// Number of valid entries in #rounds.
+        uint32_t count;
+
+        /// Most blocks this magazine may hold; depends on the size class.
+        uint32_t capacity;
+
+        /// The free blocks; those at indexes below #count are valid.
+        void* rounds[MAX_ROUNDS];
+    };
+
+    /**
+     * The magazines cached by one thread. A magazine is NULL until the
+     * thread first needs it.
+     */
+    struct ThreadCache {
+        ThreadCache()
+            : loaded()
+            , previous()
+            , allocCount(0)
+        {}
+
+        /// Blocks are allocated from and freed to these magazines.
+        Magazine* loaded[NUM_CLASSES];
+
+        /// When a loaded magazine runs out of blocks (or space), it is
+        /// swapped with this one if that helps, before going to the depot.
+        Magazine* previous[NUM_CLASSES];
+
+        /// Allocations served from this cache that haven't been added to
+        /// metrics yet; counting them in a shared counter as they happen
+        /// would make every allocation contend for its cache line.
+        uint64_t allocCount;
+    };
+
+    /**
+     * The global store of magazines for one size class.
+     */
+    struct Depot {
+        Depot()
+            : mutex("SlabAllocator::Depot::mutex")
+            , full()
+            , empty()
+        {}
+
+        /// Protects the lists below.
+        SpinLock mutex;
+
+        /// Magazines holding at least one block (usually, but not always,
+        /// completely full).
+        vector<Magazine*> full;
+
+        /// Magazines holding no blocks.
+        vector<Magazine*> empty;
+    };
+
+    /**
+     * Return the size class for requests of the given size, or -1 if the
+     * request is larger than MAX_SIZE.
+     */
+    static int
+    getClass(size_t size)
+    {
+        if (size <= MIN_SIZE)
+            return 0;
+        int shift = 63 - __builtin_clzll(size - 1);
+        if (shift >= static_cast<int>(MAX_SHIFT))
+            return -1;
+        int quarter = static_cast<int>(((size - 1) >> (shift - 2)) & 3);
+        return 1 + 4 * (shift - static_cast<int>(MIN_SHIFT)) + quarter;
+    }
+
+    /**
+     * Return the size of the blocks in a size class.
+     */
+    static uint32_t
+    getClassSize(int sizeClass)
+    {
+        if (sizeClass == 0)
+            return MIN_SIZE;
+        uint32_t shift = MIN_SHIFT + (sizeClass - 1) / 4;
+        uint32_t quarter = (sizeClass - 1) % 4;
+        return (1U << shift) + ((quarter + 1) << (shift - 2));
+    }
+
+    /**
+     * Return the calling thread's cache, creating it if needed.
+     */
+    static ThreadCache*
+    getThreadCache()
+    {
+        ThreadCache* cache = threadCache;
+        if (expect_false(cache == NULL))
+            cache = newThreadCache();
+        return cache;
+    }
+
+    static void* allocLarge(size_t size);
+    static void* allocSlow(ThreadCache* cache, int sizeClass);
+    static void flushAllocCount(ThreadCache* cache);
+    static void freeSlow(ThreadCache* cache, int sizeClass, void* block);
+    static Magazine* newSlab(int sizeClass, Magazine* magazine);
+    static ThreadCache* newThreadCache();
+    static void releaseThreadCache(void* cache);
+
+    /// One Depot for each size class. Allocated by init() and never freed,
+    /// so that blocks may still be freed during static destruction.
+    static Depot* depots;
+
+    /// The calling thread's cache, or NULL if it hasn't allocated or
+    /// freed anything yet (or has exited).
+    static __thread ThreadCache* threadCache;
+
+    /// Used to return a thread's magazines to the depot when it exits.
+    static pthread_key_t threadCacheKey;
+
+    DISALLOW_COPY_AND_ASSIGN(SlabAllocator);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_SLABALLOCATOR_H
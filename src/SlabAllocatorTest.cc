@@ -0,0 +1,195 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <thread>
+
+#include "TestUtil.h"
+#include "RawMetrics.h"
+#include "SlabAllocator.h"
+
+namespace RAMCloud {
+
+class SlabAllocatorTest : public ::testing::Test {
+  public:
+    /// The depots' contents before the test; the tests start with empty
+    /// depots and an empty cache for this thread, so that they can predict
+    /// when slabs are allocated.
+    vector<SlabAllocator::Magazine*> savedFull[SlabAllocator::NUM_CLASSES];
+    vector<SlabAllocator::Magazine*> savedEmpty[SlabAllocator::NUM_CLASSES];
+
+    SlabAllocatorTest()
+        : savedFull()
+        , savedEmpty()
+    {
+        releaseCache();
+        for (int i = 0; i < SlabAllocator::NUM_CLASSES; i++) {
+            savedFull[i].swap(SlabAllocator::depots[i].full);
+            savedEmpty[i].swap(SlabAllocator::depots[i].empty);
+        }
+    }
+
+    ~SlabAllocatorTest()
+    {
+        releaseCache();
+        for (int i = 0; i < SlabAllocator::NUM_CLASSES; i++) {
+            SlabAllocator::Depot& depot = SlabAllocator::depots[i];
+            depot.full.insert(depot.full.end(), savedFull[i].begin(),
+                    savedFull[i].end());
+            depot.empty.insert(depot.empty.end(), savedEmpty[i].begin(),
+                    savedEmpty[i].end());
+        }
+    }
+
+    static void
+    releaseCache()
+    {
+        if (SlabAllocator::threadCache != NULL)
+            SlabAllocator::releaseThreadCache(SlabAllocator::threadCache);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(SlabAllocatorTest);
+};
+
+TEST_F(SlabAllocatorTest, getClass) {
+    EXPECT_EQ(0, SlabAllocator::getClass(0));
+    EXPECT_EQ(0, SlabAllocator::getClass(64));
+    EXPECT_EQ(1, SlabAllocator::getClass(65));
+    EXPECT_EQ(1, SlabAllocator::getClass(80));
+    EXPECT_EQ(2, SlabAllocator::getClass(81));
+    EXPECT_EQ(4, SlabAllocator::getClass(128));
+    EXPECT_EQ(5, SlabAllocator::getClass(129));
+    EXPECT_EQ(40, SlabAllocator::getClass(65536));
+    EXPECT_EQ(-1, SlabAllocator::getClass(65537));
+}
+
+TEST_F(SlabAllocatorTest, getClassSize) {
+    EXPECT_EQ(64U, SlabAllocator::getClassSize(0));
+    EXPECT_EQ(80U, SlabAllocator::getClassSize(1));
+    EXPECT_EQ(128U, SlabAllocator::getClassSize(4));
+    EXPECT_EQ(160U, SlabAllocator::getClassSize(5));
+    EXPECT_EQ(65536U, SlabAllocator::getClassSize(40));
+
+    // Every class holds exactly the sizes between the previous class's
+    // size and its own.
+    for (int i = 0; i < SlabAllocator::NUM_CLASSES; i++) {
+        uint32_t size = SlabAllocator::getClassSize(i);
+        EXPECT_EQ(i, SlabAllocator::getClass(size));
+        EXPECT_EQ(i + 1, SlabAllocator::getClass(size + 1));
+        EXPECT_EQ(0U, size % 16);
+    }
+}
+
+TEST_F(SlabAllocatorTest, alloc_newSlab) {
+    uint64_t slabCount = metrics->slabAllocator.slabCount;
+    uint64_t slabBytes = metrics->slabAllocator.slabBytes;
+    char* a = static_cast<char*>(SlabAllocator::alloc(1000));
+    char* b = static_cast<char*>(SlabAllocator::alloc(1000));
+    EXPECT_EQ(slabCount + 1, metrics->slabAllocator.slabCount);
+    EXPECT_EQ(slabBytes + 64 * 1024, metrics->slabAllocator.slabBytes);
+    EXPECT_EQ(0U, reinterpret_cast<uint64_t>(a) % 64);
+    EXPECT_EQ(a + 1024, b);
+    SlabAllocator::free(b, 1000);
+    SlabAllocator::free(a, 1000);
+}
+
+TEST_F(SlabAllocatorTest, alloc_reusesFreedBlock) {
+    void* a = SlabAllocator::alloc(100);
+    SlabAllocator::free(a, 100);
+    EXPECT_EQ(a, SlabAllocator::alloc(100));
+    SlabAllocator::free(a, 100);
+}
+
+TEST_F(SlabAllocatorTest, alloc_large) {
+    uint64_t largeAllocCount = metrics->slabAllocator.largeAllocCount;
+    void* a = SlabAllocator::alloc(SlabAllocator::MAX_SIZE + 1);
+    EXPECT_EQ(largeAllocCount + 1, metrics->slabAllocator.largeAllocCount);
+    memset(a, 0, SlabAllocator::MAX_SIZE + 1);
+    SlabAllocator::free(a, SlabAllocator::MAX_SIZE + 1);
+}
+
+TEST_F(SlabAllocatorTest, allocSlow_swapPrevious) {
+    // Fill both magazines, then empty one: the next allocation after
+    // the loaded magazine runs dry comes from the previous one.
+    void* blocks[128];
+    for (int i = 0; i < 128; i++)
+        blocks[i] = SlabAllocator::alloc(1000);
+    for (int i = 0; i < 128; i++)
+        SlabAllocator::free(blocks[i], 1000);
+    uint64_t slabCount = metrics->slabAllocator.slabCount;
+    for (int i = 0; i < 128; i++)
+        blocks[i] = SlabAllocator::alloc(1000);
+    EXPECT_EQ(slabCount, metrics->slabAllocator.slabCount);
+    EXPECT_EQ(0U, SlabAllocator::depots[SlabAllocator::getClass(1000)].
+            full.size());
+    for (int i = 0; i < 128; i++)
+        SlabAllocator::free(blocks[i], 1000);
+}
+
+TEST_F(SlabAllocatorTest, freeSlow_depot) {
+    int sizeClass = SlabAllocator::getClass(1000);
+    SlabAllocator::Depot& depot = SlabAllocator::depots[sizeClass];
+    void* blocks[192];
+    for (int i = 0; i < 192; i++)
+        blocks[i] = SlabAllocator::alloc(1000);
+    uint64_t depotFreeCount = metrics->slabAllocator.depotFreeCount;
+    for (int i = 0; i < 192; i++)
+        SlabAllocator::free(blocks[i], 1000);
+
+    // Three magazines' worth of blocks don't fit in the thread's two
+    // magazines, so a full one went to the depot.
+    EXPECT_EQ(depotFreeCount + 1, metrics->slabAllocator.depotFreeCount);
+    ASSERT_EQ(1U, depot.full.size());
+    EXPECT_EQ(64U, depot.full[0]->count);
+
+    // And it comes back once the thread's own magazines are empty.
+    uint64_t depotAllocCount = metrics->slabAllocator.depotAllocCount;
+    uint64_t slabCount = metrics->slabAllocator.slabCount;
+    for (int i = 0; i < 192; i++)
+        blocks[i] = SlabAllocator::alloc(1000);
+    EXPECT_EQ(depotAllocCount + 1, metrics->slabAllocator.depotAllocCount);
+    EXPECT_EQ(slabCount, metrics->slabAllocator.slabCount);
+    EXPECT_EQ(0U, depot.full.size());
+    for (int i = 0; i < 192; i++)
+        SlabAllocator::free(blocks[i], 1000);
+}
+
+TEST_F(SlabAllocatorTest, getUsableSize) {
+    EXPECT_EQ(64U, SlabAllocator::getUsableSize(1));
+    EXPECT_EQ(112U, SlabAllocator::getUsableSize(100));
+    EXPECT_EQ(100000U, SlabAllocator::getUsableSize(100000));
+}
+
+static void
+allocAndFree(size_t size)
+{
+    SlabAllocator::free(SlabAllocator::alloc(size), size);
+}
+
+TEST_F(SlabAllocatorTest, releaseThreadCache) {
+    int sizeClass = SlabAllocator::getClass(1000);
+    std::thread thread(allocAndFree, 1000);
+    thread.join();
+
+    // The thread's only magazine was returned to the depot when it exited.
+    ASSERT_EQ(1U, SlabAllocator::depots[sizeClass].full.size());
+    EXPECT_EQ(64U, SlabAllocator::depots[sizeClass].full[0]->count);
+
+    // A block freed by one thread can be allocated by another.
+    void* a = SlabAllocator::alloc(1000);
+    EXPECT_EQ(0U, SlabAllocator::depots[sizeClass].full.size());
+    SlabAllocator::free(a, 1000);
+}
+
+} // namespace RAMCloud
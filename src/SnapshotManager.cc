@@ -0,0 +1,328 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "SnapshotManager.h"
+#include "Cycles.h"
+#include "HashTable.h"
+#include "LogEntryRelocator.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a SnapshotManager with no snapshots.
+ *
+ * \param log
+ *      The log containing the objects that snapshots may preserve.
+ * \param numBuckets
+ *      Number of buckets in the master's hash table. Preserved objects are
+ *      grouped by bucket so that enumeration can merge them in.
+ */
+SnapshotManager::SnapshotManager(Log* log, uint64_t numBuckets)
+    : log(log)
+    , numBuckets(numBuckets)
+    , mutex("SnapshotManager::mutex")
+    , numSnapshots(0)
+    , snapshots()
+    , byReference()
+{
+}
+
+/**
+ * Release all remaining snapshots.
+ */
+SnapshotManager::~SnapshotManager()
+{
+    Lock lock(mutex);
+    while (!snapshots.empty())
+        releaseSnapshot(lock, snapshots.begin());
+}
+
+/**
+ * Create a new snapshot of a tablet as of now.
+ *
+ * \param tableId
+ *      The table containing the tablet.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ * \return
+ *      The new snapshot's id, which is never 0. It must be passed to
+ *      renew() at least once per #LEASE_SECONDS to keep the snapshot alive.
+ */
+uint64_t
+SnapshotManager::create(uint64_t tableId, uint64_t firstKeyHash,
+                        uint64_t lastKeyHash)
+{
+    Lock lock(mutex);
+    releaseExpired(lock);
+
+    // Ids are random so that an iterator carrying an id minted by another
+    // master (e.g. after a migration) won't match one of ours.
+    uint64_t snapshotId;
+    do {
+        snapshotId = generateRandom();
+    } while (snapshotId == 0 || snapshots.find(snapshotId) != snapshots.end());
+
+    snapshots.insert({snapshotId, Snapshot(tableId, firstKeyHash,
+            lastKeyHash, newLeaseExpiration())});
+    numSnapshots = downCast<uint32_t>(snapshots.size());
+    return snapshotId;
+}
+
+/**
+ * Extend the lease on a snapshot.
+ *
+ * \param snapshotId
+ *      Identifies the snapshot; return value from create().
+ * \return
+ *      True if the snapshot still exists. False means it has been released
+ *      (perhaps because its lease ran out) or was never created here, and
+ *      the caller must start over with a new one.
+ */
+bool
+SnapshotManager::renew(uint64_t snapshotId)
+{
+    Lock lock(mutex);
+    releaseExpired(lock);
+    SnapshotMap::iterator it = snapshots.find(snapshotId);
+    if (it == snapshots.end())
+        return false;
+    it->second.leaseExpiration = newLeaseExpiration();
+    return true;
+}
+
+/**
+ * Discard a snapshot, letting the cleaner reclaim any versions only it
+ * was holding on to. Unknown ids are ignored.
+ *
+ * \param snapshotId
+ *      Identifies the snapshot; return value from create().
+ */
+void
+SnapshotManager::release(uint64_t snapshotId)
+{
+    Lock lock(mutex);
+    SnapshotMap::iterator it = snapshots.find(snapshotId);
+    if (it != snapshots.end())
+        releaseSnapshot(lock, it);
+}
+
+/**
+ * Return the objects in one hash table bucket that have been modified since
+ * a snapshot was created. During a snapshot enumeration, any object in the
+ * bucket whose key matches() one of these must be skipped, and the
+ * preserved versions (those with nonzero references) returned instead.
+ *
+ * To avoid racing with writers, this must be called after the bucket's
+ * current contents have been collected: ObjectManager calls preserve()
+ * before changing the hash table, so any change seen in the bucket is
+ * guaranteed to show up here.
+ *
+ * \param snapshotId
+ *      Identifies the snapshot; return value from create().
+ * \param bucketIndex
+ *      The hash table bucket.
+ * \param[out] preserved
+ *      Copies of the snapshot's PreservedObjects for the bucket are
+ *      appended here.
+ */
+void
+SnapshotManager::getPreserved(uint64_t snapshotId, uint64_t bucketIndex,
+                              std::vector<PreservedObject>* preserved)
+{
+    Lock lock(mutex);
+    SnapshotMap::iterator it = snapshots.find(snapshotId);
+    if (it == snapshots.end())
+        return;
+    auto range = it->second.objects.equal_range(bucketIndex);
+    for (auto object = range.first; object != range.second; ++object)
+        preserved->push_back(object->second);
+}
+
+/**
+ * Invoked by ObjectManager with the key's hash table bucket lock held,
+ * just before an object is created, overwritten, or removed. Each snapshot
+ * covering the key that hasn't seen it modified yet remembers the current
+ * version (or that there was none).
+ *
+ * \param key
+ *      Key of the object about to be modified.
+ * \param reference
+ *      Log reference of the object's current version, or 0 if the object
+ *      doesn't currently exist.
+ */
+void
+SnapshotManager::preserve(Key& key, uint64_t reference)
+{
+    if (expect_true(numSnapshots == 0))
+        return;
+
+    Lock lock(mutex);
+    releaseExpired(lock);
+    KeyHash keyHash = key.getHash();
+    uint64_t secondaryHash;
+    uint64_t bucketIndex = HashTable::findBucketIndex(numBuckets, keyHash,
+                                                      &secondaryHash);
+    foreach (SnapshotMap::value_type& entry, snapshots) {
+        Snapshot& snapshot = entry.second;
+        if (snapshot.tableId != key.getTableId() ||
+                keyHash < snapshot.firstKeyHash ||
+                keyHash > snapshot.lastKeyHash) {
+            continue;
+        }
+
+        bool alreadyPreserved = false;
+        auto range = snapshot.objects.equal_range(bucketIndex);
+        for (auto object = range.first; object != range.second; ++object) {
+            if (matches(object->second, key)) {
+                alreadyPreserved = true;
+                break;
+            }
+        }
+        if (alreadyPreserved)
+            continue;
+
+        auto object = snapshot.objects.insert({bucketIndex,
+                PreservedObject(key, reference)});
+        if (reference != 0)
+            byReference.insert({reference, &object->second});
+    }
+}
+
+/**
+ * Invoked by ObjectManager when the cleaner comes across an object that is
+ * no longer in the hash table. If a snapshot has preserved that version,
+ * it is relocated like a live object.
+ *
+ * \param oldBuffer
+ *      Buffer pointing to the object's current location.
+ * \param oldReference
+ *      Reference to the object's current location.
+ * \param relocator
+ *      Used to move the object to a survivor segment.
+ * \return
+ *      True if a snapshot needs the object (whether or not the relocator
+ *      had room for it; if not, the cleaner will retry). False if the object
+ *      is garbage.
+ */
+bool
+SnapshotManager::relocate(Buffer& oldBuffer, Log::Reference oldReference,
+                          LogEntryRelocator& relocator)
+{
+    if (expect_true(numSnapshots == 0))
+        return false;
+
+    Lock lock(mutex);
+    auto range = byReference.equal_range(oldReference.toInteger());
+    if (range.first == range.second)
+        return false;
+    if (!relocator.append(LOG_ENTRY_TYPE_OBJ, oldBuffer))
+        return true;
+
+    uint64_t newReference = relocator.getNewReference().toInteger();
+    std::vector<PreservedObject*> moved;
+    for (auto it = range.first; it != range.second; ++it) {
+        it->second->reference = newReference;
+        it->second->relocated = true;
+        moved.push_back(it->second);
+    }
+    byReference.erase(range.first, range.second);
+    foreach (PreservedObject* object, moved)
+        byReference.insert({newReference, object});
+    return true;
+}
+
+/**
+ * Returns true if a preserved object has the given key.
+ */
+bool
+SnapshotManager::matches(const PreservedObject& preserved, Key& key)
+{
+    return preserved.tableId == key.getTableId() &&
+            preserved.key.size() == key.getStringKeyLength() &&
+            memcmp(preserved.key.data(), key.getStringKey(),
+                   preserved.key.size()) == 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// SnapshotManager Private Methods
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Discard a snapshot and free the copies of preserved versions that the
+ * cleaner made on its behalf, unless another snapshot still refers to them.
+ *
+ * \param lock
+ *      Ensures that the caller holds #mutex.
+ * \param it
+ *      The snapshot to release.
+ */
+void
+SnapshotManager::releaseSnapshot(const Lock& lock, SnapshotMap::iterator it)
+{
+    foreach (auto& entry, it->second.objects) {
+        PreservedObject& object = entry.second;
+        if (object.reference == 0)
+            continue;
+        auto range = byReference.equal_range(object.reference);
+        for (auto ref = range.first; ref != range.second; ++ref) {
+            if (ref->second == &object) {
+                byReference.erase(ref);
+                break;
+            }
+        }
+        if (object.relocated && byReference.count(object.reference) == 0)
+            log->free(Log::Reference(object.reference));
+    }
+    snapshots.erase(it);
+    numSnapshots = downCast<uint32_t>(snapshots.size());
+}
+
+/**
+ * Release every snapshot whose lease has run out.
+ *
+ * \param lock
+ *      Ensures that the caller holds #mutex.
+ */
+void
+SnapshotManager::releaseExpired(const Lock& lock)
+{
+    uint64_t now = Cycles::rdtsc();
+    SnapshotMap::iterator it = snapshots.begin();
+    while (it != snapshots.end()) {
+        SnapshotMap::iterator next = it;
+        ++next;
+        if (it->second.leaseExpiration < now) {
+            LOG(NOTICE, "Releasing snapshot of tablet [0x%lx,0x%lx] in "
+                "tableId %lu; its lease expired", it->second.firstKeyHash,
+                it->second.lastKeyHash, it->second.tableId);
+            releaseSnapshot(lock, it);
+        }
+        it = next;
+    }
+}
+
+/**
+ * Return the lease expiration time for a snapshot used right now.
+ */
+uint64_t
+SnapshotManager::newLeaseExpiration()
+{
+    return Cycles::rdtsc() + Cycles::fromSeconds(LEASE_SECONDS);
+}
+
+} // namespace RAMCloud
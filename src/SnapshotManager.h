@@ -0,0 +1,162 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SNAPSHOTMANAGER_H
+#define RAMCLOUD_SNAPSHOTMANAGER_H
+
+#include <atomic>
+#include <map>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Key.h"
+#include "Log.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+class LogEntryRelocator;
+
+/**
+ * Keeps point-in-time views of tablets on a master for snapshot
+ * enumerations (see Enumeration). A snapshot is cheap to create: nothing is
+ * copied up front. Instead, the first time an object in a snapshot's range
+ * is overwritten or removed after the snapshot was created, ObjectManager
+ * hands the reference of the version being replaced to preserve(). The
+ * snapshot then serves that version in place of whatever the hash table
+ * holds. Keys created after the snapshot are recorded too, so that they
+ * can be hidden.
+ *
+ * Preserved versions are dead as far as the log is concerned, so the cleaner
+ * would normally discard them. While a snapshot holds them, relocate() makes
+ * the cleaner carry them over to survivor segments like live objects. They
+ * become garbage again when the snapshot is released, either explicitly at
+ * the end of the enumeration or when its lease runs out because the client
+ * stopped making progress.
+ *
+ * This class is thread-safe. When no snapshots exist, the write path costs
+ * a single atomic load.
+ */
+class SnapshotManager {
+  public:
+    /**
+     * The version of an object that was current when a snapshot was
+     * created, and that has since been overwritten or removed.
+     */
+    struct PreservedObject {
+        PreservedObject(Key& key, uint64_t reference)
+            : tableId(key.getTableId())
+            , key(static_cast<const char*>(key.getStringKey()),
+                  key.getStringKeyLength())
+            , reference(reference)
+            , relocated(false)
+        {}
+
+        /// The table containing the object.
+        uint64_t tableId;
+
+        /// The object's primary key.
+        string key;
+
+        /// Log reference of the preserved version, or 0 if the object did not
+        /// exist when the snapshot was created.
+        uint64_t reference;
+
+        /// True if the cleaner has moved the preserved version. The copy is
+        /// accounted as live in its survivor segment, so it must be freed
+        /// explicitly once no snapshot needs it.
+        bool relocated;
+    };
+
+    SnapshotManager(Log* log, uint64_t numBuckets);
+    ~SnapshotManager();
+    uint64_t create(uint64_t tableId, uint64_t firstKeyHash,
+                    uint64_t lastKeyHash);
+    bool renew(uint64_t snapshotId);
+    void release(uint64_t snapshotId);
+    void getPreserved(uint64_t snapshotId, uint64_t bucketIndex,
+                      std::vector<PreservedObject>* preserved);
+    void preserve(Key& key, uint64_t reference);
+    bool relocate(Buffer& oldBuffer, Log::Reference oldReference,
+                  LogEntryRelocator& relocator);
+
+    static bool matches(const PreservedObject& preserved, Key& key);
+
+    /// A snapshot that isn't used by an enumeration RPC for this long is
+    /// released, so that an abandoned scan can't pin old versions forever.
+    static const uint32_t LEASE_SECONDS = 60;
+
+  PRIVATE:
+    /**
+     * State for a single snapshot.
+     */
+    struct Snapshot {
+        Snapshot(uint64_t tableId, uint64_t firstKeyHash,
+                 uint64_t lastKeyHash, uint64_t leaseExpiration)
+            : tableId(tableId)
+            , firstKeyHash(firstKeyHash)
+            , lastKeyHash(lastKeyHash)
+            , leaseExpiration(leaseExpiration)
+            , objects()
+        {}
+
+        /// The snapshot covers objects in this table whose key hashes are
+        /// in the range [firstKeyHash, lastKeyHash].
+        uint64_t tableId;
+        uint64_t firstKeyHash;
+        uint64_t lastKeyHash;
+
+        /// Cycles::rdtsc() time after which the snapshot may be released.
+        uint64_t leaseExpiration;
+
+        /// Objects modified since the snapshot was created, indexed by the
+        /// hash table bucket their keys map to, so that enumeration can
+        /// find them one bucket at a time.
+        std::multimap<uint64_t, PreservedObject> objects;
+    };
+    typedef std::map<uint64_t, Snapshot> SnapshotMap;
+    typedef std::lock_guard<SpinLock> Lock;
+
+    void releaseSnapshot(const Lock& lock, SnapshotMap::iterator it);
+    void releaseExpired(const Lock& lock);
+    uint64_t newLeaseExpiration();
+
+    /// Log containing the preserved versions; relocated ones are freed
+    /// through it.
+    Log* log;
+
+    /// Number of buckets in the master's hash table.
+    uint64_t numBuckets;
+
+    /// Protects all of the members below.
+    SpinLock mutex;
+
+    /// Current number of entries in #snapshots; lets the write path skip
+    /// taking #mutex when there are none.
+    std::atomic<uint32_t> numSnapshots;
+
+    /// All existing snapshots, indexed by id.
+    SnapshotMap snapshots;
+
+    /// Finds the PreservedObjects that refer to a log reference, so that
+    /// the cleaner can update them when it relocates the version.
+    std::unordered_multimap<uint64_t, PreservedObject*> byReference;
+
+    DISALLOW_COPY_AND_ASSIGN(SnapshotManager);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_SNAPSHOTMANAGER_H
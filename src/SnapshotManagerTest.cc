@@ -0,0 +1,175 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "HashTable.h"
+#include "SnapshotManager.h"
+
+namespace RAMCloud {
+
+class SnapshotManagerTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    SnapshotManager snapshotManager;
+
+    // None of these tests relocate anything, so no log is needed.
+    SnapshotManagerTest()
+        : logEnabler()
+        , snapshotManager(NULL, 1024)
+    {
+    }
+
+    ~SnapshotManagerTest()
+    {
+        Cycles::mockTscValue = 0;
+    }
+
+    /// Returns "key:reference" for each object the given snapshot has
+    /// preserved in the bucket that key maps to.
+    string
+    getPreserved(uint64_t snapshotId, Key& key)
+    {
+        uint64_t secondaryHash;
+        uint64_t bucketIndex = HashTable::findBucketIndex(1024,
+                key.getHash(), &secondaryHash);
+        std::vector<SnapshotManager::PreservedObject> preserved;
+        snapshotManager.getPreserved(snapshotId, bucketIndex, &preserved);
+        string result;
+        foreach (SnapshotManager::PreservedObject& object, preserved) {
+            if (result.size() > 0)
+                result += " ";
+            result += format("%s:%lu", object.key.c_str(), object.reference);
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(SnapshotManagerTest);
+};
+
+TEST_F(SnapshotManagerTest, create) {
+    uint64_t id1 = snapshotManager.create(1, 0, ~0UL);
+    uint64_t id2 = snapshotManager.create(1, 0, ~0UL);
+    EXPECT_NE(0U, id1);
+    EXPECT_NE(0U, id2);
+    EXPECT_NE(id1, id2);
+    EXPECT_EQ(2U, snapshotManager.numSnapshots);
+}
+
+TEST_F(SnapshotManagerTest, renew) {
+    Cycles::mockTscValue = 1000;
+    uint64_t id = snapshotManager.create(1, 0, ~0UL);
+    uint64_t expiration = snapshotManager.snapshots.at(id).leaseExpiration;
+
+    Cycles::mockTscValue = 2000;
+    EXPECT_TRUE(snapshotManager.renew(id));
+    EXPECT_EQ(expiration + 1000,
+              snapshotManager.snapshots.at(id).leaseExpiration);
+    EXPECT_FALSE(snapshotManager.renew(id + 1));
+
+    // Once the lease has run out, the snapshot can't be renewed.
+    Cycles::mockTscValue = 2001 +
+            Cycles::fromSeconds(SnapshotManager::LEASE_SECONDS);
+    EXPECT_FALSE(snapshotManager.renew(id));
+    EXPECT_EQ(0U, snapshotManager.numSnapshots);
+}
+
+TEST_F(SnapshotManagerTest, release) {
+    uint64_t id = snapshotManager.create(1, 0, ~0UL);
+    Key key(1, "a", 1);
+    snapshotManager.preserve(key, 1234);
+    EXPECT_EQ(1U, snapshotManager.byReference.count(1234));
+
+    snapshotManager.release(id + 1);
+    EXPECT_EQ(1U, snapshotManager.numSnapshots);
+    snapshotManager.release(id);
+    EXPECT_EQ(0U, snapshotManager.numSnapshots);
+    EXPECT_EQ(0U, snapshotManager.byReference.size());
+    EXPECT_FALSE(snapshotManager.renew(id));
+}
+
+TEST_F(SnapshotManagerTest, getPreserved_unknownSnapshot) {
+    Key key(1, "a", 1);
+    EXPECT_EQ("", getPreserved(99, key));
+}
+
+TEST_F(SnapshotManagerTest, preserve_noSnapshots) {
+    Key key(1, "a", 1);
+    snapshotManager.preserve(key, 1234);
+    EXPECT_EQ(0U, snapshotManager.byReference.size());
+}
+
+TEST_F(SnapshotManagerTest, preserve_firstModificationOnly) {
+    uint64_t id = snapshotManager.create(1, 0, ~0UL);
+    Key key(1, "a", 1);
+    snapshotManager.preserve(key, 1234);
+    snapshotManager.preserve(key, 5678);
+    EXPECT_EQ("a:1234", getPreserved(id, key));
+
+    // A snapshot created later sees the second modification.
+    uint64_t id2 = snapshotManager.create(1, 0, ~0UL);
+    snapshotManager.preserve(key, 9999);
+    EXPECT_EQ("a:1234", getPreserved(id, key));
+    EXPECT_EQ("a:9999", getPreserved(id2, key));
+}
+
+TEST_F(SnapshotManagerTest, preserve_newObject) {
+    uint64_t id = snapshotManager.create(1, 0, ~0UL);
+    Key key(1, "a", 1);
+    snapshotManager.preserve(key, 0);
+    EXPECT_EQ("a:0", getPreserved(id, key));
+    EXPECT_EQ(0U, snapshotManager.byReference.size());
+}
+
+TEST_F(SnapshotManagerTest, preserve_outsideSnapshot) {
+    Key key(1, "a", 1);
+    uint64_t otherTable = snapshotManager.create(2, 0, ~0UL);
+    uint64_t below = snapshotManager.create(1, 0, key.getHash() - 1);
+    uint64_t above = snapshotManager.create(1, key.getHash() + 1, ~0UL);
+    snapshotManager.preserve(key, 1234);
+    EXPECT_EQ("", getPreserved(otherTable, key));
+    EXPECT_EQ("", getPreserved(below, key));
+    EXPECT_EQ("", getPreserved(above, key));
+}
+
+TEST_F(SnapshotManagerTest, matches) {
+    Key key(1, "abc", 3);
+    SnapshotManager::PreservedObject object(key, 1234);
+    EXPECT_TRUE(SnapshotManager::matches(object, key));
+    Key otherTable(2, "abc", 3);
+    EXPECT_FALSE(SnapshotManager::matches(object, otherTable));
+    Key prefix(1, "ab", 2);
+    EXPECT_FALSE(SnapshotManager::matches(object, prefix));
+    Key otherKey(1, "abd", 3);
+    EXPECT_FALSE(SnapshotManager::matches(object, otherKey));
+}
+
+TEST_F(SnapshotManagerTest, releaseExpired) {
+    Cycles::mockTscValue = 1000;
+    uint64_t id = snapshotManager.create(1, 0, 0xff);
+    Cycles::mockTscValue = 2000;
+    snapshotManager.create(1, 0x100, ~0UL);
+
+    Cycles::mockTscValue = 1001 +
+            Cycles::fromSeconds(SnapshotManager::LEASE_SECONDS);
+    SnapshotManager::Lock lock(snapshotManager.mutex);
+    snapshotManager.releaseExpired(lock);
+    EXPECT_EQ(1U, snapshotManager.numSnapshots);
+    EXPECT_EQ(0U, snapshotManager.snapshots.count(id));
+    EXPECT_EQ("releaseExpired: Releasing snapshot of tablet [0x0,0xff] in "
+              "tableId 1; its lease expired", TestLog::get());
+}
+
+}  // namespace RAMCloud
@@ -52,6 +52,9 @@ static const char* messages[] = {
                                                  // STATUS_CALLER_NOT_IN_CLUSTER
     "request is too large",                      // STATUS_REQUEST_TOO_LARGE
     "unknown indexlet (may exist elsewhere)",    // STATUS_UNKNOWN_INDEXLET
+    "object doesn't satisfy the read's filter",  // STATUS_OBJECT_FILTERED
+    "read-modify-write condition failed",        // STATUS_RMW_CONDITION_FAILED
+    "enumeration snapshot expired",              // STATUS_SNAPSHOT_EXPIRED
 };
 
 // The following table maps from a Status value to the internal name
@@ -86,6 +89,9 @@ static const char* symbols[] = {
     "STATUS_CALLER_NOT_IN_CLUSTER",
     "STATUS_REQUEST_TOO_LARGE",
     "STATUS_UNKNOWN_INDEXLET",
+    "STATUS_OBJECT_FILTERED",
+    "STATUS_RMW_CONDITION_FAILED",
+    "STATUS_SNAPSHOT_EXPIRED",
 };
 
 /**
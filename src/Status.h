@@ -118,7 +118,23 @@ typedef enum Status {
     /// for) a given indexlet, but that it may exist elsewhere in the system.
     STATUS_UNKNOWN_INDEXLET             = 28,
 
-    STATUS_MAX_VALUE                    = 28,
+    /// Indicates that an object exists, but was not returned because it
+    /// doesn't satisfy the filter given with the read (see ObjectFilter).
+    STATUS_OBJECT_FILTERED              = 29,
+
+    /// Indicates that the object exists, but a readModifyWrite operation
+    /// wasn't applied because its condition didn't hold (for example, a
+    /// compare-and-swap found different bytes, or an add would have gone
+    /// out of bounds; see RmwOperation).
+    STATUS_RMW_CONDITION_FAILED         = 30,
+
+    /// Indicates that a snapshot enumeration can't continue because the
+    /// server no longer has the snapshot it was using (for example, the
+    /// client let its lease run out). The tablet must be enumerated again
+    /// from its beginning.
+    STATUS_SNAPSHOT_EXPIRED             = 31,
+
+    STATUS_MAX_VALUE                    = 31,
 
     // Note: if you add a new status value you must make the following
     // additional updates:
@@ -31,19 +31,36 @@ namespace RAMCloud {
  *      and data. True means that the returned objects have
  *      been truncated so that the object data (normally the last
  *      field of the object) is omitted.
+ * \param snapshot
+ *      True means that each tablet is returned as it was when its server
+ *      started enumerating it, so writes made during the enumeration are
+ *      not seen. If a server's snapshot expires before the enumeration
+ *      is done with its tablet, the tablet is enumerated again from its
+ *      beginning, so objects already returned from it are returned again.
+ *      False means objects are returned as they are when the server gets
+ *      to them.
+ * \param filter
+ *      If non-NULL, only objects that match this filter are returned, and
+ *      only the parts of their values it selects; the filter is copied.
  */
 TableEnumerator::TableEnumerator(RamCloud& ramcloud,
                                 uint64_t tableId,
-                                bool keysOnly)
+                                bool keysOnly,
+                                bool snapshot,
+                                const ObjectFilter* filter)
     : ramcloud(ramcloud)
     , tableId(tableId)
     , keysOnly(keysOnly)
+    , snapshot(snapshot)
+    , filter()
     , tabletStartHash(0)
     , done(false)
     , state()
     , objects()
     , nextOffset(0)
 {
+    if (filter != NULL)
+        this->filter.construct(*filter);
 }
 
 /**
@@ -150,8 +167,16 @@ TableEnumerator::requestMoreObjects()
 
     nextOffset = 0;
     while (true) {
-        tabletStartHash = ramcloud.enumerateTable(tableId, keysOnly,
-                                            tabletStartHash, state, objects);
+        try {
+            tabletStartHash = ramcloud.enumerateTable(tableId, keysOnly,
+                                            tabletStartHash, state, objects,
+                                            snapshot, filter.get());
+        } catch (SnapshotExpiredException& e) {
+            // Start this tablet over with a new snapshot.
+            state.reset();
+            objects.reset();
+            continue;
+        }
         if (objects.getTotalLength() > 0) {
             return;
         }
@@ -28,7 +28,9 @@ namespace RAMCloud {
  */
 class TableEnumerator {
   public:
-    TableEnumerator(RamCloud& ramCloud, uint64_t tableId, bool keysOnly);
+    TableEnumerator(RamCloud& ramCloud, uint64_t tableId, bool keysOnly,
+                    bool snapshot = false,
+                    const ObjectFilter* filter = NULL);
     bool hasNext();
     void next(uint32_t* size, const void** object);
     void nextKeyAndData(uint32_t* keyLength, const void** key,
@@ -48,6 +50,14 @@ class TableEnumerator {
     /// field of the object) is omitted.
     bool keysOnly;
 
+    /// True means each tablet is enumerated as it was when its server
+    /// started on it; see RamCloud::enumerateTable.
+    bool snapshot;
+
+    /// If constructed, servers only return objects that match this filter,
+    /// and only the parts of their values it selects.
+    Tub<ObjectFilter> filter;
+
     /// The start hash of the tablet being enumerated.
     uint64_t tabletStartHash;
 
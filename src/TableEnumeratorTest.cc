@@ -15,6 +15,7 @@
 
 #include "TestUtil.h"
 #include "MockCluster.h"
+#include "SnapshotManager.h"
 #include "TableEnumerator.h"
 
 namespace RAMCloud {
@@ -135,6 +136,35 @@ TEST_F(TableEnumeratorTest, basics) {
     EXPECT_FALSE(iter.hasNext());
 }
 
+TEST_F(TableEnumeratorTest, snapshotExpired) {
+    uint64_t tableId2 = ramcloud.createTable("table2", 1);
+    ramcloud.write(tableId2, "0", 1, "abcdef", 6);
+    ramcloud.write(tableId2, "1", 1, "ghijkl", 6);
+
+    // The lease runs out after the first batch; the tablet is enumerated
+    // again from its beginning with a new snapshot.
+    Cycles::mockTscValue = 1000;
+    TableEnumerator iter(ramcloud, tableId2, false, true);
+    std::vector<string> keys;
+    while (iter.hasNext()) {
+        uint32_t keyLength, dataLength;
+        const void* key;
+        const void* data;
+        iter.nextKeyAndData(&keyLength, &key, &dataLength, &data);
+        keys.push_back(string(static_cast<const char*>(key), keyLength));
+        if (keys.size() == 2) {
+            Cycles::mockTscValue = 1001 +
+                    Cycles::fromSeconds(SnapshotManager::LEASE_SECONDS);
+        }
+    }
+    Cycles::mockTscValue = 0;
+    std::sort(keys.begin(), keys.end());
+    string result;
+    foreach (const string& key, keys)
+        result += key;
+    EXPECT_EQ("0011", result);
+}
+
 TEST_F(TableEnumeratorTest, keysOnly) {
     uint64_t version0, version1, version2, version3, version4;
     ramcloud.write(tableId1, "0", 1, "abcdef", 6, NULL, &version0);
@@ -78,6 +78,7 @@ class TableManager {
     void recover(uint64_t lastCompletedUpdate);
     void serializeTableConfig(ProtoBuf::TableConfig* tableConfig,
                                                     uint64_t tableId);
+    void splitTablet(uint64_t tableId, uint64_t splitKeyHash);
     void splitTablet(const char* name,
                      uint64_t splitKeyHash);
     void splitRecoveringTablet(uint64_t tableId, uint64_t splitKeyHash);
@@ -212,6 +213,7 @@ class TableManager {
     Table* recreateTable(const Lock& lock, ProtoBuf::Table* info);
     void serializeTable(const Lock& lock, Table* table,
                         ProtoBuf::Table* externalInfo);
+    void splitTablet(const Lock& lock, Table* table, uint64_t splitKeyHash);
     void sync(const Lock& lock);
     void syncTable(const Lock& lock, Table* table,
                    ProtoBuf::Table* externalInfo);
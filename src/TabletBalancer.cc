@@ -0,0 +1,408 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+#include "TabletBalancer.h"
+#include "ClientException.h"
+#include "CoordinatorServerList.h"
+#include "MasterClient.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a TabletBalancer. It does nothing until start() is called.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server.
+ * \param tableManager
+ *      Authoritative information about tablets and their mapping to servers.
+ * \param runtimeOptions
+ *      Holds the "tabletBalancer*" options that control the balancer.
+ */
+TabletBalancer::TabletBalancer(Context* context,
+                               TableManager& tableManager,
+                               RuntimeOptions* runtimeOptions)
+    : context(context)
+    , tableManager(tableManager)
+    , runtimeOptions(runtimeOptions)
+    , running(false)
+    , wakeup()
+    , mutex()
+    , thread()
+    , previousCounts()
+{
+}
+
+/**
+ * Halt the balancer thread, if it is running.
+ */
+TabletBalancer::~TabletBalancer()
+{
+    halt();
+}
+
+/**
+ * Start the thread that balances the cluster once per
+ * "tabletBalancerIntervalSeconds". Calling start() on an instance that is
+ * already running has no effect.
+ */
+void
+TabletBalancer::start()
+{
+    Lock lock(mutex);
+    if (running)
+        return;
+    running = true;
+    thread.construct(&TabletBalancer::main, this);
+}
+
+/**
+ * Stop the balancer thread. If a move is underway, this waits for it to
+ * finish. Calling halt() on an instance that is already halted or has never
+ * been started has no effect.
+ */
+void
+TabletBalancer::halt()
+{
+    Lock lock(mutex);
+    if (!running)
+        return;
+    running = false;
+    wakeup.notify_one();
+    lock.unlock();
+    thread->join();
+    thread.destroy();
+}
+
+/**
+ * Run a single round of balancing: measure the load on every master, plan
+ * moves that even it out, and log or carry out the plan depending on
+ * "tabletBalancerMode". Normally invoked by main(); exposed for testing.
+ */
+void
+TabletBalancer::balance()
+{
+    RuntimeOptions::TabletBalancerOptions options =
+            runtimeOptions->getTabletBalancerOptions();
+    if (options.mode == OFF) {
+        // Counts may be stale by the time the balancer is turned back on.
+        previousCounts.clear();
+        return;
+    }
+
+    vector<MasterLoad> masters;
+    collectLoad(&masters);
+    vector<Move> moves = plan(masters, options);
+
+    foreach (const Move& move, moves) {
+        if (options.mode == DRY_RUN) {
+            LOG(NOTICE, "Dry run; would %s", move.toString().c_str());
+            continue;
+        }
+        LOG(NOTICE, "Balancing load: %s", move.toString().c_str());
+        if (!execute(move)) {
+            // Later moves may depend on this one (e.g. a migration of half
+            // of a split tablet), so give up until the next round.
+            break;
+        }
+    }
+}
+
+/**
+ * Plan splits and migrations that even out the load across masters. Moves
+ * are planned greedily: while the busiest master's load is at least
+ * "tabletBalancerSkewPercent" of the average, its busiest tablet that can
+ * move to the idlest master without making that master busier than the
+ * source is migrated there. If every busy tablet is too hot for that, the
+ * hottest one is split in half (assuming load and data are spread evenly
+ * over its key hashes) and planning continues with the halves.
+ *
+ * \param masters
+ *      Load on each master, as measured by collectLoad(). Updated to
+ *      reflect the planned moves.
+ * \param options
+ *      Limits on how much to move; see RuntimeOptions.
+ * \return
+ *      The moves to make, in order. Later moves may depend on earlier ones.
+ */
+vector<TabletBalancer::Move>
+TabletBalancer::plan(vector<MasterLoad>& masters,
+                     const RuntimeOptions::TabletBalancerOptions& options)
+{
+    vector<Move> moves;
+    if (masters.size() < 2)
+        return moves;
+
+    uint64_t totalOperations = 0;
+    foreach (const MasterLoad& master, masters)
+        totalOperations += master.operations;
+    if (totalOperations == 0 || totalOperations < options.minOperations)
+        return moves;
+    double averageOperations = static_cast<double>(totalOperations) /
+            static_cast<double>(masters.size());
+    uint64_t bytesLeft = uint64_t(options.maxMoveMegabytes) * 1024 * 1024;
+
+    while (moves.size() < options.maxMoves) {
+        MasterLoad* busiest = &masters.front();
+        MasterLoad* idlest = &masters.front();
+        foreach (MasterLoad& master, masters) {
+            if (master.operations > busiest->operations)
+                busiest = &master;
+            if (master.operations < idlest->operations)
+                idlest = &master;
+        }
+        if (busiest == idlest || static_cast<double>(busiest->operations) *
+                100 < averageOperations * options.skewPercent) {
+            break;
+        }
+
+        // Moving more than half the difference would just make the idlest
+        // master the busiest one.
+        uint64_t maxOperations = (busiest->operations - idlest->operations) / 2;
+        TabletLoad* best = NULL;
+        TabletLoad* hottest = NULL;
+        foreach (TabletLoad& tablet, busiest->tablets) {
+            if (hottest == NULL || tablet.operations > hottest->operations)
+                hottest = &tablet;
+            if (tablet.operations == 0 || tablet.operations > maxOperations ||
+                    tablet.bytes > bytesLeft)
+                continue;
+            if (best == NULL || tablet.operations > best->operations ||
+                    (tablet.operations == best->operations &&
+                     tablet.bytes < best->bytes))
+                best = &tablet;
+        }
+
+        if (best == NULL) {
+            // Every busy tablet is too hot (or too big) to move whole. Split
+            // the hottest one, but only if there's room left in this round
+            // to migrate one of the halves.
+            if (hottest == NULL || hottest->operations == 0 ||
+                    hottest->startKeyHash == hottest->endKeyHash ||
+                    hottest->bytes / 2 > bytesLeft ||
+                    moves.size() + 2 > options.maxMoves) {
+                break;
+            }
+            uint64_t splitKeyHash = hottest->startKeyHash +
+                    (hottest->endKeyHash - hottest->startKeyHash) / 2 + 1;
+            moves.push_back(Move(Move::SPLIT, hottest->tableId,
+                    hottest->startKeyHash, hottest->endKeyHash, splitKeyHash,
+                    busiest->serverId, ServerId(), hottest->operations,
+                    hottest->bytes));
+            TabletLoad upper(hottest->tableId, splitKeyHash,
+                    hottest->endKeyHash, hottest->operations / 2,
+                    hottest->bytes / 2);
+            hottest->endKeyHash = splitKeyHash - 1;
+            hottest->operations -= upper.operations;
+            hottest->bytes -= upper.bytes;
+            busiest->tablets.push_back(upper);
+            continue;
+        }
+
+        moves.push_back(Move(Move::MIGRATE, best->tableId, best->startKeyHash,
+                best->endKeyHash, 0, busiest->serverId, idlest->serverId,
+                best->operations, best->bytes));
+        bytesLeft -= best->bytes;
+        busiest->operations -= best->operations;
+        idlest->operations += best->operations;
+        idlest->tablets.push_back(*best);
+        *best = busiest->tablets.back();
+        busiest->tablets.pop_back();
+    }
+    return moves;
+}
+
+/**
+ * Return a human-readable description of a move, for logging.
+ */
+string
+TabletBalancer::Move::toString() const
+{
+    if (type == SPLIT) {
+        return format("split tablet [0x%lx,0x%lx] in tableId %lu on %s at "
+                "0x%lx (%lu operations, %lu bytes)", firstKeyHash,
+                lastKeyHash, tableId, source.toString().c_str(), splitKeyHash,
+                operations, bytes);
+    }
+    return format("migrate tablet [0x%lx,0x%lx] in tableId %lu from %s to %s "
+            "(%lu operations, %lu bytes)", firstKeyHash, lastKeyHash, tableId,
+            source.toString().c_str(), destination.toString().c_str(),
+            operations, bytes);
+}
+
+//////////////////////////////////////////////////////////////////////
+// TabletBalancer Private Methods
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Ask every master that is up for its tablet statistics and compute the
+ * load on each tablet since the previous round. Tablets that weren't
+ * reported in the previous round (e.g. because they were just split or
+ * migrated) are considered idle until the next round.
+ *
+ * \param[out] masters
+ *      Filled in with the load on each master that responded.
+ */
+void
+TabletBalancer::collectLoad(vector<MasterLoad>* masters)
+{
+    // Send all requests before waiting for any of them.
+    vector<std::pair<ServerId, std::unique_ptr<GetMasterStatisticsRpc>>> rpcs;
+    ServerId id;
+    while (true) {
+        bool end;
+        id = context->coordinatorServerList->nextServer(id,
+                ServiceMask({WireFormat::MASTER_SERVICE}), &end);
+        if (end)
+            break;
+        rpcs.push_back(std::make_pair(id, std::unique_ptr<
+                GetMasterStatisticsRpc>(new GetMasterStatisticsRpc(
+                context, id))));
+    }
+
+    std::map<TabletKey, uint64_t> counts;
+    for (size_t i = 0; i < rpcs.size(); i++) {
+        ServerId serverId = rpcs[i].first;
+        ProtoBuf::ServerStatistics stats;
+        try {
+            rpcs[i].second->wait(&stats);
+        } catch (const ClientException& e) {
+            // Most likely the master crashed; its tablets will be
+            // recovered elsewhere.
+            LOG(NOTICE, "Couldn't get statistics from %s: %s",
+                serverId.toString().c_str(), e.toString());
+            continue;
+        }
+
+        // Spread each table's bytes over its tablets on this master in
+        // proportion to the size of their key hash ranges.
+        std::unordered_map<uint64_t, uint64_t> tableBytes;
+        std::unordered_map<uint64_t, double> tableSpan;
+        foreach (const ProtoBuf::ServerStatistics::TableEntry& table,
+                 stats.tableentry()) {
+            tableBytes[table.table_id()] = table.byte_count();
+        }
+        foreach (const ProtoBuf::ServerStatistics::TabletEntry& tablet,
+                 stats.tabletentry()) {
+            tableSpan[tablet.table_id()] += static_cast<double>(
+                    tablet.end_key_hash() - tablet.start_key_hash()) + 1;
+        }
+
+        masters->push_back(MasterLoad(serverId));
+        MasterLoad& master = masters->back();
+        foreach (const ProtoBuf::ServerStatistics::TabletEntry& tablet,
+                 stats.tabletentry()) {
+            TabletKey key(serverId.getId(), tablet.table_id(),
+                    tablet.start_key_hash(), tablet.end_key_hash());
+            uint64_t count = tablet.number_read_and_writes();
+            counts[key] = count;
+
+            uint64_t operations = 0;
+            auto previous = previousCounts.find(key);
+            if (previous != previousCounts.end() && count >= previous->second)
+                operations = count - previous->second;
+
+            double span = static_cast<double>(
+                    tablet.end_key_hash() - tablet.start_key_hash()) + 1;
+            uint64_t bytes = static_cast<uint64_t>(
+                    static_cast<double>(tableBytes[tablet.table_id()]) *
+                    span / tableSpan[tablet.table_id()]);
+
+            master.tablets.push_back(TabletLoad(tablet.table_id(),
+                    tablet.start_key_hash(), tablet.end_key_hash(),
+                    operations, bytes));
+            master.operations += operations;
+        }
+    }
+    previousCounts.swap(counts);
+}
+
+/**
+ * Carry out a single move planned by plan(), after checking that the
+ * tablet is still where the plan expects it to be.
+ *
+ * \param move
+ *      The move to make.
+ * \return
+ *      True if the move was made, false if it was skipped or failed.
+ */
+bool
+TabletBalancer::execute(const Move& move)
+{
+    try {
+        Tablet tablet = tableManager.getTablet(move.tableId,
+                                               move.firstKeyHash);
+        if (tablet.serverId != move.source ||
+                tablet.status != Tablet::NORMAL ||
+                tablet.startKeyHash != move.firstKeyHash ||
+                tablet.endKeyHash != move.lastKeyHash) {
+            LOG(NOTICE, "Tablet changed since the move was planned; "
+                "skipping: %s", move.toString().c_str());
+            return false;
+        }
+
+        if (move.type == Move::SPLIT) {
+            tableManager.splitTablet(move.tableId, move.splitKeyHash);
+        } else {
+            MasterClient::migrateTablet(context, move.source, move.tableId,
+                    move.firstKeyHash, move.lastKeyHash, move.destination);
+        }
+    } catch (const TableManager::NoSuchTable& e) {
+        LOG(NOTICE, "Table disappeared; skipping: %s",
+            move.toString().c_str());
+        return false;
+    } catch (const TableManager::NoSuchTablet& e) {
+        LOG(NOTICE, "Tablet disappeared; skipping: %s",
+            move.toString().c_str());
+        return false;
+    } catch (const ClientException& e) {
+        LOG(WARNING, "Failed to %s: %s", move.toString().c_str(),
+            e.toString());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Top-level method of the balancer thread: runs balance() once per
+ * "tabletBalancerIntervalSeconds" until halt() is called.
+ */
+void
+TabletBalancer::main()
+try {
+    Lock lock(mutex);
+    while (running) {
+        uint32_t interval =
+                runtimeOptions->getTabletBalancerOptions().intervalSeconds;
+        wakeup.wait_for(lock, std::chrono::seconds(std::max(1u, interval)));
+        if (!running)
+            break;
+        lock.unlock();
+        balance();
+        lock.lock();
+    }
+} catch (const std::exception& e) {
+    LOG(ERROR, "Fatal error in TabletBalancer: %s", e.what());
+    throw;
+} catch (...) {
+    LOG(ERROR, "Unknown fatal error in TabletBalancer.");
+    throw;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,222 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TABLETBALANCER_H
+#define RAMCLOUD_TABLETBALANCER_H
+
+#include <condition_variable>
+#include <map>
+#include <thread>
+#include <tuple>
+
+#include "Common.h"
+#include "RuntimeOptions.h"
+#include "ServerId.h"
+#include "ServerStatistics.pb.h"
+#include "TableManager.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * Runs on the coordinator and evens out load across masters. Every
+ * "tabletBalancerIntervalSeconds" it asks each master for the number of
+ * reads and writes its tablets have served (GET_SERVER_STATISTICS) and
+ * turns that into per-tablet load since the previous round. If some master
+ * is much busier than the average, it plans migrations of tablets from the
+ * busiest masters to the idlest ones, first splitting tablets that are too
+ * hot to move whole. The plan is then either logged (dry run) or carried
+ * out, subject to per-round limits on the number of moves and the amount of
+ * data migrated.
+ *
+ * All of the balancer's settings are RuntimeOptions ("tabletBalancer*"), so
+ * it can be turned on, off, or into dry-run mode while the cluster is
+ * running. It is off by default.
+ */
+class TabletBalancer {
+  PUBLIC:
+    /// Values of the "tabletBalancerMode" RuntimeOption.
+    enum Mode {
+        /// Don't collect load or plan anything.
+        OFF = 0,
+        /// Plan moves and log them, but don't carry them out.
+        DRY_RUN = 1,
+        /// Plan moves and carry them out.
+        ACTIVE = 2,
+    };
+
+    /**
+     * Load on a single tablet, as measured over the most recent round.
+     */
+    struct TabletLoad {
+        TabletLoad(uint64_t tableId, uint64_t startKeyHash,
+                   uint64_t endKeyHash, uint64_t operations, uint64_t bytes)
+            : tableId(tableId)
+            , startKeyHash(startKeyHash)
+            , endKeyHash(endKeyHash)
+            , operations(operations)
+            , bytes(bytes)
+        {}
+
+        /// The id of the containing table.
+        uint64_t tableId;
+
+        /// The smallest hash value for a key that is in this tablet.
+        uint64_t startKeyHash;
+
+        /// The largest hash value for a key that is in this tablet.
+        uint64_t endKeyHash;
+
+        /// Number of reads and writes served since the previous round.
+        uint64_t operations;
+
+        /// Estimated number of bytes of log data in the tablet, derived
+        /// from the master's TableStats for the containing table.
+        uint64_t bytes;
+    };
+
+    /**
+     * Load on a single master: the tablets it owns and the sum of their
+     * loads.
+     */
+    struct MasterLoad {
+        explicit MasterLoad(ServerId serverId)
+            : serverId(serverId)
+            , operations(0)
+            , tablets()
+        {}
+
+        /// The master this load was measured on.
+        ServerId serverId;
+
+        /// Total number of reads and writes served by #tablets since the
+        /// previous round.
+        uint64_t operations;
+
+        /// Load on each of the master's tablets.
+        vector<TabletLoad> tablets;
+    };
+
+    /**
+     * A single step of a balancing plan.
+     */
+    struct Move {
+        enum Type {
+            /// Split a tablet into two at #splitKeyHash.
+            SPLIT,
+            /// Migrate a tablet from #source to #destination.
+            MIGRATE,
+        };
+
+        Move(Type type, uint64_t tableId, uint64_t firstKeyHash,
+             uint64_t lastKeyHash, uint64_t splitKeyHash, ServerId source,
+             ServerId destination, uint64_t operations, uint64_t bytes)
+            : type(type)
+            , tableId(tableId)
+            , firstKeyHash(firstKeyHash)
+            , lastKeyHash(lastKeyHash)
+            , splitKeyHash(splitKeyHash)
+            , source(source)
+            , destination(destination)
+            , operations(operations)
+            , bytes(bytes)
+        {}
+
+        string toString() const;
+
+        /// What to do.
+        Type type;
+
+        /// The tablet to split or migrate.
+        uint64_t tableId;
+        uint64_t firstKeyHash;
+        uint64_t lastKeyHash;
+
+        /// For SPLIT, the lowest key hash of the second tablet.
+        uint64_t splitKeyHash;
+
+        /// The master that owns the tablet.
+        ServerId source;
+
+        /// For MIGRATE, the master the tablet is moved to.
+        ServerId destination;
+
+        /// Load and estimated size of the tablet when the move was planned.
+        uint64_t operations;
+        uint64_t bytes;
+    };
+
+    TabletBalancer(Context* context,
+                   TableManager& tableManager,
+                   RuntimeOptions* runtimeOptions);
+    ~TabletBalancer();
+
+    void start();
+    void halt();
+    void balance();
+
+    static vector<Move> plan(vector<MasterLoad>& masters,
+            const RuntimeOptions::TabletBalancerOptions& options);
+
+  PRIVATE:
+    void collectLoad(vector<MasterLoad>* masters);
+    bool execute(const Move& move);
+    void main();
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Authoritative information about tablets and their mapping to servers.
+    TableManager& tableManager;
+
+    /// Holds the "tabletBalancer*" options that control the balancer.
+    RuntimeOptions* runtimeOptions;
+
+    /**
+     * Used by start()/halt() to inform the main() loop of when it should
+     * exit. Protected by #mutex and changes are notified through
+     * #wakeup.
+     */
+    bool running;
+
+    /// Used to interrupt the main() loop's sleep between rounds on halt().
+    std::condition_variable wakeup;
+
+    /// Protects #running.
+    std::mutex mutex;
+
+    /// unique_lock is used since it must be released while waiting.
+    typedef std::unique_lock<std::mutex> Lock;
+
+    /// Runs main(), which balances the cluster once per interval.
+    Tub<std::thread> thread;
+
+    /// Identifies a tablet on a particular master: server id, table id,
+    /// start key hash and end key hash.
+    typedef std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> TabletKey;
+
+    /**
+     * Read and write counts each tablet reported in the previous round.
+     * Masters report counts accumulated since they took ownership of a
+     * tablet, so load is the difference between consecutive rounds.
+     */
+    std::map<TabletKey, uint64_t> previousCounts;
+
+    DISALLOW_COPY_AND_ASSIGN(TabletBalancer);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_TABLETBALANCER_H
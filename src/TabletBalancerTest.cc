@@ -0,0 +1,230 @@
+/* Copyright (c) 2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "RamCloud.h"
+#include "StringUtil.h"
+#include "TabletBalancer.h"
+
+namespace RAMCloud {
+
+class TabletBalancerTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    CoordinatorService* service;
+    TabletBalancer* balancer;
+    ServerConfig masterConfig;
+    Tub<RamCloud> ramcloud;
+    RuntimeOptions::TabletBalancerOptions options;
+
+    TabletBalancerTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , service(cluster.coordinator.get())
+        , balancer(&service->tabletBalancer)
+        , masterConfig(ServerConfig::forTesting())
+        , ramcloud()
+        , options(service->runtimeOptions.getTabletBalancerOptions())
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+        masterConfig.services = {WireFormat::MASTER_SERVICE,
+                                 WireFormat::MEMBERSHIP_SERVICE};
+        masterConfig.master.numReplicas = 0;
+        options.minOperations = 0;
+    }
+
+    void
+    addMasters()
+    {
+        masterConfig.localLocator = "mock:host=master1";
+        cluster.addServer(masterConfig);
+        masterConfig.localLocator = "mock:host=master2";
+        cluster.addServer(masterConfig);
+        ramcloud.construct(&context, "mock:host=coordinator");
+    }
+
+    static string
+    toString(const vector<TabletBalancer::Move>& moves)
+    {
+        string result;
+        foreach (const TabletBalancer::Move& move, moves) {
+            if (result.size() > 0)
+                result += " | ";
+            result += move.toString();
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(TabletBalancerTest);
+};
+
+TEST_F(TabletBalancerTest, plan_notSkewed) {
+    vector<TabletBalancer::MasterLoad> masters;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(1, 0)));
+    masters.back().tablets.push_back({1, 0, ~0UL, 100, 1000});
+    masters.back().operations = 100;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(2, 0)));
+    masters.back().tablets.push_back({2, 0, ~0UL, 90, 1000});
+    masters.back().operations = 90;
+    EXPECT_EQ(0U, TabletBalancer::plan(masters, options).size());
+
+    // Not enough load to bother.
+    masters[1].operations = masters[1].tablets[0].operations = 0;
+    options.minOperations = 101;
+    EXPECT_EQ(0U, TabletBalancer::plan(masters, options).size());
+}
+
+TEST_F(TabletBalancerTest, plan_migrate) {
+    vector<TabletBalancer::MasterLoad> masters;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(1, 0)));
+    masters.back().tablets.push_back({1, 0, 9, 60, 1000});
+    masters.back().tablets.push_back({1, 10, 19, 30, 1000});
+    masters.back().tablets.push_back({1, 20, 29, 10, 1000});
+    masters.back().operations = 100;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(2, 0)));
+
+    // The 60-operation tablet would overload master 2; after moving the
+    // 30-operation one, the load is no longer skewed enough.
+    EXPECT_EQ("migrate tablet [0xa,0x13] in tableId 1 from 1.0 to 2.0 "
+              "(30 operations, 1000 bytes)",
+              toString(TabletBalancer::plan(masters, options)));
+    EXPECT_EQ(70U, masters[0].operations);
+    EXPECT_EQ(2U, masters[0].tablets.size());
+    EXPECT_EQ(30U, masters[1].operations);
+    EXPECT_EQ(1U, masters[1].tablets.size());
+}
+
+TEST_F(TabletBalancerTest, plan_byteLimit) {
+    vector<TabletBalancer::MasterLoad> masters;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(1, 0)));
+    masters.back().tablets.push_back({1, 0, 9, 60, 1000});
+    masters.back().tablets.push_back({1, 10, 19, 30, 2 * 1024 * 1024});
+    masters.back().tablets.push_back({1, 20, 29, 10, 1000});
+    masters.back().operations = 100;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(2, 0)));
+
+    options.maxMoveMegabytes = 1;
+    EXPECT_EQ("migrate tablet [0x14,0x1d] in tableId 1 from 1.0 to 2.0 "
+              "(10 operations, 1000 bytes)",
+              toString(TabletBalancer::plan(masters, options)));
+}
+
+TEST_F(TabletBalancerTest, plan_splitHotTablet) {
+    vector<TabletBalancer::MasterLoad> masters;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(1, 0)));
+    masters.back().tablets.push_back({1, 0, ~0UL, 100, 1000});
+    masters.back().operations = 100;
+    masters.push_back(TabletBalancer::MasterLoad(ServerId(2, 0)));
+    vector<TabletBalancer::MasterLoad> saved = masters;
+
+    EXPECT_EQ("split tablet [0x0,0xffffffffffffffff] in tableId 1 on 1.0 "
+              "at 0x8000000000000000 (100 operations, 1000 bytes) | "
+              "migrate tablet [0x0,0x7fffffffffffffff] in "
+              "tableId 1 from 1.0 to 2.0 (50 operations, 500 bytes)",
+              toString(TabletBalancer::plan(masters, options)));
+
+    // No room to migrate half of the tablet in this round.
+    options.maxMoves = 1;
+    EXPECT_EQ("", toString(TabletBalancer::plan(saved, options)));
+}
+
+TEST_F(TabletBalancerTest, collectLoad) {
+    addMasters();
+    uint64_t tableId = ramcloud->createTable("table");
+    ramcloud->write(tableId, "0", 1, "abcdef", 6);
+
+    vector<TabletBalancer::MasterLoad> masters;
+    balancer->collectLoad(&masters);
+    ASSERT_EQ(2U, masters.size());
+    EXPECT_EQ(0U, masters[0].operations + masters[1].operations);
+
+    Buffer value;
+    ramcloud->read(tableId, "0", 1, &value);
+    ramcloud->read(tableId, "0", 1, &value);
+    masters.clear();
+    balancer->collectLoad(&masters);
+    ASSERT_EQ(2U, masters.size());
+    TabletBalancer::MasterLoad& owner =
+            masters[0].tablets.size() > 0 ? masters[0] : masters[1];
+    ASSERT_EQ(1U, owner.tablets.size());
+    EXPECT_EQ(2U, owner.operations);
+    EXPECT_EQ(2U, owner.tablets[0].operations);
+    EXPECT_LT(0U, owner.tablets[0].bytes);
+}
+
+TEST_F(TabletBalancerTest, balance_dryRun) {
+    addMasters();
+    uint64_t tableId = ramcloud->createTable("table");
+    ServerId owner = service->tableManager.getTablet(tableId, 0).serverId;
+    service->runtimeOptions.set("tabletBalancerMode", "1");
+    service->runtimeOptions.set("tabletBalancerMinOperations", "0");
+    balancer->balance();
+
+    ramcloud->write(tableId, "0", 1, "abcdef", 6);
+    TestLog::Enable _("balance");
+    balancer->balance();
+    EXPECT_TRUE(TestUtil::matchesPosixRegex(format(
+            "^balance: Dry run; would split tablet "
+            "\\[0x0,0xffffffffffffffff\\] in tableId %lu on %s at "
+            "0x8000000000000000 \\(1 operations, [0-9]+ bytes\\)$",
+            tableId, owner.toString().c_str()), TestLog::get()));
+    EXPECT_EQ(owner, service->tableManager.getTablet(tableId, ~0UL).serverId);
+    EXPECT_EQ(0UL, service->tableManager.getTablet(tableId, ~0UL)
+              .startKeyHash);
+}
+
+TEST_F(TabletBalancerTest, balance_active) {
+    addMasters();
+    uint64_t tableId = ramcloud->createTable("table");
+    ServerId owner = service->tableManager.getTablet(tableId, 0).serverId;
+    service->runtimeOptions.set("tabletBalancerMode", "2");
+    service->runtimeOptions.set("tabletBalancerMinOperations", "0");
+    balancer->balance();
+
+    ramcloud->write(tableId, "0", 1, "abcdef", 6);
+    ramcloud->write(tableId, "1", 1, "ghijkl", 6);
+    balancer->balance();
+
+    Tablet lower = service->tableManager.getTablet(tableId, 0);
+    Tablet upper = service->tableManager.getTablet(tableId, ~0UL);
+    EXPECT_EQ(0x7fffffffffffffffUL, lower.endKeyHash);
+    EXPECT_NE(owner, lower.serverId);
+    EXPECT_EQ(0x8000000000000000UL, upper.startKeyHash);
+    EXPECT_EQ(owner, upper.serverId);
+
+    Buffer value;
+    ramcloud->read(tableId, "0", 1, &value);
+    EXPECT_EQ("abcdef", TestUtil::toString(&value));
+    ramcloud->read(tableId, "1", 1, &value);
+    EXPECT_EQ("ghijkl", TestUtil::toString(&value));
+}
+
+TEST_F(TabletBalancerTest, execute_tabletChanged) {
+    addMasters();
+    uint64_t tableId = ramcloud->createTable("table");
+    ServerId owner = service->tableManager.getTablet(tableId, 0).serverId;
+    TabletBalancer::Move move(TabletBalancer::Move::SPLIT, tableId, 0, 1000,
+            500, owner, ServerId(), 0, 0);
+    TestLog::Enable _("execute");
+    EXPECT_FALSE(balancer->execute(move));
+    EXPECT_TRUE(StringUtil::startsWith(TestLog::get(),
+            "execute: Tablet changed since the move was planned"));
+}
+
+}  // namespace RAMCloud
@@ -23,6 +23,7 @@
 #include "Atomic.h"
 #include "BoostIntrusive.h"
 #include "Buffer.h"
+#include "Cycles.h"
 #include "ServiceLocator.h"
 #include "PerfCounter.h"
 
@@ -76,6 +77,7 @@ class Transport {
               replyPayload(),
               epoch(INVALID_EPOCH),
               outstandingRpcListHook(),
+              stageTimes(),
               enqueueThreadToStartWork(
                       &ReadThreadingCost_MetricSet::enqueueThreadToStartWork,
                       false),
@@ -148,11 +150,40 @@ class Transport {
         uint64_t epoch;
 
         /**
-         * Hook for the list of active server RPCs that the ServerRpcPool class
+         * Hook for the list of active server RPCs that each ServerRpcPool
          * maintains. RPCs are added when ServerRpc-derived classes are
          * constructed by ServerRpcPool and removed when they're destroyed.
          */
         IntrusiveListHook outstandingRpcListHook;
+
+        /**
+         * Records this RPC's progress through the server, so that
+         * ServiceManager can break its latency down into stages when the
+         * reply is sent (see ServiceManager::RpcStage). All times are in
+         * Cycles::rdtsc() ticks; zero means the point hasn't been reached.
+         */
+        struct StageTimes {
+            StageTimes()
+                : received(Cycles::rdtsc()), dispatched(0), handedOff(0),
+                  started(0), completed(0), lookupCycles(0), syncCycles(0)
+            {}
+            uint64_t received;         /// The transport created this RPC,
+                                       /// normally when its first packet
+                                       /// arrived.
+            uint64_t dispatched;       /// The transport passed the complete
+                                       /// request to ServiceManager.
+            uint64_t handedOff;        /// ServiceManager handed the RPC to a
+                                       /// worker thread.
+            uint64_t started;          /// The worker began executing it.
+            uint64_t completed;        /// The worker finished executing it,
+                                       /// or asked for the reply to be sent
+                                       /// early.
+            uint64_t lookupCycles;     /// Time the worker spent looking up
+                                       /// objects (see RpcStageTimer).
+            uint64_t syncCycles;       /// Time the worker spent waiting for
+                                       /// replication (see RpcStageTimer).
+        } stageTimes;
+
         ReadThreadingCost_MetricSet::Interval enqueueThreadToStartWork;
         ReadThreadingCost_MetricSet::Interval returnToTransport;
       protected:
@@ -104,6 +104,10 @@ opcodeSymbol(uint32_t opcode)
         case READ_KEYS_AND_VALUE:        return "READ_KEYS_AND_VALUE";
         case LOOKUP_INDEX_KEYS:          return "LOOKUP_INDEX_KEYS";
         case INDEXED_READ:               return "INDEXED_READ";
+        case READ_MODIFY_WRITE:          return "READ_MODIFY_WRITE";
+        case CACHE_HOT_OBJECT:           return "CACHE_HOT_OBJECT";
+        case INVALIDATE_HOT_OBJECT:      return "INVALIDATE_HOT_OBJECT";
+        case GET_RPC_STAGE_METRICS:      return "GET_RPC_STAGE_METRICS";
         case ILLEGAL_RPC_TYPE:           return "ILLEGAL_RPC_TYPE";
         case INSERT_INDEX_ENTRY:         return "INSERT_INDEX_ENTRY";
         case REMOVE_INDEX_ENTRY:         return "REMOVE_INDEX_ENTRY";
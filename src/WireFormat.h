@@ -119,7 +119,11 @@ enum Opcode {
     DROP_INDEX                = 65,
     DROP_INDEXLET_OWNERSHIP   = 66,
     TAKE_INDEXLET_OWNERSHIP   = 67,
-    ILLEGAL_RPC_TYPE          = 68,  // 1 + the highest legitimate Opcode
+    READ_MODIFY_WRITE         = 68,
+    CACHE_HOT_OBJECT          = 69,
+    INVALIDATE_HOT_OBJECT     = 70,
+    GET_RPC_STAGE_METRICS     = 71,
+    ILLEGAL_RPC_TYPE          = 72,  // 1 + the highest legitimate Opcode
 };
 
 /**
@@ -187,6 +191,40 @@ struct RetryResponse {
                                   // included in messageLength.
 } __attribute__((packed));
 
+/**
+ * Serialized form of an ObjectFilter, which optionally accompanies
+ * multiRead and enumerate requests. See ObjectFilter for the meaning of
+ * the fields.
+ */
+struct ObjectFilter {
+    uint8_t predicate;            // An ObjectFilter::Predicate.
+    uint8_t keyIndex;             // Key tested by the predicate.
+    uint16_t firstKeyLength;      // Length of the first key of a KEY_RANGE
+                                  // predicate; the key itself immediately
+                                  // follows this header.
+    uint16_t lastKeyLength;       // Length of the last key of a KEY_RANGE
+                                  // predicate; the key itself immediately
+                                  // follows the first key.
+    uint32_t valueOffset;         // First byte of each value to return.
+    uint32_t valueLength;         // Maximum bytes of each value to return;
+                                  // ~0 means through the end of the value.
+} __attribute__((packed));
+
+/**
+ * Serialized form of an RmwOperation, which accompanies readModifyWrite
+ * requests. See RmwOperation for the meaning of the fields.
+ */
+struct RmwOperation {
+    uint8_t op;                   // An RmwOperation::Operator.
+    uint32_t fieldOffset;         // Offset within the value of the bytes
+                                  // the operator applies to.
+    int64_t minValue;             // Bounds on the result of ADD.
+    int64_t maxValue;
+    uint32_t operandLength;       // Length of the operand in bytes; the
+                                  // operand itself immediately follows
+                                  // this header.
+} __attribute__((packed));
+
 
 // For each RPC there is a structure below, which contains the following:
 //   * A field "opcode" defining the Opcode used in requests.
@@ -370,6 +408,7 @@ struct BackupWrite {
             , primary()
             , certificateIncluded()
             , certificate()
+            , compressed()
         {}
         Request(const RequestCommonWithId& common,
                 uint64_t masterId,
@@ -381,7 +420,8 @@ struct BackupWrite {
                 bool close,
                 bool primary,
                 bool certificateIncluded,
-                const Segment::Certificate& certificate)
+                const Segment::Certificate& certificate,
+                bool compressed = false)
             : common(common)
             , masterId(masterId)
             , segmentId(segmentId)
@@ -393,6 +433,7 @@ struct BackupWrite {
             , primary(primary)
             , certificateIncluded(certificateIncluded)
             , certificate(certificate)
+            , compressed(compressed)
         {}
         RequestCommonWithId common;
         uint64_t masterId;        ///< Server from whom the request is coming.
@@ -416,6 +457,10 @@ struct BackupWrite {
                                           ///< written to storage
                                           ///< following the data included
                                           ///< in this rpc.
+        bool compressed;          ///< If true the replica is a compressed
+                                  ///< image (see SegmentCompressor) rather
+                                  ///< than the segment itself; #certificate
+                                  ///< still covers the uncompressed data.
         // Opaque byte string follows with data to write.
     } __attribute__((packed));
     struct Response {
@@ -423,6 +468,30 @@ struct BackupWrite {
     } __attribute__((packed));
 };
 
+/**
+ * Sent by a master to give another master a read-only copy of one of its
+ * frequently read objects; see HotKeyCache.
+ */
+struct CacheHotObject {
+    static const Opcode opcode = CACHE_HOT_OBJECT;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommonWithId common;
+        uint64_t tableId;
+        uint64_t version;             // Version of the object.
+        uint32_t leaseMs;             // The copy may be served for this many
+                                      // milliseconds after it arrives: the
+                                      // time left on the owner's lease
+                                      // when it was sent.
+        uint32_t length;              // Length of the object's keys and
+                                      // value, which follow immediately
+                                      // after this header.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+    } __attribute__((packed));
+};
+
 struct CreateTable {
     static const Opcode opcode = CREATE_TABLE;
     static const ServiceType service = COORDINATOR_SERVICE;
@@ -550,11 +619,18 @@ struct Enumerate {
                                     // been truncated so that the object data
                                     // (normally the last field of the object)
                                     // is omitted.
+        bool snapshot;              // True means return objects as they were
+                                    // when the server started enumerating
+                                    // the tablet, rather than as they are
+                                    // now. See SnapshotManager.
         uint64_t tabletFirstHash;
         uint32_t iteratorBytes;     // Size of iterator in bytes. The
                                     // actual iterator follows
                                     // immediately after this header.
                                     // See EnumerationIterator.
+        uint32_t filterBytes;       // Size of an ObjectFilter to apply to
+                                    // the returned objects, which follows
+                                    // the iterator. 0 means no filter.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
@@ -630,6 +706,21 @@ struct GetMetrics {
     } __attribute__((packed));
 };
 
+struct GetRpcStageMetrics {
+    static const Opcode opcode = Opcode::GET_RPC_STAGE_METRICS;
+    static const ServiceType service = PING_SERVICE;
+    struct Request {
+        RequestCommon common;
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint32_t messageLength;    // Number of bytes in a
+                                   // ProtoBuf::RpcStageMetrics message that
+                                   // follows immediately after this
+                                   // header.
+    } __attribute__((packed));
+};
+
 struct GetRuntimeOption {
     static const Opcode opcode = GET_RUNTIME_OPTION;
     static const ServiceType service = COORDINATOR_SERVICE;
@@ -830,6 +921,27 @@ struct InsertIndexEntry {
     } __attribute__((packed));
 };
 
+/**
+ * Sent by the owner of an object to the masters holding copies of it after
+ * the object is modified; see HotKeyCache.
+ */
+struct InvalidateHotObject {
+    static const Opcode opcode = INVALIDATE_HOT_OBJECT;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommonWithId common;
+        uint64_t tableId;
+        uint16_t keyLength;           // Length of the key in bytes.
+                                      // The actual key follows
+                                      // immediately after this header.
+        uint64_t version;             // Copies older than this version
+                                      // must never be served again.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+    } __attribute__((packed));
+};
+
 /**
  * Used by backups to determine if a particular replica is still needed
  * by a master.  This is only used in the case the backup has crashed, and
@@ -909,7 +1021,7 @@ struct MultiOp {
 
     /// Type of Multi Operation
     /// Note: Make sure INVALID is always last.
-    enum OpType { READ, REMOVE, WRITE, INVALID };
+    enum OpType { READ, REMOVE, WRITE, READ_MODIFY_WRITE, INVALID };
 
     struct Request {
         RequestCommon common;
@@ -919,10 +1031,14 @@ struct MultiOp {
         struct ReadPart {
             uint64_t tableId;
             uint16_t keyLength;
+            uint16_t filterLength;  // Size of an ObjectFilter to apply to
+                                    // this object. 0 means no filter.
             // In buffer: The actual key for this part
-            // follows immediately after this.
-            ReadPart(uint64_t tableId, uint16_t keyLength)
-                : tableId(tableId), keyLength(keyLength) {}
+            // follows immediately after this, followed by the filter.
+            ReadPart(uint64_t tableId, uint16_t keyLength,
+                     uint16_t filterLength = 0)
+                : tableId(tableId), keyLength(keyLength)
+                , filterLength(filterLength) {}
         } __attribute__((packed));
 
         struct RemovePart {
@@ -955,6 +1071,25 @@ struct MultiOp {
             {
             }
         } __attribute__((packed));
+
+        struct ReadModifyWritePart {
+            uint64_t tableId;
+            uint16_t keyLength;
+            uint32_t operationLength;   // Size of the RmwOperation.
+            RejectRules rejectRules;
+
+            // In buffer: The actual key for this part follows immediately
+            // after this, followed by the RmwOperation.
+            ReadModifyWritePart(uint64_t tableId, uint16_t keyLength,
+                                uint32_t operationLength,
+                                RejectRules rejectRules)
+                : tableId(tableId)
+                , keyLength(keyLength)
+                , operationLength(operationLength)
+                , rejectRules(rejectRules)
+            {
+            }
+        } __attribute__((packed));
     } __attribute__((packed));
     struct Response {
         // RpcResponseCommon contains a status field. But it is not used in
@@ -1009,6 +1144,20 @@ struct MultiOp {
             /// Version of the written object.
             uint64_t version;
         } __attribute__((packed));
+
+        struct ReadModifyWritePart {
+            /// Status of the operation.
+            Status status;
+
+            /// Version of the object: the new version if the operation
+            /// succeeded, otherwise the current one.
+            uint64_t version;
+
+            /// Length of the value following this struct: the new value if
+            /// the operation succeeded, or the current value if it failed
+            /// with STATUS_RMW_CONDITION_FAILED; 0 otherwise.
+            uint32_t length;
+        } __attribute__((packed));
     } __attribute__((packed));
 };
 
@@ -1076,6 +1225,35 @@ struct Read {
         uint32_t length;              // Length of the object's value in bytes.
                                       // The actual bytes of the object follow
                                       // immediately after this header.
+        uint32_t replicasLength;      // Length of the service locators of
+                                      // masters holding copies of a hot
+                                      // object, which follow the value; each
+                                      // is terminated by a null character.
+        uint32_t replicaLeaseMs;      // How long the copies remain valid.
+    } __attribute__((packed));
+};
+
+struct ReadModifyWrite {
+    static const Opcode opcode = READ_MODIFY_WRITE;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        uint16_t keyLength;           // Length of the key in bytes.
+                                      // The actual key follows
+                                      // immediately after this header.
+        uint32_t operationLength;     // Length of the RmwOperation, which
+                                      // follows the key.
+        RejectRules rejectRules;
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t version;
+        uint32_t length;              // Length of the object's value in bytes.
+                                      // The new value (or the current one,
+                                      // if the status is
+                                      // STATUS_RMW_CONDITION_FAILED) follows
+                                      // immediately after this header.
     } __attribute__((packed));
 };
 